@@ -1,5 +1,9 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
 #include <variant>
 #include <vector>
@@ -59,10 +63,24 @@ struct IndexOrSlice {
     SourceLocation loc{};
 };
 
+// Environment slot of a reference's name, filled on first lookup (see
+// Environment::slot) together with the name table it belongs to. Copies
+// start empty: the preprocessors rename copied references.
+struct SlotCache {
+    mutable std::atomic<uint64_t> bits{0};
+    SlotCache() = default;
+    SlotCache(const SlotCache&) noexcept {}
+    SlotCache& operator=(const SlotCache&) noexcept {
+        bits.store(0, std::memory_order_relaxed);
+        return *this;
+    }
+};
+
 struct TensorRef {
     Identifier name;
     std::vector<IndexOrSlice> indices; // empty means scalar, can mix Index and Slice
     SourceLocation loc{};
+    SlotCache slot{};
 };
 
 // Very early and minimal expression model
@@ -73,7 +91,12 @@ struct ExprTensorRef { TensorRef ref; };
 struct ExprNumber { NumberLiteral literal; };
 struct ExprString { StringLiteral literal; };
 // List literal: elements may be numbers or nested lists (n-dimensional)
-struct ExprList { std::vector<ExprPtr> elements; };
+struct ListConstant;  // Folded tensor value, see executor_utils::foldListLiteral
+struct ExprList {
+    std::vector<ExprPtr> elements;
+    // Filled on first evaluation; shared by copies of the node
+    mutable std::shared_ptr<const ListConstant> folded;
+};
 struct ExprParen { ExprPtr inner; };
 struct ExprCall { Identifier func; std::vector<ExprPtr> args; };
 struct ExprBinary {
@@ -160,6 +183,17 @@ struct QueryDirective {
     SourceLocation loc{};
 };
 
+// Answer modifiers written after a query: @limit(n=20) keeps the first n
+// answers (or tensor rows), @exists() only asks whether there is an answer,
+// and @topk(k=5) keeps the k largest elements along a tensor's last dimension
+struct QueryModifiers {
+    std::optional<uint64_t> limit;
+    bool exists{false};
+    std::optional<uint64_t> topk;
+
+    bool empty() const { return !limit && !exists && !topk; }
+};
+
 struct Query {
     // Support queries over tensor refs and Datalog atoms
     // Additionally, for Datalog queries, we may allow a conjunction of atoms and comparisons.
@@ -168,6 +202,7 @@ struct Query {
     std::vector<std::variant<DatalogAtom, DatalogNegation, DatalogCondition>> body;
     // Optional learning directive (e.g., Loss? @minimize(lr=0.01, epochs=100))
     std::optional<QueryDirective> directive;
+    QueryModifiers modifiers;
     SourceLocation loc{};
 };
 
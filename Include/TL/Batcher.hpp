@@ -0,0 +1,93 @@
+#pragma once
+
+#include "TL/Model.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tl {
+
+struct BatchOptions {
+  size_t maxBatch{32};                          // requests run together at most
+  std::chrono::microseconds maxLatency{2000};   // longest the first request of a batch waits
+};
+
+// Micro-batching in front of a Model. Requests that bind the same inputs
+// with the same shapes are stacked along a new leading axis and run as one
+// evaluation of a rewritten program, whose tensors computed from the inputs
+// carry a leading batch index (H[i] = W[i, j] X[j] becomes
+// H[b, i] = W[i, j] X[b, j]); the outputs are split back per request.
+// Programs made only of tensor equations and plain tensor queries can be
+// rewritten, as long as every reference to a batched tensor is indexed and
+// no equation mixes batched and unbatched writes of one tensor. For other
+// programs, batched() is false and every request is evaluated on its own.
+// If a batched run throws, its requests are retried one by one, so a bad
+// request only fails itself. Query output is not reported per request and
+// is dropped.
+class Batcher {
+public:
+  using Result = std::map<std::string, Tensor>;
+
+  // `inputs` are the names every request binds, `outputs` the tensors it
+  // gets back. `model` must outlive the batcher.
+  Batcher(const Model &model, std::vector<std::string> inputs, std::vector<std::string> outputs,
+          BatchOptions options = {});
+  // Runs the requests still queued, then stops the dispatcher
+  ~Batcher();
+
+  Batcher(const Batcher &) = delete;
+  Batcher &operator=(const Batcher &) = delete;
+
+  // Queues a request. The future throws std::invalid_argument if the
+  // request does not bind exactly the batcher's inputs, and whatever the
+  // evaluation throws for it. Thread-safe.
+  std::future<Result> submit(std::map<std::string, Tensor> inputs);
+  Result evaluate(std::map<std::string, Tensor> inputs) { return submit(std::move(inputs)).get(); }
+
+  // Whether the program could be rewritten to run batches
+  bool batched() const { return batched_model_ != nullptr; }
+  // The rewritten program (empty if batched() is false)
+  const Program &batchedProgram() const;
+
+  // Requests and batched runs so far, for tuning the options
+  size_t requests() const;
+  size_t batches() const;
+
+private:
+  struct Request {
+    std::map<std::string, Tensor> inputs;
+    std::promise<Result> promise;
+    std::chrono::steady_clock::time_point arrived;
+  };
+
+  void dispatchLoop();
+  void runBatch(std::vector<Request> &batch);
+  void runSingle(Request &request);
+
+  const Model &model_;
+  std::vector<std::string> inputs_;
+  std::vector<std::string> outputs_;
+  BatchOptions options_;
+  std::unique_ptr<Model> batched_model_;  // null if the program cannot carry a batch index
+  std::set<std::string> batched_tensors_;  // tensors with the leading batch index
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Request> queue_;
+  size_t requests_{0};
+  size_t batches_{0};
+  bool stop_{false};
+  std::thread dispatcher_;
+};
+
+} // namespace tl
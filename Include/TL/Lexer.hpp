@@ -1,5 +1,6 @@
 #pragma once
 
+#include <deque>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -20,18 +21,25 @@ namespace tl::lex {
             KwAnd, KwOr, KwNot,  // Keywords for logical operators
             End, Newline, Unknown
         } type{End};
-        std::string text;
+        // A view into the source, or into the stream for string literals
+        // with escapes; valid while both live
+        std::string_view text;
         SourceLocation loc{};
     };
 
+    // Tokens of a source buffer, which must outlive the stream: token text
+    // refers to it instead of being copied
     class TokenStream {
     public:
         explicit TokenStream(std::string_view src);
+        TokenStream(const TokenStream&) = delete;
+        TokenStream& operator=(const TokenStream&) = delete;
         [[nodiscard]] const Token& peek() const;
         [[nodiscard]] const Token& lookahead(size_t n) const; // look ahead without consuming
-        Token consume();
+        const Token& consume();
     private:
         std::vector<Token> tokens_;
+        std::deque<std::string> unescaped_;  // stable addresses for views
         size_t idx_{0};
     };
 
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+// Most detailed debug output compiled in, set by the TL_LOG_LEVEL CMake
+// option: 0 compiles all of it out, 1 keeps the per-run summaries, 2 (the
+// default) also keeps the per-statement and per-step messages of the
+// execution loops. What is compiled in is printed only while the owner's
+// debug flag is on.
+#ifndef TL_LOG_LEVEL
+#define TL_LOG_LEVEL 2
+#endif
+
+namespace tl {
+
+enum class LogLevel {
+  Off = 0,
+  Debug = 1,  // once per run, directive, loop or saturation
+  Trace = 2   // once per statement, step, dispatch or join
+};
+
+// Whether messages of `level` are compiled in. Guards written as
+// `logCompiled(level) && debug_` fold to false when they are not, so the
+// message and everything formatting it are removed from the build.
+constexpr bool logCompiled(LogLevel level) { return static_cast<int>(level) <= TL_LOG_LEVEL; }
+
+// TL_DEBUG=1, true, yes or on (any case); read once per process
+inline bool debugFromEnvironment() {
+  static const bool enabled = [] {
+    const char *env = std::getenv("TL_DEBUG");
+    if (!env) return false;
+    std::string v = env;
+    std::transform(v.begin(), v.end(), v.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return v == "1" || v == "true" || v == "yes" || v == "on";
+  }();
+  return enabled;
+}
+
+// One log line: formatted in a buffer and written with a single call when
+// the statement ends, so lines from concurrent workers do not interleave
+class LogLine {
+public:
+  explicit LogLine(std::ostream &sink) : sink_(sink) {}
+  LogLine(const LogLine &) = delete;
+  LogLine &operator=(const LogLine &) = delete;
+  ~LogLine() {
+    buffer_ << '\n';
+    sink_ << buffer_.str() << std::flush;
+  }
+
+  template <typename T> LogLine &operator<<(const T &value) {
+    buffer_ << value;
+    return *this;
+  }
+
+private:
+  std::ostream &sink_;
+  std::ostringstream buffer_;
+};
+
+} // namespace tl
+
+// Writes `message`, a << chain, as one line to `sink` if `enabled`. The
+// chain is only evaluated then, and the statement compiles to nothing when
+// `level` (Debug or Trace) is above TL_LOG_LEVEL.
+#define TL_LOG(level, enabled, sink, message)                                                      \
+  do {                                                                                             \
+    if constexpr (::tl::logCompiled(::tl::LogLevel::level)) {                                      \
+      if (enabled) ::tl::LogLine{sink} << message;                                                 \
+    }                                                                                              \
+  } while (0)
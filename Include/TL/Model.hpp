@@ -0,0 +1,62 @@
+#pragma once
+
+#include "TL/AST.hpp"
+#include "TL/vm.hpp"
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tl {
+
+// A program compiled once over the parameters a VM has built, for serving
+// many requests at once. The model freezes a copy of the VM: its
+// environment (weights, facts, labels), settings and Datalog rules. Each
+// request runs in a context VM of its own that starts from that
+// environment. Tensors are shared with the model rather than copied, and
+// in-place writes copy on write (see Environment::writable), so requests
+// never see each other's values or change the parameters. Executors are
+// shared too; relations are copied per context. Every member is safe to
+// call from any number of threads.
+class Model {
+public:
+  // Freezes `vm` as it is now and compiles `program` against its
+  // environment; later changes to the VM do not reach the model. Its
+  // profiler is not carried over.
+  Model(const TensorLogicVM &vm, const Program &program);
+
+  // Model of another program over the same frozen parameters and settings
+  Model derive(const Program &program) const;
+
+  const CompiledProgram &plan() const { return plan_; }
+  // Read-only view of the frozen environment (Environment::facts builds
+  // string views on demand and is the one accessor not to call concurrently)
+  const Environment &parameters() const { return prototype_->env(); }
+
+  // A fresh VM over the parameters, for binding a request's inputs in its
+  // env() before run(). Also usable on its own, e.g. to run other programs
+  // against the parameters.
+  std::unique_ptr<TensorLogicVM> context(std::ostream *out = &std::cout,
+                                         std::ostream *err = &std::cerr) const;
+
+  // Runs the program in a context made by context(), on a copy of the plan
+  void run(TensorLogicVM &context) const;
+
+  // One request: binds `inputs` in a new context, runs the program and
+  // returns the tensors named in `outputs`. Query results are written to
+  // `out`, or dropped if it is null. With dead-code elimination or
+  // intermediate release on, only query targets and file writes are sure to
+  // be bound at the end. Throws std::runtime_error for an output that is
+  // not bound after the run.
+  std::map<std::string, Tensor> evaluate(const std::map<std::string, Tensor> &inputs,
+                                         const std::vector<std::string> &outputs,
+                                         std::ostream *out = nullptr) const;
+
+private:
+  std::unique_ptr<const TensorLogicVM> prototype_;
+  CompiledProgram plan_;
+};
+
+} // namespace tl
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "TL/AST.hpp"
+#include <string>
+#include <string_view>
+
+namespace tl {
+
+// Binary encoding of a parsed program: every node with its source location.
+// Evaluation state (folded list literals) is not stored and is rebuilt on
+// first use, as for a freshly parsed program.
+std::string serializeProgram(const Program& program);
+
+// Inverse of serializeProgram; throws std::runtime_error on truncated or
+// malformed input
+Program deserializeProgram(std::string_view bytes);
+
+// Where the cache of a source file lives: next to it, "model.tl" -> "model.tlc"
+std::string programCachePath(const std::string& sourcePath);
+
+// Like parseFile, but reuses the cache next to the file when it was written
+// for the same source content (hash and size) by the same format version.
+// Otherwise the file is parsed and the cache (re)written. A cache that can't
+// be read or written is ignored. `cacheHit`, if given, reports which path
+// was taken.
+Program loadProgram(const std::string& path, bool* cacheHit = nullptr);
+
+} // namespace tl
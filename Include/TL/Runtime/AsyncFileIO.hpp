@@ -0,0 +1,91 @@
+#pragma once
+
+#include "TL/core.hpp"
+#include <filesystem>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tl {
+
+    /**
+     * @brief Background reads and writes of tensor files (see tensor_io)
+     *
+     * Reads a program will need are started with prefetch() as soon as the
+     * program is known and collected with read() by the statement that binds
+     * them, which only waits for whatever is still in flight. The pages of a
+     * mapped binary file are touched in the background too, so a slow
+     * filesystem is read off the critical path. Writes return at once and
+     * run in the background; writes of one path run in the order they were
+     * issued, and a read of a path waits for its pending writes first.
+     * flush() is the barrier that waits for every write and reports the
+     * first that failed.
+     *
+     * Paths are compared as given, so callers should resolve them first.
+     * Not thread-safe: one owner issues every operation.
+     */
+    class AsyncFileIO {
+    public:
+        AsyncFileIO() = default;
+        /// Waits for every read and write still running; write errors are dropped
+        ~AsyncFileIO();
+
+        AsyncFileIO(const AsyncFileIO&) = delete;
+        AsyncFileIO& operator=(const AsyncFileIO&) = delete;
+
+        /**
+         * @brief Start reading a tensor file in the background
+         *
+         * Does nothing if the path is already being read. A read of a path
+         * with pending writes starts once they are done.
+         */
+        void prefetch(const std::filesystem::path& path);
+
+        /**
+         * @brief The tensor of a file: the prefetched one, or read now
+         * @throws std::runtime_error as tensor_io::read does, also for a prefetch that failed
+         */
+        Tensor read(const std::filesystem::path& path);
+
+        /**
+         * @brief Write a tensor in the background
+         *
+         * The tensor must not be modified in place until the write is
+         * flushed; the caller hands over a copy if it cannot promise that.
+         */
+        void write(const std::filesystem::path& path, const Tensor& t);
+
+        /**
+         * @brief Wait for the pending writes of a path (errors are left to flush())
+         */
+        void wait(const std::filesystem::path& path);
+
+        /**
+         * @brief Wait for every pending write
+         * @throws std::runtime_error the first error of a write since the last flush
+         */
+        void flush();
+
+        /**
+         * @brief Drop prefetched tensors nobody read, waiting for reads in flight
+         */
+        void discard();
+
+        /**
+         * @brief Reads started by prefetch() and not yet collected
+         */
+        size_t pendingReads() const { return reads_.size(); }
+
+        /**
+         * @brief Writes issued since the last flush()
+         */
+        size_t pendingWrites() const { return writes_.size(); }
+
+    private:
+        std::unordered_map<std::string, std::future<Tensor>> reads_;
+        std::unordered_map<std::string, std::shared_future<void>> last_write_;  // by path
+        std::vector<std::shared_future<void>> writes_;                          // in issue order
+    };
+
+} // namespace tl
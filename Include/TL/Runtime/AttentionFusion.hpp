@@ -0,0 +1,133 @@
+#pragma once
+
+#include "TL/AST.hpp"
+#include "TL/core.hpp"
+#include "TL/Runtime/DTypePolicy.hpp"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tl {
+
+    class Environment;
+
+    /**
+     * @brief An attention chain of equations, evaluated without its L x L tensors
+     *
+     * Recognizes the weighted sum over normalized attention weights
+     *
+     *     Scores[h, p, p'] = Query[h, p, d] Key[h, p', d] / sqrt_dk
+     *     Attn[h, p, p'.]  = softmax(Scores[h, p, p'])
+     *     Out[h, p, v]     = Attn[h, p, p'] Value[h, p', v]
+     *
+     * where the weights, and any score tensors they are computed from, are
+     * read by nothing else. Batch indices (h) may number zero or more. The
+     * score may be any elementwise expression of the one contraction, of
+     * scalars and of tensors indexed by trailing LHS indices, such as the
+     * masks of `RawScores * Mask + neg_inf * (1 - Mask)`.
+     *
+     * A scaled contraction plus at most an additive mask runs as LibTorch's
+     * scaled_dot_product_attention (its flash kernel on CPU). Other scores
+     * are evaluated a block of query rows at a time, so at most one block
+     * of scores exists at once.
+     */
+    class FusedAttention {
+    public:
+        /// Single-use equation defining a tensor, or nullptr if it may not be absorbed
+        using Definitions = std::function<const TensorEquation*(const std::string&)>;
+
+        /**
+         * @brief Recognize the chain whose weighted sum is @p output
+         * @param definition Equations the chain may absorb, looked up by tensor name
+         * @return nullopt unless @p output ends an attention chain
+         */
+        static std::optional<FusedAttention> match(const TensorEquation& output, const Definitions& definition);
+
+        /**
+         * @brief Absorbed tensors, each with the tensor whose equation reads it
+         *
+         * The weights come first; their reader is the output.
+         */
+        const std::vector<std::pair<std::string, std::string>>& absorbed() const { return absorbed_; }
+
+        /**
+         * @brief Tensors the chain reads from the environment
+         */
+        const std::vector<std::string>& inputs() const { return inputs_; }
+
+        /**
+         * @brief Whether the score is a scaled contraction that runs as SDPA
+         */
+        bool usesSdpa() const { return sdpa_.has_value(); }
+
+        /**
+         * @brief Compute the output, laid out like the output equation's LHS
+         * @return An undefined tensor if the inputs do not fit the kernel
+         *         (unbound, sparse, non-floating or mismatched extents); the
+         *         caller then runs the equations one by one
+         */
+        Tensor evaluate(const Environment& env, const DTypePolicy& policy) const;
+
+        /**
+         * @brief Turn fusion on or off process-wide (on by default)
+         */
+        static void setEnabled(bool enabled);
+        static bool enabled();
+
+    private:
+        enum class Op : uint8_t {
+            Product, Ref, Scalar, Const,
+            Add, Sub, Mul, Div, Pow, Neg,
+            Sqrt, Abs, Exp, Log, Tanh, Sigmoid, Relu
+        };
+
+        /// Instruction k writes register k; operands name earlier registers
+        struct Instr {
+            Op op;
+            uint32_t a{0};
+            uint32_t b{0};
+            float value{0.0f};       // Const only
+            std::string name;        // Ref and Scalar
+            std::vector<int> axes;   // Ref: canonical axis of each dimension
+        };
+
+        /// A tensor of the contraction or the weighted sum, with the canonical axis of each dimension
+        struct Operand {
+            std::string name;
+            std::vector<int> axes;
+        };
+
+        /// Registers of a score `scale * contraction + mask` (see usesSdpa)
+        struct Sdpa {
+            int scale{-1};     // Const or Scalar register, -1 for none
+            bool divide{false};
+            int mask{-1};      // Ref register, -1 for none
+        };
+
+        // Canonical axes: batch indices 0..B-1, then query B, key B+1, and B+2
+        // for the contracted index of query and key and the value index
+        int batch_{0};
+        Operand query_, key_, value_;
+        std::vector<int> output_axes_;
+        std::vector<Instr> code_;
+        std::optional<Sdpa> sdpa_;
+        std::vector<std::pair<std::string, std::string>> absorbed_;
+        std::vector<std::string> inputs_;
+        std::vector<std::string> index_names_;  // every index variable of the chain
+
+        struct Scope;
+        bool build(const TensorEquation& output, const std::vector<std::string>& out,
+                   const TensorRef& weightsRef, const TensorRef& valueRef,
+                   const TensorEquation& weights, const Definitions& definition);
+        std::optional<uint32_t> emit(const ExprPtr& ep, const Scope& scope, const Definitions& definition,
+                                     const std::string& reader, int depth);
+        bool emitProduct(const TensorRef& a, const TensorRef& b, const Scope& scope);
+        uint32_t push(Instr instr);
+        void findSdpa();
+        Tensor scores(const Tensor& product, const std::vector<Tensor>& refs, int64_t first, int64_t rows) const;
+    };
+
+} // namespace tl
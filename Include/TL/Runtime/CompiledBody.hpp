@@ -0,0 +1,132 @@
+#pragma once
+
+#include "TL/AST.hpp"
+#include "TL/Runtime/RelationStore.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tl {
+
+/**
+ * @brief Slot-based code for the terms and comparisons of a Datalog body
+ *
+ * Compiling a rule (or conjunctive query) numbers its variables, so a
+ * binding is a flat vector of symbol IDs indexed by slot instead of a map
+ * keyed by name. Arithmetic terms and comparison operands become small
+ * expression trees over slots and pre-parsed literals, and the numeric
+ * value of every symbol is cached by the SymbolTable, so evaluating them
+ * during a join neither parses nor allocates.
+ */
+class CompiledBody {
+public:
+    /// Variable values by slot; kUnbound marks a free variable
+    using Slots = std::vector<SymbolId>;
+    static constexpr SymbolId kUnbound = static_cast<SymbolId>(-1);
+
+    /// One atom term: a constant, a variable slot or an expression root node
+    struct Term {
+        enum class Kind : uint8_t { Constant, Variable, Expression };
+        Kind kind{Kind::Constant};
+        uint32_t index{0};  // slot for Variable, node for Expression
+    };
+
+    /// Result of evaluating an expression
+    struct Value {
+        double number{0.0};
+        bool numeric{false};
+        SymbolId symbol{kUnbound};         // set when the value is a bound variable
+        const std::string* text{nullptr};  // nullptr for computed numbers
+    };
+
+    /// Buffer large enough for text() of a computed number
+    using NumberBuffer = char[32];
+
+    /**
+     * @brief Compile a body and, for rules, its head
+     * @param atoms Positive atoms in source order
+     * @param negations Negated atoms in source order
+     * @param conditions Comparisons in source order
+     * @param head Head atom, or nullptr for queries
+     */
+    static CompiledBody compile(const std::vector<const DatalogAtom*>& atoms,
+                                const std::vector<const DatalogAtom*>& negations,
+                                const std::vector<const DatalogCondition*>& conditions,
+                                const DatalogAtom* head);
+
+    /**
+     * @brief Compile the body and head of a rule
+     */
+    static CompiledBody compile(const DatalogRule& rule);
+
+    size_t slotCount() const { return slot_names_.size(); }
+    const std::string& slotName(uint32_t slot) const { return slot_names_[slot]; }
+
+    /**
+     * @brief Slot of a variable
+     * @return -1 if the body does not mention it
+     */
+    int slotOf(const std::string& name) const;
+
+    const std::vector<Term>& atomTerms(size_t atom) const { return atoms_[atom]; }
+    const std::vector<Term>& negationTerms(size_t negation) const { return negations_[negation]; }
+    const std::vector<Term>& headTerms() const { return head_; }
+
+    /**
+     * @brief Evaluate an expression term under a binding
+     * @return false if a variable is unbound, an operand of arithmetic is not
+     *         numeric, a division is by zero or the expression is unsupported
+     */
+    bool evaluate(const Term& term, const Slots& slots, const SymbolTable& symbols, Value& out) const {
+        return evalNode(term.index, slots, symbols, out);
+    }
+
+    /**
+     * @brief Evaluate comparison @p condition (index in source order)
+     *
+     * == and != compare text unless both sides are numeric; ordering
+     * comparisons are numeric when both sides are, textual otherwise.
+     */
+    bool testCondition(size_t condition, const Slots& slots, const SymbolTable& symbols) const;
+
+    /**
+     * @brief Text of a value; computed numbers are formatted like `std::ostream << double`
+     */
+    static std::string_view text(const Value& value, NumberBuffer& buffer);
+
+private:
+    struct Node {
+        enum class Op : uint8_t { Literal, Slot, Add, Sub, Mul, Div, Invalid };
+        Op op{Op::Invalid};
+        uint32_t lhs{0};  // literal index, slot, or left child
+        uint32_t rhs{0};  // right child
+    };
+    struct Literal {
+        std::string text;
+        double number{0.0};
+        bool numeric{false};
+    };
+    struct Condition {
+        enum class Cmp : uint8_t { Eq, Ne, Gt, Lt, Ge, Le, Invalid };
+        Cmp cmp{Cmp::Invalid};
+        uint32_t lhs{0};
+        uint32_t rhs{0};
+    };
+
+    uint32_t slotFor(const std::string& name);
+    uint32_t compileExpr(const ExprPtr& expr);
+    std::vector<Term> compileAtom(const DatalogAtom& atom);
+    bool evalNode(uint32_t node, const Slots& slots, const SymbolTable& symbols, Value& out) const;
+
+    std::vector<std::string> slot_names_;
+    std::vector<Node> nodes_;
+    std::vector<Literal> literals_;
+    std::vector<std::vector<Term>> atoms_;
+    std::vector<std::vector<Term>> negations_;
+    std::vector<Condition> conditions_;
+    std::vector<Term> head_;
+};
+
+} // namespace tl
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "TL/AST.hpp"
+#include "TL/backend.hpp"
+#include "TL/Runtime/AttentionFusion.hpp"
+#include "TL/Runtime/Executor.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tl {
+
+class Environment;
+class PreprocessorRegistry;
+class TensorLogicVM;
+
+/**
+ * @brief A Program lowered into a flat instruction list that can be run repeatedly
+ *
+ * Compiling does the per-program work of TensorLogicVM::execute once:
+ * statements are classified (plain, preprocessed, virtual-indexed batch,
+ * query) and put into execution order, and every tensor name the program
+ * reads or writes gets a slot number.
+ *
+ * Work that depends on the environment stays at run time. Statements a
+ * preprocessor claims are expanded on every run, because the expansion
+ * reads tensor shapes. The executor of a plain equation is chosen on the
+ * first run and reused while Environment::layoutVersion() is unchanged,
+ * since executor selection only depends on which tensors and labels exist.
+ *
+ * A plan keeps its own copy of the program and may outlive the VM that
+ * compiled it; cached executors are dropped when a different VM runs it.
+ * Copies of a plan share the program, so copying one per request (see
+ * Model) costs the instruction list, not the syntax tree.
+ */
+class CompiledProgram {
+public:
+    enum class Opcode {
+        Equation,      ///< Tensor equation with a reusable executor choice
+        Expand,        ///< Statement run through the preprocessor chain first
+        FixedPoint,    ///< Fixed-point loop over one equation
+        Fact,          ///< Datalog fact
+        Rule,          ///< Datalog rule
+        File,          ///< Tensor file read or write
+        VirtualBatch,  ///< All equations with virtual LHS indices, expanded together
+        Query          ///< Query (saturates Datalog rules first)
+    };
+
+    struct Instruction {
+        Opcode op;
+        BackendType backend;
+        size_t statement;           ///< Index into program().statements (unused for VirtualBatch)
+        std::vector<int> operands;  ///< Slots of the tensors the statement reads
+        int result{-1};             ///< Slot of the tensor it writes, -1 if none or several
+    };
+
+    /// An attention chain run as one kernel by the instruction that ends it
+    struct AttentionGroup {
+        FusedAttention kernel;
+        std::vector<size_t> members;  ///< Instructions of the scores and weights, in order
+    };
+
+    CompiledProgram() = default;
+
+    /**
+     * @brief Lower a program
+     * @param program The program (copied into the plan)
+     * @param preprocessors Decides which statements need expansion at run time
+     * @param env Environment the plan is compiled against
+     */
+    static CompiledProgram compile(const Program& program,
+                                   const PreprocessorRegistry& preprocessors,
+                                   const Environment& env);
+
+    /**
+     * @brief The program the plan was compiled from
+     */
+    const Program& program() const { return *program_; }
+
+    /**
+     * @brief Instructions in execution order
+     */
+    const std::vector<Instruction>& instructions() const { return instructions_; }
+
+    /**
+     * @brief Statements with virtual LHS indices, in source order
+     */
+    const std::vector<Statement>& virtualStatements() const { return virtual_statements_; }
+
+    /**
+     * @brief Tensor name of every slot
+     */
+    const std::vector<std::string>& slots() const { return slot_names_; }
+
+    /**
+     * @brief Slot of a tensor name, or -1 if the program does not mention it
+     */
+    int slotOf(const std::string& name) const;
+
+    /**
+     * @brief Whether instruction k contributes to an output of the program
+     *
+     * Outputs are queries and file writes. Liveness runs backward from them
+     * through the tensors that equations read and, independent of source
+     * order, through the relations that Datalog rules read. Equations using
+     * labels stay live, since skipping them would renumber later labels, and
+     * under a training directive so do list literals, which training may
+     * pick as parameters. Decided from names alone when compiling.
+     */
+    bool live(size_t k) const { return live_[k]; }
+
+    /**
+     * @brief Number of instructions that contribute to no output
+     */
+    size_t deadInstructions() const;
+
+    /**
+     * @brief Slots of tensors nothing uses after instruction k
+     *
+     * Tensors the program writes whose last read or write is instruction k,
+     * except query targets and tensors in Datalog conditions, which rules
+     * read whenever a query saturates them. The VM can drop these from the
+     * environment once k has run, so intermediates do not stay alive until
+     * the program ends. Empty under a training directive, which replays the
+     * program from the values it left.
+     */
+    const std::vector<int>& releasedAfter(size_t k) const { return released_after_[k]; }
+
+    /**
+     * @brief Attention chain that instruction k ends, or nullptr
+     *
+     * Found when compiling (see FusedAttention): the weights and the score
+     * tensors they are computed from are written once, read once along the
+     * chain and by no query, Datalog condition or file write, and what the
+     * chain reads is not rebound between its first instruction and k. The
+     * VM fuses the chain when it releases intermediates, which would drop
+     * the absorbed tensors anyway; releases of the chain's inputs wait for
+     * k. None under a training directive.
+     */
+    const AttentionGroup* attentionAt(size_t k) const;
+
+    /**
+     * @brief Instruction whose attention chain absorbs instruction k, or -1
+     */
+    int fusedInto(size_t k) const { return fused_into_[k]; }
+
+    /**
+     * @brief How many times an executor was chosen through the registry
+     *
+     * Grows only on a first run or after new tensors or labels appeared.
+     */
+    size_t executorSelections() const { return executor_selections_; }
+
+private:
+    friend class TensorLogicVM;
+
+    /// Executor chosen for an Equation instruction and the layout it was chosen under
+    struct CachedExecutor {
+        TensorEquationExecutor* executor{nullptr};
+        uint64_t layoutVersion{0};
+    };
+
+    int internSlot(const std::string& name);
+    void collectOperands(const Expr& expr, std::vector<int>& out);
+    int collectOperands(const TensorEquation& eq, std::vector<int>& out);  // returns the LHS slot
+    void computeLiveness();
+    void computeReleases();
+    void findAttention();
+
+    std::shared_ptr<const Program> program_{std::make_shared<const Program>()};
+    std::vector<Instruction> instructions_;
+    std::vector<Statement> virtual_statements_;
+    std::vector<std::string> slot_names_;
+    std::unordered_map<std::string, int> slot_of_;
+    std::vector<bool> live_;  // parallel to instructions_
+    std::vector<std::vector<int>> released_after_;  // parallel to instructions_
+    std::vector<AttentionGroup> attention_;
+    std::vector<int> attention_of_;  // parallel to instructions_: index into attention_, -1 if none
+    std::vector<int> fused_into_;    // parallel to instructions_
+
+    // Run-time state, owned by the VM that last executed the plan
+    const TensorLogicVM* owner_{nullptr};
+    std::vector<CachedExecutor> executors_;  // parallel to instructions_
+    size_t executor_selections_{0};
+};
+
+} // namespace tl
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "TL/core.hpp"
+#include <string>
+
+namespace tl {
+
+    /**
+     * @brief Element types used for stored values, contractions and masks
+     *
+     * The default policy keeps everything in float32, as before. Mixed
+     * policies run einsum operands in bf16/fp16 while results come back in
+     * float32: LibTorch's reduced-precision GEMM and reduction kernels already
+     * accumulate in fp32, so widening the result keeps later sums in fp32 too.
+     * Storage policies additionally keep bound tensors in the reduced type.
+     *
+     * Relation tensors of tensorized Datalog and guard masks use `mask`,
+     * which may be kBool or kUInt8 to store one byte per cell.
+     */
+    struct DTypePolicy {
+        torch::ScalarType value{torch::kFloat32};       ///< Floating tensors bound in the environment
+        torch::ScalarType compute{torch::kFloat32};     ///< Einsum operands
+        torch::ScalarType accumulate{torch::kFloat32};  ///< Einsum results
+        torch::ScalarType mask{torch::kFloat32};        ///< Relation tensors and Boolean masks
+
+        /**
+         * @brief Parse a preset or a comma-separated list of overrides
+         *
+         * Presets: "fp32", "mixed-bf16", "mixed-fp16" (reduced compute, fp32
+         * values), "bf16", "fp16" (reduced compute and values). Mixed and
+         * reduced presets store masks as bool. Overrides such as
+         * "mixed-bf16,mask=uint8" or "compute=fp16" refine the preceding
+         * preset (fp32 if none).
+         * @throws std::invalid_argument for unknown names or types
+         */
+        static DTypePolicy parse(const std::string& spec);
+
+        /**
+         * @brief Type a floating or Boolean tensor is stored as
+         *
+         * Floating tensors become `value`; Boolean tensors keep a compact mask
+         * type if the policy has one and become `value` otherwise. Integer
+         * tensors are indices and are left alone.
+         */
+        torch::ScalarType storageFor(torch::ScalarType type) const;
+
+        /**
+         * @brief Cast a tensor to its storage type (no copy if it already is)
+         */
+        Tensor normalize(const Tensor& t) const;
+
+        /**
+         * @brief Einsum operand in the compute type; non-floating operands
+         *        (such as masks) are cast too, since einsum needs numbers
+         */
+        Tensor toCompute(const Tensor& t) const;
+
+        /**
+         * @brief Whether contractions run in a different type than they return
+         */
+        bool mixed() const { return compute != accumulate; }
+
+        bool operator==(const DTypePolicy& other) const;
+        bool operator!=(const DTypePolicy& other) const { return !(*this == other); }
+
+        /// Short description such as "value=fp32,compute=bf16,accumulate=fp32,mask=bool"
+        std::string str() const;
+    };
+
+} // namespace tl
@@ -1,14 +1,27 @@
 #pragma once
 
 #include "TL/AST.hpp"
+#include "TL/Log.hpp"
+#include "TL/Runtime/CompiledBody.hpp"
+#include "TL/Runtime/QueryResult.hpp"
+#include "TL/Runtime/RelationStore.hpp"
+#include "TL/Runtime/ThreadPool.hpp"
+#include <chrono>
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <map>
+#include <utility>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <optional>
 
 namespace tl {
 
+class TensorBackend;
+class Profiler;
+
 // Forward declarations
 class Environment;
 
@@ -40,9 +53,19 @@ public:
      */
     bool addFact(const DatalogFact& fact);
 
+    /**
+     * @brief Add tuples of interned constants in bulk
+     * @param tuples count tuples of arity symbol IDs, packed row-major
+     * @return Number of tuples that were new
+     * @throws std::runtime_error if the relation has a different arity
+     */
+    size_t addFacts(const std::string& relation, size_t arity, const SymbolId* tuples, size_t count);
+
     /**
      * @brief Register a Datalog rule for forward chaining
      * @param rule The rule to register
+     * @throws std::runtime_error if the rule makes a relation depend on its
+     *         own negation (the rule is not registered in that case)
      */
     void addRule(const DatalogRule& rule);
 
@@ -54,11 +77,100 @@ public:
     /**
      * @brief Run forward chaining to fixpoint
      *
-     * Applies all rules iteratively until no new facts are derived.
-     * Only runs if closure_dirty_ flag is set.
+     * Rules are grouped into strata, the strongly connected components of
+     * the predicate dependency graph, and the strata are saturated one
+     * after another in dependency order. A stratum whose rules do not read
+     * its own relations is applied once; a recursive stratum runs its own
+     * fixpoint loop. Relations under a negation are therefore complete
+     * before any rule negating them runs. Only runs if closure_dirty_ flag
+     * is set. Uses semi-naive evaluation unless it has been disabled with
+     * setSemiNaive(false).
+     *
+     * Semi-naive saturation is incremental: the closure computed last time
+     * is kept, and only the facts added since then are seeded as the first
+     * delta, so a small batch of facts costs work proportional to its
+     * consequences. Rules registered since the last saturation are still
+     * joined over all facts. Derived facts are never retracted, also when
+     * a negated relation grows.
      */
     void saturate();
 
+    /**
+     * @brief Select semi-naive (default) or naive fixpoint evaluation
+     *
+     * Semi-naive evaluation only joins rule variants in which at least one
+     * body atom reads the facts derived in the previous round. The naive
+     * loop re-runs every rule over the full database each round and is kept
+     * for comparing results.
+     */
+    void setSemiNaive(bool enabled) { semi_naive_ = enabled; }
+
+    /**
+     * @brief Check if semi-naive evaluation is enabled
+     */
+    bool semiNaive() const { return semi_naive_; }
+
+    /**
+     * @brief Set the number of threads used by semi-naive saturation
+     * @param threads 0 = the process-wide ThreadPool::shared() (default),
+     *        1 = sequential, more = a private pool of that size
+     *
+     * The rule variants of a round, and slices of their outermost join
+     * atom, are evaluated concurrently against the frozen round snapshot.
+     * Each task buffers its head tuples, and the buffers are merged and
+     * deduplicated in task order when the round ends, so the derived facts
+     * and their order do not depend on thread scheduling. Negated atoms only
+     * see facts from earlier rounds while a round runs in parallel. Rounds
+     * with fewer than kParallelMinRows outer rows run sequentially.
+     */
+    void setNumThreads(size_t threads);
+
+    /**
+     * @brief Configured thread count (0 = shared pool)
+     */
+    size_t numThreads() const { return num_threads_; }
+
+    /**
+     * @brief Saturate over hash-partitioned relations (1 = off, the default)
+     *
+     * With more than one partition, saturate() hands the strata to a
+     * PartitionedDatalog, which saturates them in parallel: relations are
+     * split on the join key of the rules reading them, each partition runs
+     * the semi-naive rounds on its own tuples, and derived tuples are
+     * exchanged between rounds. The derived facts are added back to the
+     * environment. A stratum with a rule whose body atoms share no
+     * variable is saturated here instead, as without partitions, and the
+     * strata after it see its facts. Partitioned strata start over from
+     * all facts at every saturation and ignore tensor mode. Partitions run
+     * on the pool selected by setNumThreads().
+     */
+    void setPartitions(size_t partitions) { partitions_ = partitions; }
+
+    /**
+     * @brief Configured number of partitions
+     */
+    size_t partitions() const { return partitions_; }
+
+    /**
+     * @brief Backend used by tensor mode (not owned; nullptr disables tensor mode)
+     */
+    void setTensorBackend(TensorBackend* backend) { tensor_backend_ = backend; }
+
+    /**
+     * @brief Evaluate eligible strata as einsums over Boolean tensors
+     *
+     * A stratum whose rules are all pure conjunctions of variable-only atoms
+     * (see TensorDatalog) and whose relations fit in dense tensors over the
+     * current symbol domain is saturated with the tensor backend instead of
+     * tuple joins. Other strata are evaluated as usual. Off by default.
+     */
+    void setTensorMode(bool enabled) { tensor_mode_ = enabled; }
+
+    /**
+     * @brief Check if tensor mode is enabled
+     */
+    bool tensorMode() const { return tensor_mode_; }
+
     /**
      * @brief Check if saturation is needed
      * @return true if new facts/rules have been added since last saturation
@@ -66,15 +178,102 @@ public:
     bool needsSaturation() const { return closure_dirty_; }
 
     /**
-     * @brief Execute a Datalog or tensor query
+     * @brief Rules of an engine and the status of their closure, as kept by snapshots
+     *
+     * `closure` holds the rows of each relation the last saturation
+     * covered. Rows are never reordered, so once the relations are restored
+     * with their rows in order, the next saturation resumes incrementally
+     * from the facts added since, exactly as it would have before.
+     */
+    struct State {
+        std::vector<DatalogRule> rules;
+        std::vector<std::pair<std::string, size_t>> closure;
+        size_t closureRules{0};  // rules [0, closureRules) were applied by the last saturation
+        bool dirty{false};       // see needsSaturation()
+    };
+
+    /**
+     * @brief Current rules and closure status
+     */
+    State state() const;
+
+    /**
+     * @brief Replace the rules and closure status with a saved State
+     *
+     * The relations the closure covers must already hold their rows.
+     * @throws std::runtime_error if the rules make a relation depend on its
+     *         own negation (the engine is unchanged in that case)
+     */
+    void restore(const State& state);
+
+    /**
+     * @brief Total time spent saturating rules so far (for benchmarks)
+     */
+    std::chrono::nanoseconds saturationTime() const { return saturation_time_; }
+
+    /**
+     * @brief Report saturations and per-rule work to a profiler (not owned; nullptr disables)
+     *
+     * Each stratum's saturation becomes a span. Per rule, the profiler
+     * counts the variants joined, the body bindings that reached the head
+     * and the new facts they derived; strata evaluated as tensors only
+     * report their span.
+     */
+    void setProfiler(Profiler* profiler) { profiler_ = profiler; }
+
+    /**
+     * @brief Execute a Datalog query and print its answers
      * @param query The query to execute
      * @param out Output stream for results
      *
-     * For Datalog queries, performs join evaluation with conditions.
-     * For tensor queries, delegates to VM (via callback if needed).
+     * Prints answer() with query_io::writeText.
      */
     void query(const Query& query, std::ostream& out);
 
+    /**
+     * @brief Answers of a Datalog query as columns of symbol IDs
+     *
+     * Evaluates conjunctive queries with negations and conditions by join.
+     * Does not saturate first. With @limit(n=N) or @exists() the join stops
+     * once it has found enough answers; they are the first ones in join
+     * order, which need not be the first N of the full answer.
+     * @throws std::runtime_error for tensor queries, which the VM answers
+     * @throws std::invalid_argument for @topk, which ranks tensors
+     */
+    QueryResult answer(const Query& query);
+
+    /**
+     * @brief Answer a Datalog query over the closure of the rules
+     *
+     * Saturates first, unless demand-driven evaluation applies to the
+     * query (see setDemandDriven).
+     * @throws std::runtime_error for tensor queries, which the VM answers
+     */
+    QueryResult solve(const Query& query);
+
+    /**
+     * @brief Let solve() derive only the facts a query depends on (off by default)
+     *
+     * While the closure is not materialized, a single-atom query with
+     * constant arguments, such as Ancestor(Alice, x)?, is answered by a
+     * magic-set rewrite of the rules that reach its relation: each derived
+     * relation is adorned with the arguments bound when it is read (left to
+     * right through rule bodies), and magic relations carry the bound
+     * values down, so joins only visit facts reachable from the query's
+     * constants. The rewritten relations are scratch relations, dropped
+     * once the query is answered; the closure stays unsaturated.
+     *
+     * Queries without constants, conjunctive queries, and queries whose
+     * rules negate a derived relation or compute a bound argument still
+     * saturate, as does every query once the closure is materialized.
+     */
+    void setDemandDriven(bool enabled) { demand_driven_ = enabled; }
+
+    /**
+     * @brief Check if demand-driven evaluation is enabled
+     */
+    bool demandDriven() const { return demand_driven_; }
+
     /**
      * @brief Enable or disable debug logging
      */
@@ -86,57 +285,307 @@ public:
     bool debug() const { return debug_; }
 
 private:
+    /**
+     * @brief Tuple window of a relation for one evaluation round
+     *
+     * Tuples [0, deltaBegin) were known before the previous round and tuples
+     * [deltaBegin, deltaEnd) were derived by it. Tuples appended past
+     * deltaEnd during the current round are not visible until the next one.
+     */
+    struct RelationWindow {
+        size_t deltaBegin{0};
+        size_t deltaEnd{0};
+    };
+    using RoundSnapshot = std::unordered_map<std::string, RelationWindow>;
+
+    /**
+     * @brief Rules of one strongly connected component of the dependency graph
+     */
+    struct Stratum {
+        std::vector<size_t> rules;     // indices into rules_, in registration order
+        std::vector<std::string> heads;  // relations the stratum derives
+        bool recursive{false};         // some rule reads a relation of this stratum
+    };
+
+    /// Marker for answerDatalogQuery: every answer is wanted
+    static constexpr size_t kNoLimit = static_cast<size_t>(-1);
+
+    /// Marker for applyRule: every body atom reads its full window
+    static constexpr size_t kNoDeltaAtom = static_cast<size_t>(-1);
+
+    /// Symbol ID bound to each variable slot of a CompiledBody
+    using Binding = CompiledBody::Slots;
+
+    /// Symbol ID of a constant that was never interned (matches no tuple)
+    static constexpr SymbolId kUnknownSymbol = static_cast<SymbolId>(-1);
+    static_assert(kUnknownSymbol == CompiledBody::kUnbound, "unbound slots must never match a tuple");
+
+    /**
+     * @brief Body atom resolved against the store for one evaluation
+     *
+     * Holds the relation the atom reads (nullptr if it has no facts yet),
+     * the symbol IDs of its constant terms and its compiled terms, so
+     * matching a tuple only compares integers.
+     */
+    struct ResolvedAtom {
+        const DatalogAtom* atom{nullptr};
+        const Relation* relation{nullptr};
+        std::vector<SymbolId> constants;  // per term, kUnknownSymbol unless a StringLiteral
+        const CompiledBody* code{nullptr};
+        const std::vector<CompiledBody::Term>* terms{nullptr};
+    };
+
+    /**
+     * @brief Join order chosen for a rule body or conjunctive query
+     *
+     * Positive atoms (indices in source order) are joined in `order`.
+     * atomMasks[s] holds the columns of atom order[s] that are bound when
+     * it is probed. conditionsAt[s] / negationsAt[s] list the filters
+     * checked before join step s, i.e. once every variable they share with
+     * the positive atoms is bound; index order.size() is the leaf of the
+     * join. negationMasks[g] holds the bound columns of negation g there.
+     */
+    struct JoinPlan {
+        std::vector<size_t> order;
+        std::vector<Relation::ColumnMask> atomMasks;
+        std::vector<std::vector<size_t>> conditionsAt;
+        std::vector<std::vector<size_t>> negationsAt;
+        std::vector<Relation::ColumnMask> negationMasks;
+    };
+
+    /**
+     * @brief One rule variant of a round, resolved against the store and planned
+     */
+    struct RuleVariant {
+        const DatalogRule* rule{nullptr};
+        const CompiledBody* code{nullptr};
+        std::vector<ResolvedAtom> atoms;
+        std::vector<ResolvedAtom> negations;
+        std::vector<const DatalogCondition*> conditions;
+        std::vector<std::pair<size_t, size_t>> windows;  // rows each atom reads
+        std::vector<SymbolId> headConstants;             // per head term (StringLiterals)
+        const Relation* headRelation{nullptr};           // nullptr until it has facts
+        const JoinPlan* plan{nullptr};
+    };
+
+    /**
+     * @brief Head tuples derived by one parallel task
+     *
+     * Values that were not interned yet are kept in `pending` and stored
+     * as kPendingSymbol | index until the end-of-round merge interns them,
+     * which keeps the symbol table read-only while tasks run.
+     */
+    struct DerivedTuples {
+        size_t count{0};
+        std::vector<SymbolId> values;  // count tuples of head arity, packed
+        std::vector<std::string> pending;
+    };
+
+    /// Tag for not-yet-interned values in DerivedTuples (symbol IDs stay below 2^31)
+    static constexpr SymbolId kPendingSymbol = SymbolId{1} << 31;
+
+    /// Rounds with fewer outer-atom rows than this are evaluated sequentially
+    static constexpr size_t kParallelMinRows = 4096;
+
+    /// Outer-atom rows per parallel task
+    static constexpr size_t kRowsPerTask = 1024;
+
     Environment& env_;
     std::ostream* output_stream_;
     std::vector<DatalogRule> rules_;
+    std::vector<CompiledBody> compiled_;  // per rule, built by addRule
+    std::vector<Stratum> strata_;  // in evaluation order, rebuilt by addRule
+    // Relation sizes covered by the last completed saturation, and how many
+    // of rules_ it applied; later facts seed the next semi-naive run
+    RoundSnapshot closure_;
+    size_t closure_rules_{0};
+    // Plans per (rule, delta atom), reset at the start of every saturation
+    std::map<std::pair<const DatalogRule*, size_t>, JoinPlan> plan_cache_;
     bool closure_dirty_{false};
+    bool semi_naive_{true};
     bool debug_{false};
+    size_t num_threads_{0};
+    std::shared_ptr<ThreadPool> pool_;  // obtained on every parallel round
+    TensorBackend* tensor_backend_{nullptr};
+    bool tensor_mode_{false};
+    bool demand_driven_{false};
+    size_t partitions_{1};
+    std::chrono::nanoseconds saturation_time_{0};
+    Profiler* profiler_{nullptr};
+
+    /**
+     * @brief Split rules_ into strata in dependency order
+     * @return The strata, or throws std::runtime_error if some relation
+     *         depends negatively on itself
+     */
+    std::vector<Stratum> computeStrata() const;
+
+    /**
+     * @brief Saturate the partitionable strata with a PartitionedDatalog, the others here (see setPartitions)
+     */
+    void saturatePartitioned();
+
+    /**
+     * @brief Saturate a stratum with TensorDatalog if tensor mode allows it
+     * @return true if the stratum was evaluated; sets rounds
+     */
+    bool saturateWithTensors(const Stratum& stratum, size_t& rounds);
+
+    /**
+     * @brief Naive fixpoint: run the stratum's rules over all facts until nothing changes
+     * @return Number of evaluation rounds
+     */
+    size_t saturateNaive(const Stratum& stratum);
+
+    /**
+     * @brief Semi-naive fixpoint driven by per-relation deltas
+     * @return Number of evaluation rounds
+     *
+     * The first round reads the facts added since closure_ as delta.
+     */
+    size_t saturateSemiNaive(const Stratum& stratum);
+
+    /**
+     * @brief Prepare one variant per positive body atom whose relation has a delta
+     */
+    void addDeltaVariants(size_t ruleIndex,
+                          const RoundSnapshot& snapshot,
+                          std::vector<RuleVariant>& variants);
+
+    /**
+     * @brief Capture the tuple windows of all relations
+     * @param previous Windows of the previous round, or nullptr to mark
+     *                 every known tuple as delta
+     */
+    RoundSnapshot snapshotRelations(const RoundSnapshot* previous) const;
 
     /**
      * @brief Apply a single rule once, deriving new facts
-     * @param rule The rule to apply
+     * @param ruleIndex Index of the rule in rules_
+     * @param snapshot Tuple windows visible to this round
+     * @param deltaAtom Index of the positive body atom restricted to the delta
+     *                  (atoms before it read old tuples only, atoms after it read
+     *                  old and delta tuples), or kNoDeltaAtom to join over
+     *                  everything in the snapshot
      * @return Number of new facts derived
      */
-    size_t applyRule(const DatalogRule& rule);
+    size_t applyRule(size_t ruleIndex, const RoundSnapshot& snapshot, size_t deltaAtom);
 
     /**
-     * @brief Execute a Datalog atom query
-     * @param atom The query atom
-     * @param body Additional atoms/conditions for conjunctive queries
-     * @param out Output stream
+     * @brief Resolve, window and plan one rule variant (see applyRule)
+     * @return false if the variant cannot derive anything this round
+     *
+     * Also builds every index the plan probes, so evaluation never
+     * mutates shared state except through its output.
      */
-    void execDatalogQuery(const DatalogAtom& atom,
-                          const std::vector<std::variant<DatalogAtom, DatalogNegation, DatalogCondition>>& body,
-                          std::ostream& out);
+    bool prepareVariant(size_t ruleIndex,
+                        const RoundSnapshot& snapshot,
+                        size_t deltaAtom,
+                        RuleVariant& variant);
 
     /**
-     * @brief Evaluate expression in Datalog context
-     * @param expr Expression to evaluate
+     * @brief Join a prepared variant and emit its head tuples
+     * @param variant Prepared variant
+     * @param outerBegin First row of the outermost join atom to visit
+     * @param outerEnd One past the last row of the outermost join atom
+     * @param buffer If null, new facts are inserted right away; otherwise
+     *               head tuples are appended to it for a later merge
+     * @return Number of facts inserted (always 0 when buffering)
+     */
+    size_t evaluateVariant(const RuleVariant& variant,
+                           size_t outerBegin,
+                           size_t outerEnd,
+                           DerivedTuples* buffer);
+
+    /**
+     * @brief Evaluate all variants of a semi-naive round
+     * @return Number of new facts derived
+     */
+    size_t evaluateRound(const std::vector<RuleVariant>& variants);
+
+    /**
+     * @brief Resolve an atom's relation and constant terms to symbol IDs
+     * @param atom Atom to resolve
+     * @param code Compiled body the atom belongs to
+     * @param terms The atom's compiled terms in @p code
+     */
+    ResolvedAtom resolveAtom(const DatalogAtom& atom,
+                             const CompiledBody& code,
+                             const std::vector<CompiledBody::Term>& terms) const;
+
+    /**
+     * @brief Match a stored tuple against an atom under the current binding
+     * @param atom Resolved atom
+     * @param tuple Symbol IDs of the tuple (atom arity long)
      * @param binding Current variable bindings
-     * @param outStr Result as string
-     * @param outNum Result as number
-     * @param isNumeric Whether result is numeric
-     * @return true if evaluation succeeded
+     * @param assigned If non-null, unbound variables are bound and their
+     *                 slots appended here for rollback; if null they match
+     *                 any value and the binding is left unchanged
+     * @return true if the tuple matches
      */
-    bool evalExprBinding(const ExprPtr& expr,
-                        const std::unordered_map<std::string, std::string>& binding,
-                        std::string& outStr,
-                        double& outNum,
-                        bool& isNumeric) const;
+    bool matchTuple(const ResolvedAtom& atom,
+                    const SymbolId* tuple,
+                    Binding& binding,
+                    std::vector<uint32_t>* assigned) const;
 
     /**
-     * @brief Evaluate a condition (comparison)
-     * @param cond The condition to evaluate
+     * @brief Fill the index probe key of an atom under the current binding
+     * @param atom Resolved atom
      * @param binding Current variable bindings
-     * @return true if condition is satisfied
+     * @param mask Bound columns, as planned for this join step
+     * @param key Resized to the atom arity; the masked columns receive their symbol
+     */
+    void fillProbeKey(const ResolvedAtom& atom,
+                      const Binding& binding,
+                      Relation::ColumnMask mask,
+                      std::vector<SymbolId>& key) const;
+
+    /**
+     * @brief Choose a join order from cardinalities and bound-variable selectivity
+     * @param atoms Positive atoms in source order
+     * @param cardinalities Number of rows each atom reads
+     * @param negations Negated atoms
+     * @param conditions Comparison filters
+     * @return Greedy plan that joins the atom with the fewest expected rows
+     *         per partial binding first, and applies each filter as early as
+     *         its variables allow
+     */
+    JoinPlan planJoin(const std::vector<ResolvedAtom>& atoms,
+                      const std::vector<size_t>& cardinalities,
+                      const std::vector<ResolvedAtom>& negations,
+                      const std::vector<const DatalogCondition*>& conditions) const;
+
+    /**
+     * @brief Check whether any stored tuple matches an atom (used for negation)
+     * @param mask Columns bound at this point of the join
+     */
+    bool hasMatch(const ResolvedAtom& atom, Binding& binding, Relation::ColumnMask mask) const;
+
+    /**
+     * @brief Answer a Datalog atom query
+     * @param atom The query atom
+     * @param body Additional atoms/conditions for conjunctive queries
+     * @param limit Answers after which the evaluation stops
      */
-    bool evalCondition(const DatalogCondition& cond,
-                      const std::unordered_map<std::string, std::string>& binding) const;
+    QueryResult answerDatalogQuery(const DatalogAtom& atom,
+                                   const std::vector<std::variant<DatalogAtom, DatalogNegation, DatalogCondition>>& body,
+                                   size_t limit = kNoLimit);
+
+    /**
+     * @brief Answer a single-atom query by magic-set evaluation (see setDemandDriven)
+     * @return nullopt if the query or the rules reaching it need the full closure
+     */
+    std::optional<QueryResult> answerOnDemand(const Query& query);
 
     /**
      * @brief Log debug message
      */
     void debugLog(const std::string& msg) const;
+
+    /**
+     * @brief Whether messages of @p level are compiled in and debug output is on
+     */
+    bool logging(LogLevel level) const { return logCompiled(level) && debug_; }
 };
 
 } // namespace tl
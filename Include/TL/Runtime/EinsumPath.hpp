@@ -0,0 +1,104 @@
+#pragma once
+
+#include "TL/core.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tl {
+
+    /**
+     * @brief Pairwise contraction order for an einsum with three or more operands
+     *
+     * torch::einsum contracts its operands left to right, so the order in
+     * which a program writes the factors decides the FLOP count and the size
+     * of the intermediates. For `Q[h,i,d] K[h,j,d] V[h,j,e]` contracting K
+     * with V first never materializes the i-by-j score tensor.
+     *
+     * The plan is computed from the operand shapes only: every order is tried
+     * for up to kOptimalMaxOperands operands, larger contractions pick the
+     * cheapest pair greedily. Each step is a two-operand einsum, which torch
+     * runs as a (batched) matrix multiply.
+     */
+    class EinsumPath {
+    public:
+        /// Contractions with more operands than this are planned greedily
+        static constexpr size_t kOptimalMaxOperands = 5;
+
+        enum class Strategy { Optimal, Greedy };
+
+        /**
+         * @brief One pairwise contraction
+         *
+         * Operands lhs and rhs (lhs < rhs) of the working list are removed and
+         * the result is appended to its end.
+         */
+        struct Step {
+            size_t lhs;
+            size_t rhs;
+            std::string spec;  ///< Two-operand einsum spec
+        };
+
+        /**
+         * @brief Plan a contraction
+         * @param spec Einsum spec, explicit ("ij,jk->ik") or implicit ("ij,jk")
+         * @param shapes Sizes of each operand
+         * @return nullopt when there is nothing to plan: fewer than three
+         *         operands, ellipsis, or a spec torch should reject itself
+         */
+        static std::optional<EinsumPath> plan(const std::string& spec,
+                                              const std::vector<std::vector<int64_t>>& shapes);
+
+        /**
+         * @brief Run the steps on operands with the planned shapes
+         */
+        Tensor run(const std::vector<Tensor>& operands) const;
+
+        const std::vector<Step>& steps() const { return steps_; }
+        Strategy strategy() const { return strategy_; }
+
+        /// Multiply-adds of the chosen order
+        double cost() const { return cost_; }
+        /// Multiply-adds of the left-to-right order torch::einsum would use
+        double naiveCost() const { return naive_cost_; }
+
+    private:
+        std::vector<Step> steps_;
+        Strategy strategy_{Strategy::Optimal};
+        double cost_{0.0};
+        double naive_cost_{0.0};
+    };
+
+    /**
+     * @brief Thread-safe cache of contraction paths keyed by spec and operand shapes
+     */
+    class EinsumPathCache {
+    public:
+        explicit EinsumPathCache(size_t capacity = 1024) : capacity_(capacity) {}
+
+        /**
+         * @brief Path for the given operands, planned on first use
+         * @return nullptr when the einsum should be passed to torch unchanged
+         */
+        std::shared_ptr<const EinsumPath> get(const std::string& spec, const std::vector<Tensor>& operands);
+
+        size_t size() const;
+        size_t hits() const;
+        size_t misses() const;
+        void clear();
+
+    private:
+        mutable std::mutex mutex_;
+        // nullptr entries remember specs that need no plan
+        std::unordered_map<std::string, std::shared_ptr<const EinsumPath>> paths_;
+        size_t capacity_;
+        size_t hits_{0};
+        size_t misses_{0};
+    };
+
+} // namespace tl
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "TL/AST.hpp"
+#include "TL/core.hpp"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace tl {
+
+    /**
+     * @brief A maximal elementwise subtree of an expression, evaluated in one pass
+     *
+     * Arithmetic, comparisons, logical operators, negation and the pointwise
+     * functions (step, relu, sigmoid, tanh, exp, log, sqrt, abs and the
+     * trigonometric ones) are fused. Everything else - tensor references,
+     * products that may lower to einsum, softmax, list literals - becomes a
+     * leaf that the caller evaluates as before.
+     *
+     * evaluate() broadcasts the leaves and runs the whole subtree over blocks
+     * of elements, so `sigmoid(W[i,j] X[j] + b[i]) * 0.5` writes one output
+     * tensor instead of one per node. Leaves that are not dense CPU float32
+     * tensors, or that require gradients, take the unfused path: the same
+     * torch operations the ExpressionExecutor would issue, one per node.
+     */
+    class FusedElementwise {
+    public:
+        /**
+         * @brief Check whether a node is an operation the kernel can fuse
+         */
+        static bool fusible(const Expr& e);
+
+        /**
+         * @brief Collect the fusible subtree rooted at @p root
+         * @return nullopt unless the subtree has at least two operations
+         */
+        static std::optional<FusedElementwise> build(const ExprPtr& root);
+
+        /**
+         * @brief Leaf expressions in evaluation (left-to-right) order
+         */
+        const std::vector<ExprPtr>& leaves() const { return leaves_; }
+
+        /**
+         * @brief Number of fused operations (leaves and constants not counted)
+         */
+        size_t opCount() const;
+
+        /**
+         * @brief Evaluate the subtree from the values of its leaves
+         * @param inputs One tensor per leaf, in leaves() order
+         */
+        Tensor evaluate(const std::vector<Tensor>& inputs) const;
+
+        /**
+         * @brief Sum of the subtree's elements, accumulated block by block
+         *
+         * Equals torch::sum(evaluate(inputs)) without writing the broadcast
+         * result, so `Loss = (P[i] - T[i]) * (P[i] - T[i])` reads its
+         * inputs once and allocates nothing of their size. Blocks are summed
+         * in float and combined in double.
+         */
+        Tensor sum(const std::vector<Tensor>& inputs) const;
+
+        /**
+         * @brief Turn fusion on or off process-wide (on by default)
+         */
+        static void setEnabled(bool enabled);
+        static bool enabled();
+
+    private:
+        enum class Op : uint8_t {
+            Leaf, Const,
+            Add, Sub, Mul, Div, Mod, Pow,
+            Lt, Le, Gt, Ge, Eq, Ne, And, Or,
+            Neg, Not,
+            Step, Sqrt, Abs, Sigmoid, Tanh, Relu, Exp, Cos, Sin, Tan, Acos, Asin, Atan, Log
+        };
+
+        /// Instruction k writes register k; operands name earlier registers
+        struct Instr {
+            Op op;
+            uint32_t a{0};      // operand register, or the leaf index for Leaf
+            uint32_t b{0};
+            float value{0.0f};  // Const only
+        };
+
+        static bool callOp(const std::string& name, Op& out);
+        uint32_t emit(const ExprPtr& ep);
+        uint32_t push(Instr instr);
+        bool broadcastShape(const std::vector<Tensor>& inputs, std::vector<int64_t>& shape) const;
+        // Writes the result, or with total set only adds its elements up there
+        Tensor runFused(const std::vector<Tensor>& inputs, const std::vector<int64_t>& shape, double* total) const;
+        Tensor runUnfused(const std::vector<Tensor>& inputs) const;
+
+        std::vector<ExprPtr> leaves_;
+        std::vector<Instr> code_;
+    };
+
+} // namespace tl
@@ -2,29 +2,64 @@
 
 #include "TL/Runtime/Executor.hpp"
 #include "TL/Runtime/ExecutorUtils.hpp"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <algorithm>
 
 namespace tl {
 
+    /**
+     * @brief Per-executor dispatch and timing counters
+     */
+    struct ExecutorStats {
+        std::string name;
+        size_t selections{0};  ///< Chosen by scanning the canExecute chain
+        size_t cacheHits{0};   ///< Chosen from the dispatch cache
+        size_t executions{0};  ///< Calls to execute()
+        std::chrono::nanoseconds executeTime{0};  ///< Total time spent in execute()
+    };
+
     /**
      * @brief Registry for managing tensor equation executors
      *
-     * Uses the Chain of Responsibility pattern to find the appropriate executor
+     * Uses the Chain of Responsibility pattern to find the appropriate executor.
+     * The chosen executor is memoized per structural signature of the equation
+     * (see executor_utils::dispatchSignature), so the unrolled copies of one
+     * equation that differ only in numeric indices share a single scan. The
+     * cache is dropped whenever Environment::layoutVersion() changes, because
+     * canExecute only depends on which tensors and labels exist.
      */
     class ExecutorRegistry {
     public:
+        ExecutorRegistry() = default;
+
+        /**
+         * @brief Registry with the executors of `other`, shared rather than recreated
+         *
+         * Executors keep no state between calls, so the registries of
+         * concurrent VMs can share them. Counters start at zero and the
+         * dispatch cache empty.
+         */
+        ExecutorRegistry(const ExecutorRegistry& other);
+        ExecutorRegistry& operator=(const ExecutorRegistry&) = delete;
 
         /**
          * @brief Register an executor (takes ownership)
          */
         void registerExecutor(ExecutorPtr executor) {
-            executors_.push_back(std::move(executor));
+            entries_.push_back(Entry{std::move(executor), {}});
+            entries_.back().stats.name = entries_.back().executor->name();
             // Sort by priority
-            std::sort(executors_.begin(), executors_.end(),
-                [](const ExecutorPtr& a, const ExecutorPtr& b) {
-                    return a->priority() < b->priority();
+            std::stable_sort(entries_.begin(), entries_.end(),
+                [](const Entry& a, const Entry& b) {
+                    return a.executor->priority() < b.executor->priority();
                 });
+            dispatch_cache_.clear();
         }
 
         /**
@@ -32,24 +67,62 @@ namespace tl {
          * @throws ExecutionError if no executor can handle the equation
          */
         Tensor execute(const TensorEquation& eq, Environment& env, TensorBackend& backend) {
-            for (auto& executor : executors_) {
-                if (executor->canExecute(eq, env)) {
-                    if (debug_) {
-                        *err_ << "[ExecutorRegistry] Using " << executor->name() << std::endl;
-                    }
-                    return executor->execute(eq, env, backend);
-                }
-            }
-
-            throw ExecutionError("No executor found for equation: " + executor_utils::toString(eq));
+            return execute(select(eq, env), eq, env, backend);
+        }
+
+        /**
+         * @brief Execute an equation with an executor chosen earlier by select()
+         *
+         * Used by callers that keep their own executor choice (compiled
+         * plans); the call still shows up in the executor's statistics.
+         * Safe to call concurrently for different environments.
+         */
+        Tensor execute(TensorEquationExecutor& executor, const TensorEquation& eq,
+                       Environment& env, TensorBackend& backend);
+
+        /**
+         * @brief Find the executor that execute() would use, without running it
+         * @throws ExecutionError if no executor can handle the equation
+         */
+        TensorEquationExecutor& select(const TensorEquation& eq, const Environment& env);
+
+        /**
+         * @brief Counters of every executor, in priority order
+         */
+        std::vector<ExecutorStats> stats() const;
+
+        /**
+         * @brief Zero all counters (the dispatch cache is kept)
+         */
+        void resetStats();
+
+        /**
+         * @brief Enable/disable the dispatch cache (enabled by default)
+         */
+        void setCacheEnabled(bool enabled) {
+            cache_enabled_ = enabled;
+            dispatch_cache_.clear();
         }
 
         void setDebug(bool debug) { debug_ = debug; }
         void setErrOut(std::ostream* err) { err_ = err; }
 
     private:
-        std::vector<ExecutorPtr> executors_;
+        struct Entry {
+            std::shared_ptr<TensorEquationExecutor> executor;
+            ExecutorStats stats;
+        };
+
+        Entry& entryFor(TensorEquationExecutor& executor);
+
+        std::vector<Entry> entries_;
+        std::mutex stats_mutex_;  // guards the execution counters of concurrent execute() calls
+        // Signature -> index into entries_, valid for cache_env_ at cache_layout_
+        std::unordered_map<std::string, size_t> dispatch_cache_;
+        const Environment* cache_env_{nullptr};
+        uint64_t cache_layout_{0};
+        bool cache_enabled_{true};
         bool debug_ = false;
         std::ostream* err_ = &std::cerr;
     };
-} // namespace tl
\ No newline at end of file
+} // namespace tl
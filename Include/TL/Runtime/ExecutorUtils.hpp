@@ -2,12 +2,23 @@
 
 #include "TL/AST.hpp"
 #include "TL/core.hpp"
+#include <functional>
 #include <vector>
 #include <optional>
 
 namespace tl {
     class Environment; // Forward declaration
 
+    /**
+     * @brief Value of a list literal whose leaves are all numbers
+     *
+     * Cached on the ExprList node; value is undefined when the literal is not
+     * constant (tensor references, calls, ragged nesting).
+     */
+    struct ListConstant {
+        Tensor value;
+    };
+
     namespace executor_utils {
 
         /**
@@ -33,6 +44,19 @@ namespace tl {
         std::vector<int64_t> resolveIndicesCreatingLabels(
             const TensorRef& ref, Environment& env);
 
+        /**
+         * @brief Tensor for an all-numeric list literal such as [[1.0, 2.0], [3.0, 4.0]]
+         *
+         * The literal is parsed once and the result cached on the node, so
+         * re-executing the equation only copies the cached tensor. The copy
+         * keeps in-place writes and requires_grad_ on the bound tensor from
+         * reaching the cache.
+         *
+         * @return nullopt if the literal is not constant; the caller then
+         *         evaluates it element by element
+         */
+        std::optional<Tensor> foldListLiteral(const ExprList& list);
+
         /**
          * @brief Ensure tensor is large enough for given indices, resize if needed
          *
@@ -62,6 +86,16 @@ namespace tl {
             return toString(Statement(eq));
         }
 
+        /**
+         * @brief Structural key of an equation for executor dispatch caching
+         *
+         * Keeps everything canExecute looks at (projection, clause and guard
+         * layout, tensor names, index variables, call names, einsum specs) and
+         * collapses non-negative integer literals, so A[i, 3] = ... and
+         * A[i, 4] = ... share a key. List literal contents are not walked.
+         */
+        std::string dispatchSignature(const TensorEquation& eq);
+
         /**
          * @brief Get tensor value for ref, applying numeric indices and leaving symbolic as slices
          */
@@ -69,6 +103,9 @@ namespace tl {
 
         /**
          * @brief Try to lower indexed product (A[i,j] * B[j,k]) to einsum
+         *
+         * Longer chains of tensor references (A[i,j] B[j,k] C[k,l]) lower to
+         * one einsum with an operand per factor.
          */
         bool tryLowerIndexedProductToEinsum(const TensorRef& lhs,
                                            const ExprPtr& rhs,
@@ -86,6 +123,34 @@ namespace tl {
          */
         const ExprTensorRef* asExprTensorRef(const ExprPtr& expr);
 
+        /**
+         * @brief Collect the factors of a product made only of tensor references
+         *
+         * Parentheses are looked through, so A[i,j] (B[j,k] C[k]) yields three
+         * factors. A single reference is a product of one factor.
+         *
+         * @return false if any factor is not a tensor reference
+         */
+        bool collectProductFactors(const ExprPtr& expr, std::vector<const ExprTensorRef*>& factors);
+
+        /**
+         * @brief Call fn for every tensor reference in an expression, in source order
+         */
+        void forEachTensorRef(const ExprPtr& expr, const std::function<void(const TensorRef&)>& fn);
+
+        /**
+         * @brief Call fn for every tensor reference on the RHS of an equation,
+         *        clause expressions and guards included (not the LHS)
+         */
+        void forEachTensorRef(const TensorEquation& eq, const std::function<void(const TensorRef&)>& fn);
+
+        /**
+         * @brief Call fn for every identifier indexing the LHS or an RHS tensor
+         *        reference; such a name may be a bound tensor that
+         *        ExpressionExecutor reads as the index value
+         */
+        void forEachIndexName(const TensorEquation& eq, const std::function<void(const std::string&)>& fn);
+
         /**
          * @brief Convert tl::Slice to torch::indexing::Slice
          *
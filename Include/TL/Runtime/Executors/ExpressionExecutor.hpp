@@ -13,6 +13,9 @@ namespace tl {
      * - Function calls: relu, sigmoid, tanh, step, sqrt, abs, exp, softmax
      * - Tensor references with indexing
      *
+     * Subtrees of two or more elementwise operations are evaluated by a
+     * FusedElementwise kernel rather than one torch call per node.
+     *
      * Examples:
      *   Y[i] = A[i] + B[i]
      *   Z[i] = relu(W[i,j] * X[j] + b[i])
@@ -11,6 +11,14 @@ namespace tl {
      *
      * Semantics: All matching clauses contribute additively (superposition).
      * Each guarded clause lowers to: Expr * mask(Guard)
+     *
+     * With an indexed LHS the first matching clause wins per index. Clauses
+     * made of elementwise operations over the LHS index variables, scalars
+     * and tensor elements addressed by those variables are evaluated for all
+     * indices at once: each guard becomes a mask over the indices no earlier
+     * clause took, and each body only runs on the indices its guard selected.
+     * Other clauses fall back to binding the index variables one value at a
+     * time.
      */
     class GuardedClauseExecutor : public TensorEquationExecutor {
     public:
@@ -18,5 +26,13 @@ namespace tl {
         Tensor execute(const TensorEquation& eq, Environment& env, TensorBackend& backend) override;
         std::string name() const override;
         int priority() const override;
+
+        /**
+         * @brief Enable/disable the vectorized path (enabled by default)
+         */
+        void setVectorized(bool enabled) { vectorized_ = enabled; }
+
+    private:
+        bool vectorized_{true};
     };
 } // namespace tl
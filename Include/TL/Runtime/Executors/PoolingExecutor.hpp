@@ -8,6 +8,11 @@ namespace tl {
      * @brief Handles pooling operations with projections: +=, avg=, max=, min=
      *
      * Example: Y[i,j/2] avg= X[i,j]
+     *
+     * RHS axes missing from the LHS are reduced away. Whole windows in axis
+     * order pool through a reshape and one reduction; any other mapping
+     * (partial windows, reordered or repeated axes) uses one scatter_reduce.
+     * The result stays on the source tensor's device.
      */
     class PoolingExecutor : public TensorEquationExecutor {
     public:
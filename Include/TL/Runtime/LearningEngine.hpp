@@ -1,7 +1,12 @@
 #pragma once
 
 #include "TL/AST.hpp"
+#include "TL/Runtime/Sampler.hpp"
 #include <torch/torch.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 #include <unordered_set>
@@ -12,6 +17,8 @@ namespace tl {
 class Environment;
 class TensorBackend;
 class ExecutorRegistry;
+class TensorEquationExecutor;
+class Profiler;
 
 // Learning configuration extracted from directive arguments
 struct LearningConfig {
@@ -19,12 +26,99 @@ struct LearningConfig {
     double learningRate{0.01};
     int epochs{100};
     int sampleCount{1000};
+    std::optional<uint64_t> seed;  // @sample: reproducible draws when set
+    bool sampleCounts{false};      // @sample(output="counts"): histogram, not draws
     bool verbose{false};
+    // Mini-batching: with batchSize > 0, the data a training loop reads is
+    // cut along its first axis into batches of at most batchSize rows, one
+    // optimizer step each (0 = full batch)
+    int batchSize{0};
+    bool shuffle{false};  // draw a new row order every epoch
+    int workers{0};       // batches a loader thread prepares ahead (0 = no thread)
+    // Optimizer: "sgd", "adam", "adamw" or "rmsprop". Hyperparameters left
+    // unset (negative) keep the LibTorch default of the chosen optimizer
+    std::string optimizer{"sgd"};
+    double momentum{-1.0};     // sgd, rmsprop
+    double weightDecay{-1.0};  // all
+    double beta1{-1.0};        // adam, adamw
+    double beta2{-1.0};        // adam, adamw
+    double eps{-1.0};          // adam, adamw, rmsprop
+    double alpha{-1.0};        // rmsprop smoothing constant
+    // Recurrences replayed with gradients keep every checkpoint-th step and
+    // recompute the others in the backward pass (0 = keep every step,
+    // -1 = about sqrt(steps), from checkpoint=true)
+    int checkpoint{0};
 
     // Parse from QueryDirective
     static LearningConfig fromDirective(const QueryDirective& dir);
 };
 
+// The learnable parameters of a training loop packed into one contiguous
+// leaf tensor. Each parameter is bound in the environment as a view of it,
+// so optimizer steps update every parameter in place with one fused update
+// of the flat buffer and its flat gradient, and nothing is rebound between
+// steps. Parameters are laid out in name order.
+class ParameterBuffer {
+public:
+    struct Slot {
+        std::string name;
+        int64_t offset{0};
+        std::vector<int64_t> shape;
+    };
+
+    // Packs the current values of params, promoted to a common dtype
+    ParameterBuffer(Environment& env, const std::unordered_set<std::string>& params);
+
+    // Bind each parameter to its view of the buffer; views carry gradients
+    // to flat() when trainable, and are detached aliases otherwise
+    void bindViews(Environment& env, bool trainable) const;
+
+    const torch::Tensor& flat() const { return flat_; }
+    const std::vector<Slot>& slots() const { return slots_; }
+
+private:
+    torch::Tensor flat_;
+    std::vector<Slot> slots_;
+};
+
+// Create the optimizer selected by config over the given tensors
+std::unique_ptr<torch::optim::Optimizer> makeOptimizer(
+    const LearningConfig& config,
+    const std::vector<torch::Tensor>& params
+);
+
+// One equation replayed by a training loop, with the executor chosen for it.
+// A step without an equation stands for the plan's recurrences.
+struct TrainingStep {
+    const TensorEquation* equation{nullptr};
+    TensorEquationExecutor* executor{nullptr};  // chosen on first run
+    uint64_t layout{0};                         // Environment::layoutVersion() it was chosen at
+};
+
+// The slice of a program a training loop replays. Equations are kept in
+// source order and split by whether their result depends on a learnable
+// parameter and whether the target depends on it:
+// - cached: parameter-independent equations the target reads; run once
+//   before the first epoch and reused as constants
+// - steps: equations on a parameter -> target path; replayed every epoch
+// - refresh: parameter-dependent equations the target does not read; run
+//   once after training so they reflect the final parameters
+// Equations that write list literals (the parameters themselves and
+// constant data) are in none of them. inputs are the tensors the steps read
+// but never write, parameters excluded: the data mini-batches are cut from.
+// Equations with a virtual index on the LHS (State[i, *t+1] = ...) run
+// together as the VM's recurrence batch: they are kept in recurrences and
+// stand as one step in the most demanding group any of them falls in, at
+// the place of the first.
+struct TrainingPlan {
+    std::string target;
+    std::vector<std::string> inputs;
+    std::vector<Statement> recurrences;
+    std::vector<TrainingStep> cached;
+    std::vector<TrainingStep> steps;
+    std::vector<TrainingStep> refresh;
+};
+
 // The LearningEngine handles gradient-based learning using PyTorch autograd
 class LearningEngine {
 public:
@@ -52,12 +146,37 @@ public:
         const Program& program
     );
 
-    // Sample from a probability distribution
+    // Sample from a probability distribution (a 1-d tensor, or one per row
+    // of a 2-d tensor); alias tables are cached per tensor
     torch::Tensor sample(
         const std::string& probName,
         const LearningConfig& config
     );
 
+    const Sampler& sampler() const { return sampler_; }
+
+    // Slice `program` for a training loop on target and the given parameters
+    static TrainingPlan planTraining(
+        const std::string& targetName,
+        const std::unordered_set<std::string>& params,
+        const Program& program
+    );
+
+    // Runs a plan's recurrences with the given checkpoint setting; installed
+    // by the VM, which owns the native recurrence loop
+    using RecurrenceRunner = std::function<void(const std::vector<Statement>&, int checkpoint)>;
+    void setRecurrenceRunner(RecurrenceRunner runner) { recurrence_runner_ = std::move(runner); }
+
+    // Report the time, batch count and summed loss of every training epoch
+    // (not owned; nullptr disables)
+    void setProfiler(Profiler* profiler) { profiler_ = profiler; }
+
+    // Plan of the most recent minimize/maximize (for tests and diagnostics)
+    const TrainingPlan& lastPlan() const { return plan_; }
+
+    // Parameter buffer of the most recent minimize/maximize, if any
+    const ParameterBuffer* lastParameters() const { return parameters_.get(); }
+
 private:
     Environment& env_;
     TensorBackend& backend_;
@@ -70,8 +189,20 @@ private:
     // Mark tensors as requiring gradients
     void enableGradients(const std::unordered_set<std::string>& params);
 
-    // Perform one forward pass through the program
-    void forwardPass(const Program& program);
+    // Shared loop of minimize (maximize = false) and maximize
+    torch::Tensor train(
+        const std::string& targetName,
+        const LearningConfig& config,
+        const Program& program,
+        bool maximize
+    );
+
+    // Run the steps of a plan in order, binding each result
+    void runSteps(std::vector<TrainingStep>& steps);
+
+    // Inputs of plan_ to cut into mini-batches: those with the most rows, if
+    // that is more than one batch
+    std::vector<std::string> batchedInputs(const LearningConfig& config);
 
     // Perform backward pass and update parameters
     void backwardPass(
@@ -82,6 +213,13 @@ private:
 
     // Zero gradients for all parameters
     void zeroGradients(const std::unordered_set<std::string>& params);
+
+    TrainingPlan plan_;
+    RecurrenceRunner recurrence_runner_;
+    int checkpoint_{0};  // of the running minimize/maximize
+    std::unique_ptr<ParameterBuffer> parameters_;
+    Sampler sampler_;
+    Profiler* profiler_{nullptr};
 };
 
 } // namespace tl
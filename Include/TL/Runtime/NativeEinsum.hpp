@@ -0,0 +1,88 @@
+#pragma once
+
+#include "TL/core.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace tl {
+
+    /**
+     * @brief Einsums over small fixed shapes as generated, natively compiled loops
+     *
+     * For tensors of a few dozen elements, the dispatch of one torch::einsum
+     * costs more than its arithmetic. A plan turns an explicit spec
+     * ("ij,j->i") and the operand shapes into a C++ loop nest in which every
+     * extent and stride is a literal, so the compiler unrolls and vectorizes
+     * it; the innermost loop is marked for SIMD. Kernels are compiled once
+     * per spec and shape with the system compiler ($TL_CXX, or c++) into a
+     * shared object in the cache directory and loaded with dlopen, so later
+     * runs and processes load them without compiling. Kernels are keyed by
+     * the host CPU as well, since they are built with -march=native, and
+     * are only loaded from a directory and files owned by the current user
+     * and not writable by anyone else.
+     *
+     * Only dense CPU float32 operands whose iteration space has at most
+     * kMaxPoints points are handled, and none that need gradients. For
+     * anything else, or when no compiler is available, run() returns an
+     * undefined tensor and the caller uses LibTorch.
+     */
+    class NativeEinsum {
+    public:
+        /// Signature of a compiled kernel: operand data in spec order, then the output
+        using Kernel = void (*)(const float* const* inputs, float* output);
+
+        /// Iteration points (product of all index extents) above which LibTorch is faster
+        static constexpr int64_t kMaxPoints = int64_t{1} << 14;
+
+        /**
+         * @brief Plan a kernel for a spec and operand shapes
+         * @return nullopt for implicit outputs, ellipses, repeated output
+         *         labels, mismatched extents or too many points
+         */
+        static std::optional<NativeEinsum> plan(const std::string& spec,
+                                                const std::vector<std::vector<int64_t>>& shapes);
+
+        /**
+         * @brief Generated C++ source of the kernel
+         */
+        const std::string& source() const { return source_; }
+
+        /**
+         * @brief Shape of the result
+         */
+        const std::vector<int64_t>& outputShape() const { return output_shape_; }
+
+        /**
+         * @brief Compute the einsum with a compiled kernel
+         * @return An undefined tensor if the operands are not eligible,
+         *         native kernels are disabled or the kernel could not be built
+         */
+        static Tensor run(const std::string& spec, const std::vector<Tensor>& operands);
+
+        /**
+         * @brief Turn native kernels on or off process-wide (off by default)
+         *
+         * Compiling a kernel takes a fraction of a second, which only pays
+         * off for programs that run the same shapes many times.
+         */
+        static void setEnabled(bool enabled);
+        static bool enabled();
+
+        /**
+         * @brief Directory of compiled kernels
+         *
+         * $TL_KERNEL_CACHE, or tl_kernels in $XDG_CACHE_HOME or ~/.cache;
+         * created with mode 0700 when missing.
+         */
+        static void setCacheDirectory(const std::filesystem::path& dir);
+        static std::filesystem::path cacheDirectory();
+
+    private:
+        std::string source_;
+        std::vector<int64_t> output_shape_;
+    };
+
+} // namespace tl
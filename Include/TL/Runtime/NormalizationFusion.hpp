@@ -0,0 +1,40 @@
+#pragma once
+
+#include "TL/core.hpp"
+#include <cstdint>
+
+namespace tl {
+
+    /**
+     * @brief Softmax over a normalized index (i.) in two passes over memory
+     *
+     * torch::softmax reads its input three times: for the maximum, for the
+     * exponentials and their sum, and to divide by the sum. The online
+     * algorithm keeps a running maximum and rescales the running sum
+     * whenever the maximum grows, so one read yields both, and a second pass
+     * writes the result. Along the last axis a row is taken a block at a
+     * time (one exponential per element); along other axes the elements of
+     * a row are spread over memory, and a block of neighbouring rows is
+     * updated together, element by element.
+     *
+     * When the caller owns the values, such as a contraction just computed
+     * for the equation, they are overwritten instead of allocating a second
+     * tensor of their size. Values that are not dense CPU float32 tensors,
+     * or that need gradients, go to torch::softmax.
+     */
+    class FusedNormalization {
+    public:
+        /**
+         * @brief Softmax of @p values along @p dim
+         * @param owned Whether nothing else references the values, so they may be overwritten
+         */
+        static Tensor softmax(const Tensor& values, int64_t dim, bool owned);
+
+        /**
+         * @brief Turn the fused kernel on or off process-wide (on by default)
+         */
+        static void setEnabled(bool enabled);
+        static bool enabled();
+    };
+
+} // namespace tl
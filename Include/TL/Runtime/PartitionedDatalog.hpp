@@ -0,0 +1,107 @@
+#pragma once
+
+#include "TL/AST.hpp"
+#include "TL/Runtime/RelationStore.hpp"
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace tl {
+
+class Environment;
+class ThreadPool;
+
+/**
+ * @brief Parallel Datalog saturation over hash-partitioned relations
+ *
+ * Each rule is evaluated on a join key, a variable shared by all of its
+ * body atoms, and every relation a body reads is split into partitions
+ * by the hash of the column holding that key, so each partition joins
+ * its own tuples without seeing the others.
+ *
+ * Every partition is a worker with its own store and DatalogEngine,
+ * running as a task of a ThreadPool in this process. Strata run one after
+ * another. Within a stratum, workers alternate one local semi-naive round,
+ * seeded with the tuples they received since the last one, with an
+ * exchange that hands every derived tuple to the partitions owning its
+ * keys; a barrier ends the stratum once an exchange delivers no new tuple
+ * anywhere. Workers read the environment's symbol table but do not copy
+ * it, and pass tuples to each other only as TupleBatch columns of symbol
+ * IDs.
+ *
+ * Partitioning spreads the joins over threads; it does not save memory.
+ * The workers hold their own copies of the relations the rules read, one
+ * per key column a relation is read on, next to the environment's.
+ */
+class PartitionedDatalog {
+public:
+    /**
+     * @brief Tuples of one relation shipped to a partition, column by column
+     *
+     * IDs below the size of the environment's symbol table when run()
+     * started denote the same symbol in every worker. Symbols interned since (results of
+     * arithmetic) are sent as kLocalSymbol | i and spelled out in symbols[i].
+     */
+    struct TupleBatch {
+        std::string relation;
+        size_t rows{0};
+        std::vector<std::vector<SymbolId>> columns;
+        std::vector<std::string> symbols;
+    };
+
+    /// Tag of a symbol spelled out in TupleBatch::symbols (symbol IDs stay below 2^31)
+    static constexpr SymbolId kLocalSymbol = SymbolId{1} << 31;
+
+    /**
+     * @brief Choose the partitioning of a stratified program
+     * @param rules Rules of the program
+     * @param strata Indices into @p rules per stratum, in evaluation order;
+     *        rules outside them are ignored
+     * @param partitions Number of partitions (at least 1)
+     * @throws std::runtime_error if a rule in @p strata is not partitionable()
+     */
+    PartitionedDatalog(std::vector<DatalogRule> rules, std::vector<std::vector<size_t>> strata, size_t partitions);
+
+    /**
+     * @brief Whether the body atoms of a rule share a variable to partition on
+     */
+    static bool partitionable(const DatalogRule& rule);
+
+    /**
+     * @brief Relations and the column each of their copies is partitioned on
+     */
+    const std::vector<std::pair<std::string, size_t>>& partitioning() const { return keys_; }
+
+    /**
+     * @brief Partition the relations of @p env, saturate, and add the derived facts to it
+     * @param pool Pool the workers run on; nullptr runs them one after another
+     * @return Number of facts that were new in @p env
+     */
+    size_t run(Environment& env, ThreadPool* pool);
+
+    /**
+     * @brief Exchange rounds of the last run(), over all strata
+     */
+    size_t rounds() const { return rounds_; }
+
+    /**
+     * @brief Tuples the last run() shipped from one partition to another
+     */
+    size_t shuffled() const { return shuffled_; }
+
+private:
+    class Worker;
+
+    std::vector<DatalogRule> rules_;  // bodies read the partitioned copies
+    std::vector<std::vector<size_t>> strata_;
+    size_t partitions_;
+    std::vector<std::pair<std::string, size_t>> keys_;
+    std::unordered_map<std::string, std::vector<size_t>> key_columns_;  // by relation
+    std::vector<std::string> heads_;
+    size_t rounds_{0};
+    size_t shuffled_{0};
+};
+
+} // namespace tl
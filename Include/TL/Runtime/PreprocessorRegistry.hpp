@@ -68,6 +68,18 @@ namespace tl {
             return current;
         }
 
+        /**
+         * @brief Check whether any preprocessor would transform a statement
+         *
+         * preprocess() returns {st} unchanged when this is false.
+         */
+        bool claims(const Statement& st, const Environment& env) const {
+            for (const auto& preprocessor : preprocessors_) {
+                if (preprocessor->shouldPreprocess(st, env)) return true;
+            }
+            return false;
+        }
+
         /**
          * @brief Get the number of registered preprocessors
          */
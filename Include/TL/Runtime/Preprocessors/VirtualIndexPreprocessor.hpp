@@ -1,10 +1,12 @@
 #pragma once
 
 #include "TL/Runtime/StatementPreprocessor.hpp"
+#include <cstdint>
 #include <set>
 #include <string>
 #include <optional>
 #include <utility>
+#include <vector>
 
 namespace tl {
     /**
@@ -30,6 +32,109 @@ namespace tl {
      */
     constexpr int ABSOLUTE_MAX_ITERS = 10000;
 
+    /**
+     * @brief Convergence settings of one fixed-point loop
+     *
+     * The change of the monitored tensor and the count of consecutive stable
+     * iterations are computed on the tensor's device. The host reads the
+     * count only every `checkInterval` iterations, so a loop may run up to
+     * checkInterval - 1 iterations past the one where it converged.
+     */
+    struct ConvergenceOptions {
+        float tolerance{CONVERGENCE_TOLERANCE};  ///< Largest change that counts as stable
+        int maxStable{MAX_CONSECUTIVE_STABLE};   ///< Stable iterations in a row to stop
+        int checkInterval{1};                    ///< Iterations between host reads
+        int maxIterations{ABSOLUTE_MAX_ITERS};   ///< Cap on iterations
+    };
+
+    /// Outcome of the last run of a fixed-point loop
+    struct ConvergenceReport {
+        int iterations{0};      ///< Iterations performed
+        bool converged{false};  ///< false if the loop stopped at maxIterations
+    };
+
+    /**
+     * @brief A group of virtual-indexed equations lowered to one step body
+     *
+     * The body is rewritten once against per-step names and the VM runs it
+     * in a loop over the driving index (TensorLogicVM::executeRecurrence)
+     * instead of executing one cloned equation per timestep:
+     * - Input[k, t] reads `Input$t1`, a view of Input at the current step
+     * - State[j, *t] reads `State$lag1`, the state one step back (for
+     *   State[i, *t+1] = ...); earlier steps are not kept, so reads
+     *   such as *t-1 are rejected when the group is preprocessed
+     * - State[j, *t+1] on the RHS reads `State$next`, this step's value
+     * - Out[i, t] reads `Out$step`, this step's value of an equation with a
+     *   virtual index only on the RHS
+     *
+     * The VM keeps each value only as long as some step reads it, so earlier
+     * steps are never stored. Equations with a virtual index only on the RHS,
+     * such as Out[i, t] = V[i, j] State[j, *t+1], have their values stacked
+     * along t after the loop.
+     *
+     * Products that do not read the recurrence, such as U[i, k] Input[k, t],
+     * leave the body: `hoisted` computes Gate$in0[i, t] for every t in one
+     * contraction before the loop, and the body reads `Gate$in0$t1`.
+     *
+     * Steps are also placed on a wavefront: step k at time t may run in wave
+     * t + steps[k].wave, concurrently with the other steps of that wave. In a
+     * two-layer RNN layer 2 runs one wave behind layer 1, so layer 1 at time
+     * t overlaps layer 2 at time t - 1, and independent directions of a
+     * bidirectional RNN share every wave.
+     */
+    struct Recurrence {
+        /// Driver tensor sliced at the current step
+        struct View {
+            std::string name;    ///< e.g. "Input$t1"
+            std::string source;  ///< e.g. "Input"
+            int64_t dim{0};      ///< Axis indexed by the driving index
+        };
+
+        /// Tensor written with a virtual index on the LHS
+        struct State {
+            std::string tensor;        ///< e.g. "State"
+            int64_t slotDim{0};        ///< Axis of the virtual index
+            int offset{1};             ///< LHS offset, 1 for *t+1
+            TensorEquation writeBack;  ///< State[i, 0] = State$next[i], run once after the loop
+        };
+
+        /// Value of another step that a step reads, bound under `name`
+        struct Read {
+            int source{0};     ///< Index into steps of the producer
+            int lag{0};        ///< Steps back: 0 for this step, 1 for State[j, *t]
+            std::string name;  ///< e.g. "State$lag1"; before step 0 this is the initial state
+        };
+
+        /// One equation of the step body, in dependency order
+        struct Step {
+            TensorEquation equation;   ///< Rewritten body writing `output`
+            std::string output;        ///< e.g. "State$next" or "Out$step"
+            int state{-1};             ///< Index into states, -1 for RHS-only equations
+            std::string target;        ///< RHS-only: tensor receiving the stacked values
+            int64_t axis{-1};          ///< RHS-only: axis of the driving index in target
+            std::vector<Read> reads;   ///< Values of other steps (and of itself) it reads
+            std::vector<size_t> views; ///< Indices into views it reads
+            int wave{0};               ///< Wave offset, see the struct description
+        };
+
+        std::string index;  ///< Driving index, e.g. "t"
+        int iterations{0};  ///< Steps to run, or the cap for fixed-point loops
+        /// State whose change decides convergence, -1 to run every iteration.
+        /// The loop stops once it changes by at most convergence.tolerance
+        /// for convergence.maxStable steps in a row.
+        int monitored{-1};
+        ConvergenceOptions convergence;
+        /// Whether the wave offsets hold: every read is produced in an
+        /// earlier wave. False when a step reads a later step's previous
+        /// value in a way no skew satisfies; all waves are then 0 and steps
+        /// must run in order.
+        bool wavefront{false};
+        std::vector<TensorEquation> hoisted;  ///< Run once before the loop, in order
+        std::vector<View> views;
+        std::vector<State> states;
+        std::vector<Step> steps;
+    };
+
     /**
      * @brief Preprocessor for virtual index expansion
      *
@@ -54,6 +159,8 @@ namespace tl {
      * Design note: This is a preprocessor rather than an executor because
      * it performs syntactic transformation (desugaring) rather than execution.
      * Each expanded statement is then routed to appropriate executors normally.
+     * The VM runs batches lowered by lowerBatch() as a native loop and only
+     * expands the groups that cannot be lowered.
      */
     class VirtualIndexPreprocessor : public StatementPreprocessor {
     public:
@@ -61,14 +168,45 @@ namespace tl {
 
         std::vector<Statement> preprocess(const Statement& st, Environment& env) override;
 
-        // Batch preprocessing for intra-timestep dependencies (multi-layer RNNs)
-        static std::vector<Statement> preprocessBatch(const std::vector<Statement>& statements, Environment& env);
+        // Batch preprocessing for intra-timestep dependencies (multi-layer RNNs).
+        // With debug, the grouping and ordering are traced to stderr when
+        // trace messages are compiled in (see TL/Log.hpp).
+        static std::vector<Statement> preprocessBatch(const std::vector<Statement>& statements, Environment& env,
+                                                      bool debug = false);
+
+        /**
+         * @brief Lower every virtual index group of a batch to a Recurrence
+         *
+         * Groups are ordered and sized exactly as preprocessBatch orders and
+         * sizes them.
+         * @return std::nullopt if any group needs preprocessBatch: fixed-point
+         *         loops, reads of later steps, plain references to tensors the
+         *         group writes, driver tensors that are missing or too short,
+         *         and LHS indices other than identifiers
+         */
+        static std::optional<std::vector<Recurrence>> lowerBatch(const std::vector<Statement>& statements,
+                                                                 Environment& env);
+
+        /**
+         * @brief Lower a self-recursive loop such as x[*t+1] = cos(x[*t])
+         *
+         * The result monitors the loop's tensor for convergence with the
+         * default ConvergenceOptions; callers may replace its settings and
+         * iteration cap.
+         * @return std::nullopt for bodies lowerBatch could not lower either
+         */
+        static std::optional<Recurrence> lowerFixedPoint(const FixedPointLoop& loop, Environment& env);
 
         std::string name() const override { return "VirtualIndexPreprocessor"; }
 
         int priority() const override { return 5; } // High priority - expand before other preprocessing
 
     private:
+        // Lowers one group whose equations are in dependency order
+        static std::optional<Recurrence> lowerGroup(const std::string& index, int iterations,
+                                                    const std::vector<const TensorEquation*>& ordered,
+                                                    Environment& env);
+
         // Helper to check if an index is virtual
         static bool isVirtualIndex(const Index& idx);
 
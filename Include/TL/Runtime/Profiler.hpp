@@ -0,0 +1,169 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace tl {
+
+/**
+ * @brief Records where a run spends its time
+ *
+ * The VM reports every statement it runs, the DatalogEngine the work of
+ * every rule and each saturation, and the LearningEngine every training
+ * epoch. Each report becomes a span of the timeline (see writeChromeTrace)
+ * and is added to per-statement, per-rule and per-epoch totals (see
+ * summary). Recording is thread-safe. A Profiler is attached with
+ * TensorLogicVM::setProfiler and is not owned by what it profiles.
+ */
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Shape = std::vector<int64_t>;
+    using Args = std::vector<std::pair<std::string, std::string>>;
+
+    /**
+     * @brief One span of the timeline
+     */
+    struct Event {
+        std::string name;
+        std::string category;      // "statement", "datalog" or "learning"
+        Clock::duration start{};   // since the profiler was created or cleared
+        Clock::duration duration{};
+        size_t thread{0};          // small per-profiler thread number
+        Args args;
+    };
+
+    /**
+     * @brief Totals of one statement over all its runs
+     *
+     * Shapes are those of the most recent run. Bytes count the storage of
+     * the values the statement bound; FLOPs are an estimate from the index
+     * extents of its operands (see TensorLogicVM::setProfiler).
+     */
+    struct StatementStats {
+        std::string label;
+        std::string executor;  // executor of the last run, or the statement kind
+        std::vector<Shape> inputs;
+        Shape output;
+        size_t runs{0};
+        Clock::duration time{};
+        uint64_t bytes{0};
+        double flops{0.0};
+    };
+
+    /**
+     * @brief Totals of one Datalog rule over all saturations
+     */
+    struct RuleStats {
+        std::string label;
+        size_t joins{0};     // rule variants joined (one per rule and round, or per delta atom)
+        size_t matches{0};   // body bindings that reached the head
+        size_t derived{0};   // head tuples that were new facts
+    };
+
+    /**
+     * @brief One epoch of a minimize/maximize directive
+     */
+    struct EpochStats {
+        std::string target;
+        int epoch{0};
+        int64_t batches{0};
+        double loss{0.0};  // summed over the epoch's batches
+        Clock::duration time{};
+    };
+
+    Profiler();
+
+    /**
+     * @brief Record one run of a statement
+     * @param label Source text of the statement; runs with the same label add up
+     * @param executor Executor that ran it, or a name for the statement kind
+     * @param inputs Shapes of the tensors it read
+     * @param output Shape of the tensor it bound (empty if none)
+     * @param bytes Storage of the bound values
+     * @param flops Estimated floating point operations
+     */
+    void recordStatement(const std::string& label, const std::string& executor,
+                         std::vector<Shape> inputs, Shape output, uint64_t bytes, double flops,
+                         Clock::time_point start, Clock::time_point end);
+
+    /**
+     * @brief Add to the counts of a rule (no timeline span; rules run interleaved)
+     */
+    void recordRule(const std::string& label, size_t joins, size_t matches, size_t derived);
+
+    /**
+     * @brief Record one training epoch
+     */
+    void recordEpoch(const std::string& target, int epoch, int64_t batches, double loss,
+                     Clock::time_point start, Clock::time_point end);
+
+    /**
+     * @brief Record a span that is not a statement or epoch (e.g. a saturation)
+     */
+    void recordSpan(const std::string& name, const std::string& category,
+                    Clock::time_point start, Clock::time_point end, Args args = {});
+
+    /**
+     * @brief Print the statements by total time, then the rules and epochs
+     * @param limit Statements to list at most (0 = all)
+     */
+    void summary(std::ostream& out, size_t limit = 0) const;
+
+    /**
+     * @brief Write the timeline in the Chrome trace event format
+     *
+     * The JSON object loads in chrome://tracing and Perfetto: one complete
+     * ("X") event per span with microsecond timestamps, and the statement
+     * and epoch details as event arguments.
+     */
+    void writeChromeTrace(std::ostream& out) const;
+
+    /**
+     * @brief Write the Chrome trace to a file
+     * @throws std::runtime_error if the file cannot be written
+     */
+    void writeChromeTrace(const std::string& path) const;
+
+    /**
+     * @brief Forget everything recorded and restart the clock
+     */
+    void clear();
+
+    /**
+     * @brief Statement totals, in the order statements first ran
+     */
+    std::vector<StatementStats> statements() const;
+
+    /**
+     * @brief Rule totals, in the order rules were first reported
+     */
+    std::vector<RuleStats> rules() const;
+
+    std::vector<EpochStats> epochs() const;
+    std::vector<Event> events() const;
+
+private:
+    // Caller holds mutex_
+    void addEvent(std::string name, std::string category, Clock::time_point start,
+                  Clock::time_point end, Args args);
+
+    mutable std::mutex mutex_;
+    Clock::time_point origin_;
+    std::vector<Event> events_;
+    std::vector<StatementStats> statements_;
+    std::map<std::string, size_t> statement_index_;  // label -> statements_
+    std::vector<RuleStats> rules_;
+    std::map<std::string, size_t> rule_index_;       // label -> rules_
+    std::vector<EpochStats> epochs_;
+    std::map<std::thread::id, size_t> threads_;      // -> thread number
+};
+
+} // namespace tl
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "TL/core.hpp"
+#include "TL/Runtime/RelationStore.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace tl {
+
+/**
+ * @brief Answer of one query as data rather than text
+ *
+ * A tensor query gives the tensor, or for concrete indices (T[0, Alice]?)
+ * the selected element together with the indices. A Datalog query gives one
+ * column of symbol IDs per variable, in order of first appearance, and one
+ * row per answer in the order they are printed. A query without variables
+ * has no columns and a row per proof; it holds if there is at least one.
+ *
+ * Modifiers of the query shape the answer: @limit keeps the first answers
+ * found (or the first rows of a tensor), @exists reports a Datalog query
+ * like one without variables, and @topk keeps the largest elements along
+ * a tensor's last dimension, with their indices in `positions`.
+ */
+struct QueryResult {
+    std::string name;                  ///< Tensor, or relation of the query atom
+    Tensor tensor;                     ///< Defined for tensor queries
+    std::vector<int64_t> indices;      ///< Concrete indices of an element query
+    Tensor positions;                  ///< Indices of @topk elements along the last dimension
+    std::vector<std::string> variables;
+    std::vector<std::vector<SymbolId>> columns;  ///< Parallel to variables, rows IDs each
+    size_t rows{0};
+
+    bool isTensor() const { return tensor.defined(); }
+};
+
+namespace query_io {
+
+    /**
+     * @brief Print a result as a query statement does
+     *
+     * The text is formatted into one buffer and written with a single call
+     * and one flush, however many answers there are.
+     */
+    void writeText(std::ostream& out, const QueryResult& result, const SymbolTable& symbols);
+
+    /**
+     * @brief Write a result to a file for other programs to read
+     *
+     * Tensors go to any tensor file format (see TensorIO.hpp), such as the
+     * binary one. Datalog answers go to a relation file (see RelationIO.hpp)
+     * with one position per variable: `.tlr` is binary and columnar. As in
+     * any relation, repeated answers are stored once.
+     * @throws std::runtime_error if the file cannot be written, or a Datalog
+     *         answer without variables is written
+     */
+    void write(const std::filesystem::path& path, const QueryResult& result, const SymbolTable& symbols);
+
+} // namespace query_io
+
+} // namespace tl
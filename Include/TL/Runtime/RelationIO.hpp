@@ -0,0 +1,55 @@
+#pragma once
+
+#include "TL/Runtime/RelationStore.hpp"
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+
+namespace tl {
+
+    /**
+     * @brief Datalog relations read by Relation = file("...") and written by
+     *        file("...") = Relation
+     *
+     * The format follows the extension:
+     * - `.tsv`, `.facts`: one tuple per line, fields separated by tabs, or by
+     *   commas when the first tuple has no tab. Blank lines and lines starting
+     *   with '#' are skipped, and double quotes around a field are dropped.
+     * - `.tlr`: binary columnar; the distinct symbols once, then one uint32
+     *   column per position indexing them
+     *
+     * Any other extension is a tensor file (see TensorIO.hpp).
+     */
+    namespace relation_io {
+
+        /**
+         * @brief Whether the extension of a path names a relation file (case-insensitive)
+         */
+        bool isRelationFile(const std::filesystem::path& path);
+
+        /// Receives `count` tuples of `arity` symbol IDs, packed row-major
+        using TupleSink = std::function<void(size_t arity, const SymbolId* tuples, size_t count)>;
+
+        /**
+         * @brief Read a relation file in batches of tuples
+         *
+         * Text is read in blocks of lines split across `threads` (0 = the shared
+         * ThreadPool). Each thread collects the distinct fields of its lines,
+         * so every distinct field is interned once per block rather than once
+         * per occurrence. The file is never held in memory whole.
+         * @return Number of tuples read, duplicates included
+         * @throws std::runtime_error if the file cannot be opened, is
+         *         truncated, or has tuples of different arities
+         */
+        size_t read(const std::filesystem::path& path, SymbolTable& symbols, const TupleSink& sink,
+                    size_t threads = 0);
+
+        /**
+         * @brief Write every tuple of a relation, creating parent directories as needed
+         * @throws std::runtime_error if the file cannot be written
+         */
+        void write(const std::filesystem::path& path, const Relation& relation, const SymbolTable& symbols);
+
+    } // namespace relation_io
+
+} // namespace tl
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tl {
+
+/// Dense 32-bit identifier of an interned Datalog constant
+using SymbolId = uint32_t;
+
+/**
+ * @brief Interns strings to stable, dense 32-bit symbol IDs
+ *
+ * IDs are handed out in first-seen order starting at 0 and never change,
+ * so tuples can be stored and compared as integers and turned back into
+ * text only when they are printed.
+ *
+ * A table can extend a base table without copying it: the base's symbols
+ * keep their IDs and are read from the base, and symbols it does not hold
+ * are numbered after them.
+ */
+class SymbolTable {
+public:
+    /**
+     * @brief A table extending @p base, which is only read and must outlive it
+     *
+     * Symbols the base interns afterwards are not seen, so IDs stay stable.
+     */
+    static SymbolTable extending(const SymbolTable& base);
+
+    /**
+     * @brief Return the ID of a symbol, assigning the next free ID if it is new
+     */
+    SymbolId intern(const std::string& text);
+
+    /**
+     * @brief Look up an existing symbol without creating it
+     * @return true and sets outId if the symbol has been interned
+     */
+    bool lookup(const std::string& text, SymbolId& outId) const;
+
+    /**
+     * @brief Text of an interned symbol (reference stays valid for the table's lifetime)
+     */
+    const std::string& name(SymbolId id) const {
+        return id < base_size_ ? base_->name(id) : names_[id - base_size_];
+    }
+
+    /**
+     * @brief Number of interned symbols
+     */
+    size_t size() const { return base_size_ + names_.size(); }
+
+    /**
+     * @brief Numeric value of a symbol, parsed once when it was interned
+     * @return true and sets out if the symbol's text starts with a number
+     */
+    bool number(SymbolId id, double& out) const {
+        if (id < base_size_) return base_->number(id, out);
+        out = numbers_[id - base_size_];
+        return numeric_[id - base_size_] != 0;
+    }
+
+    /**
+     * @brief Parse the leading number of a text the way std::stod does
+     * @return false if the text does not start with a number or it is out of range
+     */
+    static bool parseNumber(const std::string& text, double& out);
+
+private:
+    const SymbolTable* base_{nullptr};
+    size_t base_size_{0};  // IDs below this are the base's
+    std::unordered_map<std::string, SymbolId> ids_;
+    std::deque<std::string> names_;  // deque keeps name() references stable
+    std::vector<double> numbers_;    // per symbol, 0 unless numeric_
+    std::vector<uint8_t> numeric_;
+};
+
+/**
+ * @brief Column-packed tuple storage for a single Datalog relation
+ *
+ * Tuples have a fixed arity and are appended row-major into one flat
+ * array of symbol IDs. Rows are never reordered, so a row number stays a
+ * valid handle until the relation is cleared. Duplicate tuples are
+ * rejected through an open-addressing hash table of row numbers that
+ * hashes the packed tuple directly.
+ *
+ * Joins look rows up through hash indexes keyed on the set of bound
+ * columns. An index is built the first time a column set is probed,
+ * kept up to date by insert(), and only discarded by clear().
+ */
+class Relation {
+public:
+    /// Bit i set = column i is bound (only the first 64 columns are indexable)
+    using ColumnMask = uint64_t;
+    /// Row numbers in ascending order
+    using RowList = std::vector<uint32_t>;
+
+    explicit Relation(size_t arity = 0) : arity_(arity) {}
+
+    // Copies carry the tuples only; indexes are rebuilt on demand
+    Relation(const Relation& other);
+    Relation& operator=(const Relation& other);
+    Relation(Relation&&) noexcept = default;
+    Relation& operator=(Relation&&) noexcept = default;
+
+    /**
+     * @brief Number of columns of every tuple
+     */
+    size_t arity() const { return arity_; }
+
+    /**
+     * @brief Number of stored tuples
+     */
+    size_t size() const { return rows_; }
+    bool empty() const { return rows_ == 0; }
+
+    /**
+     * @brief Pointer to the arity() symbol IDs of a row
+     *
+     * Invalidated by insert(); re-fetch after deriving new tuples.
+     */
+    const SymbolId* row(size_t r) const { return data_.data() + r * arity_; }
+
+    /**
+     * @brief Insert a tuple of arity() symbol IDs
+     * @return true if the tuple was new
+     */
+    bool insert(const SymbolId* tuple);
+
+    /**
+     * @brief Insert count tuples packed row-major, arity() IDs each
+     *
+     * The hash table and the tuple array are sized for all of them up
+     * front, so bulk loads do not rehash as the relation grows.
+     * @return Number of tuples that were new
+     */
+    size_t insertBulk(const SymbolId* tuples, size_t count);
+
+    /**
+     * @brief Check whether a tuple of arity() symbol IDs is stored
+     */
+    bool contains(const SymbolId* tuple) const;
+
+    /**
+     * @brief Candidate rows whose columns in @p mask hash like @p key
+     * @param mask Bound columns (must be non-zero)
+     * @param key arity() symbol IDs; only the columns in @p mask are read
+     * @return Rows in ascending order, or nullptr if no row can match. Hash
+     *         collisions are possible, so callers still compare each row.
+     *         The list stays valid (and grows) across insert().
+     */
+    const RowList* probe(ColumnMask mask, const SymbolId* key) const;
+
+    /**
+     * @brief Build the index for @p mask now instead of on first probe
+     */
+    void ensureIndex(ColumnMask mask) const { indexFor(mask); }
+
+    /**
+     * @brief Number of distinct keys in the index for @p mask
+     * @return 0 if that index has not been built yet
+     */
+    size_t keyCount(ColumnMask mask) const;
+
+    /**
+     * @brief Number of column sets that currently have an index
+     */
+    size_t indexCount() const { return indexes_.size(); }
+
+    /**
+     * @brief Column sets that currently have an index, in the order they were built
+     */
+    std::vector<ColumnMask> indexMasks() const;
+
+    /**
+     * @brief Remove all tuples and drop every index (the arity is kept)
+     */
+    void clear();
+
+private:
+    static constexpr uint32_t kEmptySlot = 0;  // slots hold row + 1
+
+    /// Rows bucketed by the hash of their values in the masked columns
+    struct HashIndex {
+        ColumnMask mask{0};
+        std::unordered_map<uint64_t, RowList> buckets;
+    };
+
+    size_t hashTuple(const SymbolId* tuple) const;
+    uint64_t hashColumns(ColumnMask mask, const SymbolId* tuple) const;
+    bool rowEquals(size_t r, const SymbolId* tuple) const;
+    void rehash(size_t newCapacity);
+    void reserveRows(size_t rows);               // throws past the row limit
+    bool insertRow(const SymbolId* tuple);       // capacity already reserved
+    HashIndex& indexFor(ColumnMask mask) const;
+
+    size_t arity_;
+    size_t rows_{0};
+    std::vector<SymbolId> data_;
+    std::vector<uint32_t> slots_;
+    // Built lazily by probe(); held by pointer so RowList references survive
+    // the creation of further indexes
+    mutable std::vector<std::unique_ptr<HashIndex>> indexes_;
+};
+
+} // namespace tl
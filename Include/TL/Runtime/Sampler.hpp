@@ -0,0 +1,104 @@
+#pragma once
+
+#include <torch/torch.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tl {
+
+class ThreadPool;
+
+/**
+ * @brief Walker/Vose alias table over a discrete distribution
+ *
+ * Built in O(n) from non-negative weights (normalized internally); each
+ * draw is then O(1): one column and one biased coin.
+ */
+class AliasTable {
+public:
+    /**
+     * @throws std::runtime_error if a weight is negative or not finite, or
+     *         all weights are zero
+     */
+    explicit AliasTable(const std::vector<double>& weights);
+
+    size_t size() const { return prob_.size(); }
+
+    /**
+     * @brief Outcome for 64 random bits: the high half picks the column,
+     *        the low half tosses its coin
+     */
+    int64_t draw(uint64_t bits) const;
+
+private:
+    std::vector<double> prob_;     // chance of keeping the column
+    std::vector<int64_t> alias_;   // outcome taken otherwise
+};
+
+/**
+ * @brief Counter-based random bits: a keyed hash of (seed, counter)
+ *
+ * Draw i of a request always uses counter i, so results depend only on the
+ * seed, never on how draws are split across threads.
+ */
+uint64_t counterBits(uint64_t seed, uint64_t counter);
+
+struct SampleOptions {
+    int64_t count{1000};            // draws per distribution
+    std::optional<uint64_t> seed;   // reproducible when set
+    bool counts{false};             // histogram per distribution instead of draws
+};
+
+/**
+ * @brief Draws outcomes from probability tensors for @sample
+ *
+ * A 1-d tensor is one distribution, a 2-d tensor one per row. Alias tables
+ * are built once per distribution and kept while the tensor bound under the
+ * same name is unchanged (same storage and version). Draws are split into
+ * fixed chunks run on a thread pool; each chunk is its own stream of the
+ * counter-based generator. In counts mode every chunk adds into a local
+ * histogram and no sample is materialized.
+ */
+class Sampler {
+public:
+    /**
+     * @param threads Threads for large requests (0 = ThreadPool::shared())
+     */
+    explicit Sampler(size_t threads = 0);
+    ~Sampler();
+
+    /**
+     * @brief Draw from `probs`, bound in the environment as `name`
+     * @return int64 draws of shape [count] or [rows, count], or int64
+     *         counts of shape [n] or [rows, n], on the device of `probs`
+     * @throws std::runtime_error for tensors that are not 1-d or 2-d, or
+     *         rows that are not valid distributions
+     */
+    torch::Tensor sample(const std::string& name, const torch::Tensor& probs, const SampleOptions& options);
+
+    /**
+     * @brief Alias tables built so far (for tests and diagnostics)
+     */
+    size_t tablesBuilt() const { return tables_built_; }
+
+private:
+    struct Entry {
+        torch::Tensor source;  // keeps the storage alive so its address is not reused
+        int64_t version{0};
+        std::vector<AliasTable> rows;
+    };
+
+    const std::vector<AliasTable>& tablesFor(const std::string& name, const torch::Tensor& probs);
+
+    size_t threads_;
+    std::shared_ptr<ThreadPool> pool_;
+    std::unordered_map<std::string, Entry> cache_;
+    size_t tables_built_{0};
+};
+
+} // namespace tl
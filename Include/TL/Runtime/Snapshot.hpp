@@ -0,0 +1,56 @@
+#pragma once
+
+#include "TL/Runtime/DatalogEngine.hpp"
+#include <filesystem>
+
+namespace tl {
+
+    class Environment;
+
+    /**
+     * @brief Binary snapshots of an environment and its Datalog engine, for warm restarts
+     *
+     * A snapshot holds every bound tensor, the symbol table (Datalog
+     * constants and tensor-index labels, with the labels in axis order),
+     * every relation with the column sets it is indexed on, and the
+     * engine's rules with the status of their closure.
+     *
+     * Layout, fixed fields little-endian:
+     *   char magic[4] "TLS1", uint32 format version, uint64 metadata offset,
+     *   uint64 metadata size, padding to 64 bytes,
+     *   records (see tensor_io::writeRecord), metadata
+     * Tensors and relations are records, a relation as an int32 tensor of
+     * its rows in insertion order. The metadata names them by offset, in
+     * varints and length-prefixed strings.
+     *
+     * Restoring maps the file and wraps every tensor record in place, so
+     * tensor data is paged in as it is first read. Relations are inserted
+     * into fresh stores and their indexes rebuilt, which reads their rows
+     * once.
+     */
+    namespace snapshot_io {
+
+        /**
+         * @brief Write a snapshot, creating parent directories as needed
+         *
+         * The file is written aside and renamed into place, so a crash never
+         * leaves a partial snapshot at @p path.
+         * @throws std::runtime_error if the file cannot be written or a
+         *         tensor has a dtype tensor files cannot store
+         */
+        void write(const std::filesystem::path& path, const Environment& env, const DatalogEngine& datalog);
+
+        /**
+         * @brief Replace the contents of @p env with a snapshot
+         *
+         * The device and dtype policy of @p env are kept; tensors are moved
+         * and cast to them as they are bound. @p env is unchanged if the
+         * file is malformed.
+         * @return The rules and closure status, for DatalogEngine::restore
+         * @throws std::runtime_error if the file cannot be read or is malformed
+         */
+        DatalogEngine::State read(const std::filesystem::path& path, Environment& env);
+
+    } // namespace snapshot_io
+
+} // namespace tl
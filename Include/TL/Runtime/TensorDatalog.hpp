@@ -0,0 +1,62 @@
+#pragma once
+
+#include "TL/AST.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace tl {
+
+// Forward declarations
+class Environment;
+class TensorBackend;
+
+/**
+ * @brief Evaluates a stratum of Datalog rules as einsums over Boolean tensors
+ *
+ * Every relation of the stratum is materialized as a dense 0/1 tensor with
+ * one axis of size |symbols| per column, indexed by symbol ID. A rule body
+ * then becomes one einsum over its atoms (shared variables are contracted,
+ * head variables are kept) followed by a step threshold, and the stratum is
+ * iterated until no tensor changes. Derived tuples are written back to the
+ * relation store at the end, so queries and later strata see them as usual.
+ *
+ * Only pure conjunctive rules are supported: positive atoms whose terms are
+ * all variables, and a head of distinct variables that all occur in the
+ * body. Other rules keep using the tuple-at-a-time join of DatalogEngine.
+ */
+class TensorDatalog {
+public:
+    /// Default limit on the cells of one relation tensor (64 MiB of floats)
+    static constexpr size_t kDefaultMaxCells = size_t{1} << 24;
+
+    TensorDatalog(Environment& env, TensorBackend& backend, size_t maxCells = kDefaultMaxCells);
+
+    /**
+     * @brief Check whether a rule can be evaluated as an einsum
+     */
+    static bool supports(const DatalogRule& rule);
+
+    /**
+     * @brief Saturate a stratum
+     * @param rules Rules of the stratum; each must satisfy supports()
+     * @param recursive Iterate to fixpoint (otherwise every rule runs once)
+     * @param rounds Set to the number of evaluation rounds
+     * @return false, leaving the store untouched, if a relation tensor would
+     *         exceed the cell limit or an atom's arity does not match its relation
+     */
+    bool saturate(const std::vector<const DatalogRule*>& rules, bool recursive, size_t& rounds);
+
+    /**
+     * @brief Einsum specification of a rule, e.g. "ab,bc->ac" for
+     *        Path(x, z) <- Edge(x, y), Path(y, z)
+     */
+    static std::string einsumSpec(const DatalogRule& rule);
+
+private:
+    Environment& env_;
+    TensorBackend& backend_;
+    size_t max_cells_;
+};
+
+} // namespace tl
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "TL/core.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace tl {
+
+    /**
+     * @brief Tensor files read by T = file("...") and written by file("...") = T
+     *
+     * The format follows the extension:
+     * - `.tlt`: binary; a header with dtype, rank, shape and strides (in
+     *   elements) followed by the raw little-endian data
+     * - `.npy`: NumPy's binary format, little-endian, C or Fortran order
+     * - anything else: text, one number per line or comma-separated rows
+     *
+     * Binary files are memory-mapped and wrapped as tensors without a copy.
+     * The mapping is private, so writes to the tensor never reach the file,
+     * and it is unmapped when the last tensor using it is freed.
+     */
+    namespace tensor_io {
+
+        enum class Format { Text, Tlt, Npy };
+
+        /**
+         * @brief Format selected by the extension of a path (case-insensitive)
+         */
+        Format formatFor(const std::filesystem::path& path);
+
+        /**
+         * @brief Read a tensor from a file
+         *
+         * Text files produce float32 CPU tensors (an empty file gives an empty
+         * vector). They are parsed in up to `threads` chunks of at least 1 MiB
+         * split at line boundaries (0 = ThreadPool::defaultThreads()), each written
+         * directly into its rows of the result. Binary files keep their dtype,
+         * shape and strides.
+         * @throws std::runtime_error if the file cannot be opened or is
+         *         malformed, including invalid numbers and CSV rows whose
+         *         column count differs from the first row
+         */
+        Tensor read(const std::filesystem::path& path, size_t threads = 0);
+
+        /**
+         * @brief Write a tensor, creating parent directories as needed
+         *
+         * Binary formats store the tensor contiguously in its own dtype. Text
+         * writes 0-d and 1-d tensors one value per line, 2-d tensors as
+         * comma-separated rows, and higher ranks flattened.
+         * @throws std::runtime_error if the file cannot be written or the
+         *         dtype has no encoding in the format
+         */
+        void write(const std::filesystem::path& path, const Tensor& t);
+
+        /**
+         * @brief Write a tensor's values as text, laid out as in text files
+         *
+         * The tensor is copied to a contiguous host buffer once and each value
+         * printed with std::to_chars, as the shortest text that reads back to
+         * the same value. No newline follows the last value.
+         * @throws std::runtime_error for dtypes without a text form (complex)
+         */
+        void format(std::ostream& os, const Tensor& t);
+
+        /**
+         * @brief Append a tensor to a binary stream as an embedded .tlt record
+         *
+         * The record is laid out as a .tlt file whose data offset counts from
+         * the start of the record, and padded to a multiple of 64 bytes, so
+         * records written one after another from an aligned position keep
+         * their data aligned.
+         * @return Bytes written
+         * @throws std::runtime_error if the dtype has no encoding or the write fails
+         */
+        uint64_t writeRecord(std::ostream& os, const Tensor& t);
+
+        /**
+         * @brief Tensors of the .tlt records a file holds at @p offsets
+         *
+         * The file is mapped once and every tensor is a view of the mapping,
+         * as read() does for binary files, so a tensor's pages are only read
+         * from disk when it is first used.
+         * @throws std::runtime_error if the file cannot be opened or a record is malformed
+         */
+        std::vector<Tensor> readRecords(const std::filesystem::path& path, const std::vector<uint64_t>& offsets);
+
+        /**
+         * @brief Reads a tensor file in chunks of rows along its first axis
+         *
+         * Binary files are mapped once and every chunk is a view of the
+         * mapping. Pages of the rows already returned are handed back to the
+         * system when the next chunk is read, so resident memory stays near
+         * one chunk however large the file is; writes to an earlier chunk may
+         * be lost at that point. Text files are read line by line, in the
+         * layout read() accepts, into one float32 tensor per chunk.
+         */
+        class ChunkReader {
+        public:
+            /**
+             * @throws std::invalid_argument if rows is not positive
+             * @throws std::runtime_error if the file cannot be opened or holds a 0-d tensor
+             */
+            ChunkReader(const std::filesystem::path& path, int64_t rows);
+
+            ChunkReader(const ChunkReader&) = delete;
+            ChunkReader& operator=(const ChunkReader&) = delete;
+
+            /**
+             * @brief The next chunk of at most rows() rows, std::nullopt after the last
+             * @throws std::runtime_error for malformed text rows
+             */
+            std::optional<Tensor> next();
+
+            int64_t rows() const { return rows_; }
+            const std::filesystem::path& path() const { return path_; }
+
+        private:
+            std::optional<Tensor> nextText();
+            void releaseConsumed();
+
+            std::filesystem::path path_;
+            int64_t rows_;
+            Format format_;
+            // Binary files
+            Tensor whole_;
+            bool mapped_{false};
+            int64_t position_{0};
+            size_t released_{0};  // bytes from the start of whole_ handed back to the system
+            // Text files
+            std::ifstream text_;
+            bool csv_{false};
+            int64_t columns_{0};  // 0 until the first row is seen
+            std::string line_;
+            std::string lines_;
+        };
+
+        /**
+         * @brief Writes a tensor file from chunks appended along its first axis
+         *
+         * Every chunk must have the dtype and trailing shape of the first.
+         * Binary headers are written with the first chunk and their row count
+         * patched by close(), so a file may exceed available memory. Text
+         * chunks are appended in the layout write() uses.
+         */
+        class ChunkWriter {
+        public:
+            /**
+             * @throws std::runtime_error if the file cannot be created
+             */
+            explicit ChunkWriter(const std::filesystem::path& path);
+            ~ChunkWriter();  // closes, ignoring errors
+
+            ChunkWriter(const ChunkWriter&) = delete;
+            ChunkWriter& operator=(const ChunkWriter&) = delete;
+
+            /**
+             * @throws std::runtime_error for 0-d chunks, a dtype or trailing
+             *         shape that differs from the first chunk, or write errors
+             */
+            void append(const Tensor& chunk);
+
+            /**
+             * @brief Finish the file; without chunks it holds an empty vector
+             * @throws std::runtime_error on write errors
+             */
+            void close();
+
+            int64_t rows() const { return rows_; }
+
+        private:
+            std::filesystem::path path_;
+            Format format_;
+            std::ofstream out_;
+            bool open_{true};
+            bool started_{false};
+            int64_t rows_{0};
+            torch::ScalarType type_{torch::kFloat32};
+            std::vector<int64_t> trailing_;  // shape after the first axis
+        };
+
+    } // namespace tensor_io
+
+} // namespace tl
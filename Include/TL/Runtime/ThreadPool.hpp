@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tl {
+
+/**
+ * @brief Order in which pinned workers take the cores of NUMA nodes
+ */
+enum class NumaPolicy {
+    None,     // cores in id order, nodes ignored
+    Compact,  // fill one node before the next, so a pool's memory stays node-local
+    Spread    // round-robin over nodes, for the memory bandwidth of all of them
+};
+
+/**
+ * @brief Process-wide threading settings (see ThreadPool::configure)
+ *
+ * One thread budget covers LibTorch's intra-op pool and the runtime's own
+ * loops (statement levels, recurrence waves, Datalog rounds, sampling and
+ * text parsing), which share ThreadPool::shared() unless given an explicit
+ * thread count.
+ */
+struct ThreadOptions {
+    size_t intraOp{0};                  // threads per parallel loop (0 = hardware concurrency)
+    size_t interOp{0};                  // LibTorch inter-op threads (0 = LibTorch's default)
+    bool pin{false};                    // pin pool workers to cores (Linux only)
+    NumaPolicy numa{NumaPolicy::None};  // core order for pinning; anything but None implies pin
+};
+
+/**
+ * @brief Parse "none", "compact" or "spread"
+ * @throws std::invalid_argument for any other name
+ */
+NumaPolicy parseNumaPolicy(const std::string& name);
+
+/**
+ * @brief Fixed-size pool of worker threads for data-parallel loops
+ *
+ * The pool runs one parallelFor() at a time: the calling thread and the
+ * workers claim loop indices from a shared counter until all are done.
+ * Calls made from inside a running loop body execute inline, so nested
+ * parallel loops cannot deadlock.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Create a pool
+     * @param threads Total threads including the caller (0 = defaultThreads())
+     *
+     * Workers are pinned to cores when the configured options ask for it.
+     */
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Number of threads that execute loop bodies (workers plus the caller)
+     */
+    size_t size() const { return workers_.size() + 1; }
+
+    /**
+     * @brief Run fn(i) for every i in [0, count) and wait for completion
+     *
+     * Rethrows the first exception thrown by a loop body after all claimed
+     * indices have finished. While another caller's loop runs, the whole
+     * loop runs inline on the calling thread instead of waiting for the pool.
+     */
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+    /**
+     * @brief Replace the process-wide options
+     *
+     * Pools made afterwards, including the next shared() pool, follow them;
+     * existing pools keep their threads. LibTorch's settings are applied by
+     * TensorLogicVM::setThreadOptions, which calls this.
+     */
+    static void configure(const ThreadOptions& options);
+    static ThreadOptions options();
+
+    /**
+     * @brief Threads a pool gets for a count of 0: options().intraOp, or
+     *        hardware concurrency when that is 0 too
+     */
+    static size_t defaultThreads();
+
+    /**
+     * @brief The process-wide pool of defaultThreads() threads
+     *
+     * Created on first use and again after configure(); holders of the
+     * previous pool keep it alive until they let go.
+     */
+    static std::shared_ptr<ThreadPool> shared();
+
+    /**
+     * @brief Point `pool` at the pool for a component's thread count
+     *
+     * A count of 0 selects shared(); any other count a private pool of that
+     * size, kept while it still matches. Cheap enough to call before every
+     * parallel loop, so components follow configure() without being told.
+     */
+    static void obtain(std::shared_ptr<ThreadPool>& pool, size_t threads);
+
+private:
+    void workerLoop();
+    void runIndices();
+
+    std::vector<std::thread> workers_;
+    std::mutex submit_mutex_;  // held by the caller whose loop the workers run
+
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(size_t)>* job_{nullptr};
+    size_t job_count_{0};
+    size_t busy_workers_{0};
+    size_t generation_{0};
+    bool stop_{false};
+    std::atomic<size_t> next_index_{0};
+    std::exception_ptr error_;
+};
+
+} // namespace tl
@@ -1,12 +1,31 @@
 #pragma once
 
 #include "TL/core.hpp"
+#include "TL/Runtime/DTypePolicy.hpp"
 
+#include <cstdint>
 #include <memory>
+#include <string>
 
 namespace tl {
 
-enum class BackendType { LibTorch };
+enum class BackendType {
+  LibTorch, // Dense torch::einsum
+  Sparse,   // COO operands contracted by gathering the rows their nonzeros touch
+  Native    // LibTorch, with small fixed-shape einsums run as compiled loops (see NativeEinsum)
+};
+
+// When the hybrid backend hands an einsum to the sparse backend: an operand
+// that is already sparse, or, with probeDense, a dense one with at least
+// minElements elements of which at most maxDensity are nonzero. Dense
+// operands picked this way are converted to COO first. Probing counts the
+// nonzeros of every large dense operand, a full pass and on accelerators a
+// host sync per einsum, so it is off by default.
+struct SparseRouting {
+  double maxDensity{0.01};
+  int64_t minElements{int64_t{1} << 16};
+  bool probeDense{false};
+};
 
 class TensorBackend {
 public:
@@ -21,15 +40,32 @@ public:
 
   // Learning API (no-op for now)
   virtual void learn(const Program &prog, const Loss &loss) = 0;
+
+  // Device the backend computes on; operands elsewhere are moved there
+  virtual torch::Device device() const { return torch::kCPU; }
+  virtual void setDevice(const torch::Device &) {}
+
+  // Element types for contractions: operands are cast to policy.compute and
+  // results returned as policy.accumulate
+  virtual void setDTypePolicy(const DTypePolicy &) {}
 };
 
+// Parse a device spec: "cpu", "cuda", "cuda:N" or "mps". Throws
+// std::invalid_argument for malformed specs and devices this build or
+// machine does not provide.
+torch::Device parseDevice(const std::string &spec);
+
 class BackendFactory {
 public:
-  static std::unique_ptr<TensorBackend> create(BackendType type);
+  static std::unique_ptr<TensorBackend>
+  create(BackendType type, const torch::Device &device = torch::kCPU);
 
+  // Route each einsum to `sparse` or `dense` by operand density (see
+  // BackendRouter::analyze). If either is null the other is returned.
   static std::unique_ptr<TensorBackend>
   createHybrid(std::unique_ptr<TensorBackend> sparse,
-               std::unique_ptr<TensorBackend> dense);
+               std::unique_ptr<TensorBackend> dense,
+               const SparseRouting &routing = {});
 };
 
 } // namespace tl
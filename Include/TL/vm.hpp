@@ -2,11 +2,21 @@
 
 #include "TL/AST.hpp"
 #include "TL/backend.hpp"
+#include "TL/Log.hpp"
+#include "TL/Runtime/AsyncFileIO.hpp"
+#include "TL/Runtime/CompiledProgram.hpp"
 #include "TL/Runtime/ExecutorRegistry.hpp"
 #include "TL/Runtime/PreprocessorRegistry.hpp"
 #include "TL/Runtime/DatalogEngine.hpp"
 #include "TL/Runtime/LearningEngine.hpp"
+#include "TL/Runtime/Profiler.hpp"
+#include "TL/Runtime/RelationStore.hpp"
+#include "TL/Runtime/ThreadPool.hpp"
+#include "TL/Runtime/Preprocessors/VirtualIndexPreprocessor.hpp"
 
+#include <cstdint>
+#include <filesystem>
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -17,50 +27,199 @@
 namespace tl {
 
 // Simple runtime environment that maps tensor names to concrete Tensor values
-// and stores simple Datalog facts (as Boolean relations).
+// and stores Datalog facts. Fact constants are interned to symbol IDs and every
+// relation keeps its tuples column-packed (see RelationStore.hpp).
 class Environment {
 public:
+  // Tensor names are interned into dense slots and values are kept in a
+  // vector indexed by slot. Code that resolves a name once (plans, recurrence
+  // steps) binds and looks it up without hashing; TensorRef overloads cache
+  // the slot on the reference, so executors hash each name once. The name
+  // overloads are the slow path for the REPL, tests and one-off accesses.
+  // A slot stays valid for the environment and its copies, also after erase.
+  using Slot = uint32_t;
+  static constexpr Slot kNoSlot = ~Slot{0};
+  Slot slot(const std::string &name);           // interns on first use
+  Slot slot(const TensorRef &ref);
+  Slot findSlot(const std::string &name) const; // kNoSlot if never interned
+  const std::string &slotName(Slot s) const;
+
+  void bind(Slot s, const Tensor &t);
   void bind(const std::string &name, const Tensor &t);
   void bind(const TensorRef &ref, const Tensor &t);
 
+  bool has(Slot s) const { return s < bound_.size() && bound_[s]; }
   bool has(const std::string &name) const;
   bool has(const TensorRef &ref) const;
 
+  // Removes a tensor; returns false if it was not bound
+  bool erase(const std::string &name);
+
+  // Removes every tensor, label, Datalog symbol and relation. The device,
+  // dtype policy and interned tensor names (hence slots) are kept.
+  void clear();
+
+  const Tensor &lookup(Slot s) const;                   // throws if unbound
   const Tensor &lookup(const std::string &name) const; // throws if missing
   const Tensor &lookup(const TensorRef &ref) const;     // throws if missing
 
-  static std::string key(const TensorRef &ref);
+  // Bound tensor for writing in place (copy on write). Reads hand out views
+  // and aliases of bound tensors, so if the storage is shared with anything
+  // else (another name, a view, a value saved for backward) it is copied
+  // and the copy bound first; a uniquely owned tensor is returned as is.
+  // Throws if missing.
+  Tensor writable(Slot s);
+  Tensor writable(const std::string &name);
+  Tensor writable(const TensorRef &ref);
+
+  static const std::string &key(const TensorRef &ref) { return ref.name.name; }
+
+  // Device tensors live on. bind() moves tensors from other devices, so
+  // executors can build values on the host and still compute on the target;
+  // code that allocates should use tensorOptions() to avoid the copy.
+  // Changing the device moves every bound tensor.
+  const torch::Device &device() const { return device_; }
+  void setDevice(const torch::Device &device);
+  torch::TensorOptions tensorOptions() const {
+    return torch::TensorOptions().dtype(dtype_policy_.value).device(device_);
+  }
 
-  // Label indexing for uppercase constants used as tensor indices
-  // Returns an existing index for label or creates a new one.
+  // Element types for stored values, contractions and masks (see
+  // DTypePolicy). Under a non-default policy bind() casts floating and
+  // Boolean tensors to their storage type; changing the policy re-casts
+  // every bound tensor.
+  const DTypePolicy &dtypePolicy() const { return dtype_policy_; }
+  void setDTypePolicy(const DTypePolicy &policy);
+
+  // Label indexing for uppercase constants used as tensor indices. Labels
+  // and Datalog constants share one dictionary, so W[Alice] and
+  // Parent(Alice, Bob) name the same symbol without translating names.
+  // A symbol becomes a label the first time it is used as a tensor index
+  // and then gets the next axis position, so label axes stay dense;
+  // constants only seen by Datalog are not labels, so deriving them
+  // neither grows labelled tensors nor moves layoutVersion().
+  // Returns the axis position of label, making it a label if it is new.
   int internLabel(const std::string &label);
-  // Returns true and sets outIdx if label has an assigned index.
+  // Returns true and sets outIdx if label has an axis position. Lowercase
+  // names are index variables and never resolve to a label.
   bool getLabelIndex(const std::string &label, int &outIdx) const;
+  // Axis position of a symbol, or -1 if it is not a label
+  int64_t labelAxis(SymbolId id) const {
+    return id < label_axes_.size() ? label_axes_[id] : -1;
+  }
+  // Symbol ID of every label, by axis position
+  const std::vector<SymbolId> &labelSymbols() const { return label_symbols_; }
+  // Makes every constant of a relation a label, in symbol ID order, so the
+  // relation can be projected onto label axes; throws if it does not exist
+  void labelRelation(const std::string &relation);
+
+  // Bulk moves between relations and tensors over the shared dictionary,
+  // scattering and gathering through the symbol ID <-> axis map.
+  // relationTensor gathers a relation into a sparse COO 0/1 tensor with one
+  // axis per column, each spanning every label (in the value type, or the
+  // given one), so its size is the number of facts; throws if the relation
+  // does not exist or holds a constant that is not a label. tensorTuples
+  // gathers the coordinates of the elements above threshold as row-major
+  // tuples of symbol IDs, ready for addFacts; throws if a coordinate is not
+  // a label's axis.
+  Tensor relationTensor(const std::string &relation) const;
+  Tensor relationTensor(const std::string &relation, torch::ScalarType dtype) const;
+  std::vector<SymbolId> tensorTuples(const Tensor &t, double threshold = 0.0) const;
+  // The same with symbol IDs as positions, every axis spanning the whole
+  // dictionary, for evaluating rules as tensors (see TensorDatalog)
+  Tensor symbolTensor(const std::string &relation, torch::ScalarType dtype) const;
+  std::vector<SymbolId> symbolTuples(const Tensor &t, double threshold = 0.0) const;
+
+  // Bumped whenever a new tensor name or label appears or a name is erased
+  // (rebinding an existing name does not count). Executor selection only depends on which names and
+  // labels exist, so a choice made under one version stays valid for it.
+  uint64_t layoutVersion() const { return layout_version_; }
+
+  // Capacity-tracked storage for tensors grown by element writes such as
+  // W[Alice] = 1.0 (see executor_utils::ensureTensorSize). The storage is
+  // over-allocated per axis and the bound tensor is the leading window of
+  // it; everything outside the window is zero. Binding a tensor that does
+  // not share the storage drops it.
+  struct GrowthStorage {
+    Tensor storage;
+    std::vector<int64_t> window;
+  };
+  const GrowthStorage *growthStorage(const std::string &name) const; // nullptr if none
+  void setGrowthStorage(const std::string &name, const Tensor &storage,
+                        std::vector<int64_t> window);
 
-  // Datalog fact storage helpers (Phase 1 minimal)
-  bool addFact(const DatalogFact &f); // returns true if inserted new fact
-  bool addFact(const std::string &relation, const std::vector<std::string> &tuple); // returns true if new
+  // Datalog fact storage helpers. All overloads return true if the fact is new
+  // and throw if the tuple arity differs from the relation's existing tuples.
+  bool addFact(const DatalogFact &f);
+  bool addFact(const std::string &relation, const std::vector<std::string> &tuple);
+  bool addFact(const std::string &relation, const std::vector<SymbolId> &tuple); // interned constants
+  // count tuples of interned constants packed row-major; returns how many were new
+  size_t addFacts(const std::string &relation, size_t arity, const SymbolId *tuples, size_t count);
   bool hasRelation(const std::string &relation) const;
-  const std::vector<std::vector<std::string>> &facts(const std::string &relation) const; // empty if missing
+  bool removeRelation(const std::string &relation); // drops its facts; false if missing
+  const Relation *relation(const std::string &name) const; // nullptr if missing
+  // String view of a relation's tuples, materialized on demand (empty if missing)
+  const std::vector<std::vector<std::string>> &facts(const std::string &relation) const;
 
-  // Expose tensors and relations for introspection (e.g., REPL)
-  const std::unordered_map<std::string, Tensor> &tensors() const { return tensors_; }
-  const std::unordered_map<std::string, std::vector<std::vector<std::string>>> &relations() const { return datalog_; }
+  // Interner for Datalog constants
+  SymbolTable &symbols() { return symbols_; }
+  const SymbolTable &symbols() const { return symbols_; }
+
+  // Expose tensors and relations for introspection (e.g., REPL); tensors
+  // are collected by name on every call
+  std::map<std::string, Tensor> tensors() const;
+  const std::unordered_map<std::string, Relation> &relations() const { return relations_; }
 
 private:
-  std::unordered_map<std::string, Tensor> tensors_;
-  // Global mapping from string labels (e.g., Alice) to stable integer indices for tensor axes.
-  std::unordered_map<std::string, int> labelToIndex_;
-  // Map relation -> list of tuples (each tuple is a vector of constants as strings)
-  std::unordered_map<std::string, std::vector<std::vector<std::string>>> datalog_;
-  // For fast deduplication: per-relation set of serialized tuples
-  std::unordered_map<std::string, std::unordered_set<std::string>> datalog_set_;
+  Relation &relationFor(const std::string &name, size_t arity); // creates on first use
+  // Slot cached on ref for this name table, or kNoSlot
+  Slot cachedSlot(const TensorRef &ref) const;
+  void cacheSlot(const TensorRef &ref, Slot s) const;
+
+  // Interned names, shared by copies of an environment until one of them
+  // interns a new name (copy on write). Every table has its own id, so slot
+  // caches on references tell tables apart; an id only ever gains names.
+  struct Names {
+    Names();
+    Names(const Names &other);
+    uint32_t id;
+    std::unordered_map<std::string, Slot> index;
+    std::vector<std::string> names;
+  };
+
+  std::shared_ptr<Names> names_{std::make_shared<Names>()};
+  std::vector<Tensor> values_;  // by slot; may be shorter than names_
+  std::vector<char> bound_;     // by slot; bound tensors may be undefined
+  torch::Device device_{torch::kCPU};
+  DTypePolicy dtype_policy_;
+  uint64_t layout_version_{0};
+  std::unordered_map<std::string, GrowthStorage> growth_storage_;
+  // Datalog constants and tensor-index labels
+  SymbolTable symbols_;
+  // By symbol ID: axis position of a label, -1 for other symbols
+  std::vector<int64_t> label_axes_;
+  // By axis position: symbol ID of the label
+  std::vector<SymbolId> label_symbols_;
+  // Map relation -> column-packed, deduplicated tuples of symbol IDs
+  std::unordered_map<std::string, Relation> relations_;
+  // String tuples handed out by facts(); extended lazily as relations grow
+  mutable std::unordered_map<std::string, std::vector<std::vector<std::string>>> factViews_;
 };
 
-// Minimal router for Phase 1: route tensor equations to LibTorch.
+// Routes work between backends. Statements are planned for LibTorch; the
+// sparse/dense choice depends on operand values, so it is made per einsum.
 class BackendRouter {
 public:
   static BackendType analyze(const Statement &st);
+  // Sparse if an operand is sparse or meets the routing density bound
+  static BackendType analyze(const std::vector<Tensor> &operands,
+                             const SparseRouting &routing = {});
+  // Dense operands that meet the routing density bound, to be converted to
+  // COO; all false unless routing.probeDense. Each is scanned at most once.
+  static std::vector<bool> denseToConvert(const std::vector<Tensor> &operands,
+                                          const SparseRouting &routing);
+  // Fraction of nonzero elements (1 for empty tensors)
+  static double density(const Tensor &t);
 };
 
 // Interpreted VM (Phase 1): walk statements and execute eagerly.
@@ -72,25 +231,242 @@ public:
   void setDebug(bool enabled);
   bool debug() const;
 
+  // Device for tensor storage and computation (CPU by default, or the
+  // TL_DEVICE environment variable, see parseDevice). Tensors already
+  // bound are moved to the new device.
+  void setDevice(const torch::Device &device);
+  torch::Device device() const;
+
+  // Element type policy (fp32 by default, or the TL_DTYPE environment
+  // variable, see DTypePolicy::parse). Applies to the environment and the
+  // backend's contractions.
+  void setDTypePolicy(const DTypePolicy &policy);
+  const DTypePolicy &dtypePolicy() const;
+
+  // Run virtual-index groups (State[i, *t+1] = ...) and fixed-point loops
+  // as a native loop over a step body compiled once (on by default). When
+  // disabled, or for bodies that cannot be lowered, every timestep is
+  // expanded into equations.
+  void setNativeRecurrence(bool enabled) { native_recurrence_ = enabled; }
+  bool nativeRecurrence() const { return native_recurrence_; }
+
+  // Threads that run the independent steps of a native recurrence together,
+  // such as layer 2 at time t - 1 alongside layer 1 at time t (0 = the
+  // process-wide ThreadPool::shared(), 1 = run every step in program order)
+  void setRecurrenceThreads(size_t threads);
+  size_t recurrenceThreads() const { return recurrence_threads_; }
+
+  // Skip statements that contribute to no query or file write (see
+  // CompiledProgram::live), including Datalog rules whose relations nothing
+  // reads. Off by default: skipped tensors and relations are then missing
+  // from the environment. Not applied to append(), whose later fragments
+  // may read anything, or while streamed file bindings are configured.
+  void setDeadCodeElimination(bool enabled) { dead_code_elimination_ = enabled; }
+  bool deadCodeElimination() const { return dead_code_elimination_; }
+
+  // Drop tensors the program wrote from the environment as soon as no later
+  // statement uses them (see CompiledProgram::releasedAfter), so their
+  // storage returns to the allocator for the statements that follow. Off by
+  // default, for the same reasons and with the same exceptions as dead-code
+  // elimination; query targets are always kept. Attention chains whose
+  // weights are released this way run as one kernel that never binds them
+  // (see CompiledProgram::attentionAt).
+  void setReleaseIntermediates(bool enabled) { release_intermediates_ = enabled; }
+  bool releaseIntermediates() const { return release_intermediates_; }
+
+  // Overlap tensor file I/O with computation (on by default). A run starts
+  // reading every T = file("...") binding when it begins, except for files
+  // an earlier statement of the run writes and streamed bindings, and the
+  // binding statement only waits for what is still being read. Writes
+  // (file("...") = T) run in the background and are flushed when the run
+  // ends, so a failed write is reported there rather than by its statement;
+  // files the run reads again wait for their writes first. Relation files
+  // are read and written in place.
+  void setAsyncFileIO(bool enabled) { async_file_io_ = enabled; }
+  bool asyncFileIO() const { return async_file_io_; }
+
+  // Threads that run independent tensor equations of a program together
+  // (0 = the process-wide ThreadPool::shared(), 1 = run every statement in
+  // source order).
+  // Consecutive equations are ordered by the tensors they read and write;
+  // ones that only read the environment and bind a fresh result run
+  // concurrently once what they read is computed, and results are bound in
+  // source order, so the environment ends up as after sequential execution.
+  // Debug runs are always sequential.
+  void setStatementThreads(size_t threads);
+  size_t statementThreads() const { return statement_threads_; }
+
+  // Process-wide thread budget shared by every VM and LibTorch: sets
+  // LibTorch's intra-op and inter-op thread counts and reconfigures
+  // ThreadPool::shared(), which runs the statement, recurrence, Datalog and
+  // sampling loops of components left at 0 threads. An intra-op count of 0
+  // keeps LibTorch's own (OMP_NUM_THREADS or the core count) and sizes the
+  // shared pool to match. Call before running programs: LibTorch accepts a
+  // new inter-op count only before its first inter-op work, and
+  // std::runtime_error is thrown after that.
+  static void setThreadOptions(const ThreadOptions &options);
+  static ThreadOptions threadOptions() { return ThreadPool::options(); }
+
+  // Convergence settings of fixed-point loops: the default for every loop,
+  // and overrides for the loop over a given tensor (x[*t+1] = ... is the
+  // loop over "x"). Throws std::invalid_argument for non-positive counts or
+  // a negative tolerance.
+  void setConvergenceOptions(const ConvergenceOptions &options);
+  void setConvergenceOptions(const std::string &tensor, const ConvergenceOptions &options);
+  const ConvergenceOptions &convergenceOptions(const std::string &tensor) const;
+
+  // Iterations performed by the last run of each fixed-point loop, by tensor
+  const std::unordered_map<std::string, ConvergenceReport> &convergenceReports() const {
+    return convergence_reports_;
+  }
+
+  // Read tensor = file("...") bindings of `tensor` in chunks of `rows` along
+  // the first axis instead of loading the whole file (0 loads it whole
+  // again). The equations that follow the binding run once per chunk while
+  // they work row by row: those keeping the row index produce one chunk of
+  // rows, and file("...") = T writes of such tensors append them. Equations
+  // that reduce over the rows (sum-of-products =, +=, max=, min=) combine
+  // their chunks' results and are the only values bound afterwards; the
+  // streamed and row-wise tensors are removed. Consecutive streamed
+  // bindings are read together and must have the same number of rows.
+  // Throws std::invalid_argument for negative rows.
+  void setStreamRows(const std::string &tensor, int64_t rows);
+  int64_t streamRows(const std::string &tensor) const;
+
   // Execute a full program. For Phase 1, this executes tensor equations
   // that we can interpret (currently limited to einsum calls with existing
   // tensors in the environment). Adds minimal Datalog fact/query support.
   void execute(const Program &program);
 
+  // Lower a program into a reusable plan (see CompiledProgram.hpp), then run
+  // it any number of times. execute(program) is compile + execute(plan).
+  CompiledProgram compile(const Program &program) const;
+  void execute(CompiledProgram &plan);
+
+  // Incremental session, as used by the REPL: compiles and runs only
+  // `statements`, which then stay part of the session. Earlier statements
+  // are not re-run, Datalog facts and rules extend the closure computed so
+  // far, and learning directives see every equation of the session rather
+  // than only those of their own fragment. A fragment that throws is not
+  // kept (effects of its statements that ran remain).
+  void append(const Program &statements);
+  const Program &session() const { return session_; }
+
+  // Answer a query without printing it: the tensor or selected element of
+  // a tensor query, or the answers of a Datalog query as columns of symbol
+  // IDs, after saturating the rules or deriving what the query needs (see
+  // DatalogEngine::solve). Large results can be consumed as data or written
+  // with query_io::write instead of formatted as text; @limit, @exists and
+  // @topk trim them where they are computed (see QueryModifiers). Throws
+  // std::invalid_argument for queries with a learning directive.
+  QueryResult query(const Query &q);
+
+  // Move data between the neural and symbolic halves in bulk. Labels and
+  // Datalog constants share one dictionary (see Environment::internLabel),
+  // so projectRelation binds `tensor` to the sparse 0/1 tensor of
+  // `relation`'s facts with the derived facts included, over label axes
+  // (see Environment::relationTensor), making the relation's constants
+  // labels so its positions can be read by name, and
+  // thresholdTensor asserts a fact in `relation` for every element of
+  // `tensor` above threshold, returning how many were new. Throws if the
+  // relation or tensor does not exist.
+  void projectRelation(const std::string &relation, const std::string &tensor);
+  size_t thresholdTensor(const std::string &tensor, const std::string &relation, double threshold = 0.0);
+
+  // Write the environment and the Datalog rules, with the status of their
+  // closure, to a snapshot file, or replace them with the contents of one
+  // (see snapshot_io). A restored VM answers queries from the saved closure
+  // and extends it incrementally as facts and rules are added, and its
+  // tensors are read from the mapped file as they are first used. Settings,
+  // the session and compiled plans are not part of a snapshot.
+  void saveSnapshot(const std::filesystem::path &path) const;
+  void loadSnapshot(const std::filesystem::path &path);
+
   // Access the environment (e.g., for tests or embedding)
   Environment &env() { return env_; }
   const Environment &env() const { return env_; }
 
+  // Report every statement a run executes to `profiler` (not owned; nullptr
+  // disables): its wall time, the executor that ran an equation (or the
+  // statement kind), the shapes of the tensors it read and bound, the bytes
+  // of the bound value and a FLOP estimate, two per point of the iteration
+  // space when an index is summed out and one per result element otherwise.
+  // The Datalog and learning engines report rules, saturations and epochs
+  // to the same profiler. Profiled runs execute statements one at a time.
+  void setProfiler(Profiler *profiler);
+  Profiler *profiler() const { return profiler_; }
+
+  // Access the executor registry (e.g., for dispatch and timing statistics)
+  ExecutorRegistry &executors() { return executor_registry_; }
+  const ExecutorRegistry &executors() const { return executor_registry_; }
+
+  // Access the Datalog engine (e.g., to select its evaluation strategy)
+  DatalogEngine &datalog() { return datalog_engine_; }
+  const DatalogEngine &datalog() const { return datalog_engine_; }
+
+  // Access the learning engine (e.g., to inspect the last training plan)
+  LearningEngine &learning() { return *learning_engine_; }
+  const LearningEngine &learning() const { return *learning_engine_; }
+
 private:
+  friend class Model;
+
+  // Context VM of a Model: copies `prototype`'s environment (sharing its
+  // tensors), settings and Datalog rules, and shares its executors. The
+  // profiler, session and convergence reports are not carried over.
+  TensorLogicVM(const TensorLogicVM &prototype, std::ostream *out, std::ostream *err);
+
+  // Runs a plan; directives see `context` as the program being executed.
+  // With prune, instructions the plan marks dead are skipped; with release,
+  // tensors are erased after their last use.
+  void run(CompiledProgram &plan, const Program &context, bool prune, bool release);
   void execTensorEquation(const TensorEquation &eq);
+  void execTensorEquation(const TensorEquation &eq, TensorEquationExecutor &executor);
+  // Binds an equation's computed value, writing into the LHS tensor for
+  // indexed assignments
+  void commitEquation(const TensorEquation &eq, const Tensor &result);
+  void execStatement(const Statement &st);
+  void execFileOperation(const FileOperation &fo);
+  // Starts reading the tensor files the plan binds (see setAsyncFileIO)
+  void prefetchFiles(const CompiledProgram &plan, bool prune);
+  // Executor of plan instruction k, an equation, reselected when the layout changed
+  TensorEquationExecutor &executorFor(CompiledProgram &plan, size_t k);
+  // Runs plan instruction k, an equation, with its cached executor
+  void runEquation(CompiledProgram &plan, size_t k);
+  // Runs the attention chain ending at instruction k as one kernel, or its
+  // equations one by one if the kernel does not apply; true if fused
+  bool runAttention(CompiledProgram &plan, size_t k);
+  // Runs the equations at instructions [first, last) level by level of
+  // their dependencies, the independent ones of a level concurrently
+  void runEquations(CompiledProgram &plan, size_t first, size_t last);
+  bool startsStream(const CompiledProgram &plan, size_t k) const;
+  // Runs the streamed bindings at instruction `first` and the statements
+  // that follow chunk by chunk; returns the last instruction it ran
+  size_t executeStream(CompiledProgram &plan, size_t first);
   void execQuery(const Query &q);
+  // Keeps the @topk elements and @limit rows of a tensor query's result
+  void applyModifiers(const QueryModifiers &modifiers, QueryResult &result) const;
   void executeFixedPointLoop(const FixedPointLoop &loop);
+  // Runs the virtual-indexed batch, natively where it can be lowered;
+  // checkpoint is passed to executeRecurrence
+  void executeVirtualBatch(const std::vector<Statement> &statements, int checkpoint = 0);
+  // Reruns a batch for a training loop from the values its tensors had
+  // before the program's batch ran
+  void replayRecurrences(const std::vector<Statement> &statements, int checkpoint);
+  // Returns the iterations performed and whether the monitored state
+  // converged. With checkpoint != 0 and gradients enabled, only every k-th
+  // step's values are kept for the backward pass and the steps between are
+  // recomputed there (k = checkpoint, or about sqrt(steps) for -1)
+  ConvergenceReport executeRecurrence(const Recurrence &rec, int checkpoint = 0);
   TensorEquation substituteVirtualIndex(const TensorEquation &eq, int concreteTimeStep);
   void substituteVirtualIndexInExpr(Expr &expr, int concreteTimeStep);
   void initializeExecutors();
   void initializePreprocessors();
 
   void debugLog(const std::string &msg) const;
+  // Whether messages of `level` are compiled in and debug output is on;
+  // guards blocks that format a message over several statements
+  bool logging(LogLevel level) const { return logCompiled(level) && debug_; }
 
   // Output streams for normal output and errors/debug
   std::ostream* output_stream_ { &std::cout };
@@ -100,11 +476,27 @@ private:
   BackendRouter router_;
   Environment env_;
   bool debug_{false};
+  bool native_recurrence_{true};
+  bool dead_code_elimination_{false};
+  bool release_intermediates_{false};
+  bool async_file_io_{true};
+  AsyncFileIO file_io_;  // prefetches of the current run and unflushed writes
+  size_t recurrence_threads_{0};
+  std::shared_ptr<ThreadPool> recurrence_pool_;  // obtained by each concurrent recurrence
+  size_t statement_threads_{0};
+  std::shared_ptr<ThreadPool> statement_pool_;  // obtained by each concurrent run
+  std::unordered_map<std::string, Tensor> recurrence_inputs_;  // tensors of the last batch before it ran
+  ConvergenceOptions convergence_defaults_;
+  std::unordered_map<std::string, ConvergenceOptions> convergence_options_;
+  std::unordered_map<std::string, ConvergenceReport> convergence_reports_;
+  std::unordered_map<std::string, int64_t> stream_rows_;
   PreprocessorRegistry preprocessor_registry_;
   ExecutorRegistry executor_registry_;
   DatalogEngine datalog_engine_;
   std::unique_ptr<LearningEngine> learning_engine_;
-  Program current_program_;  // Store current program for learning directives
+  Profiler *profiler_{nullptr};
+  const Program *current_program_{nullptr};  // Program being executed, for learning directives
+  Program session_;                          // statements appended so far
 };
 
 } // namespace tl
@@ -0,0 +1,318 @@
+#include "TL/Batcher.hpp"
+
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_set>
+
+namespace tl {
+
+namespace {
+// Adds a leading batch index to every reference to a batched tensor
+class BatchRewriter {
+public:
+  BatchRewriter(const Environment &parameters, const std::vector<std::string> &inputs)
+      : parameters_(parameters), batched_(inputs.begin(), inputs.end()), inputs_(inputs.begin(), inputs.end()) {}
+
+  // The rewritten program, or false if some statement cannot carry the index
+  bool rewrite(const Program &program, Program &out) {
+    batchIndex_ = pickIndexName(program);
+    for (const auto &st : program.statements) {
+      if (const auto *eq = std::get_if<TensorEquation>(&st)) {
+        TensorEquation rewritten;
+        if (!rewriteEquation(*eq, rewritten)) return false;
+        out.statements.emplace_back(std::move(rewritten));
+      } else if (const auto *q = std::get_if<Query>(&st)) {
+        if (q->directive || !q->modifiers.empty() || !q->body.empty() || !std::holds_alternative<TensorRef>(q->target)) return false;
+        out.statements.push_back(st);
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const std::set<std::string> &batched() const { return batched_; }
+
+private:
+  bool rewriteEquation(const TensorEquation &eq, TensorEquation &out) {
+    const std::string &lhs = eq.lhs.name.name;
+    if (inputs_.count(lhs) || hasVirtualIndex(eq.lhs)) return false;
+    readsBatched_ = false;
+    ok_ = true;
+    out = eq;
+    for (auto &clause : out.clauses) {
+      if (clause.expr) clause.expr = rewrite(clause.expr);
+      if (clause.guard && *clause.guard) *clause.guard = rewrite(*clause.guard);
+    }
+    if (!ok_) return false;
+    if (!readsBatched_) {
+      // Writing into a batched tensor without the index would be ambiguous
+      if (batched_.count(lhs)) return false;
+      unbatched_.insert(lhs);
+      return true;
+    }
+    // A tensor bound before the batch (a parameter or an unbatched result) has no batch axis
+    if (unbatched_.count(lhs) || (parameters_.has(lhs) && !batched_.count(lhs))) return false;
+    batched_.insert(lhs);
+    prependBatchIndex(out.lhs);
+    return true;
+  }
+
+  // Returns `expr` itself when nothing under it changes
+  ExprPtr rewrite(const ExprPtr &expr) {
+    if (!expr) return expr;
+    return std::visit(
+        [&](const auto &node) -> ExprPtr {
+          using T = std::decay_t<decltype(node)>;
+          if constexpr (std::is_same_v<T, ExprTensorRef>) {
+            if (hasVirtualIndex(node.ref)) ok_ = false;
+            if (!batched_.count(node.ref.name.name)) return expr;
+            // A bare name stands for the whole tensor, which gains an axis
+            if (node.ref.indices.empty()) ok_ = false;
+            readsBatched_ = true;
+            auto copy = std::make_shared<Expr>(*expr);
+            prependBatchIndex(std::get<ExprTensorRef>(copy->node).ref);
+            return copy;
+          } else if constexpr (std::is_same_v<T, ExprParen>) {
+            ExprPtr inner = rewrite(node.inner);
+            if (inner == node.inner) return expr;
+            return std::make_shared<Expr>(Expr{expr->loc, ExprParen{inner}});
+          } else if constexpr (std::is_same_v<T, ExprCall>) {
+            ExprCall call = node;
+            bool changed = false;
+            for (auto &arg : call.args) {
+              ExprPtr next = rewrite(arg);
+              changed |= next != arg;
+              arg = std::move(next);
+            }
+            return changed ? std::make_shared<Expr>(Expr{expr->loc, std::move(call)}) : expr;
+          } else if constexpr (std::is_same_v<T, ExprBinary>) {
+            ExprPtr lhs = rewrite(node.lhs), rhs = rewrite(node.rhs);
+            if (lhs == node.lhs && rhs == node.rhs) return expr;
+            return std::make_shared<Expr>(Expr{expr->loc, ExprBinary{node.op, lhs, rhs}});
+          } else if constexpr (std::is_same_v<T, ExprUnary>) {
+            ExprPtr operand = rewrite(node.operand);
+            if (operand == node.operand) return expr;
+            return std::make_shared<Expr>(Expr{expr->loc, ExprUnary{node.op, operand}});
+          } else {
+            return expr;  // literals
+          }
+        },
+        expr->node);
+  }
+
+  void prependBatchIndex(TensorRef &ref) const {
+    Index index;
+    index.value = Identifier{batchIndex_, ref.loc};
+    ref.indices.insert(ref.indices.begin(), IndexOrSlice{index, ref.loc});
+  }
+
+  static bool hasVirtualIndex(const TensorRef &ref) {
+    for (const auto &ios : ref.indices) {
+      const auto *index = std::get_if<Index>(&ios.value);
+      if (index && std::holds_alternative<VirtualIndex>(index->value)) return true;
+    }
+    return false;
+  }
+
+  // "batch", or "batch2", "batch3", ... if the program uses that index already
+  static std::string pickIndexName(const Program &program) {
+    std::unordered_set<std::string> used;
+    auto collectRef = [&](const TensorRef &ref) {
+      for (const auto &ios : ref.indices) {
+        const auto *index = std::get_if<Index>(&ios.value);
+        if (index) {
+          if (const auto *id = std::get_if<Identifier>(&index->value)) used.insert(id->name);
+        }
+      }
+    };
+    std::function<void(const ExprPtr &)> collect = [&](const ExprPtr &expr) {
+      if (!expr) return;
+      std::visit(
+          [&](const auto &node) {
+            using T = std::decay_t<decltype(node)>;
+            if constexpr (std::is_same_v<T, ExprTensorRef>) {
+              collectRef(node.ref);
+            } else if constexpr (std::is_same_v<T, ExprParen>) {
+              collect(node.inner);
+            } else if constexpr (std::is_same_v<T, ExprCall>) {
+              for (const auto &arg : node.args) collect(arg);
+            } else if constexpr (std::is_same_v<T, ExprBinary>) {
+              collect(node.lhs);
+              collect(node.rhs);
+            } else if constexpr (std::is_same_v<T, ExprUnary>) {
+              collect(node.operand);
+            }
+          },
+          expr->node);
+    };
+    for (const auto &st : program.statements) {
+      const auto *eq = std::get_if<TensorEquation>(&st);
+      if (!eq) continue;
+      collectRef(eq->lhs);
+      for (const auto &clause : eq->clauses) {
+        collect(clause.expr);
+        if (clause.guard) collect(*clause.guard);
+      }
+    }
+    std::string name = "batch";
+    for (int n = 2; used.count(name); ++n) name = "batch" + std::to_string(n);
+    return name;
+  }
+
+  const Environment &parameters_;
+  std::set<std::string> batched_;
+  std::unordered_set<std::string> unbatched_;  // written by the program without the index
+  std::unordered_set<std::string> inputs_;
+  std::string batchIndex_;
+  bool readsBatched_{false};
+  bool ok_{true};
+};
+
+// Requests can share a batch when they bind tensors of the same shapes and types
+bool stackable(const std::map<std::string, Tensor> &a, const std::map<std::string, Tensor> &b) {
+  for (const auto &kv : a) {
+    const Tensor &other = b.at(kv.first);
+    if (kv.second.sizes() != other.sizes() || kv.second.scalar_type() != other.scalar_type() ||
+        kv.second.device() != other.device()) {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+Batcher::Batcher(const Model &model, std::vector<std::string> inputs, std::vector<std::string> outputs,
+                 BatchOptions options)
+    : model_(model), inputs_(std::move(inputs)), outputs_(std::move(outputs)), options_(options) {
+  if (options_.maxBatch == 0) throw std::invalid_argument("Batcher maxBatch must be positive");
+  BatchRewriter rewriter(model_.parameters(), inputs_);
+  Program program;
+  if (options_.maxBatch > 1 && rewriter.rewrite(model_.plan().program(), program)) {
+    batched_model_ = std::make_unique<Model>(model_.derive(program));
+    batched_tensors_ = rewriter.batched();
+  }
+  if (batched_model_) dispatcher_ = std::thread([this] { dispatchLoop(); });
+}
+
+Batcher::~Batcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (dispatcher_.joinable()) dispatcher_.join();
+}
+
+const Program &Batcher::batchedProgram() const {
+  static const Program empty;
+  return batched_model_ ? batched_model_->plan().program() : empty;
+}
+
+size_t Batcher::requests() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return requests_;
+}
+
+size_t Batcher::batches() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return batches_;
+}
+
+std::future<Batcher::Result> Batcher::submit(std::map<std::string, Tensor> inputs) {
+  Request request;
+  request.inputs = std::move(inputs);
+  request.arrived = std::chrono::steady_clock::now();
+  auto future = request.promise.get_future();
+
+  bool valid = request.inputs.size() == inputs_.size();
+  for (const auto &name : inputs_) valid = valid && request.inputs.count(name) && request.inputs.at(name).defined();
+  if (!valid) {
+    request.promise.set_exception(std::make_exception_ptr(
+        std::invalid_argument("A batched request must bind exactly the batcher's inputs")));
+    return future;
+  }
+
+  if (!batched_model_) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++requests_;
+    }
+    runSingle(request);
+    return future;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++requests_;
+    queue_.push_back(std::move(request));
+  }
+  cv_.notify_all();
+  return future;
+}
+
+void Batcher::dispatchLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+    if (queue_.empty()) return;
+    // The first request waits at most maxLatency for others to join it
+    const auto deadline = queue_.front().arrived + options_.maxLatency;
+    cv_.wait_until(lock, deadline, [&] { return stop_ || queue_.size() >= options_.maxBatch; });
+
+    std::vector<Request> batch;
+    batch.push_back(std::move(queue_.front()));
+    queue_.pop_front();
+    for (auto it = queue_.begin(); it != queue_.end() && batch.size() < options_.maxBatch;) {
+      if (stackable(batch.front().inputs, it->inputs)) {
+        batch.push_back(std::move(*it));
+        it = queue_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (batch.size() > 1) ++batches_;
+    lock.unlock();
+    runBatch(batch);
+    lock.lock();
+  }
+}
+
+void Batcher::runBatch(std::vector<Request> &batch) {
+  if (batch.size() == 1) {
+    runSingle(batch.front());
+    return;
+  }
+  Result results;
+  try {
+    std::map<std::string, Tensor> stacked;
+    std::vector<Tensor> parts(batch.size());
+    for (const auto &name : inputs_) {
+      for (size_t r = 0; r < batch.size(); ++r) parts[r] = batch[r].inputs.at(name);
+      stacked.emplace(name, torch::stack(parts));
+    }
+    results = batched_model_->evaluate(stacked, outputs_);
+  } catch (...) {
+    // One bad request should not fail the others
+    for (auto &request : batch) runSingle(request);
+    return;
+  }
+  for (size_t r = 0; r < batch.size(); ++r) {
+    Result own;
+    for (const auto &kv : results) {
+      own.emplace(kv.first, batched_tensors_.count(kv.first) ? kv.second.select(0, static_cast<int64_t>(r))
+                                                             : kv.second);
+    }
+    batch[r].promise.set_value(std::move(own));
+  }
+}
+
+void Batcher::runSingle(Request &request) {
+  try {
+    request.promise.set_value(model_.evaluate(request.inputs, outputs_));
+  } catch (...) {
+    request.promise.set_exception(std::current_exception());
+  }
+}
+
+} // namespace tl
@@ -92,10 +92,16 @@ namespace tl::lex {
     template< typename Rule > struct action : pegtl::nothing< Rule > {};
 
     struct TokenSink {
-        std::vector<Token> out;
+        std::vector<Token>& out;
+        std::deque<std::string>& unescaped;
     };
 
-    static std::string unescape(const std::string& s) {
+    template< typename Input >
+    static std::string_view textOf(const Input& in) {
+        return std::string_view(in.begin(), in.size());
+    }
+
+    static std::string unescape(std::string_view s) {
         if (s.empty()) return {};
         char quote = s.front();
         size_t i = 1;
@@ -133,7 +139,7 @@ namespace tl::lex {
     template<> struct action< identifier > {
         template< typename Input >
         static void apply(const Input& in, TokenSink& sink) {
-            Token t; t.text = in.string(); t.loc = locFrom(in.position());
+            Token t; t.text = textOf(in); t.loc = locFrom(in.position());
             // Check for keywords
             if (t.text == "and") {
                 t.type = Token::KwAnd;
@@ -152,8 +158,8 @@ namespace tl::lex {
     template<> struct action< number > {
         template< typename Input >
         static void apply(const Input& in, TokenSink& sink) {
-            Token t; t.text = in.string(); t.loc = locFrom(in.position());
-            if (t.text.find_first_of(".eE") != std::string::npos) t.type = Token::Float; else t.type = Token::Integer;
+            Token t; t.text = textOf(in); t.loc = locFrom(in.position());
+            if (t.text.find_first_of(".eE") != std::string_view::npos) t.type = Token::Float; else t.type = Token::Integer;
             sink.out.push_back(std::move(t));
         }
     };
@@ -162,8 +168,15 @@ namespace tl::lex {
     template<> struct action< string_lit > {
         template< typename Input >
         static void apply(const Input& in, TokenSink& sink) {
-            Token t; t.type = Token::String; t.text = unescape(in.string()); t.loc = locFrom(in.position());
-            sink.out.push_back(std::move(t));
+            Token t; t.type = Token::String; t.loc = locFrom(in.position());
+            const std::string_view quoted = textOf(in);
+            // Without escapes the content is the source between the quotes
+            if (quoted.find('\\') == std::string_view::npos) {
+                t.text = quoted.substr(1, quoted.size() - 2);
+            } else {
+                t.text = sink.unescaped.emplace_back(unescape(quoted));
+            }
+            sink.out.push_back(t);
         }
     };
 
@@ -171,7 +184,7 @@ namespace tl::lex {
     template<> struct action< rule_name > { \
         template< typename Input > \
         static void apply(const Input& in, TokenSink& sink) { \
-            Token t; t.type = token_type; t.text = std::string(1, ch); t.loc = locFrom(in.position()); \
+            Token t; t.type = token_type; t.text = textOf(in); t.loc = locFrom(in.position()); \
             sink.out.push_back(std::move(t)); \
         } \
     };
@@ -215,7 +228,7 @@ namespace tl::lex {
     template<> struct action< larrow > {
         template< typename Input >
         static void apply(const Input& in, TokenSink& sink) {
-            Token t; t.type = Token::LArrow; t.text = in.string(); t.loc = locFrom(in.position());
+            Token t; t.type = Token::LArrow; t.text = textOf(in); t.loc = locFrom(in.position());
             sink.out.push_back(std::move(t));
         }
     };
@@ -225,7 +238,7 @@ namespace tl::lex {
     template<> struct action< rule > { \
         template< typename Input > \
         static void apply(const Input& in, TokenSink& sink) { \
-            Token t; t.type = tokentype; t.text = in.string(); t.loc = locFrom(in.position()); \
+            Token t; t.type = tokentype; t.text = textOf(in); t.loc = locFrom(in.position()); \
             sink.out.push_back(std::move(t)); \
         } \
     };
@@ -241,22 +254,21 @@ namespace tl::lex {
     template<> struct action< unknown_char > {
         template< typename Input >
         static void apply(const Input& in, TokenSink& sink) {
-            Token t; t.type = Token::Unknown; t.text = in.string(); t.loc = locFrom(in.position());
+            Token t; t.type = Token::Unknown; t.text = textOf(in); t.loc = locFrom(in.position());
             sink.out.push_back(std::move(t));
         }
     };
 
     TokenStream::TokenStream(std::string_view src) {
         pegtl::memory_input in(src, "<input>");
-        TokenSink sink;
+        TokenSink sink{tokens_, unescaped_};
         pegtl::parse< tokens_grammar, action >(in, sink);
         Token end; end.type = Token::End; end.text = ""; end.loc = {0,0};
-        sink.out.push_back(std::move(end));
-        tokens_ = std::move(sink.out);
+        tokens_.push_back(end);
     }
 
     const Token& TokenStream::peek() const { return tokens_[idx_]; }
     const Token& TokenStream::lookahead(size_t n) const { return tokens_[idx_ + n]; }
-    Token TokenStream::consume() { return tokens_[idx_++]; }
+    const Token& TokenStream::consume() { return tokens_[idx_++]; }
 
 }
@@ -0,0 +1,44 @@
+#include "TL/Model.hpp"
+
+#include <stdexcept>
+
+namespace tl {
+
+Model::Model(const TensorLogicVM &vm, const Program &program) {
+  auto prototype = std::unique_ptr<TensorLogicVM>(new TensorLogicVM(vm, &std::cout, &std::cerr));
+  plan_ = prototype->compile(program);
+  // Interning every name the program uses here keeps the contexts on the
+  // model's name table, so they need not copy it and the slots cached on
+  // the shared syntax tree stay valid for all of them
+  for (const auto &name : plan_.slots()) prototype->env_.slot(name);
+  prototype_ = std::move(prototype);
+}
+
+Model Model::derive(const Program &program) const { return Model(*prototype_, program); }
+
+std::unique_ptr<TensorLogicVM> Model::context(std::ostream *out, std::ostream *err) const {
+  return std::unique_ptr<TensorLogicVM>(new TensorLogicVM(*prototype_, out, err));
+}
+
+void Model::run(TensorLogicVM &context) const {
+  CompiledProgram plan = plan_;
+  context.execute(plan);
+}
+
+std::map<std::string, Tensor> Model::evaluate(const std::map<std::string, Tensor> &inputs,
+                                              const std::vector<std::string> &outputs,
+                                              std::ostream *out) const {
+  std::ostream discard(nullptr);
+  auto vm = context(out ? out : &discard, &std::cerr);
+  for (const auto &input : inputs) vm->env().bind(input.first, input.second);
+  run(*vm);
+
+  std::map<std::string, Tensor> results;
+  for (const auto &name : outputs) {
+    if (!vm->env().has(name)) throw std::runtime_error("Model output '" + name + "' is not bound after the run");
+    results.emplace(name, vm->env().lookup(name));
+  }
+  return results;
+}
+
+} // namespace tl
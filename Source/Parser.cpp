@@ -1,5 +1,7 @@
 #include "TL/Parser.hpp"
+#include <algorithm>
 #include <fstream>
+#include <memory_resource>
 #include <sstream>
 #include "TL/Lexer.hpp"
 
@@ -10,9 +12,36 @@ namespace {
 using tl::lex::Token;
 using tl::lex::TokenStream;
 
+// Expression nodes of one parse are carved from shared chunks instead of
+// one heap allocation each. Every node's control block holds a copy of the
+// allocator, so the chunks are released with the last node that survives
+// the parse; freeing a single node returns nothing.
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    explicit ArenaAllocator(std::shared_ptr<std::pmr::monotonic_buffer_resource> arena)
+        : arena(std::move(arena)) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+    std::shared_ptr<std::pmr::monotonic_buffer_resource> arena;
+};
+
 class Parser {
 public:
-    explicit Parser(const std::string_view src) : toks_(src) {
+    explicit Parser(const std::string_view src)
+        : toks_(src),
+          // Chunks grow geometrically from about the size of the source
+          arena_(std::make_shared<std::pmr::monotonic_buffer_resource>(std::clamp<size_t>(src.size(), 4096, 1 << 20))) {
         advance();
     }
 
@@ -30,15 +59,18 @@ public:
 private:
     TokenStream toks_;
     Token tok_;
+    std::shared_ptr<std::pmr::monotonic_buffer_resource> arena_;
 
     void advance() { tok_ = toks_.consume(); }
+
+    ExprPtr newExpr() { return std::allocate_shared<Expr>(ArenaAllocator<Expr>(arena_)); }
     void skipNewlines() { while (tok_.type == Token::Newline) advance(); }
 
-    static bool startsWithUpper(const std::string& s) {
+    static bool startsWithUpper(std::string_view s) {
         if (s.empty()) return false;
         return std::isupper(static_cast<unsigned char>(s[0])) != 0;
     }
-    static bool startsWithLower(const std::string& s) {
+    static bool startsWithLower(std::string_view s) {
         if (s.empty()) return false;
         return std::islower(static_cast<unsigned char>(s[0])) != 0;
     }
@@ -62,21 +94,21 @@ private:
 
     Identifier parseIdentifier() {
         if (tok_.type != Token::Identifier) errorHere("identifier expected");
-        Identifier id{tok_.text, tok_.loc};
+        Identifier id{std::string(tok_.text), tok_.loc};
         advance();
         return id;
     }
 
     NumberLiteral parseNumber() {
         if (tok_.type != Token::Integer && tok_.type != Token::Float) errorHere("number expected");
-        NumberLiteral n{tok_.text, tok_.loc};
+        NumberLiteral n{std::string(tok_.text), tok_.loc};
         advance();
         return n;
     }
 
     StringLiteral parseString() {
         if (tok_.type != Token::String) errorHere("string expected");
-        StringLiteral s{tok_.text, tok_.loc};
+        StringLiteral s{std::string(tok_.text), tok_.loc};
         advance();
         return s;
     }
@@ -293,7 +325,7 @@ private:
             advance();
             skipNewlines();
             auto rhs = parseAddSub();
-            auto e = std::make_shared<Expr>();
+            auto e = newExpr();
             e->loc = lhs->loc;
             ExprBinary bin;
             switch (opType) {
@@ -323,7 +355,7 @@ private:
                 Token::Type op = tok_.type; advance();
                 skipNewlines();
                 auto rhs = parseTerm();
-                auto e = std::make_shared<Expr>();
+                auto e = newExpr();
                 e->loc = lhs->loc;
                 ExprBinary bin;
                 bin.op = (op == Token::Plus) ? ExprBinary::Op::Add : ExprBinary::Op::Sub;
@@ -346,15 +378,15 @@ private:
             auto rhs = parsePrimary();
             // build 0 - rhs
             NumberLiteral zero{"0", loc};
-            auto zeroExpr = std::make_shared<Expr>(); zeroExpr->loc = loc; zeroExpr->node = ExprNumber{zero};
-            auto e = std::make_shared<Expr>(); e->loc = loc; ExprBinary bin; bin.op = ExprBinary::Op::Sub; bin.lhs = zeroExpr; bin.rhs = rhs; e->node = std::move(bin);
+            auto zeroExpr = newExpr(); zeroExpr->loc = loc; zeroExpr->node = ExprNumber{zero};
+            auto e = newExpr(); e->loc = loc; ExprBinary bin; bin.op = ExprBinary::Op::Sub; bin.lhs = zeroExpr; bin.rhs = rhs; e->node = std::move(bin);
             return e;
         }
         if (tok_.type == Token::LParen) {
             advance();
             auto inner = parseExpr();
             expect(Token::RParen, ")");
-            auto e = std::make_shared<Expr>(); e->loc = inner->loc; e->node = ExprParen{inner};
+            auto e = newExpr(); e->loc = inner->loc; e->node = ExprParen{inner};
             return e;
         }
         if (tok_.type == Token::LBracket) {
@@ -369,12 +401,12 @@ private:
                 }
             }
             expect(Token::RBracket, "]");
-            auto e = std::make_shared<Expr>(); e->loc = loc; e->node = ExprList{std::move(elems)};
+            auto e = newExpr(); e->loc = loc; e->node = ExprList{std::move(elems)};
             return e;
         }
         if (tok_.type == Token::Integer || tok_.type == Token::Float) {
             auto num = parseNumber();
-            auto e = std::make_shared<Expr>(); e->loc = num.loc; e->node = ExprNumber{num};
+            auto e = newExpr(); e->loc = num.loc; e->node = ExprNumber{num};
             return e;
         }
         // identifier: could be function call or tensor ref
@@ -394,7 +426,7 @@ private:
                     }
                 }
                 expect(Token::RParen, ")");
-                auto e = std::make_shared<Expr>(); e->loc = loc; e->node = ExprCall{std::move(id), std::move(args)};
+                auto e = newExpr(); e->loc = loc; e->node = ExprCall{std::move(id), std::move(args)};
                 return e;
             } else {
                 // tensor ref or scalar identifier (no indices)
@@ -405,14 +437,14 @@ private:
                     }
                     expect(Token::RBracket, "]");
                 }
-                auto e = std::make_shared<Expr>(); e->loc = ref.loc; e->node = ExprTensorRef{ref};
+                auto e = newExpr(); e->loc = ref.loc; e->node = ExprTensorRef{ref};
                 return e;
             }
         }
         // Optional: allow bare strings as primaries for now (kept for compatibility)
         if (tok_.type == Token::String) {
             auto s = parseString();
-            auto e = std::make_shared<Expr>(); e->loc = s.loc; e->node = ExprString{s};
+            auto e = newExpr(); e->loc = s.loc; e->node = ExprString{s};
             return e;
         }
         errorHere("expression expected");
@@ -426,7 +458,7 @@ private:
         if (tok_.type == Token::Caret) {
             advance();
             auto rhs = parsePower();  // right-associative: recurse for right side
-            auto e = std::make_shared<Expr>();
+            auto e = newExpr();
             e->loc = lhs->loc;
             ExprBinary bin; bin.op = ExprBinary::Op::Pow; bin.lhs = lhs; bin.rhs = rhs;
             e->node = std::move(bin);
@@ -445,7 +477,7 @@ private:
             if (tok_.type == Token::Slash) {
                 advance();
                 auto rhs = parsePower();
-                auto e = std::make_shared<Expr>();
+                auto e = newExpr();
                 e->loc = lhs->loc;
                 ExprBinary bin; bin.op = ExprBinary::Op::Div; bin.lhs = lhs; bin.rhs = rhs;
                 e->node = std::move(bin);
@@ -455,7 +487,7 @@ private:
             if (tok_.type == Token::Star) {
                 advance();
                 auto rhs = parsePower();
-                auto e = std::make_shared<Expr>();
+                auto e = newExpr();
                 e->loc = lhs->loc;
                 ExprBinary bin; bin.op = ExprBinary::Op::Mul; bin.lhs = lhs; bin.rhs = rhs;
                 e->node = std::move(bin);
@@ -465,7 +497,7 @@ private:
             if (tok_.type == Token::Percent) {
                 advance();
                 auto rhs = parsePower();
-                auto e = std::make_shared<Expr>();
+                auto e = newExpr();
                 e->loc = lhs->loc;
                 ExprBinary bin; bin.op = ExprBinary::Op::Mod; bin.lhs = lhs; bin.rhs = rhs;
                 e->node = std::move(bin);
@@ -474,7 +506,7 @@ private:
             }
             if (startsPrimary(tok_.type)) {
                 auto rhs = parsePower();
-                auto e = std::make_shared<Expr>();
+                auto e = newExpr();
                 e->loc = lhs->loc;
                 ExprBinary bin; bin.op = ExprBinary::Op::Mul; bin.lhs = lhs; bin.rhs = rhs;
                 e->node = std::move(bin);
@@ -498,7 +530,7 @@ private:
             Token::Type opType = tok_.type;
             advance();
             auto rhs = parseAddSub();
-            auto e = std::make_shared<Expr>();
+            auto e = newExpr();
             e->loc = lhs->loc;
             ExprBinary bin;
             switch (opType) {
@@ -525,7 +557,7 @@ private:
             SourceLocation loc = tok_.loc;
             advance();
             auto operand = parseGuardNotFactor();
-            auto e = std::make_shared<Expr>();
+            auto e = newExpr();
             e->loc = loc;
             ExprUnary un;
             un.op = ExprUnary::Op::Not;
@@ -548,7 +580,7 @@ private:
         while (tok_.type == Token::KwAnd) {
             advance();
             auto rhs = parseGuardNotFactor();
-            auto e = std::make_shared<Expr>();
+            auto e = newExpr();
             e->loc = lhs->loc;
             ExprBinary bin;
             bin.op = ExprBinary::Op::And;
@@ -566,7 +598,7 @@ private:
         while (tok_.type == Token::KwOr) {
             advance();
             auto rhs = parseGuardAndTerm();
-            auto e = std::make_shared<Expr>();
+            auto e = newExpr();
             e->loc = lhs->loc;
             ExprBinary bin;
             bin.op = ExprBinary::Op::Or;
@@ -614,7 +646,7 @@ private:
                 tok_.type == Token::Star || tok_.type == Token::Slash ||
                 tok_.type == Token::Percent) {
                 // This is an arithmetic expression, parse it fully
-                auto expr = std::make_shared<Expr>();
+                auto expr = newExpr();
                 expr->loc = num.loc;
                 expr->node = ExprNumber{num};
                 // Now parse the rest of the expression
@@ -638,7 +670,7 @@ private:
                     tok_.type == Token::Star || tok_.type == Token::Slash ||
                     tok_.type == Token::Percent) {
                     // This is an arithmetic expression
-                    auto expr = std::make_shared<Expr>();
+                    auto expr = newExpr();
                     expr->loc = id.loc;
                     TensorRef ref;
                     ref.name = id;
@@ -682,7 +714,7 @@ private:
             Token::Type op = tok_.type;
             advance();
             ExprPtr rhs = parseDatalogArithmeticMulDiv(parseDatalogArithmeticPrimary());
-            auto e = std::make_shared<Expr>();
+            auto e = newExpr();
             e->loc = lhs->loc;
             ExprBinary bin;
             bin.op = (op == Token::Plus) ? ExprBinary::Op::Add : ExprBinary::Op::Sub;
@@ -700,7 +732,7 @@ private:
             Token::Type op = tok_.type;
             advance();
             ExprPtr rhs = parseDatalogArithmeticPrimary();
-            auto e = std::make_shared<Expr>();
+            auto e = newExpr();
             e->loc = lhs->loc;
             ExprBinary bin;
             if (op == Token::Star) bin.op = ExprBinary::Op::Mul;
@@ -718,14 +750,14 @@ private:
     ExprPtr parseDatalogArithmeticPrimary() {
         if (tok_.type == Token::Integer) {
             auto num = parseNumber();
-            auto e = std::make_shared<Expr>();
+            auto e = newExpr();
             e->loc = num.loc;
             e->node = ExprNumber{num};
             return e;
         }
         if (tok_.type == Token::Identifier && startsWithLower(tok_.text)) {
             auto id = parseLowercaseIdentifier();
-            auto e = std::make_shared<Expr>();
+            auto e = newExpr();
             e->loc = id.loc;
             TensorRef ref;
             ref.name = id;
@@ -835,7 +867,7 @@ private:
         } else if (tok_.type == Token::String) {
             arg.value = parseString();
         } else if (tok_.type == Token::Identifier) {
-            std::string val = tok_.text;
+            std::string val(tok_.text);
             if (val == "true" || val == "True") {
                 advance();
                 arg.value = true;
@@ -874,6 +906,43 @@ private:
         return dir;
     }
 
+    // Record an answer modifier (see QueryModifiers); false for learning directives
+    static bool applyQueryModifier(QueryModifiers& modifiers, const QueryDirective& dir) {
+        const std::string& name = dir.name.name;
+        if (name != "limit" && name != "topk" && name != "exists") return false;
+        auto fail = [&](const std::string& msg) {
+            std::ostringstream oss;
+            oss << "Parse error at line " << dir.loc.line << ", col " << dir.loc.column << ": " << msg;
+            throw ParseError(oss.str());
+        };
+        if (name == "exists") {
+            if (!dir.args.empty()) fail("@exists takes no arguments");
+            modifiers.exists = true;
+            return true;
+        }
+        const std::string param = name == "limit" ? "n" : "k";
+        if (dir.args.size() != 1 || dir.args[0].name.name != param) {
+            fail("@" + name + " takes one argument, " + param + "=<count>");
+        }
+        const auto* count = std::get_if<NumberLiteral>(&dir.args[0].value);
+        if (!count || count->text.empty() || count->text.size() > 18 ||
+            count->text.find_first_not_of("0123456789") != std::string::npos) {
+            fail("@" + name + " expects a non-negative integer count");
+        }
+        (name == "limit" ? modifiers.limit : modifiers.topk) = std::stoull(count->text);
+        return true;
+    }
+
+    // Directives after a query's '?': answer modifiers and at most one learning directive
+    void parseQueryDirectives(Query& q) {
+        while (tok_.type == Token::At) {
+            QueryDirective dir = *parseQueryDirective();
+            if (applyQueryModifier(q.modifiers, dir)) continue;
+            if (q.directive) errorHere("a query takes at most one learning directive");
+            q.directive = std::move(dir);
+        }
+    }
+
     // Parse a Datalog constant into a StringLiteral or NumberLiteral (uppercase identifiers, numbers, or strings)
     std::variant<StringLiteral, NumberLiteral> parseDatalogConstant() {
         if (tok_.type == Token::String) {
@@ -952,7 +1021,7 @@ private:
             // Datalog query: Atom? or Atom, body...? (conjunctive query with comparisons)
             if (accept(Token::Question)) {
                 Query q; q.target = head; q.loc = head.loc;
-                q.directive = parseQueryDirective();
+                parseQueryDirectives(q);
                 return q;
             }
             if (accept(Token::LArrow)) {
@@ -974,7 +1043,7 @@ private:
                 } while (tok_.type == Token::Comma);
                 expect(Token::Question, "'?' to end query");
                 Query q; q.target = head; q.body = std::move(conj); q.loc = head.loc;
-                q.directive = parseQueryDirective();
+                parseQueryDirectives(q);
                 return q;
             }
             // else, treat as fact if constants only
@@ -1006,7 +1075,7 @@ private:
         // Check if this is a query: tensor_ref?
         if (accept(Token::Question)) {
             Query q; q.target = lhs; q.loc = lhs.loc;
-            q.directive = parseQueryDirective();
+            parseQueryDirectives(q);
             return q;
         }
         // Parse projection operator: '=', '+=', 'avg=', 'max=', 'min='
@@ -1014,7 +1083,7 @@ private:
         if (tok_.type == Token::Plus) {
             advance(); expect(Token::Equals, "="); proj = "+=";
         } else if (tok_.type == Token::Identifier && (tok_.text == "avg" || tok_.text == "max" || tok_.text == "min")) {
-            std::string op = tok_.text; advance(); expect(Token::Equals, "="); proj = op + "=";
+            std::string op(tok_.text); advance(); expect(Token::Equals, "="); proj = op + "=";
         } else {
             expect(Token::Equals, "projection '='");
         }
@@ -1055,10 +1124,13 @@ Program parseProgram(const std::string_view source) {
 }
 
 Program parseFile(const std::string& path) {
-    std::ifstream ifs(path);
+    std::ifstream ifs(path, std::ios::binary | std::ios::ate);
     if (!ifs) throw ParseError("Cannot open file: " + path);
-    std::stringstream buffer; buffer << ifs.rdbuf();
-    return parseProgram(buffer.str());
+    // Read in one piece; tokens refer into this buffer while parsing
+    std::string source(static_cast<size_t>(ifs.tellg()), '\0');
+    ifs.seekg(0);
+    ifs.read(source.data(), static_cast<std::streamsize>(source.size()));
+    return parseProgram(source);
 }
 
 } // namespace tl
@@ -0,0 +1,540 @@
+#include "TL/ProgramCache.hpp"
+#include "TL/Parser.hpp"
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <variant>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tl {
+
+namespace {
+
+// .tlc layout, fixed fields little-endian:
+//   char magic[4] "TLC1", uint32 format version, uint64 source hash,
+//   uint64 source size, uint64 payload size, payload
+// The payload is the program in varints and length-prefixed strings.
+// Bump kFormatVersion whenever an AST node gains, loses or reorders a field.
+constexpr char kMagic[4] = {'T', 'L', 'C', '1'};
+constexpr uint32_t kFormatVersion = 2;
+constexpr size_t kHeaderSize = 32;
+
+uint64_t contentHash(std::string_view bytes) {
+    // FNV-1a; collisions additionally need an identical size to go unnoticed
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (const char c : bytes) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+class Writer {
+public:
+    void u(uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<char>(v));
+    }
+    void i(int64_t v) { u((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63)); }
+    void bytes(std::string_view s) {
+        u(s.size());
+        out.append(s.data(), s.size());
+    }
+    template <typename T>
+    void fixed(T v) {
+        char buf[sizeof(T)];
+        std::memcpy(buf, &v, sizeof(T));
+        out.append(buf, sizeof(T));
+    }
+
+    std::string out;
+};
+
+class Reader {
+public:
+    explicit Reader(std::string_view in) : in_(in) {}
+
+    uint64_t u() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos_ >= in_.size()) fail();
+            const auto b = static_cast<unsigned char>(in_[pos_++]);
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        fail();
+    }
+    int64_t i() {
+        const uint64_t v = u();
+        return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+    }
+    std::string bytes() {
+        const uint64_t n = u();
+        if (n > in_.size() - pos_) fail();
+        std::string s(in_.substr(pos_, n));
+        pos_ += n;
+        return s;
+    }
+    // Element counts are bounded by the bytes left, so corrupt input fails
+    // instead of reserving absurd amounts of memory
+    size_t count() {
+        const uint64_t n = u();
+        if (n > in_.size() - pos_) fail();
+        return static_cast<size_t>(n);
+    }
+    bool done() const { return pos_ == in_.size(); }
+
+    [[noreturn]] static void fail() { throw std::runtime_error("Malformed program cache"); }
+
+private:
+    std::string_view in_;
+    size_t pos_{0};
+};
+
+// One encode/decode pair per AST type, declared up front so the templates
+// below find every overload regardless of definition order
+void encode(Writer& w, bool v);
+void encode(Writer& w, const std::string& v);
+void encode(Writer& w, const SourceLocation& v);
+void encode(Writer& w, const Identifier& v);
+void encode(Writer& w, const NumberLiteral& v);
+void encode(Writer& w, const StringLiteral& v);
+void encode(Writer& w, const VirtualIndex& v);
+void encode(Writer& w, const Index& v);
+void encode(Writer& w, const Slice& v);
+void encode(Writer& w, const IndexOrSlice& v);
+void encode(Writer& w, const TensorRef& v);
+void encode(Writer& w, const ExprPtr& v);
+void encode(Writer& w, const ExprTensorRef& v);
+void encode(Writer& w, const ExprNumber& v);
+void encode(Writer& w, const ExprString& v);
+void encode(Writer& w, const ExprList& v);
+void encode(Writer& w, const ExprParen& v);
+void encode(Writer& w, const ExprCall& v);
+void encode(Writer& w, const ExprBinary& v);
+void encode(Writer& w, const ExprUnary& v);
+void encode(Writer& w, const DatalogAtom& v);
+void encode(Writer& w, const DatalogNegation& v);
+void encode(Writer& w, const DatalogCondition& v);
+void encode(Writer& w, const GuardedClause& v);
+void encode(Writer& w, const TensorEquation& v);
+void encode(Writer& w, const FixedPointLoop& v);
+void encode(Writer& w, const FileOperation& v);
+void encode(Writer& w, const DirectiveArg& v);
+void encode(Writer& w, const QueryDirective& v);
+void encode(Writer& w, const QueryModifiers& v);
+void encode(Writer& w, const Query& v);
+void encode(Writer& w, const DatalogFact& v);
+void encode(Writer& w, const DatalogRule& v);
+
+void decode(Reader& r, bool& v);
+void decode(Reader& r, std::string& v);
+void decode(Reader& r, SourceLocation& v);
+void decode(Reader& r, Identifier& v);
+void decode(Reader& r, NumberLiteral& v);
+void decode(Reader& r, StringLiteral& v);
+void decode(Reader& r, VirtualIndex& v);
+void decode(Reader& r, Index& v);
+void decode(Reader& r, Slice& v);
+void decode(Reader& r, IndexOrSlice& v);
+void decode(Reader& r, TensorRef& v);
+void decode(Reader& r, ExprPtr& v);
+void decode(Reader& r, ExprTensorRef& v);
+void decode(Reader& r, ExprNumber& v);
+void decode(Reader& r, ExprString& v);
+void decode(Reader& r, ExprList& v);
+void decode(Reader& r, ExprParen& v);
+void decode(Reader& r, ExprCall& v);
+void decode(Reader& r, ExprBinary& v);
+void decode(Reader& r, ExprUnary& v);
+void decode(Reader& r, DatalogAtom& v);
+void decode(Reader& r, DatalogNegation& v);
+void decode(Reader& r, DatalogCondition& v);
+void decode(Reader& r, GuardedClause& v);
+void decode(Reader& r, TensorEquation& v);
+void decode(Reader& r, FixedPointLoop& v);
+void decode(Reader& r, FileOperation& v);
+void decode(Reader& r, DirectiveArg& v);
+void decode(Reader& r, QueryDirective& v);
+void decode(Reader& r, QueryModifiers& v);
+void decode(Reader& r, Query& v);
+void decode(Reader& r, DatalogFact& v);
+void decode(Reader& r, DatalogRule& v);
+
+template <typename T> void encode(Writer& w, const std::vector<T>& v);
+template <typename T> void encode(Writer& w, const std::optional<T>& v);
+template <typename... Ts> void encode(Writer& w, const std::variant<Ts...>& v);
+template <typename T> void decode(Reader& r, std::vector<T>& v);
+template <typename T> void decode(Reader& r, std::optional<T>& v);
+template <typename... Ts> void decode(Reader& r, std::variant<Ts...>& v);
+
+template <typename T>
+void encode(Writer& w, const std::vector<T>& v) {
+    w.u(v.size());
+    for (const auto& x : v) encode(w, x);
+}
+
+template <typename T>
+void encode(Writer& w, const std::optional<T>& v) {
+    w.u(v.has_value() ? 1 : 0);
+    if (v) encode(w, *v);
+}
+
+template <typename... Ts>
+void encode(Writer& w, const std::variant<Ts...>& v) {
+    w.u(v.index());
+    std::visit([&](const auto& x) { encode(w, x); }, v);
+}
+
+template <typename T>
+void decode(Reader& r, std::vector<T>& v) {
+    const size_t n = r.count();
+    v.clear();
+    v.reserve(n);
+    for (size_t k = 0; k < n; ++k) decode(r, v.emplace_back());
+}
+
+template <typename T>
+void decode(Reader& r, std::optional<T>& v) {
+    v.reset();
+    if (r.u() != 0) decode(r, v.emplace());
+}
+
+template <typename V, size_t I = 0>
+void decodeAlternative(Reader& r, V& v, uint64_t index) {
+    if constexpr (I < std::variant_size_v<V>) {
+        if (index == I) {
+            decode(r, v.template emplace<I>());
+            return;
+        }
+        decodeAlternative<V, I + 1>(r, v, index);
+    } else {
+        Reader::fail();
+    }
+}
+
+template <typename... Ts>
+void decode(Reader& r, std::variant<Ts...>& v) {
+    decodeAlternative(r, v, r.u());
+}
+
+void encode(Writer& w, const bool v) { w.u(v ? 1 : 0); }
+void encode(Writer& w, const std::string& v) { w.bytes(v); }
+void encode(Writer& w, const SourceLocation& v) { w.u(v.line); w.u(v.column); }
+void encode(Writer& w, const Identifier& v) { encode(w, v.name); encode(w, v.loc); }
+void encode(Writer& w, const NumberLiteral& v) { encode(w, v.text); encode(w, v.loc); }
+void encode(Writer& w, const StringLiteral& v) { encode(w, v.text); encode(w, v.loc); }
+void encode(Writer& w, const VirtualIndex& v) { encode(w, v.name); w.i(v.offset); encode(w, v.loc); }
+void encode(Writer& w, const Index& v) { encode(w, v.value); encode(w, v.normalized); encode(w, v.loc); }
+void encode(Writer& w, const Slice& v) {
+    encode(w, v.start);
+    encode(w, v.end);
+    encode(w, v.step);
+    encode(w, v.loc);
+}
+void encode(Writer& w, const IndexOrSlice& v) { encode(w, v.value); encode(w, v.loc); }
+void encode(Writer& w, const TensorRef& v) { encode(w, v.name); encode(w, v.indices); encode(w, v.loc); }
+void encode(Writer& w, const ExprPtr& v) {
+    w.u(v ? 1 : 0);
+    if (!v) return;
+    encode(w, v->loc);
+    encode(w, v->node);
+}
+void encode(Writer& w, const ExprTensorRef& v) { encode(w, v.ref); }
+void encode(Writer& w, const ExprNumber& v) { encode(w, v.literal); }
+void encode(Writer& w, const ExprString& v) { encode(w, v.literal); }
+void encode(Writer& w, const ExprList& v) { encode(w, v.elements); }
+void encode(Writer& w, const ExprParen& v) { encode(w, v.inner); }
+void encode(Writer& w, const ExprCall& v) { encode(w, v.func); encode(w, v.args); }
+void encode(Writer& w, const ExprBinary& v) {
+    w.u(static_cast<uint64_t>(v.op));
+    encode(w, v.lhs);
+    encode(w, v.rhs);
+}
+void encode(Writer& w, const ExprUnary& v) { w.u(static_cast<uint64_t>(v.op)); encode(w, v.operand); }
+void encode(Writer& w, const DatalogAtom& v) { encode(w, v.relation); encode(w, v.terms); encode(w, v.loc); }
+void encode(Writer& w, const DatalogNegation& v) { encode(w, v.atom); encode(w, v.loc); }
+void encode(Writer& w, const DatalogCondition& v) {
+    encode(w, v.lhs);
+    encode(w, v.op);
+    encode(w, v.rhs);
+    encode(w, v.loc);
+}
+void encode(Writer& w, const GuardedClause& v) { encode(w, v.expr); encode(w, v.guard); encode(w, v.loc); }
+void encode(Writer& w, const TensorEquation& v) {
+    encode(w, v.lhs);
+    encode(w, v.projection);
+    encode(w, v.clauses);
+    encode(w, v.loc);
+}
+void encode(Writer& w, const FixedPointLoop& v) {
+    encode(w, v.equation);
+    encode(w, v.monitoredTensor);
+    encode(w, v.loc);
+}
+void encode(Writer& w, const FileOperation& v) {
+    encode(w, v.lhsIsTensor);
+    encode(w, v.tensor);
+    encode(w, v.file);
+    encode(w, v.loc);
+}
+void encode(Writer& w, const DirectiveArg& v) { encode(w, v.name); encode(w, v.value); encode(w, v.loc); }
+void encode(Writer& w, const QueryDirective& v) { encode(w, v.name); encode(w, v.args); encode(w, v.loc); }
+// Counts are stored one higher, leaving 0 for an absent one
+void encode(Writer& w, const QueryModifiers& v) {
+    w.u(v.limit ? *v.limit + 1 : 0);
+    encode(w, v.exists);
+    w.u(v.topk ? *v.topk + 1 : 0);
+}
+void encode(Writer& w, const Query& v) {
+    encode(w, v.target);
+    encode(w, v.body);
+    encode(w, v.directive);
+    encode(w, v.modifiers);
+    encode(w, v.loc);
+}
+void encode(Writer& w, const DatalogFact& v) { encode(w, v.relation); encode(w, v.constants); encode(w, v.loc); }
+void encode(Writer& w, const DatalogRule& v) { encode(w, v.head); encode(w, v.body); encode(w, v.loc); }
+
+void decode(Reader& r, bool& v) {
+    const uint64_t b = r.u();
+    if (b > 1) Reader::fail();
+    v = b == 1;
+}
+void decode(Reader& r, std::string& v) { v = r.bytes(); }
+void decode(Reader& r, SourceLocation& v) { v.line = r.u(); v.column = r.u(); }
+void decode(Reader& r, Identifier& v) { decode(r, v.name); decode(r, v.loc); }
+void decode(Reader& r, NumberLiteral& v) { decode(r, v.text); decode(r, v.loc); }
+void decode(Reader& r, StringLiteral& v) { decode(r, v.text); decode(r, v.loc); }
+void decode(Reader& r, VirtualIndex& v) {
+    decode(r, v.name);
+    v.offset = static_cast<int>(r.i());
+    decode(r, v.loc);
+}
+void decode(Reader& r, Index& v) { decode(r, v.value); decode(r, v.normalized); decode(r, v.loc); }
+void decode(Reader& r, Slice& v) {
+    decode(r, v.start);
+    decode(r, v.end);
+    decode(r, v.step);
+    decode(r, v.loc);
+}
+void decode(Reader& r, IndexOrSlice& v) { decode(r, v.value); decode(r, v.loc); }
+void decode(Reader& r, TensorRef& v) { decode(r, v.name); decode(r, v.indices); decode(r, v.loc); }
+void decode(Reader& r, ExprPtr& v) {
+    v.reset();
+    if (r.u() == 0) return;
+    v = std::make_shared<Expr>();
+    decode(r, v->loc);
+    decode(r, v->node);
+}
+void decode(Reader& r, ExprTensorRef& v) { decode(r, v.ref); }
+void decode(Reader& r, ExprNumber& v) { decode(r, v.literal); }
+void decode(Reader& r, ExprString& v) { decode(r, v.literal); }
+void decode(Reader& r, ExprList& v) { decode(r, v.elements); }
+void decode(Reader& r, ExprParen& v) { decode(r, v.inner); }
+void decode(Reader& r, ExprCall& v) { decode(r, v.func); decode(r, v.args); }
+void decode(Reader& r, ExprBinary& v) {
+    const uint64_t op = r.u();
+    if (op > static_cast<uint64_t>(ExprBinary::Op::Or)) Reader::fail();
+    v.op = static_cast<ExprBinary::Op>(op);
+    decode(r, v.lhs);
+    decode(r, v.rhs);
+}
+void decode(Reader& r, ExprUnary& v) {
+    const uint64_t op = r.u();
+    if (op > static_cast<uint64_t>(ExprUnary::Op::Not)) Reader::fail();
+    v.op = static_cast<ExprUnary::Op>(op);
+    decode(r, v.operand);
+}
+void decode(Reader& r, DatalogAtom& v) { decode(r, v.relation); decode(r, v.terms); decode(r, v.loc); }
+void decode(Reader& r, DatalogNegation& v) { decode(r, v.atom); decode(r, v.loc); }
+void decode(Reader& r, DatalogCondition& v) {
+    decode(r, v.lhs);
+    decode(r, v.op);
+    decode(r, v.rhs);
+    decode(r, v.loc);
+}
+void decode(Reader& r, GuardedClause& v) { decode(r, v.expr); decode(r, v.guard); decode(r, v.loc); }
+void decode(Reader& r, TensorEquation& v) {
+    decode(r, v.lhs);
+    decode(r, v.projection);
+    decode(r, v.clauses);
+    decode(r, v.loc);
+}
+void decode(Reader& r, FixedPointLoop& v) {
+    decode(r, v.equation);
+    decode(r, v.monitoredTensor);
+    decode(r, v.loc);
+}
+void decode(Reader& r, FileOperation& v) {
+    decode(r, v.lhsIsTensor);
+    decode(r, v.tensor);
+    decode(r, v.file);
+    decode(r, v.loc);
+}
+void decode(Reader& r, DirectiveArg& v) { decode(r, v.name); decode(r, v.value); decode(r, v.loc); }
+void decode(Reader& r, QueryDirective& v) { decode(r, v.name); decode(r, v.args); decode(r, v.loc); }
+void decode(Reader& r, QueryModifiers& v) {
+    v.limit.reset();
+    v.topk.reset();
+    if (const uint64_t n = r.u()) v.limit = n - 1;
+    decode(r, v.exists);
+    if (const uint64_t k = r.u()) v.topk = k - 1;
+}
+void decode(Reader& r, Query& v) {
+    decode(r, v.target);
+    decode(r, v.body);
+    decode(r, v.directive);
+    decode(r, v.modifiers);
+    decode(r, v.loc);
+}
+void decode(Reader& r, DatalogFact& v) { decode(r, v.relation); decode(r, v.constants); decode(r, v.loc); }
+void decode(Reader& r, DatalogRule& v) { decode(r, v.head); decode(r, v.body); decode(r, v.loc); }
+
+template <typename T>
+T readFixed(std::string_view bytes, size_t offset) {
+    T value;
+    std::memcpy(&value, bytes.data() + offset, sizeof(T));
+    return value;
+}
+
+// Bytes of a cache file, mapped read-only where the platform allows it
+class CacheBytes {
+public:
+    explicit CacheBytes(const std::string& path) {
+#ifndef _WIN32
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st {};
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* base = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (base != MAP_FAILED) {
+                mapped_ = static_cast<const char*>(base);
+                view_ = std::string_view(mapped_, static_cast<size_t>(st.st_size));
+            }
+        }
+        ::close(fd);
+        if (mapped_) return;
+#endif
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) return;
+        owned_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        view_ = owned_;
+    }
+    ~CacheBytes() {
+#ifndef _WIN32
+        if (mapped_) ::munmap(const_cast<char*>(mapped_), view_.size());
+#endif
+    }
+    CacheBytes(const CacheBytes&) = delete;
+    CacheBytes& operator=(const CacheBytes&) = delete;
+
+    std::string_view view() const { return view_; }
+
+private:
+    const char* mapped_{nullptr};
+    std::string owned_;
+    std::string_view view_;
+};
+
+std::optional<Program> readCache(const std::string& cachePath, uint64_t hash, uint64_t size) {
+    const CacheBytes file(cachePath);
+    const std::string_view bytes = file.view();
+    if (bytes.size() < kHeaderSize || std::memcmp(bytes.data(), kMagic, sizeof(kMagic)) != 0) return std::nullopt;
+    if (readFixed<uint32_t>(bytes, 4) != kFormatVersion || readFixed<uint64_t>(bytes, 8) != hash ||
+        readFixed<uint64_t>(bytes, 16) != size || readFixed<uint64_t>(bytes, 24) != bytes.size() - kHeaderSize) {
+        return std::nullopt;
+    }
+    try {
+        return deserializeProgram(bytes.substr(kHeaderSize));
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+}
+
+void writeCache(const std::string& cachePath, const Program& program, uint64_t hash, uint64_t size) {
+    Writer header;
+    header.out.append(kMagic, sizeof(kMagic));
+    header.fixed<uint32_t>(kFormatVersion);
+    header.fixed<uint64_t>(hash);
+    header.fixed<uint64_t>(size);
+    const std::string payload = serializeProgram(program);
+    header.fixed<uint64_t>(payload.size());
+
+    // Write aside and rename, so concurrent runs never see a partial file
+#ifndef _WIN32
+    const std::string tmp = cachePath + ".tmp" + std::to_string(::getpid());
+#else
+    const std::string tmp = cachePath + ".tmp";
+#endif
+    {
+        std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+        if (!ofs) return;
+        ofs.write(header.out.data(), static_cast<std::streamsize>(header.out.size()));
+        ofs.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        if (!ofs) {
+            ofs.close();
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, cachePath, ec);
+    if (ec) std::filesystem::remove(tmp, ec);
+}
+
+} // namespace
+
+std::string serializeProgram(const Program& program) {
+    Writer w;
+    encode(w, program.statements);
+    return std::move(w.out);
+}
+
+Program deserializeProgram(const std::string_view bytes) {
+    Reader r(bytes);
+    Program program;
+    decode(r, program.statements);
+    if (!r.done()) Reader::fail();
+    return program;
+}
+
+std::string programCachePath(const std::string& sourcePath) {
+    return sourcePath + "c";
+}
+
+Program loadProgram(const std::string& path, bool* cacheHit) {
+    std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+    if (!ifs) throw ParseError("Cannot open file: " + path);
+    std::string source(static_cast<size_t>(ifs.tellg()), '\0');
+    ifs.seekg(0);
+    ifs.read(source.data(), static_cast<std::streamsize>(source.size()));
+
+    const uint64_t hash = contentHash(source);
+    const std::string cachePath = programCachePath(path);
+    if (auto cached = readCache(cachePath, hash, source.size())) {
+        if (cacheHit) *cacheHit = true;
+        return std::move(*cached);
+    }
+    if (cacheHit) *cacheHit = false;
+    Program program = parseProgram(source);
+    writeCache(cachePath, program, hash, source.size());
+    return program;
+}
+
+} // namespace tl
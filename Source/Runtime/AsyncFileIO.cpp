@@ -0,0 +1,98 @@
+#include "TL/Runtime/AsyncFileIO.hpp"
+#include "TL/Runtime/TensorIO.hpp"
+#include <torch/torch.h>
+#include <exception>
+#include <utility>
+
+namespace tl {
+
+    namespace {
+    // Reads one byte per page of a CPU tensor's storage, so a mapped file is
+    // paged in by the thread that calls this rather than the first statement
+    // that reads the tensor
+    void touchPages(const Tensor& t) {
+        if (!t.defined() || t.is_sparse() || !t.device().is_cpu()) return;
+        const auto* data = static_cast<const volatile unsigned char*>(t.storage().data());
+        const size_t bytes = t.storage().nbytes();
+        if (!data) return;
+        constexpr size_t kPage = 4096;
+        unsigned char sink = 0;
+        for (size_t offset = 0; offset < bytes; offset += kPage) sink ^= data[offset];
+        (void)sink;
+    }
+    }
+
+    AsyncFileIO::~AsyncFileIO() {
+        discard();
+        for (auto& write : writes_) write.wait();
+    }
+
+    void AsyncFileIO::prefetch(const std::filesystem::path& path) {
+        const std::string key = path.string();
+        if (reads_.count(key)) return;
+        // Reads what the pending writes of the path leave behind
+        std::shared_future<void> previous;
+        if (auto it = last_write_.find(key); it != last_write_.end()) previous = it->second;
+        reads_.emplace(key, std::async(std::launch::async, [path, previous] {
+                           if (previous.valid()) previous.wait();
+                           Tensor t = tensor_io::read(path);
+                           touchPages(t);
+                           return t;
+                       }));
+    }
+
+    Tensor AsyncFileIO::read(const std::filesystem::path& path) {
+        const std::string key = path.string();
+        auto it = reads_.find(key);
+        if (it == reads_.end()) {
+            wait(path);
+            return tensor_io::read(path);
+        }
+        std::future<Tensor> pending = std::move(it->second);
+        reads_.erase(it);
+        return pending.get();
+    }
+
+    void AsyncFileIO::write(const std::filesystem::path& path, const Tensor& t) {
+        const std::string key = path.string();
+        // A prefetch of the path read what was there before this write
+        auto read = reads_.find(key);
+        if (read != reads_.end()) {
+            read->second.wait();
+            reads_.erase(read);
+        }
+        std::shared_future<void> previous;
+        if (auto it = last_write_.find(key); it != last_write_.end()) previous = it->second;
+        std::shared_future<void> done = std::async(std::launch::async, [path, t, previous] {
+                                            if (previous.valid()) previous.wait();
+                                            tensor_io::write(path, t);
+                                        }).share();
+        last_write_[key] = done;
+        writes_.push_back(std::move(done));
+    }
+
+    void AsyncFileIO::wait(const std::filesystem::path& path) {
+        auto it = last_write_.find(path.string());
+        if (it != last_write_.end()) it->second.wait();
+    }
+
+    void AsyncFileIO::flush() {
+        std::exception_ptr error;
+        for (auto& write : writes_) {
+            try {
+                write.get();
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        writes_.clear();
+        last_write_.clear();
+        if (error) std::rethrow_exception(error);
+    }
+
+    void AsyncFileIO::discard() {
+        for (auto& [path, read] : reads_) read.wait();
+        reads_.clear();
+    }
+
+} // namespace tl
@@ -0,0 +1,506 @@
+#include "TL/Runtime/AttentionFusion.hpp"
+#include "TL/vm.hpp"
+#include <torch/torch.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <numeric>
+#include <unordered_map>
+
+namespace tl {
+
+    namespace {
+    std::atomic<bool> g_attentionFusionEnabled{true};
+
+    // Scores evaluated per block of query rows, in elements
+    constexpr int64_t kBlockElements = int64_t{1} << 20;
+    // Score tensors inlined below the weights at most
+    constexpr int kMaxDepth = 4;
+
+    // Name of a lowercase index variable, or nullptr for labels, literals,
+    // slices and virtual indices
+    const std::string* variable(const IndexOrSlice& ios) {
+        const auto* idx = std::get_if<Index>(&ios.value);
+        const auto* id = idx ? std::get_if<Identifier>(&idx->value) : nullptr;
+        if (!id || id->name.empty() || std::isupper(static_cast<unsigned char>(id->name[0]))) return nullptr;
+        return &id->name;
+    }
+
+    bool isNormalized(const IndexOrSlice& ios) {
+        const auto* idx = std::get_if<Index>(&ios.value);
+        return idx && idx->normalized;
+    }
+
+    // Index variables of a reference; false unless all are distinct variables
+    bool variables(const TensorRef& ref, std::vector<std::string>& out) {
+        out.clear();
+        for (const auto& ios : ref.indices) {
+            const std::string* name = variable(ios);
+            if (!name || std::find(out.begin(), out.end(), *name) != out.end()) return false;
+            out.push_back(*name);
+        }
+        return true;
+    }
+
+    // A plain assignment of one unguarded clause to distinct LHS variables
+    bool plainEquation(const TensorEquation& eq, std::vector<std::string>& lhs) {
+        if (!eq.projection.empty() && eq.projection != "=") return false;
+        if (eq.clauses.size() != 1 || eq.clauses[0].guard || !eq.clauses[0].expr) return false;
+        return !eq.lhs.indices.empty() && variables(eq.lhs, lhs);
+    }
+
+    const TensorRef* refOf(const ExprPtr& ep) {
+        const auto* tr = ep ? std::get_if<ExprTensorRef>(&ep->node) : nullptr;
+        return tr ? &tr->ref : nullptr;
+    }
+
+    void addName(std::vector<std::string>& names, const std::string& name) {
+        if (std::find(names.begin(), names.end(), name) == names.end()) names.push_back(name);
+    }
+
+    // Dimension order that sorts `axes`
+    std::vector<int64_t> sortedOrder(const std::vector<int>& axes) {
+        std::vector<int64_t> order(axes.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int64_t a, int64_t b) { return axes[a] < axes[b]; });
+        return order;
+    }
+    }
+
+    struct FusedAttention::Scope {
+        std::unordered_map<std::string, int> axis;  // index variable -> canonical axis
+        std::vector<std::string> lhs;               // LHS variables of the equation being read
+    };
+
+    // -------- Matching --------
+
+    std::optional<FusedAttention> FusedAttention::match(const TensorEquation& output, const Definitions& definition) {
+        std::vector<std::string> out;
+        if (!plainEquation(output, out)) return std::nullopt;
+        if (std::any_of(output.lhs.indices.begin(), output.lhs.indices.end(), isNormalized)) return std::nullopt;
+        const auto* sum = std::get_if<ExprBinary>(&output.clauses[0].expr->node);
+        if (!sum || sum->op != ExprBinary::Op::Mul) return std::nullopt;
+        const TensorRef* factors[2] = {refOf(sum->lhs), refOf(sum->rhs)};
+        if (!factors[0] || !factors[1]) return std::nullopt;
+
+        // Either factor may be the weights
+        for (int side = 0; side < 2; ++side) {
+            const TensorEquation* weights = definition(factors[side]->name.name);
+            if (!weights) continue;
+            FusedAttention kernel;
+            if (kernel.build(output, out, *factors[side], *factors[1 - side], *weights, definition)) return kernel;
+        }
+        return std::nullopt;
+    }
+
+    bool FusedAttention::build(const TensorEquation& output, const std::vector<std::string>& out,
+                               const TensorRef& weightsRef, const TensorRef& valueRef,
+                               const TensorEquation& weights, const Definitions& definition) {
+        std::vector<std::string> w, v, wl;
+        if (!variables(weightsRef, w) || !variables(valueRef, v) || !plainEquation(weights, wl)) return false;
+        if (w.size() != wl.size() || weightsRef.name.name == valueRef.name.name) return false;
+        auto has = [](const std::vector<std::string>& names, const std::string& name) {
+            return std::find(names.begin(), names.end(), name) != names.end();
+        };
+
+        // Batch indices are in all three tensors, the query index is kept
+        // and the key index is summed out against the values
+        std::vector<std::string> batchNames;
+        std::string q, k;
+        for (const auto& name : w) {
+            const bool kept = has(out, name), summed = has(v, name);
+            if (kept && summed) {
+                batchNames.push_back(name);
+            } else if (kept || summed) {
+                std::string& role = kept ? q : k;
+                if (!role.empty()) return false;
+                role = name;
+            } else {
+                return false;
+            }
+        }
+        if (q.empty() || k.empty()) return false;
+        batch_ = static_cast<int>(batchNames.size());
+        const int B = batch_;
+        std::unordered_map<std::string, int> axis;
+        for (int i = 0; i < B; ++i) axis[batchNames[i]] = i;
+        axis[q] = B;
+        axis[k] = B + 1;
+
+        // One value index, in the values and the output only
+        const size_t rank = static_cast<size_t>(B) + 2;
+        std::string valueName;
+        for (const auto& name : v) {
+            if (axis.count(name)) continue;
+            if (!valueName.empty()) return false;
+            valueName = name;
+        }
+        if (valueName.empty() || v.size() != rank || out.size() != rank) return false;
+        value_.name = valueRef.name.name;
+        for (const auto& name : v) value_.axes.push_back(name == valueName ? B + 2 : axis.at(name));
+        for (const auto& name : out) {
+            auto it = axis.find(name);
+            if (name != valueName && (it == axis.end() || it->second == B + 1)) return false;
+            output_axes_.push_back(name == valueName ? B + 2 : it->second);
+        }
+
+        // The key index is the one the weights normalize
+        int normalizedAt = -1;
+        for (size_t i = 0; i < weights.lhs.indices.size(); ++i) {
+            if (!isNormalized(weights.lhs.indices[i])) continue;
+            if (normalizedAt >= 0) return false;
+            normalizedAt = static_cast<int>(i);
+        }
+        if (normalizedAt < 0 || w[normalizedAt] != k) return false;
+
+        Scope scope;
+        for (size_t i = 0; i < wl.size(); ++i) scope.axis[wl[i]] = axis.at(w[i]);
+        scope.lhs = wl;
+        // The weights are an explicit softmax, which normalizes the last
+        // dimension (see NormalizationExecutor); normalized products without
+        // one may be claimed by the product executors instead
+        const auto* call = std::get_if<ExprCall>(&weights.clauses[0].expr->node);
+        if (!call || call->func.name != "softmax" || call->args.size() != 1 ||
+            normalizedAt + 1 != static_cast<int>(wl.size())) {
+            return false;
+        }
+        const ExprPtr& score = call->args[0];
+
+        for (const auto* names : {&out, &w, &v, &wl}) {
+            for (const auto& name : *names) addName(index_names_, name);
+        }
+        absorbed_.emplace_back(weightsRef.name.name, output.lhs.name.name);
+        addName(inputs_, value_.name);
+        if (!emit(score, scope, definition, weightsRef.name.name, 0) || query_.name.empty()) return false;
+        findSdpa();
+        return true;
+    }
+
+    uint32_t FusedAttention::push(Instr instr) {
+        code_.push_back(std::move(instr));
+        return static_cast<uint32_t>(code_.size() - 1);
+    }
+
+    std::optional<uint32_t> FusedAttention::emit(const ExprPtr& ep, const Scope& scope, const Definitions& definition,
+                                                 const std::string& reader, int depth) {
+        if (!ep) return std::nullopt;
+        const Expr& e = *ep;
+        if (const auto* par = std::get_if<ExprParen>(&e.node)) {
+            return emit(par->inner, scope, definition, reader, depth);
+        }
+        if (const auto* num = std::get_if<ExprNumber>(&e.node)) {
+            Instr instr{Op::Const};
+            try {
+                instr.value = static_cast<float>(std::stod(num->literal.text));
+            } catch (...) {
+                return std::nullopt;
+            }
+            return push(std::move(instr));
+        }
+
+        if (const auto* tr = std::get_if<ExprTensorRef>(&e.node)) {
+            const TensorRef& ref = tr->ref;
+            if (ref.indices.empty()) {
+                Instr instr{Op::Scalar};
+                instr.name = ref.name.name;
+                addName(inputs_, ref.name.name);
+                return push(std::move(instr));
+            }
+            // Elementwise operands broadcast by position, so they must carry
+            // the trailing LHS indices in order
+            std::vector<std::string> names;
+            if (!variables(ref, names) || names.size() > scope.lhs.size() ||
+                !std::equal(names.begin(), names.end(), scope.lhs.end() - static_cast<std::ptrdiff_t>(names.size()))) {
+                return std::nullopt;
+            }
+            if (names.size() == scope.lhs.size() && depth < kMaxDepth) {
+                const TensorEquation* def = definition(ref.name.name);
+                std::vector<std::string> lhs;
+                if (def && plainEquation(*def, lhs) && lhs.size() == names.size() &&
+                    std::none_of(def->lhs.indices.begin(), def->lhs.indices.end(), isNormalized)) {
+                    Scope inner;
+                    for (size_t i = 0; i < lhs.size(); ++i) inner.axis[lhs[i]] = scope.axis.at(names[i]);
+                    inner.lhs = lhs;
+                    for (const auto& name : lhs) addName(index_names_, name);
+                    absorbed_.emplace_back(ref.name.name, reader);
+                    return emit(def->clauses[0].expr, inner, definition, ref.name.name, depth + 1);
+                }
+            }
+            Instr instr{Op::Ref};
+            instr.name = ref.name.name;
+            for (const auto& name : names) instr.axes.push_back(scope.axis.at(name));
+            addName(inputs_, ref.name.name);
+            return push(std::move(instr));
+        }
+
+        if (const auto* bin = std::get_if<ExprBinary>(&e.node)) {
+            using BinOp = ExprBinary::Op;
+            if (bin->op == BinOp::Mul) {
+                const TensorRef* a = refOf(bin->lhs);
+                const TensorRef* b = refOf(bin->rhs);
+                bool contracts = false;
+                if (a && b) {
+                    for (const TensorRef* ref : {a, b}) {
+                        for (const auto& ios : ref->indices) {
+                            const std::string* name = variable(ios);
+                            contracts = contracts || (name && !scope.axis.count(*name));
+                        }
+                    }
+                }
+                if (contracts) {
+                    if (!emitProduct(*a, *b, scope)) return std::nullopt;
+                    return push(Instr{Op::Product});
+                }
+            }
+            Op op;
+            switch (bin->op) {
+            case BinOp::Add: op = Op::Add; break;
+            case BinOp::Sub: op = Op::Sub; break;
+            case BinOp::Mul: op = Op::Mul; break;
+            case BinOp::Div: op = Op::Div; break;
+            case BinOp::Pow: op = Op::Pow; break;
+            default: return std::nullopt;
+            }
+            auto lhs = emit(bin->lhs, scope, definition, reader, depth);
+            if (!lhs) return std::nullopt;
+            auto rhs = emit(bin->rhs, scope, definition, reader, depth);
+            if (!rhs) return std::nullopt;
+            return push(Instr{op, *lhs, *rhs});
+        }
+
+        if (const auto* un = std::get_if<ExprUnary>(&e.node)) {
+            if (un->op != ExprUnary::Op::Neg) return std::nullopt;
+            auto operand = emit(un->operand, scope, definition, reader, depth);
+            if (!operand) return std::nullopt;
+            return push(Instr{Op::Neg, *operand});
+        }
+
+        if (const auto* call = std::get_if<ExprCall>(&e.node)) {
+            struct Entry { const char* name; Op op; };
+            static const Entry kCalls[] = {
+                {"sqrt", Op::Sqrt}, {"abs", Op::Abs}, {"exp", Op::Exp}, {"log", Op::Log},
+                {"tanh", Op::Tanh}, {"sigmoid", Op::Sigmoid}, {"relu", Op::Relu},
+            };
+            if (call->args.size() != 1) return std::nullopt;
+            for (const auto& entry : kCalls) {
+                if (call->func.name != entry.name) continue;
+                auto operand = emit(call->args[0], scope, definition, reader, depth);
+                if (!operand) return std::nullopt;
+                return push(Instr{entry.op, *operand});
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool FusedAttention::emitProduct(const TensorRef& a, const TensorRef& b, const Scope& scope) {
+        // One contraction per chain
+        if (!query_.name.empty()) return false;
+        std::vector<std::string> an, bn;
+        if (!variables(a, an) || !variables(b, bn)) return false;
+
+        const int B = batch_;
+        std::string contracted;
+        auto axesOf = [&](const std::vector<std::string>& names, Operand& operand) {
+            for (const auto& name : names) {
+                auto it = scope.axis.find(name);
+                if (it != scope.axis.end()) {
+                    operand.axes.push_back(it->second);
+                    continue;
+                }
+                if (!contracted.empty() && contracted != name) return false;
+                contracted = name;
+                operand.axes.push_back(B + 2);
+            }
+            return true;
+        };
+        Operand x{a.name.name, {}}, y{b.name.name, {}};
+        if (!axesOf(an, x) || !axesOf(bn, y) || contracted.empty()) return false;
+
+        // Query and key each carry every batch index, their own and the contracted one
+        auto covers = [&](const Operand& operand, int own) {
+            if (operand.axes.size() != static_cast<size_t>(B) + 2) return false;
+            std::vector<int> sorted = operand.axes;
+            std::sort(sorted.begin(), sorted.end());
+            for (int i = 0; i < B; ++i) {
+                if (sorted[i] != i) return false;
+            }
+            return sorted[B] == own && sorted[B + 1] == B + 2;
+        };
+        if (covers(x, B) && covers(y, B + 1)) {
+            query_ = std::move(x);
+            key_ = std::move(y);
+        } else if (covers(x, B + 1) && covers(y, B)) {
+            query_ = std::move(y);
+            key_ = std::move(x);
+        } else {
+            return false;
+        }
+        for (const auto* names : {&an, &bn}) {
+            for (const auto& name : *names) addName(index_names_, name);
+        }
+        addName(inputs_, query_.name);
+        addName(inputs_, key_.name);
+        return true;
+    }
+
+    void FusedAttention::findSdpa() {
+        auto isScale = [&](uint32_t r) { return code_[r].op == Op::Const || code_[r].op == Op::Scalar; };
+        auto isProduct = [&](uint32_t r) { return code_[r].op == Op::Product; };
+        Sdpa sdpa;
+        uint32_t r = static_cast<uint32_t>(code_.size() - 1);
+        if (code_[r].op == Op::Add) {
+            const Instr& add = code_[r];
+            if (code_[add.a].op == Op::Ref) {
+                sdpa.mask = static_cast<int>(add.a);
+                r = add.b;
+            } else if (code_[add.b].op == Op::Ref) {
+                sdpa.mask = static_cast<int>(add.b);
+                r = add.a;
+            }
+        }
+        const Instr& body = code_[r];
+        if (body.op == Op::Product) {
+            // unscaled
+        } else if (body.op == Op::Mul && isProduct(body.a) && isScale(body.b)) {
+            sdpa.scale = static_cast<int>(body.b);
+        } else if (body.op == Op::Mul && isScale(body.a) && isProduct(body.b)) {
+            sdpa.scale = static_cast<int>(body.a);
+        } else if (body.op == Op::Div && isProduct(body.a) && isScale(body.b)) {
+            sdpa.scale = static_cast<int>(body.b);
+            sdpa.divide = true;
+        } else {
+            return;
+        }
+        sdpa_ = sdpa;
+    }
+
+    // -------- Evaluation --------
+
+    Tensor FusedAttention::scores(const Tensor& product, const std::vector<Tensor>& values, int64_t first,
+                                  int64_t rows) const {
+        std::vector<Tensor> reg(code_.size());
+        for (size_t i = 0; i < code_.size(); ++i) {
+            const Instr& in = code_[i];
+            switch (in.op) {
+            case Op::Product: reg[i] = product; break;
+            case Op::Ref:
+                reg[i] = values[i].size(batch_) > 1 ? values[i].narrow(batch_, first, rows) : values[i];
+                break;
+            case Op::Scalar: reg[i] = values[i]; break;
+            case Op::Const: reg[i] = torch::tensor(in.value); break;
+            case Op::Add: reg[i] = reg[in.a] + reg[in.b]; break;
+            case Op::Sub: reg[i] = reg[in.a] - reg[in.b]; break;
+            case Op::Mul: reg[i] = reg[in.a] * reg[in.b]; break;
+            case Op::Div: reg[i] = reg[in.a] / reg[in.b]; break;
+            case Op::Pow: reg[i] = torch::pow(reg[in.a], reg[in.b]); break;
+            case Op::Neg: reg[i] = -reg[in.a]; break;
+            case Op::Sqrt: reg[i] = torch::sqrt(reg[in.a]); break;
+            case Op::Abs: reg[i] = torch::abs(reg[in.a]); break;
+            case Op::Exp: reg[i] = torch::exp(reg[in.a]); break;
+            case Op::Log: reg[i] = torch::log(reg[in.a]); break;
+            case Op::Tanh: reg[i] = torch::tanh(reg[in.a]); break;
+            case Op::Sigmoid: reg[i] = torch::sigmoid(reg[in.a]); break;
+            case Op::Relu: reg[i] = torch::relu(reg[in.a]); break;
+            }
+        }
+        return reg.back();
+    }
+
+    Tensor FusedAttention::evaluate(const Environment& env, const DTypePolicy& policy) const {
+        // Index variables naming bound tensors select elements instead (see ExpressionExecutor)
+        for (const auto& name : index_names_) {
+            if (env.has(name)) return {};
+        }
+        auto bound = [&](const std::string& name, size_t dims, Tensor& out) {
+            if (!env.has(name)) return false;
+            out = env.lookup(name);
+            return out.layout() == torch::kStrided && static_cast<size_t>(out.dim()) == dims;
+        };
+
+        // Query [batch..., Lq, d], key [batch..., Lk, d], values [batch..., Lk, v]
+        const int B = batch_;
+        Tensor q, k, v;
+        if (!bound(query_.name, query_.axes.size(), q) || !bound(key_.name, key_.axes.size(), k) ||
+            !bound(value_.name, value_.axes.size(), v)) {
+            return {};
+        }
+        if (!q.is_floating_point() || !k.is_floating_point() || !v.is_floating_point()) return {};
+        q = policy.toCompute(q.permute(sortedOrder(query_.axes)));
+        k = policy.toCompute(k.permute(sortedOrder(key_.axes)));
+        v = policy.toCompute(v.permute(sortedOrder(value_.axes)));
+        for (int64_t d = 0; d < B; ++d) {
+            if (k.size(d) != q.size(d) || v.size(d) != q.size(d)) return {};
+        }
+        if (k.size(B + 1) != q.size(B + 1) || v.size(B) != k.size(B) || q.size(B) == 0) return {};
+
+        // Score operands in the layout [batch..., Lq, Lk], size 1 where they broadcast
+        std::vector<int64_t> extents(q.sizes().begin(), q.sizes().begin() + B);
+        extents.push_back(q.size(B));
+        extents.push_back(k.size(B));
+        std::vector<Tensor> values(code_.size());
+        for (size_t i = 0; i < code_.size(); ++i) {
+            const Instr& in = code_[i];
+            if (in.op == Op::Scalar) {
+                if (!env.has(in.name)) return {};
+                const Tensor& t = env.lookup(in.name);
+                if (t.layout() != torch::kStrided || t.numel() != 1) return {};
+                values[i] = t.reshape({});
+            } else if (in.op == Op::Ref) {
+                Tensor t;
+                if (!bound(in.name, in.axes.size(), t)) return {};
+                const auto order = sortedOrder(in.axes);
+                std::vector<int64_t> shape(static_cast<size_t>(B) + 2, 1);
+                for (size_t d = 0; d < order.size(); ++d) {
+                    const int a = in.axes[order[d]];
+                    const int64_t n = t.size(order[d]);
+                    if (n != 1 && n != extents[a]) return {};
+                    shape[a] = n;
+                }
+                values[i] = t.permute(order).reshape(shape);
+            }
+        }
+
+        Tensor result;  // [batch..., Lq, v]
+        if (sdpa_ && B <= 2) {
+            double scale = 1.0;
+            if (sdpa_->scale >= 0) {
+                const Instr& in = code_[sdpa_->scale];
+                const double factor = in.op == Op::Const ? in.value : values[sdpa_->scale].item<double>();
+                scale = sdpa_->divide ? 1.0 / factor : factor;
+            }
+            // SDPA takes [batch, heads, length, features]
+            auto fourD = [](Tensor t) {
+                while (t.dim() < 4) t = t.unsqueeze(0);
+                return t;
+            };
+            std::optional<Tensor> mask;
+            if (sdpa_->mask >= 0) mask = fourD(values[sdpa_->mask].to(q.scalar_type()));
+            result = torch::scaled_dot_product_attention(fourD(q), fourD(k), fourD(v), mask, 0.0, false, scale);
+            std::vector<int64_t> shape(extents.begin(), extents.end() - 1);
+            shape.push_back(v.size(B + 1));
+            result = result.reshape(shape).to(policy.accumulate);
+        } else {
+            int64_t batches = 1;
+            for (int d = 0; d < B; ++d) batches *= extents[d];
+            const int64_t rows = std::max<int64_t>(1, kBlockElements / std::max<int64_t>(1, batches * extents[B + 1]));
+            const Tensor keys = k.transpose(-2, -1);
+            std::vector<Tensor> blocks;
+            for (int64_t first = 0; first < extents[B]; first += rows) {
+                const int64_t n = std::min(rows, extents[B] - first);
+                Tensor product = torch::matmul(q.narrow(B, first, n), keys).to(policy.accumulate);
+                Tensor weights = torch::softmax(scores(product, values, first, n), -1);
+                blocks.push_back(torch::matmul(weights.to(v.scalar_type()), v).to(policy.accumulate));
+            }
+            result = blocks.size() == 1 ? blocks.front() : torch::cat(blocks, B);
+        }
+
+        // To the output's index order
+        std::vector<int64_t> order;
+        for (int a : output_axes_) order.push_back(a == B + 2 ? B + 1 : a);
+        return result.permute(order);
+    }
+
+    void FusedAttention::setEnabled(bool enabled) { g_attentionFusionEnabled.store(enabled); }
+    bool FusedAttention::enabled() { return g_attentionFusionEnabled.load(); }
+
+} // namespace tl
@@ -0,0 +1,210 @@
+#include "TL/Runtime/CompiledBody.hpp"
+#include <cctype>
+#include <cstdio>
+
+namespace tl {
+
+CompiledBody CompiledBody::compile(const std::vector<const DatalogAtom*>& atoms,
+                                   const std::vector<const DatalogAtom*>& negations,
+                                   const std::vector<const DatalogCondition*>& conditions,
+                                   const DatalogAtom* head) {
+    CompiledBody body;
+    for (const DatalogAtom* atom : atoms) body.atoms_.push_back(body.compileAtom(*atom));
+    for (const DatalogAtom* atom : negations) body.negations_.push_back(body.compileAtom(*atom));
+    for (const DatalogCondition* cond : conditions) {
+        Condition c;
+        if (cond->op == "==") c.cmp = Condition::Cmp::Eq;
+        else if (cond->op == "!=") c.cmp = Condition::Cmp::Ne;
+        else if (cond->op == ">") c.cmp = Condition::Cmp::Gt;
+        else if (cond->op == "<") c.cmp = Condition::Cmp::Lt;
+        else if (cond->op == ">=") c.cmp = Condition::Cmp::Ge;
+        else if (cond->op == "<=") c.cmp = Condition::Cmp::Le;
+        c.lhs = body.compileExpr(cond->lhs);
+        c.rhs = body.compileExpr(cond->rhs);
+        body.conditions_.push_back(c);
+    }
+    if (head) body.head_ = body.compileAtom(*head);
+    return body;
+}
+
+CompiledBody CompiledBody::compile(const DatalogRule& rule) {
+    std::vector<const DatalogAtom*> atoms;
+    std::vector<const DatalogAtom*> negations;
+    std::vector<const DatalogCondition*> conditions;
+    for (const auto& el : rule.body) {
+        if (const auto* a = std::get_if<DatalogAtom>(&el)) atoms.push_back(a);
+        else if (const auto* n = std::get_if<DatalogNegation>(&el)) negations.push_back(&n->atom);
+        else if (const auto* c = std::get_if<DatalogCondition>(&el)) conditions.push_back(c);
+    }
+    return compile(atoms, negations, conditions, &rule.head);
+}
+
+int CompiledBody::slotOf(const std::string& name) const {
+    for (size_t i = 0; i < slot_names_.size(); ++i) {
+        if (slot_names_[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+uint32_t CompiledBody::slotFor(const std::string& name) {
+    const int existing = slotOf(name);
+    if (existing >= 0) return static_cast<uint32_t>(existing);
+    slot_names_.push_back(name);
+    return static_cast<uint32_t>(slot_names_.size() - 1);
+}
+
+std::vector<CompiledBody::Term> CompiledBody::compileAtom(const DatalogAtom& atom) {
+    std::vector<Term> terms;
+    terms.reserve(atom.terms.size());
+    for (const auto& term : atom.terms) {
+        Term t;
+        if (const auto* id = std::get_if<Identifier>(&term)) {
+            t.kind = Term::Kind::Variable;
+            t.index = slotFor(id->name);
+        } else if (const auto* expr = std::get_if<ExprPtr>(&term)) {
+            t.kind = Term::Kind::Expression;
+            t.index = compileExpr(*expr);
+        }
+        terms.push_back(t);
+    }
+    return terms;
+}
+
+uint32_t CompiledBody::compileExpr(const ExprPtr& expr) {
+    Node node;
+    if (expr) {
+        if (const auto* num = std::get_if<ExprNumber>(&expr->node)) {
+            Literal lit{num->literal.text};
+            lit.numeric = SymbolTable::parseNumber(lit.text, lit.number);
+            node.op = Node::Op::Literal;
+            node.lhs = static_cast<uint32_t>(literals_.size());
+            literals_.push_back(std::move(lit));
+        } else if (const auto* str = std::get_if<ExprString>(&expr->node)) {
+            Literal lit{str->literal.text};
+            lit.numeric = SymbolTable::parseNumber(lit.text, lit.number);
+            node.op = Node::Op::Literal;
+            node.lhs = static_cast<uint32_t>(literals_.size());
+            literals_.push_back(std::move(lit));
+        } else if (const auto* tr = std::get_if<ExprTensorRef>(&expr->node)) {
+            // Lowercase scalar references (no indices) are Datalog variables
+            const std::string& name = tr->ref.name.name;
+            if (tr->ref.indices.empty() && !name.empty() &&
+                std::islower(static_cast<unsigned char>(name[0])) != 0) {
+                node.op = Node::Op::Slot;
+                node.lhs = slotFor(name);
+            }
+        } else if (const auto* paren = std::get_if<ExprParen>(&expr->node)) {
+            return compileExpr(paren->inner);
+        } else if (const auto* bin = std::get_if<ExprBinary>(&expr->node)) {
+            switch (bin->op) {
+                case ExprBinary::Op::Add: node.op = Node::Op::Add; break;
+                case ExprBinary::Op::Sub: node.op = Node::Op::Sub; break;
+                case ExprBinary::Op::Mul: node.op = Node::Op::Mul; break;
+                case ExprBinary::Op::Div: node.op = Node::Op::Div; break;
+                default: break;  // other operators are not Datalog arithmetic
+            }
+            if (node.op != Node::Op::Invalid) {
+                node.lhs = compileExpr(bin->lhs);
+                node.rhs = compileExpr(bin->rhs);
+            }
+        }
+        // Lists and calls stay Invalid
+    }
+    nodes_.push_back(node);
+    return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+bool CompiledBody::evalNode(uint32_t index, const Slots& slots, const SymbolTable& symbols, Value& out) const {
+    const Node& node = nodes_[index];
+    switch (node.op) {
+        case Node::Op::Literal: {
+            const Literal& lit = literals_[node.lhs];
+            out.text = &lit.text;
+            out.symbol = kUnbound;
+            out.numeric = lit.numeric;
+            out.number = lit.number;
+            return true;
+        }
+        case Node::Op::Slot: {
+            const SymbolId id = slots[node.lhs];
+            if (id == kUnbound) return false;
+            out.text = &symbols.name(id);
+            out.symbol = id;
+            out.numeric = symbols.number(id, out.number);
+            return true;
+        }
+        case Node::Op::Add:
+        case Node::Op::Sub:
+        case Node::Op::Mul:
+        case Node::Op::Div: {
+            Value lhs, rhs;
+            if (!evalNode(node.lhs, slots, symbols, lhs)) return false;
+            if (!evalNode(node.rhs, slots, symbols, rhs)) return false;
+            if (!lhs.numeric || !rhs.numeric) return false;
+            double result = 0.0;
+            if (node.op == Node::Op::Add) result = lhs.number + rhs.number;
+            else if (node.op == Node::Op::Sub) result = lhs.number - rhs.number;
+            else if (node.op == Node::Op::Mul) result = lhs.number * rhs.number;
+            else if (rhs.number == 0.0) return false;
+            else result = lhs.number / rhs.number;
+            out.text = nullptr;
+            out.symbol = kUnbound;
+            out.numeric = true;
+            out.number = result;
+            return true;
+        }
+        case Node::Op::Invalid:
+            break;
+    }
+    return false;
+}
+
+bool CompiledBody::testCondition(size_t condition, const Slots& slots, const SymbolTable& symbols) const {
+    const Condition& c = conditions_[condition];
+    Value lhs, rhs;
+    if (!evalNode(c.lhs, slots, symbols, lhs)) return false;
+    if (!evalNode(c.rhs, slots, symbols, rhs)) return false;
+
+    auto compareText = [&] {
+        NumberBuffer lb, rb;
+        const std::string_view ls = text(lhs, lb);
+        const std::string_view rs = text(rhs, rb);
+        switch (c.cmp) {
+            case Condition::Cmp::Eq: return ls == rs;
+            case Condition::Cmp::Ne: return ls != rs;
+            case Condition::Cmp::Gt: return ls > rs;
+            case Condition::Cmp::Lt: return ls < rs;
+            case Condition::Cmp::Ge: return ls >= rs;
+            case Condition::Cmp::Le: return ls <= rs;
+            case Condition::Cmp::Invalid: break;
+        }
+        return false;
+    };
+
+    const bool equality = c.cmp == Condition::Cmp::Eq || c.cmp == Condition::Cmp::Ne;
+    if (equality && (!lhs.numeric || !rhs.numeric)) return compareText();
+    if (lhs.numeric && rhs.numeric) {
+        const double l = lhs.number, r = rhs.number;
+        switch (c.cmp) {
+            case Condition::Cmp::Eq: return l == r;
+            case Condition::Cmp::Ne: return l != r;
+            case Condition::Cmp::Gt: return l > r;
+            case Condition::Cmp::Lt: return l < r;
+            case Condition::Cmp::Ge: return l >= r;
+            case Condition::Cmp::Le: return l <= r;
+            case Condition::Cmp::Invalid: break;
+        }
+        return false;
+    }
+    // Mixed types with ordering: fall back to text comparison
+    return compareText();
+}
+
+std::string_view CompiledBody::text(const Value& value, NumberBuffer& buffer) {
+    if (value.text) return *value.text;
+    // %g with precision 6 is the default formatting of std::ostream
+    const int n = std::snprintf(buffer, sizeof(buffer), "%g", value.number);
+    return std::string_view(buffer, n > 0 ? static_cast<size_t>(n) : 0);
+}
+
+} // namespace tl
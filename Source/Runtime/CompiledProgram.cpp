@@ -0,0 +1,449 @@
+#include "TL/Runtime/CompiledProgram.hpp"
+#include "TL/Runtime/ExecutorUtils.hpp"
+#include "TL/Runtime/PreprocessorRegistry.hpp"
+#include "TL/Runtime/RelationIO.hpp"
+#include "TL/vm.hpp"
+#include <algorithm>
+#include <cctype>
+#include <unordered_set>
+
+namespace tl {
+
+namespace {
+// Equations with a virtual index on the LHS (recurrences such as
+// State[i, *t+1] = ...) are batch-expanded together after everything else.
+// RHS-only virtual indices go through the normal preprocessor chain.
+bool hasVirtualLhs(const Statement& st) {
+    const auto* eq = std::get_if<TensorEquation>(&st);
+    if (!eq) return false;
+    for (const auto& ios : eq->lhs.indices) {
+        if (const auto* idx = std::get_if<Index>(&ios.value)) {
+            if (std::holds_alternative<VirtualIndex>(idx->value)) return true;
+        }
+    }
+    return false;
+}
+
+bool isLabel(const IndexOrSlice& ios) {
+    const auto* idx = std::get_if<Index>(&ios.value);
+    const auto* id = idx ? std::get_if<Identifier>(&idx->value) : nullptr;
+    return id && !id->name.empty() && std::isupper(static_cast<unsigned char>(id->name[0]));
+}
+
+// Labels are numbered in order of first use, so an equation using one must
+// run even if nothing reads its result
+bool usesLabels(const TensorEquation& eq) {
+    bool labels = std::any_of(eq.lhs.indices.begin(), eq.lhs.indices.end(), isLabel);
+    executor_utils::forEachTensorRef(eq, [&](const TensorRef& ref) {
+        labels = labels || std::any_of(ref.indices.begin(), ref.indices.end(), isLabel);
+    });
+    return labels;
+}
+
+// Equations training may pick as parameters (see LearningEngine)
+bool isListLiteral(const TensorEquation& eq) {
+    return eq.clauses.size() == 1 && eq.clauses[0].expr &&
+           std::holds_alternative<ExprList>(eq.clauses[0].expr->node);
+}
+
+// A plain assignment of the whole tensor; earlier values of it are not read
+bool definesWhole(const TensorEquation& eq) {
+    return eq.lhs.indices.empty() && (eq.projection.empty() || eq.projection == "=");
+}
+
+template <typename Body>
+void forEachBodyRead(const Body& body, std::unordered_set<std::string>& relations,
+                     std::unordered_set<std::string>& tensors) {
+    for (const auto& el : body) {
+        if (const auto* atom = std::get_if<DatalogAtom>(&el)) {
+            relations.insert(atom->relation.name);
+        } else if (const auto* neg = std::get_if<DatalogNegation>(&el)) {
+            relations.insert(neg->atom.relation.name);
+        } else if (const auto* cond = std::get_if<DatalogCondition>(&el)) {
+            for (const ExprPtr* side : {&cond->lhs, &cond->rhs}) {
+                if (*side) executor_utils::forEachTensorRef(*side, [&](const TensorRef& ref) { tensors.insert(ref.name.name); });
+            }
+        }
+    }
+}
+}
+
+int CompiledProgram::slotOf(const std::string& name) const {
+    auto it = slot_of_.find(name);
+    return it == slot_of_.end() ? -1 : it->second;
+}
+
+int CompiledProgram::internSlot(const std::string& name) {
+    auto it = slot_of_.find(name);
+    if (it != slot_of_.end()) return it->second;
+    const int slot = static_cast<int>(slot_names_.size());
+    slot_names_.push_back(name);
+    slot_of_.emplace(name, slot);
+    return slot;
+}
+
+void CompiledProgram::collectOperands(const Expr& expr, std::vector<int>& out) {
+    if (const auto* ref = std::get_if<ExprTensorRef>(&expr.node)) {
+        out.push_back(internSlot(ref->ref.name.name));
+    } else if (const auto* bin = std::get_if<ExprBinary>(&expr.node)) {
+        collectOperands(*bin->lhs, out);
+        collectOperands(*bin->rhs, out);
+    } else if (const auto* un = std::get_if<ExprUnary>(&expr.node)) {
+        collectOperands(*un->operand, out);
+    } else if (const auto* call = std::get_if<ExprCall>(&expr.node)) {
+        for (const auto& arg : call->args) collectOperands(*arg, out);
+    } else if (const auto* paren = std::get_if<ExprParen>(&expr.node)) {
+        collectOperands(*paren->inner, out);
+    } else if (const auto* list = std::get_if<ExprList>(&expr.node)) {
+        for (const auto& elem : list->elements) collectOperands(*elem, out);
+    }
+}
+
+int CompiledProgram::collectOperands(const TensorEquation& eq, std::vector<int>& out) {
+    for (const auto& clause : eq.clauses) {
+        if (clause.expr) collectOperands(*clause.expr, out);
+        if (clause.guard && *clause.guard) collectOperands(**clause.guard, out);
+    }
+    return internSlot(eq.lhs.name.name);
+}
+
+CompiledProgram CompiledProgram::compile(const Program& program,
+                                         const PreprocessorRegistry& preprocessors,
+                                         const Environment& env) {
+    CompiledProgram plan;
+    plan.program_ = std::make_shared<const Program>(program);
+    const auto& statements = plan.program_->statements;
+
+    // Same order as the interpreter: plain statements in source order, then
+    // the virtual-indexed batch, then every query.
+    for (size_t i = 0; i < statements.size(); ++i) {
+        const Statement& st = statements[i];
+        if (hasVirtualLhs(st)) {
+            plan.virtual_statements_.push_back(st);
+            continue;
+        }
+        if (std::holds_alternative<Query>(st)) continue;
+
+        Instruction instr{Opcode::Equation, BackendRouter::analyze(st), i, {}, -1};
+        if (const auto* eq = std::get_if<TensorEquation>(&st)) {
+            if (preprocessors.claims(st, env)) instr.op = Opcode::Expand;
+            instr.result = plan.collectOperands(*eq, instr.operands);
+        } else if (const auto* loop = std::get_if<FixedPointLoop>(&st)) {
+            instr.op = Opcode::FixedPoint;
+            instr.result = plan.collectOperands(loop->equation, instr.operands);
+        } else if (std::holds_alternative<DatalogFact>(st)) {
+            instr.op = Opcode::Fact;
+        } else if (std::holds_alternative<DatalogRule>(st)) {
+            instr.op = Opcode::Rule;
+        } else if (const auto* fo = std::get_if<FileOperation>(&st)) {
+            instr.op = Opcode::File;
+            const int slot = plan.internSlot(fo->tensor.name.name);
+            if (fo->lhsIsTensor) {
+                instr.result = slot;
+            } else {
+                instr.operands.push_back(slot);
+            }
+        }
+        plan.instructions_.push_back(std::move(instr));
+    }
+
+    if (!plan.virtual_statements_.empty()) {
+        Instruction batch{Opcode::VirtualBatch, BackendType::LibTorch, statements.size(), {}, -1};
+        // Several tensors are written, so result stays -1; their slots exist all the same
+        for (const auto& st : plan.virtual_statements_) {
+            plan.collectOperands(std::get<TensorEquation>(st), batch.operands);
+        }
+        plan.instructions_.push_back(std::move(batch));
+    }
+
+    for (size_t i = 0; i < statements.size(); ++i) {
+        const auto* q = std::get_if<Query>(&statements[i]);
+        if (!q) continue;
+        Instruction instr{Opcode::Query, BackendRouter::analyze(statements[i]), i, {}, -1};
+        if (const auto* ref = std::get_if<TensorRef>(&q->target)) {
+            instr.operands.push_back(plan.internSlot(ref->name.name));
+        }
+        plan.instructions_.push_back(std::move(instr));
+    }
+
+    plan.executors_.resize(plan.instructions_.size());
+    plan.computeLiveness();
+    plan.findAttention();
+    plan.computeReleases();
+    return plan;
+}
+
+size_t CompiledProgram::deadInstructions() const {
+    return static_cast<size_t>(std::count(live_.begin(), live_.end(), false));
+}
+
+void CompiledProgram::computeLiveness() {
+    const auto& statements = program_->statements;
+    live_.assign(instructions_.size(), false);
+
+    // Relations first: rules are saturated at query time wherever they
+    // appear, so relation liveness ignores source order and is closed over
+    // the rules reading each other
+    std::unordered_set<std::string> relations, tensors;
+    bool training = false;
+    for (const auto& st : statements) {
+        if (const auto* q = std::get_if<Query>(&st)) {
+            if (const auto* atom = std::get_if<DatalogAtom>(&q->target)) relations.insert(atom->relation.name);
+            forEachBodyRead(q->body, relations, tensors);
+            if (const auto* ref = std::get_if<TensorRef>(&q->target)) tensors.insert(ref->name.name);
+            const std::string directive = q->directive ? q->directive->name.name : "";
+            training = training || directive == "minimize" || directive == "maximize";
+        } else if (const auto* fo = std::get_if<FileOperation>(&st)) {
+            if (!fo->lhsIsTensor && relation_io::isRelationFile(fo->file.text)) relations.insert(fo->tensor.name.name);
+        }
+    }
+    for (bool grew = true; grew;) {
+        grew = false;
+        for (const auto& st : statements) {
+            const auto* rule = std::get_if<DatalogRule>(&st);
+            if (!rule || !relations.count(rule->head.relation.name)) continue;
+            const size_t before = relations.size();
+            forEachBodyRead(rule->body, relations, tensors);
+            grew = grew || relations.size() != before;
+        }
+    }
+
+    // Tensors backward in execution order. Queries, and the rule conditions
+    // they saturate, come last, so `tensors` already holds what they read.
+    for (size_t k = instructions_.size(); k-- > 0;) {
+        const Instruction& instr = instructions_[k];
+        if (instr.op == Opcode::Query) {
+            live_[k] = true;
+            continue;
+        }
+        if (instr.op == Opcode::VirtualBatch) {
+            for (const auto& st : virtual_statements_) {
+                live_[k] = live_[k] || tensors.count(std::get<TensorEquation>(st).lhs.name.name) > 0;
+            }
+            if (!live_[k]) continue;
+            for (const auto& st : virtual_statements_) {
+                const auto& eq = std::get<TensorEquation>(st);
+                tensors.insert(eq.lhs.name.name);
+                executor_utils::forEachTensorRef(eq, [&](const TensorRef& ref) { tensors.insert(ref.name.name); });
+                executor_utils::forEachIndexName(eq, [&](const std::string& index) { tensors.insert(index); });
+            }
+            continue;
+        }
+
+        const Statement& st = statements[instr.statement];
+        if (const auto* fact = std::get_if<DatalogFact>(&st)) {
+            live_[k] = relations.count(fact->relation.name) > 0;
+        } else if (const auto* rule = std::get_if<DatalogRule>(&st)) {
+            live_[k] = relations.count(rule->head.relation.name) > 0;
+        } else if (const auto* fo = std::get_if<FileOperation>(&st)) {
+            const std::string& name = fo->tensor.name.name;
+            if (relation_io::isRelationFile(fo->file.text)) {
+                live_[k] = !fo->lhsIsTensor || relations.count(name) > 0;
+            } else if (!fo->lhsIsTensor) {
+                live_[k] = true;
+                tensors.insert(name);
+            } else {
+                live_[k] = tensors.count(name) > 0;
+                if (live_[k] && fo->tensor.indices.empty()) tensors.erase(name);
+            }
+        } else {
+            const auto* eq = std::get_if<TensorEquation>(&st);
+            if (const auto* loop = std::get_if<FixedPointLoop>(&st)) eq = &loop->equation;
+            if (!eq) {
+                live_[k] = true;
+                continue;
+            }
+            const std::string& name = eq->lhs.name.name;
+            live_[k] = tensors.count(name) > 0 || usesLabels(*eq) || (training && isListLiteral(*eq));
+            if (!live_[k]) continue;
+            // Statements expanded at run time may read their own LHS
+            if (instr.op == Opcode::Equation && definesWhole(*eq)) tensors.erase(name);
+            executor_utils::forEachTensorRef(*eq, [&](const TensorRef& ref) { tensors.insert(ref.name.name); });
+            // Index variables may name bound tensors (see ExpressionExecutor)
+            executor_utils::forEachIndexName(*eq, [&](const std::string& index) { tensors.insert(index); });
+        }
+    }
+}
+
+void CompiledProgram::computeReleases() {
+    const auto& statements = program_->statements;
+    released_after_.assign(instructions_.size(), {});
+    std::vector<int> lastUse(slot_names_.size(), -1);
+    std::vector<bool> written(slot_names_.size(), false);
+    std::vector<bool> pinned(slot_names_.size(), false);
+
+    std::unordered_set<std::string> relations, conditions;
+    for (const auto& st : statements) {
+        if (const auto* q = std::get_if<Query>(&st)) {
+            const std::string directive = q->directive ? q->directive->name.name : "";
+            if (directive == "minimize" || directive == "maximize") return;
+            forEachBodyRead(q->body, relations, conditions);
+        } else if (const auto* rule = std::get_if<DatalogRule>(&st)) {
+            forEachBodyRead(rule->body, relations, conditions);
+        }
+    }
+    for (const auto& name : conditions) {
+        const int slot = slotOf(name);
+        if (slot >= 0) pinned[slot] = true;
+    }
+
+    for (size_t k = 0; k < instructions_.size(); ++k) {
+        const Instruction& instr = instructions_[k];
+        // What a fused attention chain reads is read when its last instruction runs
+        const int at = fused_into_[k] >= 0 ? fused_into_[k] : static_cast<int>(k);
+        auto use = [&](int slot) {
+            if (slot >= 0) lastUse[slot] = std::max(lastUse[slot], at);
+        };
+        for (int slot : instr.operands) {
+            use(slot);
+            if (instr.op == Opcode::Query) pinned[slot] = true;
+        }
+        use(instr.result);
+        if (instr.result >= 0) written[instr.result] = true;
+
+        // Index variables may name bound tensors (see ExpressionExecutor)
+        auto indexUses = [&](const TensorEquation& eq) {
+            executor_utils::forEachIndexName(eq, [&](const std::string& index) { use(slotOf(index)); });
+        };
+        if (instr.op == Opcode::VirtualBatch) {
+            for (const auto& st : virtual_statements_) {
+                const auto& eq = std::get<TensorEquation>(st);
+                written[slotOf(eq.lhs.name.name)] = true;
+                indexUses(eq);
+            }
+            continue;
+        }
+        const Statement& st = statements[instr.statement];
+        if (const auto* eq = std::get_if<TensorEquation>(&st)) {
+            indexUses(*eq);
+        } else if (const auto* loop = std::get_if<FixedPointLoop>(&st)) {
+            indexUses(loop->equation);
+        }
+    }
+
+    for (size_t slot = 0; slot < slot_names_.size(); ++slot) {
+        if (written[slot] && !pinned[slot] && lastUse[slot] >= 0) {
+            released_after_[lastUse[slot]].push_back(static_cast<int>(slot));
+        }
+    }
+}
+
+const CompiledProgram::AttentionGroup* CompiledProgram::attentionAt(size_t k) const {
+    return attention_of_[k] < 0 ? nullptr : &attention_[attention_of_[k]];
+}
+
+void CompiledProgram::findAttention() {
+    const auto& statements = program_->statements;
+    attention_.clear();
+    attention_of_.assign(instructions_.size(), -1);
+    fused_into_.assign(instructions_.size(), -1);
+
+    // A chain may absorb tensors one equation writes and one other equation
+    // reads; queries, files, conditions and index variables pin theirs
+    const size_t slotCount = slot_names_.size();
+    std::vector<int> writer(slotCount, -1), writes(slotCount, 0), reads(slotCount, 0);
+    std::vector<bool> pinned(slotCount, false);
+    std::unordered_set<std::string> relations, conditions;
+    for (const auto& st : statements) {
+        if (const auto* q = std::get_if<Query>(&st)) {
+            const std::string directive = q->directive ? q->directive->name.name : "";
+            if (directive == "minimize" || directive == "maximize") return;
+            forEachBodyRead(q->body, relations, conditions);
+        } else if (const auto* rule = std::get_if<DatalogRule>(&st)) {
+            forEachBodyRead(rule->body, relations, conditions);
+        }
+    }
+    auto pin = [&](const std::string& name) {
+        const int slot = slotOf(name);
+        if (slot >= 0) pinned[slot] = true;
+    };
+    for (const auto& name : conditions) pin(name);
+    auto pinIndices = [&](const TensorEquation& eq) {
+        auto scan = [&](const TensorRef& ref) {
+            for (const auto& ios : ref.indices) {
+                const auto* idx = std::get_if<Index>(&ios.value);
+                const auto* id = idx ? std::get_if<Identifier>(&idx->value) : nullptr;
+                if (id) pin(id->name);
+            }
+        };
+        scan(eq.lhs);
+        executor_utils::forEachTensorRef(eq, scan);
+    };
+
+    for (size_t k = 0; k < instructions_.size(); ++k) {
+        const Instruction& instr = instructions_[k];
+        std::unordered_set<int> seen;
+        for (int slot : instr.operands) {
+            if (seen.insert(slot).second) ++reads[slot];
+            if (instr.op != Opcode::Equation) pinned[slot] = true;
+        }
+        if (instr.result >= 0) {
+            ++writes[instr.result];
+            writer[instr.result] = static_cast<int>(k);
+        }
+        if (instr.op == Opcode::VirtualBatch) {
+            for (const auto& st : virtual_statements_) {
+                const auto& eq = std::get<TensorEquation>(st);
+                pin(eq.lhs.name.name);
+                pinIndices(eq);
+            }
+        } else if (const auto* eq = std::get_if<TensorEquation>(&statements[instr.statement])) {
+            pinIndices(*eq);
+        } else if (const auto* loop = std::get_if<FixedPointLoop>(&statements[instr.statement])) {
+            pinIndices(loop->equation);
+        }
+    }
+
+    auto definition = [&](const std::string& name) -> const TensorEquation* {
+        const int slot = slotOf(name);
+        if (slot < 0 || pinned[slot] || writes[slot] != 1 || reads[slot] != 1) return nullptr;
+        const Instruction& def = instructions_[writer[slot]];
+        if (def.op != Opcode::Equation || def.backend != BackendType::LibTorch) return nullptr;
+        return &std::get<TensorEquation>(statements[def.statement]);
+    };
+
+    for (size_t k = 0; k < instructions_.size(); ++k) {
+        const Instruction& instr = instructions_[k];
+        if (instr.op != Opcode::Equation || instr.backend != BackendType::LibTorch) continue;
+        const auto& output = std::get<TensorEquation>(statements[instr.statement]);
+        auto kernel = FusedAttention::match(output, definition);
+        if (!kernel) continue;
+
+        // Every absorbed tensor is written before the equation reading it,
+        // so the chain sees the values sequential execution would
+        std::vector<size_t> members;
+        std::unordered_set<int> absorbed;
+        bool ok = true;
+        for (const auto& [name, reader] : kernel->absorbed()) {
+            const int slot = slotOf(name);
+            const int at = writer[slot];
+            const int readAt = reader == output.lhs.name.name ? static_cast<int>(k) : writer[slotOf(reader)];
+            ok = ok && at < readAt && fused_into_[at] < 0 && attention_of_[at] < 0;
+            members.push_back(static_cast<size_t>(at));
+            absorbed.insert(slot);
+        }
+        std::sort(members.begin(), members.end());
+        std::unordered_set<int> inputs;
+        for (const auto& name : kernel->inputs()) {
+            const int slot = slotOf(name);
+            ok = ok && !absorbed.count(slot);
+            inputs.insert(slot);
+        }
+        // Nor is what the chain reads rebound while it is pending
+        for (size_t j = ok ? members.front() + 1 : k; j < k; ++j) {
+            if (std::binary_search(members.begin(), members.end(), j)) continue;
+            const Instruction& between = instructions_[j];
+            if (between.op == Opcode::VirtualBatch || (between.result >= 0 && inputs.count(between.result))) {
+                ok = false;
+                break;
+            }
+        }
+        if (!ok) continue;
+
+        attention_of_[k] = static_cast<int>(attention_.size());
+        for (size_t m : members) fused_into_[m] = static_cast<int>(k);
+        attention_.push_back({std::move(*kernel), std::move(members)});
+    }
+}
+
+} // namespace tl
@@ -0,0 +1,112 @@
+#include "TL/Runtime/DTypePolicy.hpp"
+#include <torch/torch.h>
+#include <stdexcept>
+
+namespace tl {
+
+    namespace {
+
+    torch::ScalarType parseType(const std::string& name) {
+        if (name == "fp32" || name == "float32" || name == "float") return torch::kFloat32;
+        if (name == "bf16" || name == "bfloat16") return torch::kBFloat16;
+        if (name == "fp16" || name == "float16" || name == "half") return torch::kFloat16;
+        if (name == "bool") return torch::kBool;
+        if (name == "uint8" || name == "u8") return torch::kUInt8;
+        throw std::invalid_argument("Unknown dtype: " + name);
+    }
+
+    std::string typeName(torch::ScalarType type) {
+        switch (type) {
+            case torch::kFloat32: return "fp32";
+            case torch::kBFloat16: return "bf16";
+            case torch::kFloat16: return "fp16";
+            case torch::kBool: return "bool";
+            case torch::kUInt8: return "uint8";
+            default: return "other";
+        }
+    }
+
+    bool isReduced(torch::ScalarType type) {
+        return type == torch::kBFloat16 || type == torch::kFloat16;
+    }
+
+    bool isMaskType(torch::ScalarType type) {
+        return type == torch::kBool || type == torch::kUInt8;
+    }
+
+    } // namespace
+
+    DTypePolicy DTypePolicy::parse(const std::string& spec) {
+        DTypePolicy policy;
+        size_t start = 0;
+        while (start <= spec.size()) {
+            const size_t comma = spec.find(',', start);
+            const std::string item = spec.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+            start = comma == std::string::npos ? spec.size() + 1 : comma + 1;
+            if (item.empty()) continue;
+
+            const size_t eq = item.find('=');
+            if (eq == std::string::npos) {
+                if (item == "fp32") {
+                    policy = DTypePolicy{};
+                } else if (item == "mixed-bf16" || item == "mixed-fp16") {
+                    policy = DTypePolicy{};
+                    policy.compute = item == "mixed-bf16" ? torch::kBFloat16 : torch::kFloat16;
+                    policy.mask = torch::kBool;
+                } else if (item == "bf16" || item == "fp16") {
+                    const auto reduced = item == "bf16" ? torch::kBFloat16 : torch::kFloat16;
+                    policy = DTypePolicy{reduced, reduced, reduced, torch::kBool};
+                } else {
+                    throw std::invalid_argument("Unknown dtype policy: " + item +
+                                                " (expected fp32, mixed-bf16, mixed-fp16, bf16 or fp16)");
+                }
+                continue;
+            }
+
+            const std::string key = item.substr(0, eq);
+            const torch::ScalarType type = parseType(item.substr(eq + 1));
+            const bool floating = type == torch::kFloat32 || isReduced(type);
+            if (key == "mask") {
+                policy.mask = type;
+            } else if (!floating) {
+                throw std::invalid_argument("Dtype policy '" + key + "' must be a floating type");
+            } else if (key == "value") {
+                policy.value = type;
+            } else if (key == "compute") {
+                policy.compute = type;
+            } else if (key == "accumulate") {
+                policy.accumulate = type;
+            } else {
+                throw std::invalid_argument("Unknown dtype policy field: " + key);
+            }
+        }
+        return policy;
+    }
+
+    torch::ScalarType DTypePolicy::storageFor(torch::ScalarType type) const {
+        if (type == torch::kBool) return isMaskType(mask) ? mask : value;
+        if (type == torch::kFloat32 || type == torch::kFloat64 || isReduced(type)) return value;
+        return type;
+    }
+
+    Tensor DTypePolicy::normalize(const Tensor& t) const {
+        if (!t.defined()) return t;
+        const torch::ScalarType target = storageFor(t.scalar_type());
+        return target == t.scalar_type() ? t : t.to(target);
+    }
+
+    Tensor DTypePolicy::toCompute(const Tensor& t) const {
+        return t.scalar_type() == compute ? t : t.to(compute);
+    }
+
+    bool DTypePolicy::operator==(const DTypePolicy& other) const {
+        return value == other.value && compute == other.compute &&
+               accumulate == other.accumulate && mask == other.mask;
+    }
+
+    std::string DTypePolicy::str() const {
+        return "value=" + typeName(value) + ",compute=" + typeName(compute) +
+               ",accumulate=" + typeName(accumulate) + ",mask=" + typeName(mask);
+    }
+
+} // namespace tl
@@ -1,10 +1,18 @@
 #include "TL/Runtime/DatalogEngine.hpp"
+#include "TL/Runtime/PartitionedDatalog.hpp"
+#include "TL/Runtime/Profiler.hpp"
+#include "TL/Runtime/TensorDatalog.hpp"
 #include "TL/vm.hpp"
 #include <sstream>
 #include <unordered_set>
-#include <optional>
 #include <cctype>
 #include <functional>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+// Debug line of this engine on its output stream, compiled out above TL_LOG_LEVEL
+#define DATALOG_LOG(level, message) TL_LOG(level, debug_, *output_stream_, "[DatalogEngine] " << message)
 
 namespace tl {
 
@@ -17,7 +25,7 @@ bool DatalogEngine::addFact(const DatalogFact& fact) {
     bool inserted = env_.addFact(fact);
     if (inserted) {
         closure_dirty_ = true;
-        if (debug_) {
+        if (logging(LogLevel::Trace)) {
             std::ostringstream oss;
             oss << "Added fact: " << fact.relation.name << "(";
             for (size_t i = 0; i < fact.constants.size(); ++i) {
@@ -35,179 +43,1117 @@ bool DatalogEngine::addFact(const DatalogFact& fact) {
     return inserted;
 }
 
+size_t DatalogEngine::addFacts(const std::string& relation, size_t arity, const SymbolId* tuples, size_t count) {
+    const size_t inserted = env_.addFacts(relation, arity, tuples, count);
+    if (inserted > 0) {
+        closure_dirty_ = true;
+        DATALOG_LOG(Debug, "Added " << inserted << " facts to " << relation);
+    }
+    return inserted;
+}
+
 void DatalogEngine::addRule(const DatalogRule& rule) {
     rules_.push_back(rule);
+    try {
+        strata_ = computeStrata();
+    } catch (...) {
+        rules_.pop_back();
+        throw;
+    }
+    compiled_.push_back(CompiledBody::compile(rule));
     closure_dirty_ = true;
-    if (debug_) {
-        debugLog("Registered Datalog rule");
+    DATALOG_LOG(Debug, "Registered Datalog rule");
+}
+
+std::vector<DatalogEngine::Stratum> DatalogEngine::computeStrata() const {
+    // Predicate dependency graph: head -> every relation its body reads.
+    // Nodes are numbered in order of first appearance, so the strata come
+    // out in the same order for the same program.
+    std::unordered_map<std::string, size_t> nodeOf;
+    std::vector<std::string> names;
+    auto node = [&](const std::string& name) {
+        auto it = nodeOf.find(name);
+        if (it != nodeOf.end()) return it->second;
+        nodeOf.emplace(name, names.size());
+        names.push_back(name);
+        return names.size() - 1;
+    };
+    std::vector<std::vector<size_t>> deps;
+    for (const auto& rule : rules_) {
+        const size_t head = node(rule.head.relation.name);
+        std::vector<size_t> bodyNodes;
+        for (const auto& el : rule.body) {
+            if (const auto* a = std::get_if<DatalogAtom>(&el)) bodyNodes.push_back(node(a->relation.name));
+            else if (const auto* n = std::get_if<DatalogNegation>(&el)) bodyNodes.push_back(node(n->atom.relation.name));
+        }
+        deps.resize(names.size());
+        for (size_t b : bodyNodes) deps[head].push_back(b);
+    }
+    deps.resize(names.size());
+
+    // Tarjan's algorithm; a component is emitted only after every
+    // component it depends on, which is the evaluation order
+    const size_t unvisited = static_cast<size_t>(-1);
+    std::vector<size_t> index(names.size(), unvisited), low(names.size(), 0), component(names.size(), 0);
+    std::vector<bool> onStack(names.size(), false);
+    std::vector<size_t> stack;
+    size_t nextIndex = 0, components = 0;
+    std::function<void(size_t)> connect = [&](size_t v) {
+        index[v] = low[v] = nextIndex++;
+        stack.push_back(v);
+        onStack[v] = true;
+        for (size_t w : deps[v]) {
+            if (index[w] == unvisited) {
+                connect(w);
+                low[v] = std::min(low[v], low[w]);
+            } else if (onStack[w]) {
+                low[v] = std::min(low[v], index[w]);
+            }
+        }
+        if (low[v] == index[v]) {
+            size_t w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                onStack[w] = false;
+                component[w] = components;
+            } while (w != v);
+            ++components;
+        }
+    };
+    for (size_t v = 0; v < names.size(); ++v) {
+        if (index[v] == unvisited) connect(v);
     }
+
+    std::vector<Stratum> byComponent(components);
+    for (size_t r = 0; r < rules_.size(); ++r) {
+        const DatalogRule& rule = rules_[r];
+        const size_t c = component[nodeOf.at(rule.head.relation.name)];
+        Stratum& stratum = byComponent[c];
+        stratum.rules.push_back(r);
+        if (std::find(stratum.heads.begin(), stratum.heads.end(), rule.head.relation.name) == stratum.heads.end()) {
+            stratum.heads.push_back(rule.head.relation.name);
+        }
+        for (const auto& el : rule.body) {
+            if (const auto* a = std::get_if<DatalogAtom>(&el)) {
+                if (component[nodeOf.at(a->relation.name)] == c) stratum.recursive = true;
+            } else if (const auto* n = std::get_if<DatalogNegation>(&el)) {
+                if (component[nodeOf.at(n->atom.relation.name)] == c) {
+                    throw std::runtime_error("Datalog program is not stratifiable: " +
+                                             rule.head.relation.name + " depends on the negation of " +
+                                             n->atom.relation.name + " within a recursive cycle");
+                }
+            }
+        }
+    }
+
+    // Components without rules hold base facts only
+    std::vector<Stratum> strata;
+    for (auto& stratum : byComponent) {
+        if (!stratum.rules.empty()) strata.push_back(std::move(stratum));
+    }
+    return strata;
+}
+
+void DatalogEngine::setNumThreads(size_t threads) {
+    if (threads != num_threads_) pool_.reset();
+    num_threads_ = threads;
+}
+
+DatalogEngine::State DatalogEngine::state() const {
+    State state;
+    state.rules = rules_;
+    state.closure.reserve(closure_.size());
+    for (const auto& kv : closure_) state.closure.emplace_back(kv.first, kv.second.deltaEnd);
+    state.closureRules = closure_rules_;
+    state.dirty = closure_dirty_;
+    return state;
+}
+
+void DatalogEngine::restore(const State& state) {
+    std::vector<DatalogRule> previous = std::move(rules_);
+    rules_ = state.rules;
+    try {
+        strata_ = computeStrata();
+    } catch (...) {
+        rules_ = std::move(previous);
+        throw;
+    }
+    compiled_.clear();
+    for (const auto& rule : rules_) compiled_.push_back(CompiledBody::compile(rule));
+    closure_.clear();
+    for (const auto& [name, rows] : state.closure) closure_[name].deltaEnd = rows;
+    closure_rules_ = std::min(state.closureRules, rules_.size());
+    closure_dirty_ = state.dirty;
+    plan_cache_.clear();
+    DATALOG_LOG(Debug, "Restored " << rules_.size() << " rules, closure " << (closure_dirty_ ? "dirty" : "saturated"));
 }
 
 void DatalogEngine::saturate() {
     if (!closure_dirty_ || rules_.empty()) return;
+    if (partitions_ > 1) {
+        saturatePartitioned();
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+
+    // Join plans are chosen from the relation sizes seen by this saturation
+    plan_cache_.clear();
+    if (logging(LogLevel::Debug) && semi_naive_ && closure_rules_ > 0) {
+        size_t newFacts = 0;
+        for (const auto& kv : snapshotRelations(&closure_)) {
+            newFacts += kv.second.deltaEnd - kv.second.deltaBegin;
+        }
+        debugLog("Incremental saturation seeded with " + std::to_string(newFacts) + " new facts and " +
+                 std::to_string(rules_.size() - closure_rules_) + " new rules.");
+    }
+    size_t rounds = 0;
+    for (size_t i = 0; i < strata_.size(); ++i) {
+        const Stratum& stratum = strata_[i];
+        const auto stratumStart = std::chrono::steady_clock::now();
+        size_t stratumRounds = 0;
+        const bool viaTensors = saturateWithTensors(stratum, stratumRounds);
+        if (!viaTensors) stratumRounds = semi_naive_ ? saturateSemiNaive(stratum) : saturateNaive(stratum);
+        rounds += stratumRounds;
+        if (logging(LogLevel::Debug) || profiler_) {
+            std::string heads;
+            for (const auto& h : stratum.heads) heads += (heads.empty() ? "" : ", ") + h;
+            if (profiler_) {
+                profiler_->recordSpan("Stratum " + std::to_string(i) + " {" + heads + "}", "datalog",
+                                      stratumStart, std::chrono::steady_clock::now(),
+                                      {{"rounds", std::to_string(stratumRounds)},
+                                       {"evaluation", viaTensors ? "tensors" : semi_naive_ ? "semi-naive" : "naive"}});
+            }
+            if (logging(LogLevel::Debug)) {
+                debugLog("Stratum " + std::to_string(i) + " {" + heads + "}" +
+                         (stratum.recursive ? " reached fixpoint after " + std::to_string(stratumRounds) + " rounds"
+                                            : " applied once") +
+                         (viaTensors ? " as tensors." : "."));
+            }
+        }
+    }
+
+    if (logging(LogLevel::Debug)) {
+        debugLog(std::string(semi_naive_ ? "Semi-naive" : "Naive") +
+                 " rule saturation reached fixpoint after " + std::to_string(rounds) + " rounds.");
+    }
+    closure_ = snapshotRelations(nullptr);
+    closure_rules_ = rules_.size();
+    closure_dirty_ = false;
+    saturation_time_ += std::chrono::steady_clock::now() - start;
+}
+
+void DatalogEngine::saturatePartitioned() {
+    const auto start = std::chrono::steady_clock::now();
+    if (num_threads_ != 1) ThreadPool::obtain(pool_, num_threads_);
+    ThreadPool* pool = num_threads_ != 1 ? pool_.get() : nullptr;
+    plan_cache_.clear();
+
+    // Consecutive partitionable strata share one PartitionedDatalog; the
+    // others are saturated in this store on the facts added before them
+    size_t derived = 0;
+    size_t rounds = 0;
+    size_t shuffled = 0;
+    std::vector<std::vector<size_t>> pending;
+    auto runPending = [&]() {
+        if (pending.empty()) return;
+        PartitionedDatalog partitioned(rules_, std::move(pending), partitions_);
+        pending.clear();
+        derived += partitioned.run(env_, pool);
+        rounds += partitioned.rounds();
+        shuffled += partitioned.shuffled();
+    };
+    for (const Stratum& stratum : strata_) {
+        if (std::all_of(stratum.rules.begin(), stratum.rules.end(),
+                        [&](size_t r) { return PartitionedDatalog::partitionable(rules_[r]); })) {
+            pending.push_back(stratum.rules);
+            continue;
+        }
+        runPending();
+        size_t stratumRounds = 0;
+        const bool viaTensors = saturateWithTensors(stratum, stratumRounds);
+        if (!viaTensors) stratumRounds = semi_naive_ ? saturateSemiNaive(stratum) : saturateNaive(stratum);
+        if (logging(LogLevel::Debug)) {
+            std::string heads;
+            for (const auto& h : stratum.heads) heads += (heads.empty() ? "" : ", ") + h;
+            debugLog("Stratum {" + heads + "} cannot be partitioned and was saturated in one store after " +
+                     std::to_string(stratumRounds) + " rounds" + (viaTensors ? " as tensors." : "."));
+        }
+    }
+    runPending();
+
+    if (profiler_) {
+        profiler_->recordSpan("Partitioned saturation", "datalog", start, std::chrono::steady_clock::now(),
+                              {{"partitions", std::to_string(partitions_)},
+                               {"rounds", std::to_string(rounds)},
+                               {"shuffled", std::to_string(shuffled)}});
+    }
+    DATALOG_LOG(Debug, "Partitioned saturation over " << partitions_ << " partitions derived " << derived
+                                                      << " facts in " << rounds << " rounds, shipping " << shuffled
+                                                      << " tuples between partitions.");
+    closure_ = snapshotRelations(nullptr);
+    closure_rules_ = rules_.size();
+    closure_dirty_ = false;
+    saturation_time_ += std::chrono::steady_clock::now() - start;
+}
 
-    size_t totalNew = 0;
-    size_t iter = 0;
+bool DatalogEngine::saturateWithTensors(const Stratum& stratum, size_t& rounds) {
+    if (!tensor_mode_ || !tensor_backend_) return false;
+    std::vector<const DatalogRule*> rules;
+    for (size_t r : stratum.rules) {
+        if (!TensorDatalog::supports(rules_[r])) return false;
+        rules.push_back(&rules_[r]);
+    }
+    TensorDatalog tensors(env_, *tensor_backend_);
+    if (!tensors.saturate(rules, stratum.recursive, rounds)) return false;
+    if (logging(LogLevel::Debug)) {
+        for (const DatalogRule* rule : rules) {
+            debugLog("Tensor rule for " + rule->head.relation.name + ": einsum(\"" +
+                     TensorDatalog::einsumSpec(*rule) + "\") > 0");
+        }
+    }
+    return true;
+}
+
+size_t DatalogEngine::saturateNaive(const Stratum& stratum) {
+    size_t rounds = 0;
     while (true) {
         size_t roundNew = 0;
-        for (const auto& r : rules_) {
-            roundNew += applyRule(r);
+        for (size_t r : stratum.rules) {
+            roundNew += applyRule(r, snapshotRelations(nullptr), kNoDeltaAtom);
         }
-        totalNew += roundNew;
-        ++iter;
-        if (roundNew == 0) break;
+        ++rounds;
+        // Rules of a non-recursive stratum cannot see their own output
+        if (roundNew == 0 || !stratum.recursive) break;
     }
+    return rounds;
+}
 
-    if (debug_) {
-        debugLog("Rule saturation finished after fixpoint.");
+size_t DatalogEngine::saturateSemiNaive(const Stratum& stratum) {
+    // First round: rules registered since the last saturation are joined
+    // once over the whole database. The closure already holds every
+    // consequence of the older rules over the facts it covers, so those
+    // rules only need variants reading the facts added since (all facts,
+    // the first time round).
+    RoundSnapshot snapshot = snapshotRelations(&closure_);
+    std::vector<RuleVariant> variants;
+    for (size_t r : stratum.rules) {
+        if (r >= closure_rules_) {
+            RuleVariant v;
+            if (prepareVariant(r, snapshot, kNoDeltaAtom, v)) variants.push_back(std::move(v));
+        } else {
+            addDeltaVariants(r, snapshot, variants);
+        }
     }
-    closure_dirty_ = false;
+    size_t roundNew = evaluateRound(variants);
+    size_t rounds = 1;
+
+    // Later rounds: only facts derived by the previous round can produce
+    // new consequences, so evaluate one variant per body atom whose
+    // relation has a non-empty delta, with that atom reading the delta.
+    // Lower strata are complete, so only this stratum's relations change.
+    while (roundNew > 0 && stratum.recursive) {
+        snapshot = snapshotRelations(&snapshot);
+        variants.clear();
+        for (size_t r : stratum.rules) addDeltaVariants(r, snapshot, variants);
+        roundNew = evaluateRound(variants);
+        ++rounds;
+    }
+    return rounds;
 }
 
-size_t DatalogEngine::applyRule(const DatalogRule& rule) {
-    // Collect body atoms, negations and conditions
-    std::vector<DatalogAtom> bodyAtoms;
-    std::vector<DatalogNegation> negations;
-    std::vector<DatalogCondition> conditions;
-    bodyAtoms.reserve(rule.body.size());
-    for (const auto& el : rule.body) {
-        if (const auto* a = std::get_if<DatalogAtom>(&el)) bodyAtoms.push_back(*a);
-        else if (const auto* n = std::get_if<DatalogNegation>(&el)) negations.push_back(*n);
-        else if (const auto* c = std::get_if<DatalogCondition>(&el)) conditions.push_back(*c);
+void DatalogEngine::addDeltaVariants(size_t ruleIndex,
+                                     const RoundSnapshot& snapshot,
+                                     std::vector<RuleVariant>& variants) {
+    size_t atomIdx = 0;
+    for (const auto& el : rules_[ruleIndex].body) {
+        const auto* a = std::get_if<DatalogAtom>(&el);
+        if (!a) continue;
+        auto it = snapshot.find(a->relation.name);
+        if (it != snapshot.end() && it->second.deltaEnd > it->second.deltaBegin) {
+            RuleVariant v;
+            if (prepareVariant(ruleIndex, snapshot, atomIdx, v)) variants.push_back(std::move(v));
+        }
+        ++atomIdx;
     }
-    if (bodyAtoms.empty()) return 0;
+}
 
-    size_t newCount = 0;
+DatalogEngine::RoundSnapshot DatalogEngine::snapshotRelations(const RoundSnapshot* previous) const {
+    RoundSnapshot snapshot;
+    for (const auto& kv : env_.relations()) {
+        RelationWindow w;
+        w.deltaEnd = kv.second.size();
+        if (previous) {
+            auto it = previous->find(kv.first);
+            w.deltaBegin = (it != previous->end()) ? it->second.deltaEnd : 0;
+        }
+        snapshot.emplace(kv.first, w);
+    }
+    return snapshot;
+}
 
-    auto hasMatch = [&](const DatalogAtom& a, const std::unordered_map<std::string, std::string>& binding) -> bool {
-        const auto& tuples = env_.facts(a.relation.name);
-        for (const auto& tup : tuples) {
-            if (tup.size() != a.terms.size()) continue;
-            bool ok = true;
-            for (size_t i = 0; i < a.terms.size(); ++i) {
-                const auto& term = a.terms[i];
-                const std::string& val = tup[i];
-                if (std::holds_alternative<StringLiteral>(term)) {
-                    if (std::get<StringLiteral>(term).text != val) { ok = false; break; }
-                } else if (std::holds_alternative<Identifier>(term)) {
-                    const std::string& vn = std::get<Identifier>(term).name;
-                    auto it = binding.find(vn);
-                    if (it != binding.end() && it->second != val) { ok = false; break; }
-                } else {
-                    // ExprPtr: evaluate and compare
-                    const auto& expr = std::get<ExprPtr>(term);
-                    std::string outStr; double outNum = 0; bool isNumeric = false;
-                    if (!evalExprBinding(expr, binding, outStr, outNum, isNumeric)) {
-                        ok = false; break;
+DatalogEngine::ResolvedAtom DatalogEngine::resolveAtom(const DatalogAtom& atom,
+                                                      const CompiledBody& code,
+                                                      const std::vector<CompiledBody::Term>& terms) const {
+    ResolvedAtom resolved;
+    resolved.atom = &atom;
+    resolved.relation = env_.relation(atom.relation.name);
+    resolved.code = &code;
+    resolved.terms = &terms;
+    resolved.constants.assign(atom.terms.size(), kUnknownSymbol);
+    for (size_t i = 0; i < atom.terms.size(); ++i) {
+        if (const auto* sl = std::get_if<StringLiteral>(&atom.terms[i])) {
+            SymbolId id = kUnknownSymbol;
+            env_.symbols().lookup(sl->text, id);
+            resolved.constants[i] = id;
+        }
+    }
+    return resolved;
+}
+
+bool DatalogEngine::matchTuple(const ResolvedAtom& ra,
+                               const SymbolId* tuple,
+                               Binding& binding,
+                               std::vector<uint32_t>* assigned) const {
+    const std::vector<CompiledBody::Term>& terms = *ra.terms;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        const CompiledBody::Term& term = terms[i];
+        const SymbolId val = tuple[i];
+        switch (term.kind) {
+            case CompiledBody::Term::Kind::Constant:
+                if (ra.constants[i] != val) return false;
+                break;
+            case CompiledBody::Term::Kind::Variable: {
+                SymbolId& slot = binding[term.index];
+                if (slot == CompiledBody::kUnbound) {
+                    if (assigned) {
+                        slot = val;
+                        assigned->push_back(term.index);
                     }
-                    if (outStr != val) { ok = false; break; }
+                } else if (slot != val) {
+                    return false;
+                }
+                break;
+            }
+            case CompiledBody::Term::Kind::Expression: {
+                // Evaluate and compare with tuple value
+                CompiledBody::Value value;
+                if (!ra.code->evaluate(term, binding, env_.symbols(), value)) return false;
+                if (value.symbol != CompiledBody::kUnbound) {
+                    if (value.symbol != val) return false;
+                } else {
+                    CompiledBody::NumberBuffer buffer;
+                    if (CompiledBody::text(value, buffer) != env_.symbols().name(val)) return false;
+                }
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void DatalogEngine::fillProbeKey(const ResolvedAtom& ra,
+                                 const Binding& binding,
+                                 Relation::ColumnMask mask,
+                                 std::vector<SymbolId>& key) const {
+    const std::vector<CompiledBody::Term>& terms = *ra.terms;
+    key.assign(terms.size(), kUnknownSymbol);
+    for (size_t i = 0; i < terms.size() && i < 64; ++i) {
+        if (((mask >> i) & 1u) == 0) continue;
+        // The plan only marks constants and variables that earlier steps have bound
+        key[i] = terms[i].kind == CompiledBody::Term::Kind::Constant ? ra.constants[i] : binding[terms[i].index];
+    }
+}
+
+// Visit the rows in [begin, end) that can match under the given bound
+// columns: a probe of the relation's index when any column is bound, a
+// scan otherwise. visit(row) returns false to stop early. Rows appended
+// while visiting lie past end and are skipped.
+template <typename Visit>
+static void forEachCandidate(const Relation& relation,
+                             Relation::ColumnMask mask,
+                             const std::vector<SymbolId>& key,
+                             size_t begin,
+                             size_t end,
+                             Visit&& visit) {
+    if (mask == 0) {
+        for (size_t row = begin; row < end; ++row) {
+            if (!visit(row)) return;
+        }
+        return;
+    }
+    const Relation::RowList* rows = relation.probe(mask, key.data());
+    if (!rows) return;
+    size_t k = static_cast<size_t>(
+        std::lower_bound(rows->begin(), rows->end(), static_cast<uint32_t>(begin)) - rows->begin());
+    for (; k < rows->size(); ++k) {
+        const size_t row = (*rows)[k];
+        if (row >= end) return;
+        if (!visit(row)) return;
+    }
+}
+
+bool DatalogEngine::hasMatch(const ResolvedAtom& ra, Binding& binding, Relation::ColumnMask mask) const {
+    // The relation may have been created since the atom was resolved
+    const Relation* relation = ra.relation ? ra.relation : env_.relation(ra.atom->relation.name);
+    if (!relation || relation->arity() != ra.atom->terms.size()) return false;
+    std::vector<SymbolId> key;
+    fillProbeKey(ra, binding, mask, key);
+    bool found = false;
+    forEachCandidate(*relation, mask, key, 0, relation->size(), [&](size_t row) {
+        found = matchTuple(ra, relation->row(row), binding, nullptr);
+        return !found;
+    });
+    return found;
+}
+
+// Datalog variables an expression reads: lowercase scalar references, as
+// compiled by CompiledBody
+static void collectExprVars(const ExprPtr& e, std::vector<std::string>& vars) {
+    if (!e) return;
+    if (const auto* tr = std::get_if<ExprTensorRef>(&e->node)) {
+        const std::string& name = tr->ref.name.name;
+        if (tr->ref.indices.empty() && !name.empty() &&
+            std::islower(static_cast<unsigned char>(name[0])) != 0) {
+            vars.push_back(name);
+        }
+    } else if (const auto* paren = std::get_if<ExprParen>(&e->node)) {
+        collectExprVars(paren->inner, vars);
+    } else if (const auto* bin = std::get_if<ExprBinary>(&e->node)) {
+        collectExprVars(bin->lhs, vars);
+        collectExprVars(bin->rhs, vars);
+    }
+}
+
+// Every variable an atom mentions, in identifier or expression terms
+static std::vector<std::string> atomVars(const DatalogAtom& atom) {
+    std::vector<std::string> vars;
+    for (const auto& term : atom.terms) {
+        if (const auto* id = std::get_if<Identifier>(&term)) vars.push_back(id->name);
+        else if (const auto* expr = std::get_if<ExprPtr>(&term)) collectExprVars(*expr, vars);
+    }
+    return vars;
+}
+
+// Columns of an atom that are known before it is matched: constants, and
+// identifiers in `bound` (only the first 64 columns can be indexed)
+static Relation::ColumnMask boundMask(const DatalogAtom& atom, const std::unordered_set<std::string>& bound) {
+    Relation::ColumnMask mask = 0;
+    for (size_t t = 0; t < atom.terms.size() && t < 64; ++t) {
+        const auto& term = atom.terms[t];
+        if (std::holds_alternative<StringLiteral>(term) ||
+            (std::holds_alternative<Identifier>(term) && bound.count(std::get<Identifier>(term).name))) {
+            mask |= Relation::ColumnMask{1} << t;
+        }
+    }
+    return mask;
+}
+
+DatalogEngine::JoinPlan DatalogEngine::planJoin(const std::vector<ResolvedAtom>& atoms,
+                                                const std::vector<size_t>& cardinalities,
+                                                const std::vector<ResolvedAtom>& negations,
+                                                const std::vector<const DatalogCondition*>& conditions) const {
+    const size_t n = atoms.size();
+    JoinPlan plan;
+    plan.order.reserve(n);
+    plan.atomMasks.reserve(n);
+    plan.conditionsAt.resize(n + 1);
+    plan.negationsAt.resize(n + 1);
+    plan.negationMasks.resize(negations.size(), 0);
+
+    // Only identifier terms of positive atoms bind variables
+    std::unordered_set<std::string> positiveVars;
+    for (const auto& ra : atoms) {
+        for (const auto& term : ra.atom->terms) {
+            if (const auto* id = std::get_if<Identifier>(&term)) positiveVars.insert(id->name);
+        }
+    }
+
+    // An expression term is evaluated while its atom is matched, so its
+    // variables must be bound earlier or by identifiers to its left
+    auto exprTermsReady = [&](const DatalogAtom& atom, const std::unordered_set<std::string>& bound) {
+        std::unordered_set<std::string> local;
+        for (const auto& term : atom.terms) {
+            if (const auto* id = std::get_if<Identifier>(&term)) {
+                local.insert(id->name);
+            } else if (const auto* expr = std::get_if<ExprPtr>(&term)) {
+                std::vector<std::string> vars;
+                collectExprVars(*expr, vars);
+                for (const auto& v : vars) {
+                    if (!bound.count(v) && !local.count(v)) return false;
                 }
             }
-            if (ok) return true;
         }
-        return false;
+        return true;
+    };
+
+    // Expected rows per partial binding: exact average bucket size when the
+    // relation already has an index on the bound columns, otherwise a 1/10
+    // selectivity guess per bound column
+    auto estimateRows = [&](size_t i, const std::unordered_set<std::string>& bound) -> double {
+        const ResolvedAtom& ra = atoms[i];
+        const double card = static_cast<double>(cardinalities[i]);
+        if (card == 0.0) return 0.0;
+        size_t boundCount = 0;
+        for (const auto& term : ra.atom->terms) {
+            if (std::holds_alternative<StringLiteral>(term) ||
+                (std::holds_alternative<Identifier>(term) && bound.count(std::get<Identifier>(term).name))) {
+                ++boundCount;
+            }
+        }
+        const Relation::ColumnMask mask = boundMask(*ra.atom, bound);
+        if (boundCount == 0) return card;
+        if (boundCount == ra.atom->terms.size()) return std::min(card, 1.0);
+        if (ra.relation) {
+            if (const size_t keys = ra.relation->keyCount(mask)) {
+                return std::max(card / static_cast<double>(keys), 1.0);
+            }
+        }
+        double est = card;
+        for (size_t b = 0; b < boundCount; ++b) est *= 0.1;
+        return std::max(est, 1.0);
     };
 
-    // Depth-first join over positive body atoms
-    std::unordered_map<std::string, std::string> binding;
-    std::function<void(size_t)> dfs = [&](size_t idx) {
-        if (idx == bodyAtoms.size()) {
-            // Evaluate conditions as filters
-            for (const auto& cond : conditions) {
-                if (!evalCondition(cond, binding)) return; // reject this binding
+    // Greedy order; ties keep source order
+    std::unordered_set<std::string> bound;
+    std::vector<std::unordered_set<std::string>> boundBefore;  // bound at each step
+    boundBefore.push_back(bound);
+    std::vector<bool> placed(n, false);
+    for (size_t step = 0; step < n; ++step) {
+        size_t best = n;
+        double bestRows = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            if (placed[i] || !exprTermsReady(*atoms[i].atom, bound)) continue;
+            const double rows = estimateRows(i, bound);
+            if (best == n || rows < bestRows) {
+                best = i;
+                bestRows = rows;
             }
-            // Evaluate negations: all must have no match
-            for (const auto& neg : negations) {
-                if (hasMatch(neg.atom, binding)) return; // reject if negated atom holds
+        }
+        if (best == n) {
+            // No atom has its expression terms ready: fall back to source order
+            for (size_t i = 0; i < n; ++i) {
+                if (!placed[i]) { best = i; break; }
+            }
+        }
+        placed[best] = true;
+        plan.order.push_back(best);
+        plan.atomMasks.push_back(boundMask(*atoms[best].atom, bound));
+        for (const auto& term : atoms[best].atom->terms) {
+            if (const auto* id = std::get_if<Identifier>(&term)) bound.insert(id->name);
+        }
+        boundBefore.push_back(bound);
+    }
+
+    // Earliest step at which every variable the filter shares with the
+    // positive atoms is bound (variables no atom binds never become bound,
+    // so they do not delay the filter)
+    auto earliestStep = [&](const std::vector<std::string>& vars) -> size_t {
+        for (size_t step = 0; step <= n; ++step) {
+            bool ready = true;
+            for (const auto& v : vars) {
+                if (positiveVars.count(v) && !boundBefore[step].count(v)) { ready = false; break; }
+            }
+            if (ready) return step;
+        }
+        return n;
+    };
+
+    for (size_t c = 0; c < conditions.size(); ++c) {
+        std::vector<std::string> vars;
+        collectExprVars(conditions[c]->lhs, vars);
+        collectExprVars(conditions[c]->rhs, vars);
+        plan.conditionsAt[earliestStep(vars)].push_back(c);
+    }
+    for (size_t g = 0; g < negations.size(); ++g) {
+        const size_t step = earliestStep(atomVars(*negations[g].atom));
+        plan.negationsAt[step].push_back(g);
+        plan.negationMasks[g] = boundMask(*negations[g].atom, boundBefore[step]);
+    }
+    return plan;
+}
+
+size_t DatalogEngine::applyRule(size_t ruleIndex, const RoundSnapshot& snapshot, size_t deltaAtom) {
+    RuleVariant variant;
+    if (!prepareVariant(ruleIndex, snapshot, deltaAtom, variant)) return 0;
+    const auto& outer = variant.windows[variant.plan->order.front()];
+    return evaluateVariant(variant, outer.first, outer.second, nullptr);
+}
+
+bool DatalogEngine::prepareVariant(size_t ruleIndex,
+                                   const RoundSnapshot& snapshot,
+                                   size_t deltaAtom,
+                                   RuleVariant& variant) {
+    // Collect body atoms, negations and conditions
+    const DatalogRule& rule = rules_[ruleIndex];
+    const CompiledBody& code = compiled_[ruleIndex];
+    variant.rule = &rule;
+    variant.code = &code;
+    std::vector<ResolvedAtom>& bodyAtoms = variant.atoms;
+    bodyAtoms.reserve(rule.body.size());
+    for (const auto& el : rule.body) {
+        if (const auto* a = std::get_if<DatalogAtom>(&el)) {
+            bodyAtoms.push_back(resolveAtom(*a, code, code.atomTerms(bodyAtoms.size())));
+        } else if (const auto* n = std::get_if<DatalogNegation>(&el)) {
+            variant.negations.push_back(resolveAtom(n->atom, code, code.negationTerms(variant.negations.size())));
+        } else if (const auto* c = std::get_if<DatalogCondition>(&el)) {
+            variant.conditions.push_back(c);
+        }
+    }
+    if (bodyAtoms.empty()) return false;
+
+    // Rows of the relation each atom may read in this round (see applyRule docs)
+    std::vector<std::pair<size_t, size_t>>& windows = variant.windows;
+    windows.assign(bodyAtoms.size(), {0, 0});
+    std::vector<size_t> cardinalities(bodyAtoms.size());
+    for (size_t i = 0; i < bodyAtoms.size(); ++i) {
+        const ResolvedAtom& ra = bodyAtoms[i];
+        auto it = snapshot.find(ra.atom->relation.name);
+        if (ra.relation && ra.relation->arity() == ra.atom->terms.size() && it != snapshot.end()) {
+            const RelationWindow& w = it->second;
+            if (deltaAtom == kNoDeltaAtom || i > deltaAtom) windows[i] = {0, w.deltaEnd};
+            else if (i == deltaAtom) windows[i] = {w.deltaBegin, w.deltaEnd};
+            else windows[i] = {0, w.deltaBegin};
+        }
+        cardinalities[i] = windows[i].second - windows[i].first;
+        // Joining with an empty window derives nothing
+        if (cardinalities[i] == 0) return false;
+    }
+
+    auto planIt = plan_cache_.find({&rule, deltaAtom});
+    if (planIt == plan_cache_.end()) {
+        planIt = plan_cache_.emplace(std::make_pair(&rule, deltaAtom),
+                                     planJoin(bodyAtoms, cardinalities, variant.negations, variant.conditions)).first;
+        if (logging(LogLevel::Trace)) {
+            std::ostringstream oss;
+            oss << "Join plan for " << rule.head.relation.name << ":";
+            for (size_t idx : planIt->second.order) {
+                oss << " " << bodyAtoms[idx].atom->relation.name
+                    << (idx == deltaAtom ? "[delta]" : "") << "(" << cardinalities[idx] << ")";
             }
+            debugLog(oss.str());
+        }
+    }
+    variant.plan = &planIt->second;
+
+    // Build every index the join will probe up front: evaluation may run
+    // on several threads and must not mutate the relations it reads
+    for (size_t step = 0; step < variant.plan->order.size(); ++step) {
+        const Relation::ColumnMask mask = variant.plan->atomMasks[step];
+        if (mask != 0) bodyAtoms[variant.plan->order[step]].relation->ensureIndex(mask);
+    }
+    for (size_t g = 0; g < variant.negations.size(); ++g) {
+        const ResolvedAtom& neg = variant.negations[g];
+        const Relation::ColumnMask mask = variant.plan->negationMasks[g];
+        if (mask != 0 && neg.relation && neg.relation->arity() == neg.atom->terms.size()) {
+            neg.relation->ensureIndex(mask);
+        }
+    }
+
+    // Head constants are interned here for the same reason
+    variant.headConstants.assign(rule.head.terms.size(), kUnknownSymbol);
+    for (size_t i = 0; i < rule.head.terms.size(); ++i) {
+        if (const auto* sl = std::get_if<StringLiteral>(&rule.head.terms[i])) {
+            variant.headConstants[i] = env_.symbols().intern(sl->text);
+        }
+    }
+    variant.headRelation = env_.relation(rule.head.relation.name);
+    return true;
+}
+
+size_t DatalogEngine::evaluateVariant(const RuleVariant& variant,
+                                      size_t outerBegin,
+                                      size_t outerEnd,
+                                      DerivedTuples* buffer) {
+    const DatalogRule& rule = *variant.rule;
+    const JoinPlan& plan = *variant.plan;
+    const std::vector<ResolvedAtom>& bodyAtoms = variant.atoms;
+    const size_t headArity = rule.head.terms.size();
+    size_t newCount = 0;
+
+    // Depth-first join over positive body atoms in plan order. probeKey is
+    // only read while probing, so one buffer serves every depth; trail
+    // records the slots bound at each depth for rollback.
+    const CompiledBody& code = *variant.code;
+    const SymbolTable& symbols = env_.symbols();
+    Binding binding(code.slotCount(), CompiledBody::kUnbound);
+    std::vector<uint32_t> trail;
+    std::vector<SymbolId> headTuple;
+    std::vector<SymbolId> probeKey;
+    std::vector<std::string> pendingValues;  // expression results not interned yet
+    size_t matches = 0;
+    std::function<void(size_t)> dfs = [&](size_t step) {
+        // Filters whose variables are bound by now
+        for (size_t c : plan.conditionsAt[step]) {
+            if (!code.testCondition(c, binding, symbols)) return; // reject this binding
+        }
+        for (size_t g : plan.negationsAt[step]) {
+            // reject if negated atom holds
+            if (hasMatch(variant.negations[g], binding, plan.negationMasks[g])) return;
+        }
+
+        if (step == plan.order.size()) {
+            ++matches;
             // Build head tuple
-            std::vector<std::string> headTuple;
-            headTuple.reserve(rule.head.terms.size());
-            for (const auto& t : rule.head.terms) {
-                if (std::holds_alternative<StringLiteral>(t)) {
-                    headTuple.push_back(std::get<StringLiteral>(t).text);
-                } else if (std::holds_alternative<Identifier>(t)) {
-                    const std::string& vn = std::get<Identifier>(t).name;
-                    auto it = binding.find(vn);
-                    if (it == binding.end()) {
-                        // Unsafe variable in head: skip
-                        return;
-                    }
-                    headTuple.push_back(it->second);
+            headTuple.clear();
+            pendingValues.clear();
+            const std::vector<CompiledBody::Term>& headTerms = code.headTerms();
+            for (size_t i = 0; i < headArity; ++i) {
+                const CompiledBody::Term& t = headTerms[i];
+                if (t.kind == CompiledBody::Term::Kind::Constant) {
+                    headTuple.push_back(variant.headConstants[i]);
+                } else if (t.kind == CompiledBody::Term::Kind::Variable) {
+                    // Unsafe variable in head: skip
+                    if (binding[t.index] == CompiledBody::kUnbound) return;
+                    headTuple.push_back(binding[t.index]);
                 } else {
-                    // ExprPtr: evaluate the arithmetic expression
-                    const auto& expr = std::get<ExprPtr>(t);
-                    std::string outStr; double outNum = 0; bool isNumeric = false;
-                    if (!evalExprBinding(expr, binding, outStr, outNum, isNumeric)) {
+                    // Evaluate the arithmetic expression
+                    CompiledBody::Value value;
+                    if (!code.evaluate(t, binding, symbols, value)) {
                         // Failed to evaluate expression: skip this binding
                         return;
                     }
-                    headTuple.push_back(outStr);
+                    if (value.symbol != CompiledBody::kUnbound) {
+                        headTuple.push_back(value.symbol);
+                        continue;
+                    }
+                    CompiledBody::NumberBuffer numberText;
+                    std::string text(CompiledBody::text(value, numberText));
+                    if (!buffer) {
+                        headTuple.push_back(env_.symbols().intern(text));
+                        continue;
+                    }
+                    SymbolId id = kUnknownSymbol;
+                    if (symbols.lookup(text, id)) {
+                        headTuple.push_back(id);
+                    } else {
+                        headTuple.push_back(kPendingSymbol | static_cast<SymbolId>(buffer->pending.size() + pendingValues.size()));
+                        pendingValues.push_back(std::move(text));
+                    }
                 }
             }
-            if (env_.addFact(rule.head.relation.name, headTuple)) {
-                ++newCount;
+            if (!buffer) {
+                if (env_.addFact(rule.head.relation.name, headTuple)) ++newCount;
+                return;
             }
+            // Tuples that already hold can be dropped before the merge
+            if (pendingValues.empty() && variant.headRelation &&
+                variant.headRelation->arity() == headArity &&
+                variant.headRelation->contains(headTuple.data())) {
+                return;
+            }
+            buffer->values.insert(buffer->values.end(), headTuple.begin(), headTuple.end());
+            for (auto& v : pendingValues) buffer->pending.push_back(std::move(v));
+            ++buffer->count;
             return;
         }
 
-        const DatalogAtom& atom = bodyAtoms[idx];
-        const auto& tuples = env_.facts(atom.relation.name);
-        for (const auto& tup : tuples) {
-            if (tup.size() != atom.terms.size()) continue;
-            // Local modifications to binding; keep a list to rollback
-            std::vector<std::string> assignedVars;
-            bool ok = true;
-            for (size_t i = 0; i < atom.terms.size(); ++i) {
-                const auto& term = atom.terms[i];
-                const std::string& val = tup[i];
-                if (std::holds_alternative<StringLiteral>(term)) {
-                    if (std::get<StringLiteral>(term).text != val) { ok = false; break; }
-                } else if (std::holds_alternative<Identifier>(term)) {
-                    const std::string& vn = std::get<Identifier>(term).name;
-                    auto it = binding.find(vn);
-                    if (it == binding.end()) {
-                        binding.emplace(vn, val);
-                        assignedVars.push_back(vn);
-                    } else if (it->second != val) {
-                        ok = false; break;
-                    }
-                } else {
-                    // ExprPtr: evaluate and compare with tuple value
-                    const auto& expr = std::get<ExprPtr>(term);
-                    std::string outStr; double outNum = 0; bool isNumeric = false;
-                    if (!evalExprBinding(expr, binding, outStr, outNum, isNumeric)) {
-                        ok = false; break;
-                    }
-                    if (outStr != val) { ok = false; break; }
-                }
-            }
-            if (ok) {
-                dfs(idx + 1);
+        const size_t idx = plan.order[step];
+        const ResolvedAtom& atom = bodyAtoms[idx];
+        const Relation::ColumnMask mask = plan.atomMasks[step];
+        fillProbeKey(atom, binding, mask, probeKey);
+        size_t begin = variant.windows[idx].first;
+        size_t end = variant.windows[idx].second;
+        if (step == 0) {
+            begin = std::max(begin, outerBegin);
+            end = std::min(end, outerEnd);
+        }
+        const size_t mark = trail.size();
+        forEachCandidate(*atom.relation, mask, probeKey, begin, end, [&](size_t row) {
+            // Fetch by position: head facts derived below may grow this relation
+            if (matchTuple(atom, atom.relation->row(row), binding, &trail)) {
+                dfs(step + 1);
             }
             // rollback
-            for (const auto& vn : assignedVars) binding.erase(vn);
-        }
+            while (trail.size() > mark) {
+                binding[trail.back()] = CompiledBody::kUnbound;
+                trail.pop_back();
+            }
+            return true;
+        });
     };
 
     dfs(0);
+    // Buffered slices are joins of a variant evaluateRound counts once
+    if (profiler_) profiler_->recordRule(toString(Statement(rule)), buffer ? 0 : 1, matches, newCount);
+    return newCount;
+}
+
+size_t DatalogEngine::evaluateRound(const std::vector<RuleVariant>& variants) {
+    size_t outerRows = 0;
+    for (const auto& v : variants) {
+        const auto& outer = v.windows[v.plan->order.front()];
+        outerRows += outer.second - outer.first;
+    }
+    if (num_threads_ != 1 && outerRows >= kParallelMinRows) ThreadPool::obtain(pool_, num_threads_);
+
+    size_t newCount = 0;
+    if (num_threads_ == 1 || outerRows < kParallelMinRows || pool_->size() <= 1) {
+        for (const auto& v : variants) {
+            const auto& outer = v.windows[v.plan->order.front()];
+            newCount += evaluateVariant(v, outer.first, outer.second, nullptr);
+        }
+        return newCount;
+    }
+
+    // One task per slice of each variant's outermost atom. Every task reads
+    // the frozen snapshot windows and writes only its own buffer.
+    struct Task {
+        const RuleVariant* variant;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Task> tasks;
+    for (const auto& v : variants) {
+        const auto& outer = v.windows[v.plan->order.front()];
+        for (size_t begin = outer.first; begin < outer.second; begin += kRowsPerTask) {
+            tasks.push_back({&v, begin, std::min(begin + kRowsPerTask, outer.second)});
+        }
+    }
+    if (profiler_) {
+        for (const auto& v : variants) profiler_->recordRule(toString(Statement(*v.rule)), 1, 0, 0);
+    }
+    std::vector<DerivedTuples> buffers(tasks.size());
+    pool_->parallelFor(tasks.size(), [&](size_t t) {
+        evaluateVariant(*tasks[t].variant, tasks[t].begin, tasks[t].end, &buffers[t]);
+    });
+
+    // Merge in task order, which is the order the sequential join derives
+    // facts in, so the result does not depend on scheduling
+    std::vector<SymbolId> tuple;
+    std::vector<SymbolId> pendingIds;
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        const DatalogRule& rule = *tasks[t].variant->rule;
+        const size_t arity = rule.head.terms.size();
+        DerivedTuples& buffer = buffers[t];
+        pendingIds.clear();
+        for (const auto& text : buffer.pending) pendingIds.push_back(env_.symbols().intern(text));
+        size_t derived = 0;
+        for (size_t i = 0; i < buffer.count; ++i) {
+            tuple.assign(buffer.values.begin() + i * arity, buffer.values.begin() + (i + 1) * arity);
+            for (auto& value : tuple) {
+                if (value & kPendingSymbol) value = pendingIds[value & ~kPendingSymbol];
+            }
+            if (env_.addFact(rule.head.relation.name, tuple)) ++derived;
+        }
+        newCount += derived;
+        if (profiler_ && derived) profiler_->recordRule(toString(Statement(rule)), 0, 0, derived);
+    }
+    if (logging(LogLevel::Trace)) {
+        debugLog("Evaluated " + std::to_string(variants.size()) + " rule variants as " +
+                 std::to_string(tasks.size()) + " parallel tasks on " +
+                 std::to_string(pool_->size()) + " threads.");
+    }
     return newCount;
 }
 
 void DatalogEngine::query(const Query& q, std::ostream& out) {
+    query_io::writeText(out, answer(q), env_.symbols());
+}
+
+QueryResult DatalogEngine::answer(const Query& q) {
     // Only handle Datalog queries here; tensor queries handled by VM
     if (std::holds_alternative<TensorRef>(q.target)) {
         // This shouldn't happen - tensor queries should be handled by VM
         throw std::runtime_error("DatalogEngine::query called with TensorRef query");
     }
 
+    const QueryModifiers& modifiers = q.modifiers;
+    if (modifiers.topk) throw std::invalid_argument("@topk ranks tensor queries; limit Datalog answers with @limit");
+    size_t limit = modifiers.limit ? static_cast<size_t>(*modifiers.limit) : kNoLimit;
+    if (modifiers.exists) limit = std::min<size_t>(limit, 1);
+
+    QueryResult result = answerDatalogQuery(std::get<DatalogAtom>(q.target), q.body, limit);
+    if (modifiers.exists) {
+        // Reported like a query without variables: whether an answer was found
+        result.variables.clear();
+        result.columns.clear();
+    }
+    return result;
+}
+
+QueryResult DatalogEngine::solve(const Query& q) {
+    if (std::holds_alternative<TensorRef>(q.target)) {
+        throw std::runtime_error("DatalogEngine::solve called with TensorRef query");
+    }
+    if (demand_driven_ && closure_dirty_ && q.body.empty()) {
+        if (auto result = answerOnDemand(q)) return std::move(*result);
+    }
+    saturate();
+    return answer(q);
+}
+
+// Relation `name` read with the bound ('b') and free ('f') arguments of
+// `adornment`, and the magic relation holding the bound values it is read
+// with. '$' cannot appear in identifiers, so neither clashes with a program
+// relation.
+static std::string adornedName(const std::string& name, const std::string& adornment) {
+    return name + "$" + adornment;
+}
+
+static std::string magicName(const std::string& name, const std::string& adornment) {
+    return name + "$" + adornment + "$magic";
+}
+
+static DatalogAtom adornedAtom(const DatalogAtom& atom, const std::string& adornment) {
+    DatalogAtom adorned = atom;
+    adorned.relation.name = adornedName(atom.relation.name, adornment);
+    return adorned;
+}
+
+// Magic atom of an atom read with `adornment`: its terms at the bound positions
+static DatalogAtom magicAtom(const DatalogAtom& atom, const std::string& adornment) {
+    DatalogAtom magic;
+    magic.relation.name = magicName(atom.relation.name, adornment);
+    magic.loc = atom.loc;
+    for (size_t i = 0; i < adornment.size(); ++i) {
+        if (adornment[i] == 'b') magic.terms.push_back(atom.terms[i]);
+    }
+    return magic;
+}
+
+std::optional<QueryResult> DatalogEngine::answerOnDemand(const Query& q) {
     const auto& atom = std::get<DatalogAtom>(q.target);
-    execDatalogQuery(atom, q.body, out);
+    std::unordered_map<std::string, std::vector<const DatalogRule*>> rulesFor;
+    for (const auto& rule : rules_) rulesFor[rule.head.relation.name].push_back(&rule);
+    // Facts of a relation no rule derives are complete already
+    if (!rulesFor.count(atom.relation.name)) return answer(q);
+
+    std::string queryAdornment;
+    std::vector<std::string> queryConstants;
+    for (const auto& term : atom.terms) {
+        const auto* sl = std::get_if<StringLiteral>(&term);
+        queryAdornment += sl ? 'b' : 'f';
+        if (sl) queryConstants.push_back(sl->text);
+    }
+    if (queryConstants.empty()) return std::nullopt;
+
+    // Rewrite the rules of every relation reachable from the query, once
+    // per adornment it is read with. Variables are bound left to right:
+    // by the bound head arguments, then by each positive atom in turn.
+    std::vector<DatalogRule> rewritten;
+    std::vector<std::pair<std::string, std::vector<std::string>>> seeds{
+        {magicName(atom.relation.name, queryAdornment), queryConstants}};
+    std::vector<std::string> scratch;
+    std::vector<std::pair<std::string, std::string>> pending{{atom.relation.name, queryAdornment}};
+    std::unordered_set<std::string> visited{adornedName(atom.relation.name, queryAdornment)};
+    while (!pending.empty()) {
+        const auto [name, adornment] = pending.back();
+        pending.pop_back();
+        const bool guarded = adornment.find('b') != std::string::npos;
+        scratch.push_back(adornedName(name, adornment));
+        if (guarded) scratch.push_back(magicName(name, adornment));
+
+        // Facts stored in the relation, asserted or derived earlier, hold too
+        DatalogRule stored;
+        DatalogAtom read;
+        read.relation.name = name;
+        for (size_t i = 0; i < adornment.size(); ++i) read.terms.push_back(Identifier{"v" + std::to_string(i)});
+        stored.head = adornedAtom(read, adornment);
+        if (guarded) stored.body.push_back(magicAtom(read, adornment));
+        stored.body.push_back(read);
+        rewritten.push_back(std::move(stored));
+
+        for (const DatalogRule* rule : rulesFor[name]) {
+            const DatalogAtom& head = rule->head;
+            // Saturation reports the arity mismatch
+            if (head.terms.size() != adornment.size()) return std::nullopt;
+            DatalogRule modified;
+            modified.head = adornedAtom(head, adornment);
+            modified.loc = rule->loc;
+            std::unordered_set<std::string> bound;
+            if (guarded) {
+                for (size_t i = 0; i < adornment.size(); ++i) {
+                    if (adornment[i] != 'b') continue;
+                    if (const auto* id = std::get_if<Identifier>(&head.terms[i])) bound.insert(id->name);
+                    else if (!std::holds_alternative<StringLiteral>(head.terms[i])) return std::nullopt;
+                }
+                modified.body.push_back(magicAtom(head, adornment));
+            }
+            // Positive atoms joined before the current one, which bind its magic values
+            std::vector<std::variant<DatalogAtom, DatalogNegation, DatalogCondition>> prefix = modified.body;
+            for (const auto& el : rule->body) {
+                const auto* a = std::get_if<DatalogAtom>(&el);
+                if (!a) {
+                    // A negated derived relation would have to be complete
+                    const auto* neg = std::get_if<DatalogNegation>(&el);
+                    if (neg && rulesFor.count(neg->atom.relation.name)) return std::nullopt;
+                    modified.body.push_back(el);
+                    continue;
+                }
+                if (!rulesFor.count(a->relation.name)) {
+                    modified.body.push_back(el);
+                    prefix.push_back(el);
+                } else {
+                    std::string bodyAdornment;
+                    for (const auto& term : a->terms) {
+                        const auto* id = std::get_if<Identifier>(&term);
+                        const bool isBound = std::holds_alternative<StringLiteral>(term) || (id && bound.count(id->name));
+                        bodyAdornment += isBound ? 'b' : 'f';
+                    }
+                    if (bodyAdornment.find('b') != std::string::npos) {
+                        DatalogRule magic;
+                        magic.head = magicAtom(*a, bodyAdornment);
+                        if (prefix.empty()) {
+                            // Only constants are bound: the demand is a fact
+                            std::vector<std::string> values;
+                            for (const auto& term : magic.head.terms) values.push_back(std::get<StringLiteral>(term).text);
+                            seeds.emplace_back(magic.head.relation.name, std::move(values));
+                        } else {
+                            magic.body = prefix;
+                            magic.loc = rule->loc;
+                            rewritten.push_back(std::move(magic));
+                        }
+                    }
+                    if (visited.insert(adornedName(a->relation.name, bodyAdornment)).second) {
+                        pending.emplace_back(a->relation.name, bodyAdornment);
+                    }
+                    DatalogAtom adorned = adornedAtom(*a, bodyAdornment);
+                    modified.body.push_back(adorned);
+                    prefix.push_back(std::move(adorned));
+                }
+                for (const auto& term : a->terms) {
+                    if (const auto* id = std::get_if<Identifier>(&term)) bound.insert(id->name);
+                }
+            }
+            rewritten.push_back(std::move(modified));
+        }
+    }
+
+    // Scratch relations are dropped however the evaluation ends
+    struct ScratchRelations {
+        Environment& env;
+        const std::vector<std::string>& names;
+        ~ScratchRelations() {
+            for (const auto& name : names) env.removeRelation(name);
+        }
+    } cleanup{env_, scratch};
+
+    DATALOG_LOG(Debug, "Answering " << atom.relation.name << "$" << queryAdornment << " on demand with "
+                                    << rewritten.size() << " magic-set rules.");
+    for (const auto& seed : seeds) env_.addFact(seed.first, seed.second);
+    DatalogEngine demand(env_, output_stream_);
+    demand.semi_naive_ = semi_naive_;
+    demand.debug_ = debug_;
+    demand.num_threads_ = num_threads_;
+    demand.pool_ = pool_;
+    demand.profiler_ = profiler_;
+    for (const auto& rule : rewritten) demand.addRule(rule);
+    demand.saturate();
+    saturation_time_ += demand.saturation_time_;
+
+    Query adorned = q;
+    adorned.target = adornedAtom(atom, queryAdornment);
+    QueryResult result = answer(adorned);
+    result.name = atom.relation.name;
+    return result;
 }
 
-void DatalogEngine::execDatalogQuery(const DatalogAtom& atom,
-                                     const std::vector<std::variant<DatalogAtom, DatalogNegation, DatalogCondition>>& body,
-                                     std::ostream& out) {
+QueryResult DatalogEngine::answerDatalogQuery(const DatalogAtom& atom,
+                                              const std::vector<std::variant<DatalogAtom, DatalogNegation, DatalogCondition>>& body,
+                                              size_t limit) {
+    QueryResult result;
+    result.name = atom.relation.name;
     // If this is a conjunctive Datalog query with optional comparisons, evaluate via join
     if (!body.empty()) {
         // Separate atoms, negations, and conditions
@@ -221,8 +1167,10 @@ void DatalogEngine::execDatalogQuery(const DatalogAtom& atom,
             else if (const auto* c = std::get_if<DatalogCondition>(&el)) conditions.push_back(*c);
         }
         if (atoms.empty()) {
-            out << "None" << std::endl;
-            return;
+            // Nothing to join: no answers over one unnamed variable, printed as None
+            result.variables.push_back("");
+            result.columns.emplace_back();
+            return result;
         }
 
         // Determine variable output order across atoms by first appearance
@@ -240,114 +1188,96 @@ void DatalogEngine::execDatalogQuery(const DatalogAtom& atom,
         };
         for (const auto& a : atoms) considerAtomVars(a);
 
-        // Helper to test if an atom has any matching tuple under current binding
-        auto hasMatch = [&](const DatalogAtom& a, const std::unordered_map<std::string, std::string>& binding) -> bool {
-            const auto& tuples = env_.facts(a.relation.name);
-            for (const auto& tup : tuples) {
-                if (tup.size() != a.terms.size()) continue;
-                bool ok = true;
-                for (size_t i = 0; i < a.terms.size(); ++i) {
-                    const auto& term = a.terms[i];
-                    const std::string& val = tup[i];
-                    if (std::holds_alternative<StringLiteral>(term)) {
-                        if (std::get<StringLiteral>(term).text != val) { ok = false; break; }
-                    } else if (std::holds_alternative<Identifier>(term)) {
-                        const std::string& vn = std::get<Identifier>(term).name;
-                        auto it = binding.find(vn);
-                        if (it != binding.end() && it->second != val) { ok = false; break; }
-                    } else {
-                        // ExprPtr: evaluate and compare
-                        const auto& expr = std::get<ExprPtr>(term);
-                        std::string outStr; double outNum = 0; bool isNumeric = false;
-                        if (!evalExprBinding(expr, binding, outStr, outNum, isNumeric)) {
-                            ok = false; break;
-                        }
-                        if (outStr != val) { ok = false; break; }
-                    }
-                }
-                if (ok) return true;
-            }
-            return false;
+        std::vector<const DatalogAtom*> atomPtrs;
+        std::vector<const DatalogAtom*> negPtrs;
+        std::vector<const DatalogCondition*> conditionPtrs;
+        for (const auto& a : atoms) atomPtrs.push_back(&a);
+        for (const auto& n : negs) negPtrs.push_back(&n.atom);
+        for (const auto& c : conditions) conditionPtrs.push_back(&c);
+        const CompiledBody code = CompiledBody::compile(atomPtrs, negPtrs, conditionPtrs, nullptr);
+
+        std::vector<ResolvedAtom> resolved;
+        std::vector<ResolvedAtom> resolvedNegs;
+        std::vector<size_t> cardinalities;
+        resolved.reserve(atoms.size());
+        for (size_t i = 0; i < atoms.size(); ++i) {
+            resolved.push_back(resolveAtom(atoms[i], code, code.atomTerms(i)));
+            const ResolvedAtom& ra = resolved.back();
+            const bool usable = ra.relation && ra.relation->arity() == atoms[i].terms.size();
+            cardinalities.push_back(usable ? ra.relation->size() : 0);
+        }
+        for (size_t g = 0; g < negs.size(); ++g) {
+            resolvedNegs.push_back(resolveAtom(negs[g].atom, code, code.negationTerms(g)));
+        }
+        std::vector<uint32_t> varSlots;
+        for (const auto& vn : varNames) varSlots.push_back(static_cast<uint32_t>(code.slotOf(vn)));
+        const SymbolTable& symbols = env_.symbols();
+        const JoinPlan plan = planJoin(resolved, cardinalities, resolvedNegs, conditionPtrs);
+
+        // Answers are collected with the rows that produced them and ordered
+        // as a source-order nested loop would find them, independent of the
+        // join order
+        struct Answer {
+            std::vector<uint32_t> rows;  // matched row per atom, in source order
+            std::vector<SymbolId> values;  // per variable
         };
+        std::vector<Answer> answers;
+        std::vector<uint32_t> rowsBySource(resolved.size(), 0);
 
         // DFS join similar to rules
-        std::unordered_map<std::string, std::string> binding;
-        bool anyPrinted = false;
-
-        std::function<void(size_t)> dfs = [&](size_t idx) {
-            if (idx == atoms.size()) {
-                // Evaluate conditions
-                for (const auto& cond : conditions) {
-                    if (!evalCondition(cond, binding)) return;
-                }
-                // Evaluate negations
-                for (const auto& n : negs) {
-                    if (hasMatch(n.atom, binding)) return;
-                }
-                if (varNames.empty()) {
-                    out << "True" << std::endl;
-                    anyPrinted = true;
-                    return;
-                }
-                if (varNames.size() == 1) {
-                    out << binding[varNames[0]] << std::endl;
-                    anyPrinted = true;
-                } else {
-                    for (size_t i = 0; i < varNames.size(); ++i) {
-                        if (i) out << ", ";
-                        out << binding[varNames[i]];
-                    }
-                    out << std::endl;
-                    anyPrinted = true;
-                }
+        Binding binding(code.slotCount(), CompiledBody::kUnbound);
+        std::vector<uint32_t> trail;
+        std::vector<SymbolId> probeKey;
+
+        std::function<void(size_t)> dfs = [&](size_t step) {
+            for (size_t c : plan.conditionsAt[step]) {
+                if (!code.testCondition(c, binding, symbols)) return;
+            }
+            for (size_t g : plan.negationsAt[step]) {
+                if (hasMatch(resolvedNegs[g], binding, plan.negationMasks[g])) return;
+            }
+            if (step == plan.order.size()) {
+                std::vector<SymbolId> values(varSlots.size());
+                for (size_t i = 0; i < varSlots.size(); ++i) values[i] = binding[varSlots[i]];
+                answers.push_back({rowsBySource, std::move(values)});
                 return;
             }
-            const DatalogAtom& a = atoms[idx];
-            const auto& tuples = env_.facts(a.relation.name);
-            for (const auto& tup : tuples) {
-                if (tup.size() != a.terms.size()) continue;
-                std::vector<std::string> assigned;
-                bool ok = true;
-                for (size_t i = 0; i < a.terms.size(); ++i) {
-                    const auto& term = a.terms[i];
-                    const std::string& val = tup[i];
-                    if (std::holds_alternative<StringLiteral>(term)) {
-                        if (std::get<StringLiteral>(term).text != val) { ok = false; break; }
-                    } else if (std::holds_alternative<Identifier>(term)) {
-                        const std::string& vn = std::get<Identifier>(term).name;
-                        auto it = binding.find(vn);
-                        if (it == binding.end()) { binding.emplace(vn, val); assigned.push_back(vn); }
-                        else if (it->second != val) { ok = false; break; }
-                    } else {
-                        // ExprPtr: evaluate and compare
-                        const auto& expr = std::get<ExprPtr>(term);
-                        std::string outStr; double outNum = 0; bool isNumeric = false;
-                        if (!evalExprBinding(expr, binding, outStr, outNum, isNumeric)) {
-                            ok = false; break;
-                        }
-                        if (outStr != val) { ok = false; break; }
-                    }
+            const size_t idx = plan.order[step];
+            const ResolvedAtom& a = resolved[idx];
+            if (cardinalities[idx] == 0) return;
+            const Relation::ColumnMask mask = plan.atomMasks[step];
+            fillProbeKey(a, binding, mask, probeKey);
+            const size_t mark = trail.size();
+            forEachCandidate(*a.relation, mask, probeKey, 0, a.relation->size(), [&](size_t row) {
+                if (matchTuple(a, a.relation->row(row), binding, &trail)) {
+                    rowsBySource[idx] = static_cast<uint32_t>(row);
+                    dfs(step + 1);
                 }
-                if (ok) dfs(idx + 1);
-                for (const auto& vn : assigned) binding.erase(vn);
-            }
+                while (trail.size() > mark) {
+                    binding[trail.back()] = CompiledBody::kUnbound;
+                    trail.pop_back();
+                }
+                return answers.size() < limit;
+            });
         };
 
-        dfs(0);
-        if (!anyPrinted) {
-            // Ground conjunctive query with no satisfying assignment
-            if (varNames.empty()) {
-                out << "False" << std::endl;
-            } else {
-                out << "None" << std::endl;
-            }
+        // With a limit, the answers are the first ones the join order finds
+        if (limit > 0) dfs(0);
+        std::stable_sort(answers.begin(), answers.end(),
+                         [](const Answer& x, const Answer& y) { return x.rows < y.rows; });
+        result.variables = varNames;
+        result.columns.assign(varNames.size(), {});
+        for (auto& column : result.columns) column.reserve(answers.size());
+        for (const auto& answer : answers) {
+            for (size_t i = 0; i < answer.values.size(); ++i) result.columns[i].push_back(answer.values[i]);
         }
-        return;
+        result.rows = answers.size();
+        return result;
     }
 
     // Simple single-atom query
     const std::string rel = atom.relation.name;
-    if (debug_) {
+    if (logging(LogLevel::Debug)) {
         std::ostringstream oss;
         oss << "Query over Datalog atom: " << rel << "(";
         for (size_t i = 0; i < atom.terms.size(); ++i) {
@@ -366,9 +1296,10 @@ void DatalogEngine::execDatalogQuery(const DatalogAtom& atom,
     // Collect variable positions and names in order of first appearance
     std::vector<int> varPositions;
     std::vector<std::string> varNames;
-    std::vector<std::optional<std::string>> constants(atom.terms.size());
-    std::vector<std::optional<ExprPtr>> exprTerms(atom.terms.size());
     std::unordered_map<std::string, int> firstPos; // for repeated variable consistency
+    const CompiledBody code = CompiledBody::compile({&atom}, {}, {}, nullptr);
+    const std::vector<CompiledBody::Term>& terms = code.atomTerms(0);
+    const ResolvedAtom resolved = resolveAtom(atom, code, terms);
 
     for (size_t i = 0; i < atom.terms.size(); ++i) {
         if (std::holds_alternative<Identifier>(atom.terms[i])) {
@@ -378,175 +1309,62 @@ void DatalogEngine::execDatalogQuery(const DatalogAtom& atom,
                 varPositions.push_back(static_cast<int>(i));
                 varNames.push_back(vname);
             }
-        } else if (std::holds_alternative<StringLiteral>(atom.terms[i])) {
-            constants[i] = std::get<StringLiteral>(atom.terms[i]).text;
-        } else {
-            // ExprPtr
-            exprTerms[i] = std::get<ExprPtr>(atom.terms[i]);
         }
     }
 
-    const auto& tuples = env_.facts(rel);
-    auto matchesTuple = [&](const std::vector<std::string>& tuple) -> bool {
-        if (tuple.size() != atom.terms.size()) return false;
-        // Check constants
-        for (size_t i = 0; i < constants.size(); ++i) {
-            if (constants[i].has_value() && tuple[i] != *constants[i]) return false;
-        }
-        // Build binding for variable consistency check
-        std::unordered_map<std::string, std::string> bind;
-        for (size_t i = 0; i < atom.terms.size(); ++i) {
-            if (std::holds_alternative<Identifier>(atom.terms[i])) {
-                const std::string& vn = std::get<Identifier>(atom.terms[i]).name;
-                auto it = bind.find(vn);
-                if (it == bind.end()) bind.emplace(vn, tuple[i]);
-                else if (it->second != tuple[i]) return false;
+    const Relation* relation = resolved.relation;
+    const size_t rowCount =
+        (relation && relation->arity() == atom.terms.size()) ? relation->size() : 0;
+    const SymbolTable& symbols = env_.symbols();
+    Binding bind(code.slotCount(), CompiledBody::kUnbound);
+    auto matchesTuple = [&](const SymbolId* tuple) -> bool {
+        // Check constants and bind variables, checking repeated ones for consistency
+        std::fill(bind.begin(), bind.end(), CompiledBody::kUnbound);
+        for (size_t i = 0; i < terms.size(); ++i) {
+            const CompiledBody::Term& t = terms[i];
+            if (t.kind == CompiledBody::Term::Kind::Constant) {
+                if (tuple[i] != resolved.constants[i]) return false;
+            } else if (t.kind == CompiledBody::Term::Kind::Variable) {
+                if (bind[t.index] == CompiledBody::kUnbound) bind[t.index] = tuple[i];
+                else if (bind[t.index] != tuple[i]) return false;
             }
         }
-        // Check expression terms
-        for (size_t i = 0; i < exprTerms.size(); ++i) {
-            if (exprTerms[i].has_value()) {
-                std::string outStr; double outNum = 0; bool isNumeric = false;
-                if (!evalExprBinding(*exprTerms[i], bind, outStr, outNum, isNumeric)) return false;
-                if (tuple[i] != outStr) return false;
-            }
+        // Check expression terms, which may use variables on either side
+        for (size_t i = 0; i < terms.size(); ++i) {
+            if (terms[i].kind != CompiledBody::Term::Kind::Expression) continue;
+            CompiledBody::Value value;
+            if (!code.evaluate(terms[i], bind, symbols, value)) return false;
+            CompiledBody::NumberBuffer buffer;
+            if (symbols.name(tuple[i]) != CompiledBody::text(value, buffer)) return false;
         }
         return true;
     };
 
-    // Ground query (no variables): print True/False
+    // Ground query (no variables): one proof is enough
     if (varNames.empty()) {
-        bool any = false;
-        for (const auto& tup : tuples) { if (matchesTuple(tup)) { any = true; break; } }
-        out << (any ? "True" : "False") << std::endl;
-        return;
-    }
-
-    // Variable bindings: print each matching binding
-    bool anyPrinted = false;
-    for (const auto& tup : tuples) {
-        if (!matchesTuple(tup)) continue;
-        if (varNames.size() == 1) {
-            out << tup[varPositions[0]] << std::endl;
-            anyPrinted = true;
-        } else {
-            // Print comma-separated values for the variables in first-appearance order
-            for (size_t i = 0; i < varNames.size(); ++i) {
-                if (i) out << ", ";
-                out << tup[varPositions[i]];
+        for (size_t row = 0; row < rowCount && limit > 0; ++row) {
+            if (matchesTuple(relation->row(row))) {
+                result.rows = 1;
+                break;
             }
-            out << std::endl;
-            anyPrinted = true;
-        }
-    }
-    if (!anyPrinted) {
-        out << "None" << std::endl;
-    }
-}
-
-bool DatalogEngine::evalExprBinding(const ExprPtr& e,
-                                    const std::unordered_map<std::string, std::string>& binding,
-                                    std::string& outStr,
-                                    double& outNum,
-                                    bool& isNumeric) const {
-    if (!e) return false;
-    const Expr& ex = *e;
-
-    if (const auto* num = std::get_if<ExprNumber>(&ex.node)) {
-        outStr = num->literal.text;
-        try { outNum = std::stod(outStr); isNumeric = true; } catch (...) { isNumeric = false; }
-        return true;
-    }
-
-    if (const auto* str = std::get_if<ExprString>(&ex.node)) {
-        outStr = str->literal.text;
-        try { outNum = std::stod(outStr); isNumeric = true; } catch (...) { isNumeric = false; }
-        return true;
-    }
-
-    if (const auto* tr = std::get_if<ExprTensorRef>(&ex.node)) {
-        // Treat lowercase scalar identifiers (no indices) as Datalog variables
-        const std::string& name = tr->ref.name.name;
-        const bool isVar = tr->ref.indices.empty() && !name.empty() &&
-                          std::islower(static_cast<unsigned char>(name[0])) != 0;
-        if (isVar) {
-            auto it = binding.find(name);
-            if (it == binding.end()) return false; // unbound
-            outStr = it->second;
-            try { outNum = std::stod(outStr); isNumeric = true; } catch (...) { isNumeric = false; }
-            return true;
-        }
-        // Otherwise unsupported in condition
-        return false;
-    }
-
-    if (const auto* paren = std::get_if<ExprParen>(&ex.node)) {
-        return evalExprBinding(paren->inner, binding, outStr, outNum, isNumeric);
-    }
-
-    if (const auto* bin = std::get_if<ExprBinary>(&ex.node)) {
-        // Minimal arithmetic support if both sides numeric
-        std::string ls; double ln = 0; bool lnum = false;
-        std::string rs; double rn = 0; bool rnum = false;
-        if (!evalExprBinding(bin->lhs, binding, ls, ln, lnum)) return false;
-        if (!evalExprBinding(bin->rhs, binding, rs, rn, rnum)) return false;
-        if (!lnum || !rnum) return false;
-        double res = 0;
-        switch (bin->op) {
-            case ExprBinary::Op::Add: res = ln + rn; break;
-            case ExprBinary::Op::Sub: res = ln - rn; break;
-            case ExprBinary::Op::Mul: res = ln * rn; break;
-            case ExprBinary::Op::Div: if (rn == 0.0) return false; res = ln / rn; break;
-            default: return false;;
         }
-        outNum = res; isNumeric = true;
-        std::ostringstream oss; oss << res; outStr = oss.str();
-        return true;
+        return result;
     }
 
-    // Lists and calls not supported in conditions
-    return false;
-}
-
-bool DatalogEngine::evalCondition(const DatalogCondition& cond,
-                                  const std::unordered_map<std::string, std::string>& binding) const {
-    std::string ls, rs;
-    double ln = 0, rn = 0;
-    bool lnum = false, rnum = false;
-
-    if (!evalExprBinding(cond.lhs, binding, ls, ln, lnum)) return false;
-    if (!evalExprBinding(cond.rhs, binding, rs, rn, rnum)) return false;
-
-    auto doStrCmp = [&](const std::string& op) {
-        if (op == "==") return ls == rs;
-        if (op == "!=") return ls != rs;
-        if (op == ">") return ls > rs;
-        if (op == "<") return ls < rs;
-        if (op == ">=") return ls >= rs;
-        if (op == "<=") return ls <= rs;
-        return false;
-    };
-
-    if ((cond.op == "==" || cond.op == "!=") && (!lnum || !rnum)) {
-        return doStrCmp(cond.op);
-    }
-    if (lnum && rnum) {
-        if (cond.op == "==") return ln == rn;
-        if (cond.op == "!=") return ln != rn;
-        if (cond.op == ">") return ln > rn;
-        if (cond.op == "<") return ln < rn;
-        if (cond.op == ">=") return ln >= rn;
-        if (cond.op == "<=") return ln <= rn;
-        return false;
+    // Variable bindings: one row per matching tuple
+    result.variables = varNames;
+    result.columns.assign(varNames.size(), {});
+    for (size_t row = 0; row < rowCount && result.rows < limit; ++row) {
+        const SymbolId* tup = relation->row(row);
+        if (!matchesTuple(tup)) continue;
+        for (size_t i = 0; i < varNames.size(); ++i) result.columns[i].push_back(tup[varPositions[i]]);
+        ++result.rows;
     }
-    // Mixed types with ordering: fallback to string compare
-    return doStrCmp(cond.op);
+    return result;
 }
 
 void DatalogEngine::debugLog(const std::string& msg) const {
-    if (debug_) {
-        (*output_stream_) << "[DatalogEngine] " << msg << std::endl;
-    }
+    DATALOG_LOG(Debug, msg);
 }
 
 } // namespace tl
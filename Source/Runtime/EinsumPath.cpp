@@ -0,0 +1,303 @@
+#include "TL/Runtime/EinsumPath.hpp"
+#include <torch/torch.h>
+#include <algorithm>
+#include <limits>
+
+namespace tl {
+
+    namespace {
+
+    // Labels are the 52 ASCII letters, so a set of labels fits in one word
+    using LabelSet = uint64_t;
+    constexpr int kNumLabels = 52;
+
+    int labelBit(char c) {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return 26 + (c - 'a');
+        return -1;
+    }
+
+    char labelChar(int bit) {
+        return bit < 26 ? static_cast<char>('A' + bit) : static_cast<char>('a' + (bit - 26));
+    }
+
+    struct Problem {
+        std::vector<std::string> inputs;
+        std::vector<LabelSet> masks;
+        std::string output;
+        LabelSet outMask{0};
+        double extent[kNumLabels]{};
+
+        // Number of points in the index space spanned by a label set
+        double volume(LabelSet set) const {
+            double v = 1.0;
+            for (int b = 0; b < kNumLabels; ++b) {
+                if (set & (LabelSet{1} << b)) v *= extent[b];
+            }
+            return v;
+        }
+
+        // Labels of an intermediate, in a fixed (alphabetical) order
+        static std::string labels(LabelSet set) {
+            std::string s;
+            for (int b = 0; b < kNumLabels; ++b) {
+                if (set & (LabelSet{1} << b)) s.push_back(labelChar(b));
+            }
+            return s;
+        }
+    };
+
+    std::optional<Problem> parseSpec(const std::string& spec, const std::vector<std::vector<int64_t>>& shapes) {
+        std::string text;
+        for (char c : spec) {
+            if (c == '.') return std::nullopt;  // ellipsis: leave it to torch
+            if (c != ' ') text.push_back(c);
+        }
+
+        Problem p;
+        const size_t arrow = text.find("->");
+        const std::string lhs = text.substr(0, arrow);
+        size_t start = 0;
+        while (true) {
+            const size_t comma = lhs.find(',', start);
+            p.inputs.push_back(lhs.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+            if (comma == std::string::npos) break;
+            start = comma + 1;
+        }
+        if (p.inputs.size() < 3 || p.inputs.size() != shapes.size()) return std::nullopt;
+
+        int occurrences[kNumLabels]{};
+        bool seen[kNumLabels]{};
+        for (size_t k = 0; k < p.inputs.size(); ++k) {
+            const std::string& in = p.inputs[k];
+            if (in.size() != shapes[k].size()) return std::nullopt;
+            LabelSet mask = 0;
+            for (size_t d = 0; d < in.size(); ++d) {
+                const int b = labelBit(in[d]);
+                if (b < 0) return std::nullopt;
+                const auto size = static_cast<double>(shapes[k][d]);
+                if (!seen[b] || p.extent[b] == 1.0) {
+                    p.extent[b] = size;
+                } else if (size != p.extent[b] && size != 1.0) {
+                    return std::nullopt;
+                }
+                seen[b] = true;
+                ++occurrences[b];
+                mask |= LabelSet{1} << b;
+            }
+            p.masks.push_back(mask);
+        }
+
+        if (arrow != std::string::npos) {
+            p.output = text.substr(arrow + 2);
+            for (char c : p.output) {
+                const int b = labelBit(c);
+                if (b < 0 || !seen[b] || (p.outMask & (LabelSet{1} << b))) return std::nullopt;
+                p.outMask |= LabelSet{1} << b;
+            }
+        } else {
+            // Implicit output: labels used once, in alphabetical order
+            for (int b = 0; b < kNumLabels; ++b) {
+                if (occurrences[b] == 1) p.outMask |= LabelSet{1} << b;
+            }
+            p.output = Problem::labels(p.outMask);
+        }
+        return p;
+    }
+
+    // Labels every operand except i and j (and the output) still needs
+    LabelSet neededBeyond(const Problem& p, const std::vector<LabelSet>& work, size_t i, size_t j) {
+        LabelSet needed = p.outMask;
+        for (size_t k = 0; k < work.size(); ++k) {
+            if (k != i && k != j) needed |= work[k];
+        }
+        return needed;
+    }
+
+    void contract(std::vector<LabelSet>& work, size_t i, size_t j, LabelSet result) {
+        work.erase(work.begin() + static_cast<std::ptrdiff_t>(j));
+        work.erase(work.begin() + static_cast<std::ptrdiff_t>(i));
+        work.push_back(result);
+    }
+
+    using Order = std::vector<std::pair<size_t, size_t>>;
+
+    // Exhaustive search with pruning on the cost so far
+    void searchOptimal(const Problem& p, const std::vector<LabelSet>& work, double cost,
+                       Order& current, Order& best, double& bestCost) {
+        if (cost >= bestCost) return;
+        if (work.size() == 1) {
+            bestCost = cost;
+            best = current;
+            return;
+        }
+        for (size_t i = 0; i < work.size(); ++i) {
+            for (size_t j = i + 1; j < work.size(); ++j) {
+                const LabelSet joint = work[i] | work[j];
+                std::vector<LabelSet> next = work;
+                contract(next, i, j, joint & neededBeyond(p, work, i, j));
+                current.emplace_back(i, j);
+                searchOptimal(p, next, cost + p.volume(joint), current, best, bestCost);
+                current.pop_back();
+            }
+        }
+    }
+
+    // Repeatedly contract the cheapest pair, preferring the one whose result
+    // grows memory the least
+    double searchGreedy(const Problem& p, Order& order) {
+        std::vector<LabelSet> work = p.masks;
+        double cost = 0.0;
+        while (work.size() > 1) {
+            size_t bi = 0, bj = 1;
+            double bestGrowth = std::numeric_limits<double>::infinity();
+            double bestVolume = std::numeric_limits<double>::infinity();
+            LabelSet bestResult = 0;
+            for (size_t i = 0; i < work.size(); ++i) {
+                for (size_t j = i + 1; j < work.size(); ++j) {
+                    const LabelSet joint = work[i] | work[j];
+                    const LabelSet result = joint & neededBeyond(p, work, i, j);
+                    const double growth = p.volume(result) - p.volume(work[i]) - p.volume(work[j]);
+                    const double volume = p.volume(joint);
+                    if (volume < bestVolume || (volume == bestVolume && growth < bestGrowth)) {
+                        bi = i;
+                        bj = j;
+                        bestGrowth = growth;
+                        bestVolume = volume;
+                        bestResult = result;
+                    }
+                }
+            }
+            order.emplace_back(bi, bj);
+            cost += bestVolume;
+            contract(work, bi, bj, bestResult);
+        }
+        return cost;
+    }
+
+    // Order torch::einsum uses: ((A B) C) D ...
+    double leftToRight(const Problem& p, Order& order) {
+        LabelSet acc = p.masks[0];
+        double cost = 0.0;
+        for (size_t k = 1; k < p.masks.size(); ++k) {
+            LabelSet needed = p.outMask;
+            for (size_t r = k + 1; r < p.masks.size(); ++r) needed |= p.masks[r];
+            const LabelSet joint = acc | p.masks[k];
+            cost += p.volume(joint);
+            acc = joint & needed;
+            // The running product is always the last operand of the working list
+            order.emplace_back(0, k == 1 ? 1 : p.masks.size() - k);
+        }
+        return cost;
+    }
+
+    } // namespace
+
+    std::optional<EinsumPath> EinsumPath::plan(const std::string& spec,
+                                               const std::vector<std::vector<int64_t>>& shapes) {
+        auto problem = parseSpec(spec, shapes);
+        if (!problem) return std::nullopt;
+        const Problem& p = *problem;
+
+        EinsumPath path;
+        Order order;
+        if (p.inputs.size() <= kOptimalMaxOperands) {
+            Order current;
+            double best = std::numeric_limits<double>::infinity();
+            searchOptimal(p, p.masks, 0.0, current, order, best);
+            path.strategy_ = Strategy::Optimal;
+            path.cost_ = best;
+        } else {
+            path.strategy_ = Strategy::Greedy;
+            path.cost_ = searchGreedy(p, order);
+        }
+        Order naive;
+        path.naive_cost_ = leftToRight(p, naive);
+        if (path.naive_cost_ < path.cost_) {
+            // The greedy choice is not guaranteed to beat the written order
+            order = std::move(naive);
+            path.cost_ = path.naive_cost_;
+        }
+
+        // Replay the order on label strings to get each step's spec
+        std::vector<LabelSet> work = p.masks;
+        std::vector<std::string> names = p.inputs;
+        for (size_t s = 0; s < order.size(); ++s) {
+            const auto [i, j] = order[s];
+            const LabelSet result = (work[i] | work[j]) & neededBeyond(p, work, i, j);
+            const bool last = s + 1 == order.size();
+            std::string out = last ? p.output : Problem::labels(result);
+            path.steps_.push_back(Step{i, j, names[i] + "," + names[j] + "->" + out});
+
+            contract(work, i, j, result);
+            names.erase(names.begin() + static_cast<std::ptrdiff_t>(j));
+            names.erase(names.begin() + static_cast<std::ptrdiff_t>(i));
+            names.push_back(std::move(out));
+        }
+        return path;
+    }
+
+    Tensor EinsumPath::run(const std::vector<Tensor>& operands) const {
+        std::vector<Tensor> work = operands;
+        for (const auto& step : steps_) {
+            Tensor result = torch::einsum(step.spec, {work[step.lhs], work[step.rhs]});
+            work.erase(work.begin() + static_cast<std::ptrdiff_t>(step.rhs));
+            work.erase(work.begin() + static_cast<std::ptrdiff_t>(step.lhs));
+            work.push_back(std::move(result));
+        }
+        return work.front();
+    }
+
+    std::shared_ptr<const EinsumPath> EinsumPathCache::get(const std::string& spec,
+                                                           const std::vector<Tensor>& operands) {
+        std::vector<std::vector<int64_t>> shapes;
+        shapes.reserve(operands.size());
+        std::string key = spec;
+        for (const auto& t : operands) {
+            shapes.push_back(t.sizes().vec());
+            key += '|';
+            for (int64_t s : shapes.back()) {
+                key += std::to_string(s);
+                key += ',';
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = paths_.find(key);
+        if (it != paths_.end()) {
+            ++hits_;
+            return it->second;
+        }
+        ++misses_;
+        if (paths_.size() >= capacity_) paths_.clear();
+        std::shared_ptr<const EinsumPath> path;
+        if (auto planned = EinsumPath::plan(spec, shapes)) {
+            path = std::make_shared<const EinsumPath>(std::move(*planned));
+        }
+        paths_.emplace(std::move(key), path);
+        return path;
+    }
+
+    size_t EinsumPathCache::size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return paths_.size();
+    }
+
+    size_t EinsumPathCache::hits() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hits_;
+    }
+
+    size_t EinsumPathCache::misses() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return misses_;
+    }
+
+    void EinsumPathCache::clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        paths_.clear();
+        hits_ = 0;
+        misses_ = 0;
+    }
+
+} // namespace tl
@@ -0,0 +1,356 @@
+#include "TL/Runtime/ElementwiseFusion.hpp"
+#include "TL/Runtime/Executor.hpp"
+#include "TL/Runtime/ExecutorUtils.hpp"
+#include <torch/torch.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <string>
+
+namespace tl {
+
+    namespace {
+    std::atomic<bool> g_fusionEnabled{true};
+
+    // Elements evaluated per register; small enough that all registers stay in cache
+    constexpr int64_t kBlock = 256;
+    // Rows are split across threads once a task covers at least this many elements
+    constexpr int64_t kParallelGrain = 32768;
+    }
+
+    // -------- Building --------
+
+    bool FusedElementwise::callOp(const std::string& name, Op& out) {
+        struct Entry { const char* name; Op op; };
+        // Same set of pointwise functions as ExpressionExecutor::evalExpr (softmax
+        // normalizes over a dimension, so it is not elementwise)
+        static const Entry kCalls[] = {
+            {"step", Op::Step}, {"sqrt", Op::Sqrt}, {"abs", Op::Abs}, {"sigmoid", Op::Sigmoid},
+            {"tanh", Op::Tanh}, {"relu", Op::Relu}, {"exp", Op::Exp}, {"cos", Op::Cos},
+            {"sin", Op::Sin}, {"tan", Op::Tan}, {"acos", Op::Acos}, {"asin", Op::Asin},
+            {"atan", Op::Atan}, {"log", Op::Log},
+        };
+        for (const auto& entry : kCalls) {
+            if (name == entry.name) {
+                out = entry.op;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool FusedElementwise::fusible(const Expr& e) {
+        if (const auto* bin = std::get_if<ExprBinary>(&e.node)) {
+            // A product with a tensor reference on the left, or a chain of
+            // references, may lower to an einsum contraction; keep it as a leaf
+            if (bin->op != ExprBinary::Op::Mul) return true;
+            if (executor_utils::asExprTensorRef(bin->lhs) != nullptr) return false;
+            std::vector<const ExprTensorRef*> factors;
+            return !(executor_utils::collectProductFactors(bin->lhs, factors) &&
+                     executor_utils::collectProductFactors(bin->rhs, factors));
+        }
+        if (std::holds_alternative<ExprUnary>(e.node)) return true;
+        if (const auto* call = std::get_if<ExprCall>(&e.node)) {
+            Op op = Op::Leaf;
+            return call->args.size() == 1 && callOp(call->func.name, op);
+        }
+        return false;
+    }
+
+    uint32_t FusedElementwise::push(Instr instr) {
+        code_.push_back(instr);
+        return static_cast<uint32_t>(code_.size() - 1);
+    }
+
+    uint32_t FusedElementwise::emit(const ExprPtr& ep) {
+        ExprPtr node = ep;
+        while (node) {
+            const auto* par = std::get_if<ExprParen>(&node->node);
+            if (!par) break;
+            node = par->inner;
+        }
+
+        if (!node || !fusible(*node)) {
+            if (node) {
+                if (const auto* num = std::get_if<ExprNumber>(&node->node)) {
+                    double v = 0.0;
+                    try {
+                        v = std::stod(num->literal.text);
+                    } catch (...) {}
+                    Instr instr{Op::Const};
+                    instr.value = static_cast<float>(v);
+                    return push(instr);
+                }
+            }
+            Instr instr{Op::Leaf};
+            instr.a = static_cast<uint32_t>(leaves_.size());
+            leaves_.push_back(node);
+            return push(instr);
+        }
+
+        if (const auto* bin = std::get_if<ExprBinary>(&node->node)) {
+            using BOp = ExprBinary::Op;
+            Op op = Op::Add;
+            switch (bin->op) {
+                case BOp::Add: op = Op::Add; break;
+                case BOp::Sub: op = Op::Sub; break;
+                case BOp::Mul: op = Op::Mul; break;
+                case BOp::Div: op = Op::Div; break;
+                case BOp::Mod: op = Op::Mod; break;
+                case BOp::Pow: op = Op::Pow; break;
+                case BOp::Lt: op = Op::Lt; break;
+                case BOp::Le: op = Op::Le; break;
+                case BOp::Gt: op = Op::Gt; break;
+                case BOp::Ge: op = Op::Ge; break;
+                case BOp::Eq: op = Op::Eq; break;
+                case BOp::Ne: op = Op::Ne; break;
+                case BOp::And: op = Op::And; break;
+                case BOp::Or: op = Op::Or; break;
+            }
+            const uint32_t a = emit(bin->lhs);
+            const uint32_t b = emit(bin->rhs);
+            Instr instr{op};
+            instr.a = a;
+            instr.b = b;
+            return push(instr);
+        }
+        if (const auto* un = std::get_if<ExprUnary>(&node->node)) {
+            Instr instr{un->op == ExprUnary::Op::Neg ? Op::Neg : Op::Not};
+            instr.a = emit(un->operand);
+            return push(instr);
+        }
+        const auto& call = std::get<ExprCall>(node->node);
+        Op op = Op::Leaf;
+        callOp(call.func.name, op);
+        Instr instr{op};
+        instr.a = emit(call.args[0]);
+        return push(instr);
+    }
+
+    std::optional<FusedElementwise> FusedElementwise::build(const ExprPtr& root) {
+        FusedElementwise kernel;
+        kernel.emit(root);
+        if (kernel.opCount() < 2) return std::nullopt;
+        return kernel;
+    }
+
+    size_t FusedElementwise::opCount() const {
+        return static_cast<size_t>(std::count_if(code_.begin(), code_.end(), [](const Instr& instr) {
+            return instr.op != Op::Leaf && instr.op != Op::Const;
+        }));
+    }
+
+    void FusedElementwise::setEnabled(bool enabled) { g_fusionEnabled.store(enabled); }
+    bool FusedElementwise::enabled() { return g_fusionEnabled.load(); }
+
+    // -------- Evaluation --------
+
+    bool FusedElementwise::broadcastShape(const std::vector<Tensor>& inputs, std::vector<int64_t>& shape) const {
+        shape.clear();
+        for (const auto& t : inputs) {
+            if (!t.defined() || t.scalar_type() != torch::kFloat32 || !t.is_cpu() || t.is_sparse() ||
+                t.requires_grad()) {
+                return false;
+            }
+            const auto sizes = t.sizes();
+            if (sizes.size() > shape.size()) shape.insert(shape.begin(), sizes.size() - shape.size(), 1);
+            // Right-aligned, as in torch broadcasting
+            const size_t offset = shape.size() - sizes.size();
+            for (size_t d = 0; d < sizes.size(); ++d) {
+                int64_t& dim = shape[offset + d];
+                if (sizes[d] == dim || sizes[d] == 1) continue;
+                if (dim != 1) return false;  // let torch report the mismatch
+                dim = sizes[d];
+            }
+        }
+        return true;
+    }
+
+    Tensor FusedElementwise::evaluate(const std::vector<Tensor>& inputs) const {
+        if (inputs.size() != leaves_.size()) {
+            throw ExecutionError("Fused expression expects " + std::to_string(leaves_.size()) + " inputs");
+        }
+        std::vector<int64_t> shape;
+        if (broadcastShape(inputs, shape)) return runFused(inputs, shape, nullptr);
+        return runUnfused(inputs);
+    }
+
+    Tensor FusedElementwise::sum(const std::vector<Tensor>& inputs) const {
+        if (inputs.size() != leaves_.size()) {
+            throw ExecutionError("Fused expression expects " + std::to_string(leaves_.size()) + " inputs");
+        }
+        std::vector<int64_t> shape;
+        if (!broadcastShape(inputs, shape)) return torch::sum(runUnfused(inputs));
+        double total = 0.0;
+        runFused(inputs, shape, &total);
+        return torch::tensor(static_cast<float>(total));
+    }
+
+    Tensor FusedElementwise::runUnfused(const std::vector<Tensor>& inputs) const {
+        std::vector<Tensor> regs(code_.size());
+        for (size_t k = 0; k < code_.size(); ++k) {
+            const Instr& in = code_[k];
+            const Tensor& a = in.op == Op::Leaf || in.op == Op::Const ? regs[k] : regs[in.a];
+            const Tensor& b = regs[in.b];
+            Tensor& r = regs[k];
+            switch (in.op) {
+                case Op::Leaf: r = inputs[in.a]; break;
+                case Op::Const: r = torch::tensor(in.value); break;
+                case Op::Add: r = a + b; break;
+                case Op::Sub: r = a - b; break;
+                case Op::Mul: r = a * b; break;
+                case Op::Div: r = a / b; break;
+                case Op::Mod: r = torch::fmod(a, b); break;
+                case Op::Pow: r = torch::pow(a, b); break;
+                case Op::Lt: r = torch::lt(a, b).to(torch::kFloat32); break;
+                case Op::Le: r = torch::le(a, b).to(torch::kFloat32); break;
+                case Op::Gt: r = torch::gt(a, b).to(torch::kFloat32); break;
+                case Op::Ge: r = torch::ge(a, b).to(torch::kFloat32); break;
+                case Op::Eq: r = torch::eq(a, b).to(torch::kFloat32); break;
+                case Op::Ne: r = torch::ne(a, b).to(torch::kFloat32); break;
+                case Op::And: r = torch::logical_and(torch::ne(a, 0), torch::ne(b, 0)).to(torch::kFloat32); break;
+                case Op::Or: r = torch::logical_or(torch::ne(a, 0), torch::ne(b, 0)).to(torch::kFloat32); break;
+                case Op::Neg: r = -a; break;
+                case Op::Not: r = torch::eq(a, 0).to(torch::kFloat32); break;
+                case Op::Step: r = torch::gt(a, 0).to(torch::kFloat32); break;
+                case Op::Sqrt: r = torch::sqrt(a); break;
+                case Op::Abs: r = torch::abs(a); break;
+                case Op::Sigmoid: r = torch::sigmoid(a); break;
+                case Op::Tanh: r = torch::tanh(a); break;
+                case Op::Relu: r = torch::relu(a); break;
+                case Op::Exp: r = torch::exp(a); break;
+                case Op::Cos: r = torch::cos(a); break;
+                case Op::Sin: r = torch::sin(a); break;
+                case Op::Tan: r = torch::tan(a); break;
+                case Op::Acos: r = torch::acos(a); break;
+                case Op::Asin: r = torch::asin(a); break;
+                case Op::Atan: r = torch::atan(a); break;
+                case Op::Log: r = torch::log(a); break;
+            }
+        }
+        return regs.back();
+    }
+
+    Tensor FusedElementwise::runFused(const std::vector<Tensor>& inputs, const std::vector<int64_t>& shape,
+                                      double* total) const {
+        // Summing keeps each block in registers and never writes the elements
+        Tensor out = total ? Tensor() : torch::empty(shape, torch::TensorOptions().dtype(torch::kFloat32));
+        int64_t numel = 1;
+        for (int64_t extent : shape) numel *= extent;
+        if (numel == 0) return out;
+
+        const size_t dims = shape.size();
+        const int64_t inner = dims == 0 ? 1 : shape.back();
+        const int64_t rows = numel / inner;
+
+        // Broadcast views have stride 0 along expanded dimensions, so nothing is copied
+        std::vector<Tensor> views;
+        std::vector<const float*> base;
+        std::vector<std::vector<int64_t>> strides;
+        views.reserve(inputs.size());
+        for (const auto& t : inputs) {
+            views.push_back(t.expand(shape));
+            base.push_back(views.back().data_ptr<float>());
+            strides.push_back(views.back().strides().vec());
+        }
+        float* result = total ? nullptr : out.data_ptr<float>();
+
+        auto runRows = [&](int64_t begin, int64_t end) {
+            double partial = 0.0;
+            std::vector<float> regs(code_.size() * kBlock);
+            std::vector<const float*> row(inputs.size());
+            std::vector<int64_t> innerStride(inputs.size(), 0);
+            for (size_t j = 0; j < inputs.size(); ++j) {
+                if (dims > 0) innerStride[j] = strides[j][dims - 1];
+            }
+
+            for (int64_t r = begin; r < end; ++r) {
+                for (size_t j = 0; j < inputs.size(); ++j) row[j] = base[j];
+                int64_t rem = r;
+                for (size_t d = dims > 0 ? dims - 1 : 0; d-- > 0;) {
+                    const int64_t idx = rem % shape[d];
+                    rem /= shape[d];
+                    for (size_t j = 0; j < inputs.size(); ++j) row[j] += idx * strides[j][d];
+                }
+
+                for (int64_t c = 0; c < inner; c += kBlock) {
+                    const int64_t n = std::min(kBlock, inner - c);
+                    for (size_t k = 0; k < code_.size(); ++k) {
+                        const Instr& in = code_[k];
+                        // The last instruction writes straight into the output
+                        float* R = k + 1 == code_.size() && result ? result + r * inner + c : regs.data() + k * kBlock;
+                        const float* A = regs.data() + in.a * kBlock;
+                        const float* B = regs.data() + in.b * kBlock;
+                        auto unary = [&](auto f) { for (int64_t i = 0; i < n; ++i) R[i] = f(A[i]); };
+                        auto binary = [&](auto f) { for (int64_t i = 0; i < n; ++i) R[i] = f(A[i], B[i]); };
+                        switch (in.op) {
+                            case Op::Leaf: {
+                                const int64_t s = innerStride[in.a];
+                                const float* src = row[in.a] + c * s;
+                                if (s == 0) {
+                                    std::fill(R, R + n, *src);
+                                } else if (s == 1) {
+                                    std::memcpy(R, src, static_cast<size_t>(n) * sizeof(float));
+                                } else {
+                                    for (int64_t i = 0; i < n; ++i) R[i] = src[i * s];
+                                }
+                                break;
+                            }
+                            case Op::Const: std::fill(R, R + n, in.value); break;
+                            case Op::Add: binary([](float x, float y) { return x + y; }); break;
+                            case Op::Sub: binary([](float x, float y) { return x - y; }); break;
+                            case Op::Mul: binary([](float x, float y) { return x * y; }); break;
+                            case Op::Div: binary([](float x, float y) { return x / y; }); break;
+                            case Op::Mod: binary([](float x, float y) { return std::fmod(x, y); }); break;
+                            case Op::Pow: binary([](float x, float y) { return std::pow(x, y); }); break;
+                            case Op::Lt: binary([](float x, float y) { return x < y ? 1.0f : 0.0f; }); break;
+                            case Op::Le: binary([](float x, float y) { return x <= y ? 1.0f : 0.0f; }); break;
+                            case Op::Gt: binary([](float x, float y) { return x > y ? 1.0f : 0.0f; }); break;
+                            case Op::Ge: binary([](float x, float y) { return x >= y ? 1.0f : 0.0f; }); break;
+                            case Op::Eq: binary([](float x, float y) { return x == y ? 1.0f : 0.0f; }); break;
+                            case Op::Ne: binary([](float x, float y) { return x != y ? 1.0f : 0.0f; }); break;
+                            case Op::And: binary([](float x, float y) { return x != 0.0f && y != 0.0f ? 1.0f : 0.0f; }); break;
+                            case Op::Or: binary([](float x, float y) { return x != 0.0f || y != 0.0f ? 1.0f : 0.0f; }); break;
+                            case Op::Neg: unary([](float x) { return -x; }); break;
+                            case Op::Not: unary([](float x) { return x == 0.0f ? 1.0f : 0.0f; }); break;
+                            case Op::Step: unary([](float x) { return x > 0.0f ? 1.0f : 0.0f; }); break;
+                            case Op::Sqrt: unary([](float x) { return std::sqrt(x); }); break;
+                            case Op::Abs: unary([](float x) { return std::fabs(x); }); break;
+                            case Op::Sigmoid: unary([](float x) { return 1.0f / (1.0f + std::exp(-x)); }); break;
+                            case Op::Tanh: unary([](float x) { return std::tanh(x); }); break;
+                            case Op::Relu: unary([](float x) { return x < 0.0f ? 0.0f : x; }); break;  // keeps NaN
+                            case Op::Exp: unary([](float x) { return std::exp(x); }); break;
+                            case Op::Cos: unary([](float x) { return std::cos(x); }); break;
+                            case Op::Sin: unary([](float x) { return std::sin(x); }); break;
+                            case Op::Tan: unary([](float x) { return std::tan(x); }); break;
+                            case Op::Acos: unary([](float x) { return std::acos(x); }); break;
+                            case Op::Asin: unary([](float x) { return std::asin(x); }); break;
+                            case Op::Atan: unary([](float x) { return std::atan(x); }); break;
+                            case Op::Log: unary([](float x) { return std::log(x); }); break;
+                        }
+                    }
+                    if (!result) {
+                        const float* last = regs.data() + (code_.size() - 1) * kBlock;
+                        float block = 0.0f;
+                        for (int64_t i = 0; i < n; ++i) block += last[i];
+                        partial += block;
+                    }
+                }
+            }
+            return partial;
+        };
+
+        const int64_t grain = std::max<int64_t>(1, kParallelGrain / inner);
+        if (total) {
+            *total = at::parallel_reduce(
+                0, rows, grain, 0.0, [&](int64_t begin, int64_t end, double) { return runRows(begin, end); },
+                std::plus<double>());
+        } else {
+            at::parallel_for(0, rows, grain, [&](int64_t begin, int64_t end) { runRows(begin, end); });
+        }
+        return out;
+    }
+
+} // namespace tl
@@ -0,0 +1,92 @@
+#include "TL/Runtime/ExecutorRegistry.hpp"
+#include "TL/Log.hpp"
+#include "TL/vm.hpp"
+
+namespace tl {
+
+    ExecutorRegistry::ExecutorRegistry(const ExecutorRegistry& other)
+        : cache_enabled_(other.cache_enabled_), debug_(other.debug_), err_(other.err_) {
+        entries_.reserve(other.entries_.size());
+        for (const auto& entry : other.entries_) {
+            entries_.push_back(Entry{entry.executor, {}});
+            entries_.back().stats.name = entry.stats.name;
+        }
+    }
+
+    TensorEquationExecutor& ExecutorRegistry::select(const TensorEquation& eq, const Environment& env) {
+        std::string signature;
+        if (cache_enabled_) {
+            if (cache_env_ != &env || cache_layout_ != env.layoutVersion()) {
+                dispatch_cache_.clear();
+                cache_env_ = &env;
+                cache_layout_ = env.layoutVersion();
+            }
+            signature = executor_utils::dispatchSignature(eq);
+            auto it = dispatch_cache_.find(signature);
+            if (it != dispatch_cache_.end()) {
+                Entry& entry = entries_[it->second];
+                ++entry.stats.cacheHits;
+                TL_LOG(Trace, debug_, *err_, "[ExecutorRegistry] Using " << entry.stats.name << " (cached)");
+                return *entry.executor;
+            }
+        }
+
+        // canExecute may bind placeholder tensors, so the layout is read before the scan
+        const uint64_t layout = env.layoutVersion();
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            Entry& entry = entries_[i];
+            if (entry.executor->canExecute(eq, env)) {
+                ++entry.stats.selections;
+                TL_LOG(Trace, debug_, *err_, "[ExecutorRegistry] Using " << entry.stats.name);
+                if (cache_enabled_ && layout == cache_layout_) {
+                    dispatch_cache_.emplace(std::move(signature), i);
+                }
+                return *entry.executor;
+            }
+        }
+
+        throw ExecutionError("No executor found for equation: " + executor_utils::toString(eq));
+    }
+
+    Tensor ExecutorRegistry::execute(TensorEquationExecutor& executor, const TensorEquation& eq,
+                                     Environment& env, TensorBackend& backend) {
+        ExecutorStats& stats = entryFor(executor).stats;
+        const auto start = std::chrono::steady_clock::now();
+        auto record = [&] {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats.executeTime += std::chrono::steady_clock::now() - start;
+            ++stats.executions;
+        };
+        try {
+            Tensor result = executor.execute(eq, env, backend);
+            record();
+            return result;
+        } catch (...) {
+            record();
+            throw;
+        }
+    }
+
+    ExecutorRegistry::Entry& ExecutorRegistry::entryFor(TensorEquationExecutor& executor) {
+        for (auto& entry : entries_) {
+            if (entry.executor.get() == &executor) return entry;
+        }
+        throw ExecutionError("Executor " + executor.name() + " is not registered");
+    }
+
+    std::vector<ExecutorStats> ExecutorRegistry::stats() const {
+        std::vector<ExecutorStats> out;
+        out.reserve(entries_.size());
+        for (const auto& entry : entries_) out.push_back(entry.stats);
+        return out;
+    }
+
+    void ExecutorRegistry::resetStats() {
+        for (auto& entry : entries_) {
+            const std::string name = entry.stats.name;
+            entry.stats = ExecutorStats{};
+            entry.stats.name = name;
+        }
+    }
+
+} // namespace tl
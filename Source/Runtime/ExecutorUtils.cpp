@@ -1,6 +1,7 @@
 #include "TL/Runtime/ExecutorUtils.hpp"
 #include "TL/vm.hpp"
 #include <torch/torch.h>
+#include <algorithm>
 
 namespace tl {
 namespace executor_utils {
@@ -94,6 +95,87 @@ std::vector<int64_t> resolveIndicesCreatingLabels(const TensorRef &ref,
   return indices;
 }
 
+// Flatten a nested list of number literals; false for anything else, including
+// ragged nesting (the element-wise path reports those)
+static bool flattenNumericList(const ExprList &list, std::vector<int64_t> &shape,
+                               std::vector<float> &flat) {
+  std::vector<int64_t> child_shape;
+  bool first = true;
+  for (const auto &element : list.elements) {
+    if (!element)
+      return false;
+    const Expr *e = element.get();
+    std::vector<int64_t> cs;
+    if (const auto *sub = std::get_if<ExprList>(&e->node)) {
+      if (!flattenNumericList(*sub, cs, flat))
+        return false;
+    } else {
+      while (const auto *par = std::get_if<ExprParen>(&e->node)) {
+        if (!par->inner)
+          return false;
+        e = par->inner.get();
+      }
+      const auto *num = std::get_if<ExprNumber>(&e->node);
+      if (!num)
+        return false;
+      double v = 0.0;
+      try {
+        v = std::stod(num->literal.text);
+      } catch (...) {
+      }
+      flat.push_back(static_cast<float>(v));
+    }
+    if (first) {
+      child_shape = std::move(cs);
+      first = false;
+    } else if (child_shape != cs) {
+      return false;
+    }
+  }
+  shape.clear();
+  shape.push_back(static_cast<int64_t>(list.elements.size()));
+  shape.insert(shape.end(), child_shape.begin(), child_shape.end());
+  return true;
+}
+
+std::optional<Tensor> foldListLiteral(const ExprList &list) {
+  // Plans and learning loops may evaluate one AST from several threads
+  auto folded = std::atomic_load(&list.folded);
+  if (!folded) {
+    auto constant = std::make_shared<ListConstant>();
+    std::vector<int64_t> shape;
+    std::vector<float> flat;
+    if (flattenNumericList(list, shape, flat)) {
+      constant->value = torch::tensor(flat).reshape(shape);
+    }
+    folded = constant;
+    std::atomic_store(&list.folded, folded);
+  }
+  if (!folded->value.defined())
+    return std::nullopt;
+  return folded->value.clone();
+}
+
+// Leading window of a capacity-tracked storage tensor
+static Tensor growthWindow(const Tensor &storage,
+                           const std::vector<int64_t> &shape) {
+  Tensor view = storage;
+  for (size_t d = 0; d < shape.size(); ++d) {
+    view = view.narrow(static_cast<int64_t>(d), 0, shape[d]);
+  }
+  return view;
+}
+
+// True if t is still the window ensureTensorSize last handed out; a slice
+// or a tensor rebound in between does not qualify
+static bool isGrowthWindow(const Tensor &t,
+                           const Environment::GrowthStorage &growth) {
+  const Tensor &storage = growth.storage;
+  return t.scalar_type() == storage.scalar_type() &&
+         t.data_ptr() == storage.data_ptr() &&
+         t.strides() == storage.strides() && t.sizes().vec() == growth.window;
+}
+
 Tensor ensureTensorSize(const std::string &name,
                         const std::vector<int64_t> &required_indices,
                         Environment &env) {
@@ -103,15 +185,18 @@ Tensor ensureTensorSize(const std::string &name,
     required_shape.push_back(idx + 1);
   }
 
-  const auto opts = torch::TensorOptions().dtype(torch::kFloat32);
+  const auto opts = env.tensorOptions();
 
   // If tensor doesn't exist, create it
   if (!env.has(name)) {
-    return torch::zeros(required_shape, opts);
+    Tensor created = torch::zeros(required_shape, opts);
+    env.setGrowthStorage(name, created, required_shape);
+    return created;
   }
 
-  // If tensor exists, check if it's large enough
-  Tensor current = env.lookup(name);
+  // If tensor exists, check if it's large enough. Callers write into the
+  // result in place, so a tensor sharing its storage is copied first
+  Tensor current = env.writable(name);
   auto current_shape = current.sizes();
 
   bool needs_resize = false;
@@ -131,6 +216,40 @@ Tensor ensureTensorSize(const std::string &name,
     return current;
   }
 
+  // Grow within the same rank through the capacity-tracked storage: the
+  // capacity of an axis at least doubles whenever it is exceeded, so
+  // populating a tensor one label at a time copies each element O(1) times
+  if (current.dim() == static_cast<int64_t>(new_shape.size())) {
+    const Environment::GrowthStorage *growth = env.growthStorage(name);
+    const bool windowed = growth && isGrowthWindow(current, *growth);
+    const Tensor *storage = windowed ? &growth->storage : nullptr;
+
+    std::vector<int64_t> capacity(new_shape.size());
+    bool fits = windowed;
+    for (size_t d = 0; d < new_shape.size(); ++d) {
+      const int64_t have = windowed ? storage->size(static_cast<int64_t>(d))
+                                    : current_shape[d];
+      if (new_shape[d] <= have) {
+        capacity[d] = have;
+      } else {
+        capacity[d] = std::max(new_shape[d], 2 * have);
+        fits = false;
+      }
+    }
+
+    // The storage beyond the current window is still zero
+    if (fits) {
+      Tensor window = growthWindow(*storage, new_shape);
+      env.setGrowthStorage(name, *storage, new_shape);
+      return window;
+    }
+
+    Tensor grown = torch::zeros(capacity, opts);
+    growthWindow(grown, current_shape.vec()).copy_(current);
+    env.setGrowthStorage(name, grown, new_shape);
+    return growthWindow(grown, new_shape);
+  }
+
   // Resize and copy
   Tensor resized = torch::zeros(new_shape, opts);
 
@@ -186,15 +305,113 @@ bool tryParseEinsumCall(const ExprPtr &expr, std::string &spec_out,
     const auto *argRef = std::get_if<ExprTensorRef>(&call->args[i]->node);
     if (!argRef)
       return false;
-    const std::string name = argRef->ref.name.name;
-    if (!env.has(name)) {
-      throw std::runtime_error("einsum uses unknown tensor: " + name);
+    if (!env.has(argRef->ref)) {
+      throw std::runtime_error("einsum uses unknown tensor: " + argRef->ref.name.name);
     }
-    inputs_out.push_back(env.lookup(name));
+    inputs_out.push_back(env.lookup(argRef->ref));
   }
   return true;
 }
 
+// Integer literals are collapsed; anything else (fractions, signs) is kept verbatim
+static void appendNumberSignature(const std::string &text, std::string &out) {
+  const bool integer = !text.empty() &&
+      std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; });
+  if (integer) {
+    out += '#';
+  } else {
+    out += '\'';
+    out += text;
+    out += '\'';
+  }
+}
+
+static void appendRefSignature(const TensorRef &ref, std::string &out) {
+  out += ref.name.name;
+  if (ref.indices.empty()) return;
+  out += '[';
+  for (const auto &ios : ref.indices) {
+    if (const auto *idx = std::get_if<Index>(&ios.value)) {
+      if (const auto *id = std::get_if<Identifier>(&idx->value)) {
+        out += id->name;
+      } else if (const auto *num = std::get_if<NumberLiteral>(&idx->value)) {
+        appendNumberSignature(num->text, out);
+      } else if (const auto *virt = std::get_if<VirtualIndex>(&idx->value)) {
+        out += '*';
+        out += virt->name.name;
+        out += std::to_string(virt->offset);
+      }
+      if (idx->normalized) out += '.';
+    } else {
+      const auto &slice = std::get<Slice>(ios.value);
+      out += ':';
+      out += slice.start ? 's' : '-';
+      out += slice.end ? 'e' : '-';
+      out += slice.step ? 't' : '-';
+    }
+    out += ',';
+  }
+  out += ']';
+}
+
+static void appendExprSignature(const ExprPtr &expr, std::string &out) {
+  if (!expr) {
+    out += '!';
+    return;
+  }
+  const Expr &e = *expr;
+  if (const auto *ref = std::get_if<ExprTensorRef>(&e.node)) {
+    appendRefSignature(ref->ref, out);
+  } else if (const auto *num = std::get_if<ExprNumber>(&e.node)) {
+    appendNumberSignature(num->literal.text, out);
+  } else if (const auto *str = std::get_if<ExprString>(&e.node)) {
+    out += '"';
+    out += str->literal.text;
+    out += '"';
+  } else if (std::holds_alternative<ExprList>(e.node)) {
+    out += "[]";
+  } else if (const auto *par = std::get_if<ExprParen>(&e.node)) {
+    out += '(';
+    appendExprSignature(par->inner, out);
+    out += ')';
+  } else if (const auto *call = std::get_if<ExprCall>(&e.node)) {
+    out += call->func.name;
+    out += '(';
+    for (const auto &arg : call->args) {
+      appendExprSignature(arg, out);
+      out += ',';
+    }
+    out += ')';
+  } else if (const auto *bin = std::get_if<ExprBinary>(&e.node)) {
+    out += '{';
+    appendExprSignature(bin->lhs, out);
+    out += '<';
+    out += std::to_string(static_cast<int>(bin->op));
+    out += '>';
+    appendExprSignature(bin->rhs, out);
+    out += '}';
+  } else if (const auto *un = std::get_if<ExprUnary>(&e.node)) {
+    out += un->op == ExprUnary::Op::Neg ? '-' : '~';
+    appendExprSignature(un->operand, out);
+  }
+}
+
+std::string dispatchSignature(const TensorEquation &eq) {
+  std::string out;
+  out.reserve(64);
+  appendRefSignature(eq.lhs, out);
+  out += eq.projection.empty() ? "=" : eq.projection;
+  for (const auto &clause : eq.clauses) {
+    appendExprSignature(clause.expr, out);
+    if (clause.guard) {
+      out += '?';
+      appendExprSignature(*clause.guard, out);
+    }
+    out += ';';
+  }
+  return out;
+}
+
 Tensor valueForRef(const TensorRef &ref, Environment &env) {
   using torch::indexing::Slice;
   using torch::indexing::TensorIndex;
@@ -250,6 +467,76 @@ const ExprTensorRef *asExprTensorRef(const ExprPtr &ep) {
   }
 }
 
+bool collectProductFactors(const ExprPtr &ep,
+                           std::vector<const ExprTensorRef *> &factors) {
+  if (!ep)
+    return false;
+  if (const auto *tr = asExprTensorRef(ep)) {
+    factors.push_back(tr);
+    return true;
+  }
+  const Expr *cur = ep.get();
+  while (const auto *par = std::get_if<ExprParen>(&cur->node)) {
+    if (!par->inner)
+      return false;
+    cur = par->inner.get();
+  }
+  const auto *bin = std::get_if<ExprBinary>(&cur->node);
+  if (!bin || bin->op != ExprBinary::Op::Mul)
+    return false;
+  return collectProductFactors(bin->lhs, factors) &&
+         collectProductFactors(bin->rhs, factors);
+}
+
+void forEachTensorRef(const ExprPtr &expr,
+                      const std::function<void(const TensorRef &)> &fn) {
+  if (!expr)
+    return;
+  std::visit(
+      [&](const auto &node) {
+        using T = std::decay_t<decltype(node)>;
+        if constexpr (std::is_same_v<T, ExprTensorRef>) {
+          fn(node.ref);
+        } else if constexpr (std::is_same_v<T, ExprParen>) {
+          forEachTensorRef(node.inner, fn);
+        } else if constexpr (std::is_same_v<T, ExprCall>) {
+          for (const auto &arg : node.args)
+            forEachTensorRef(arg, fn);
+        } else if constexpr (std::is_same_v<T, ExprBinary>) {
+          forEachTensorRef(node.lhs, fn);
+          forEachTensorRef(node.rhs, fn);
+        } else if constexpr (std::is_same_v<T, ExprUnary>) {
+          forEachTensorRef(node.operand, fn);
+        } else if constexpr (std::is_same_v<T, ExprList>) {
+          for (const auto &element : node.elements)
+            forEachTensorRef(element, fn);
+        }
+      },
+      expr->node);
+}
+
+void forEachTensorRef(const TensorEquation &eq,
+                      const std::function<void(const TensorRef &)> &fn) {
+  for (const auto &clause : eq.clauses) {
+    forEachTensorRef(clause.expr, fn);
+    if (clause.guard)
+      forEachTensorRef(*clause.guard, fn);
+  }
+}
+
+void forEachIndexName(const TensorEquation &eq,
+                      const std::function<void(const std::string &)> &fn) {
+  auto scan = [&](const TensorRef &ref) {
+    for (const auto &ios : ref.indices) {
+      const auto *idx = std::get_if<Index>(&ios.value);
+      const auto *id = idx ? std::get_if<Identifier>(&idx->value) : nullptr;
+      if (id) fn(id->name);
+    }
+  };
+  scan(eq.lhs);
+  forEachTensorRef(eq, scan);
+}
+
 static bool hasNumericIndices(const TensorRef &ref) {
   for (const auto &ios : ref.indices) {
     if (std::holds_alternative<Index>(ios.value)) {
@@ -325,9 +612,11 @@ bool tryLowerIndexedProductToEinsum(const TensorRef &lhs, const ExprPtr &rhs,
   if (!bin || bin->op != ExprBinary::Op::Mul)
     return false;
 
-  const auto *leftRef = asExprTensorRef(bin->lhs);
-  const auto *rightRef = asExprTensorRef(bin->rhs);
-  if (!leftRef || !rightRef)
+  // A chain such as A[i,j] B[j,k] C[k,l] becomes a single multi-operand
+  // einsum; the backend picks the contraction order
+  std::vector<const ExprTensorRef *> factors;
+  if (!collectProductFactors(bin->lhs, factors) ||
+      !collectProductFactors(bin->rhs, factors))
     return false;
 
   // Allow numeric indices - they will be handled by valueForRef() which
@@ -346,8 +635,6 @@ bool tryLowerIndexedProductToEinsum(const TensorRef &lhs, const ExprPtr &rhs,
     }
     return names;
   };
-  const std::vector<std::string> leftNames = collectNames(leftRef->ref);
-  const std::vector<std::string> rightNames = collectNames(rightRef->ref);
   const std::vector<std::string> outNames = collectNames(lhs);
 
   static const std::string pool =
@@ -372,23 +659,28 @@ bool tryLowerIndexedProductToEinsum(const TensorRef &lhs, const ExprPtr &rhs,
     return s;
   };
 
-  const std::string a = mapSeq(leftNames);
-  const std::string b = mapSeq(rightNames);
+  std::string inputs;
+  for (const auto *factor : factors) {
+    const std::string labels = mapSeq(collectNames(factor->ref));
+    if (labels.empty())
+      return false;
+    if (!inputs.empty())
+      inputs += ',';
+    inputs += labels;
+  }
   const std::string out = mapSeq(outNames);
-  if (a.empty() || b.empty())
-    return false;
 
   // IMPORTANT: Validate that all output indices appear in at least one input
   // Without this check, we could generate invalid einsum specs like "b,b->a"
   // where 'a' doesn't appear in any input operand
   for (char c : out) {
-    if (a.find(c) == std::string::npos && b.find(c) == std::string::npos) {
+    if (inputs.find(c) == std::string::npos) {
       // Output index doesn't appear in any input - can't construct valid einsum
       return false;
     }
   }
 
-  spec_out = a + "," + b + "->" + out;
+  spec_out = inputs + "->" + out;
 
   inputs_out.clear();
 
@@ -396,50 +688,31 @@ bool tryLowerIndexedProductToEinsum(const TensorRef &lhs, const ExprPtr &rhs,
   // bound/free indices For example, State[j,0] will be correctly sliced to
   // State[:,0] before einsum
 
-  // For left operand: create placeholder for base tensor if needed, then slice
-  const std::string leftName = leftRef->ref.name.name;
-  if (!env.has(leftName)) {
-    // Create a TensorRef with only free variable indices for placeholder shape
-    // inference
-    TensorRef baseRef = leftRef->ref;
-    // Remove numeric indices - keep only identifiers for shape inference
-    std::vector<IndexOrSlice> freeIndices;
-    for (const auto &ios : baseRef.indices) {
-      if (std::holds_alternative<Index>(ios.value)) {
-        const auto &idx = std::get<Index>(ios.value);
-        if (std::holds_alternative<Identifier>(idx.value)) {
-          IndexOrSlice iosNew;
-          iosNew.value = idx;
-          iosNew.loc = ios.loc;
-          freeIndices.push_back(iosNew);
-        }
-      }
-    }
-    baseRef.indices = freeIndices;
-    env.bind(leftName, placeholderForRef(baseRef));
-  }
-  inputs_out.push_back(valueForRef(leftRef->ref, env));
-
-  // For right operand: same approach
-  const std::string rightName = rightRef->ref.name.name;
-  if (!env.has(rightName)) {
-    TensorRef baseRef = rightRef->ref;
-    std::vector<IndexOrSlice> freeIndices;
-    for (const auto &ios : baseRef.indices) {
-      if (std::holds_alternative<Index>(ios.value)) {
-        const auto &idx = std::get<Index>(ios.value);
-        if (std::holds_alternative<Identifier>(idx.value)) {
-          IndexOrSlice iosNew;
-          iosNew.value = idx;
-          iosNew.loc = ios.loc;
-          freeIndices.push_back(iosNew);
+  // For each operand: create placeholder for base tensor if needed, then slice
+  for (const auto *factor : factors) {
+    const std::string &name = factor->ref.name.name;
+    if (!env.has(factor->ref)) {
+      // Create a TensorRef with only free variable indices for placeholder
+      // shape inference
+      TensorRef baseRef = factor->ref;
+      // Remove numeric indices - keep only identifiers for shape inference
+      std::vector<IndexOrSlice> freeIndices;
+      for (const auto &ios : baseRef.indices) {
+        if (std::holds_alternative<Index>(ios.value)) {
+          const auto &idx = std::get<Index>(ios.value);
+          if (std::holds_alternative<Identifier>(idx.value)) {
+            IndexOrSlice iosNew;
+            iosNew.value = idx;
+            iosNew.loc = ios.loc;
+            freeIndices.push_back(iosNew);
+          }
         }
       }
+      baseRef.indices = freeIndices;
+      env.bind(name, placeholderForRef(baseRef));
     }
-    baseRef.indices = freeIndices;
-    env.bind(rightName, placeholderForRef(baseRef));
+    inputs_out.push_back(valueForRef(factor->ref, env));
   }
-  inputs_out.push_back(valueForRef(rightRef->ref, env));
 
   return true;
 }
@@ -1,4 +1,5 @@
 #include "TL/Runtime/Executors/ExpressionExecutor.hpp"
+#include "TL/Runtime/ElementwiseFusion.hpp"
 #include "TL/Runtime/ExecutorUtils.hpp"
 #include "TL/vm.hpp"
 #include <torch/torch.h>
@@ -26,6 +27,20 @@ namespace tl {
     }
 
     Tensor ExpressionExecutor::execute(const TensorEquation &eq, Environment &env, TensorBackend &backend) {
+        // A scalar LHS sums a fused elementwise RHS while computing it, rather
+        // than materializing the elements first (see the auto-reduce below)
+        const ExprPtr& rhs = eq.clauses[0].expr;
+        if (eq.lhs.indices.empty() && FusedElementwise::enabled() && FusedElementwise::fusible(*rhs)) {
+            if (auto kernel = FusedElementwise::build(rhs)) {
+                std::vector<Tensor> inputs;
+                inputs.reserve(kernel->leaves().size());
+                for (const auto& leaf : kernel->leaves()) {
+                    inputs.push_back(evalExpr(leaf, eq.lhs, env, backend));
+                }
+                return kernel->sum(inputs);
+            }
+        }
+
         // Evaluate the RHS expression
         Tensor val = evalExpr(eq.clauses[0].expr, eq.lhs, env, backend);
 
@@ -53,14 +68,14 @@ namespace tl {
                 }
             }
 
-            // Write element
-            const auto opts = torch::TensorOptions().dtype(torch::kFloat32);
+            // Write element in the destination's dtype (see DTypePolicy)
+            const auto opts = t.options();
             std::vector<torch::indexing::TensorIndex> elemIdx;
             elemIdx.reserve(idxs_assign.size());
             for (int64_t v : idxs_assign) {
                 elemIdx.emplace_back(v);
             }
-                t.index_put_(elemIdx, val.to(opts.dtype()));
+                t.index_put_(elemIdx, val.to(opts));
 
                 return t;
             }
@@ -82,6 +97,19 @@ namespace tl {
 
         const Expr& e = *ep;
 
+        // Run chains of elementwise operations as one fused kernel; the
+        // non-elementwise leaves are evaluated here as usual
+        if (FusedElementwise::enabled() && FusedElementwise::fusible(e)) {
+            if (auto kernel = FusedElementwise::build(ep)) {
+                std::vector<Tensor> inputs;
+                inputs.reserve(kernel->leaves().size());
+                for (const auto& leaf : kernel->leaves()) {
+                    inputs.push_back(evalExpr(leaf, lhsCtx, env, backend));
+                }
+                return kernel->evaluate(inputs);
+            }
+        }
+
         // Handle numeric literals
         if (const auto* num = std::get_if<ExprNumber>(&e.node)) {
             double v = 0.0;
@@ -111,7 +139,7 @@ namespace tl {
 
             if (hasBounden) {
                 // Resolve indices using bound values from environment
-                Tensor base = env.lookup(tr->ref.name.name);
+                Tensor base = env.lookup(tr->ref);
                 if (tr->ref.indices.empty()) return base;
 
                 std::vector<torch::indexing::TensorIndex> indices;
@@ -153,6 +181,10 @@ namespace tl {
 
         // Handle list literals (should be caught by ListLiteralExecutor, but handle here as fallback)
         if (const auto* lst = std::get_if<ExprList>(&e.node)) {
+            if (auto folded = executor_utils::foldListLiteral(*lst)) {
+                return *folded;
+            }
+
             // Build n-D tensor from nested list literal
             std::function<void(const ExprPtr&, std::vector<int64_t>&, std::vector<float>&)> collect =
                 [&](const ExprPtr& ep2, std::vector<int64_t>& shape_out, std::vector<float>& flat_out) {
@@ -3,10 +3,209 @@
 #include "TL/Runtime/ExecutorUtils.hpp"
 #include "TL/vm.hpp"
 #include <torch/torch.h>
+#include <optional>
 #include <set>
 
 namespace tl {
 
+    namespace {
+
+    // State shared by the lane evaluator: the LHS index variable and the
+    // number of indices it ranges over
+    struct Lanes {
+        const std::string& var;
+        int64_t size;
+        const Environment& env;
+    };
+
+    bool laneCall(const std::string& name) {
+        // Pointwise functions of ExpressionExecutor::evalExpr
+        static const std::set<std::string> kCalls = {
+            "step", "sqrt", "abs", "sigmoid", "tanh", "relu", "exp", "cos",
+            "sin", "tan", "acos", "asin", "atan", "log",
+        };
+        return kCalls.count(name) > 0;
+    }
+
+    std::optional<int64_t> literalIndex(const NumberLiteral& lit) {
+        try {
+            size_t used = 0;
+            const long long v = std::stoll(lit.text, &used);
+            if (used != lit.text.size()) return std::nullopt;
+            return static_cast<int64_t>(v);
+        } catch (...) {
+            return std::nullopt;
+        }
+    }
+
+    // Whether every node evaluates to either a scalar or one value per index
+    bool lanesSupported(const Expr& e, const Lanes& ctx) {
+        if (std::holds_alternative<ExprNumber>(e.node)) return true;
+        if (const auto* par = std::get_if<ExprParen>(&e.node)) {
+            return par->inner && lanesSupported(*par->inner, ctx);
+        }
+        if (const auto* bin = std::get_if<ExprBinary>(&e.node)) {
+            return bin->lhs && bin->rhs && lanesSupported(*bin->lhs, ctx) && lanesSupported(*bin->rhs, ctx);
+        }
+        if (const auto* un = std::get_if<ExprUnary>(&e.node)) {
+            return un->operand && lanesSupported(*un->operand, ctx);
+        }
+        if (const auto* call = std::get_if<ExprCall>(&e.node)) {
+            return call->args.size() == 1 && call->args[0] && laneCall(call->func.name) &&
+                   lanesSupported(*call->args[0], ctx);
+        }
+        const auto* tr = std::get_if<ExprTensorRef>(&e.node);
+        if (!tr) return false;
+
+        const std::string& name = tr->ref.name.name;
+        if (tr->ref.indices.empty()) {
+            if (name == ctx.var) return true;
+            return ctx.env.has(name) && ctx.env.lookup(name).numel() == 1;
+        }
+        if (name == ctx.var || !ctx.env.has(name)) return false;
+        const Tensor t = ctx.env.lookup(name);
+        if (t.is_sparse() || t.dim() != static_cast<int64_t>(tr->ref.indices.size())) return false;
+
+        // Elements are gathered by position, so every index must be in range
+        for (size_t d = 0; d < tr->ref.indices.size(); ++d) {
+            const auto* idx = std::get_if<Index>(&tr->ref.indices[d].value);
+            if (!idx || idx->normalized) return false;
+            const int64_t extent = t.size(static_cast<int64_t>(d));
+            if (const auto* id = std::get_if<Identifier>(&idx->value)) {
+                if (id->name != ctx.var || extent < ctx.size) return false;
+            } else if (const auto* lit = std::get_if<NumberLiteral>(&idx->value)) {
+                auto n = literalIndex(*lit);
+                if (!n || *n < 0 || *n >= extent) return false;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Evaluate e for the index values in `lanes` (int64); mirrors the
+    // operator semantics of ExpressionExecutor::evalExpr
+    Tensor evalLanes(const Expr& e, const Tensor& lanes, const Lanes& ctx) {
+        if (const auto* num = std::get_if<ExprNumber>(&e.node)) {
+            double v = 0.0;
+            try {
+                v = std::stod(num->literal.text);
+            } catch (...) {}
+            return torch::tensor(static_cast<float>(v));
+        }
+        if (const auto* par = std::get_if<ExprParen>(&e.node)) {
+            return evalLanes(*par->inner, lanes, ctx);
+        }
+        if (const auto* bin = std::get_if<ExprBinary>(&e.node)) {
+            Tensor a = evalLanes(*bin->lhs, lanes, ctx);
+            Tensor b = evalLanes(*bin->rhs, lanes, ctx);
+            switch (bin->op) {
+                case ExprBinary::Op::Add: return a + b;
+                case ExprBinary::Op::Sub: return a - b;
+                case ExprBinary::Op::Mul: return a * b;
+                case ExprBinary::Op::Div: return a / b;
+                case ExprBinary::Op::Mod: return torch::fmod(a, b);
+                case ExprBinary::Op::Pow: return torch::pow(a, b);
+                case ExprBinary::Op::Lt: return torch::lt(a, b).to(torch::kFloat32);
+                case ExprBinary::Op::Le: return torch::le(a, b).to(torch::kFloat32);
+                case ExprBinary::Op::Gt: return torch::gt(a, b).to(torch::kFloat32);
+                case ExprBinary::Op::Ge: return torch::ge(a, b).to(torch::kFloat32);
+                case ExprBinary::Op::Eq: return torch::eq(a, b).to(torch::kFloat32);
+                case ExprBinary::Op::Ne: return torch::ne(a, b).to(torch::kFloat32);
+                case ExprBinary::Op::And:
+                    return torch::logical_and(torch::ne(a, 0), torch::ne(b, 0)).to(torch::kFloat32);
+                case ExprBinary::Op::Or:
+                    return torch::logical_or(torch::ne(a, 0), torch::ne(b, 0)).to(torch::kFloat32);
+            }
+        }
+        if (const auto* un = std::get_if<ExprUnary>(&e.node)) {
+            Tensor a = evalLanes(*un->operand, lanes, ctx);
+            if (un->op == ExprUnary::Op::Neg) return -a;
+            return torch::eq(a, 0).to(torch::kFloat32);
+        }
+        if (const auto* call = std::get_if<ExprCall>(&e.node)) {
+            Tensor a = evalLanes(*call->args[0], lanes, ctx);
+            const std::string& f = call->func.name;
+            if (f == "step") return torch::gt(a, 0).to(torch::kFloat32);
+            if (f == "sqrt") return torch::sqrt(a);
+            if (f == "abs") return torch::abs(a);
+            if (f == "sigmoid") return torch::sigmoid(a);
+            if (f == "tanh") return torch::tanh(a);
+            if (f == "relu") return torch::relu(a);
+            if (f == "exp") return torch::exp(a);
+            if (f == "cos") return torch::cos(a);
+            if (f == "sin") return torch::sin(a);
+            if (f == "tan") return torch::tan(a);
+            if (f == "acos") return torch::acos(a);
+            if (f == "asin") return torch::asin(a);
+            if (f == "atan") return torch::atan(a);
+            return torch::log(a);
+        }
+
+        const auto& ref = std::get<ExprTensorRef>(e.node).ref;
+        if (ref.indices.empty()) {
+            if (ref.name.name == ctx.var) return lanes.to(torch::kFloat32);
+            return ctx.env.lookup(ref).reshape({});
+        }
+
+        // Gather one element per lane through the row-major offset
+        Tensor t = ctx.env.lookup(ref).contiguous();
+        Tensor offset = torch::zeros_like(lanes);
+        int64_t stride = 1;
+        for (int64_t d = t.dim() - 1; d >= 0; --d) {
+            const auto& idx = std::get<Index>(ref.indices[static_cast<size_t>(d)].value);
+            if (std::holds_alternative<Identifier>(idx.value)) {
+                offset = offset + lanes * stride;
+            } else {
+                offset = offset + *literalIndex(std::get<NumberLiteral>(idx.value)) * stride;
+            }
+            stride *= t.size(d);
+        }
+        return t.reshape({-1}).index_select(0, offset);
+    }
+
+    // First-match-wins over all indices at once. Each guard is evaluated on
+    // the indices no earlier clause took, and each body only on the indices
+    // its guard matched, so a clause never computes values that are masked out.
+    std::optional<Tensor> executeLanes(const TensorEquation& eq, const Lanes& ctx) {
+        for (const auto& clause : eq.clauses) {
+            if (!lanesSupported(*clause.expr, ctx)) return std::nullopt;
+            if (clause.guard.has_value() && !(*clause.guard && lanesSupported(**clause.guard, ctx))) {
+                return std::nullopt;
+            }
+        }
+
+        const auto opts = ctx.env.tensorOptions();
+        Tensor result = torch::zeros({ctx.size}, opts);
+        Tensor remaining = torch::arange(ctx.size, opts.dtype(torch::kInt64));
+        for (const auto& clause : eq.clauses) {
+            if (remaining.numel() == 0) break;
+
+            Tensor matched = remaining;
+            if (clause.guard.has_value()) {
+                Tensor mask = torch::ne(evalLanes(**clause.guard, remaining, ctx), 0);
+                if (mask.dim() == 0) mask = mask.expand({remaining.numel()});
+                matched = remaining.masked_select(mask);
+                remaining = remaining.masked_select(torch::logical_not(mask));
+            } else {
+                remaining = remaining.narrow(0, 0, 0);
+            }
+            if (matched.numel() == 0) continue;
+
+            Tensor value = evalLanes(*clause.expr, matched, ctx).to(result.scalar_type());
+            if (value.dim() == 0) value = value.expand({matched.numel()});
+            result.index_copy_(0, matched, value);
+        }
+
+        if (remaining.numel() > 0) {
+            throw ExecutionError("GuardedClauseExecutor: no clause matched for index " +
+                                 std::to_string(remaining[0].item<int64_t>()));
+        }
+        return result;
+    }
+
+    } // namespace
+
     bool GuardedClauseExecutor::canExecute(const TensorEquation &eq, const Environment &env) const {
         // Only handle standard assignment (=)
         if (!eq.projection.empty() && eq.projection != "=") {
@@ -54,8 +253,8 @@ namespace tl {
                 const Expr& e = *ep;
 
                 if (const auto* tr = std::get_if<ExprTensorRef>(&e.node)) {
-                    if (env.has(tr->ref.name.name)) {
-                        Tensor t = env.lookup(tr->ref.name.name);
+                    if (env.has(tr->ref)) {
+                        Tensor t = env.lookup(tr->ref);
                         if (t.dim() > 0) {
                             maxSize = std::max(maxSize, t.size(0));
                         }
@@ -87,6 +286,17 @@ namespace tl {
                 throw ExecutionError("GuardedClauseExecutor: cannot determine iteration size");
             }
 
+            for (const auto& clause : eq.clauses) {
+                if (!clause.expr) {
+                    throw ExecutionError("GuardedClauseExecutor: null expression in clause");
+                }
+            }
+            if (vectorized_ && indexVars.size() == 1 && eq.lhs.indices.size() == 1) {
+                if (auto result = executeLanes(eq, Lanes{indexVars[0], maxSize, env})) {
+                    return *result;
+                }
+            }
+
             // Evaluate element-by-element to handle expressions like X[i] * X[i] correctly
             // Save any existing bindings for index variables
             std::vector<std::pair<std::string, Tensor>> savedBindings;
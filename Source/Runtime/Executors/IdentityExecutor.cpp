@@ -43,8 +43,7 @@ namespace tl {
         }
 
         // It's an identity if the RHS tensor exists
-        const std::string srcName = eref->ref.name.name;
-        return env.has(srcName);
+        return env.has(eref->ref);
     }
 
     Tensor IdentityExecutor::execute(const TensorEquation &eq, Environment &env, TensorBackend &backend) {
@@ -54,8 +53,7 @@ namespace tl {
             throw ExecutionError("IdentityExecutor: expected tensor ref on RHS");
         }
 
-        const std::string srcName = eref->ref.name.name;
-        Tensor src = env.lookup(srcName);
+        Tensor src = env.lookup(eref->ref);
 
         // Apply RHS indices if present
         if (!eref->ref.indices.empty()) {
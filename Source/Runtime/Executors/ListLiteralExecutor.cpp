@@ -1,4 +1,5 @@
 #include "TL/Runtime/Executors/ListLiteralExecutor.hpp"
+#include "TL/Runtime/ExecutorUtils.hpp"
 #include "TL/vm.hpp"
 #include <torch/torch.h>
 #include <functional>
@@ -36,6 +37,11 @@ namespace tl {
             throw ExecutionError("List literal executor: expected list literal");
         }
 
+        // All-numeric literals are parsed once and cached on the node
+        if (auto folded = executor_utils::foldListLiteral(*lst)) {
+            return *folded;
+        }
+
         // Helper: recursively evaluate and collect shape and data
         std::function<Tensor(const ExprPtr&)> evalExpr_simple = [&](const ExprPtr& ep) -> Tensor {
             if (!ep) throw ExecutionError("null expression in list literal");
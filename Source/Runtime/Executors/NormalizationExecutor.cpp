@@ -1,6 +1,7 @@
 #include "TL/Runtime/Executors/NormalizationExecutor.hpp"
 #include "TL/Runtime/Executors/ExpressionExecutor.hpp"
 #include "TL/Runtime/ExecutorUtils.hpp"
+#include "TL/Runtime/NormalizationFusion.hpp"
 #include "TL/vm.hpp"
 #include <torch/torch.h>
 
@@ -63,8 +64,12 @@ namespace tl {
             // But we need to ensure it was applied to the correct dimension
             normalized = rawValues;
         } else {
-            // Apply softmax along the normalized dimension
-            normalized = torch::softmax(rawValues, normDim);
+            // Apply softmax along the normalized dimension; values computed for
+            // this equation alone (not a tensor of the environment) are reused
+            // for the result
+            const bool owned = !rawValues.is_sparse() && rawValues.use_count() == 1 &&
+                               rawValues.storage().use_count() == 1;
+            normalized = FusedNormalization::softmax(rawValues, normDim, owned);
         }
 
         return normalized;
@@ -3,9 +3,100 @@
 #include <torch/torch.h>
 #include <unordered_map>
 #include <limits>
+#include <optional>
 
 namespace tl {
 
+    namespace {
+
+    // Output position of an LHS index: the RHS axis it reads (-1 for a fixed
+    // index) and the pooling divisor
+    struct PoolAxis {
+        int64_t rhsAxis;
+        int64_t divisor;
+    };
+
+    const char* scatterReduction(const std::string& projection) {
+        if (projection == "max=") return "amax";
+        if (projection == "min=") return "amin";
+        if (projection == "avg=") return "mean";
+        return "sum";
+    }
+
+    Tensor reduceDims(const Tensor& x, const std::vector<int64_t>& dims, const std::string& projection) {
+        if (dims.empty()) return x;
+        if (projection == "max=") return x.amax(dims);
+        if (projection == "min=") return x.amin(dims);
+        if (projection == "avg=") return x.mean(dims);
+        return x.sum(dims);
+    }
+
+    // Every output cell pools a full window of consecutive source elements when
+    // the LHS reads RHS axes in order, each at most once, with divisors that
+    // divide the axis. Such a pooling is a reshape that splits each divided
+    // axis into (size / divisor, divisor) followed by one reduction.
+    std::optional<Tensor> poolByReshape(const Tensor& x, const std::vector<PoolAxis>& axes,
+                                        const std::vector<int64_t>& outShape, const std::string& projection) {
+        std::vector<int64_t> divisorOf(static_cast<size_t>(x.dim()), 0);  // 0 = reduced away
+        int64_t last = -1;
+        for (const auto& a : axes) {
+            if (a.rhsAxis < 0) continue;
+            if (a.rhsAxis <= last || x.size(a.rhsAxis) % a.divisor != 0) return std::nullopt;
+            divisorOf[static_cast<size_t>(a.rhsAxis)] = a.divisor;
+            last = a.rhsAxis;
+        }
+
+        std::vector<int64_t> split;
+        std::vector<int64_t> reduced;
+        for (int64_t d = 0; d < x.dim(); ++d) {
+            const int64_t div = divisorOf[static_cast<size_t>(d)];
+            if (div == 0) {
+                reduced.push_back(static_cast<int64_t>(split.size()));
+                split.push_back(x.size(d));
+            } else if (div == 1) {
+                split.push_back(x.size(d));
+            } else {
+                split.push_back(x.size(d) / div);
+                reduced.push_back(static_cast<int64_t>(split.size()));
+                split.push_back(div);
+            }
+        }
+        return reduceDims(x.reshape(split), reduced, projection).reshape(outShape);
+    }
+
+    // General case: the flat output cell of every source element is computed
+    // by broadcasting one index vector per LHS axis, then a single
+    // scatter_reduce pools all elements. Cells no element maps to keep the
+    // projection's identity (0 or +/-inf), as with per-element accumulation.
+    Tensor poolByScatter(const Tensor& x, const std::vector<PoolAxis>& axes,
+                         const std::vector<int64_t>& outShape, const std::string& projection) {
+        const auto longOpts = x.options().dtype(torch::kInt64);
+        Tensor cell = torch::zeros(x.sizes(), longOpts);
+        int64_t stride = 1;
+        for (int64_t li = static_cast<int64_t>(axes.size()) - 1; li >= 0; --li) {
+            const auto& a = axes[static_cast<size_t>(li)];
+            if (a.rhsAxis >= 0) {
+                Tensor pos = torch::arange(x.size(a.rhsAxis), longOpts);
+                if (a.divisor > 1) pos = torch::div(pos, a.divisor, "floor");
+                std::vector<int64_t> view(static_cast<size_t>(x.dim()), 1);
+                view[static_cast<size_t>(a.rhsAxis)] = x.size(a.rhsAxis);
+                cell = cell + pos.view(view) * stride;
+            }
+            stride *= outShape[static_cast<size_t>(li)];
+        }
+
+        float init = 0.0f;
+        if (projection == "max=") init = -std::numeric_limits<float>::infinity();
+        if (projection == "min=") init = std::numeric_limits<float>::infinity();
+        Tensor out = torch::full(outShape, init, x.options());
+        // Averages only count source elements; empty cells stay 0
+        out.view({-1}).scatter_reduce_(0, cell.reshape({-1}), x.reshape({-1}),
+                                       scatterReduction(projection), /*include_self=*/projection != "avg=");
+        return out;
+    }
+
+    } // namespace
+
     bool PoolingExecutor::canExecute(const TensorEquation &eq, const Environment &env) const {
         // Check if this is a pooling operation (+=, max=, min=, avg=)
         if (eq.projection != "+=" && eq.projection != "max=" &&
@@ -25,8 +116,7 @@ namespace tl {
         if (!eref) return false;
 
         // RHS tensor must exist
-        const std::string srcName = eref->ref.name.name;
-        return env.has(srcName);
+        return env.has(eref->ref);
     }
 
     Tensor PoolingExecutor::execute(const TensorEquation &eq, Environment &env, TensorBackend &backend) {
@@ -102,7 +192,30 @@ namespace tl {
             }
         }
 
-        // Prepare output tensor
+        // Pool the whole tensor in one reduction when the RHS indexes every axis
+        if (rank > 0 && src.numel() > 0 && !src.is_sparse() &&
+            static_cast<int64_t>(eref->ref.indices.size()) == rank && lhsMap.size() == outShape.size()) {
+            const Tensor x = src.to(torch::kFloat32);
+            if (outShape.empty()) {
+                if (eq.projection == "max=") return x.max();
+                if (eq.projection == "min=") return x.min();
+                if (eq.projection == "avg=") return x.mean().reshape({1});
+                return x.sum();
+            }
+
+            std::vector<PoolAxis> axes;
+            axes.reserve(lhsMap.size());
+            for (const auto &mi : lhsMap) {
+                auto it = mi.base.empty() ? rhsAxis.end() : rhsAxis.find(mi.base);
+                axes.push_back({it == rhsAxis.end() ? -1 : it->second, mi.divisor});
+            }
+            if (auto pooled = poolByReshape(x, axes, outShape, eq.projection)) {
+                return *pooled;
+            }
+            return poolByScatter(x, axes, outShape, eq.projection);
+        }
+
+        // Scalar or empty sources: accumulate element by element
         torch::TensorOptions opts = torch::TensorOptions().dtype(torch::kFloat32);
         torch::Tensor out;
 
@@ -50,8 +50,10 @@ namespace tl {
         // Ensure tensor is large enough (uses helper to avoid duplication)
         Tensor tensor = executor_utils::ensureTensorSize(lhs_name, *indices, env);
 
-        // Set value at indices - handle multi-dimensional case
-        const auto opts = torch::TensorOptions().dtype(torch::kFloat32);
+        // Set value at indices - handle multi-dimensional case. The value takes
+        // the destination's dtype and device, which follow the environment's
+        // dtype policy.
+        const auto opts = tensor.options();
         std::vector<torch::indexing::TensorIndex> elem_idx;
         elem_idx.reserve(indices->size());
         for (int64_t v : *indices) {
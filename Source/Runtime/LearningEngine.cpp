@@ -2,6 +2,8 @@
 #include "TL/vm.hpp"
 #include "TL/backend.hpp"
 #include "TL/Runtime/ExecutorRegistry.hpp"
+#include "TL/Runtime/ExecutorUtils.hpp"
+#include "TL/Runtime/Profiler.hpp"
 #include "TL/Runtime/Executors/ScalarAssignExecutor.hpp"
 #include "TL/Runtime/Executors/ListLiteralExecutor.hpp"
 #include "TL/Runtime/Executors/EinsumExecutor.hpp"
@@ -12,12 +14,133 @@
 #include "TL/Runtime/Executors/PoolingExecutor.hpp"
 #include "TL/Runtime/Executors/IdentityExecutor.hpp"
 #include "TL/Runtime/Executors/ExpressionExecutor.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <cmath>
+#include <thread>
 
 namespace tl {
 
+namespace {
+// Equations whose single clause is a list literal define parameters and
+// constant data; training loops never re-execute them
+bool isListLiteral(const TensorEquation& eq) {
+    return eq.clauses.size() == 1 && eq.clauses[0].expr &&
+           std::holds_alternative<ExprList>(eq.clauses[0].expr->node);
+}
+
+bool hasVirtualLhs(const TensorEquation& eq) {
+    for (const auto& ios : eq.lhs.indices) {
+        const auto* idx = std::get_if<Index>(&ios.value);
+        if (idx && std::holds_alternative<VirtualIndex>(idx->value)) return true;
+    }
+    return false;
+}
+
+// Cuts the rows of tensors with a common first dimension into the
+// mini-batches of every epoch, in order. Shuffled batches are gathered
+// copies, the others views. With prefetch > 0 a loader thread prepares up
+// to that many batches ahead of the training loop.
+class BatchLoader {
+public:
+    BatchLoader(std::vector<torch::Tensor> sources, int64_t batchSize, bool shuffle, int epochs, size_t prefetch)
+        : sources_(std::move(sources)),
+          rows_(sources_.front().size(0)),
+          batchSize_(batchSize),
+          shuffle_(shuffle),
+          total_(std::max(epochs, 0) * batchesPerEpoch()),
+          prefetch_(prefetch) {
+        if (prefetch_ > 0 && total_ > 0) thread_ = std::thread([this] { run(); });
+    }
+
+    ~BatchLoader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        space_.notify_all();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    BatchLoader(const BatchLoader&) = delete;
+    BatchLoader& operator=(const BatchLoader&) = delete;
+
+    int64_t batchesPerEpoch() const { return (rows_ + batchSize_ - 1) / batchSize_; }
+
+    // One slice per source; rethrows what the loader thread threw
+    std::vector<torch::Tensor> next() {
+        if (prefetch_ == 0 || total_ == 0) return make(made_++);
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [&] { return !queue_.empty() || error_; });
+        if (queue_.empty()) std::rethrow_exception(error_);
+        std::vector<torch::Tensor> batch = std::move(queue_.front());
+        queue_.pop_front();
+        space_.notify_one();
+        return batch;
+    }
+
+private:
+    // Batch k of the whole run; called in increasing order of k
+    std::vector<torch::Tensor> make(int64_t k) {
+        const int64_t b = k % batchesPerEpoch();
+        if (shuffle_ && b == 0) order_ = torch::randperm(rows_, torch::kLong);
+        const int64_t start = b * batchSize_;
+        const int64_t length = std::min(batchSize_, rows_ - start);
+        std::vector<torch::Tensor> batch;
+        batch.reserve(sources_.size());
+        for (const auto& source : sources_) {
+            if (shuffle_) {
+                batch.push_back(source.index_select(0, order_.narrow(0, start, length).to(source.device())));
+            } else {
+                batch.push_back(source.narrow(0, start, length));
+            }
+        }
+        return batch;
+    }
+
+    void run() {
+        try {
+            for (int64_t k = 0; k < total_; ++k) {
+                std::vector<torch::Tensor> batch = make(k);
+                std::unique_lock<std::mutex> lock(mutex_);
+                space_.wait(lock, [&] { return stop_ || queue_.size() < prefetch_; });
+                if (stop_) return;
+                queue_.push_back(std::move(batch));
+                ready_.notify_one();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+            ready_.notify_one();
+        }
+    }
+
+    std::vector<torch::Tensor> sources_;
+    int64_t rows_;
+    int64_t batchSize_;
+    bool shuffle_;
+    int64_t total_;
+    size_t prefetch_;
+    torch::Tensor order_;  // row order of the current epoch when shuffling
+    int64_t made_{0};      // batches made without the thread
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable ready_;  // a batch or an error is available
+    std::condition_variable space_;  // the queue has room, or stop_ is set
+    std::deque<std::vector<torch::Tensor>> queue_;
+    std::exception_ptr error_;
+    bool stop_{false};
+};
+}
+
 LearningConfig LearningConfig::fromDirective(const QueryDirective& dir) {
     LearningConfig config;
     config.directive = dir.name.name;
@@ -41,12 +164,138 @@ LearningConfig LearningConfig::fromDirective(const QueryDirective& dir) {
             if (auto* b = std::get_if<bool>(&arg.value)) {
                 config.verbose = *b;
             }
+        } else if (name == "batch_size") {
+            if (auto* num = std::get_if<NumberLiteral>(&arg.value)) {
+                config.batchSize = std::stoi(num->text);
+            }
+        } else if (name == "shuffle") {
+            if (auto* b = std::get_if<bool>(&arg.value)) {
+                config.shuffle = *b;
+            }
+        } else if (name == "workers") {
+            if (auto* num = std::get_if<NumberLiteral>(&arg.value)) {
+                config.workers = std::stoi(num->text);
+            }
+        } else if (name == "checkpoint") {
+            if (auto* num = std::get_if<NumberLiteral>(&arg.value)) {
+                config.checkpoint = std::stoi(num->text);
+            } else if (auto* b = std::get_if<bool>(&arg.value)) {
+                config.checkpoint = *b ? -1 : 0;
+            }
+        } else if (name == "seed") {
+            if (auto* num = std::get_if<NumberLiteral>(&arg.value)) {
+                config.seed = std::stoull(num->text);
+            }
+        } else if (name == "output") {
+            if (auto* str = std::get_if<StringLiteral>(&arg.value)) {
+                if (str->text == "counts") {
+                    config.sampleCounts = true;
+                } else if (str->text == "samples") {
+                    config.sampleCounts = false;
+                } else {
+                    throw std::runtime_error("Unknown sample output: " + str->text + " (expected samples or counts)");
+                }
+            }
+        } else if (name == "optimizer" || name == "optim") {
+            if (auto* str = std::get_if<StringLiteral>(&arg.value)) {
+                config.optimizer = str->text;
+                std::transform(config.optimizer.begin(), config.optimizer.end(), config.optimizer.begin(),
+                               [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            }
+        } else if (auto* num = std::get_if<NumberLiteral>(&arg.value)) {
+            if (name == "momentum") {
+                config.momentum = std::stod(num->text);
+            } else if (name == "weight_decay") {
+                config.weightDecay = std::stod(num->text);
+            } else if (name == "beta1") {
+                config.beta1 = std::stod(num->text);
+            } else if (name == "beta2") {
+                config.beta2 = std::stod(num->text);
+            } else if (name == "eps") {
+                config.eps = std::stod(num->text);
+            } else if (name == "alpha") {
+                config.alpha = std::stod(num->text);
+            }
         }
     }
 
     return config;
 }
 
+ParameterBuffer::ParameterBuffer(Environment& env, const std::unordered_set<std::string>& params) {
+    std::vector<std::string> names(params.begin(), params.end());
+    std::sort(names.begin(), names.end());
+
+    std::vector<torch::Tensor> values;
+    values.reserve(names.size());
+    int64_t numel = 0;
+    for (const auto& name : names) {
+        const torch::Tensor value = env.lookup(name).detach();
+        slots_.push_back(Slot{name, numel, value.sizes().vec()});
+        numel += value.numel();
+        values.push_back(value);
+    }
+    if (values.empty()) return;
+
+    auto dtype = values.front().scalar_type();
+    for (const auto& value : values) dtype = torch::promote_types(dtype, value.scalar_type());
+    if (!torch::isFloatingType(dtype)) dtype = torch::kFloat32;
+
+    flat_ = torch::empty({numel}, values.front().options().dtype(dtype));
+    for (size_t i = 0; i < values.size(); ++i) {
+        flat_.narrow(0, slots_[i].offset, values[i].numel()).copy_(values[i].reshape({-1}));
+    }
+    flat_.requires_grad_(true);
+}
+
+void ParameterBuffer::bindViews(Environment& env, bool trainable) const {
+    const torch::Tensor base = trainable ? flat_ : flat_.detach();
+    for (const auto& slot : slots_) {
+        int64_t numel = 1;
+        for (int64_t d : slot.shape) numel *= d;
+        env.bind(slot.name, base.narrow(0, slot.offset, numel).view(slot.shape));
+    }
+}
+
+std::unique_ptr<torch::optim::Optimizer> makeOptimizer(
+    const LearningConfig& config,
+    const std::vector<torch::Tensor>& params
+) {
+    const std::string& kind = config.optimizer;
+    if (kind == "sgd") {
+        torch::optim::SGDOptions options(config.learningRate);
+        if (config.momentum >= 0) options.momentum(config.momentum);
+        if (config.weightDecay >= 0) options.weight_decay(config.weightDecay);
+        return std::make_unique<torch::optim::SGD>(params, options);
+    }
+    if (kind == "adam" || kind == "adamw") {
+        auto configure = [&](auto options) {
+            auto betas = options.betas();
+            if (config.beta1 >= 0) std::get<0>(betas) = config.beta1;
+            if (config.beta2 >= 0) std::get<1>(betas) = config.beta2;
+            options.betas(betas);
+            if (config.eps >= 0) options.eps(config.eps);
+            if (config.weightDecay >= 0) options.weight_decay(config.weightDecay);
+            return options;
+        };
+        if (kind == "adam") {
+            return std::make_unique<torch::optim::Adam>(
+                params, configure(torch::optim::AdamOptions(config.learningRate)));
+        }
+        return std::make_unique<torch::optim::AdamW>(
+            params, configure(torch::optim::AdamWOptions(config.learningRate)));
+    }
+    if (kind == "rmsprop") {
+        torch::optim::RMSpropOptions options(config.learningRate);
+        if (config.alpha >= 0) options.alpha(config.alpha);
+        if (config.eps >= 0) options.eps(config.eps);
+        if (config.momentum >= 0) options.momentum(config.momentum);
+        if (config.weightDecay >= 0) options.weight_decay(config.weightDecay);
+        return std::make_unique<torch::optim::RMSprop>(params, options);
+    }
+    throw std::runtime_error("Unknown optimizer: " + kind + " (expected sgd, adam, adamw or rmsprop)");
+}
+
 LearningEngine::LearningEngine(Environment& env, TensorBackend& backend, ExecutorRegistry& registry, std::ostream* output)
     : env_(env), backend_(backend), registry_(registry), output_(output ? output : &std::cout) {}
 
@@ -81,16 +330,7 @@ std::unordered_set<std::string> LearningEngine::identifyLearnableParameters(cons
         if (auto* eq = std::get_if<TensorEquation>(&stmt)) {
             const std::string& lhsName = eq->lhs.name.name;
 
-            // Check if RHS is a simple list literal assignment
-            bool isListLiteral = false;
-            if (eq->clauses.size() == 1) {
-                const auto& clause = eq->clauses[0];
-                if (auto* exprList = std::get_if<ExprList>(&clause.expr->node)) {
-                    isListLiteral = true;
-                }
-            }
-
-            if (isListLiteral) {
+            if (isListLiteral(*eq)) {
                 // Check naming convention: lowercase first letter = learnable parameter
                 // Exception: uppercase W* (weight matrices) are also learnable
                 bool isParameter = false;
@@ -125,29 +365,114 @@ void LearningEngine::enableGradients(const std::unordered_set<std::string>& para
     (void)params;  // Suppress unused parameter warning
 }
 
-void LearningEngine::forwardPass(const Program& program) {
-    // Execute all tensor equations in order
+TrainingPlan LearningEngine::planTraining(
+    const std::string& targetName,
+    const std::unordered_set<std::string>& params,
+    const Program& program
+) {
+    std::vector<const TensorEquation*> equations;
+    std::vector<std::vector<std::string>> reads;
     for (const auto& stmt : program.statements) {
-        if (auto* eq = std::get_if<TensorEquation>(&stmt)) {
-            // For learnable parameters (list literals), skip re-execution
-            // They should retain their current values and gradients
-            bool isListLiteral = false;
-            if (eq->clauses.size() == 1) {
-                if (auto* exprList = std::get_if<ExprList>(&eq->clauses[0].expr->node)) {
-                    isListLiteral = true;
+        const auto* eq = std::get_if<TensorEquation>(&stmt);
+        if (!eq || isListLiteral(*eq)) continue;
+        equations.push_back(eq);
+        reads.emplace_back();
+        executor_utils::forEachTensorRef(*eq, [&](const TensorRef& ref) {
+            reads.back().push_back(ref.name.name);
+        });
+    }
+
+    // Both closures iterate to a fixed point, since a name may be written by
+    // several equations and read before its last write
+    std::unordered_set<std::string> dependent(params.begin(), params.end());
+    std::unordered_set<std::string> needed{targetName};
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 0; i < equations.size(); ++i) {
+            const std::string& lhs = equations[i]->lhs.name.name;
+            if (!dependent.count(lhs)) {
+                for (const auto& name : reads[i]) {
+                    if (dependent.count(name)) {
+                        dependent.insert(lhs);
+                        changed = true;
+                        break;
+                    }
                 }
             }
+            if (needed.count(lhs)) {
+                for (const auto& name : reads[i]) {
+                    if (needed.insert(name).second) changed = true;
+                }
+            }
+        }
+    }
 
-            if (isListLiteral) {
-                // Skip - this is a learnable parameter, don't re-initialize
-                continue;
+    TrainingPlan plan;
+    plan.target = targetName;
+    std::unordered_set<std::string> written;
+    for (size_t i = 0; i < equations.size(); ++i) {
+        const std::string& lhs = equations[i]->lhs.name.name;
+        if (needed.count(lhs) && dependent.count(lhs)) written.insert(lhs);
+    }
+    for (size_t i = 0; i < equations.size(); ++i) {
+        if (!written.count(equations[i]->lhs.name.name)) continue;
+        for (const auto& name : reads[i]) {
+            if (written.count(name) || params.count(name)) continue;
+            if (std::find(plan.inputs.begin(), plan.inputs.end(), name) == plan.inputs.end()) {
+                plan.inputs.push_back(name);
             }
+        }
+    }
+    auto groupOf = [&](const TensorEquation& eq) -> std::vector<TrainingStep>* {
+        const std::string& lhs = eq.lhs.name.name;
+        const bool isDependent = dependent.count(lhs) > 0;
+        if (needed.count(lhs)) return isDependent ? &plan.steps : &plan.cached;
+        return isDependent ? &plan.refresh : nullptr;
+    };
+    auto rank = [&](const std::vector<TrainingStep>* group) {
+        return group == &plan.steps ? 3 : group == &plan.cached ? 2 : group == &plan.refresh ? 1 : 0;
+    };
+    std::vector<TrainingStep>* recurrenceGroup = nullptr;
+    for (const TensorEquation* eq : equations) {
+        if (!hasVirtualLhs(*eq)) continue;
+        plan.recurrences.emplace_back(*eq);
+        std::vector<TrainingStep>* group = groupOf(*eq);
+        if (rank(group) > rank(recurrenceGroup)) recurrenceGroup = group;
+    }
+    bool recurrencePlaced = false;
+    for (const TensorEquation* eq : equations) {
+        if (hasVirtualLhs(*eq)) {
+            if (recurrenceGroup && !recurrencePlaced) recurrenceGroup->push_back(TrainingStep{});
+            recurrencePlaced = true;
+            continue;
+        }
+        // Equations neither reading a parameter nor feeding the target keep
+        // the values of the program run
+        if (std::vector<TrainingStep>* group = groupOf(*eq)) group->push_back(TrainingStep{eq});
+    }
+    return plan;
+}
 
-            // Execute the equation - this will compute fresh values with gradients
-            // IMPORTANT: Must bind result back to environment to preserve gradient chain
-            torch::Tensor result = registry_.execute(*eq, env_, backend_);
-            env_.bind(eq->lhs.name.name, result);
+void LearningEngine::runSteps(std::vector<TrainingStep>& steps) {
+    for (auto& step : steps) {
+        if (!step.equation) {
+            if (!recurrence_runner_) {
+                throw std::runtime_error("Training through recurrences needs a VM to run them");
+            }
+            recurrence_runner_(plan_.recurrences, checkpoint_);
+            continue;
         }
+        // Binding results never adds names after the first epoch, so each
+        // executor is chosen once; select() may bind placeholders, hence the
+        // layout is read first
+        const uint64_t layout = env_.layoutVersion();
+        if (!step.executor || step.layout != layout) {
+            step.executor = &registry_.select(*step.equation, env_);
+            step.layout = layout;
+        }
+        // Bind the result back so later steps extend its gradient chain
+        torch::Tensor result = registry_.execute(*step.executor, *step.equation, env_, backend_);
+        env_.bind(step.equation->lhs.name.name, result);
     }
 }
 
@@ -186,81 +511,171 @@ void LearningEngine::zeroGradients(const std::unordered_set<std::string>& params
     }
 }
 
-torch::Tensor LearningEngine::minimize(
-    const std::string& lossName,
+std::vector<std::string> LearningEngine::batchedInputs(const LearningConfig& config) {
+    std::vector<std::string> names;
+    if (config.batchSize <= 0) return names;
+    int64_t rows = 0;
+    for (const auto& name : plan_.inputs) {
+        if (!env_.has(name)) continue;
+        const torch::Tensor t = env_.lookup(name);
+        if (t.dim() > 0) rows = std::max(rows, t.size(0));
+    }
+    if (rows <= config.batchSize) return names;
+    // Inputs with other first dimensions (weights, scalars) are shared by every batch
+    for (const auto& name : plan_.inputs) {
+        if (!env_.has(name)) continue;
+        const torch::Tensor t = env_.lookup(name);
+        if (t.dim() > 0 && t.size(0) == rows) names.push_back(name);
+    }
+    return names;
+}
+
+torch::Tensor LearningEngine::train(
+    const std::string& targetName,
     const LearningConfig& config,
-    const Program& program
+    const Program& program,
+    bool maximize
 ) {
+    const std::string label = maximize ? "Reward" : "Loss";
+    if (config.batchSize < 0) {
+        throw std::runtime_error("batch_size must not be negative");
+    }
+    if (config.workers < 0) {
+        throw std::runtime_error("workers must not be negative");
+    }
+    if (config.checkpoint < -1) {
+        throw std::runtime_error("checkpoint must be a number of steps or true");
+    }
+
     // Identify learnable parameters
     auto params = identifyLearnableParameters(program);
-
     if (params.empty()) {
-        throw std::runtime_error("No learnable parameters found for minimization");
+        throw std::runtime_error(std::string("No learnable parameters found for ") +
+                                 (maximize ? "maximization" : "minimization"));
     }
 
-    // Enable gradients for learnable parameters
-    enableGradients(params);
+    // Pack the parameters into one buffer; the environment holds views of
+    // it for the whole loop and the optimizer updates it in place
+    parameters_ = std::make_unique<ParameterBuffer>(env_, params);
+    std::unique_ptr<torch::optim::Optimizer> optimizer = makeOptimizer(config, {parameters_->flat()});
+    parameters_->bindViews(env_, true);
+    if (config.verbose) {
+        for (const auto& slot : parameters_->slots()) {
+            (*output_) << "Parameter " << slot.name << " at offset " << slot.offset << std::endl;
+        }
+        (*output_) << "Optimizer: " << config.optimizer << " over "
+                  << parameters_->flat().numel() << " values" << std::endl;
+    }
 
-    // Create parameter vector for optimizer
-    // IMPORTANT: We need to pass the actual tensors that will be updated,
-    // not copies. We'll get them from env after each forward pass.
-    std::vector<torch::Tensor> param_tensors;
-    for (const auto& name : params) {
-        param_tensors.push_back(env_.lookup(name).clone().detach().requires_grad_(true));
+    plan_ = planTraining(targetName, params, program);
+    checkpoint_ = config.checkpoint;
+    if (config.verbose) {
+        (*output_) << "Training plan: " << plan_.steps.size() << " equations per epoch, "
+                  << plan_.cached.size() << " cached" << std::endl;
+    }
+    {
+        torch::NoGradGuard noGrad;
+        runSteps(plan_.cached);
     }
 
-    // Rebind the parameters with gradients enabled
-    size_t idx = 0;
-    for (const auto& name : params) {
-        env_.bind(name, param_tensors[idx]);
+    // Mini-batches stand in for the full data tensors while training
+    const std::vector<std::string> batched = batchedInputs(config);
+    std::vector<torch::Tensor> full;
+    for (const auto& name : batched) full.push_back(env_.lookup(name));
+    std::unique_ptr<BatchLoader> loader;
+    if (!batched.empty()) {
+        loader = std::make_unique<BatchLoader>(full, config.batchSize, config.shuffle, config.epochs,
+                                               static_cast<size_t>(config.workers));
         if (config.verbose) {
-            (*output_) << "Parameter " << name << " requires_grad="
-                      << param_tensors[idx].requires_grad() << std::endl;
+            (*output_) << "Mini-batches: " << loader->batchesPerEpoch() << " per epoch of "
+                      << batched.size() << " data tensors" << std::endl;
         }
-        idx++;
     }
-
-    // Create SGD optimizer
-    torch::optim::SGD optimizer(param_tensors, torch::optim::SGDOptions(config.learningRate));
+    auto restoreData = [&] {
+        loader.reset();  // joins the loader thread
+        for (size_t i = 0; i < batched.size(); ++i) env_.bind(batched[i], full[i]);
+    };
+    const int64_t batches = loader ? loader->batchesPerEpoch() : 1;
+    const int report = std::max(1, config.epochs / 10);
 
     // Training loop
-    for (int epoch = 0; epoch < config.epochs; ++epoch) {
-        // Zero gradients
-        optimizer.zero_grad();
+    try {
+        for (int epoch = 0; epoch < config.epochs; ++epoch) {
+            const auto epochStart = std::chrono::steady_clock::now();
+            double total = 0.0;
+            for (int64_t batch = 0; batch < batches; ++batch) {
+                if (loader) {
+                    std::vector<torch::Tensor> slices = loader->next();
+                    for (size_t i = 0; i < batched.size(); ++i) env_.bind(batched[i], slices[i]);
+                }
 
-        // Forward pass
-        forwardPass(program);
+                // Zero gradients
+                optimizer->zero_grad();
 
-        // Get current loss
-        if (!env_.has(lossName)) {
-            throw std::runtime_error("Loss tensor not found: " + lossName);
-        }
+                // Forward pass over the parameter -> target slice
+                runSteps(plan_.steps);
 
-        torch::Tensor loss = env_.lookup(lossName);
-        if (config.verbose && epoch == 0) {
-            (*output_) << "Loss tensor requires_grad=" << loss.requires_grad()
-                      << ", has grad_fn=" << (loss.grad_fn() != nullptr) << std::endl;
-        }
+                if (!env_.has(targetName)) {
+                    throw std::runtime_error(label + " tensor not found: " + targetName);
+                }
 
-        if (loss.numel() > 1) {
-            loss = loss.sum();
-        }
+                torch::Tensor value = env_.lookup(targetName);
+                if (config.verbose && epoch == 0 && batch == 0) {
+                    (*output_) << label << " tensor requires_grad=" << value.requires_grad()
+                              << ", has grad_fn=" << (value.grad_fn() != nullptr) << std::endl;
+                }
 
-        // Backward pass
-        loss.backward();
+                if (value.numel() > 1) {
+                    value = value.sum();
+                }
 
-        // Update parameters
-        optimizer.step();
+                // Maximizing a reward is minimizing its negation
+                torch::Tensor loss = maximize ? -value : value;
+                loss.backward();
+
+                // Update every parameter at once through the flat buffer
+                optimizer->step();
+
+                if (config.verbose || profiler_) total += value.item<double>();
+            }
+            if (profiler_) {
+                profiler_->recordEpoch(targetName, epoch, batches, total, epochStart, std::chrono::steady_clock::now());
+            }
 
-        // Print progress
-        if (config.verbose && (epoch % (config.epochs / 10) == 0 || epoch == config.epochs - 1)) {
-            (*output_) << "Epoch " << epoch << "/" << config.epochs
-                      << " - Loss: " << loss.item<double>() << std::endl;
+            // Print progress (summed over the epoch's batches)
+            if (config.verbose && (epoch % report == 0 || epoch == config.epochs - 1)) {
+                (*output_) << "Epoch " << epoch << "/" << config.epochs
+                          << " - " << label << ": " << total << std::endl;
+            }
         }
+    } catch (...) {
+        restoreData();
+        parameters_->bindViews(env_, false);
+        throw;
     }
 
-    // Return final loss value
-    return env_.lookup(lossName).detach();
+    // Later statements read the trained values through detached aliases
+    parameters_->bindViews(env_, false);
+    {
+        torch::NoGradGuard noGrad;
+        if (loader) {
+            // Recompute the slice on the full data so the target covers every row
+            restoreData();
+            runSteps(plan_.steps);
+        }
+        runSteps(plan_.refresh);
+    }
+
+    // Return final target value
+    return env_.lookup(targetName).detach();
+}
+
+torch::Tensor LearningEngine::minimize(
+    const std::string& lossName,
+    const LearningConfig& config,
+    const Program& program
+) {
+    return train(lossName, config, program, false);
 }
 
 torch::Tensor LearningEngine::maximize(
@@ -268,53 +683,7 @@ torch::Tensor LearningEngine::maximize(
     const LearningConfig& config,
     const Program& program
 ) {
-    // Maximizing reward is equivalent to minimizing negative reward
-    // We'll temporarily negate the reward tensor
-
-    auto params = identifyLearnableParameters(program);
-    if (params.empty()) {
-        throw std::runtime_error("No learnable parameters found for maximization");
-    }
-
-    // Create parameter vector for optimizer with gradients enabled
-    std::vector<torch::Tensor> param_tensors;
-    for (const auto& name : params) {
-        param_tensors.push_back(env_.lookup(name).clone().detach().requires_grad_(true));
-    }
-
-    // Rebind the parameters with gradients enabled
-    size_t idx = 0;
-    for (const auto& name : params) {
-        env_.bind(name, param_tensors[idx++]);
-    }
-
-    torch::optim::SGD optimizer(param_tensors, torch::optim::SGDOptions(config.learningRate));
-
-    for (int epoch = 0; epoch < config.epochs; ++epoch) {
-        optimizer.zero_grad();
-        forwardPass(program);
-
-        if (!env_.has(rewardName)) {
-            throw std::runtime_error("Reward tensor not found: " + rewardName);
-        }
-
-        torch::Tensor reward = env_.lookup(rewardName);
-        if (reward.numel() > 1) {
-            reward = reward.sum();
-        }
-
-        // Negate for maximization
-        torch::Tensor loss = -reward;
-        loss.backward();
-        optimizer.step();
-
-        if (config.verbose && (epoch % (config.epochs / 10) == 0 || epoch == config.epochs - 1)) {
-            (*output_) << "Epoch " << epoch << "/" << config.epochs
-                      << " - Reward: " << reward.item<double>() << std::endl;
-        }
-    }
-
-    return env_.lookup(rewardName).detach();
+    return train(rewardName, config, program, true);
 }
 
 torch::Tensor LearningEngine::sample(
@@ -325,15 +694,11 @@ torch::Tensor LearningEngine::sample(
         throw std::runtime_error("Probability tensor not found: " + probName);
     }
 
-    torch::Tensor probs = env_.lookup(probName);
-
-    // Ensure probabilities sum to 1
-    probs = probs / probs.sum();
-
-    // Sample from the distribution
-    torch::Tensor samples = torch::multinomial(probs, config.sampleCount, true);
-
-    return samples;
+    SampleOptions options;
+    options.count = config.sampleCount;
+    options.seed = config.seed;
+    options.counts = config.sampleCounts;
+    return sampler_.sample(probName, env_.lookup(probName), options);
 }
 
 } // namespace tl
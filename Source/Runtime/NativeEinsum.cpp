@@ -0,0 +1,339 @@
+#include "TL/Runtime/NativeEinsum.hpp"
+#include <torch/torch.h>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
+
+namespace tl {
+
+    namespace {
+    std::atomic<bool> g_nativeEnabled{false};
+
+    // Kernels by source; nullptr records a kernel that could not be built
+    struct KernelCache {
+        std::mutex mutex;
+        std::unordered_map<std::string, NativeEinsum::Kernel> kernels;
+        std::filesystem::path dir;
+    };
+
+    KernelCache& kernelCache() {
+        static KernelCache cache;
+        return cache;
+    }
+
+    constexpr const char* kFlags = "-O3 -march=native -fopenmp-simd -shared -fPIC";
+
+    std::string compiler() {
+        const char* cxx = std::getenv("TL_CXX");
+        return cxx && *cxx ? cxx : "c++";
+    }
+
+    uint64_t fnv1a(const std::string& text) {
+        uint64_t h = 0xCBF29CE484222325ull;
+        for (const char c : text) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 0x100000001B3ull;
+        }
+        return h;
+    }
+
+    std::filesystem::path directoryOf(const std::filesystem::path& configured) {
+        if (!configured.empty()) return configured;
+        if (const char* env = std::getenv("TL_KERNEL_CACHE"); env && *env) return env;
+        // Per user, so nobody else can plant a library where we look for kernels
+        if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) return std::filesystem::path(xdg) / "tl_kernels";
+        if (const char* home = std::getenv("HOME"); home && *home) {
+            return std::filesystem::path(home) / ".cache" / "tl_kernels";
+        }
+        std::error_code ec;
+        const std::filesystem::path tmp = std::filesystem::temp_directory_path(ec);
+#ifndef _WIN32
+        const std::string user = "tl_kernels_" + std::to_string(::geteuid());
+#else
+        const std::string user = "tl_kernels";
+#endif
+        return (ec ? std::filesystem::path(".") : tmp) / user;
+    }
+
+    // Identifies the instruction set kernels are built for: -march=native
+    // binaries from another CPU may use instructions this one lacks
+    const std::string& hostId() {
+        static const std::string id = [] {
+            std::string text;
+#ifndef _WIN32
+            struct utsname host {};
+            if (::uname(&host) == 0) text += host.machine;
+#endif
+            std::ifstream cpuinfo("/proc/cpuinfo");
+            std::string line;
+            bool model = false, features = false;
+            while ((!model || !features) && std::getline(cpuinfo, line)) {
+                const std::string key = line.substr(0, line.find(':'));
+                const bool isModel = key.rfind("model name", 0) == 0 || key.rfind("CPU part", 0) == 0;
+                const bool isFeatures = key.rfind("flags", 0) == 0 || key.rfind("Features", 0) == 0;
+                if ((isModel && !model) || (isFeatures && !features)) text += "\n" + line;
+                model = model || isModel;
+                features = features || isFeatures;
+            }
+            return text;
+        }();
+        return id;
+    }
+
+#ifndef _WIN32
+    // Whether a path is ours alone to write: owned by this user, not a
+    // symlink, and not writable by group or others
+    bool privatePath(const std::filesystem::path& path) {
+        struct stat st {};
+        if (::lstat(path.c_str(), &st) != 0) return false;
+        if (!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode)) return false;
+        return st.st_uid == ::geteuid() && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+    }
+
+    // Creates the directory (mode 0700) if missing and checks it is private
+    bool privateDirectory(const std::filesystem::path& dir) {
+        std::error_code ec;
+        if (!std::filesystem::exists(dir, ec)) {
+            if (dir.has_parent_path()) std::filesystem::create_directories(dir.parent_path(), ec);
+            if (::mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) return false;
+        }
+        return privatePath(dir);
+    }
+#endif
+
+    // Compiles (or finds) the shared object of a kernel and loads it; nullptr on failure
+    NativeEinsum::Kernel build(const std::string& source, const std::filesystem::path& dir) {
+#ifndef _WIN32
+        // Whatever is in a directory others can write to could be anyone's code
+        if (!privateDirectory(dir)) return nullptr;
+        const std::string cxx = compiler();
+        char name[32];
+        std::snprintf(name, sizeof(name), "einsum_%016llx",
+                      static_cast<unsigned long long>(fnv1a(cxx + kFlags + hostId() + source)));
+        const std::filesystem::path library = dir / (std::string(name) + ".so");
+        std::error_code ec;
+        if (!std::filesystem::exists(library, ec)) {
+            // Build aside and rename, so concurrent processes never load a partial library
+            const std::string suffix = ".tmp" + std::to_string(::getpid());
+            const std::filesystem::path src = dir / (std::string(name) + suffix + ".cpp");
+            const std::filesystem::path tmp = dir / (std::string(name) + suffix + ".so");
+            {
+                std::ofstream ofs(src, std::ios::trunc);
+                if (!(ofs << source)) return nullptr;
+            }
+            const std::string command = cxx + " " + kFlags + " -o '" + tmp.string() + "' '" + src.string() +
+                                        "' > /dev/null 2>&1";
+            const bool built = std::system(command.c_str()) == 0;
+            std::filesystem::remove(src, ec);
+            if (!built) {
+                std::filesystem::remove(tmp, ec);
+                return nullptr;
+            }
+            std::filesystem::rename(tmp, library, ec);
+            if (ec) {
+                std::filesystem::remove(tmp, ec);
+                return nullptr;
+            }
+        }
+        if (!privatePath(library)) return nullptr;
+        // Loaded for the lifetime of the process
+        void* handle = ::dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) return nullptr;
+        return reinterpret_cast<NativeEinsum::Kernel>(::dlsym(handle, "tl_kernel"));
+#else
+        (void)source;
+        (void)dir;
+        return nullptr;
+#endif
+    }
+
+    // Row-major offset of an operand's element in terms of the loop variables
+    std::string offsetOf(const std::string& labels, const std::vector<int64_t>& shape) {
+        std::map<char, int64_t> strides;  // repeated labels (diagonals) add up
+        int64_t stride = 1;
+        for (size_t d = labels.size(); d-- > 0;) {
+            if (shape[d] > 1) strides[labels[d]] += stride;
+            stride *= shape[d];
+        }
+        std::string offset;
+        for (const auto& [label, s] : strides) {
+            if (!offset.empty()) offset += " + ";
+            offset += std::string("i_") + label + (s == 1 ? "" : " * " + std::to_string(s));
+        }
+        return offset.empty() ? "0" : offset;
+    }
+    }
+
+    std::optional<NativeEinsum> NativeEinsum::plan(const std::string& spec,
+                                                   const std::vector<std::vector<int64_t>>& shapes) {
+        std::string text;
+        for (char c : spec) {
+            if (c != ' ') text.push_back(c);
+        }
+        const size_t arrow = text.find("->");
+        if (arrow == std::string::npos) return std::nullopt;
+        std::vector<std::string> inputs;
+        const std::string lhs = text.substr(0, arrow);
+        for (size_t start = 0;;) {
+            const size_t comma = lhs.find(',', start);
+            inputs.push_back(lhs.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+            if (comma == std::string::npos) break;
+            start = comma + 1;
+        }
+        const std::string output = text.substr(arrow + 2);
+        if (inputs.size() != shapes.size()) return std::nullopt;
+
+        // Extent of every label; the order of first appearance fixes the loop order
+        std::map<char, int64_t> extents;
+        std::string order;
+        for (size_t k = 0; k < inputs.size(); ++k) {
+            if (inputs[k].size() != shapes[k].size()) return std::nullopt;
+            for (size_t d = 0; d < inputs[k].size(); ++d) {
+                const char label = inputs[k][d];
+                if (!std::isalpha(static_cast<unsigned char>(label))) return std::nullopt;
+                const auto [it, added] = extents.emplace(label, shapes[k][d]);
+                if (added) order.push_back(label);
+                else if (it->second != shapes[k][d]) return std::nullopt;
+            }
+        }
+        std::vector<int64_t> outputShape;
+        for (size_t d = 0; d < output.size(); ++d) {
+            const auto it = extents.find(output[d]);
+            if (it == extents.end() || output.find(output[d], d + 1) != std::string::npos) return std::nullopt;
+            outputShape.push_back(it->second);
+        }
+        int64_t points = 1;
+        for (const auto& kv : extents) {
+            points *= kv.second;
+            if (points > kMaxPoints) return std::nullopt;
+        }
+        if (points == 0) return std::nullopt;
+
+        std::string contracted;
+        for (char label : order) {
+            if (output.find(label) == std::string::npos) contracted.push_back(label);
+        }
+        std::string product;
+        for (size_t k = 0; k < inputs.size(); ++k) {
+            if (k > 0) product += " * ";
+            product += "t" + std::to_string(k) + "[" + offsetOf(inputs[k], shapes[k]) + "]";
+        }
+        const std::string outOffset = offsetOf(output, outputShape);
+
+        std::ostringstream src;
+        src << "// " << spec << "\n"
+            << "extern \"C\" void tl_kernel(const float* const* in, float* out) {\n";
+        for (size_t k = 0; k < inputs.size(); ++k) {
+            src << "    const float* __restrict__ t" << k << " = in[" << k << "];\n";
+        }
+        std::string indent = "    ";
+        auto loop = [&](char label) {
+            src << indent << "for (long i_" << label << " = 0; i_" << label << " < " << extents[label]
+                << "; ++i_" << label << ") {\n";
+            indent += "    ";
+        };
+        for (size_t d = 0; d + (contracted.empty() ? 1 : 0) < output.size(); ++d) loop(output[d]);
+        if (contracted.empty()) {
+            if (!output.empty()) {
+                src << indent << "#pragma omp simd\n";
+                loop(output.back());
+            }
+            src << indent << "out[" << outOffset << "] = " << product << ";\n";
+        } else {
+            src << indent << "float acc = 0.0f;\n";
+            const std::string accIndent = indent;
+            for (size_t c = 0; c < contracted.size(); ++c) {
+                if (c + 1 == contracted.size()) src << indent << "#pragma omp simd reduction(+:acc)\n";
+                loop(contracted[c]);
+            }
+            src << indent << "acc += " << product << ";\n";
+            for (size_t c = 0; c < contracted.size(); ++c) {
+                indent.resize(indent.size() - 4);
+                src << indent << "}\n";
+            }
+            src << accIndent << "out[" << outOffset << "] = acc;\n";
+        }
+        while (indent.size() > 4) {
+            indent.resize(indent.size() - 4);
+            src << indent << "}\n";
+        }
+        src << "}\n";
+
+        NativeEinsum kernel;
+        kernel.source_ = src.str();
+        kernel.output_shape_ = std::move(outputShape);
+        return kernel;
+    }
+
+    Tensor NativeEinsum::run(const std::string& spec, const std::vector<Tensor>& operands) {
+        if (!enabled() || operands.empty()) return {};
+        std::vector<std::vector<int64_t>> shapes;
+        shapes.reserve(operands.size());
+        for (const auto& t : operands) {
+            if (!t.defined() || t.is_sparse() || !t.device().is_cpu() || t.scalar_type() != torch::kFloat32 ||
+                (t.requires_grad() && torch::GradMode::is_enabled())) {
+                return {};
+            }
+            shapes.push_back(t.sizes().vec());
+        }
+        const auto kernel = plan(spec, shapes);
+        if (!kernel) return {};
+
+        Kernel fn = nullptr;
+        {
+            KernelCache& cache = kernelCache();
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            auto it = cache.kernels.find(kernel->source());
+            if (it == cache.kernels.end()) {
+                it = cache.kernels.emplace(kernel->source(), build(kernel->source(), directoryOf(cache.dir))).first;
+            }
+            fn = it->second;
+        }
+        if (!fn) return {};
+
+        std::vector<Tensor> contiguous;
+        std::vector<const float*> data;
+        contiguous.reserve(operands.size());
+        data.reserve(operands.size());
+        for (const auto& t : operands) {
+            contiguous.push_back(t.is_contiguous() ? t : t.contiguous());
+            data.push_back(contiguous.back().data_ptr<float>());
+        }
+        Tensor result = torch::empty(kernel->outputShape(), torch::kFloat32);
+        fn(data.data(), result.data_ptr<float>());
+        return result;
+    }
+
+    void NativeEinsum::setEnabled(bool enabled) { g_nativeEnabled.store(enabled, std::memory_order_relaxed); }
+
+    bool NativeEinsum::enabled() { return g_nativeEnabled.load(std::memory_order_relaxed); }
+
+    void NativeEinsum::setCacheDirectory(const std::filesystem::path& dir) {
+        KernelCache& cache = kernelCache();
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.dir = dir;
+    }
+
+    std::filesystem::path NativeEinsum::cacheDirectory() {
+        KernelCache& cache = kernelCache();
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        return directoryOf(cache.dir);
+    }
+
+} // namespace tl
@@ -0,0 +1,112 @@
+#include "TL/Runtime/NormalizationFusion.hpp"
+#include <torch/torch.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace tl {
+
+    namespace {
+    std::atomic<bool> g_normalizationFusionEnabled{true};
+
+    // Elements of a row, or neighbouring rows, handled together; small enough to stay in cache
+    constexpr int64_t kBlock = 256;
+    // Rows are split across threads once a task covers at least this many elements
+    constexpr int64_t kParallelGrain = 32768;
+    constexpr float kNegInf = -std::numeric_limits<float>::infinity();
+
+    // Softmax of n contiguous elements; y may be x
+    void softmaxRow(const float* x, float* y, int64_t n) {
+        float max = kNegInf;
+        float sum = 0.0f;
+        for (int64_t c = 0; c < n; c += kBlock) {
+            const int64_t w = std::min(kBlock, n - c);
+            float blockMax = kNegInf;
+            for (int64_t i = 0; i < w; ++i) blockMax = std::max(blockMax, x[c + i]);
+            if (blockMax > max) {
+                sum *= std::exp(max - blockMax);
+                max = blockMax;
+            }
+            float blockSum = 0.0f;
+            if (max == kNegInf) {
+                // Nothing finite yet: -inf adds nothing, NaN poisons the row as in torch
+                for (int64_t i = 0; i < w; ++i) blockSum += x[c + i] == kNegInf ? 0.0f : std::exp(x[c + i] - max);
+            } else {
+                for (int64_t i = 0; i < w; ++i) blockSum += std::exp(x[c + i] - max);
+            }
+            sum += blockSum;
+        }
+        const float inv = 1.0f / sum;
+        for (int64_t i = 0; i < n; ++i) y[i] = std::exp(x[i] - max) * inv;
+    }
+
+    // Softmax of w neighbouring rows whose n elements lie `stride` apart; y may be x
+    void softmaxRows(const float* x, float* y, int64_t n, int64_t stride, int64_t w, float* max, float* sum) {
+        std::fill(max, max + w, kNegInf);
+        std::fill(sum, sum + w, 0.0f);
+        for (int64_t k = 0; k < n; ++k) {
+            const float* row = x + k * stride;
+            for (int64_t j = 0; j < w; ++j) {
+                const float v = row[j];
+                if (v > max[j]) {
+                    sum[j] = sum[j] * std::exp(max[j] - v) + 1.0f;
+                    max[j] = v;
+                } else if (v != kNegInf) {
+                    sum[j] += std::exp(v - max[j]);
+                }
+            }
+        }
+        for (int64_t j = 0; j < w; ++j) sum[j] = 1.0f / sum[j];
+        for (int64_t k = 0; k < n; ++k) {
+            const float* row = x + k * stride;
+            float* out = y + k * stride;
+            for (int64_t j = 0; j < w; ++j) out[j] = std::exp(row[j] - max[j]) * sum[j];
+        }
+    }
+    }
+
+    Tensor FusedNormalization::softmax(const Tensor& values, int64_t dim, bool owned) {
+        if (!enabled() || !values.defined() || values.dim() == 0 || values.is_sparse() || !values.device().is_cpu() ||
+            values.scalar_type() != torch::kFloat32 || values.requires_grad()) {
+            return torch::softmax(values, dim);
+        }
+        if (dim < 0) dim += values.dim();
+        // A contiguous copy is ours to overwrite as well
+        const bool copied = !values.is_contiguous();
+        Tensor src = copied ? values.contiguous() : values;
+        Tensor out = copied || owned ? src : torch::empty_like(src);
+        if (src.numel() == 0) return out;
+
+        const int64_t n = src.size(dim);
+        int64_t inner = 1;
+        for (int64_t d = dim + 1; d < src.dim(); ++d) inner *= src.size(d);
+        const int64_t outer = src.numel() / (n * inner);
+        const float* x = src.data_ptr<float>();
+        float* y = out.data_ptr<float>();
+
+        if (inner == 1) {
+            at::parallel_for(0, outer, std::max<int64_t>(1, kParallelGrain / n), [&](int64_t begin, int64_t end) {
+                for (int64_t o = begin; o < end; ++o) softmaxRow(x + o * n, y + o * n, n);
+            });
+            return out;
+        }
+        const int64_t blocks = (inner + kBlock - 1) / kBlock;
+        at::parallel_for(0, outer * blocks, std::max<int64_t>(1, kParallelGrain / (n * kBlock)),
+                         [&](int64_t begin, int64_t end) {
+                             std::vector<float> max(kBlock), sum(kBlock);
+                             for (int64_t t = begin; t < end; ++t) {
+                                 const int64_t first = (t % blocks) * kBlock;
+                                 const int64_t offset = (t / blocks) * n * inner + first;
+                                 softmaxRows(x + offset, y + offset, n, inner, std::min(kBlock, inner - first),
+                                             max.data(), sum.data());
+                             }
+                         });
+        return out;
+    }
+
+    void FusedNormalization::setEnabled(bool enabled) { g_normalizationFusionEnabled.store(enabled); }
+    bool FusedNormalization::enabled() { return g_normalizationFusionEnabled.load(); }
+
+} // namespace tl
@@ -0,0 +1,309 @@
+#include "TL/Runtime/PartitionedDatalog.hpp"
+#include "TL/Runtime/DatalogEngine.hpp"
+#include "TL/Runtime/ThreadPool.hpp"
+#include "TL/vm.hpp"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+namespace tl {
+
+using TupleBatch = PartitionedDatalog::TupleBatch;
+
+// Copy of a relation partitioned on one column. '#' cannot appear in
+// identifiers, so the name does not clash with a program relation.
+static std::string partitionedName(const std::string& relation, size_t column) {
+    return relation + "#" + std::to_string(column);
+}
+
+// First column of an atom holding variable `name`, or npos
+static size_t columnOf(const DatalogAtom& atom, const std::string& name) {
+    for (size_t i = 0; i < atom.terms.size(); ++i) {
+        const auto* id = std::get_if<Identifier>(&atom.terms[i]);
+        if (id && id->name == name) return i;
+    }
+    return std::string::npos;
+}
+
+// Partition owning a key value. Symbols of the shared dictionary hash by
+// ID and later ones by text, so every worker agrees on both.
+static size_t ownerOf(SymbolId id, const SymbolTable& symbols, size_t dictionarySize, size_t partitions) {
+    const uint64_t hash = id < dictionarySize ? (uint64_t{id} * 0x9E3779B97F4A7C15ull) >> 32
+                                              : std::hash<std::string>{}(symbols.name(id));
+    return static_cast<size_t>(hash % partitions);
+}
+
+// Batch under construction; symbols outside the dictionary are spelled out once
+struct BatchBuilder {
+    BatchBuilder(const std::string& relation, size_t arity) {
+        batch.relation = relation;
+        batch.columns.resize(arity);
+    }
+
+    void append(const SymbolId* tuple, const SymbolTable& symbols, size_t dictionarySize) {
+        for (size_t c = 0; c < batch.columns.size(); ++c) {
+            SymbolId id = tuple[c];
+            if (id >= dictionarySize) {
+                const auto tagged = PartitionedDatalog::kLocalSymbol | static_cast<SymbolId>(batch.symbols.size());
+                const auto [it, added] = spelled.emplace(id, tagged);
+                if (added) batch.symbols.push_back(symbols.name(id));
+                id = it->second;
+            }
+            batch.columns[c].push_back(id);
+        }
+        ++batch.rows;
+    }
+
+    TupleBatch batch;
+    std::unordered_map<SymbolId, SymbolId> spelled;  // local ID -> tagged ID
+};
+
+// Rows [begin, size) of a relation, split by the owner of their key column
+// into batches for `target`, appended to outbox[owner]
+static void ship(const Relation& relation, size_t begin, const std::string& target, size_t column,
+                 const SymbolTable& symbols, size_t dictionarySize,
+                 std::vector<std::vector<TupleBatch>>& outbox) {
+    if (begin >= relation.size()) return;
+    const size_t partitions = outbox.size();
+    std::vector<BatchBuilder> builders(partitions, BatchBuilder(target, relation.arity()));
+    for (size_t r = begin; r < relation.size(); ++r) {
+        const SymbolId* tuple = relation.row(r);
+        builders[ownerOf(tuple[column], symbols, dictionarySize, partitions)].append(tuple, symbols, dictionarySize);
+    }
+    for (size_t p = 0; p < partitions; ++p) {
+        if (builders[p].batch.rows > 0) outbox[p].push_back(std::move(builders[p].batch));
+    }
+}
+
+// Row-major tuples of a batch in `symbols`, interning the spelled-out ones
+static std::vector<SymbolId> unpack(const TupleBatch& batch, SymbolTable& symbols) {
+    std::vector<SymbolId> spelled;
+    spelled.reserve(batch.symbols.size());
+    for (const auto& text : batch.symbols) spelled.push_back(symbols.intern(text));
+    const size_t arity = batch.columns.size();
+    std::vector<SymbolId> tuples(batch.rows * arity);
+    for (size_t c = 0; c < arity; ++c) {
+        for (size_t r = 0; r < batch.rows; ++r) {
+            const SymbolId id = batch.columns[c][r];
+            tuples[r * arity + c] = (id & PartitionedDatalog::kLocalSymbol) != 0
+                                        ? spelled[id & ~PartitionedDatalog::kLocalSymbol]
+                                        : id;
+        }
+    }
+    return tuples;
+}
+
+/**
+ * @brief One partition: its copies of the relations, the facts it derived and its engine
+ *
+ * The worker's symbol table extends the shared dictionary, which it only
+ * reads, with the symbols it interns itself.
+ *
+ * Derived facts are kept under the head's own name, the partitioned
+ * copies under partitionedName(), so the engine sees no recursion and
+ * applies each rule once per saturate(), to the tuples received since.
+ */
+class PartitionedDatalog::Worker {
+public:
+    Worker(const SymbolTable& dictionary, size_t partitions)
+        : engine_(env_)
+        , dictionary_size_(dictionary.size())
+        , partitions_(partitions) {
+        env_.symbols() = SymbolTable::extending(dictionary);
+        // Workers already run in parallel with each other
+        engine_.setNumThreads(1);
+    }
+
+    void addRule(const DatalogRule& rule) { engine_.addRule(rule); }
+
+    void saturate() { engine_.saturate(); }
+
+    /// Store a batch; returns the number of tuples that were new
+    size_t receive(const TupleBatch& batch) {
+        const std::vector<SymbolId> tuples = unpack(batch, env_.symbols());
+        return engine_.addFacts(batch.relation, batch.columns.size(), tuples.data(), batch.rows);
+    }
+
+    /// Facts derived since the last drain, addressed to the partitions owning their keys
+    std::vector<std::vector<TupleBatch>> drain(const std::vector<std::string>& heads,
+                                               const std::unordered_map<std::string, std::vector<size_t>>& keyColumns) {
+        std::vector<std::vector<TupleBatch>> outbox(partitions_);
+        for (const auto& name : heads) {
+            const Relation* derived = env_.relation(name);
+            const auto keys = keyColumns.find(name);
+            if (!derived || keys == keyColumns.end()) continue;
+            size_t& drained = drained_[name];
+            for (size_t column : keys->second) {
+                if (column < derived->arity()) {
+                    ship(*derived, drained, partitionedName(name, column), column, env_.symbols(), dictionary_size_,
+                         outbox);
+                }
+            }
+            drained = derived->size();
+        }
+        return outbox;
+    }
+
+    /// Every fact this partition derived, one batch per relation
+    std::vector<TupleBatch> collect(const std::vector<std::string>& heads) const {
+        std::vector<TupleBatch> batches;
+        for (const auto& name : heads) {
+            const Relation* derived = env_.relation(name);
+            if (!derived || derived->empty()) continue;
+            BatchBuilder builder(name, derived->arity());
+            for (size_t r = 0; r < derived->size(); ++r) {
+                builder.append(derived->row(r), env_.symbols(), dictionary_size_);
+            }
+            batches.push_back(std::move(builder.batch));
+        }
+        return batches;
+    }
+
+private:
+    Environment env_;
+    DatalogEngine engine_;
+    size_t dictionary_size_;
+    size_t partitions_;
+    std::unordered_map<std::string, size_t> drained_;  // rows shipped per derived relation
+};
+
+// Positive body atoms in source order, then negated ones; Rule may be const
+template <typename Rule, typename Atom = std::conditional_t<std::is_const_v<Rule>, const DatalogAtom, DatalogAtom>>
+static std::vector<Atom*> bodyAtoms(Rule& rule, size_t& positives) {
+    std::vector<Atom*> atoms;
+    positives = 0;
+    for (auto& el : rule.body) {
+        if (auto* a = std::get_if<DatalogAtom>(&el)) {
+            atoms.insert(atoms.begin() + static_cast<std::ptrdiff_t>(positives++), a);
+        } else if (auto* n = std::get_if<DatalogNegation>(&el)) {
+            atoms.push_back(&n->atom);
+        }
+    }
+    return atoms;
+}
+
+// The join key is the first variable of the first atom that every atom holds
+template <typename Atom>
+static std::string joinKey(const std::vector<Atom*>& atoms, size_t positives) {
+    if (positives == 0) return {};
+    for (const auto& term : atoms.front()->terms) {
+        const auto* id = std::get_if<Identifier>(&term);
+        if (id && std::all_of(atoms.begin(), atoms.end(), [&](const DatalogAtom* a) {
+                return columnOf(*a, id->name) != std::string::npos;
+            })) {
+            return id->name;
+        }
+    }
+    return {};
+}
+
+bool PartitionedDatalog::partitionable(const DatalogRule& rule) {
+    size_t positives = 0;
+    const auto atoms = bodyAtoms(rule, positives);
+    return !joinKey(atoms, positives).empty();
+}
+
+PartitionedDatalog::PartitionedDatalog(std::vector<DatalogRule> rules,
+                                       std::vector<std::vector<size_t>> strata,
+                                       size_t partitions)
+    : rules_(std::move(rules))
+    , strata_(std::move(strata))
+    , partitions_(std::max<size_t>(partitions, 1)) {
+    for (const auto& stratum : strata_) {
+        for (size_t r : stratum) {
+            DatalogRule& rule = rules_.at(r);
+            const std::string& head = rule.head.relation.name;
+            if (std::find(heads_.begin(), heads_.end(), head) == heads_.end()) heads_.push_back(head);
+
+            size_t positives = 0;
+            const auto atoms = bodyAtoms(rule, positives);
+            const std::string key = joinKey(atoms, positives);
+            if (key.empty()) {
+                throw std::runtime_error("Cannot partition the rule " + toString(Statement{rule}) +
+                                         ": its body atoms share no variable");
+            }
+            for (DatalogAtom* atom : atoms) {
+                const size_t column = columnOf(*atom, key);
+                auto& columns = key_columns_[atom->relation.name];
+                if (std::find(columns.begin(), columns.end(), column) == columns.end()) {
+                    columns.push_back(column);
+                    keys_.emplace_back(atom->relation.name, column);
+                }
+                atom->relation.name = partitionedName(atom->relation.name, column);
+            }
+        }
+    }
+}
+
+size_t PartitionedDatalog::run(Environment& env, ThreadPool* pool) {
+    rounds_ = 0;
+    shuffled_ = 0;
+    const SymbolTable& dictionary = env.symbols();
+    std::vector<std::unique_ptr<Worker>> workers;
+    workers.reserve(partitions_);
+    for (size_t p = 0; p < partitions_; ++p) workers.push_back(std::make_unique<Worker>(dictionary, partitions_));
+    auto forEachWorker = [&](const std::function<void(size_t)>& fn) {
+        if (pool && partitions_ > 1) {
+            pool->parallelFor(partitions_, fn);
+        } else {
+            for (size_t p = 0; p < partitions_; ++p) fn(p);
+        }
+    };
+
+    // Stored facts go to the partitions of every key they are read on
+    std::vector<std::vector<TupleBatch>> inbox(partitions_);
+    for (const auto& key : keys_) {
+        const Relation* stored = env.relation(key.first);
+        if (stored && key.second < stored->arity()) {
+            ship(*stored, 0, partitionedName(key.first, key.second), key.second, dictionary, dictionary.size(), inbox);
+        }
+    }
+    forEachWorker([&](size_t p) {
+        for (const auto& batch : inbox[p]) workers[p]->receive(batch);
+    });
+    inbox.clear();
+
+    for (const auto& stratum : strata_) {
+        for (auto& worker : workers) {
+            for (size_t r : stratum) worker->addRule(rules_[r]);
+        }
+        size_t delivered = 0;
+        do {
+            ++rounds_;
+            // outboxes[from][to]
+            std::vector<std::vector<std::vector<TupleBatch>>> outboxes(partitions_);
+            forEachWorker([&](size_t p) {
+                workers[p]->saturate();
+                outboxes[p] = workers[p]->drain(heads_, key_columns_);
+            });
+            // Barrier: every outbox is complete before any partition reads its inbox
+            std::vector<size_t> received(partitions_, 0);
+            forEachWorker([&](size_t p) {
+                for (size_t from = 0; from < partitions_; ++from) {
+                    for (const auto& batch : outboxes[from][p]) received[p] += workers[p]->receive(batch);
+                }
+            });
+            delivered = 0;
+            for (size_t p = 0; p < partitions_; ++p) {
+                delivered += received[p];
+                for (size_t to = 0; to < partitions_; ++to) {
+                    if (to == p) continue;
+                    for (const auto& batch : outboxes[p][to]) shuffled_ += batch.rows;
+                }
+            }
+        } while (delivered > 0);
+    }
+
+    size_t added = 0;
+    for (const auto& worker : workers) {
+        for (const auto& batch : worker->collect(heads_)) {
+            const std::vector<SymbolId> tuples = unpack(batch, env.symbols());
+            added += env.addFacts(batch.relation, batch.columns.size(), tuples.data(), batch.rows);
+        }
+    }
+    return added;
+}
+
+} // namespace tl
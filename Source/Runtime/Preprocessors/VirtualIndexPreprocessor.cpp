@@ -1,4 +1,5 @@
 #include "TL/Runtime/Preprocessors/VirtualIndexPreprocessor.hpp"
+#include "TL/Log.hpp"
 #include "TL/vm.hpp"
 #include <torch/torch.h>
 #include <set>
@@ -454,13 +455,49 @@ ExprPtr substituteIndicesInExprSSA(const ExprPtr& expr,
     return sub.visit(*expr);
 }
 
-} // anonymous namespace
+// Virtual indices of a tensor reference as (name, offset) pairs
+std::vector<std::pair<std::string, int>> virtualIndicesOf(const TensorRef& ref) {
+    std::vector<std::pair<std::string, int>> result;
+    for (const auto& ios : ref.indices) {
+        if (const auto* idx = std::get_if<Index>(&ios.value)) {
+            if (const auto* vid = std::get_if<VirtualIndex>(&idx->value)) {
+                result.push_back({vid->name.name, vid->offset});
+            }
+        }
+    }
+    return result;
+}
 
-std::vector<Statement> VirtualIndexPreprocessor::preprocessBatch(const std::vector<Statement>& statements, Environment& env) {
-    // Group statements by virtual index variable
-    std::map<std::string, std::vector<VirtualEqInfo>> groupsByVirtualIndex;
+// Between steps only the latest value of a state is kept (slot 0 of the
+// expansion), so a read further back than the step before the one written,
+// such as State[*t-1] in State[*t+1] = ..., has no value to read and is
+// rejected rather than aliased to State[*t]
+void rejectDeepLags(const std::string& index, const std::vector<VirtualEqInfo>& eqInfos) {
+    std::map<std::string, int> written;  // state tensor -> LHS offset
+    for (const auto& info : eqInfos) {
+        if (!info.isRhsOnly) written[info.lhsTensorName] = info.lhsVirtualOffset;
+    }
+    for (const auto& info : eqInfos) {
+        for (const auto& [key, offsets] : info.rhsVirtualRefs) {
+            const auto& [tensorName, virtualName] = key;
+            auto it = written.find(tensorName);
+            if (virtualName != index || it == written.end()) continue;
+            for (int offset : offsets) {
+                if (it->second - offset <= 1) continue;
+                const std::string ref = tensorName + "[*" + index + (offset < 0 ? "" : "+") + std::to_string(offset) + "]";
+                throw std::runtime_error("Virtual index reference " + ref + " reads " +
+                                         std::to_string(it->second - offset) +
+                                         " steps back; recurrences keep only the previous step");
+            }
+        }
+    }
+}
 
-    bool debug = std::getenv("TL_DEBUG") != nullptr;
+// Group the equations of a batch by virtual index. Equations with virtual
+// indices only on the RHS join the group of each virtual index they read.
+std::map<std::string, std::vector<VirtualEqInfo>> groupByVirtualIndex(const std::vector<Statement>& statements,
+                                                                       bool debug) {
+    std::map<std::string, std::vector<VirtualEqInfo>> groupsByVirtualIndex;
 
     if (debug) {
         std::cerr << "[VirtualIndexPreprocessor] Processing " << statements.size() << " statements\n";
@@ -472,7 +509,7 @@ std::vector<Statement> VirtualIndexPreprocessor::preprocessBatch(const std::vect
         }
         const auto& eq = std::get<TensorEquation>(st);
 
-        auto lhsVirtuals = findVirtualIndices(eq.lhs);
+        auto lhsVirtuals = virtualIndicesOf(eq.lhs);
         auto rhsV = collectRhsVirtualIndices(eq);
 
         if (debug) {
@@ -497,8 +534,11 @@ std::vector<Statement> VirtualIndexPreprocessor::preprocessBatch(const std::vect
                 std::cerr << "[VirtualIndexPreprocessor]     -> RHS-only equation, LHS base name: " << baseLhsName << "\n";
             }
 
+            std::set<std::string> joined;
             for (const auto& [key, offsets] : rhsV) {
                 const auto& [tensorName, virtualName] = key;
+                // Once per group, however many of its tensors the equation reads
+                if (!joined.insert(virtualName).second) continue;
                 VirtualEqInfo info{eq, baseLhsName, -1, rhsV, true};
                 groupsByVirtualIndex[virtualName].push_back(info);
 
@@ -530,6 +570,310 @@ std::vector<Statement> VirtualIndexPreprocessor::preprocessBatch(const std::vect
         groupsByVirtualIndex[virtualIndexName].push_back(info);
     }
 
+    for (const auto& [virtualIndexName, eqInfos] : groupsByVirtualIndex) rejectDeepLags(virtualIndexName, eqInfos);
+    return groupsByVirtualIndex;
+}
+
+// Index list with the virtual indices removed (temporaries have no time axis)
+std::vector<IndexOrSlice> withoutVirtualIndices(const std::vector<IndexOrSlice>& indices) {
+    std::vector<IndexOrSlice> result;
+    for (const auto& ios : indices) {
+        if (const auto* idx = std::get_if<Index>(&ios.value)) {
+            if (std::holds_alternative<VirtualIndex>(idx->value)) continue;
+        }
+        result.push_back(ios);
+    }
+    return result;
+}
+
+// State[i, 0] = tempName[i]: copies a temporary back to slot 0 of the
+// tensor written by eq (main tensors keep the virtual dimension)
+TensorEquation copyBackEquation(const TensorEquation& eq, const std::string& tempName) {
+    TensorEquation copyEq;
+    copyEq.projection = eq.projection;
+    copyEq.loc = eq.loc;
+
+    copyEq.lhs = eq.lhs;
+    for (auto& ios : copyEq.lhs.indices) {
+        if (auto* idx = std::get_if<Index>(&ios.value)) {
+            if (std::holds_alternative<VirtualIndex>(idx->value)) {
+                NumberLiteral num;
+                num.text = "0";
+                num.loc = ios.loc;
+                idx->value = num;
+            }
+        }
+    }
+
+    auto rhsRef = std::make_shared<Expr>();
+    rhsRef->loc = eq.lhs.loc;
+    TensorRef readRef = eq.lhs;
+    readRef.name.name = tempName;
+    readRef.indices = withoutVirtualIndices(readRef.indices);
+    rhsRef->node = ExprTensorRef{readRef};
+
+    GuardedClause copyClause;
+    copyClause.expr = rhsRef;
+    copyEq.clauses.push_back(copyClause);
+    return copyEq;
+}
+
+// Rewrites the references of a recurrence body to the per-step names of
+// Recurrence (see VirtualIndexPreprocessor.hpp). Anything the names cannot
+// express clears `supported`.
+struct RecurrenceRewriter {
+    const std::string& index;
+    const Environment& env;
+    Recurrence& rec;
+    const std::map<std::string, int>& stateOf;   // state tensor -> index into rec.states
+    const std::map<std::string, int>& stepOf;    // every tensor the group writes -> index into rec.steps
+    const std::set<std::string>& hoisted;        // tensors computed before the loop, see InputHoister
+    Recurrence::Step* step{nullptr};              // step being rewritten, receives its reads
+    int current{0};                              // its index into rec.steps
+    bool supported{true};
+
+    // Reads of this step's value need a producer earlier in the body
+    std::string read(const std::string& name, int lag, const std::string& as) {
+        const int source = stepOf.at(name);
+        if (lag == 0 && source >= current) supported = false;
+        const bool known = std::any_of(step->reads.begin(), step->reads.end(),
+                                       [&](const Recurrence::Read& r) { return r.name == as; });
+        if (!known) step->reads.push_back({source, lag, as});
+        return as;
+    }
+
+    TensorRef lowerRef(const TensorRef& ref) {
+        const std::string& name = ref.name.name;
+        TensorRef result = ref;
+        result.indices.clear();
+        std::optional<int> offset;
+        int drivers = 0;
+        int64_t driverDim = -1;
+        for (size_t d = 0; d < ref.indices.size(); ++d) {
+            const auto& ios = ref.indices[d];
+            if (const auto* idx = std::get_if<Index>(&ios.value)) {
+                if (const auto* vid = std::get_if<VirtualIndex>(&idx->value); vid && vid->name.name == index) {
+                    if (offset) supported = false;
+                    offset = vid->offset;
+                    continue;
+                }
+                if (const auto* id = std::get_if<Identifier>(&idx->value); id && id->name == index) {
+                    ++drivers;
+                    driverDim = static_cast<int64_t>(d);
+                    continue;
+                }
+            }
+            result.indices.push_back(ios);
+        }
+
+        if (offset) {
+            auto it = stateOf.find(name);
+            if (drivers > 0 || (it == stateOf.end() && stepOf.count(name))) {
+                supported = false;
+                return ref;
+            }
+            if (it == stateOf.end()) {
+                // Not written by the group: slot 0, as in the unrolled expansion
+                return substituteIndicesSSA(ref, {}, index, {}, false);
+            }
+            auto& state = rec.states[it->second];
+            const int lag = state.offset - *offset;
+            if (lag < 0 || (lag > 0 && !env.has(name))) {
+                supported = false;
+                return ref;
+            }
+            result.name.name = read(name, lag, lag == 0 ? name + "$next" : name + "$lag" + std::to_string(lag));
+            return result;
+        }
+
+        // Out[i, t] of an RHS-only equation is its value at this step; other
+        // plain reads of group outputs would see values not written back yet
+        if (auto it = stepOf.find(name); it != stepOf.end()) {
+            const Recurrence::Step* producer = it->second < current ? &rec.steps[it->second] : nullptr;
+            if (drivers != 1 || !producer || producer->state >= 0 || producer->axis != driverDim) {
+                supported = false;
+                return ref;
+            }
+            result.name.name = read(name, 0, name + "$step");
+            return result;
+        }
+        if (drivers == 0) return ref;
+        if (drivers > 1 || (!hoisted.count(name) && !env.has(name))) {
+            supported = false;
+            return ref;
+        }
+        // Hoisted tensors span t as far as their inputs, which were checked
+        if (!hoisted.count(name)) {
+            const Tensor& source = env.lookup(name);
+            if (driverDim >= source.dim() || source.size(driverDim) < rec.iterations) {
+                supported = false;
+                return ref;
+            }
+        }
+        result.name.name = name + "$" + index + std::to_string(driverDim);
+        auto view = std::find_if(rec.views.begin(), rec.views.end(),
+                                 [&](const Recurrence::View& v) { return v.name == result.name.name; });
+        const size_t viewIndex = static_cast<size_t>(view - rec.views.begin());
+        if (view == rec.views.end()) rec.views.push_back({result.name.name, name, driverDim});
+        if (std::find(step->views.begin(), step->views.end(), viewIndex) == step->views.end()) {
+            step->views.push_back(viewIndex);
+        }
+        return result;
+    }
+
+    ExprPtr lower(const ExprPtr& expr) {
+        auto result = std::make_shared<Expr>(*expr);
+        std::visit([this](auto& node) { (*this)(node); }, result->node);
+        return result;
+    }
+
+    void operator()(ExprTensorRef& ref) { ref.ref = lowerRef(ref.ref); }
+    void operator()(ExprNumber&) {}
+    void operator()(ExprString&) {}
+    void operator()(ExprList& lst) {
+        for (auto& e : lst.elements) e = lower(e);
+    }
+    void operator()(ExprParen& p) { p.inner = lower(p.inner); }
+    void operator()(ExprCall& c) {
+        for (auto& arg : c.args) arg = lower(arg);
+    }
+    void operator()(ExprBinary& b) {
+        b.lhs = lower(b.lhs);
+        b.rhs = lower(b.rhs);
+    }
+    void operator()(ExprUnary& u) { u.operand = lower(u.operand); }
+};
+
+// Moves products that do not depend on the recurrence, such as
+// U[i, k] Input[k, t], out of the step body: each becomes an equation over
+// the whole time axis, Gate$in0[i, t] = U[i, k] Input[k, t], run once
+// before the loop as one contraction, and the body reads its slice at t.
+// Only whole product chains move, since a factor shared with the rest of a
+// chain could share its summed indices.
+struct InputHoister {
+    const std::string& index;
+    const Environment& env;
+    const std::map<std::string, int>& stepOf;
+    Recurrence& rec;
+    std::map<std::string, std::string> names;  // hoisted term -> tensor name
+    std::set<std::string> tensors;              // every hoisted tensor
+    std::string prefix;                         // LHS tensor of the equation being rewritten
+    std::vector<Identifier> context;            // its LHS indices without t or the virtual index
+
+    // Factors of a product chain; false if one of them is not a tensor reference
+    static bool factors(const ExprPtr& e, std::vector<const TensorRef*>& out, std::vector<ExprPtr>& others) {
+        if (const auto* b = std::get_if<ExprBinary>(&e->node); b && b->op == ExprBinary::Op::Mul) {
+            const bool lhs = factors(b->lhs, out, others);
+            const bool rhs = factors(b->rhs, out, others);
+            return lhs && rhs;
+        }
+        if (const auto* p = std::get_if<ExprParen>(&e->node)) return factors(p->inner, out, others);
+        if (const auto* r = std::get_if<ExprTensorRef>(&e->node)) {
+            out.push_back(&r->ref);
+            return true;
+        }
+        others.push_back(e);
+        return false;
+    }
+
+    bool independent(const std::vector<const TensorRef*>& refs) const {
+        if (refs.size() < 2) return false;
+        std::set<std::string> used;
+        bool timed = false;
+        for (const TensorRef* ref : refs) {
+            if (stepOf.count(ref->name.name) || !env.has(ref->name.name)) return false;
+            int drivers = 0;
+            for (size_t d = 0; d < ref->indices.size(); ++d) {
+                const auto* idx = std::get_if<Index>(&ref->indices[d].value);
+                if (!idx || idx->normalized || std::holds_alternative<VirtualIndex>(idx->value)) return false;
+                const auto* id = std::get_if<Identifier>(&idx->value);
+                if (!id) continue;
+                used.insert(id->name);
+                if (id->name != index) continue;
+                ++drivers;
+                const Tensor& source = env.lookup(ref->name.name);
+                if (static_cast<int64_t>(d) >= source.dim() || source.size(d) < rec.iterations) return false;
+            }
+            if (drivers > 1) return false;
+            timed = timed || drivers == 1;
+        }
+        // The slice at t must have the shape the product has in the body
+        for (const auto& id : context) {
+            if (!used.count(id.name)) return false;
+        }
+        return timed;
+    }
+
+    ExprPtr hoist(const ExprPtr& chain) {
+        TensorRef target;
+        for (const auto& id : context) target.indices.push_back(IndexOrSlice{Index{id}});
+        target.indices.push_back(IndexOrSlice{Index{Identifier{index}}});
+        const std::string key = toString(*chain) + toString(target);
+        auto [it, fresh] = names.emplace(key, prefix + "$in" + std::to_string(names.size()));
+        target.name.name = it->second;
+        if (fresh) {
+            TensorEquation eq;
+            eq.lhs = target;
+            eq.projection = "=";
+            eq.clauses.push_back(GuardedClause{chain, std::nullopt});
+            rec.hoisted.push_back(std::move(eq));
+            tensors.insert(it->second);
+        }
+        auto result = std::make_shared<Expr>(*chain);
+        result->node = ExprTensorRef{target};
+        return result;
+    }
+
+    ExprPtr rewrite(const ExprPtr& expr) {
+        if (const auto* b = std::get_if<ExprBinary>(&expr->node); b && b->op == ExprBinary::Op::Mul) {
+            std::vector<const TensorRef*> refs;
+            std::vector<ExprPtr> others;
+            if (factors(expr, refs, others)) return independent(refs) ? hoist(expr) : expr;
+            return rewriteFactors(expr);
+        }
+        auto result = std::make_shared<Expr>(*expr);
+        std::visit([this](auto& node) { (*this)(node); }, result->node);
+        return result;
+    }
+
+    // A chain with other factors keeps its products; only those factors are rewritten
+    ExprPtr rewriteFactors(const ExprPtr& expr) {
+        if (std::holds_alternative<ExprTensorRef>(expr->node)) return expr;
+        auto result = std::make_shared<Expr>(*expr);
+        if (auto* b = std::get_if<ExprBinary>(&result->node); b && b->op == ExprBinary::Op::Mul) {
+            b->lhs = rewriteFactors(b->lhs);
+            b->rhs = rewriteFactors(b->rhs);
+        } else if (auto* p = std::get_if<ExprParen>(&result->node)) {
+            p->inner = rewriteFactors(p->inner);
+        } else {
+            return rewrite(expr);
+        }
+        return result;
+    }
+
+    void operator()(ExprTensorRef&) {}
+    void operator()(ExprNumber&) {}
+    void operator()(ExprString&) {}
+    void operator()(ExprList&) {}
+    void operator()(ExprParen& p) { p.inner = rewrite(p.inner); }
+    void operator()(ExprCall& c) {
+        for (auto& arg : c.args) arg = rewrite(arg);
+    }
+    void operator()(ExprBinary& b) {
+        b.lhs = rewrite(b.lhs);
+        b.rhs = rewrite(b.rhs);
+    }
+    void operator()(ExprUnary& u) { u.operand = rewrite(u.operand); }
+};
+
+} // anonymous namespace
+
+std::vector<Statement> VirtualIndexPreprocessor::preprocessBatch(const std::vector<Statement>& statements, Environment& env,
+                                                                 bool debugOutput) {
+    // Constant false when trace messages are compiled out, which removes every branch below
+    const bool debug = logCompiled(LogLevel::Trace) && debugOutput;
+    auto groupsByVirtualIndex = groupByVirtualIndex(statements, debug);
+
     std::vector<Statement> result;
 
     // Process each group independently
@@ -689,19 +1033,7 @@ std::vector<Statement> VirtualIndexPreprocessor::preprocessBatch(const std::vect
                     writeEq.lhs.name.name = tempName;
 
                     // MODE B: Remove virtual indices entirely from temp tensors
-                    std::vector<IndexOrSlice> newIndices;
-                    for (auto& ios : writeEq.lhs.indices) {
-                        if (std::holds_alternative<Index>(ios.value)) {
-                            const auto& idx = std::get<Index>(ios.value);
-                            if (!std::holds_alternative<VirtualIndex>(idx.value)) {
-                                newIndices.push_back(ios);
-                            }
-                        } else {
-                            // Keep slices
-                            newIndices.push_back(ios);
-                        }
-                    }
-                    writeEq.lhs.indices = newIndices;
+                    writeEq.lhs.indices = withoutVirtualIndices(writeEq.lhs.indices);
 
                     for (size_t clauseIdx = 0; clauseIdx < writeEq.clauses.size(); ++clauseIdx) {
                         writeEq.clauses[clauseIdx].expr =
@@ -729,56 +1061,161 @@ std::vector<Statement> VirtualIndexPreprocessor::preprocessBatch(const std::vect
                 // Only copy back non-RHS-only equations
                 if (info.isRhsOnly) continue;
 
-                std::string tempName = tensorToTemp[info.lhsTensorName];
-
-                TensorEquation copyEq;
-                copyEq.projection = info.eq.projection;
-                copyEq.loc = info.eq.loc;
-
-                copyEq.lhs = info.eq.lhs;
-                // MODE B: Substitute virtual indices with 0 (main tensors keep the dimension)
-                for (auto& ios : copyEq.lhs.indices) {
-                    if (std::holds_alternative<Index>(ios.value)) {
-                        auto& idx = std::get<Index>(ios.value);
-                        if (std::holds_alternative<VirtualIndex>(idx.value)) {
-                            NumberLiteral num;
-                            num.text = "0";
-                            num.loc = ios.loc;
-                            idx.value = num;
-                        }
-                    }
-                }
+                result.push_back(copyBackEquation(info.eq, tensorToTemp[info.lhsTensorName]));
+            }
+        }
+    }
 
-                auto rhsRef = std::make_shared<Expr>();
-                rhsRef->loc = info.eq.lhs.loc;
-                TensorRef readRef = info.eq.lhs;
-                readRef.name.name = tempName;
-                // MODE B: Remove virtual indices entirely from RHS read reference
-                std::vector<IndexOrSlice> newReadIndices;
-                for (auto& ios : readRef.indices) {
-                    if (std::holds_alternative<Index>(ios.value)) {
-                        const auto& idx = std::get<Index>(ios.value);
-                        if (!std::holds_alternative<VirtualIndex>(idx.value)) {
-                            newReadIndices.push_back(ios);
-                        }
-                    } else {
-                        // Keep slices
-                        newReadIndices.push_back(ios);
-                    }
-                }
-                readRef.indices = newReadIndices;
-                rhsRef->node = ExprTensorRef{readRef};
+    return result;
+}
 
-                GuardedClause copyClause;
-                copyClause.expr = rhsRef;
-                copyEq.clauses.push_back(copyClause);
+std::optional<std::vector<Recurrence>> VirtualIndexPreprocessor::lowerBatch(const std::vector<Statement>& statements,
+                                                                         Environment& env) {
+    auto groups = groupByVirtualIndex(statements, false);
+    std::vector<Recurrence> lowered;
 
-                result.push_back(copyEq);
+    for (auto& [virtualIndexName, eqInfos] : groups) {
+        if (eqInfos.empty()) continue;
+
+        DependencyGraph graph;
+        for (const auto& info : eqInfos) graph.addEquation(info);
+        graph.buildEdges();
+        std::vector<const TensorEquation*> ordered;
+        for (int idx : graph.topologicalSort()) ordered.push_back(&eqInfos[idx].eq);
+
+        const int iterations = getIterationCount(virtualIndexName, env, eqInfos[0].eq);
+        if (iterations == CONVERGENCE_FLAG) return std::nullopt;
+
+        auto rec = lowerGroup(virtualIndexName, iterations, ordered, env);
+        if (!rec) return std::nullopt;
+        lowered.push_back(std::move(*rec));
+    }
+
+    return lowered;
+}
+
+std::optional<Recurrence> VirtualIndexPreprocessor::lowerFixedPoint(const FixedPointLoop& loop, Environment& env) {
+    const auto lhsVirtuals = virtualIndicesOf(loop.equation.lhs);
+    if (lhsVirtuals.size() != 1) return std::nullopt;
+
+    auto rec = lowerGroup(lhsVirtuals[0].first, ABSOLUTE_MAX_ITERS, {&loop.equation}, env);
+    if (!rec) return std::nullopt;
+    for (size_t s = 0; s < rec->states.size(); ++s) {
+        if (rec->states[s].tensor == loop.monitoredTensor) rec->monitored = static_cast<int>(s);
+    }
+    if (rec->monitored < 0) return std::nullopt;
+    return rec;
+}
+
+std::optional<Recurrence> VirtualIndexPreprocessor::lowerGroup(const std::string& index, int iterations,
+                                                               const std::vector<const TensorEquation*>& ordered,
+                                                               Environment& env) {
+    Recurrence rec;
+    rec.index = index;
+    rec.iterations = iterations;
+
+    // Every tensor the group writes, and which of them carry state
+    std::map<std::string, int> stateOf;
+    std::map<std::string, int> stepOf;
+    for (const TensorEquation* eq : ordered) {
+        const std::string lhsName = Environment::key(eq->lhs);
+        if (!stepOf.emplace(lhsName, static_cast<int>(stepOf.size())).second) return std::nullopt;
+        const auto lhsVirtuals = virtualIndicesOf(eq->lhs);
+        if (lhsVirtuals.empty()) continue;
+
+        ensureMinimumVirtualSlots(*eq, env, index, 1);
+        Recurrence::State state;
+        state.tensor = lhsName;
+        state.offset = lhsVirtuals[0].second;
+        for (size_t d = 0; d < eq->lhs.indices.size(); ++d) {
+            const auto* idx = std::get_if<Index>(&eq->lhs.indices[d].value);
+            if (idx && std::holds_alternative<VirtualIndex>(idx->value)) {
+                state.slotDim = static_cast<int64_t>(d);
             }
         }
+        state.writeBack = copyBackEquation(*eq, state.tensor + "$next");
+        stateOf[state.tensor] = static_cast<int>(rec.states.size());
+        rec.states.push_back(std::move(state));
     }
 
-    return result;
+    InputHoister hoister{index, env, stepOf, rec};
+    RecurrenceRewriter rewriter{index, env, rec, stateOf, stepOf, hoister.tensors};
+    for (const TensorEquation* eq : ordered) {
+        const std::string lhsName = Environment::key(eq->lhs);
+        const bool rhsOnly = stateOf.find(lhsName) == stateOf.end();
+        Recurrence::Step step;
+        step.equation = *eq;
+        if (eq->clauses.size() == 1 && !eq->clauses[0].guard) {
+            hoister.prefix = lhsName;
+            hoister.context.clear();
+            for (const auto& ios : eq->lhs.indices) {
+                const auto* idx = std::get_if<Index>(&ios.value);
+                const auto* id = idx ? std::get_if<Identifier>(&idx->value) : nullptr;
+                if (id && id->name != index) hoister.context.push_back(*id);
+            }
+            step.equation.clauses[0].expr = hoister.rewrite(eq->clauses[0].expr);
+        }
+        rewriter.step = &step;
+        rewriter.current = static_cast<int>(rec.steps.size());
+        for (auto& clause : step.equation.clauses) {
+            clause.expr = rewriter.lower(clause.expr);
+            if (clause.guard) clause.guard = rewriter.lower(*clause.guard);
+        }
+
+        // The step value must be the whole RHS, so LHS indices are plain
+        // identifiers; RHS-only equations index their target by t once
+        std::vector<IndexOrSlice> lhsIndices;
+        for (size_t d = 0; d < eq->lhs.indices.size(); ++d) {
+            const auto& ios = eq->lhs.indices[d];
+            const auto* idx = std::get_if<Index>(&ios.value);
+            if (idx && std::holds_alternative<VirtualIndex>(idx->value) && !rhsOnly) continue;
+            const auto* id = idx ? std::get_if<Identifier>(&idx->value) : nullptr;
+            if (!id) return std::nullopt;
+            if (id->name == index) {
+                if (!rhsOnly || step.axis >= 0) return std::nullopt;
+                step.axis = static_cast<int64_t>(d);
+                continue;
+            }
+            lhsIndices.push_back(ios);
+        }
+
+        if (rhsOnly) {
+            if (step.axis < 0) return std::nullopt;
+            step.target = lhsName;
+            step.output = lhsName + "$step";
+        } else {
+            step.state = stateOf.at(lhsName);
+            step.output = lhsName + "$next";
+        }
+        step.equation.lhs.name.name = step.output;
+        step.equation.lhs.indices = std::move(lhsIndices);
+        rec.steps.push_back(std::move(step));
+    }
+    if (!rewriter.supported) return std::nullopt;
+
+    // Wave offsets: a read of the value `source` produced lag steps earlier
+    // is ready in time if wave >= source's wave - lag + 1. Reads of earlier
+    // steps settle in one pass; feedback from later steps may take more, and
+    // a cycle that keeps raising offsets leaves the body sequential
+    bool settled = false;
+    for (size_t pass = 0; pass <= rec.steps.size() && !settled; ++pass) {
+        settled = true;
+        for (auto& step : rec.steps) {
+            for (const auto& read : step.reads) {
+                const int ready = rec.steps[read.source].wave - read.lag + 1;
+                if (step.wave < ready) {
+                    step.wave = ready;
+                    settled = false;
+                }
+            }
+        }
+    }
+    rec.wavefront = settled;
+    if (!settled) {
+        for (auto& step : rec.steps) step.wave = 0;
+    }
+
+    return rec;
 }
 
 bool VirtualIndexPreprocessor::shouldPreprocess(const Statement& st, const Environment& env) const {
@@ -834,6 +1271,11 @@ std::vector<Statement> VirtualIndexPreprocessor::preprocess(const Statement& st,
 
     std::string virtualIndexName = lhsVirtuals[0].first;
     int lhsOffset = lhsVirtuals[0].second;
+    {
+        std::string lhsKey = Environment::key(eq.lhs);
+        rejectDeepLags(virtualIndexName, {VirtualEqInfo{eq, lhsKey.substr(0, lhsKey.find('[')), lhsOffset,
+                                                        collectRhsVirtualIndices(eq), false}});
+    }
 
     // Step 2: Find regular indices in RHS that match the virtual index name
     auto regularIndices = findRegularIndices(eq);
@@ -991,16 +1433,7 @@ std::optional<std::pair<std::string, int>> VirtualIndexPreprocessor::getVirtualI
 }
 
 std::vector<std::pair<std::string, int>> VirtualIndexPreprocessor::findVirtualIndices(const TensorRef& ref) {
-    std::vector<std::pair<std::string, int>> result;
-    for (size_t i = 0; i < ref.indices.size(); ++i) {
-        if (std::holds_alternative<Index>(ref.indices[i].value)) {
-            const auto& idx = std::get<Index>(ref.indices[i].value);
-            if (auto info = getVirtualIndexInfo(idx)) {
-                result.push_back({info->first, info->second});
-            }
-        }
-    }
-    return result;
+    return virtualIndicesOf(ref);
 }
 
 std::set<std::string> VirtualIndexPreprocessor::findRegularIndices(const TensorEquation& eq) {
@@ -0,0 +1,269 @@
+#include "TL/Runtime/Profiler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace tl {
+
+namespace {
+// Statement labels longer than this are cut in the summary table
+constexpr size_t kLabelWidth = 60;
+
+double millis(Profiler::Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+double micros(Profiler::Clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+
+std::string shapeText(const Profiler::Shape& shape) {
+    std::string text = "[";
+    for (size_t i = 0; i < shape.size(); ++i) {
+        if (i) text += ", ";
+        text += std::to_string(shape[i]);
+    }
+    return text + "]";
+}
+
+std::string shapesText(const std::vector<Profiler::Shape>& shapes) {
+    std::string text;
+    for (const auto& shape : shapes) text += (text.empty() ? "" : " ") + shapeText(shape);
+    return text;
+}
+
+std::string bytesText(uint64_t bytes) {
+    static const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double value = static_cast<double>(bytes);
+    size_t unit = 0;
+    while (value >= 1024.0 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+        value /= 1024.0;
+        ++unit;
+    }
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(unit ? 1 : 0) << value << ' ' << units[unit];
+    return oss.str();
+}
+
+std::string numberText(double value) {
+    std::ostringstream oss;
+    oss << value;
+    return oss.str();
+}
+
+void writeJsonString(std::ostream& out, const std::string& text) {
+    out << '"';
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            case '\r': out << "\\r"; break;
+            default:
+                if (c < 0x20) {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+                        << std::dec << std::setfill(' ');
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+}
+}
+
+Profiler::Profiler() : origin_(Clock::now()) {}
+
+void Profiler::addEvent(std::string name, std::string category, Clock::time_point start,
+                        Clock::time_point end, Args args) {
+    auto thread = threads_.emplace(std::this_thread::get_id(), threads_.size()).first->second;
+    Event event;
+    event.name = std::move(name);
+    event.category = std::move(category);
+    event.start = start - origin_;
+    event.duration = end - start;
+    event.thread = thread;
+    event.args = std::move(args);
+    events_.push_back(std::move(event));
+}
+
+void Profiler::recordStatement(const std::string& label, const std::string& executor,
+                               std::vector<Shape> inputs, Shape output, uint64_t bytes, double flops,
+                               Clock::time_point start, Clock::time_point end) {
+    Args args{{"executor", executor}};
+    if (!inputs.empty()) args.emplace_back("inputs", shapesText(inputs));
+    if (!output.empty() || bytes) args.emplace_back("output", shapeText(output));
+    if (bytes) args.emplace_back("bytes", std::to_string(bytes));
+    if (flops > 0.0) args.emplace_back("flops", numberText(flops));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = statement_index_.emplace(label, statements_.size()).first;
+    if (it->second == statements_.size()) {
+        statements_.emplace_back();
+        statements_.back().label = label;
+    }
+    StatementStats& stats = statements_[it->second];
+    stats.executor = executor;
+    stats.inputs = std::move(inputs);
+    stats.output = std::move(output);
+    ++stats.runs;
+    stats.time += end - start;
+    stats.bytes += bytes;
+    stats.flops += flops;
+    addEvent(label, "statement", start, end, std::move(args));
+}
+
+void Profiler::recordRule(const std::string& label, size_t joins, size_t matches, size_t derived) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = rule_index_.emplace(label, rules_.size()).first;
+    if (it->second == rules_.size()) {
+        rules_.emplace_back();
+        rules_.back().label = label;
+    }
+    RuleStats& stats = rules_[it->second];
+    stats.joins += joins;
+    stats.matches += matches;
+    stats.derived += derived;
+}
+
+void Profiler::recordEpoch(const std::string& target, int epoch, int64_t batches, double loss,
+                           Clock::time_point start, Clock::time_point end) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    epochs_.push_back({target, epoch, batches, loss, end - start});
+    addEvent(target + " epoch " + std::to_string(epoch), "learning", start, end,
+             {{"batches", std::to_string(batches)}, {"loss", numberText(loss)}});
+}
+
+void Profiler::recordSpan(const std::string& name, const std::string& category,
+                          Clock::time_point start, Clock::time_point end, Args args) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    addEvent(name, category, start, end, std::move(args));
+}
+
+void Profiler::summary(std::ostream& out, size_t limit) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<const StatementStats*> order;
+    Clock::duration total{};
+    for (const auto& s : statements_) {
+        order.push_back(&s);
+        total += s.time;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](const StatementStats* a, const StatementStats* b) { return a->time > b->time; });
+    if (limit && order.size() > limit) order.resize(limit);
+
+    const std::ios_base::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::fixed;
+    out << "Profile: " << statements_.size() << " statements, " << std::setprecision(3) << millis(total)
+        << " ms\n";
+    out << std::setw(12) << "time ms" << std::setw(8) << "share" << std::setw(8) << "runs" << "  "
+        << std::left << std::setw(22) << "executor" << std::right << std::setw(12) << "bytes"
+        << std::setw(12) << "MFLOP" << "  " << "statement\n";
+    for (const StatementStats* s : order) {
+        const double share = total.count() > 0 ? 100.0 * s->time.count() / total.count() : 0.0;
+        std::string label = s->label;
+        if (label.size() > kLabelWidth) label = label.substr(0, kLabelWidth - 3) + "...";
+        out << std::setw(12) << std::setprecision(3) << millis(s->time) << std::setw(7)
+            << std::setprecision(1) << share << '%' << std::setw(8) << s->runs << "  " << std::left
+            << std::setw(22) << s->executor << std::right << std::setw(12) << bytesText(s->bytes)
+            << std::setw(12) << std::setprecision(3) << s->flops / 1e6 << "  " << label;
+        if (!s->output.empty()) out << "  -> " << shapeText(s->output);
+        out << '\n';
+    }
+
+    if (!rules_.empty()) {
+        out << "\nRules:\n"
+            << std::setw(10) << "joins" << std::setw(12) << "matches" << std::setw(12) << "derived"
+            << "  rule\n";
+        for (const auto& r : rules_) {
+            out << std::setw(10) << r.joins << std::setw(12) << r.matches << std::setw(12) << r.derived
+                << "  " << r.label << '\n';
+        }
+    }
+
+    if (!epochs_.empty()) {
+        out << "\nEpochs:\n"
+            << std::setw(12) << "time ms" << std::setw(10) << "batches" << std::setw(14) << "loss"
+            << "  target\n";
+        for (const auto& e : epochs_) {
+            out << std::setw(12) << std::setprecision(3) << millis(e.time) << std::setw(10) << e.batches
+                << std::setw(14) << std::setprecision(6) << e.loss << "  " << e.target << " epoch "
+                << e.epoch << '\n';
+        }
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void Profiler::writeChromeTrace(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::ios_base::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < events_.size(); ++i) {
+        const Event& e = events_[i];
+        out << (i ? ",\n" : "\n") << "{\"name\":";
+        writeJsonString(out, e.name);
+        out << ",\"cat\":";
+        writeJsonString(out, e.category);
+        out << ",\"ph\":\"X\",\"ts\":" << micros(e.start) << ",\"dur\":" << micros(e.duration)
+            << ",\"pid\":1,\"tid\":" << e.thread << ",\"args\":{";
+        for (size_t a = 0; a < e.args.size(); ++a) {
+            if (a) out << ',';
+            writeJsonString(out, e.args[a].first);
+            out << ':';
+            writeJsonString(out, e.args[a].second);
+        }
+        out << "}}";
+    }
+    out << "\n]}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void Profiler::writeChromeTrace(const std::string& path) const {
+    std::ofstream ofs(path, std::ios::trunc);
+    if (!ofs) throw std::runtime_error("Cannot write profile trace: " + path);
+    writeChromeTrace(ofs);
+    if (!ofs) throw std::runtime_error("Cannot write profile trace: " + path);
+}
+
+void Profiler::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    origin_ = Clock::now();
+    events_.clear();
+    statements_.clear();
+    statement_index_.clear();
+    rules_.clear();
+    rule_index_.clear();
+    epochs_.clear();
+    threads_.clear();
+}
+
+std::vector<Profiler::StatementStats> Profiler::statements() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return statements_;
+}
+
+std::vector<Profiler::RuleStats> Profiler::rules() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rules_;
+}
+
+std::vector<Profiler::EpochStats> Profiler::epochs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return epochs_;
+}
+
+std::vector<Profiler::Event> Profiler::events() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_;
+}
+
+} // namespace tl
@@ -0,0 +1,78 @@
+#include "TL/Runtime/QueryResult.hpp"
+#include "TL/Runtime/RelationIO.hpp"
+#include "TL/Runtime/TensorIO.hpp"
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace tl {
+
+namespace query_io {
+
+    void writeText(std::ostream& out, const QueryResult& result, const SymbolTable& symbols) {
+        if (result.isTensor()) {
+            std::ostringstream text;
+            if (result.positions.defined()) {
+                const int64_t k = result.tensor.dim() > 0 ? result.tensor.size(-1) : 0;
+                text << result.name << " (top " << k << ") =\n" << result.tensor << '\n'
+                     << result.name << " (top " << k << " indices) =\n" << result.positions << '\n';
+            } else if (result.indices.empty()) {
+                text << result.name << " =\n" << result.tensor << '\n';
+            } else {
+                text << result.name << '[';
+                for (size_t i = 0; i < result.indices.size(); ++i) {
+                    if (i) text << ',';
+                    text << result.indices[i];
+                }
+                text << "] = ";
+                tensor_io::format(text, result.tensor);
+                text << '\n';
+            }
+            out << text.str() << std::flush;
+            return;
+        }
+
+        std::string text;
+        if (result.variables.empty()) {
+            if (result.rows == 0) text = "False\n";
+            for (size_t r = 0; r < result.rows; ++r) text += "True\n";
+        } else if (result.rows == 0) {
+            text = "None\n";
+        } else {
+            size_t bytes = 0;
+            for (size_t r = 0; r < result.rows; ++r) {
+                for (const auto& column : result.columns) bytes += symbols.name(column[r]).size() + 2;
+            }
+            text.reserve(bytes);
+            for (size_t r = 0; r < result.rows; ++r) {
+                for (size_t c = 0; c < result.columns.size(); ++c) {
+                    if (c) text += ", ";
+                    text += symbols.name(result.columns[c][r]);
+                }
+                text += '\n';
+            }
+        }
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        out.flush();
+    }
+
+    void write(const std::filesystem::path& path, const QueryResult& result, const SymbolTable& symbols) {
+        if (result.isTensor()) {
+            tensor_io::write(path, result.tensor);
+            return;
+        }
+        if (result.variables.empty()) {
+            throw std::runtime_error("Query " + result.name + " has no variables to write to " + path.string());
+        }
+        Relation relation(result.variables.size());
+        std::vector<SymbolId> tuple(result.variables.size());
+        for (size_t r = 0; r < result.rows; ++r) {
+            for (size_t c = 0; c < tuple.size(); ++c) tuple[c] = result.columns[c][r];
+            relation.insert(tuple.data());
+        }
+        relation_io::write(path, relation, symbols);
+    }
+
+} // namespace query_io
+
+} // namespace tl
@@ -0,0 +1,313 @@
+#include "TL/Runtime/RelationIO.hpp"
+#include "TL/Runtime/ThreadPool.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace tl {
+
+    namespace relation_io {
+
+    namespace {
+
+    // .tlr layout, all fields little-endian:
+    //   char magic[4] "TLR1", uint32 arity, uint64 rows, uint64 symbol count,
+    //   per symbol a uint32 byte length and its bytes, then `arity` columns
+    //   of `rows` uint32 indices into the symbols
+    constexpr char kTlrMagic[4] = {'T', 'L', 'R', '1'};
+    constexpr size_t kPieceBytes = size_t{16} << 20;  // text per thread and block
+    constexpr size_t kMinPieceBytes = size_t{1} << 20;
+    constexpr size_t kColumnBatch = size_t{1} << 20;  // rows per batch of a .tlr file
+    constexpr size_t kWriteBlock = size_t{1} << 20;
+
+    std::string extensionOf(const std::filesystem::path& path) {
+        std::string ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return ext;
+    }
+
+    bool isColumnar(const std::filesystem::path& path) { return extensionOf(path) == ".tlr"; }
+
+    // Lines that hold no tuple
+    bool isSkipped(const char* begin, const char* end) {
+        while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '\r')) ++begin;
+        return begin == end || *begin == '#';
+    }
+
+    template <typename Fn>
+    void forEachTupleLine(const char* begin, const char* end, Fn&& fn) {
+        while (begin < end) {
+            const char* newline = static_cast<const char*>(std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+            const char* lineEnd = newline ? newline : end;
+            if (!isSkipped(begin, lineEnd)) fn(begin, lineEnd);
+            begin = newline ? newline + 1 : end;
+        }
+    }
+
+    // Tab if the first tuple has one, else comma; 0 while no tuple was seen
+    char detectDelimiter(const char* begin, const char* end) {
+        char delimiter = 0;
+        forEachTupleLine(begin, end, [&](const char* b, const char* e) {
+            if (delimiter == 0) delimiter = std::memchr(b, '\t', static_cast<size_t>(e - b)) ? '\t' : ',';
+        });
+        return delimiter;
+    }
+
+    std::string_view fieldText(const char* begin, const char* end) {
+        while (begin < end && (*begin == ' ' || *begin == '\r')) ++begin;
+        while (end > begin && (end[-1] == ' ' || end[-1] == '\r')) --end;
+        if (end - begin >= 2 && *begin == '"' && end[-1] == '"') {
+            ++begin;
+            --end;
+        }
+        return std::string_view(begin, static_cast<size_t>(end - begin));
+    }
+
+    // Lines of a block handled by one thread. Fields are numbered by a
+    // dictionary local to the piece and interned afterwards, one lookup per
+    // distinct field.
+    struct Piece {
+        const char* begin{nullptr};
+        const char* end{nullptr};
+        size_t arity{0};
+        std::vector<std::string_view> symbols;  // distinct fields in first-seen order
+        std::vector<SymbolId> tuples;           // indices into symbols, later symbol IDs
+        std::string error;
+    };
+
+    void tokenize(Piece& piece, char delimiter) {
+        std::unordered_map<std::string_view, SymbolId> local;
+        forEachTupleLine(piece.begin, piece.end, [&](const char* b, const char* e) {
+            if (!piece.error.empty()) return;
+            size_t fields = 0;
+            for (const char* field = b;;) {
+                const char* next = static_cast<const char*>(std::memchr(field, delimiter, static_cast<size_t>(e - field)));
+                const std::string_view text = fieldText(field, next ? next : e);
+                const auto entry = local.try_emplace(text, static_cast<SymbolId>(piece.symbols.size()));
+                if (entry.second) piece.symbols.push_back(text);
+                piece.tuples.push_back(entry.first->second);
+                ++fields;
+                if (!next) break;
+                field = next + 1;
+            }
+            if (piece.arity == 0) piece.arity = fields;
+            if (fields != piece.arity) {
+                piece.error = "Relation file has a tuple of " + std::to_string(fields) + " fields, expected " +
+                              std::to_string(piece.arity) + ": '" + std::string(b, e) + "'";
+            }
+        });
+    }
+
+    size_t readText(const std::filesystem::path& path, SymbolTable& symbols, const TupleSink& sink, size_t threads) {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) throw std::runtime_error("Cannot open file for reading: " + path.string());
+        std::shared_ptr<ThreadPool> pool;
+        if (threads != 1) ThreadPool::obtain(pool, threads);
+        if (threads == 0) threads = pool->size();
+
+        const size_t blockBytes = threads * kPieceBytes;
+        std::string block;
+        std::vector<SymbolId> ids;
+        char delimiter = 0;
+        size_t arity = 0;
+        size_t total = 0;
+        for (bool eof = false; !eof;) {
+            const size_t carry = block.size();
+            block.resize(carry + blockBytes);
+            ifs.read(&block[carry], static_cast<std::streamsize>(blockBytes));
+            block.resize(carry + static_cast<size_t>(ifs.gcount()));
+            eof = !ifs;
+            // Whole lines only; a partial last line is carried into the next block
+            size_t end = block.size();
+            if (!eof) {
+                const size_t newline = block.rfind('\n');
+                end = newline == std::string::npos ? 0 : newline + 1;
+            }
+            const char* const data = block.data();
+            if (delimiter == 0) delimiter = detectDelimiter(data, data + end);
+
+            if (delimiter != 0 && end > 0) {
+                const size_t count = std::max<size_t>(1, std::min(threads, end / kMinPieceBytes));
+                std::vector<Piece> pieces(count);
+                const char* at = data;
+                for (size_t p = 0; p < count; ++p) {
+                    pieces[p].begin = at;
+                    if (p + 1 == count) {
+                        at = data + end;
+                    } else {
+                        at = std::max(at, data + end * (p + 1) / count);
+                        const char* newline = static_cast<const char*>(std::memchr(at, '\n', static_cast<size_t>(data + end - at)));
+                        at = newline ? newline + 1 : data + end;
+                    }
+                    pieces[p].end = at;
+                }
+                auto parse = [&](size_t p) { tokenize(pieces[p], delimiter); };
+                if (pool && count > 1) {
+                    pool->parallelFor(count, parse);
+                } else {
+                    for (size_t p = 0; p < count; ++p) parse(p);
+                }
+
+                for (auto& piece : pieces) {
+                    if (!piece.error.empty()) throw std::runtime_error(piece.error + " in: " + path.string());
+                    if (piece.arity == 0) continue;
+                    if (arity == 0) arity = piece.arity;
+                    if (piece.arity != arity) {
+                        throw std::runtime_error("Relation file has tuples of " + std::to_string(piece.arity) +
+                                                 " and " + std::to_string(arity) + " fields: " + path.string());
+                    }
+                    ids.resize(piece.symbols.size());
+                    for (size_t i = 0; i < piece.symbols.size(); ++i) ids[i] = symbols.intern(std::string(piece.symbols[i]));
+                    for (auto& id : piece.tuples) id = ids[id];
+                    const size_t rows = piece.tuples.size() / arity;
+                    sink(arity, piece.tuples.data(), rows);
+                    total += rows;
+                }
+            }
+            block.erase(0, end);
+        }
+        return total;
+    }
+
+    template <typename T>
+    T readValue(std::ifstream& ifs, const std::filesystem::path& path) {
+        T value{};
+        ifs.read(reinterpret_cast<char*>(&value), sizeof(T));
+        if (!ifs) throw std::runtime_error("Truncated relation file: " + path.string());
+        return value;
+    }
+
+    template <typename T>
+    void writeValue(std::ofstream& ofs, T value) {
+        ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    size_t readColumnar(const std::filesystem::path& path, SymbolTable& symbols, const TupleSink& sink) {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) throw std::runtime_error("Cannot open file for reading: " + path.string());
+        char magic[sizeof(kTlrMagic)];
+        ifs.read(magic, sizeof(magic));
+        if (!ifs || std::memcmp(magic, kTlrMagic, sizeof(kTlrMagic)) != 0) {
+            throw std::runtime_error("Not a .tlr relation file: " + path.string());
+        }
+        const uint32_t arity = readValue<uint32_t>(ifs, path);
+        const uint64_t rows = readValue<uint64_t>(ifs, path);
+        const uint64_t symbolCount = readValue<uint64_t>(ifs, path);
+        if (arity == 0) throw std::runtime_error("Relation file has arity 0: " + path.string());
+
+        // The file's own dictionary, interned once
+        std::vector<SymbolId> ids;
+        std::string text;
+        for (uint64_t i = 0; i < symbolCount; ++i) {
+            text.resize(readValue<uint32_t>(ifs, path));
+            ifs.read(&text[0], static_cast<std::streamsize>(text.size()));
+            if (!ifs) throw std::runtime_error("Truncated relation file: " + path.string());
+            ids.push_back(symbols.intern(text));
+        }
+
+        const std::streamoff columns = ifs.tellg();
+        std::vector<uint32_t> column;
+        std::vector<SymbolId> tuples;
+        for (uint64_t first = 0; first < rows; first += kColumnBatch) {
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(kColumnBatch, rows - first));
+            column.resize(n);
+            tuples.resize(n * arity);
+            for (uint32_t c = 0; c < arity; ++c) {
+                ifs.seekg(columns + static_cast<std::streamoff>((c * rows + first) * sizeof(uint32_t)));
+                ifs.read(reinterpret_cast<char*>(column.data()), static_cast<std::streamsize>(n * sizeof(uint32_t)));
+                if (!ifs) throw std::runtime_error("Truncated relation file: " + path.string());
+                for (size_t i = 0; i < n; ++i) {
+                    if (column[i] >= ids.size()) throw std::runtime_error("Symbol index out of range in: " + path.string());
+                    tuples[i * arity + c] = ids[column[i]];
+                }
+            }
+            sink(arity, tuples.data(), n);
+        }
+        return static_cast<size_t>(rows);
+    }
+
+    } // namespace
+
+    bool isRelationFile(const std::filesystem::path& path) {
+        const std::string ext = extensionOf(path);
+        return ext == ".tsv" || ext == ".facts" || ext == ".tlr";
+    }
+
+    size_t read(const std::filesystem::path& path, SymbolTable& symbols, const TupleSink& sink, size_t threads) {
+        if (isColumnar(path)) return readColumnar(path, symbols, sink);
+        return readText(path, symbols, sink, threads);
+    }
+
+    void write(const std::filesystem::path& path, const Relation& relation, const SymbolTable& symbols) {
+        const std::filesystem::path parent = path.parent_path();
+        if (!parent.empty()) {
+            std::error_code ec;
+            std::filesystem::create_directories(parent, ec);
+        }
+        std::ofstream ofs(path, std::ios::binary);
+        if (!ofs) throw std::runtime_error("Cannot open file for writing: " + path.string());
+
+        const size_t arity = relation.arity();
+        const size_t rows = relation.size();
+        if (isColumnar(path)) {
+            // Symbols the relation uses, numbered in first-seen order
+            std::vector<uint32_t> local(symbols.size(), UINT32_MAX);
+            std::vector<SymbolId> used;
+            for (size_t r = 0; r < rows; ++r) {
+                const SymbolId* tuple = relation.row(r);
+                for (size_t c = 0; c < arity; ++c) {
+                    if (local[tuple[c]] != UINT32_MAX) continue;
+                    local[tuple[c]] = static_cast<uint32_t>(used.size());
+                    used.push_back(tuple[c]);
+                }
+            }
+            ofs.write(kTlrMagic, sizeof(kTlrMagic));
+            writeValue<uint32_t>(ofs, static_cast<uint32_t>(arity));
+            writeValue<uint64_t>(ofs, rows);
+            writeValue<uint64_t>(ofs, used.size());
+            for (SymbolId id : used) {
+                const std::string& name = symbols.name(id);
+                writeValue<uint32_t>(ofs, static_cast<uint32_t>(name.size()));
+                ofs.write(name.data(), static_cast<std::streamsize>(name.size()));
+            }
+            std::vector<uint32_t> column;
+            for (size_t c = 0; c < arity; ++c) {
+                for (size_t first = 0; first < rows; first += kColumnBatch) {
+                    const size_t n = std::min(kColumnBatch, rows - first);
+                    column.resize(n);
+                    for (size_t i = 0; i < n; ++i) column[i] = local[relation.row(first + i)[c]];
+                    ofs.write(reinterpret_cast<const char*>(column.data()), static_cast<std::streamsize>(n * sizeof(uint32_t)));
+                }
+            }
+        } else {
+            std::string block;
+            for (size_t r = 0; r < rows; ++r) {
+                const SymbolId* tuple = relation.row(r);
+                for (size_t c = 0; c < arity; ++c) {
+                    if (c) block += '\t';
+                    block += symbols.name(tuple[c]);
+                }
+                block += '\n';
+                if (block.size() >= kWriteBlock) {
+                    ofs.write(block.data(), static_cast<std::streamsize>(block.size()));
+                    block.clear();
+                }
+            }
+            ofs.write(block.data(), static_cast<std::streamsize>(block.size()));
+        }
+        if (!ofs) throw std::runtime_error("Failed writing relation to: " + path.string());
+    }
+
+    } // namespace relation_io
+
+} // namespace tl
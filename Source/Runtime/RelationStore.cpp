@@ -0,0 +1,202 @@
+#include "TL/Runtime/RelationStore.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace tl {
+
+// -------- SymbolTable --------
+
+SymbolTable SymbolTable::extending(const SymbolTable& base) {
+    SymbolTable table;
+    table.base_ = &base;
+    table.base_size_ = base.size();
+    return table;
+}
+
+SymbolId SymbolTable::intern(const std::string& text) {
+    SymbolId id;
+    if (lookup(text, id)) return id;
+    id = static_cast<SymbolId>(base_size_ + names_.size());
+    names_.push_back(text);
+    ids_.emplace(text, id);
+    double value = 0.0;
+    numeric_.push_back(parseNumber(text, value) ? 1 : 0);
+    numbers_.push_back(value);
+    return id;
+}
+
+bool SymbolTable::parseNumber(const std::string& text, double& out) {
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    errno = 0;
+    const double value = std::strtod(begin, &end);
+    if (end == begin || errno == ERANGE) return false;
+    out = value;
+    return true;
+}
+
+bool SymbolTable::lookup(const std::string& text, SymbolId& outId) const {
+    if (base_ && base_->lookup(text, outId) && outId < base_size_) return true;
+    auto it = ids_.find(text);
+    if (it == ids_.end()) return false;
+    outId = it->second;
+    return true;
+}
+
+// -------- Relation --------
+
+Relation::Relation(const Relation& other)
+    : arity_(other.arity_)
+    , rows_(other.rows_)
+    , data_(other.data_)
+    , slots_(other.slots_)
+{}
+
+Relation& Relation::operator=(const Relation& other) {
+    if (this != &other) {
+        arity_ = other.arity_;
+        rows_ = other.rows_;
+        data_ = other.data_;
+        slots_ = other.slots_;
+        indexes_.clear();
+    }
+    return *this;
+}
+
+size_t Relation::hashTuple(const SymbolId* tuple) const {
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ arity_;
+    for (size_t i = 0; i < arity_; ++i) {
+        h ^= tuple[i];
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+    }
+    return static_cast<size_t>(h);
+}
+
+uint64_t Relation::hashColumns(ColumnMask mask, const SymbolId* tuple) const {
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ mask;
+    for (size_t i = 0; i < arity_ && i < 64; ++i) {
+        if ((mask >> i) & 1u) {
+            h ^= tuple[i];
+            h *= 0xBF58476D1CE4E5B9ull;
+            h ^= h >> 31;
+        }
+    }
+    return h;
+}
+
+bool Relation::rowEquals(size_t r, const SymbolId* tuple) const {
+    const SymbolId* stored = row(r);
+    for (size_t i = 0; i < arity_; ++i) {
+        if (stored[i] != tuple[i]) return false;
+    }
+    return true;
+}
+
+void Relation::rehash(size_t newCapacity) {
+    std::vector<uint32_t> slots(newCapacity, kEmptySlot);
+    const size_t mask = newCapacity - 1;
+    for (size_t r = 0; r < rows_; ++r) {
+        size_t pos = hashTuple(row(r)) & mask;
+        while (slots[pos] != kEmptySlot) pos = (pos + 1) & mask;
+        slots[pos] = static_cast<uint32_t>(r + 1);
+    }
+    slots_.swap(slots);
+}
+
+bool Relation::contains(const SymbolId* tuple) const {
+    if (slots_.empty()) return false;
+    const size_t mask = slots_.size() - 1;
+    for (size_t pos = hashTuple(tuple) & mask; slots_[pos] != kEmptySlot; pos = (pos + 1) & mask) {
+        if (rowEquals(slots_[pos] - 1, tuple)) return true;
+    }
+    return false;
+}
+
+void Relation::reserveRows(size_t rows) {
+    if (rows >= static_cast<size_t>(UINT32_MAX)) {
+        throw std::runtime_error("Relation: too many tuples");
+    }
+    // Keep the load factor at or below 1/2 so probe sequences stay short
+    size_t capacity = slots_.empty() ? 16 : slots_.size();
+    while (rows * 2 > capacity) capacity *= 2;
+    if (capacity != slots_.size()) rehash(capacity);
+}
+
+bool Relation::insertRow(const SymbolId* tuple) {
+    const size_t mask = slots_.size() - 1;
+    size_t pos = hashTuple(tuple) & mask;
+    for (; slots_[pos] != kEmptySlot; pos = (pos + 1) & mask) {
+        if (rowEquals(slots_[pos] - 1, tuple)) return false;
+    }
+    data_.insert(data_.end(), tuple, tuple + arity_);
+    slots_[pos] = static_cast<uint32_t>(rows_ + 1);
+    for (auto& index : indexes_) {
+        index->buckets[hashColumns(index->mask, tuple)].push_back(static_cast<uint32_t>(rows_));
+    }
+    ++rows_;
+    return true;
+}
+
+bool Relation::insert(const SymbolId* tuple) {
+    reserveRows(rows_ + 1);
+    return insertRow(tuple);
+}
+
+size_t Relation::insertBulk(const SymbolId* tuples, size_t count) {
+    if (count == 0) return 0;
+    reserveRows(rows_ + count);
+    // Geometric growth, so a load made of many batches copies the tuples O(1) times
+    const size_t needed = data_.size() + count * arity_;
+    if (data_.capacity() < needed) data_.reserve(std::max(needed, data_.capacity() * 2));
+    size_t inserted = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (insertRow(tuples + i * arity_)) ++inserted;
+    }
+    return inserted;
+}
+
+Relation::HashIndex& Relation::indexFor(ColumnMask mask) const {
+    for (auto& index : indexes_) {
+        if (index->mask == mask) return *index;
+    }
+    auto index = std::make_unique<HashIndex>();
+    index->mask = mask;
+    index->buckets.reserve(rows_);
+    for (size_t r = 0; r < rows_; ++r) {
+        index->buckets[hashColumns(mask, row(r))].push_back(static_cast<uint32_t>(r));
+    }
+    indexes_.push_back(std::move(index));
+    return *indexes_.back();
+}
+
+const Relation::RowList* Relation::probe(ColumnMask mask, const SymbolId* key) const {
+    const HashIndex& index = indexFor(mask);
+    auto it = index.buckets.find(hashColumns(mask, key));
+    return it == index.buckets.end() ? nullptr : &it->second;
+}
+
+size_t Relation::keyCount(ColumnMask mask) const {
+    for (const auto& index : indexes_) {
+        if (index->mask == mask) return index->buckets.size();
+    }
+    return 0;
+}
+
+std::vector<Relation::ColumnMask> Relation::indexMasks() const {
+    std::vector<ColumnMask> masks;
+    masks.reserve(indexes_.size());
+    for (const auto& index : indexes_) masks.push_back(index->mask);
+    return masks;
+}
+
+void Relation::clear() {
+    data_.clear();
+    slots_.clear();
+    indexes_.clear();
+    rows_ = 0;
+}
+
+} // namespace tl
@@ -0,0 +1,159 @@
+#include "TL/Runtime/Sampler.hpp"
+#include "TL/Runtime/ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+namespace tl {
+
+namespace {
+// Draws per parallel chunk; large enough to amortize scheduling, small
+// enough that a request of a few chunks still spreads across threads
+constexpr int64_t kChunk = 1 << 16;
+
+uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+}
+
+AliasTable::AliasTable(const std::vector<double>& weights) {
+    const size_t n = weights.size();
+    double total = 0.0;
+    for (double w : weights) {
+        if (!(w >= 0.0) || !std::isfinite(w)) {
+            throw std::runtime_error("sample: probabilities must be finite and non-negative");
+        }
+        total += w;
+    }
+    if (n == 0 || total <= 0.0) {
+        throw std::runtime_error("sample: probabilities must not all be zero");
+    }
+
+    // Vose's method: scaled weights below 1 are topped up by one outcome
+    // above 1, which then moves to the small or large list by its remainder
+    prob_.resize(n);
+    alias_.resize(n);
+    std::vector<double> scaled(n);
+    std::vector<int64_t> small, large;
+    for (size_t i = 0; i < n; ++i) {
+        scaled[i] = weights[i] * static_cast<double>(n) / total;
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<int64_t>(i));
+    }
+    while (!small.empty() && !large.empty()) {
+        const int64_t s = small.back();
+        small.pop_back();
+        const int64_t l = large.back();
+        prob_[s] = scaled[s];
+        alias_[s] = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // Whatever remains is 1 up to rounding
+    for (int64_t i : large) { prob_[i] = 1.0; alias_[i] = i; }
+    for (int64_t i : small) { prob_[i] = 1.0; alias_[i] = i; }
+}
+
+int64_t AliasTable::draw(uint64_t bits) const {
+    const uint64_t column = ((bits >> 32) * static_cast<uint64_t>(prob_.size())) >> 32;
+    const double coin = static_cast<double>(bits & 0xFFFFFFFFull) * (1.0 / 4294967296.0);
+    return coin < prob_[column] ? static_cast<int64_t>(column) : alias_[column];
+}
+
+uint64_t counterBits(uint64_t seed, uint64_t counter) {
+    return splitmix64(splitmix64(seed) ^ counter);
+}
+
+Sampler::Sampler(size_t threads) : threads_(threads) {}
+
+Sampler::~Sampler() = default;
+
+const std::vector<AliasTable>& Sampler::tablesFor(const std::string& name, const torch::Tensor& probs) {
+    auto it = cache_.find(name);
+    if (it != cache_.end() && it->second.source.data_ptr() == probs.data_ptr() &&
+        it->second.source.sizes() == probs.sizes() && it->second.source.strides() == probs.strides() &&
+        it->second.version == probs._version()) {
+        return it->second.rows;
+    }
+
+    const torch::Tensor host = probs.detach().to(torch::kCPU, torch::kFloat64).contiguous().reshape({-1, probs.size(-1)});
+    const double* data = host.data_ptr<double>();
+    const int64_t cols = host.size(1);
+    Entry entry;
+    entry.source = probs;
+    entry.version = probs._version();
+    entry.rows.reserve(host.size(0));
+    for (int64_t r = 0; r < host.size(0); ++r) {
+        entry.rows.emplace_back(std::vector<double>(data + r * cols, data + (r + 1) * cols));
+    }
+    tables_built_ += entry.rows.size();
+    return cache_.insert_or_assign(name, std::move(entry)).first->second.rows;
+}
+
+torch::Tensor Sampler::sample(const std::string& name, const torch::Tensor& probs, const SampleOptions& options) {
+    if (probs.dim() != 1 && probs.dim() != 2) {
+        throw std::runtime_error("sample: expected a 1-d or 2-d probability tensor, got " +
+                                 std::to_string(probs.dim()) + " dimensions");
+    }
+    if (probs.size(-1) == 0) {
+        throw std::runtime_error("sample: probabilities must not all be zero");
+    }
+    if (options.count < 0) {
+        throw std::runtime_error("sample: n must not be negative");
+    }
+    const std::vector<AliasTable>& tables = tablesFor(name, probs);
+    const int64_t rows = static_cast<int64_t>(tables.size());
+    const int64_t outcomes = probs.size(-1);
+    const int64_t count = options.count;
+    const uint64_t seed = options.seed ? *options.seed : (static_cast<uint64_t>(std::random_device{}()) << 32) ^
+                                                         std::random_device{}();
+
+    const int64_t width = options.counts ? outcomes : count;
+    torch::Tensor out = torch::zeros({rows, width}, torch::kLong);
+    int64_t* data = out.data_ptr<int64_t>();
+
+    // Draw i of row r uses counter r * count + i in every mode, so counts
+    // are exactly the histogram of the draws for the same seed
+    const int64_t chunksPerRow = (count + kChunk - 1) / kChunk;
+    const size_t chunks = static_cast<size_t>(rows * chunksPerRow);
+    std::vector<std::vector<int64_t>> partial(options.counts ? chunks : 0);
+    auto run = [&](size_t c) {
+        const int64_t r = static_cast<int64_t>(c) / chunksPerRow;
+        const int64_t begin = (static_cast<int64_t>(c) % chunksPerRow) * kChunk;
+        const int64_t end = std::min(count, begin + kChunk);
+        const AliasTable& table = tables[r];
+        const uint64_t base = static_cast<uint64_t>(r) * static_cast<uint64_t>(count);
+        if (options.counts) {
+            std::vector<int64_t>& hist = partial[c];
+            hist.assign(outcomes, 0);
+            for (int64_t i = begin; i < end; ++i) ++hist[table.draw(counterBits(seed, base + i))];
+        } else {
+            int64_t* row = data + r * count;
+            for (int64_t i = begin; i < end; ++i) row[i] = table.draw(counterBits(seed, base + i));
+        }
+    };
+    if (chunks > 1) {
+        ThreadPool::obtain(pool_, threads_);
+        pool_->parallelFor(chunks, run);
+    } else if (chunks == 1) {
+        run(0);
+    }
+
+    if (options.counts) {
+        for (size_t c = 0; c < chunks; ++c) {
+            int64_t* row = data + (static_cast<int64_t>(c) / chunksPerRow) * outcomes;
+            for (int64_t k = 0; k < outcomes; ++k) row[k] += partial[c][k];
+        }
+    }
+
+    if (probs.dim() == 1) out = out.reshape({width});
+    return out.to(probs.device());
+}
+
+} // namespace tl
@@ -0,0 +1,370 @@
+#include "TL/Runtime/Snapshot.hpp"
+#include "TL/ProgramCache.hpp"
+#include "TL/Runtime/TensorIO.hpp"
+#include "TL/vm.hpp"
+#include <torch/torch.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace tl {
+
+    namespace snapshot_io {
+
+    namespace {
+
+    constexpr char kMagic[4] = {'T', 'L', 'S', '1'};
+    constexpr uint32_t kFormatVersion = 4;  // 2: labels are symbols; 3: which symbols are labels; 4: label axes
+    constexpr size_t kHeaderSize = 64;
+
+    enum class TensorKind : uint64_t { Undefined = 0, Dense = 1, Sparse = 2 };
+
+    // Metadata encoding: varints and length-prefixed strings
+    class Writer {
+    public:
+        void u(uint64_t v) {
+            while (v >= 0x80) {
+                out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+                v >>= 7;
+            }
+            out.push_back(static_cast<char>(v));
+        }
+        void i(int64_t v) { u((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63)); }
+        void bytes(std::string_view s) {
+            u(s.size());
+            out.append(s.data(), s.size());
+        }
+
+        std::string out;
+    };
+
+    class Reader {
+    public:
+        Reader(std::string_view in, const std::filesystem::path& path) : in_(in), path_(path) {}
+
+        uint64_t u() {
+            uint64_t v = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                if (pos_ >= in_.size()) fail();
+                const auto b = static_cast<unsigned char>(in_[pos_++]);
+                v |= static_cast<uint64_t>(b & 0x7F) << shift;
+                if (!(b & 0x80)) return v;
+            }
+            fail();
+        }
+        int64_t i() {
+            const uint64_t v = u();
+            return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+        }
+        std::string bytes() {
+            const uint64_t n = u();
+            if (n > in_.size() - pos_) fail();
+            std::string s(in_.substr(pos_, n));
+            pos_ += n;
+            return s;
+        }
+        // A count of items that each take at least one byte
+        uint64_t count() {
+            const uint64_t n = u();
+            if (n > in_.size() - pos_) fail();
+            return n;
+        }
+        bool done() const { return pos_ == in_.size(); }
+
+        [[noreturn]] void fail() const { throw std::runtime_error("Malformed snapshot: " + path_.string()); }
+
+    private:
+        std::string_view in_;
+        const std::filesystem::path& path_;
+        size_t pos_{0};
+    };
+
+    struct TensorEntry {
+        std::string name;
+        TensorKind kind{TensorKind::Undefined};
+        bool requiresGrad{false};
+        size_t record{0};            // Dense: the values; Sparse: the indices, values follow
+        std::vector<int64_t> sizes;  // Sparse only
+    };
+
+    struct RelationEntry {
+        std::string name;
+        size_t arity{0};
+        size_t rows{0};
+        size_t record{0};
+        std::vector<Relation::ColumnMask> indexes;
+    };
+
+    // Appends records after the header, remembering their offsets
+    class RecordWriter {
+    public:
+        explicit RecordWriter(std::ofstream& out) : out_(out) {}
+
+        uint64_t add(const Tensor& t) {
+            const uint64_t at = end_;
+            end_ += tensor_io::writeRecord(out_, t);
+            return at;
+        }
+        uint64_t end() const { return end_; }
+
+    private:
+        std::ofstream& out_;
+        uint64_t end_{kHeaderSize};
+    };
+
+    void writeFile(const std::filesystem::path& path, const Environment& env, const DatalogEngine& datalog,
+                   std::ofstream& ofs) {
+        const std::vector<char> blank(kHeaderSize, 0);
+        ofs.write(blank.data(), static_cast<std::streamsize>(blank.size()));
+        RecordWriter records(ofs);
+        Writer meta;
+
+        const SymbolTable& symbols = env.symbols();
+        meta.u(symbols.size());
+        for (size_t id = 0; id < symbols.size(); ++id) meta.bytes(symbols.name(static_cast<SymbolId>(id)));
+        // Labels by axis position, so tensors indexed by them read the same
+        const std::vector<SymbolId>& labels = env.labelSymbols();
+        meta.u(labels.size());
+        for (SymbolId id : labels) meta.u(id);
+
+        const std::map<std::string, Tensor> tensors = env.tensors();
+        meta.u(tensors.size());
+        for (const auto& [name, t] : tensors) {
+            meta.bytes(name);
+            if (!t.defined()) {
+                meta.u(static_cast<uint64_t>(TensorKind::Undefined));
+                continue;
+            }
+            meta.u(static_cast<uint64_t>(t.is_sparse() ? TensorKind::Sparse : TensorKind::Dense));
+            meta.u(t.requires_grad() ? 1 : 0);
+            if (t.is_sparse()) {
+                const Tensor coalesced = t.detach().coalesce();
+                meta.u(records.add(coalesced.indices()));
+                meta.u(records.add(coalesced.values()));
+                meta.u(static_cast<uint64_t>(coalesced.dim()));
+                for (int64_t size : coalesced.sizes()) meta.i(size);
+            } else {
+                meta.u(records.add(t));
+            }
+        }
+
+        // Empty relations hold no facts and are not kept
+        std::vector<std::pair<const std::string*, const Relation*>> relations;
+        for (const auto& [name, relation] : env.relations()) {
+            if (!relation.empty()) relations.emplace_back(&name, &relation);
+        }
+        meta.u(relations.size());
+        for (const auto& [name, relation] : relations) {
+            meta.bytes(*name);
+            meta.u(relation->arity());
+            meta.u(relation->size());
+            // Rows are packed row-major, as a [rows, arity] tensor of symbol IDs
+            const Tensor rows = torch::from_blob(const_cast<SymbolId*>(relation->row(0)),
+                                                 {static_cast<int64_t>(relation->size()),
+                                                  static_cast<int64_t>(relation->arity())},
+                                                 torch::kInt32);
+            meta.u(records.add(rows));
+            const std::vector<Relation::ColumnMask> indexes = relation->indexMasks();
+            meta.u(indexes.size());
+            for (Relation::ColumnMask mask : indexes) meta.u(mask);
+        }
+
+        const DatalogEngine::State state = datalog.state();
+        Program rules;
+        for (const auto& rule : state.rules) rules.statements.emplace_back(rule);
+        meta.bytes(serializeProgram(rules));
+        meta.u(state.closureRules);
+        meta.u(state.dirty ? 1 : 0);
+        meta.u(state.closure.size());
+        for (const auto& [name, rows] : state.closure) {
+            meta.bytes(name);
+            meta.u(rows);
+        }
+
+        const uint64_t metaOffset = records.end();
+        const uint64_t metaSize = meta.out.size();
+        ofs.write(meta.out.data(), static_cast<std::streamsize>(meta.out.size()));
+        std::vector<char> header(kHeaderSize, 0);
+        std::memcpy(header.data(), kMagic, sizeof(kMagic));
+        std::memcpy(header.data() + 4, &kFormatVersion, sizeof(uint32_t));
+        std::memcpy(header.data() + 8, &metaOffset, sizeof(uint64_t));
+        std::memcpy(header.data() + 16, &metaSize, sizeof(uint64_t));
+        ofs.seekp(0);
+        ofs.write(header.data(), static_cast<std::streamsize>(header.size()));
+        if (!ofs) throw std::runtime_error("Failed writing snapshot: " + path.string());
+    }
+
+    // Metadata of a snapshot file, checked against its header
+    std::string readMetadata(const std::filesystem::path& path) {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) throw std::runtime_error("Cannot open file for reading: " + path.string());
+        char header[kHeaderSize];
+        if (!ifs.read(header, kHeaderSize) || std::memcmp(header, kMagic, sizeof(kMagic)) != 0) {
+            throw std::runtime_error("Not a snapshot file: " + path.string());
+        }
+        uint32_t version = 0;
+        uint64_t offset = 0, size = 0;
+        std::memcpy(&version, header + 4, sizeof(uint32_t));
+        std::memcpy(&offset, header + 8, sizeof(uint64_t));
+        std::memcpy(&size, header + 16, sizeof(uint64_t));
+        if (version != kFormatVersion) {
+            throw std::runtime_error("Unsupported snapshot version " + std::to_string(version) + ": " + path.string());
+        }
+        std::error_code ec;
+        const uint64_t fileSize = std::filesystem::file_size(path, ec);
+        if (ec || offset < kHeaderSize || offset > fileSize || size != fileSize - offset) {
+            throw std::runtime_error("Malformed snapshot: " + path.string());
+        }
+        std::string meta(size, '\0');
+        ifs.seekg(static_cast<std::streamoff>(offset));
+        if (!ifs.read(meta.data(), static_cast<std::streamsize>(size))) {
+            throw std::runtime_error("Truncated snapshot: " + path.string());
+        }
+        return meta;
+    }
+
+    } // namespace
+
+    void write(const std::filesystem::path& path, const Environment& env, const DatalogEngine& datalog) {
+        const std::filesystem::path parent = path.parent_path();
+        if (!parent.empty()) {
+            std::error_code ec;
+            std::filesystem::create_directories(parent, ec);
+        }
+#ifndef _WIN32
+        const std::filesystem::path tmp = path.string() + ".tmp" + std::to_string(::getpid());
+#else
+        const std::filesystem::path tmp = path.string() + ".tmp";
+#endif
+        try {
+            std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+            if (!ofs) throw std::runtime_error("Cannot open file for writing: " + path.string());
+            writeFile(path, env, datalog, ofs);
+        } catch (...) {
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            throw;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, path, ec);
+        if (ec) {
+            std::filesystem::remove(tmp, ec);
+            throw std::runtime_error("Cannot write snapshot: " + path.string());
+        }
+    }
+
+    DatalogEngine::State read(const std::filesystem::path& path, Environment& env) {
+        const std::string meta = readMetadata(path);
+        Reader r(meta, path);
+        std::vector<uint64_t> offsets;
+
+        std::vector<std::string> symbols(r.count());
+        for (auto& symbol : symbols) symbol = r.bytes();
+        std::vector<uint64_t> labels(r.count());
+        std::vector<char> labelled(symbols.size(), 0);
+        for (auto& id : labels) {
+            id = r.u();
+            if (id >= symbols.size() || labelled[id]) r.fail();
+            labelled[id] = 1;
+        }
+
+        std::vector<TensorEntry> tensors(r.count());
+        for (auto& entry : tensors) {
+            entry.name = r.bytes();
+            const uint64_t kind = r.u();
+            if (kind > static_cast<uint64_t>(TensorKind::Sparse)) r.fail();
+            entry.kind = static_cast<TensorKind>(kind);
+            if (entry.kind == TensorKind::Undefined) continue;
+            entry.requiresGrad = r.u() != 0;
+            entry.record = offsets.size();
+            offsets.push_back(r.u());
+            if (entry.kind == TensorKind::Sparse) {
+                offsets.push_back(r.u());
+                entry.sizes.resize(r.count());
+                for (auto& size : entry.sizes) size = r.i();
+            }
+        }
+
+        std::vector<RelationEntry> relations(r.count());
+        for (auto& entry : relations) {
+            entry.name = r.bytes();
+            entry.arity = r.u();
+            entry.rows = r.u();
+            entry.record = offsets.size();
+            offsets.push_back(r.u());
+            entry.indexes.resize(r.count());
+            for (auto& mask : entry.indexes) mask = r.u();
+        }
+
+        DatalogEngine::State state;
+        for (auto& statement : deserializeProgram(r.bytes()).statements) {
+            auto* rule = std::get_if<DatalogRule>(&statement);
+            if (!rule) r.fail();
+            state.rules.push_back(std::move(*rule));
+        }
+        state.closureRules = r.u();
+        state.dirty = r.u() != 0;
+        state.closure.resize(r.count());
+        for (auto& [name, rows] : state.closure) {
+            name = r.bytes();
+            rows = r.u();
+        }
+        if (!r.done()) r.fail();
+
+        // Views of the mapped file; tensor data is not read until it is used
+        const std::vector<Tensor> records = tensor_io::readRecords(path, offsets);
+        std::vector<Tensor> values;
+        values.reserve(tensors.size());
+        for (const auto& entry : tensors) {
+            Tensor t;
+            if (entry.kind == TensorKind::Dense) {
+                t = records[entry.record];
+            } else if (entry.kind == TensorKind::Sparse) {
+                t = torch::sparse_coo_tensor(records[entry.record], records[entry.record + 1], entry.sizes);
+            }
+            if (entry.requiresGrad) t.requires_grad_(true);
+            values.push_back(std::move(t));
+        }
+        SymbolTable table;
+        for (size_t id = 0; id < symbols.size(); ++id) {
+            if (table.intern(symbols[id]) != id) r.fail();
+        }
+        for (const auto& entry : relations) {
+            const Tensor& rows = records[entry.record];
+            if (rows.scalar_type() != torch::kInt32 || rows.dim() != 2 || !rows.is_contiguous() ||
+                rows.size(0) != static_cast<int64_t>(entry.rows) || rows.size(1) != static_cast<int64_t>(entry.arity)) {
+                r.fail();
+            }
+            const auto* ids = static_cast<const SymbolId*>(rows.data_ptr());
+            if (std::any_of(ids, ids + rows.numel(), [&](SymbolId id) { return id >= table.size(); })) r.fail();
+        }
+
+        env.clear();
+        env.symbols() = std::move(table);
+        for (uint64_t id : labels) env.internLabel(symbols[id]);
+        for (size_t k = 0; k < tensors.size(); ++k) env.bind(tensors[k].name, values[k]);
+        for (const auto& entry : relations) {
+            const Tensor& rows = records[entry.record];
+            env.addFacts(entry.name, entry.arity, static_cast<const SymbolId*>(rows.data_ptr()), entry.rows);
+            const Relation* relation = env.relation(entry.name);
+            if (!relation) continue;
+            for (Relation::ColumnMask mask : entry.indexes) relation->ensureIndex(mask);
+        }
+        return state;
+    }
+
+    } // namespace snapshot_io
+
+} // namespace tl
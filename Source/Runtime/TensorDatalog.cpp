@@ -0,0 +1,148 @@
+#include "TL/Runtime/TensorDatalog.hpp"
+#include "TL/backend.hpp"
+#include "TL/vm.hpp"
+#include <torch/torch.h>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace tl {
+
+TensorDatalog::TensorDatalog(Environment& env, TensorBackend& backend, size_t maxCells)
+    : env_(env)
+    , backend_(backend)
+    , max_cells_(maxCells)
+{}
+
+bool TensorDatalog::supports(const DatalogRule& rule) {
+    std::unordered_set<std::string> bodyVars;
+    size_t atoms = 0;
+    for (const auto& el : rule.body) {
+        const auto* a = std::get_if<DatalogAtom>(&el);
+        if (!a || a->terms.empty()) return false;  // negations and conditions need the join
+        for (const auto& term : a->terms) {
+            const auto* id = std::get_if<Identifier>(&term);
+            if (!id) return false;
+            bodyVars.insert(id->name);
+        }
+        ++atoms;
+    }
+    // einsum subscripts are single letters
+    if (atoms == 0 || bodyVars.size() > 52 || rule.head.terms.empty()) return false;
+
+    std::unordered_set<std::string> headVars;
+    for (const auto& term : rule.head.terms) {
+        const auto* id = std::get_if<Identifier>(&term);
+        if (!id || !bodyVars.count(id->name) || !headVars.insert(id->name).second) return false;
+    }
+    return true;
+}
+
+std::string TensorDatalog::einsumSpec(const DatalogRule& rule) {
+    static const char* kLetters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    std::unordered_map<std::string, char> letterOf;
+    auto letter = [&](const auto& term) {
+        const std::string& name = std::get<Identifier>(term).name;
+        auto it = letterOf.find(name);
+        if (it == letterOf.end()) it = letterOf.emplace(name, kLetters[letterOf.size()]).first;
+        return it->second;
+    };
+    std::string spec;
+    for (const auto& el : rule.body) {
+        const auto& atom = std::get<DatalogAtom>(el);
+        if (!spec.empty()) spec += ',';
+        for (const auto& term : atom.terms) spec += letter(term);
+    }
+    spec += "->";
+    for (const auto& term : rule.head.terms) spec += letter(term);
+    return spec;
+}
+
+bool TensorDatalog::saturate(const std::vector<const DatalogRule*>& rules, bool recursive, size_t& rounds) {
+    rounds = 0;
+    const int64_t domain = static_cast<int64_t>(env_.symbols().size());
+    if (domain == 0) return false;
+
+    // Arity of every relation the stratum touches
+    std::unordered_map<std::string, size_t> arities;
+    std::vector<std::string> names;  // first-appearance order
+    auto note = [&](const DatalogAtom& atom) {
+        auto it = arities.find(atom.relation.name);
+        if (it == arities.end()) {
+            arities.emplace(atom.relation.name, atom.terms.size());
+            names.push_back(atom.relation.name);
+            return true;
+        }
+        return it->second == atom.terms.size();
+    };
+    for (const DatalogRule* rule : rules) {
+        if (!note(rule->head)) return false;
+        for (const auto& el : rule->body) {
+            if (!note(std::get<DatalogAtom>(el))) return false;
+        }
+    }
+    for (const auto& name : names) {
+        const size_t arity = arities.at(name);
+        const Relation* rel = env_.relation(name);
+        if (rel && rel->arity() != arity) return false;
+        double cells = 1.0;
+        for (size_t i = 0; i < arity; ++i) cells *= static_cast<double>(domain);
+        if (cells > static_cast<double>(max_cells_)) return false;
+    }
+
+    // Materialize the relations as 0/1 tensors indexed by symbol ID, stored in
+    // the policy's mask type (one byte per cell for bool/uint8)
+    const DTypePolicy& policy = env_.dtypePolicy();
+    const bool floatMasks = c10::isFloatingType(policy.mask);
+    std::unordered_map<std::string, torch::Tensor> tensors;
+    for (const auto& name : names) {
+        if (env_.hasRelation(name)) {
+            // Dense within max_cells_ (checked above)
+            tensors.emplace(name, env_.symbolTensor(name, policy.mask).to_dense());
+        } else {
+            tensors.emplace(name, torch::zeros(std::vector<int64_t>(arities.at(name), domain),
+                                               env_.tensorOptions().dtype(policy.mask)));
+        }
+    }
+
+    std::vector<std::string> specs;
+    for (const DatalogRule* rule : rules) specs.push_back(einsumSpec(*rule));
+
+    // Each rule ORs step(einsum(body)) into its head; a recursive stratum
+    // repeats until a full pass changes nothing
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < rules.size(); ++i) {
+            const DatalogRule& rule = *rules[i];
+            std::vector<torch::Tensor> operands;
+            for (const auto& el : rule.body) {
+                const torch::Tensor& rel = tensors.at(std::get<DatalogAtom>(el).relation.name);
+                // einsum needs numbers; compact masks are widened per contraction
+                operands.push_back(floatMasks ? rel : policy.toCompute(rel));
+            }
+            torch::Tensor& head = tensors.at(rule.head.relation.name);
+            torch::Tensor derived = backend_.einsum(specs[i], operands).gt(0);
+            torch::Tensor next = torch::logical_or(head.gt(0), derived).to(policy.mask);
+            if (!torch::equal(next, head)) {
+                head = next;
+                changed = true;
+            }
+        }
+        ++rounds;
+        if (!recursive) break;
+    }
+
+    // Write derived tuples back in row-major order
+    std::unordered_set<std::string> heads;
+    for (const DatalogRule* rule : rules) {
+        const std::string& name = rule->head.relation.name;
+        if (!heads.insert(name).second) continue;
+        const std::vector<SymbolId> tuples = env_.symbolTuples(tensors.at(name));
+        const size_t arity = arities.at(name);
+        if (arity > 0) env_.addFacts(name, arity, tuples.data(), tuples.size() / arity);
+        else if (tensors.at(name).item<double>() > 0) env_.addFact(name, std::vector<SymbolId>{});
+    }
+    return true;
+}
+
+} // namespace tl
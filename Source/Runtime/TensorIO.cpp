@@ -0,0 +1,720 @@
+#include "TL/Runtime/TensorIO.hpp"
+#include "TL/Runtime/ThreadPool.hpp"
+#include <torch/torch.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tl {
+
+    namespace tensor_io {
+
+    namespace {
+
+    // .tlt layout, all fields little-endian:
+    //   char magic[4] "TLT1", uint32 dtype code, uint32 rank, uint32 reserved,
+    //   uint64 data offset, int64 shape[rank], int64 strides[rank], padding,
+    //   data at the offset (a multiple of kAlignment)
+    constexpr char kTltMagic[4] = {'T', 'L', 'T', '1'};
+    constexpr size_t kTltFixedHeader = 24;
+    constexpr char kNpyMagic[6] = {'\x93', 'N', 'U', 'M', 'P', 'Y'};
+    constexpr size_t kAlignment = 64;
+
+    struct DTypeInfo {
+        torch::ScalarType type;
+        uint32_t tltCode;
+        const char* npyDescr;  // nullptr if NumPy has no such type
+    };
+
+    constexpr DTypeInfo kDTypes[] = {
+        {torch::kFloat32, 0, "<f4"},
+        {torch::kFloat64, 1, "<f8"},
+        {torch::kFloat16, 2, "<f2"},
+        {torch::kBFloat16, 3, nullptr},
+        {torch::kInt64, 4, "<i8"},
+        {torch::kInt32, 5, "<i4"},
+        {torch::kInt16, 6, "<i2"},
+        {torch::kInt8, 7, "|i1"},
+        {torch::kUInt8, 8, "|u1"},
+        {torch::kBool, 9, "|b1"},
+    };
+
+    const DTypeInfo& infoFor(torch::ScalarType type) {
+        for (const auto& info : kDTypes) {
+            if (info.type == type) return info;
+        }
+        throw std::runtime_error(std::string("Tensor files cannot store dtype ") + c10::toString(type));
+    }
+
+    // Bytes of a file, mapped copy-on-write where the platform allows it
+    struct FileBytes {
+        const char* data{nullptr};
+        size_t size{0};
+        bool mapped{false};
+        std::vector<char> owned;  // read fallback
+
+        ~FileBytes() {
+#ifndef _WIN32
+            if (mapped) munmap(const_cast<char*>(data), size);
+#endif
+        }
+    };
+
+    std::shared_ptr<FileBytes> load(const std::filesystem::path& path) {
+        auto bytes = std::make_shared<FileBytes>();
+#ifndef _WIN32
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open file for reading: " + path.string());
+        struct stat st {};
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* base = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (base != MAP_FAILED) {
+                bytes->data = static_cast<const char*>(base);
+                bytes->size = static_cast<size_t>(st.st_size);
+                bytes->mapped = true;
+            }
+        }
+        ::close(fd);
+        if (bytes->mapped) return bytes;
+#endif
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) throw std::runtime_error("Cannot open file for reading: " + path.string());
+        bytes->owned.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        bytes->data = bytes->owned.data();
+        bytes->size = bytes->owned.size();
+        return bytes;
+    }
+
+    template <typename T>
+    T readField(const FileBytes& bytes, size_t offset, const std::filesystem::path& path) {
+        if (offset + sizeof(T) > bytes.size) throw std::runtime_error("Truncated tensor file: " + path.string());
+        T value;
+        std::memcpy(&value, bytes.data + offset, sizeof(T));
+        return value;
+    }
+
+    // Wraps the data of a binary file; the tensor keeps the file bytes alive
+    Tensor wrap(const std::shared_ptr<FileBytes>& bytes, size_t offset, torch::ScalarType type,
+                const std::vector<int64_t>& shape, const std::vector<int64_t>& strides,
+                const std::filesystem::path& path) {
+        const size_t itemSize = c10::elementSize(type);
+        size_t span = 1;
+        for (size_t d = 0; d < shape.size(); ++d) {
+            if (shape[d] < 0 || strides[d] < 0) throw std::runtime_error("Negative shape or stride in: " + path.string());
+            if (shape[d] == 0) span = 0;
+        }
+        if (span != 0) {
+            for (size_t d = 0; d < shape.size(); ++d) span += static_cast<size_t>((shape[d] - 1) * strides[d]);
+        }
+        const size_t byteSpan = span * itemSize;
+        if (offset > bytes->size || byteSpan > bytes->size - offset) {
+            throw std::runtime_error("Tensor data extends past the end of: " + path.string());
+        }
+
+        const auto options = torch::TensorOptions().dtype(type);
+        const char* data = bytes->data + offset;
+        if (reinterpret_cast<uintptr_t>(data) % itemSize == 0) {
+            const std::function<void(void*)> release = [bytes](void*) {};
+            return torch::from_blob(const_cast<char*>(data), shape, strides, release, options);
+        }
+        // Misaligned data cannot be viewed in place
+        Tensor owned = torch::empty({static_cast<int64_t>(byteSpan)}, torch::kUInt8);
+        std::memcpy(owned.data_ptr(), data, byteSpan);
+        const std::function<void(void*)> release = [owned](void*) {};
+        return torch::from_blob(owned.data_ptr(), shape, strides, release, options);
+    }
+
+    // A .tlt file, or a record embedded in a file at `base` whose data offset counts from there
+    Tensor readTlt(const std::shared_ptr<FileBytes>& bytes, const std::filesystem::path& path, size_t base = 0) {
+        if (base > bytes->size || bytes->size - base < kTltFixedHeader ||
+            std::memcmp(bytes->data + base, kTltMagic, sizeof(kTltMagic)) != 0) {
+            throw std::runtime_error("Not a .tlt tensor file: " + path.string());
+        }
+        const uint32_t code = readField<uint32_t>(*bytes, base + 4, path);
+        const uint32_t rank = readField<uint32_t>(*bytes, base + 8, path);
+        const uint64_t offset = readField<uint64_t>(*bytes, base + 16, path);
+        const DTypeInfo* info = nullptr;
+        for (const auto& candidate : kDTypes) {
+            if (candidate.tltCode == code) info = &candidate;
+        }
+        if (!info) throw std::runtime_error("Unknown dtype code " + std::to_string(code) + " in: " + path.string());
+        std::vector<int64_t> shape(rank), strides(rank);
+        for (uint32_t d = 0; d < rank; ++d) {
+            shape[d] = readField<int64_t>(*bytes, base + kTltFixedHeader + 8 * d, path);
+            strides[d] = readField<int64_t>(*bytes, base + kTltFixedHeader + 8 * (rank + d), path);
+        }
+        if (offset > bytes->size - base) throw std::runtime_error("Tensor data extends past the end of: " + path.string());
+        return wrap(bytes, base + offset, info->type, shape, strides, path);
+    }
+
+    // Value of 'key': ... in a NumPy header dictionary, up to the next top-level comma
+    std::string npyField(const std::string& header, const std::string& key, const std::filesystem::path& path) {
+        const size_t at = header.find("'" + key + "'");
+        if (at == std::string::npos) throw std::runtime_error("NumPy header has no '" + key + "': " + path.string());
+        size_t pos = header.find(':', at);
+        if (pos == std::string::npos) throw std::runtime_error("Malformed NumPy header: " + path.string());
+        ++pos;
+        while (pos < header.size() && std::isspace(static_cast<unsigned char>(header[pos]))) ++pos;
+        size_t end = pos;
+        if (end < header.size() && header[end] == '(') {
+            end = header.find(')', end);
+            if (end == std::string::npos) throw std::runtime_error("Malformed NumPy header: " + path.string());
+            return header.substr(pos, end + 1 - pos);
+        }
+        while (end < header.size() && header[end] != ',' && header[end] != '}') ++end;
+        std::string value = header.substr(pos, end - pos);
+        while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) value.pop_back();
+        return value;
+    }
+
+    Tensor readNpy(const std::shared_ptr<FileBytes>& bytes, const std::filesystem::path& path) {
+        if (bytes->size < 10 || std::memcmp(bytes->data, kNpyMagic, sizeof(kNpyMagic)) != 0) {
+            throw std::runtime_error("Not a .npy file: " + path.string());
+        }
+        const uint8_t major = static_cast<uint8_t>(bytes->data[6]);
+        size_t headerStart = 10;
+        size_t headerLength = readField<uint16_t>(*bytes, 8, path);
+        if (major >= 2) {
+            headerStart = 12;
+            headerLength = readField<uint32_t>(*bytes, 8, path);
+        }
+        if (headerStart + headerLength > bytes->size) throw std::runtime_error("Truncated .npy file: " + path.string());
+        const std::string header(bytes->data + headerStart, headerLength);
+
+        std::string descr = npyField(header, "descr", path);
+        if (descr.size() < 2 || (descr.front() != '\'' && descr.front() != '"')) {
+            throw std::runtime_error("Unsupported NumPy dtype " + descr + " in: " + path.string());
+        }
+        descr = descr.substr(1, descr.size() - 2);
+        if (descr.size() == 3 && descr[0] == '=') descr[0] = '<';
+        if (descr == "<b1" || descr == "<u1" || descr == "<i1") descr[0] = '|';
+        const DTypeInfo* info = nullptr;
+        for (const auto& candidate : kDTypes) {
+            if (candidate.npyDescr && descr == candidate.npyDescr) info = &candidate;
+        }
+        if (!info) throw std::runtime_error("Unsupported NumPy dtype '" + descr + "' in: " + path.string());
+
+        const bool fortran = npyField(header, "fortran_order", path) == "True";
+        const std::string shapeText = npyField(header, "shape", path);
+        std::vector<int64_t> shape;
+        for (size_t pos = 1; pos < shapeText.size();) {
+            while (pos < shapeText.size() && !std::isdigit(static_cast<unsigned char>(shapeText[pos]))) ++pos;
+            if (pos >= shapeText.size()) break;
+            size_t end = pos;
+            while (end < shapeText.size() && std::isdigit(static_cast<unsigned char>(shapeText[end]))) ++end;
+            shape.push_back(std::stoll(shapeText.substr(pos, end - pos)));
+            pos = end;
+        }
+
+        std::vector<int64_t> strides(shape.size());
+        int64_t step = 1;
+        for (size_t i = 0; i < shape.size(); ++i) {
+            const size_t d = fortran ? i : shape.size() - 1 - i;
+            strides[d] = step;
+            step *= std::max<int64_t>(shape[d], 1);
+        }
+        return wrap(bytes, headerStart + headerLength, info->type, shape, strides, path);
+    }
+
+    // Text is parsed in chunks that split the file at line boundaries. A
+    // first pass counts each chunk's rows, so every chunk then parses
+    // straight into its own rows of the output tensor.
+    constexpr size_t kMinTextChunk = size_t{1} << 20;
+
+    bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    // Line [begin, end) without surrounding blanks
+    void trim(const char*& begin, const char*& end) {
+        while (begin < end && isBlank(*begin)) ++begin;
+        while (end > begin && isBlank(end[-1])) --end;
+    }
+
+    // Calls fn(begin, end) for every non-blank line of [begin, end)
+    template <typename Fn>
+    void forEachLine(const char* begin, const char* end, Fn&& fn) {
+        while (begin < end) {
+            const char* newline = static_cast<const char*>(std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+            const char* lineEnd = newline ? newline : end;
+            const char* b = begin;
+            const char* e = lineEnd;
+            trim(b, e);
+            if (b < e) fn(b, e);
+            begin = newline ? newline + 1 : end;
+        }
+    }
+
+    // An empty field reads as 0, as a missing CSV value
+    float parseNumber(const char* begin, const char* end, int64_t row, const std::filesystem::path& path) {
+        trim(begin, end);
+        if (begin == end) return 0.0f;
+        if (*begin == '+') ++begin;
+        float value = 0.0f;
+        bool ok = false;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        const auto [ptr, ec] = std::from_chars(begin, end, value);
+        ok = ec == std::errc() && ptr == end;
+#else
+        const std::string token(begin, end);
+        char* parsed = nullptr;
+        value = std::strtof(token.c_str(), &parsed);
+        ok = parsed == token.c_str() + token.size();
+#endif
+        if (!ok) {
+            throw std::runtime_error("Invalid number '" + std::string(begin, end) + "' in row " +
+                                     std::to_string(row + 1) + " of: " + path.string());
+        }
+        return value;
+    }
+
+    // Parses the non-blank lines of [begin, end) into out, `columns` values
+    // per line (one number per line unless csv). Rows are numbered from
+    // firstRow in error messages.
+    void parseRows(const char* begin, const char* end, bool csv, int64_t columns, int64_t firstRow, float* out,
+                   const std::filesystem::path& path) {
+        int64_t row = firstRow;
+        forEachLine(begin, end, [&](const char* b, const char* e) {
+            float* dst = out + (row - firstRow) * columns;
+            if (!csv) {
+                *dst = parseNumber(b, e, row, path);
+                ++row;
+                return;
+            }
+            int64_t column = 0;
+            for (const char* field = b;; ++column) {
+                const char* comma = static_cast<const char*>(std::memchr(field, ',', static_cast<size_t>(e - field)));
+                const char* fieldEnd = comma ? comma : e;
+                if (column < columns) dst[column] = parseNumber(field, fieldEnd, row, path);
+                if (!comma) break;
+                field = comma + 1;
+            }
+            if (column + 1 != columns) {
+                throw std::runtime_error("CSV has inconsistent number of columns in: " + path.string() +
+                                         " (row " + std::to_string(row + 1) + " has " + std::to_string(column + 1) +
+                                         ", expected " + std::to_string(columns) + ")");
+            }
+            ++row;
+        });
+    }
+
+    Tensor readText(const std::filesystem::path& path, size_t threads) {
+        const auto bytes = load(path);
+        const char* const data = bytes->data;
+        const size_t size = bytes->size;
+
+        // Chunk boundaries fall just after a newline
+        const bool shared = threads == 0;
+        if (shared) threads = ThreadPool::defaultThreads();
+        const size_t chunks = std::max<size_t>(1, std::min(threads, size / kMinTextChunk));
+        std::vector<const char*> bounds{data};
+        for (size_t c = 1; c < chunks; ++c) {
+            const char* at = std::max(bounds.back(), data + size * c / chunks);
+            const char* newline = static_cast<const char*>(std::memchr(at, '\n', static_cast<size_t>(data + size - at)));
+            bounds.push_back(newline ? newline + 1 : data + size);
+        }
+        bounds.push_back(data + size);
+
+        std::shared_ptr<ThreadPool> pool;
+        if (chunks > 1) ThreadPool::obtain(pool, shared ? 0 : chunks);
+        auto parallel = [&](const std::function<void(size_t)>& fn) {
+            if (pool) {
+                pool->parallelFor(chunks, fn);
+            } else {
+                fn(0);
+            }
+        };
+
+        struct ChunkInfo {
+            int64_t rows{0};
+            int64_t firstColumns{0};
+            bool comma{false};
+        };
+        std::vector<ChunkInfo> info(chunks);
+        parallel([&](size_t c) {
+            auto& chunk = info[c];
+            forEachLine(bounds[c], bounds[c + 1], [&](const char* b, const char* e) {
+                if (chunk.rows++ == 0) chunk.firstColumns = 1 + std::count(b, e, ',');
+                chunk.comma = chunk.comma || std::memchr(b, ',', static_cast<size_t>(e - b)) != nullptr;
+            });
+        });
+
+        std::vector<int64_t> firstRow(chunks + 1, 0);
+        bool csv = false;
+        int64_t columns = 0;
+        for (size_t c = 0; c < chunks; ++c) {
+            firstRow[c + 1] = firstRow[c] + info[c].rows;
+            csv = csv || info[c].comma;
+            if (columns == 0 && info[c].rows > 0) columns = info[c].firstColumns;
+        }
+        const int64_t rows = firstRow[chunks];
+        if (rows == 0) return torch::zeros({0});
+
+        // One number per line unless some line has a comma
+        if (!csv) columns = 1;
+        Tensor out = csv ? torch::empty({rows, columns}, torch::kFloat32) : torch::empty({rows}, torch::kFloat32);
+        float* const values = out.data_ptr<float>();
+        parallel([&](size_t c) {
+            parseRows(bounds[c], bounds[c + 1], csv, columns, firstRow[c], values + firstRow[c] * columns, path);
+        });
+        return out;
+    }
+
+    std::ofstream openForWriting(const std::filesystem::path& path, std::ios::openmode mode) {
+        const std::filesystem::path parent = path.parent_path();
+        if (!parent.empty()) {
+            std::error_code ec;
+            std::filesystem::create_directories(parent, ec);
+        }
+        std::ofstream ofs(path, mode);
+        if (!ofs) throw std::runtime_error("Cannot open file for writing: " + path.string());
+        return ofs;
+    }
+
+    void writeData(std::ofstream& ofs, const Tensor& contig, const std::filesystem::path& path) {
+        ofs.write(static_cast<const char*>(contig.data_ptr()), static_cast<std::streamsize>(contig.nbytes()));
+        if (!ofs) throw std::runtime_error("Failed writing tensor data to: " + path.string());
+    }
+
+    std::vector<char> tltHeader(const Tensor& contig) {
+        const DTypeInfo& info = infoFor(contig.scalar_type());
+        const uint32_t rank = static_cast<uint32_t>(contig.dim());
+        const size_t headerSize = kTltFixedHeader + 16 * static_cast<size_t>(rank);
+        const uint64_t offset = (headerSize + kAlignment - 1) / kAlignment * kAlignment;
+
+        std::vector<char> header(offset, 0);
+        std::memcpy(header.data(), kTltMagic, sizeof(kTltMagic));
+        std::memcpy(header.data() + 4, &info.tltCode, sizeof(uint32_t));
+        std::memcpy(header.data() + 8, &rank, sizeof(uint32_t));
+        std::memcpy(header.data() + 16, &offset, sizeof(uint64_t));
+        for (uint32_t d = 0; d < rank; ++d) {
+            const int64_t size = contig.size(d);
+            const int64_t stride = contig.stride(d);
+            std::memcpy(header.data() + kTltFixedHeader + 8 * d, &size, sizeof(int64_t));
+            std::memcpy(header.data() + kTltFixedHeader + 8 * (rank + d), &stride, sizeof(int64_t));
+        }
+        return header;
+    }
+
+    void writeTlt(const std::filesystem::path& path, const Tensor& contig) {
+        const std::vector<char> header = tltHeader(contig);
+        std::ofstream ofs = openForWriting(path, std::ios::binary);
+        ofs.write(header.data(), static_cast<std::streamsize>(header.size()));
+        writeData(ofs, contig, path);
+    }
+
+    const DTypeInfo& npyInfoFor(torch::ScalarType type) {
+        const DTypeInfo& info = infoFor(type);
+        if (!info.npyDescr) {
+            throw std::runtime_error(std::string("NumPy files cannot store dtype ") + c10::toString(type));
+        }
+        return info;
+    }
+
+    // Characters reserved for the row count of a streamed .npy file
+    constexpr size_t kNpyRowsWidth = 20;
+
+    // Version 1.0 header of a C-order array, padded so the data starts on an
+    // aligned offset. The first extent is padded to firstWidth characters so
+    // a streamed file can rewrite it in place.
+    std::string npyHeader(const DTypeInfo& info, const std::vector<int64_t>& shape, size_t firstWidth = 0) {
+        std::string dict = std::string("{'descr': '") + info.npyDescr + "', 'fortran_order': False, 'shape': (";
+        for (size_t d = 0; d < shape.size(); ++d) {
+            std::string extent = std::to_string(shape[d]);
+            if (d == 0 && extent.size() < firstWidth) extent.insert(0, firstWidth - extent.size(), ' ');
+            dict += extent;
+            if (shape.size() == 1 || d + 1 < shape.size()) dict += ",";
+            if (d + 1 < shape.size()) dict += " ";
+        }
+        dict += "), }";
+        // The header ends in a newline
+        const size_t unpadded = sizeof(kNpyMagic) + 4 + dict.size() + 1;
+        dict.append((kAlignment - unpadded % kAlignment) % kAlignment, ' ');
+        dict += '\n';
+        const uint16_t length = static_cast<uint16_t>(dict.size());
+
+        std::string header(kNpyMagic, sizeof(kNpyMagic));
+        header += '\x01';
+        header += '\x00';
+        header.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        return header + dict;
+    }
+
+    void writeNpy(const std::filesystem::path& path, const Tensor& contig) {
+        const std::string header = npyHeader(npyInfoFor(contig.scalar_type()), contig.sizes().vec());
+        std::ofstream ofs = openForWriting(path, std::ios::binary);
+        ofs.write(header.data(), static_cast<std::streamsize>(header.size()));
+        writeData(ofs, contig, path);
+    }
+
+    // Values are formatted into a block that is flushed once it fills, so
+    // memory stays bounded for tensors of any size
+    constexpr size_t kTextBlock = size_t{1} << 20;
+
+    template <typename T>
+    char* formatNumber(char* first, char* last, T value) {
+        if constexpr (std::is_floating_point_v<T>) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+            // Shortest text that reads back as the same value
+            return std::to_chars(first, last, value).ptr;
+#else
+            const int digits = std::is_same_v<T, float> ? 9 : 17;
+            const int n = std::snprintf(first, static_cast<size_t>(last - first), "%.*g", digits, static_cast<double>(value));
+            return first + n;
+#endif
+        } else {
+            return std::to_chars(first, last, value).ptr;
+        }
+    }
+
+    // Writes n values, `columns` per line, without a trailing newline
+    template <typename T>
+    void formatValues(std::ostream& os, const T* values, int64_t n, int64_t columns) {
+        std::string block;
+        block.reserve(kTextBlock + 64);
+        char number[64];
+        for (int64_t i = 0; i < n; ++i) {
+            if (i) block += (i % columns) ? ',' : '\n';
+            block.append(number, formatNumber(number, number + sizeof(number), values[i]));
+            if (block.size() >= kTextBlock) {
+                os.write(block.data(), static_cast<std::streamsize>(block.size()));
+                block.clear();
+            }
+        }
+        os.write(block.data(), static_cast<std::streamsize>(block.size()));
+    }
+
+    void writeText(const std::filesystem::path& path, const Tensor& contig) {
+        std::ofstream ofs = openForWriting(path, std::ios::out);
+        format(ofs, contig);
+        if (contig.dim() == 0) ofs << "\n";
+        if (!ofs) throw std::runtime_error("Failed writing tensor data to: " + path.string());
+    }
+
+    } // namespace
+
+    Format formatFor(const std::filesystem::path& path) {
+        std::string ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (ext == ".tlt") return Format::Tlt;
+        if (ext == ".npy") return Format::Npy;
+        return Format::Text;
+    }
+
+    Tensor read(const std::filesystem::path& path, size_t threads) {
+        switch (formatFor(path)) {
+            case Format::Tlt: return readTlt(load(path), path);
+            case Format::Npy: return readNpy(load(path), path);
+            case Format::Text: break;
+        }
+        return readText(path, threads);
+    }
+
+    void format(std::ostream& os, const Tensor& t) {
+        Tensor host = t.detach().cpu().contiguous();
+        // Narrow floating types print as float32, bool as 0 and 1
+        if (host.scalar_type() == torch::kHalf || host.scalar_type() == torch::kBFloat16) {
+            host = host.to(torch::kFloat32);
+        } else if (host.scalar_type() == torch::kBool) {
+            host = host.to(torch::kUInt8);
+        }
+        const int64_t n = host.numel();
+        const int64_t columns = host.dim() == 2 ? std::max<int64_t>(1, host.size(1)) : 1;
+        switch (host.scalar_type()) {
+            case torch::kFloat32: return formatValues(os, host.data_ptr<float>(), n, columns);
+            case torch::kFloat64: return formatValues(os, host.data_ptr<double>(), n, columns);
+            case torch::kInt64: return formatValues(os, host.data_ptr<int64_t>(), n, columns);
+            case torch::kInt32: return formatValues(os, host.data_ptr<int32_t>(), n, columns);
+            case torch::kInt16: return formatValues(os, host.data_ptr<int16_t>(), n, columns);
+            case torch::kInt8: return formatValues(os, host.data_ptr<int8_t>(), n, columns);
+            case torch::kUInt8: return formatValues(os, host.data_ptr<uint8_t>(), n, columns);
+            default:
+                throw std::runtime_error(std::string("Text cannot store dtype ") + c10::toString(host.scalar_type()));
+        }
+    }
+
+    void write(const std::filesystem::path& path, const Tensor& t) {
+        // A single copy to the host instead of one transfer per element
+        const Tensor contig = t.detach().cpu().contiguous();
+        switch (formatFor(path)) {
+            case Format::Tlt: return writeTlt(path, contig);
+            case Format::Npy: return writeNpy(path, contig);
+            case Format::Text: break;
+        }
+        writeText(path, contig);
+    }
+
+    uint64_t writeRecord(std::ostream& os, const Tensor& t) {
+        const Tensor contig = t.detach().cpu().contiguous();
+        const std::vector<char> header = tltHeader(contig);
+        const uint64_t size = header.size() + contig.nbytes();
+        const std::vector<char> padding((kAlignment - size % kAlignment) % kAlignment, 0);
+        os.write(header.data(), static_cast<std::streamsize>(header.size()));
+        os.write(static_cast<const char*>(contig.data_ptr()), static_cast<std::streamsize>(contig.nbytes()));
+        os.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+        if (!os) throw std::runtime_error("Failed writing tensor record");
+        return size + padding.size();
+    }
+
+    std::vector<Tensor> readRecords(const std::filesystem::path& path, const std::vector<uint64_t>& offsets) {
+        const auto bytes = load(path);
+        std::vector<Tensor> tensors;
+        tensors.reserve(offsets.size());
+        for (uint64_t offset : offsets) tensors.push_back(readTlt(bytes, path, static_cast<size_t>(offset)));
+        return tensors;
+    }
+
+    ChunkReader::ChunkReader(const std::filesystem::path& path, int64_t rows)
+        : path_(path), rows_(rows), format_(formatFor(path)) {
+        if (rows <= 0) throw std::invalid_argument("Tensor chunks must have a positive number of rows");
+        if (format_ == Format::Text) {
+            text_.open(path);
+            if (!text_) throw std::runtime_error("Cannot open file for reading: " + path.string());
+            return;
+        }
+        const auto bytes = load(path);
+        whole_ = format_ == Format::Tlt ? readTlt(bytes, path) : readNpy(bytes, path);
+        if (whole_.dim() == 0) throw std::runtime_error("Cannot read a 0-d tensor in chunks: " + path.string());
+        // Misaligned data was copied out of the mapping
+        const char* data = static_cast<const char*>(whole_.data_ptr());
+        mapped_ = bytes->mapped && data >= bytes->data && data < bytes->data + bytes->size;
+    }
+
+    std::optional<Tensor> ChunkReader::next() {
+        if (format_ == Format::Text) return nextText();
+        releaseConsumed();
+        if (position_ >= whole_.size(0)) return std::nullopt;
+        const int64_t n = std::min(rows_, whole_.size(0) - position_);
+        Tensor chunk = whole_.narrow(0, position_, n);
+        position_ += n;
+        return chunk;
+    }
+
+    std::optional<Tensor> ChunkReader::nextText() {
+        lines_.clear();
+        int64_t count = 0;
+        while (count < rows_ && std::getline(text_, line_)) {
+            const char* b = line_.data();
+            const char* e = b + line_.size();
+            trim(b, e);
+            if (b == e) continue;
+            // The first row decides the layout
+            if (columns_ == 0) {
+                csv_ = std::memchr(b, ',', static_cast<size_t>(e - b)) != nullptr;
+                columns_ = csv_ ? 1 + std::count(b, e, ',') : 1;
+            }
+            lines_.append(b, e);
+            lines_ += '\n';
+            ++count;
+        }
+        if (count == 0) return std::nullopt;
+        Tensor chunk = csv_ ? torch::empty({count, columns_}, torch::kFloat32) : torch::empty({count}, torch::kFloat32);
+        parseRows(lines_.data(), lines_.data() + lines_.size(), csv_, columns_, position_, chunk.data_ptr<float>(), path_);
+        position_ += count;
+        return chunk;
+    }
+
+    void ChunkReader::releaseConsumed() {
+#ifndef _WIN32
+        if (!mapped_ || position_ == 0 || !whole_.is_contiguous()) return;
+        // Whole pages of returned rows only; a page shared with the next row stays
+        const size_t rowBytes = static_cast<size_t>(whole_.numel() / whole_.size(0)) * whole_.element_size();
+        const uintptr_t page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+        const uintptr_t base = reinterpret_cast<uintptr_t>(whole_.data_ptr());
+        const uintptr_t begin = (base + released_ + page - 1) / page * page;
+        const uintptr_t end = (base + static_cast<size_t>(position_) * rowBytes) / page * page;
+        if (end > begin) {
+            ::madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+            released_ = end - base;
+        }
+#endif
+    }
+
+    ChunkWriter::ChunkWriter(const std::filesystem::path& path)
+        : path_(path), format_(formatFor(path)),
+          out_(openForWriting(path, format_ == Format::Text ? std::ios::out : std::ios::binary)) {}
+
+    ChunkWriter::~ChunkWriter() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    void ChunkWriter::append(const Tensor& chunk) {
+        if (!open_) throw std::runtime_error("Tensor file already closed: " + path_.string());
+        const Tensor contig = chunk.detach().cpu().contiguous();
+        if (contig.dim() == 0) throw std::runtime_error("Cannot append a 0-d chunk to: " + path_.string());
+        const std::vector<int64_t> trailing(contig.sizes().begin() + 1, contig.sizes().end());
+        if (!started_) {
+            started_ = true;
+            type_ = contig.scalar_type();
+            trailing_ = trailing;
+            if (format_ == Format::Tlt) {
+                const std::vector<char> header = tltHeader(contig);
+                out_.write(header.data(), static_cast<std::streamsize>(header.size()));
+            } else if (format_ == Format::Npy) {
+                std::vector<int64_t> shape{0};
+                shape.insert(shape.end(), trailing_.begin(), trailing_.end());
+                const std::string header = npyHeader(npyInfoFor(type_), shape, kNpyRowsWidth);
+                out_.write(header.data(), static_cast<std::streamsize>(header.size()));
+            }
+        } else if (contig.scalar_type() != type_ || trailing != trailing_) {
+            throw std::runtime_error("Chunk dtype or shape differs from the first chunk of: " + path_.string());
+        }
+        if (contig.size(0) == 0) return;
+
+        if (format_ == Format::Text) {
+            if (rows_ > 0) out_ << '\n';
+            format(out_, contig);
+            if (!out_) throw std::runtime_error("Failed writing tensor data to: " + path_.string());
+        } else {
+            writeData(out_, contig, path_);
+        }
+        rows_ += contig.size(0);
+    }
+
+    void ChunkWriter::close() {
+        if (!open_) return;
+        open_ = false;
+        if (!started_) {
+            out_.close();
+            write(path_, torch::zeros({0}));
+            return;
+        }
+        // Patch the row count into the header
+        if (format_ == Format::Tlt) {
+            out_.seekp(static_cast<std::streamoff>(kTltFixedHeader));
+            out_.write(reinterpret_cast<const char*>(&rows_), sizeof(rows_));
+        } else if (format_ == Format::Npy) {
+            std::vector<int64_t> shape{rows_};
+            shape.insert(shape.end(), trailing_.begin(), trailing_.end());
+            const std::string header = npyHeader(npyInfoFor(type_), shape, kNpyRowsWidth);
+            out_.seekp(0);
+            out_.write(header.data(), static_cast<std::streamsize>(header.size()));
+        }
+        out_.close();
+        if (!out_) throw std::runtime_error("Failed writing tensor data to: " + path_.string());
+    }
+
+    } // namespace tensor_io
+
+} // namespace tl
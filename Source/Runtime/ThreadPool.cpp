@@ -0,0 +1,295 @@
+#include "TL/Runtime/ThreadPool.hpp"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace tl {
+
+namespace {
+// Set while a thread executes loop bodies, so nested loops run inline
+thread_local bool t_inParallelLoop = false;
+
+struct GlobalState {
+    std::mutex mutex;
+    ThreadOptions options;
+    std::shared_ptr<ThreadPool> shared;
+    std::vector<int> cores;  // pinning order; empty when workers are not pinned
+};
+
+GlobalState& globalState() {
+    static GlobalState state;
+    return state;
+}
+
+#ifdef __linux__
+// "0-3,8,10-11" as in /sys/devices/system/node/node*/cpulist
+std::vector<int> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream ss(text);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty()) continue;
+        const size_t dash = range.find('-');
+        try {
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int c = first; c <= last; ++c) cpus.push_back(c);
+        } catch (const std::exception&) {
+            return {};
+        }
+    }
+    return cpus;
+}
+
+// Cores this process may run on, grouped by NUMA node in node order. A
+// machine without the sysfs node directory is one node.
+std::vector<std::vector<int>> coresByNode() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return {};
+    auto isAllowed = [&](int c) { return c >= 0 && c < CPU_SETSIZE && CPU_ISSET(c, &allowed); };
+
+    std::map<int, std::vector<int>> nodes;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+            !std::all_of(name.begin() + 4, name.end(), [](unsigned char ch) { return std::isdigit(ch); })) {
+            continue;
+        }
+        std::ifstream in(entry.path() / "cpulist");
+        std::string list;
+        std::getline(in, list);
+        std::vector<int>& cores = nodes[std::stoi(name.substr(4))];
+        for (int c : parseCpuList(list)) {
+            if (isAllowed(c)) cores.push_back(c);
+        }
+    }
+
+    std::vector<std::vector<int>> grouped;
+    for (auto& [node, cores] : nodes) {
+        if (!cores.empty()) grouped.push_back(std::move(cores));
+    }
+    if (grouped.empty()) {
+        grouped.emplace_back();
+        for (int c = 0; c < CPU_SETSIZE; ++c) {
+            if (isAllowed(c)) grouped.back().push_back(c);
+        }
+    }
+    return grouped;
+}
+#endif
+
+std::vector<int> pinningOrder(NumaPolicy policy) {
+    std::vector<int> order;
+#ifdef __linux__
+    const auto nodes = coresByNode();
+    if (policy == NumaPolicy::Spread) {
+        for (size_t i = 0;; ++i) {
+            bool any = false;
+            for (const auto& cores : nodes) {
+                if (i < cores.size()) {
+                    order.push_back(cores[i]);
+                    any = true;
+                }
+            }
+            if (!any) break;
+        }
+    } else {
+        for (const auto& cores : nodes) order.insert(order.end(), cores.begin(), cores.end());
+        if (policy == NumaPolicy::None) std::sort(order.begin(), order.end());
+    }
+#else
+    (void)policy;
+#endif
+    return order;
+}
+
+void pinCurrentThread(int core) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    // Best effort: a core taken away since configure() leaves the thread unpinned
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)core;
+#endif
+}
+}
+
+NumaPolicy parseNumaPolicy(const std::string& name) {
+    if (name == "none") return NumaPolicy::None;
+    if (name == "compact") return NumaPolicy::Compact;
+    if (name == "spread") return NumaPolicy::Spread;
+    throw std::invalid_argument("Unknown NUMA policy '" + name + "' (expected none, compact or spread)");
+}
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) threads = defaultThreads();
+    std::vector<int> cores;
+    {
+        GlobalState& state = globalState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        cores = state.cores;
+    }
+    // Worker i takes the i-th core; the first is left to the calling thread
+    workers_.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i) {
+        const int core = cores.empty() ? -1 : cores[i % cores.size()];
+        workers_.emplace_back([this, core] {
+            if (core >= 0) pinCurrentThread(core);
+            workerLoop();
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& w : workers_) w.join();
+}
+
+void ThreadPool::runIndices() {
+    const bool wasInLoop = t_inParallelLoop;
+    t_inParallelLoop = true;
+    while (true) {
+        const size_t i = next_index_.fetch_add(1);
+        if (i >= job_count_) break;
+        try {
+            (*job_)(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = std::current_exception();
+        }
+    }
+    t_inParallelLoop = wasInLoop;
+}
+
+void ThreadPool::workerLoop() {
+    size_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait(lock, [&] { return stop_ || generation_ != seenGeneration; });
+            if (stop_) return;
+            seenGeneration = generation_;
+            ++busy_workers_;
+        }
+        runIndices();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --busy_workers_;
+        }
+        done_cv_.notify_all();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
+    if (workers_.empty() || count == 1 || t_inParallelLoop) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+
+    // Another caller owns the workers: splitting this loop would only wait
+    // for that one, so run it here and leave the pool's budget as it is
+    std::unique_lock<std::mutex> submit(submit_mutex_, std::try_to_lock);
+    if (!submit) {
+        const bool wasInLoop = t_inParallelLoop;
+        t_inParallelLoop = true;
+        try {
+            for (size_t i = 0; i < count; ++i) fn(i);
+        } catch (...) {
+            t_inParallelLoop = wasInLoop;
+            throw;
+        }
+        t_inParallelLoop = wasInLoop;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &fn;
+        job_count_ = count;
+        next_index_.store(0);
+        error_ = nullptr;
+        ++generation_;
+    }
+    work_cv_.notify_all();
+    runIndices();
+
+    std::exception_ptr error;
+    {
+        // Workers that woke up late see no indices left and leave at once
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [&] { return busy_workers_ == 0; });
+        job_ = nullptr;
+        error = error_;
+        error_ = nullptr;
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void ThreadPool::configure(const ThreadOptions& options) {
+    const bool pin = options.pin || options.numa != NumaPolicy::None;
+    std::vector<int> cores = pin ? pinningOrder(options.numa) : std::vector<int>{};
+    std::shared_ptr<ThreadPool> previous;
+    {
+        GlobalState& state = globalState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.options = options;
+        state.options.pin = pin;
+        state.cores = std::move(cores);
+        previous = std::move(state.shared);
+    }
+    // Joined outside the lock, or right away when nobody else holds it
+    previous.reset();
+}
+
+ThreadOptions ThreadPool::options() {
+    GlobalState& state = globalState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.options;
+}
+
+size_t ThreadPool::defaultThreads() {
+    size_t threads = options().intraOp;
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    return threads == 0 ? 1 : threads;
+}
+
+std::shared_ptr<ThreadPool> ThreadPool::shared() {
+    GlobalState& state = globalState();
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.shared) return state.shared;
+    }
+    // Built unlocked, since the constructor reads the options; a racing
+    // caller's pool is dropped in favour of the first one stored
+    auto pool = std::make_shared<ThreadPool>();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.shared) state.shared = std::move(pool);
+    return state.shared;
+}
+
+void ThreadPool::obtain(std::shared_ptr<ThreadPool>& pool, size_t threads) {
+    if (threads == 0) {
+        pool = shared();
+    } else if (!pool || pool->size() != threads) {
+        pool = std::make_shared<ThreadPool>(threads);
+    }
+}
+
+} // namespace tl
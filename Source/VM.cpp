@@ -12,77 +12,390 @@
 #include "TL/Runtime/Preprocessors/VirtualIndexPreprocessor.hpp"
 #include "TL/Runtime/DatalogEngine.hpp"
 #include "TL/Runtime/ExecutorUtils.hpp"
+#include "TL/Runtime/RelationIO.hpp"
+#include "TL/Runtime/Snapshot.hpp"
+#include "TL/Runtime/TensorIO.hpp"
 
 #include <stdexcept>
 #include <torch/torch.h>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <map>
+#include <cmath>
 #include <cstdlib>
 #include <sstream>
 #include <cctype>
 #include <functional>
 #include <fstream>
 #include <filesystem>
+#include <optional>
+#include <type_traits>
+#include <unordered_set>
+
+// Debug line of this VM on its error stream, compiled out above TL_LOG_LEVEL
+#define VM_LOG(level, message) TL_LOG(level, debug_, *error_stream_, "[VM] " << message)
 
 namespace tl {
 
 // -------- Environment --------
 
-void Environment::bind(const std::string &name, const Tensor &t) {
-  tensors_[name] = t;
+namespace {
+// Copy to device; parameters stay leaves so their gradients keep accumulating
+Tensor toDevice(const Tensor &t, const torch::Device &device) {
+  if (!t.defined() || t.device() == device) return t;
+  if (t.is_leaf() && t.requires_grad()) {
+    return t.detach().to(device).requires_grad_(true);
+  }
+  return t.to(device);
 }
 
-void Environment::bind(const TensorRef &ref, const Tensor &t) {
-  bind(key(ref), t);
+// Ids of name tables; 0 marks an empty slot cache
+std::atomic<uint32_t> nextNameTable{1};
+} // namespace
+
+Environment::Names::Names() : id(nextNameTable++) {}
+
+Environment::Names::Names(const Names &other)
+    : id(nextNameTable++), index(other.index), names(other.names) {}
+
+Environment::Slot Environment::slot(const std::string &name) {
+  auto it = names_->index.find(name);
+  if (it != names_->index.end()) return it->second;
+  // Copies still sharing the table keep reading the old one
+  if (names_.use_count() > 1) names_ = std::make_shared<Names>(*names_);
+  const Slot s = static_cast<Slot>(names_->names.size());
+  names_->index.emplace(name, s);
+  names_->names.push_back(name);
+  return s;
 }
 
-bool Environment::has(const std::string &name) const {
-  return tensors_.find(name) != tensors_.end();
+Environment::Slot Environment::slot(const TensorRef &ref) {
+  Slot s = cachedSlot(ref);
+  if (s == kNoSlot) {
+    s = slot(ref.name.name);
+    cacheSlot(ref, s);
+  }
+  return s;
 }
 
-bool Environment::has(const TensorRef &ref) const { return has(key(ref)); }
+Environment::Slot Environment::findSlot(const std::string &name) const {
+  auto it = names_->index.find(name);
+  return it == names_->index.end() ? kNoSlot : it->second;
+}
 
-const Tensor &Environment::lookup(const std::string &name) const {
-  auto it = tensors_.find(name);
-  if (it == tensors_.end()) {
-    throw std::runtime_error("Environment: tensor not found: " + name);
+const std::string &Environment::slotName(Slot s) const { return names_->names.at(s); }
+
+Environment::Slot Environment::cachedSlot(const TensorRef &ref) const {
+  const uint64_t bits = ref.slot.bits.load(std::memory_order_relaxed);
+  return (bits >> 32) == names_->id ? static_cast<Slot>(bits) : kNoSlot;
+}
+
+void Environment::cacheSlot(const TensorRef &ref, Slot s) const {
+  ref.slot.bits.store((static_cast<uint64_t>(names_->id) << 32) | s, std::memory_order_relaxed);
+}
+
+void Environment::setDevice(const torch::Device &device) {
+  if (device == device_) return;
+  device_ = device;
+  for (auto &t : values_) t = toDevice(t, device_);
+  // Moved tensors no longer share the over-allocated storage
+  growth_storage_.clear();
+}
+
+void Environment::setDTypePolicy(const DTypePolicy &policy) {
+  if (policy == dtype_policy_) return;
+  dtype_policy_ = policy;
+  for (auto &t : values_) t = dtype_policy_.normalize(t);
+  growth_storage_.clear();
+}
+
+void Environment::bind(Slot s, const Tensor &in) {
+  Tensor t = toDevice(in, device_);
+  // The default policy leaves dtypes alone, as before policies existed
+  if (dtype_policy_ != DTypePolicy{}) t = dtype_policy_.normalize(t);
+  if (s >= values_.size()) {
+    if (s >= names_->names.size()) throw std::runtime_error("Environment: unknown slot " + std::to_string(s));
+    values_.resize(names_->names.size());
+    bound_.resize(names_->names.size(), 0);
   }
-  return it->second;
+  values_[s] = std::move(t);
+  if (!bound_[s]) {
+    bound_[s] = 1;
+    ++layout_version_;
+  }
+  if (!growth_storage_.empty()) {
+    auto it = growth_storage_.find(names_->names[s]);
+    const Tensor &v = values_[s];
+    if (it != growth_storage_.end() &&
+        (!v.defined() || v.is_sparse() || v.data_ptr() != it->second.storage.data_ptr())) {
+      growth_storage_.erase(it);
+    }
+  }
+}
+
+void Environment::bind(const std::string &name, const Tensor &t) { bind(slot(name), t); }
+
+void Environment::bind(const TensorRef &ref, const Tensor &t) { bind(slot(ref), t); }
+
+const Environment::GrowthStorage *Environment::growthStorage(const std::string &name) const {
+  auto it = growth_storage_.find(name);
+  return it == growth_storage_.end() ? nullptr : &it->second;
+}
+
+void Environment::setGrowthStorage(const std::string &name, const Tensor &storage,
+                                   std::vector<int64_t> window) {
+  growth_storage_.insert_or_assign(name, GrowthStorage{storage, std::move(window)});
+}
+
+bool Environment::has(const std::string &name) const { return has(findSlot(name)); }
+
+bool Environment::has(const TensorRef &ref) const {
+  Slot s = cachedSlot(ref);
+  if (s == kNoSlot) {
+    s = findSlot(ref.name.name);
+    if (s == kNoSlot) return false;
+    cacheSlot(ref, s);
+  }
+  return has(s);
+}
+
+bool Environment::erase(const std::string &name) {
+  const Slot s = findSlot(name);
+  if (!has(s)) return false;
+  values_[s] = Tensor();
+  bound_[s] = 0;
+  growth_storage_.erase(name);
+  ++layout_version_;
+  return true;
+}
+
+void Environment::clear() {
+  // Names stay interned, so slots resolved by plans remain valid
+  std::fill(values_.begin(), values_.end(), Tensor());
+  std::fill(bound_.begin(), bound_.end(), 0);
+  growth_storage_.clear();
+  ++layout_version_;
+  symbols_ = SymbolTable();
+  label_axes_.clear();
+  label_symbols_.clear();
+  relations_.clear();
+  factViews_.clear();
+}
+
+const Tensor &Environment::lookup(Slot s) const {
+  if (!has(s)) {
+    throw std::runtime_error("Environment: tensor not found: " +
+                             (s < names_->names.size() ? names_->names[s] : "#" + std::to_string(s)));
+  }
+  return values_[s];
+}
+
+const Tensor &Environment::lookup(const std::string &name) const {
+  const Slot s = findSlot(name);
+  if (!has(s)) throw std::runtime_error("Environment: tensor not found: " + name);
+  return values_[s];
 }
 
 const Tensor &Environment::lookup(const TensorRef &ref) const {
-  return lookup(key(ref));
+  Slot s = cachedSlot(ref);
+  if (s == kNoSlot) {
+    s = findSlot(ref.name.name);
+    if (s != kNoSlot) cacheSlot(ref, s);
+  }
+  if (!has(s)) throw std::runtime_error("Environment: tensor not found: " + ref.name.name);
+  return values_[s];
 }
 
-std::string Environment::key(const TensorRef &ref) { return ref.name.name; }
+Tensor Environment::writable(Slot s) {
+  if (!has(s)) return lookup(s);  // throws
+  Tensor &t = values_[s];
+  if (!t.defined() || t.is_sparse()) return t;
+  // Growth storage holds the tensor itself or the storage it is a window of
+  long tensorOwners = 1;
+  long storageOwners = 1;
+  const GrowthStorage *growth = growth_storage_.empty() ? nullptr : growthStorage(names_->names[s]);
+  if (growth && growth->storage.storage().is_alias_of(t.storage())) {
+    if (growth->storage.unsafeGetTensorImpl() == t.unsafeGetTensorImpl()) {
+      ++tensorOwners;
+    } else {
+      ++storageOwners;
+    }
+  }
+  if (t.use_count() > tensorOwners || t.storage().use_count() > storageOwners) {
+    t = t.clone();
+    growth_storage_.erase(names_->names[s]);
+  }
+  return t;
+}
+
+Tensor Environment::writable(const std::string &name) {
+  const Slot s = findSlot(name);
+  if (!has(s)) throw std::runtime_error("Environment: tensor not found: " + name);
+  return writable(s);
+}
+
+Tensor Environment::writable(const TensorRef &ref) {
+  if (!has(ref)) throw std::runtime_error("Environment: tensor not found: " + ref.name.name);
+  return writable(slot(ref));
+}
+
+std::map<std::string, Tensor> Environment::tensors() const {
+  std::map<std::string, Tensor> out;
+  for (Slot s = 0; s < bound_.size(); ++s) {
+    if (bound_[s]) out.emplace(names_->names[s], values_[s]);
+  }
+  return out;
+}
 
 int Environment::internLabel(const std::string &label) {
-  auto it = labelToIndex_.find(label);
-  if (it != labelToIndex_.end()) return it->second;
-  int idx = static_cast<int>(labelToIndex_.size());
-  labelToIndex_[label] = idx;
-  return idx;
+  const SymbolId id = symbols_.intern(label);
+  const int64_t axis = labelAxis(id);
+  if (axis >= 0) return static_cast<int>(axis);
+  // A new label moves layoutVersion(); a Datalog constant becomes one here
+  if (label_axes_.size() <= id) label_axes_.resize(id + 1, -1);
+  label_axes_[id] = static_cast<int64_t>(label_symbols_.size());
+  label_symbols_.push_back(id);
+  ++layout_version_;
+  return static_cast<int>(label_axes_[id]);
 }
 
 bool Environment::getLabelIndex(const std::string &label, int &outIdx) const {
-  auto it = labelToIndex_.find(label);
-  if (it == labelToIndex_.end()) return false;
-  outIdx = it->second;
+  if (label.empty() || std::islower(static_cast<unsigned char>(label[0]))) return false;
+  SymbolId id = 0;
+  if (!symbols_.lookup(label, id) || labelAxis(id) < 0) return false;
+  outIdx = static_cast<int>(labelAxis(id));
   return true;
 }
 
-bool Environment::addFact(const std::string &relation, const std::vector<std::string> &tuple) {
-  // Serialize tuple with unit separator for unique key
-  std::string key;
-  for (size_t i = 0; i < tuple.size(); ++i) {
-    if (i) key.push_back('\x1F');
-    key += tuple[i];
+void Environment::labelRelation(const std::string &relation) {
+  const Relation *rel = this->relation(relation);
+  if (!rel) throw std::runtime_error("Unknown Datalog relation: " + relation);
+  std::vector<char> seen(symbols_.size(), 0);
+  const SymbolId *ids = rel->size() > 0 ? rel->row(0) : nullptr;
+  for (size_t k = 0; k < rel->size() * rel->arity(); ++k) seen[ids[k]] = 1;
+  for (SymbolId id = 0; id < seen.size(); ++id) {
+    if (seen[id]) internLabel(symbols_.name(id));
+  }
+}
+
+namespace {
+
+// Sparse COO 0/1 tensor of a relation's rows, with each symbol ID at the
+// label axis `positions` gives it, or at itself without them
+Tensor scatterRows(const std::string &name, const Relation &rel, const SymbolTable &symbols,
+                   const std::vector<int64_t> *positions, int64_t extent, const torch::Device &device,
+                   torch::ScalarType dtype) {
+  const int64_t arity = static_cast<int64_t>(rel.arity());
+  const int64_t rows = static_cast<int64_t>(rel.size());
+  const auto options = torch::TensorOptions().dtype(dtype).device(device);
+  // A nullary relation is one cell, set if the relation holds
+  if (arity == 0) return rows > 0 ? torch::ones({}, options) : torch::zeros({}, options);
+  // The packed rows are the coordinates; every cell the relation does not
+  // hold stays implicit, so extent^arity never has to fit in memory
+  Tensor coords = torch::empty({rows, arity}, torch::kLong);
+  int64_t *out = coords.data_ptr<int64_t>();
+  const SymbolId *ids = rows > 0 ? rel.row(0) : nullptr;
+  for (int64_t k = 0; k < rows * arity; ++k) {
+    const int64_t position = positions ? (ids[k] < positions->size() ? (*positions)[ids[k]] : -1) : ids[k];
+    if (position < 0) {
+      throw std::runtime_error("Cannot project " + name + " onto label axes: " + symbols.name(ids[k]) +
+                               " is not a label");
+    }
+    out[k] = position;
+  }
+  const std::vector<int64_t> sizes(rel.arity(), extent);
+  // Built and coalesced (sorted) in float on the CPU, which every backend supports
+  Tensor t = torch::sparse_coo_tensor(coords.t(), torch::ones({rows}, torch::kFloat32), sizes).coalesce();
+  // MPS has no sparse layout; there the relation must fit dense
+  if (!device.is_cpu() && !device.is_cuda()) return t.to_dense().to(options);
+  return t.to(options);
+}
+
+// Coordinates of the elements of t above threshold as row-major tuples of
+// the symbol IDs `symbols` gives each position, or of the positions
+// themselves without it; every position must be below extent
+std::vector<SymbolId> gatherRows(const Tensor &t, double threshold, const std::vector<SymbolId> *symbols,
+                                 int64_t extent) {
+  Tensor coords;
+  if (t.is_sparse()) {
+    // The stored entries are the candidates; implicit cells are zero
+    const Tensor sparse = t.detach().coalesce();
+    const Tensor values = sparse.values();
+    const Tensor mask = values.scalar_type() == torch::kBool ? values : values.gt(threshold);
+    coords = sparse.indices().index({torch::indexing::Slice(), mask}).t();
+  } else {
+    const Tensor mask = t.scalar_type() == torch::kBool ? t : t.detach().gt(threshold);
+    coords = mask.nonzero();
   }
-  auto &setRef = datalog_set_[relation];
-  auto inserted = setRef.insert(key).second;
-  if (inserted) {
-    datalog_[relation].push_back(tuple);
+  coords = coords.to(torch::kLong).cpu().contiguous();
+  const int64_t *data = coords.data_ptr<int64_t>();
+  std::vector<SymbolId> tuples(static_cast<size_t>(coords.numel()));
+  for (size_t k = 0; k < tuples.size(); ++k) {
+    if (data[k] >= extent) {
+      throw std::runtime_error("Tensor position " + std::to_string(data[k]) + " is not " +
+                               (symbols ? "a label" : "an interned symbol") + " (" + std::to_string(extent) +
+                               (symbols ? " labels)" : " symbols)"));
+    }
+    tuples[k] = symbols ? (*symbols)[static_cast<size_t>(data[k])] : static_cast<SymbolId>(data[k]);
   }
-  return inserted;
+  return tuples;
+}
+
+} // namespace
+
+Tensor Environment::relationTensor(const std::string &relation) const {
+  return relationTensor(relation, dtype_policy_.value);
+}
+
+Tensor Environment::relationTensor(const std::string &relation, torch::ScalarType dtype) const {
+  const Relation *rel = this->relation(relation);
+  if (!rel) throw std::runtime_error("Unknown Datalog relation: " + relation);
+  return scatterRows(relation, *rel, symbols_, &label_axes_, static_cast<int64_t>(label_symbols_.size()), device_,
+                     dtype);
+}
+
+std::vector<SymbolId> Environment::tensorTuples(const Tensor &t, double threshold) const {
+  return gatherRows(t, threshold, &label_symbols_, static_cast<int64_t>(label_symbols_.size()));
+}
+
+Tensor Environment::symbolTensor(const std::string &relation, torch::ScalarType dtype) const {
+  const Relation *rel = this->relation(relation);
+  if (!rel) throw std::runtime_error("Unknown Datalog relation: " + relation);
+  return scatterRows(relation, *rel, symbols_, nullptr, static_cast<int64_t>(symbols_.size()), device_, dtype);
+}
+
+std::vector<SymbolId> Environment::symbolTuples(const Tensor &t, double threshold) const {
+  return gatherRows(t, threshold, nullptr, static_cast<int64_t>(symbols_.size()));
+}
+
+Relation &Environment::relationFor(const std::string &name, size_t arity) {
+  auto it = relations_.find(name);
+  if (it == relations_.end()) {
+    it = relations_.emplace(name, Relation(arity)).first;
+  } else if (it->second.arity() != arity) {
+    throw std::runtime_error("Datalog relation '" + name + "' has arity " +
+                             std::to_string(it->second.arity()) + ", got a tuple of arity " +
+                             std::to_string(arity));
+  }
+  return it->second;
+}
+
+bool Environment::addFact(const std::string &relation, const std::vector<SymbolId> &tuple) {
+  return relationFor(relation, tuple.size()).insert(tuple.data());
+}
+
+size_t Environment::addFacts(const std::string &relation, size_t arity, const SymbolId *tuples, size_t count) {
+  if (count == 0) return 0;
+  return relationFor(relation, arity).insertBulk(tuples, count);
+}
+
+bool Environment::addFact(const std::string &relation, const std::vector<std::string> &tuple) {
+  std::vector<SymbolId> ids;
+  ids.reserve(tuple.size());
+  for (const auto &c : tuple) ids.push_back(symbols_.intern(c));
+  return addFact(relation, ids);
 }
 
 bool Environment::addFact(const DatalogFact &f) {
@@ -99,14 +412,36 @@ bool Environment::addFact(const DatalogFact &f) {
 }
 
 bool Environment::hasRelation(const std::string &relation) const {
-  return datalog_.find(relation) != datalog_.end();
+  return relations_.find(relation) != relations_.end();
+}
+
+bool Environment::removeRelation(const std::string &relation) {
+  factViews_.erase(relation);
+  return relations_.erase(relation) > 0;
+}
+
+const Relation *Environment::relation(const std::string &name) const {
+  auto it = relations_.find(name);
+  return it == relations_.end() ? nullptr : &it->second;
 }
 
 const std::vector<std::vector<std::string>> &Environment::facts(const std::string &relation) const {
   static const std::vector<std::vector<std::string>> kEmpty;
-  auto it = datalog_.find(relation);
-  if (it == datalog_.end()) return kEmpty;
-  return it->second;
+  const Relation *rel = this->relation(relation);
+  if (!rel) return kEmpty;
+  // Relations only grow between clears, so the view is extended with the
+  // rows added since the last call (and rebuilt if the relation shrank).
+  auto &view = factViews_[relation];
+  if (view.size() > rel->size()) view.clear();
+  view.reserve(rel->size());
+  for (size_t r = view.size(); r < rel->size(); ++r) {
+    const SymbolId *row = rel->row(r);
+    std::vector<std::string> tuple;
+    tuple.reserve(rel->arity());
+    for (size_t i = 0; i < rel->arity(); ++i) tuple.push_back(symbols_.name(row[i]));
+    view.push_back(std::move(tuple));
+  }
+  return view;
 }
 
 // -------- BackendRouter --------
@@ -119,23 +454,88 @@ BackendType BackendRouter::analyze(const Statement &st) {
   return BackendType::LibTorch; // default
 }
 
+double BackendRouter::density(const Tensor &t) {
+  const int64_t numel = t.numel();
+  if (numel == 0) return 1.0;
+  const int64_t nnz = t.is_sparse() ? t._nnz() : t.count_nonzero().item<int64_t>();
+  return static_cast<double>(nnz) / static_cast<double>(numel);
+}
+
+BackendType BackendRouter::analyze(const std::vector<Tensor> &operands,
+                                   const SparseRouting &routing) {
+  for (const auto &t : operands) {
+    if (t.is_sparse()) return BackendType::Sparse;
+  }
+  const auto convert = denseToConvert(operands, routing);
+  return std::find(convert.begin(), convert.end(), true) != convert.end() ? BackendType::Sparse
+                                                                          : BackendType::LibTorch;
+}
+
+std::vector<bool> BackendRouter::denseToConvert(const std::vector<Tensor> &operands,
+                                                const SparseRouting &routing) {
+  std::vector<bool> convert(operands.size(), false);
+  // A single operand has nothing to contract against
+  if (!routing.probeDense || operands.size() < 2) return convert;
+  for (size_t i = 0; i < operands.size(); ++i) {
+    const Tensor &t = operands[i];
+    convert[i] = !t.is_sparse() && t.numel() >= routing.minElements && density(t) <= routing.maxDensity;
+  }
+  return convert;
+}
+
 // -------- TensorLogicVM --------
 
 TensorLogicVM::TensorLogicVM(std::ostream* out, std::ostream* err)
   : output_stream_(out), error_stream_(err), datalog_engine_(env_, out) {
-  torch_ = BackendFactory::create(BackendType::LibTorch);
-  if (const char* env = std::getenv("TL_DEBUG")) {
-    std::string v = env;
-    for (auto &c : v) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
-    if (v == "1" || v == "true" || v == "yes" || v == "on") {
-      debug_ = true;
-      datalog_engine_.setDebug(true);
-    }
+  torch_ = BackendFactory::createHybrid(BackendFactory::create(BackendType::Sparse),
+                                        BackendFactory::create(BackendType::Native));
+  datalog_engine_.setTensorBackend(torch_.get());
+  if (debugFromEnvironment()) {
+    debug_ = true;
+    datalog_engine_.setDebug(true);
+  }
+  if (const char* device = std::getenv("TL_DEVICE")) {
+    if (*device) setDevice(parseDevice(device));
+  }
+  if (const char* dtype = std::getenv("TL_DTYPE")) {
+    if (*dtype) setDTypePolicy(DTypePolicy::parse(dtype));
   }
   initializePreprocessors();
   initializeExecutors();
   // Initialize learning engine after executors are registered
   learning_engine_ = std::make_unique<LearningEngine>(env_, *torch_, executor_registry_, output_stream_);
+  learning_engine_->setRecurrenceRunner([this](const std::vector<Statement> &statements, int checkpoint) {
+    replayRecurrences(statements, checkpoint);
+  });
+}
+
+TensorLogicVM::TensorLogicVM(const TensorLogicVM &prototype, std::ostream *out, std::ostream *err)
+  : output_stream_(out), error_stream_(err), env_(prototype.env_), debug_(prototype.debug_),
+    native_recurrence_(prototype.native_recurrence_),
+    dead_code_elimination_(prototype.dead_code_elimination_),
+    release_intermediates_(prototype.release_intermediates_), async_file_io_(prototype.async_file_io_),
+    recurrence_threads_(prototype.recurrence_threads_), statement_threads_(prototype.statement_threads_),
+    convergence_defaults_(prototype.convergence_defaults_),
+    convergence_options_(prototype.convergence_options_), stream_rows_(prototype.stream_rows_),
+    executor_registry_(prototype.executor_registry_), datalog_engine_(env_, out) {
+  torch_ = BackendFactory::createHybrid(BackendFactory::create(BackendType::Sparse),
+                                        BackendFactory::create(BackendType::Native));
+  torch_->setDevice(env_.device());
+  torch_->setDTypePolicy(env_.dtypePolicy());
+  executor_registry_.setErrOut(error_stream_);
+  datalog_engine_.setTensorBackend(torch_.get());
+  datalog_engine_.setDebug(debug_);
+  datalog_engine_.setSemiNaive(prototype.datalog_engine_.semiNaive());
+  datalog_engine_.setTensorMode(prototype.datalog_engine_.tensorMode());
+  datalog_engine_.setDemandDriven(prototype.datalog_engine_.demandDriven());
+  datalog_engine_.setPartitions(prototype.datalog_engine_.partitions());
+  datalog_engine_.setNumThreads(prototype.datalog_engine_.numThreads());
+  for (const auto &rule : prototype.datalog_engine_.rules()) datalog_engine_.addRule(rule);
+  initializePreprocessors();
+  learning_engine_ = std::make_unique<LearningEngine>(env_, *torch_, executor_registry_, output_stream_);
+  learning_engine_->setRecurrenceRunner([this](const std::vector<Statement> &statements, int checkpoint) {
+    replayRecurrences(statements, checkpoint);
+  });
 }
 
 void TensorLogicVM::initializePreprocessors() {
@@ -173,314 +573,820 @@ void TensorLogicVM::setDebug(bool enabled) {
   datalog_engine_.setDebug(enabled);
 }
 bool TensorLogicVM::debug() const { return debug_; }
-void TensorLogicVM::debugLog(const std::string &msg) const {
-  if (debug_) {
-    (*error_stream_) << "[VM] " << msg << std::endl;
+
+void TensorLogicVM::setProfiler(Profiler *profiler) {
+  profiler_ = profiler;
+  datalog_engine_.setProfiler(profiler);
+  learning_engine_->setProfiler(profiler);
+}
+
+void TensorLogicVM::setDevice(const torch::Device &device) {
+  env_.setDevice(device);
+  torch_->setDevice(device);
+  VM_LOG(Debug, "Device: " << device.str());
+}
+
+torch::Device TensorLogicVM::device() const { return env_.device(); }
+
+void TensorLogicVM::setDTypePolicy(const DTypePolicy &policy) {
+  env_.setDTypePolicy(policy);
+  torch_->setDTypePolicy(policy);
+  VM_LOG(Debug, "Dtype policy: " << policy.str());
+}
+
+const DTypePolicy &TensorLogicVM::dtypePolicy() const { return env_.dtypePolicy(); }
+
+static void validateConvergence(const ConvergenceOptions &options) {
+  if (!(options.tolerance >= 0.0f)) throw std::invalid_argument("Convergence tolerance must be non-negative");
+  if (options.maxStable < 1 || options.checkInterval < 1 || options.maxIterations < 1) {
+    throw std::invalid_argument("Convergence maxStable, checkInterval and maxIterations must be positive");
   }
 }
 
+void TensorLogicVM::setRecurrenceThreads(size_t threads) {
+  if (threads != recurrence_threads_) recurrence_pool_.reset();
+  recurrence_threads_ = threads;
+}
+
+void TensorLogicVM::setConvergenceOptions(const ConvergenceOptions &options) {
+  validateConvergence(options);
+  convergence_defaults_ = options;
+}
+
+void TensorLogicVM::setConvergenceOptions(const std::string &tensor, const ConvergenceOptions &options) {
+  validateConvergence(options);
+  convergence_options_[tensor] = options;
+}
+
+const ConvergenceOptions &TensorLogicVM::convergenceOptions(const std::string &tensor) const {
+  auto it = convergence_options_.find(tensor);
+  return it == convergence_options_.end() ? convergence_defaults_ : it->second;
+}
+
+void TensorLogicVM::debugLog(const std::string &msg) const {
+  VM_LOG(Debug, msg);
+}
+
+CompiledProgram TensorLogicVM::compile(const Program &program) const {
+  return CompiledProgram::compile(program, preprocessor_registry_, env_);
+}
+
 void TensorLogicVM::execute(const Program &program) {
-  // Store current program for learning directives
-  current_program_ = program;
+  CompiledProgram plan = compile(program);
+  execute(plan);
+}
 
-  if (debug_) {
-    debugLog("========== EXECUTE START ==========");
-    debugLog("Total statements: " + std::to_string(program.statements.size()));
+TensorEquationExecutor &TensorLogicVM::executorFor(CompiledProgram &plan, size_t k) {
+  const auto &eq = std::get<TensorEquation>(plan.program().statements[plan.instructions_[k].statement]);
+  auto &cached = plan.executors_[k];
+  const uint64_t layout = env_.layoutVersion();
+  if (!cached.executor || cached.layoutVersion != layout) {
+    cached.executor = &executor_registry_.select(eq, env_);
+    cached.layoutVersion = layout;
+    ++plan.executor_selections_;
   }
+  return *cached.executor;
+}
 
-  // BATCH PREPROCESSING: Collect virtual-indexed statements for batch processing
-  std::vector<Statement> virtualIndexedStmts;
-  std::vector<size_t> virtualIndexedIndices;
-  std::vector<Statement> processedStatements;
-  std::vector<size_t> processedIndices;
+void TensorLogicVM::runEquation(CompiledProgram &plan, size_t k) {
+  const auto &eq = std::get<TensorEquation>(plan.program().statements[plan.instructions_[k].statement]);
+  execTensorEquation(eq, executorFor(plan, k));
+}
 
-  // First pass: identify virtual-indexed statements
-  for (size_t i = 0; i < program.statements.size(); ++i) {
-    const auto &st = program.statements[i];
+bool TensorLogicVM::runAttention(CompiledProgram &plan, size_t k) {
+  const auto &group = *plan.attentionAt(k);
+  const auto &output = std::get<TensorEquation>(plan.program().statements[plan.instructions_[k].statement]);
+  // The kernel computes what NormalizationExecutor would for the weights
+  if (dynamic_cast<NormalizationExecutor *>(&executorFor(plan, group.members.back()))) {
+    Tensor result = group.kernel.evaluate(env_, dtype_policy_);
+    if (result.defined()) {
+      VM_LOG(Trace, "  Fused " << group.members.size() << " statement(s)"
+                               << (group.kernel.usesSdpa() ? " into SDPA" : " into blocked attention"));
+      commitEquation(output, result);
+      return true;
+    }
+  }
+  for (size_t m : group.members) runEquation(plan, m);
+  runEquation(plan, k);
+  return false;
+}
 
-    bool isVirtualIndexed = false;
-    if (std::holds_alternative<TensorEquation>(st)) {
-      const auto& eq = std::get<TensorEquation>(st);
+namespace {
+bool hasListLiteral(const Expr &expr) {
+  if (std::holds_alternative<ExprList>(expr.node)) return true;
+  if (const auto *bin = std::get_if<ExprBinary>(&expr.node)) return hasListLiteral(*bin->lhs) || hasListLiteral(*bin->rhs);
+  if (const auto *un = std::get_if<ExprUnary>(&expr.node)) return hasListLiteral(*un->operand);
+  if (const auto *paren = std::get_if<ExprParen>(&expr.node)) return hasListLiteral(*paren->inner);
+  if (const auto *call = std::get_if<ExprCall>(&expr.node)) {
+    for (const auto &arg : call->args) {
+      if (hasListLiteral(*arg)) return true;
+    }
+  }
+  return false;
+}
 
-      // Check LHS for virtual indices
-      for (const auto& ios : eq.lhs.indices) {
-        // Check if it's an Index (not a Slice), then check if it's a VirtualIndex
-        if (std::holds_alternative<Index>(ios.value)) {
-          const auto& idx = std::get<Index>(ios.value);
-          if (std::holds_alternative<VirtualIndex>(idx.value)) {
-            isVirtualIndexed = true;
-            break;
-          }
-        }
-      }
+// Whether running eq only reads the environment and binds a fresh LHS value,
+// so it may run alongside other such equations. Excluded: guards (they bind
+// their index tensors), list literals (folded into the shared node on first
+// use), labels (interned on first use), unbound operands (bound to a
+// placeholder), and LHS indices other than free variables, on a bound
+// tensor or with a literal RHS (element writes grow storage, indexed writes
+// update in place)
+bool readsOnly(const TensorEquation &eq, const std::function<bool(const std::string &)> &bound) {
+  for (const auto &clause : eq.clauses) {
+    if (clause.guard || !clause.expr || hasListLiteral(*clause.expr)) return false;
+    if (!eq.lhs.indices.empty() && executor_utils::tryParseNumericLiteral(clause.expr)) return false;
+  }
+  if (!eq.lhs.indices.empty() && bound(eq.lhs.name.name)) return false;
+  for (const auto &ios : eq.lhs.indices) {
+    const auto *idx = std::get_if<Index>(&ios.value);
+    const auto *id = idx ? std::get_if<Identifier>(&idx->value) : nullptr;
+    if (!id || id->name.empty() || std::isupper(static_cast<unsigned char>(id->name[0]))) return false;
+  }
+  bool ok = true;
+  executor_utils::forEachTensorRef(eq, [&](const TensorRef &ref) {
+    if (!bound(ref.name.name)) ok = false;
+    for (const auto &ios : ref.indices) {
+      const auto *idx = std::get_if<Index>(&ios.value);
+      const auto *id = idx ? std::get_if<Identifier>(&idx->value) : nullptr;
+      if (id && (id->name.empty() || std::isupper(static_cast<unsigned char>(id->name[0])))) ok = false;
+    }
+  });
+  return ok;
+}
+} // namespace
 
-      // IMPORTANT: RHS-only virtual indices should NOT be batched
-      // They are handled by single-statement preprocessing which substitutes them with 0
-      // Only batch equations that have virtual indices on BOTH LHS and RHS (recurrent equations)
-      // Examples:
-      //   - State[i, *t+1] = W[i,j] State[j, *t] + Input[i, t]  -> BATCH (LHS has *t)
-      //   - Output = sigmoid(W_out[i] State[i, *5])  -> DON'T BATCH (only RHS has *5)
+void TensorLogicVM::setStatementThreads(size_t threads) {
+  if (threads != statement_threads_) statement_pool_.reset();
+  statement_threads_ = threads;
+}
 
-      // Note: We already checked LHS above and found no virtual indices
-      // So this equation will go through normal preprocessing, not batch
+void TensorLogicVM::setThreadOptions(const ThreadOptions &options) {
+  if (options.interOp > 0 && static_cast<size_t>(at::get_num_interop_threads()) != options.interOp) {
+    try {
+      at::set_num_interop_threads(static_cast<int>(options.interOp));
+    } catch (const c10::Error &) {
+      throw std::runtime_error("Inter-op threads can only be set before LibTorch starts inter-op work");
     }
+  }
+  ThreadOptions applied = options;
+  if (applied.intraOp > 0) {
+    at::set_num_threads(static_cast<int>(applied.intraOp));
+  } else {
+    applied.intraOp = static_cast<size_t>(std::max(1, at::get_num_threads()));
+  }
+  ThreadPool::configure(applied);
+}
 
-    if (isVirtualIndexed) {
-      virtualIndexedStmts.push_back(st);
-      virtualIndexedIndices.push_back(i);
+void TensorLogicVM::runEquations(CompiledProgram &plan, size_t first, size_t last) {
+  const auto &statements = plan.program().statements;
+  auto equationAt = [&](size_t k) -> const TensorEquation & {
+    return std::get<TensorEquation>(statements[plan.instructions_[k].statement]);
+  };
+
+  // Level of each equation: one past every earlier equation it must follow,
+  // because it reads what that one writes or writes what it reads or
+  // writes. An equation that may change the environment beyond binding its
+  // result gets a level of its own after everything before it. Index
+  // variables that name tensors (Y = X[n]) are read like operands.
+  const size_t slotCount = plan.slots().size();
+  std::vector<int> written(slotCount, -1), read(slotCount, -1);
+  std::vector<int> level(last - first);
+  std::vector<int> reads;
+  int floor = 0, top = -1;
+  for (size_t k = first; k < last; ++k) {
+    const auto &instr = plan.instructions_[k];
+    auto bound = [&](const std::string &name) {
+      const int slot = plan.slotOf(name);
+      return env_.has(name) || (slot >= 0 && written[slot] >= 0);
+    };
+    reads.assign(instr.operands.begin(), instr.operands.end());
+    executor_utils::forEachIndexName(equationAt(k), [&](const std::string &name) {
+      const int slot = plan.slotOf(name);
+      if (slot >= 0) reads.push_back(slot);
+    });
+    int l = floor;
+    if (instr.result < 0 || !readsOnly(equationAt(k), bound)) {
+      l = top + 1;
+      floor = l + 1;
     } else {
-      processedStatements.push_back(st);
-      processedIndices.push_back(i);
-    }
-  }
-
-  // IMPORTANT: Execute non-virtual statements first so tensors are defined
-  // This allows getIterationCount to find driving tensors like Input
-  if (debug_) {
-    debugLog("Executing " + std::to_string(processedStatements.size()) + " non-virtual statements first");
-  }
-
-  for (size_t i = 0; i < processedStatements.size(); ++i) {
-    const auto &st = processedStatements[i];
-    if (debug_) {
-      debugLog("Non-virtual stmt " + std::to_string(i) + ": " + toString(st));
-    }
-
-    // FIRST: Preprocess statement (for non-virtual preprocessors)
-    auto preprocessed = preprocessor_registry_.preprocess(st, env_);
-
-    // THEN: Execute each preprocessed statement
-    for (const auto &preprocessed_st : preprocessed) {
-      const BackendType be = router_.analyze(preprocessed_st);
-      if (debug_ && preprocessed.size() > 1) {
-        debugLog("  Preprocessed: " + toString(preprocessed_st));
-      }
-
-      if (std::holds_alternative<TensorEquation>(preprocessed_st)) {
-        execTensorEquation(std::get<TensorEquation>(preprocessed_st));
-      } else if (std::holds_alternative<FixedPointLoop>(preprocessed_st)) {
-        executeFixedPointLoop(std::get<FixedPointLoop>(preprocessed_st));
-      } else if (std::holds_alternative<DatalogFact>(preprocessed_st)) {
-        datalog_engine_.addFact(std::get<DatalogFact>(preprocessed_st));
-      } else if (std::holds_alternative<DatalogRule>(preprocessed_st)) {
-        datalog_engine_.addRule(std::get<DatalogRule>(preprocessed_st));
-      } else if (std::holds_alternative<FileOperation>(preprocessed_st)) {
-        const auto &fo = std::get<FileOperation>(preprocessed_st);
-        auto resolvePath = [](const std::string &p)->std::filesystem::path {
-        std::filesystem::path path(p);
-        if (path.is_absolute()) return path;
-        // Try as-is relative to CWD
-        const std::filesystem::path cwd = std::filesystem::current_path();
-        std::filesystem::path candidate = cwd / path;
-        if (std::filesystem::exists(candidate)) return candidate;
-        // TODO: Should we throw here?
-        // Fall back to as-is
-        return candidate;
-      };
-
-      auto readTensorFromFile = [&](const std::string &p)->Tensor {
-        const std::filesystem::path rp = resolvePath(p);
-        std::ifstream ifs(rp);
-        if (!ifs) throw std::runtime_error("Cannot open file for reading: " + rp.string());
-        std::vector<std::string> lines;
-        std::string line;
-        while (std::getline(ifs, line)) {
-          // Trim CR and whitespace at both ends
-          while (!line.empty() && (line.back()=='\r' || line.back()=='\n' || line.back()==' ' || line.back()=='\t')) line.pop_back();
-          size_t start = 0; while (start < line.size() && (line[start]==' ' || line[start]=='\t')) ++start;
-          if (start > 0) line = line.substr(start);
-          if (line.empty()) continue;
-          lines.push_back(line);
-        }
-        if (lines.empty()) {
-          return torch::zeros({0});
-        }
-        bool hasComma = false;
-        for (const auto &ln : lines) { if (ln.find(',') != std::string::npos) { hasComma = true; break; } }
-        if (hasComma) {
-          // Parse as 2D CSV
-          std::vector<float> values;
-          size_t cols = 0;
-          for (const auto &ln : lines) {
-            std::vector<float> row;
-            size_t pos = 0;
-            while (pos <= ln.size()) {
-              size_t comma = ln.find(',', pos);
-              const std::string tok = (comma == std::string::npos) ? ln.substr(pos) : ln.substr(pos, comma - pos);
-              if (!tok.empty()) {
-                row.push_back(static_cast<float>(std::stod(tok)));
-              } else {
-                row.push_back(0.0f);
-              }
-              if (comma == std::string::npos) break;
-              pos = comma + 1;
-            }
-            if (cols == 0) cols = row.size();
-            if (row.size() != cols) throw std::runtime_error("CSV has inconsistent number of columns in: " + rp.string());
-            values.insert(values.end(), row.begin(), row.end());
-          }
-          const int64_t rows = static_cast<int64_t>(lines.size());
-          const int64_t c = static_cast<int64_t>(cols);
-          torch::Tensor t = torch::from_blob(values.data(), {rows, c}, torch::TensorOptions().dtype(torch::kFloat32)).clone();
-          return t;
-        } else {
-          // Treat as 1D: one number per non-empty line
-          std::vector<float> values;
-          values.reserve(lines.size());
-          for (const auto &ln : lines) {
-            values.push_back(static_cast<float>(std::stod(ln)));
-          }
-          const int64_t n = static_cast<int64_t>(values.size());
-          torch::Tensor t = torch::from_blob(values.data(), {n}, torch::TensorOptions().dtype(torch::kFloat32)).clone();
-          return t;
-        }
-      };
-
-      auto writeTensorToFile = [&](const std::string &p, const Tensor &t) {
-        std::filesystem::path rp = resolvePath(p);
-        // Ensure directory exists
-        std::filesystem::path parent = rp.parent_path();
-        if (!parent.empty()) {
-          std::error_code ec; std::filesystem::create_directories(parent, ec);
-        }
-        std::ofstream ofs(rp);
-        if (!ofs) throw std::runtime_error("Cannot open file for writing: " + rp.string());
-        const torch::Tensor contig = t.contiguous();
-        if (contig.dim() == 0) {
-          double v = 0.0; try { v = contig.item<double>(); } catch (...) { v = contig.item<float>(); }
-          ofs << v << "\n";
-          return;
-        }
-        if (contig.dim() == 1) {
-          const int64_t n = contig.size(0);
-          for (int64_t i = 0; i < n; ++i) {
-            double v = 0.0; try { v = contig[i].item<double>(); } catch (...) { v = contig[i].item<float>(); }
-            ofs << v;
-            if (i + 1 < n) ofs << "\n";
-          }
-          return;
-        }
-        if (contig.dim() == 2) {
-          const int64_t r = contig.size(0);
-          const int64_t c = contig.size(1);
-          for (int64_t i = 0; i < r; ++i) {
-            for (int64_t j = 0; j < c; ++j) {
-              double v = 0.0; try { v = contig[i][j].item<double>(); } catch (...) { v = contig[i][j].item<float>(); }
-              if (j) ofs << ",";
-              ofs << v;
-            }
-            if (i + 1 < r) ofs << "\n";
-          }
-          return;
-        }
-        // Higher dimensions: write flattened, one value per line
-        const int64_t n = contig.numel();
-        torch::Tensor flat = contig.reshape({n});
-        for (int64_t i = 0; i < n; ++i) {
-          double v = 0.0; try { v = flat[i].item<double>(); } catch (...) { v = flat[i].item<float>(); }
-          ofs << v;
-          if (i + 1 < n) ofs << "\n";
-        }
-      };
-
-      if (fo.lhsIsTensor) {
-        Tensor t = readTensorFromFile(fo.file.text);
-        env_.bind(fo.tensor, t);
-        if (debug_) {
-          std::ostringstream oss; oss << "Loaded tensor from '" << fo.file.text << "' into " << Environment::key(fo.tensor) << " shape=" << t.sizes();
-          debugLog(oss.str());
-        }
-      } else {
-        const auto &src = env_.lookup(fo.tensor);
-        writeTensorToFile(fo.file.text, src);
-        if (debug_) {
-          std::ostringstream oss; oss << "Wrote tensor " << Environment::key(fo.tensor) << " shape=" << src.sizes() << " to '" << fo.file.text << "'";
-            debugLog(oss.str());
-          }
-        }
-      } else if (std::holds_alternative<Query>(preprocessed_st)) {
-        // Queries are processed in a separate loop after saturation (see line ~459)
-        // Do nothing here - not an error
-      } else {
-        // Unknown statement kind
-        if (debug_) debugLog("Warning: Unknown statement type, skipping");
+      for (int s : reads) l = std::max(l, written[s] + 1);
+      l = std::max({l, written[instr.result] + 1, read[instr.result] + 1});
+    }
+    level[k - first] = l;
+    top = std::max(top, l);
+    if (instr.result >= 0) written[instr.result] = std::max(written[instr.result], l);
+    for (int s : reads) read[s] = std::max(read[s], l);
+  }
+
+  std::vector<std::vector<size_t>> levels(static_cast<size_t>(top + 1));
+  for (size_t k = first; k < last; ++k) levels[level[k - first]].push_back(k);
+
+  std::vector<TensorEquationExecutor *> executors;
+  std::vector<Tensor> results;
+  std::vector<std::exception_ptr> errors;
+  ThreadPool::obtain(statement_pool_, statement_threads_);
+  const bool grad = torch::GradMode::is_enabled();  // thread-local, so workers inherit it explicitly
+  for (const auto &group : levels) {
+    if (group.size() == 1) {
+      runEquation(plan, group.front());
+      continue;
+    }
+    // Executors are chosen here, against the environment as earlier levels
+    // left it; only their computations run on the pool
+    executors.clear();
+    for (size_t k : group) executors.push_back(&executorFor(plan, k));
+    results.assign(group.size(), Tensor());
+    errors.assign(group.size(), nullptr);
+    statement_pool_->parallelFor(group.size(), [&](size_t i) {
+      torch::AutoGradMode mode(grad);
+      try {
+        results[i] = executor_registry_.execute(*executors[i], equationAt(group[i]), env_, *torch_);
+      } catch (...) {
+        errors[i] = std::current_exception();
       }
-    } // end for each preprocessed statement
-  } // end for each non-virtual statement
+    });
+    // Bound in source order; the first failure wins, as it would sequentially
+    for (size_t i = 0; i < group.size(); ++i) {
+      if (errors[i]) std::rethrow_exception(errors[i]);
+      commitEquation(equationAt(group[i]), results[i]);
+    }
+  }
+}
 
-  // NOW batch preprocess and execute virtual-indexed statements
-  // At this point, tensors like Input should be defined
-  if (!virtualIndexedStmts.empty()) {
-    if (debug_) {
-      debugLog("Batch preprocessing " + std::to_string(virtualIndexedStmts.size()) + " virtual-indexed statements");
+namespace {
+Profiler::Shape shapeOf(const Tensor &t) {
+  return t.defined() ? Profiler::Shape(t.sizes().begin(), t.sizes().end()) : Profiler::Shape{};
+}
+
+// FLOP estimate for the profiler: two per point of the iteration space
+// (multiply and add) when some index is summed out, otherwise one per
+// result element. Extents are read off the bound operands; label indices
+// are constants and do not span an axis.
+double estimateFlops(const TensorEquation &eq, const Environment &env, const Tensor &result) {
+  std::unordered_set<std::string> kept;
+  for (const auto &ios : eq.lhs.indices) {
+    const auto *idx = std::get_if<Index>(&ios.value);
+    const auto *id = idx ? std::get_if<Identifier>(&idx->value) : nullptr;
+    if (id) kept.insert(id->name);
+  }
+  std::map<std::string, int64_t> extents;
+  bool contracts = false;
+  executor_utils::forEachTensorRef(eq, [&](const TensorRef &ref) {
+    if (!env.has(ref)) return;
+    const Tensor &t = env.lookup(ref);
+    if (static_cast<int64_t>(ref.indices.size()) != t.dim()) return;
+    for (size_t i = 0; i < ref.indices.size(); ++i) {
+      const auto *idx = std::get_if<Index>(&ref.indices[i].value);
+      const auto *id = idx ? std::get_if<Identifier>(&idx->value) : nullptr;
+      int label = 0;
+      if (!id || env.getLabelIndex(id->name, label)) continue;
+      int64_t &extent = extents[id->name];
+      extent = std::max(extent, t.size(static_cast<int64_t>(i)));
+      if (!kept.count(id->name)) contracts = true;
     }
-    std::vector<Statement> expandedVirtual = VirtualIndexPreprocessor::preprocessBatch(virtualIndexedStmts, env_);
+  });
+  if (!contracts) return result.defined() ? static_cast<double>(result.numel()) : 0.0;
+  double points = 1.0;
+  for (const auto &kv : extents) points *= static_cast<double>(kv.second);
+  return 2.0 * points;
+}
+
+const char *instructionKind(CompiledProgram::Opcode op) {
+  using Opcode = CompiledProgram::Opcode;
+  switch (op) {
+  case Opcode::Equation: return "equation";
+  case Opcode::Expand: return "expand";
+  case Opcode::File: return "file";
+  case Opcode::FixedPoint: return "fixed-point";
+  case Opcode::Fact: return "fact";
+  case Opcode::Rule: return "rule";
+  case Opcode::VirtualBatch: return "recurrence";
+  case Opcode::Query: return "query";
+  }
+  return "statement";
+}
+} // namespace
 
-    if (debug_) {
-      debugLog("Executing " + std::to_string(expandedVirtual.size()) + " expanded virtual statements");
+void TensorLogicVM::execute(CompiledProgram &plan) {
+  run(plan, plan.program(), dead_code_elimination_ && stream_rows_.empty(),
+      release_intermediates_ && stream_rows_.empty());
+}
+
+void TensorLogicVM::append(const Program &statements) {
+  // The fragment joins the session first so its own directives see it too;
+  // a fragment that fails is dropped again
+  const size_t before = session_.statements.size();
+  session_.statements.insert(session_.statements.end(), statements.statements.begin(),
+                             statements.statements.end());
+  try {
+    CompiledProgram plan = compile(statements);
+    run(plan, session_, false, false);
+  } catch (...) {
+    session_.statements.resize(before);
+    throw;
+  }
+}
+
+void TensorLogicVM::run(CompiledProgram &plan, const Program &context, bool prune, bool release) {
+  using Opcode = CompiledProgram::Opcode;
+  const Program &program = plan.program();
+
+  // Learning directives read the program being executed; keep it only for this call
+  struct CurrentProgramScope {
+    const Program *&slot;
+    ~CurrentProgramScope() { slot = nullptr; }
+  } currentProgramScope{current_program_};
+  current_program_ = &context;
+
+  // Cached executors point into this VM's registry
+  if (plan.owner_ != this) {
+    plan.owner_ = this;
+    plan.executors_.assign(plan.instructions_.size(), {});
+  }
+
+  VM_LOG(Debug, "========== EXECUTE START ==========");
+  VM_LOG(Debug, "Total statements: " << program.statements.size());
+  if (prune) VM_LOG(Debug, "Skipping " << plan.deadInstructions() << " statement(s) no output reads");
+
+  // Tensor files are read while the statements before their bindings run.
+  // A run that throws still finishes its writes, but reports its own error
+  struct FileIOScope {
+    AsyncFileIO &io;
+    bool finished{false};
+    ~FileIOScope() {
+      if (finished) return;
+      io.discard();
+      try {
+        io.flush();
+      } catch (...) {
+      }
+    }
+  } fileIOScope{file_io_};
+  if (async_file_io_) prefetchFiles(plan, prune);
+
+  // Instructions before `released` have had their dead tensors erased; a
+  // group of concurrent equations releases once all of it has run
+  size_t released = 0;
+  auto releaseThrough = [&](size_t k) {
+    for (; release && released <= k; ++released) {
+      for (int slot : plan.releasedAfter(released)) {
+        const std::string &name = plan.slots()[slot];
+        if (env_.erase(name)) VM_LOG(Trace, "  Released " << name);
+      }
+    }
+  };
+
+  // Attention chains run as one kernel where their weights would be released anyway
+  const bool fuse = release && FusedAttention::enabled();
+  bool fusedAttention = false;
+
+  // Shapes are taken before the instruction runs, as it may rebind what it reads
+  std::vector<Profiler::Shape> profiledInputs;
+  auto profileInstruction = [&](size_t k, Profiler::Clock::time_point start) {
+    const auto end = Profiler::Clock::now();
+    const auto &instr = plan.instructions_[k];
+    std::string label = instr.op == Opcode::VirtualBatch
+                            ? "virtual-indexed batch of " + std::to_string(plan.virtualStatements().size()) + " statements"
+                            : toString(program.statements[instr.statement]);
+    std::string executor = instructionKind(instr.op);
+    Tensor result;
+    if (instr.result >= 0 && env_.has(plan.slots()[instr.result])) result = env_.lookup(plan.slots()[instr.result]);
+    double flops = 0.0;
+    if (instr.op == Opcode::Equation) {
+      if (plan.executors_[k].executor) executor = plan.executors_[k].executor->name();
+      if (fusedAttention) executor = "FusedAttention";
+      flops = estimateFlops(std::get<TensorEquation>(program.statements[instr.statement]), env_, result);
     }
+    const uint64_t bytes = result.defined() ? static_cast<uint64_t>(result.nbytes()) : 0;
+    profiler_->recordStatement(label, executor, std::move(profiledInputs), shapeOf(result), bytes, flops,
+                               start, end);
+    profiledInputs.clear();
+  };
+
+  for (size_t k = 0; k < plan.instructions_.size(); ++k) {
+    const auto &instr = plan.instructions_[k];
+    if (prune && !plan.live(k)) {
+      VM_LOG(Trace, "Dead stmt " << instr.statement << ": "
+                                 << (instr.op == Opcode::VirtualBatch ? std::string("virtual-indexed batch")
+                                                                      : toString(program.statements[instr.statement])));
+      releaseThrough(k);
+      continue;
+    }
+    if (fuse && plan.fusedInto(k) >= 0) {
+      VM_LOG(Trace, "Fused stmt " << instr.statement << " into stmt "
+                                  << plan.instructions_[plan.fusedInto(k)].statement);
+      releaseThrough(k);
+      continue;
+    }
+    const size_t first = k;
+    fusedAttention = false;
+    const auto started = profiler_ ? Profiler::Clock::now() : Profiler::Clock::time_point{};
+    if (profiler_) {
+      for (int slot : instr.operands) {
+        const std::string &name = plan.slots()[slot];
+        if (env_.has(name)) profiledInputs.push_back(shapeOf(env_.lookup(name)));
+      }
+    }
+    switch (instr.op) {
+    case Opcode::Equation: {
+      if (fuse && plan.attentionAt(k)) {
+        VM_LOG(Trace, "Attention stmt " + std::to_string(instr.statement) + ": " + toString(program.statements[instr.statement]));
+        fusedAttention = runAttention(plan, k);
+        break;
+      }
+      // Consecutive equations are scheduled by their dependencies; debug
+      // and profiled runs stay sequential so the log and timings follow the
+      // source
+      size_t last = k + 1;
+      while (last < plan.instructions_.size() && plan.instructions_[last].op == Opcode::Equation &&
+             (!prune || plan.live(last)) &&
+             !(fuse && (plan.fusedInto(last) >= 0 || plan.attentionAt(last)))) {
+        ++last;
+      }
+      if (last - k > 1 && statement_threads_ != 1 && !logging(LogLevel::Trace) && !profiler_) {
+        runEquations(plan, k, last);
+        k = last - 1;
+        break;
+      }
+      VM_LOG(Trace, "Non-virtual stmt " + std::to_string(instr.statement) + ": " + toString(program.statements[instr.statement]));
+      runEquation(plan, k);
+      break;
+    }
+    case Opcode::Expand: {
+      const auto &st = program.statements[instr.statement];
+      VM_LOG(Trace, "Non-virtual stmt " + std::to_string(instr.statement) + ": " + toString(st));
+      // Expansion depends on the environment (e.g. iteration counts), so it runs every time
+      auto preprocessed = preprocessor_registry_.preprocess(st, env_);
+      for (const auto &preprocessed_st : preprocessed) {
+        if (preprocessed.size() > 1) VM_LOG(Trace, "  Preprocessed: " << toString(preprocessed_st));
+        execStatement(preprocessed_st);
+      }
+      break;
+    }
+    case Opcode::File:
+      if (startsStream(plan, k)) {
+        k = executeStream(plan, k);
+        break;
+      }
+      [[fallthrough]];
+    case Opcode::FixedPoint:
+    case Opcode::Fact:
+    case Opcode::Rule: {
+      const auto &st = program.statements[instr.statement];
+      VM_LOG(Trace, "Non-virtual stmt " + std::to_string(instr.statement) + ": " + toString(st));
+      execStatement(st);
+      break;
+    }
+    case Opcode::VirtualBatch: {
+      // Runs after the plain statements so tensors like Input are defined;
+      // getIterationCount needs them to find the driving tensor
+      const auto &virtualIndexedStmts = plan.virtualStatements();
+      // Training replays the batch from the values it starts from here
+      recurrence_inputs_.clear();
+      for (const auto &st : virtualIndexedStmts) {
+        const std::string name = std::get<TensorEquation>(st).lhs.name.name;
+        recurrence_inputs_[name] = env_.has(name) ? env_.lookup(name).clone() : Tensor();
+      }
+      executeVirtualBatch(virtualIndexedStmts);
+      break;
+    }
+    case Opcode::Query:
+      execStatement(program.statements[instr.statement]);
+      break;
+    }
+    // A streamed group is reported as its first binding
+    if (profiler_) profileInstruction(first, started);
+    releaseThrough(k);
+  }
 
-    for (size_t i = 0; i < expandedVirtual.size(); ++i) {
-      const auto &st = expandedVirtual[i];
+  // Flush barrier: the run's files are complete once it returns
+  fileIOScope.finished = true;
+  file_io_.discard();
+  file_io_.flush();
+}
 
-      if (std::holds_alternative<TensorEquation>(st)) {
-        const auto& eq = std::get<TensorEquation>(st);
-        if (debug_) {
-          std::ostringstream oss;
-          oss << "Virtual stmt " << i << ": " << Environment::key(eq.lhs) << " = ...";
+void TensorLogicVM::execStatement(const Statement &st) {
+  if (std::holds_alternative<TensorEquation>(st)) {
+    execTensorEquation(std::get<TensorEquation>(st));
+  } else if (std::holds_alternative<FixedPointLoop>(st)) {
+    executeFixedPointLoop(std::get<FixedPointLoop>(st));
+  } else if (std::holds_alternative<DatalogFact>(st)) {
+    datalog_engine_.addFact(std::get<DatalogFact>(st));
+  } else if (std::holds_alternative<DatalogRule>(st)) {
+    datalog_engine_.addRule(std::get<DatalogRule>(st));
+  } else if (std::holds_alternative<FileOperation>(st)) {
+    execFileOperation(std::get<FileOperation>(st));
+  } else if (std::holds_alternative<Query>(st)) {
+    // Datalog queries saturate (or derive what they need) in query(); tensor
+    // queries do not read relations and leave pending facts for later
+    execQuery(std::get<Query>(st));
+  } else {
+    // Unknown statement kind
+    VM_LOG(Debug, "Warning: Unknown statement type, skipping");
+  }
+}
 
-          // Show LHS tensor shape if it exists
-          std::string lhsName = Environment::key(eq.lhs);
-          if (env_.has(lhsName)) {
-            oss << " (existing shape: " << env_.lookup(lhsName).sizes() << ")";
-          } else {
-            oss << " (new tensor)";
-          }
-          debugLog(oss.str());
-        }
+static std::filesystem::path resolvePath(const std::string &p) {
+  std::filesystem::path path(p);
+  if (path.is_absolute()) return path;
+  // Try as-is relative to CWD
+  const std::filesystem::path cwd = std::filesystem::current_path();
+  std::filesystem::path candidate = cwd / path;
+  if (std::filesystem::exists(candidate)) return candidate;
+  // TODO: Should we throw here?
+  // Fall back to as-is
+  return candidate;
+}
 
-        try {
-          execTensorEquation(eq);
-        } catch (const std::exception& e) {
-          if (debug_) {
-            debugLog("ERROR executing virtual stmt " + std::to_string(i));
-            debugLog("  LHS: " + Environment::key(eq.lhs));
-            debugLog("  Error: " + std::string(e.what()));
-          }
-          throw;
-        }
-      } else if (std::holds_alternative<FixedPointLoop>(st)) {
-        const auto& loop = std::get<FixedPointLoop>(st);
-        if (debug_) {
-          debugLog("Virtual stmt " + std::to_string(i) + ": FixedPointLoop for " + loop.monitoredTensor);
-        }
-        try {
-          executeFixedPointLoop(loop);
-        } catch (const std::exception& e) {
-          if (debug_) {
-            debugLog("ERROR executing fixed-point loop " + std::to_string(i));
-            debugLog("  Monitored tensor: " + loop.monitoredTensor);
-            debugLog("  Error: " + std::string(e.what()));
-          }
-          throw;
-        }
-      } else if (std::holds_alternative<Query>(st)) {
-        // Ensure closure is up-to-date before answering queries
-        datalog_engine_.saturate();
-        execQuery(std::get<Query>(st));
+void TensorLogicVM::execFileOperation(const FileOperation &fo) {
+  const std::filesystem::path path = resolvePath(fo.file.text);
+  if (relation_io::isRelationFile(path)) {
+    const std::string &relation = fo.tensor.name.name;
+    if (!fo.tensor.indices.empty()) {
+      throw std::runtime_error("Relation files bind a relation name without indices: " + relation);
+    }
+    if (fo.lhsIsTensor) {
+      size_t added = 0;
+      const size_t read = relation_io::read(path, env_.symbols(), [&](size_t arity, const SymbolId *tuples, size_t count) {
+        added += datalog_engine_.addFacts(relation, arity, tuples, count);
+      });
+      VM_LOG(Debug, "Loaded " << read << " tuples (" << added << " new) from '" << fo.file.text << "' into "
+                              << relation);
+    } else {
+      const Relation *rel = env_.relation(relation);
+      if (!rel) throw std::runtime_error("Unknown Datalog relation: " + relation);
+      relation_io::write(path, *rel, env_.symbols());
+      VM_LOG(Debug, "Wrote relation " + relation + " to '" + fo.file.text + "'");
+    }
+    return;
+  }
+
+  if (fo.lhsIsTensor) {
+    // Binary files stay mapped; bind() only copies to change device or dtype.
+    // A prefetched file is taken as read, anything else is read now
+    Tensor t = file_io_.read(path);
+    env_.bind(fo.tensor, t);
+    VM_LOG(Debug, "Loaded tensor from '" << fo.file.text << "' into " << Environment::key(fo.tensor)
+                                         << " shape=" << t.sizes());
+  } else {
+    const auto &src = env_.lookup(fo.tensor);
+    if (async_file_io_) {
+      // The write must see the value as of now. While the environment is
+      // the only owner, the reference the write holds makes writable() copy
+      // before anything writes into it; shared storage is copied here
+      const bool shared = src.defined() && (src.is_sparse() || src.use_count() > 1 || src.storage().use_count() > 1);
+      file_io_.write(path, shared ? src.clone() : src);
+    } else {
+      file_io_.wait(path);
+      tensor_io::write(path, src);
+    }
+    VM_LOG(Debug, "Wrote tensor " << Environment::key(fo.tensor) << " shape=" << src.sizes() << " to '"
+                                  << fo.file.text << "'");
+  }
+}
+
+// -------- Streamed file bindings --------
+
+namespace {
+const Identifier *indexIdentifier(const IndexOrSlice &ios) {
+  const auto *idx = std::get_if<Index>(&ios.value);
+  return idx ? std::get_if<Identifier>(&idx->value) : nullptr;
+}
+
+// How an equation of a streamed segment treats the rows of a chunk
+struct StreamRole {
+  int64_t axis{-1};        // LHS axis of the row index, -1 if it is reduced
+  std::string projection;  // reduced: combines the chunks' partial results
+};
+
+// Role of eq when the chunked tensors (name -> axis of the rows) hold one
+// chunk, or std::nullopt if eq cannot run chunk by chunk: it reads no chunked
+// tensor or a partial accumulator, indexes the rows with different or
+// normalized indices, uses the row index on other tensors, or reduces over
+// the rows in a way that does not combine across chunks
+std::optional<StreamRole> streamRole(const TensorEquation &eq,
+                                     const std::unordered_map<std::string, int64_t> &chunked,
+                                     const std::unordered_set<std::string> &accumulators) {
+  const std::string &target = eq.lhs.name.name;
+  if (eq.clauses.empty() || chunked.count(target) || accumulators.count(target)) return std::nullopt;
+  std::vector<const TensorRef *> refs;
+  executor_utils::forEachTensorRef(eq, [&](const TensorRef &ref) { refs.push_back(&ref); });
+
+  std::optional<std::string> row;
+  for (const TensorRef *ref : refs) {
+    if (accumulators.count(ref->name.name)) return std::nullopt;
+    auto it = chunked.find(ref->name.name);
+    if (it == chunked.end()) continue;
+    if (it->second >= static_cast<int64_t>(ref->indices.size())) return std::nullopt;
+    const Identifier *id = indexIdentifier(ref->indices[it->second]);
+    if (!id || (row && *row != id->name)) return std::nullopt;
+    row = id->name;
+  }
+  if (!row) return std::nullopt;
+  for (const TensorRef *ref : refs) {
+    auto it = chunked.find(ref->name.name);
+    for (size_t d = 0; d < ref->indices.size(); ++d) {
+      const Identifier *id = indexIdentifier(ref->indices[d]);
+      if (!id || id->name != *row) continue;
+      const bool rowAxis = it != chunked.end() && static_cast<int64_t>(d) == it->second;
+      if (!rowAxis || std::get<Index>(ref->indices[d].value).normalized) return std::nullopt;
+    }
+  }
+
+  StreamRole role;
+  for (size_t d = 0; d < eq.lhs.indices.size(); ++d) {
+    // Element and slice writes update a tensor in place
+    const auto *idx = std::get_if<Index>(&eq.lhs.indices[d].value);
+    const Identifier *id = indexIdentifier(eq.lhs.indices[d]);
+    if (!id || idx->normalized) return std::nullopt;
+    if (id->name == *row) role.axis = static_cast<int64_t>(d);
+  }
+  if (role.axis >= 0) return role;
+
+  // Summing products over the rows is the sum of the chunks' sums
+  const std::string projection = eq.projection.empty() ? "=" : eq.projection;
+  std::vector<const ExprTensorRef *> factors;
+  if (projection == "=" && eq.clauses.size() == 1 && !eq.clauses[0].guard &&
+      executor_utils::collectProductFactors(eq.clauses[0].expr, factors)) {
+    role.projection = "+=";
+  } else if (projection == "+=" || projection == "max=" || projection == "min=") {
+    role.projection = projection;
+  } else {
+    return std::nullopt;
+  }
+  return role;
+}
+} // namespace
+
+void TensorLogicVM::setStreamRows(const std::string &tensor, int64_t rows) {
+  if (rows < 0) throw std::invalid_argument("Stream chunks must have a positive number of rows");
+  if (rows == 0) {
+    stream_rows_.erase(tensor);
+  } else {
+    stream_rows_[tensor] = rows;
+  }
+}
+
+void TensorLogicVM::prefetchFiles(const CompiledProgram &plan, bool prune) {
+  // Files are read as the run starts, so only those no earlier statement
+  // of the run writes; streamed bindings read their chunks as they go
+  std::unordered_set<std::string> written;
+  size_t started = 0;
+  for (size_t k = 0; k < plan.instructions_.size(); ++k) {
+    const auto &instr = plan.instructions_[k];
+    if (instr.op != CompiledProgram::Opcode::File || (prune && !plan.live(k))) continue;
+    const auto &fo = std::get<FileOperation>(plan.program().statements[instr.statement]);
+    if (relation_io::isRelationFile(fo.file.text)) continue;
+    const std::filesystem::path path = resolvePath(fo.file.text);
+    if (!fo.lhsIsTensor) {
+      written.insert(path.string());
+    } else if (!written.count(path.string()) && streamRows(fo.tensor.name.name) == 0) {
+      file_io_.prefetch(path);
+      ++started;
+    }
+  }
+  if (started > 0) VM_LOG(Debug, "Prefetching " << started << " tensor file(s)");
+}
+
+int64_t TensorLogicVM::streamRows(const std::string &tensor) const {
+  auto it = stream_rows_.find(tensor);
+  return it == stream_rows_.end() ? 0 : it->second;
+}
+
+bool TensorLogicVM::startsStream(const CompiledProgram &plan, size_t k) const {
+  const auto &instr = plan.instructions_[k];
+  if (instr.op != CompiledProgram::Opcode::File || stream_rows_.empty()) return false;
+  const auto &fo = std::get<FileOperation>(plan.program().statements[instr.statement]);
+  return fo.lhsIsTensor && streamRows(fo.tensor.name.name) > 0 && !relation_io::isRelationFile(fo.file.text);
+}
+
+size_t TensorLogicVM::executeStream(CompiledProgram &plan, size_t first) {
+  using Opcode = CompiledProgram::Opcode;
+  const Program &program = plan.program();
+  const auto &instructions = plan.instructions_;
+
+  // Consecutive streamed bindings are read together, one chunk of each at a time
+  std::vector<std::string> inputs;
+  std::vector<std::unique_ptr<tensor_io::ChunkReader>> readers;
+  std::unordered_map<std::string, int64_t> chunked;
+  int64_t rows = 0;
+  size_t k = first;
+  for (; k < instructions.size() && startsStream(plan, k); ++k) {
+    const auto &fo = std::get<FileOperation>(program.statements[instructions[k].statement]);
+    const std::string &name = fo.tensor.name.name;
+    if (chunked.count(name)) break;
+    inputs.push_back(name);
+    chunked[name] = 0;
+    rows = rows == 0 ? streamRows(name) : std::min(rows, streamRows(name));
+  }
+  const size_t inputEnd = k;
+
+  struct Step {
+    size_t instruction;
+    std::string tensor;  // LHS, or the tensor a write stores
+    StreamRole role;
+    std::unique_ptr<tensor_io::ChunkWriter> writer;  // writes only
+  };
+  std::vector<Step> steps;
+  std::unordered_set<std::string> accumulators;
+  for (; k < instructions.size(); ++k) {
+    const auto &instr = instructions[k];
+    const auto &st = program.statements[instr.statement];
+    if (instr.op == Opcode::Equation) {
+      const auto &eq = std::get<TensorEquation>(st);
+      auto role = streamRole(eq, chunked, accumulators);
+      if (!role) break;
+      if (role->axis >= 0) {
+        chunked[eq.lhs.name.name] = role->axis;
+      } else {
+        accumulators.insert(eq.lhs.name.name);
       }
+      steps.push_back({k, eq.lhs.name.name, *role, nullptr});
+    } else if (instr.op == Opcode::File) {
+      // Chunks are appended along the first axis
+      const auto &fo = std::get<FileOperation>(st);
+      auto it = chunked.find(fo.tensor.name.name);
+      if (fo.lhsIsTensor || it == chunked.end() || it->second != 0) break;
+      steps.push_back({k, fo.tensor.name.name, {}, nullptr});
+    } else {
+      break;
     }
   }
 
-  // Finally, execute any remaining queries that weren't virtual-indexed
-  for (size_t i = 0; i < program.statements.size(); ++i) {
-    const auto &st = program.statements[i];
-    if (std::holds_alternative<Query>(st)) {
-      // Ensure closure is up-to-date before answering queries
-      datalog_engine_.saturate();
-      execQuery(std::get<Query>(st));
+  // Nothing downstream runs row by row: load the files whole
+  if (steps.empty()) {
+    for (size_t j = first; j < inputEnd; ++j) execStatement(program.statements[instructions[j].statement]);
+    return inputEnd - 1;
+  }
+
+  // Chunks go through the files directly, after any background write of them
+  for (size_t j = first; j < inputEnd; ++j) {
+    const auto &fo = std::get<FileOperation>(program.statements[instructions[j].statement]);
+    const std::filesystem::path path = resolvePath(fo.file.text);
+    file_io_.wait(path);
+    readers.push_back(std::make_unique<tensor_io::ChunkReader>(path, rows));
+  }
+  for (auto &step : steps) {
+    const auto &st = program.statements[instructions[step.instruction].statement];
+    if (const auto *fo = std::get_if<FileOperation>(&st)) {
+      const std::filesystem::path path = resolvePath(fo->file.text);
+      file_io_.wait(path);
+      step.writer = std::make_unique<tensor_io::ChunkWriter>(path);
     }
   }
+  VM_LOG(Debug, "Streaming " << inputs.size() << " file binding(s) in chunks of " << rows << " rows through "
+                             << steps.size() << " statements");
+
+  std::unordered_map<std::string, Tensor> partial;
+  int64_t chunks = 0;
+  for (;; ++chunks) {
+    size_t exhausted = 0;
+    bool mismatched = false;
+    int64_t chunkRows = -1;
+    for (size_t i = 0; i < readers.size(); ++i) {
+      auto chunk = readers[i]->next();
+      if (!chunk) {
+        ++exhausted;
+        continue;
+      }
+      mismatched = mismatched || (chunkRows >= 0 && chunk->size(0) != chunkRows);
+      chunkRows = chunk->size(0);
+      env_.bind(inputs[i], *chunk);
+    }
+    if (exhausted == readers.size()) break;
+    if (exhausted != 0 || mismatched) throw std::runtime_error("Files streamed together have different numbers of rows");
+
+    for (auto &step : steps) {
+      if (step.writer) {
+        step.writer->append(env_.lookup(step.tensor));
+        continue;
+      }
+      runEquation(plan, step.instruction);
+      if (step.role.axis >= 0) continue;
+      Tensor value = env_.lookup(step.tensor);
+      auto it = partial.find(step.tensor);
+      if (it != partial.end()) {
+        if (step.role.projection == "max=") {
+          value = torch::maximum(it->second, value);
+        } else if (step.role.projection == "min=") {
+          value = torch::minimum(it->second, value);
+        } else {
+          value = it->second + value;
+        }
+        env_.bind(step.tensor, value);
+      }
+      partial[step.tensor] = value;
+    }
+  }
+
+  for (auto &step : steps) {
+    if (step.writer) step.writer->close();
+  }
+  // Row-wise values only ever existed one chunk at a time
+  for (const auto &entry : chunked) env_.erase(entry.first);
+  VM_LOG(Debug, "Streamed " + std::to_string(chunks) + " chunks");
+  return k - 1;
 }
 
 // Resolve indices to concrete integer positions using either numeric indices
@@ -521,197 +1427,194 @@ static bool resolveConcreteIndices(const TensorRef& ref,
 }
 
 void TensorLogicVM::execTensorEquation(const TensorEquation &eq) {
-  // New refactored version using ExecutorRegistry
+  execTensorEquation(eq, executor_registry_.select(eq, env_));
+}
+
+void TensorLogicVM::execTensorEquation(const TensorEquation &eq, TensorEquationExecutor &executor) {
   try {
-    std::string lhsName = Environment::key(eq.lhs);
-    if (debug_) {
+    if (logging(LogLevel::Trace)) {
       std::ostringstream oss;
-      oss << "Executing: " << lhsName;
+      oss << "Executing: " << Environment::key(eq.lhs);
       if (!eq.lhs.indices.empty()) {
         oss << " with " << eq.lhs.indices.size() << " indices";
       }
       debugLog(oss.str());
     }
-    Tensor result = executor_registry_.execute(eq, env_, *torch_);
-    if (debug_) {
-      std::ostringstream oss;
-      oss << "  Result shape: " << result.sizes() << ", numel=" << result.numel();
-      debugLog(oss.str());
-    }
-
-    // Special case: indexed LHS (e.g., avg[1] = expr, Input_proj2[i,t] = expr)
-    // Some executors (ScalarAssignExecutor, ListLiteralExecutor) handle this internally and return the full tensor.
-    // Others (ExpressionExecutor for non-literal RHS) just return the RHS value.
-    // We need to detect the latter case and do the indexed assignment ourselves.
-    if (!eq.lhs.indices.empty()) {
-      // Check if all indices are concrete (number literals AND/OR uppercase labels)
-      // ScalarAssignExecutor handles assignments where all indices are concrete/labels.
-      // If there are any lowercase free variables, VM must handle indexed assignment.
-      bool allConcreteOrLabelIndices = true;
-      bool hasFreeVariables = false;
-
-      for (const auto& ios : eq.lhs.indices) {
-        // Slices are not concrete - require special handling
-        if (!std::holds_alternative<Index>(ios.value)) {
-          allConcreteOrLabelIndices = false;
-          break;
-        }
-        const auto& idx = std::get<Index>(ios.value);
+    Tensor result = executor_registry_.execute(executor, eq, env_, *torch_);
+    VM_LOG(Trace, "  Result shape: " << result.sizes() << ", numel=" << result.numel());
+    commitEquation(eq, result);
+  } catch (const ExecutionError& e) {
+    VM_LOG(Debug, "Execution error: " + std::string(e.what()));
+    throw;
+  }
+}
 
-        if (std::holds_alternative<NumberLiteral>(idx.value)) {
-          // Concrete numeric index - OK for ScalarAssignExecutor
+void TensorLogicVM::commitEquation(const TensorEquation &eq, const Tensor &result) {
+  const std::string &lhsName = Environment::key(eq.lhs);
+
+  // Special case: indexed LHS (e.g., avg[1] = expr, Input_proj2[i,t] = expr)
+  // Some executors (ScalarAssignExecutor, ListLiteralExecutor) handle this internally and return the full tensor.
+  // Others (ExpressionExecutor for non-literal RHS) just return the RHS value.
+  // We need to detect the latter case and do the indexed assignment ourselves.
+  if (!eq.lhs.indices.empty()) {
+    // Check if all indices are concrete (number literals AND/OR uppercase labels)
+    // ScalarAssignExecutor handles assignments where all indices are concrete/labels.
+    // If there are any lowercase free variables, VM must handle indexed assignment.
+    bool allConcreteOrLabelIndices = true;
+    bool hasFreeVariables = false;
+
+    for (const auto& ios : eq.lhs.indices) {
+      // Slices are not concrete - require special handling
+      if (!std::holds_alternative<Index>(ios.value)) {
+        allConcreteOrLabelIndices = false;
+        break;
+      }
+      const auto& idx = std::get<Index>(ios.value);
+
+      if (std::holds_alternative<NumberLiteral>(idx.value)) {
+        // Concrete numeric index - OK for ScalarAssignExecutor
+        continue;
+      } else if (auto* id = std::get_if<Identifier>(&idx.value)) {
+        // Check if it's a label (uppercase) or a free variable (lowercase)
+        if (!id->name.empty() && std::isupper(id->name[0])) {
+          // Uppercase label - OK for ScalarAssignExecutor
           continue;
-        } else if (auto* id = std::get_if<Identifier>(&idx.value)) {
-          // Check if it's a label (uppercase) or a free variable (lowercase)
-          if (!id->name.empty() && std::isupper(id->name[0])) {
-            // Uppercase label - OK for ScalarAssignExecutor
-            continue;
-          } else {
-            // Lowercase free variable - requires VM indexed assignment
-            hasFreeVariables = true;
-            break;
-          }
         } else {
-          // Other types (VirtualIndex, etc.) - not handled by ScalarAssignExecutor
-          allConcreteOrLabelIndices = false;
+          // Lowercase free variable - requires VM indexed assignment
+          hasFreeVariables = true;
           break;
         }
+      } else {
+        // Other types (VirtualIndex, etc.) - not handled by ScalarAssignExecutor
+        allConcreteOrLabelIndices = false;
+        break;
       }
+    }
 
-      // If all indices are concrete/labels AND there are no free variables,
-      // ScalarAssignExecutor or ListLiteralExecutor already handled the indexed assignment
-      // and returned the full tensor. Just bind it.
-      if (allConcreteOrLabelIndices && !hasFreeVariables) {
-        if (debug_) {
-          debugLog("  All concrete/label indices - executor handled assignment");
-        }
-        env_.bind(eq.lhs, result);
-        return;
-      }
+    // If all indices are concrete/labels AND there are no free variables,
+    // ScalarAssignExecutor or ListLiteralExecutor already handled the indexed assignment
+    // and returned the full tensor. Just bind it.
+    if (allConcreteOrLabelIndices && !hasFreeVariables) {
+      VM_LOG(Trace, "  All concrete/label indices - executor handled assignment");
+      env_.bind(eq.lhs, result);
+      return;
+    }
 
-      // Otherwise, we have free variables (identifiers) and need to do indexed assignment
-      // Build index list from LHS indices
-      // Identifiers (free variables like 'i') become Slice()
-      // NumberLiterals (concrete like '1') become concrete indices
-      std::vector<torch::indexing::TensorIndex> indices;
-      std::vector<int64_t> concreteIndices;  // Track concrete index values
-      std::vector<bool> isConcreteFlag;      // Track which positions are concrete
-      bool hasConcreteIndex = false;
-
-      for (const auto& ios : eq.lhs.indices) {
-        // Handle both Index and Slice
-        if (std::holds_alternative<Slice>(ios.value)) {
-          // Convert TL slice to PyTorch slice with proper bounds
-          const auto& tl_slice = std::get<Slice>(ios.value);
-          indices.push_back(executor_utils::convertSlice(tl_slice));
-          concreteIndices.push_back(-1);  // Placeholder (slices don't have a single concrete index)
-          isConcreteFlag.push_back(false);  // Slices are not concrete single indices
-        } else {
-          const auto& idx = std::get<Index>(ios.value);
-          if (const auto* num = std::get_if<NumberLiteral>(&idx.value)) {
-            long long v = std::stoll(num->text);
-            indices.push_back(static_cast<int64_t>(v));
-            concreteIndices.push_back(static_cast<int64_t>(v));
-            isConcreteFlag.push_back(true);
-            hasConcreteIndex = true;
-          } else if (std::holds_alternative<Identifier>(idx.value)) {
-            // Free variable - use slice to cover all values in that dimension
-            indices.push_back(torch::indexing::Slice());
-            concreteIndices.push_back(-1);  // Placeholder
-            isConcreteFlag.push_back(false);
-          }
+    // Otherwise, we have free variables (identifiers) and need to do indexed assignment
+    // Build index list from LHS indices
+    // Identifiers (free variables like 'i') become Slice()
+    // NumberLiterals (concrete like '1') become concrete indices
+    std::vector<torch::indexing::TensorIndex> indices;
+    std::vector<int64_t> concreteIndices;  // Track concrete index values
+    std::vector<bool> isConcreteFlag;      // Track which positions are concrete
+    bool hasConcreteIndex = false;
+
+    for (const auto& ios : eq.lhs.indices) {
+      // Handle both Index and Slice
+      if (std::holds_alternative<Slice>(ios.value)) {
+        // Convert TL slice to PyTorch slice with proper bounds
+        const auto& tl_slice = std::get<Slice>(ios.value);
+        indices.push_back(executor_utils::convertSlice(tl_slice));
+        concreteIndices.push_back(-1);  // Placeholder (slices don't have a single concrete index)
+        isConcreteFlag.push_back(false);  // Slices are not concrete single indices
+      } else {
+        const auto& idx = std::get<Index>(ios.value);
+        if (const auto* num = std::get_if<NumberLiteral>(&idx.value)) {
+          long long v = std::stoll(num->text);
+          indices.push_back(static_cast<int64_t>(v));
+          concreteIndices.push_back(static_cast<int64_t>(v));
+          isConcreteFlag.push_back(true);
+          hasConcreteIndex = true;
+        } else if (std::holds_alternative<Identifier>(idx.value)) {
+          // Free variable - use slice to cover all values in that dimension
+          indices.push_back(torch::indexing::Slice());
+          concreteIndices.push_back(-1);  // Placeholder
+          isConcreteFlag.push_back(false);
         }
       }
+    }
 
-      if (!indices.empty()) {
-        // Check if tensor exists and needs indexed assignment
-        if (env_.has(lhsName)) {
-          Tensor existingTensor = env_.lookup(lhsName);
+    if (!indices.empty()) {
+      // Check if tensor exists and needs indexed assignment
+      if (env_.has(eq.lhs)) {
+        Tensor existingTensor = env_.lookup(eq.lhs);
 
-          if (debug_) {
-            std::ostringstream oss;
-            oss << "  Indexed assignment (mixed): existing=" << existingTensor.sizes()
-                << " result=" << result.sizes() << " hasConcreteIndex=" << hasConcreteIndex;
-            debugLog(oss.str());
-          }
+        VM_LOG(Trace, "  Indexed assignment (mixed): existing=" << existingTensor.sizes()
+                          << " result=" << result.sizes() << " hasConcreteIndex=" << hasConcreteIndex);
 
-          if (result.numel() < existingTensor.numel() || result.dim() == 0 || hasConcreteIndex) {
-            // Check if we need to resize to accommodate the concrete indices
-            std::vector<int64_t> requiredShape(existingTensor.sizes().begin(), existingTensor.sizes().end());
-            bool needsResize = false;
-
-            for (size_t i = 0; i < isConcreteFlag.size(); ++i) {
-              if (isConcreteFlag[i]) {
-                int64_t requiredSize = concreteIndices[i] + 1;
-                if (i >= requiredShape.size()) {
-                  requiredShape.resize(i + 1, 1);
-                  requiredShape[i] = requiredSize;
-                  needsResize = true;
-                } else if (requiredShape[i] < requiredSize) {
-                  requiredShape[i] = requiredSize;
-                  needsResize = true;
-                }
+        if (result.numel() < existingTensor.numel() || result.dim() == 0 || hasConcreteIndex) {
+          // Check if we need to resize to accommodate the concrete indices
+          std::vector<int64_t> requiredShape(existingTensor.sizes().begin(), existingTensor.sizes().end());
+          bool needsResize = false;
+
+          for (size_t i = 0; i < isConcreteFlag.size(); ++i) {
+            if (isConcreteFlag[i]) {
+              int64_t requiredSize = concreteIndices[i] + 1;
+              if (i >= requiredShape.size()) {
+                requiredShape.resize(i + 1, 1);
+                requiredShape[i] = requiredSize;
+                needsResize = true;
+              } else if (requiredShape[i] < requiredSize) {
+                requiredShape[i] = requiredSize;
+                needsResize = true;
               }
             }
+          }
 
-            // Resize if needed
-            if (needsResize) {
-              Tensor resizedTensor = torch::zeros(requiredShape, existingTensor.options());
-              // Copy existing values
-              if (existingTensor.numel() > 0) {
-                std::vector<torch::indexing::TensorIndex> copyIndices;
-                for (int i = 0; i < existingTensor.dim(); ++i) {
-                  copyIndices.push_back(torch::indexing::Slice(0, existingTensor.size(i)));
-                }
-                resizedTensor.index_put_(copyIndices, existingTensor);
+          // Resize if needed
+          if (needsResize) {
+            Tensor resizedTensor = torch::zeros(requiredShape, existingTensor.options());
+            // Copy existing values
+            if (existingTensor.numel() > 0) {
+              std::vector<torch::indexing::TensorIndex> copyIndices;
+              for (int i = 0; i < existingTensor.dim(); ++i) {
+                copyIndices.push_back(torch::indexing::Slice(0, existingTensor.size(i)));
               }
-              env_.bind(lhsName, resizedTensor);
-              resizedTensor.index_put_(indices, result);
-              return;
-            } else {
-              // No resize needed, just do indexed assignment
-              existingTensor.index_put_(indices, result);
-              return;
+              resizedTensor.index_put_(copyIndices, existingTensor);
             }
+            env_.bind(eq.lhs, resizedTensor);
+            resizedTensor.index_put_(indices, result);
+            return;
+          } else {
+            // No resize needed, just do indexed assignment: in place, unless
+            // the storage is shared (see Environment::writable)
+            existingTensor.reset();
+            env_.writable(eq.lhs).index_put_(indices, result);
+            return;
           }
-        } else if (hasConcreteIndex) {
-          // Tensor doesn't exist yet, and we have concrete indices
-          // We need to create it with appropriate size
-
-          // Infer shape from indices and result
-          std::vector<int64_t> shape;
-          int resultDim = 0;
-          for (size_t i = 0; i < isConcreteFlag.size(); ++i) {
-            if (isConcreteFlag[i]) {
-              shape.push_back(concreteIndices[i] + 1);
+        }
+      } else if (hasConcreteIndex) {
+        // Tensor doesn't exist yet, and we have concrete indices
+        // We need to create it with appropriate size
+
+        // Infer shape from indices and result
+        std::vector<int64_t> shape;
+        int resultDim = 0;
+        for (size_t i = 0; i < isConcreteFlag.size(); ++i) {
+          if (isConcreteFlag[i]) {
+            shape.push_back(concreteIndices[i] + 1);
+          } else {
+            // Slice - use corresponding dimension from result
+            if (resultDim < result.dim()) {
+              shape.push_back(result.size(resultDim));
+              resultDim++;
             } else {
-              // Slice - use corresponding dimension from result
-              if (resultDim < result.dim()) {
-                shape.push_back(result.size(resultDim));
-                resultDim++;
-              } else {
-                shape.push_back(1);
-              }
+              shape.push_back(1);
             }
           }
-
-          // Create new tensor and assign
-          Tensor newTensor = torch::zeros(shape, result.options());
-          newTensor.index_put_(indices, result);
-          env_.bind(lhsName, newTensor);
-          return;
         }
-      }
-    }
 
-    // Default case: bind result to environment
-    env_.bind(eq.lhs, result);
-  } catch (const ExecutionError& e) {
-    if (debug_) {
-      debugLog("Execution error: " + std::string(e.what()));
+        // Create new tensor and assign
+        Tensor newTensor = torch::zeros(shape, result.options());
+        newTensor.index_put_(indices, result);
+        env_.bind(eq.lhs, newTensor);
+        return;
+      }
     }
-    throw;
   }
+
+  // Default case: bind result to environment
+  env_.bind(eq.lhs, result);
 }
 
 // Recursive helper for expression substitution
@@ -780,54 +1683,50 @@ TensorEquation TensorLogicVM::substituteVirtualIndex(const TensorEquation &eq, i
 }
 
 void TensorLogicVM::executeFixedPointLoop(const FixedPointLoop &loop) {
-  constexpr int ABSOLUTE_MAX = ABSOLUTE_MAX_ITERS;  // 10000
-  constexpr int MAX_STABLE = MAX_CONSECUTIVE_STABLE;  // 10
-  constexpr float TOLERANCE = CONVERGENCE_TOLERANCE;  // 0.0001f
+  const ConvergenceOptions &options = convergenceOptions(loop.monitoredTensor);
+
+  // Lowered loops run the body compiled once; the expansion below is the fallback
+  if (native_recurrence_) {
+    if (auto rec = VirtualIndexPreprocessor::lowerFixedPoint(loop, env_)) {
+      rec->iterations = options.maxIterations;
+      rec->convergence = options;
+      convergence_reports_[loop.monitoredTensor] = executeRecurrence(*rec);
+      return;
+    }
+  }
 
+  ConvergenceReport report;
   int consecutiveStableCount = 0;
-  int totalIterations = 0;
   Tensor prevState;
 
-  if (debug_) {
-    std::ostringstream oss;
-    oss << "Fixed-point loop for " << loop.monitoredTensor
-        << " (tolerance=" << TOLERANCE
-        << ", maxStable=" << MAX_STABLE << ")";
-    debugLog(oss.str());
-  }
+  VM_LOG(Debug, "Fixed-point loop for " << loop.monitoredTensor << " (tolerance=" << options.tolerance
+                                         << ", maxStable=" << options.maxStable << ")");
 
-  while (totalIterations < ABSOLUTE_MAX) {
+  while (report.iterations < options.maxIterations && !report.converged) {
     // Save previous state (after first iteration)
-    if (totalIterations > 0 && env_.has(loop.monitoredTensor)) {
+    if (report.iterations > 0 && env_.has(loop.monitoredTensor)) {
       prevState = env_.lookup(loop.monitoredTensor).clone();
     }
 
     // Execute one iteration by substituting virtual index with concrete timestep
-    TensorEquation expandedEq = substituteVirtualIndex(loop.equation, totalIterations);
+    TensorEquation expandedEq = substituteVirtualIndex(loop.equation, report.iterations);
     execTensorEquation(expandedEq);
 
-    totalIterations++;
+    report.iterations++;
 
     // Check convergence (after second iteration onwards)
-    if (totalIterations > 1 && env_.has(loop.monitoredTensor)) {
+    if (report.iterations > 1 && env_.has(loop.monitoredTensor)) {
       Tensor currentState = env_.lookup(loop.monitoredTensor);
 
       // Compute maximum absolute change across all elements
       float maxChange = (currentState - prevState).abs().max().item<float>();
 
-      if (maxChange <= TOLERANCE) {
+      if (maxChange <= options.tolerance) {
         // Value is stable - increment counter
         consecutiveStableCount++;
-
-        if (consecutiveStableCount >= MAX_STABLE) {
-          // Converged! Exit loop
-          if (debug_) {
-            std::ostringstream oss;
-            oss << "  Converged after " << totalIterations
-                << " iterations (change=" << maxChange << ")";
-            debugLog(oss.str());
-          }
-          return;
+        report.converged = consecutiveStableCount >= options.maxStable;
+        if (report.converged) {
+          VM_LOG(Debug, "  Converged after " << report.iterations << " iterations (change=" << maxChange << ")");
         }
       } else {
         // Value changed significantly - reset stability counter
@@ -836,18 +1735,528 @@ void TensorLogicVM::executeFixedPointLoop(const FixedPointLoop &loop) {
     }
   }
 
-  // Hit absolute maximum without convergence
-  if (debug_) {
+  // Hit the maximum without convergence
+  if (!report.converged) VM_LOG(Debug, "  Hit max iterations (" << options.maxIterations << ") without convergence");
+  convergence_reports_[loop.monitoredTensor] = report;
+}
+
+namespace {
+// Times [t0, t1) of a recurrence, run from the values live at t0. Used by
+// checkpointed recurrences: forward runs each segment without gradients,
+// and backward reruns it with gradients from the same inputs.
+//
+// Inputs, in order: the values each step carries into t0 (see carryBegin),
+// by step and then time; the initial values of the steps that have one;
+// the driver tensors; the gradient-carrying tensors the body reads, bound
+// under their names while the segment runs. Outputs: the values produced
+// in the segment that are carried out of t1, by step and then time; then
+// every value of each RHS-only step, to be stacked along t.
+class RecurrenceSegment : public torch::CustomClassHolder {
+public:
+  RecurrenceSegment(const Recurrence &rec, std::vector<size_t> ringSize, std::vector<bool> hasInitial,
+                    std::vector<std::string> params, Environment &env, ExecutorRegistry &registry,
+                    TensorBackend &backend)
+      : rec_(rec), ring_size_(std::move(ringSize)), has_initial_(std::move(hasInitial)),
+        params_(std::move(params)), env_(env), registry_(registry), backend_(backend),
+        executors_(rec.steps.size(), nullptr), layouts_(rec.steps.size(), 0),
+        read_slots_(rec.steps.size()) {
+    for (const auto &view : rec.views) view_slots_.push_back(env.slot(view.name));
+    for (size_t k = 0; k < rec.steps.size(); ++k) {
+      for (const auto &read : rec.steps[k].reads) read_slots_[k].push_back(env.slot(read.name));
+    }
+  }
+
+  // First time of step k whose value is still read at time b
+  int carryBegin(size_t k, int b) const { return std::max(0, b - static_cast<int>(ring_size_[k])); }
+
+  std::vector<Tensor> run(int t0, int t1, const std::vector<Tensor> &inputs) {
+    const size_t stepCount = rec_.steps.size();
+    std::vector<std::vector<Tensor>> ring(stepCount);
+    std::vector<Tensor> initial(stepCount);
+    size_t at = 0;
+    for (size_t k = 0; k < stepCount; ++k) {
+      ring[k].resize(ring_size_[k]);
+      for (int t = carryBegin(k, t0); t < t0; ++t) ring[k][t % ring[k].size()] = inputs[at++];
+    }
+    for (size_t k = 0; k < stepCount; ++k) {
+      if (has_initial_[k]) initial[k] = inputs[at++];
+    }
+    std::vector<Tensor> sources(inputs.begin() + at, inputs.begin() + at + rec_.views.size());
+    at += rec_.views.size();
+    std::vector<Tensor> bound;
+    bound.reserve(params_.size());
+    for (const auto &name : params_) {
+      bound.push_back(env_.lookup(name));
+      env_.bind(name, inputs[at++]);
+    }
+    auto restore = [&] {
+      for (size_t i = 0; i < params_.size(); ++i) env_.bind(params_[i], bound[i]);
+    };
+    auto valueAt = [&](size_t k, int t) -> const Tensor & {
+      return t < 0 ? initial[k] : ring[k][t % ring[k].size()];
+    };
+
+    std::vector<std::vector<Tensor>> collected(stepCount);
+    try {
+      for (int t = t0; t < t1; ++t) {
+        for (size_t k = 0; k < stepCount; ++k) {
+          const auto &op = rec_.steps[k];
+          for (size_t v : op.views) env_.bind(view_slots_[v], sources[v].select(rec_.views[v].dim, t));
+          for (size_t i = 0; i < op.reads.size(); ++i) {
+            env_.bind(read_slots_[k][i], valueAt(op.reads[i].source, t - op.reads[i].lag));
+          }
+          if (!executors_[k] || layouts_[k] != env_.layoutVersion()) {
+            executors_[k] = &registry_.select(op.equation, env_);
+            layouts_[k] = env_.layoutVersion();
+          }
+          Tensor value = registry_.execute(*executors_[k], op.equation, env_, backend_);
+          if (op.state < 0) collected[k].push_back(value);
+          ring[k][t % ring[k].size()] = std::move(value);
+        }
+      }
+    } catch (...) {
+      restore();
+      throw;
+    }
+    restore();
+
+    std::vector<Tensor> outputs;
+    for (size_t k = 0; k < stepCount; ++k) {
+      for (int t = std::max(t0, carryBegin(k, t1)); t < t1; ++t) outputs.push_back(valueAt(k, t));
+    }
+    for (size_t k = 0; k < stepCount; ++k) {
+      for (auto &value : collected[k]) outputs.push_back(std::move(value));
+    }
+    return outputs;
+  }
+
+private:
+  Recurrence rec_;  // a copy: backward runs after the lowered batch is gone
+  std::vector<size_t> ring_size_;
+  std::vector<bool> has_initial_;
+  std::vector<std::string> params_;
+  Environment &env_;
+  ExecutorRegistry &registry_;
+  TensorBackend &backend_;
+  std::vector<TensorEquationExecutor *> executors_;
+  std::vector<uint64_t> layouts_;
+  std::vector<Environment::Slot> view_slots_;               // by view
+  std::vector<std::vector<Environment::Slot>> read_slots_;  // by step and read
+};
+
+// One checkpointed segment: keeps only its inputs for the backward pass,
+// where the segment is recomputed with gradients and differentiated
+struct CheckpointedSegment : public torch::autograd::Function<CheckpointedSegment> {
+  static torch::autograd::variable_list forward(torch::autograd::AutogradContext *ctx,
+                                                c10::intrusive_ptr<RecurrenceSegment> segment, int64_t t0,
+                                                int64_t t1, torch::autograd::variable_list inputs) {
+    ctx->saved_data["segment"] = c10::IValue::make_capsule(segment);
+    ctx->saved_data["t0"] = t0;
+    ctx->saved_data["t1"] = t1;
+    ctx->save_for_backward(inputs);
+    torch::autograd::variable_list outputs = segment->run(static_cast<int>(t0), static_cast<int>(t1), inputs);
+    // Every output must be a tensor of its own: a step may return a value
+    // it read, or the same value twice
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      bool shared = false;
+      for (const auto &in : inputs) shared = shared || (in.defined() && outputs[i].is_alias_of(in));
+      for (size_t j = 0; j < i && !shared; ++j) shared = outputs[i].is_alias_of(outputs[j]);
+      if (shared) outputs[i] = outputs[i].clone();
+    }
+    return outputs;
+  }
+
+  static torch::autograd::variable_list backward(torch::autograd::AutogradContext *ctx,
+                                                 torch::autograd::variable_list grads) {
+    auto segment = c10::static_intrusive_pointer_cast<RecurrenceSegment>(ctx->saved_data["segment"].toCapsule());
+    const int t0 = static_cast<int>(ctx->saved_data["t0"].toInt());
+    const int t1 = static_cast<int>(ctx->saved_data["t1"].toInt());
+    const torch::autograd::variable_list inputs = ctx->get_saved_variables();
+
+    torch::autograd::variable_list leaves;
+    std::vector<size_t> wrt;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      Tensor leaf = inputs[i].defined() ? inputs[i].detach() : inputs[i];
+      if (leaf.defined() && leaf.is_floating_point()) {
+        leaf.requires_grad_(true);
+        wrt.push_back(i);
+      }
+      leaves.push_back(leaf);
+    }
+    torch::autograd::variable_list outputs;
+    {
+      torch::AutoGradMode enable(true);
+      outputs = segment->run(t0, t1, leaves);
+    }
+
+    torch::autograd::variable_list roots, rootGrads, targets;
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      if (!grads[i].defined() || !outputs[i].requires_grad()) continue;
+      roots.push_back(outputs[i]);
+      rootGrads.push_back(grads[i]);
+    }
+    for (size_t i : wrt) targets.push_back(leaves[i]);
+
+    // segment, t0 and t1 take no gradient
+    torch::autograd::variable_list result(3 + inputs.size());
+    if (roots.empty() || targets.empty()) return result;
+    const torch::autograd::variable_list found =
+        torch::autograd::grad(roots, targets, rootGrads, /*retain_graph=*/false, /*create_graph=*/false,
+                              /*allow_unused=*/true);
+    for (size_t j = 0; j < wrt.size(); ++j) result[3 + wrt[j]] = found[j];
+    return result;
+  }
+};
+} // namespace
+
+void TensorLogicVM::executeVirtualBatch(const std::vector<Statement> &virtualIndexedStmts, int checkpoint) {
+  if (native_recurrence_) {
+    if (auto lowered = VirtualIndexPreprocessor::lowerBatch(virtualIndexedStmts, env_)) {
+      for (const auto &rec : *lowered) executeRecurrence(rec, checkpoint);
+      return;
+    }
+  }
+  VM_LOG(Debug, "Batch preprocessing " + std::to_string(virtualIndexedStmts.size()) + " virtual-indexed statements");
+  std::vector<Statement> expandedVirtual = VirtualIndexPreprocessor::preprocessBatch(virtualIndexedStmts, env_, debug_);
+
+  VM_LOG(Debug, "Executing " + std::to_string(expandedVirtual.size()) + " expanded virtual statements");
+
+  for (size_t i = 0; i < expandedVirtual.size(); ++i) {
+    const auto &st = expandedVirtual[i];
+
+    if (std::holds_alternative<TensorEquation>(st)) {
+      const auto& eq = std::get<TensorEquation>(st);
+      if (logging(LogLevel::Trace)) {
+        std::ostringstream oss;
+        oss << "Virtual stmt " << i << ": " << Environment::key(eq.lhs) << " = ...";
+
+        // Show LHS tensor shape if it exists
+        std::string lhsName = Environment::key(eq.lhs);
+        if (env_.has(lhsName)) {
+          oss << " (existing shape: " << env_.lookup(lhsName).sizes() << ")";
+        } else {
+          oss << " (new tensor)";
+        }
+        debugLog(oss.str());
+      }
+
+      try {
+        execTensorEquation(eq);
+      } catch (const std::exception& e) {
+        VM_LOG(Debug, "ERROR executing virtual stmt " << i);
+        VM_LOG(Debug, "  LHS: " << Environment::key(eq.lhs));
+        VM_LOG(Debug, "  Error: " << e.what());
+        throw;
+      }
+    } else if (std::holds_alternative<FixedPointLoop>(st)) {
+      const auto& loop = std::get<FixedPointLoop>(st);
+      VM_LOG(Trace, "Virtual stmt " + std::to_string(i) + ": FixedPointLoop for " + loop.monitoredTensor);
+      try {
+        executeFixedPointLoop(loop);
+      } catch (const std::exception& e) {
+        VM_LOG(Debug, "ERROR executing fixed-point loop " << i);
+        VM_LOG(Debug, "  Monitored tensor: " << loop.monitoredTensor);
+        VM_LOG(Debug, "  Error: " << e.what());
+        throw;
+      }
+    } else {
+      execStatement(st);
+    }
+  }
+}
+
+void TensorLogicVM::replayRecurrences(const std::vector<Statement> &statements, int checkpoint) {
+  for (const auto &st : statements) {
+    const std::string name = std::get<TensorEquation>(st).lhs.name.name;
+    auto it = recurrence_inputs_.find(name);
+    if (it == recurrence_inputs_.end()) continue;
+    // Copies, since the write-back of the final state goes into slot 0
+    if (it->second.defined()) {
+      env_.bind(name, it->second.clone());
+    } else {
+      env_.erase(name);
+    }
+  }
+  executeVirtualBatch(statements, checkpoint);
+}
+
+ConvergenceReport TensorLogicVM::executeRecurrence(const Recurrence &rec, int checkpoint) {
+  const size_t stepCount = rec.steps.size();
+  // Checkpointing only pays off when a backward pass will follow
+  const bool checkpointed = checkpoint != 0 && rec.monitored < 0 && rec.iterations > 1 &&
+                            torch::GradMode::is_enabled();
+  // Fixed-point loops stop at the first converged time, so they finish every
+  // time before starting the next
+  const bool overlap = !checkpointed && rec.wavefront && rec.monitored < 0 && recurrence_threads_ != 1 &&
+                       stepCount > 1;
+  int lastWave = 0;
+  for (const auto &op : rec.steps) lastWave = std::max(lastWave, overlap ? op.wave : 0);
+  VM_LOG(Debug, "Recurrence over " << rec.index << ": " << stepCount << " equations, " << rec.iterations
+                                   << " steps"
+                                   << (overlap ? ", " + std::to_string(rec.iterations + lastWave) + " waves" : ""));
+  ConvergenceReport report;
+  if (rec.iterations == 0) return report;
+
+  // Terms independent of the recurrence, over every step at once
+  for (const auto &eq : rec.hoisted) execTensorEquation(eq);
+
+  // Drivers are not written by the loop, so they are looked up once
+  std::vector<Tensor> sources;
+  sources.reserve(rec.views.size());
+  for (const auto &view : rec.views) sources.push_back(env_.lookup(view.source));
+
+  // Values of each step by time: ring[t % size] holds time t and times
+  // before 0 read the initial state. A ring reaches back as far as its
+  // farthest reader, counting the waves a reader may trail its producer, so
+  // a value is never overwritten while still needed
+  struct History {
+    std::vector<Tensor> ring;
+    Tensor initial;
+  };
+  std::vector<History> history(stepCount);
+  std::vector<size_t> ringSize(stepCount, 1);
+  int monitoredStep = -1;
+  for (size_t k = 0; k < stepCount; ++k) {
+    const auto &op = rec.steps[k];
+    for (const auto &read : op.reads) {
+      const int reach = (overlap ? op.wave - rec.steps[read.source].wave : 0) + read.lag + 1;
+      ringSize[read.source] = std::max(ringSize[read.source], static_cast<size_t>(std::max(reach, 1)));
+    }
+    if (op.state < 0) continue;
+    const auto &state = rec.states[op.state];
+    if (env_.has(state.tensor)) history[k].initial = env_.lookup(state.tensor).select(state.slotDim, 0);
+    if (op.state == rec.monitored) monitoredStep = static_cast<int>(k);
+  }
+  for (size_t k = 0; k < stepCount; ++k) history[k].ring.resize(ringSize[k]);
+  auto valueAt = [&](size_t k, int t) -> const Tensor & {
+    return t < 0 ? history[k].initial : history[k].ring[t % history[k].ring.size()];
+  };
+
+  std::vector<TensorEquationExecutor *> executors(stepCount, nullptr);
+  std::vector<uint64_t> layouts(stepCount, 0);
+  std::vector<std::vector<Tensor>> collected(stepCount);
+
+  // Convergence compares the monitored state's newest value with the one
+  // before it, both still held by its ring, through buffers reused every
+  // step, so checking neither clones the state nor allocates. The count of
+  // stable steps stays on the state's device as well; reading it back is the
+  // only host sync, and happens every checkInterval comparisons.
+  const ConvergenceOptions &convergence = rec.convergence;
+  Tensor diff;
+  Tensor change;
+  Tensor isStable;
+  Tensor stable;
+  int comparisons = 0;
+  bool &converged = report.converged;
+
+  // Per-step names are bound every time, so they are resolved to slots once;
+  // copies of the environment made below share them
+  std::vector<Environment::Slot> viewSlots;
+  viewSlots.reserve(rec.views.size());
+  for (const auto &view : rec.views) viewSlots.push_back(env_.slot(view.name));
+  std::vector<std::vector<Environment::Slot>> readSlots(stepCount);
+  for (size_t k = 0; k < stepCount; ++k) {
+    for (const auto &read : rec.steps[k].reads) readSlots[k].push_back(env_.slot(read.name));
+  }
+  auto bindInputs = [&](size_t k, int t, Environment &env) {
+    const auto &op = rec.steps[k];
+    for (size_t v : op.views) env.bind(viewSlots[v], sources[v].select(rec.views[v].dim, t));
+    for (size_t i = 0; i < op.reads.size(); ++i) {
+      env.bind(readSlots[k][i], valueAt(op.reads[i].source, t - op.reads[i].lag));
+    }
+  };
+  auto commit = [&](size_t k, int t, Tensor value) {
+    if (static_cast<int>(k) == monitoredStep && t > 0) {
+      // Training replays the loop in grad mode; the check is not part of the
+      // graph, and out= ops reject inputs that require grad
+      torch::NoGradGuard noGrad;
+      const Tensor previous = valueAt(k, t - 1).detach();
+      const Tensor current = value.detach();
+      if (!diff.defined()) {
+        diff = torch::empty_like(current);
+        change = torch::empty({}, current.options());
+        isStable = torch::empty({}, current.options().dtype(torch::kFloat32));
+        stable = torch::zeros({}, current.options().dtype(torch::kFloat32));
+      }
+      torch::sub_out(diff, current, previous);
+      diff.abs_();
+      torch::amax_out(change, diff);
+      // A change of at most the tolerance counts as stable; any other resets
+      // the count (stable * isStable + isStable)
+      torch::le_out(isStable, change, convergence.tolerance);
+      stable.mul_(isStable).add_(isStable);
+      if (++comparisons % convergence.checkInterval == 0) {
+        converged = stable.item<float>() >= convergence.maxStable;
+      }
+    }
+    if (rec.steps[k].state < 0) collected[k].push_back(value);
+    history[k].ring[t % history[k].ring.size()] = std::move(value);
+  };
+  // Every step at one time, in body order, on the VM's environment
+  auto runTime = [&](int t) {
+    for (size_t k = 0; k < stepCount; ++k) {
+      const auto &op = rec.steps[k];
+      bindInputs(k, t, env_);
+      // Names bound during the first step change the layout; later steps reuse the choice
+      if (!executors[k] || layouts[k] != env_.layoutVersion()) {
+        executors[k] = &executor_registry_.select(op.equation, env_);
+        layouts[k] = env_.layoutVersion();
+      }
+      commit(k, t, executor_registry_.execute(*executors[k], op.equation, env_, *torch_));
+    }
+    ++report.iterations;
+  };
+
+  if (checkpointed) {
+    // Segments of k steps keep only the values carried across their
+    // boundaries alive for backward, and recompute the rest there: O(T / k)
+    // boundaries plus O(k) recomputed steps, about sqrt(T) each by default
+    const int segment = checkpoint > 0
+        ? checkpoint
+        : std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(rec.iterations)))));
+    VM_LOG(Debug, "  Checkpointed in segments of " + std::to_string(segment) + " steps");
+
+    // Tensors the body reads that carry gradients, other than per-step names
+    std::unordered_set<std::string> local;
+    for (const auto &view : rec.views) local.insert(view.name);
+    for (const auto &op : rec.steps) {
+      local.insert(op.output);
+      for (const auto &read : op.reads) local.insert(read.name);
+    }
+    std::vector<std::string> params;
+    std::vector<Tensor> paramValues;
+    for (const auto &op : rec.steps) {
+      executor_utils::forEachTensorRef(op.equation, [&](const TensorRef &ref) {
+        const std::string &name = ref.name.name;
+        if (!local.insert(name).second || !env_.has(name) || !env_.lookup(name).requires_grad()) return;
+        params.push_back(name);
+        paramValues.push_back(env_.lookup(name));
+      });
+    }
+    // Initial states are views of tensors the write-back below changes in place
+    std::vector<bool> hasInitial(stepCount, false);
+    std::vector<Tensor> initials;
+    for (size_t k = 0; k < stepCount; ++k) {
+      if (!history[k].initial.defined()) continue;
+      hasInitial[k] = true;
+      initials.push_back(history[k].initial.clone());
+    }
+    auto runner = c10::make_intrusive<RecurrenceSegment>(rec, ringSize, hasInitial, params, env_,
+                                                         executor_registry_, *torch_);
+
+    std::map<std::pair<size_t, int>, Tensor> live;  // (step, time) -> value still read
+    for (int t0 = 0; t0 < rec.iterations; t0 += segment) {
+      const int t1 = std::min(rec.iterations, t0 + segment);
+      std::vector<Tensor> inputs;
+      for (size_t k = 0; k < stepCount; ++k) {
+        for (int t = runner->carryBegin(k, t0); t < t0; ++t) inputs.push_back(live.at({k, t}));
+      }
+      inputs.insert(inputs.end(), initials.begin(), initials.end());
+      inputs.insert(inputs.end(), sources.begin(), sources.end());
+      inputs.insert(inputs.end(), paramValues.begin(), paramValues.end());
+
+      std::vector<Tensor> outputs =
+          CheckpointedSegment::apply(runner, static_cast<int64_t>(t0), static_cast<int64_t>(t1), inputs);
+      size_t at = 0;
+      for (size_t k = 0; k < stepCount; ++k) {
+        for (int t = std::max(t0, runner->carryBegin(k, t1)); t < t1; ++t) live[{k, t}] = outputs[at++];
+      }
+      for (size_t k = 0; k < stepCount; ++k) {
+        if (rec.steps[k].state >= 0) continue;
+        for (int t = t0; t < t1; ++t) collected[k].push_back(outputs[at++]);
+      }
+      for (auto it = live.begin(); it != live.end();) {
+        it = it->first.second < runner->carryBegin(it->first.first, t1) ? live.erase(it) : std::next(it);
+      }
+    }
+    for (const auto &[key, value] : live) {
+      history[key.first].ring[key.second % history[key.first].ring.size()] = value;
+    }
+    report.iterations = rec.iterations;
+  } else if (!overlap) {
+    for (int t = 0; t < rec.iterations && !converged; ++t) runTime(t);
+  } else {
+    // Time 0 binds every per-step name and selects every executor, so the
+    // copies the waves run on need neither: their layout never changes
+    runTime(0);
+    std::vector<Environment> lanes(stepCount, env_);
+    ThreadPool::obtain(recurrence_pool_, recurrence_threads_);
+    std::vector<std::pair<size_t, int>> tasks;
+    const bool grad = torch::GradMode::is_enabled();  // thread-local, so workers inherit it explicitly
+    for (int w = 1; w < rec.iterations + lastWave; ++w) {
+      tasks.clear();
+      for (size_t k = 0; k < stepCount; ++k) {
+        const int t = w - rec.steps[k].wave;
+        if (t >= 1 && t < rec.iterations) tasks.emplace_back(k, t);
+      }
+      // Steps of one wave read only earlier waves and write only their own ring
+      recurrence_pool_->parallelFor(tasks.size(), [&](size_t i) {
+        const auto [k, t] = tasks[i];
+        torch::AutoGradMode mode(grad);
+        bindInputs(k, t, lanes[k]);
+        commit(k, t, executor_registry_.execute(*executors[k], rec.steps[k].equation, lanes[k], *torch_));
+      });
+    }
+    report.iterations = rec.iterations;
+  }
+  // The cap may fall between two reads of the count
+  if (!converged && comparisons % convergence.checkInterval != 0) {
+    converged = stable.item<float>() >= convergence.maxStable;
+  }
+
+  if (logging(LogLevel::Debug) && rec.monitored >= 0) {
     std::ostringstream oss;
-    oss << "  Hit max iterations (" << ABSOLUTE_MAX
-        << ") without convergence";
+    if (converged) {
+      oss << "  Converged after " << report.iterations << " iterations (change=" << change.item<float>() << ")";
+    } else {
+      oss << "  Hit max iterations (" << rec.iterations << ") without convergence";
+    }
     debugLog(oss.str());
   }
+
+  for (size_t k = 0; k < stepCount; ++k) {
+    if (rec.steps[k].state >= 0) env_.bind(rec.steps[k].output, valueAt(k, report.iterations - 1));
+  }
+
+  // State$next holds the final value; store it in slot 0 as the expansion does
+  for (const auto &state : rec.states) execTensorEquation(state.writeBack);
+
+  // Stack per-step values along t and write them into the leading window of
+  // the target, growing it like repeated Out[i, t] element writes would
+  for (size_t k = 0; k < rec.steps.size(); ++k) {
+    const auto &op = rec.steps[k];
+    if (op.state >= 0) continue;
+    Tensor stacked = torch::stack(collected[k], op.axis);
+    if (!env_.has(op.target) || env_.lookup(op.target).dim() != stacked.dim()) {
+      env_.bind(op.target, stacked);
+      continue;
+    }
+    // The window is written in place, so an aliased target is copied first
+    Tensor target = env_.writable(op.target);
+    std::vector<int64_t> shape(target.sizes().begin(), target.sizes().end());
+    std::vector<torch::indexing::TensorIndex> window;
+    bool grow = false;
+    for (int64_t d = 0; d < stacked.dim(); ++d) {
+      if (stacked.size(d) > shape[d]) {
+        shape[d] = stacked.size(d);
+        grow = true;
+      }
+      window.push_back(torch::indexing::Slice(0, stacked.size(d)));
+    }
+    if (grow) {
+      Tensor grown = torch::zeros(shape, target.options());
+      std::vector<torch::indexing::TensorIndex> old;
+      for (int64_t d = 0; d < target.dim(); ++d) old.push_back(torch::indexing::Slice(0, target.size(d)));
+      grown.index(old).copy_(target);
+      target = grown;
+    }
+    target.index(window).copy_(stacked);
+    env_.bind(op.target, target);
+  }
+  return report;
 }
 
 void TensorLogicVM::execQuery(const Query &q) {
-  using torch::indexing::TensorIndex;
-
   // Handle learning directives
   if (q.directive.has_value()) {
     const auto& directive = q.directive.value();
@@ -860,87 +2269,103 @@ void TensorLogicVM::execQuery(const Query &q) {
       throw std::runtime_error("Learning directives only supported for tensor queries");
     }
 
-    if (debug_) {
-      debugLog("Executing learning directive: @" + directive.name.name + " on " + targetName);
-    }
+    VM_LOG(Debug, "Executing learning directive: @" + directive.name.name + " on " + targetName);
 
     // Execute the learning directive
-    torch::Tensor result = learning_engine_->executeDirective(targetName, directive, current_program_);
+    torch::Tensor result = learning_engine_->executeDirective(targetName, directive, *current_program_);
 
     // Print the result
     (*output_stream_) << targetName << " (after " << directive.name.name << ") =\n" << result << std::endl;
     return;
   }
 
-  // Handle tensor queries
-  if (std::holds_alternative<TensorRef>(q.target)) {
-    const auto &ref = std::get<TensorRef>(q.target);
-    const std::string name = Environment::key(ref);
-    if (debug_) debugLog("Query: " + name);
-    // Lookup (throws if missing)
-    const auto &t = env_.lookup(ref);
-
-    // If specific indices provided (numeric or label), print scalar value
-    std::vector<int64_t> idxs;
-    if (!ref.indices.empty() && resolveConcreteIndices(ref, env_, idxs, false)) {
-      // Special case: 0-dim (scalar) tensors cannot be indexed
-      // If query is like avg[0]?, we treat [0] as a "no-op" index for scalars
-      if (t.dim() == 0) {
-        // Check that all indices are 0
-        bool allZero = true;
-        for (int64_t idx : idxs) {
-          if (idx != 0) {
-            allZero = false;
-            break;
-          }
-        }
-        if (!allZero) {
-          throw std::runtime_error("Cannot index 0-dim tensor with non-zero indices: " + name);
-        }
-        // Just use the scalar value directly
-        double val = 0.0;
-        try { val = t.item<double>(); } catch (...) { val = t.item<float>(); }
-        (*output_stream_) << name << "[";
-        for (size_t i = 0; i < idxs.size(); ++i) { if (i) (*output_stream_) << ","; (*output_stream_) << idxs[i]; }
-        (*output_stream_) << "] = " << val << std::endl;
-        if (debug_) {
-          std::ostringstream oss;
-          oss << "Query tensor present: shape=" << t.sizes() << " (0-dim scalar)";
-          debugLog(oss.str());
-        }
-        return;
-      }
+  query_io::writeText(*output_stream_, query(q), env_.symbols());
+}
 
-      // Normal case: index into multi-dimensional tensor
-      std::vector<TensorIndex> elemIdx;
-      elemIdx.reserve(idxs.size());
-      for (int64_t v : idxs) elemIdx.emplace_back(v);
-      torch::Tensor elem = t.index(elemIdx);
-      double val = 0.0;
-      try { val = elem.item<double>(); } catch (...) { val = elem.item<float>(); }
-      (*output_stream_) << name << "[";
-      for (size_t i = 0; i < idxs.size(); ++i) { if (i) (*output_stream_) << ","; (*output_stream_) << idxs[i]; }
-      (*output_stream_) << "] = " << val << std::endl;
-      if (debug_) {
-        std::ostringstream oss;
-        oss << "Query tensor present: shape=" << t.sizes();
-        debugLog(oss.str());
+QueryResult TensorLogicVM::query(const Query &q) {
+  using torch::indexing::TensorIndex;
+  if (q.directive) throw std::invalid_argument("Queries with learning directives only run as statements");
+
+  if (!std::holds_alternative<TensorRef>(q.target)) return datalog_engine_.solve(q);
+
+  const auto &ref = std::get<TensorRef>(q.target);
+  QueryResult result;
+  result.name = Environment::key(ref);
+  VM_LOG(Debug, "Query: " + result.name);
+  // Lookup (throws if missing)
+  const auto &t = env_.lookup(ref);
+  result.tensor = t;
+
+  // Specific indices (numeric or label) select one element
+  std::vector<int64_t> idxs;
+  if (!ref.indices.empty() && resolveConcreteIndices(ref, env_, idxs, false)) {
+    result.indices = std::move(idxs);
+    if (t.dim() == 0) {
+      // A 0-dim tensor cannot be indexed; avg[0]? reads it as a no-op index
+      for (int64_t idx : result.indices) {
+        if (idx != 0) throw std::runtime_error("Cannot index 0-dim tensor with non-zero indices: " + result.name);
       }
-      return;
+      VM_LOG(Debug, "Query tensor present: shape=" << t.sizes() << " (0-dim scalar)");
+      return result;
     }
+    std::vector<TensorIndex> elemIdx(result.indices.begin(), result.indices.end());
+    result.tensor = t.index(elemIdx);
+  }
+  VM_LOG(Debug, "Query tensor present: shape=" << t.sizes());
+  if (!q.modifiers.empty()) applyModifiers(q.modifiers, result);
+  return result;
+}
 
-    // Otherwise, print entire tensor
-    (*output_stream_) << name << " =\n" << t << std::endl;
-    if (debug_) {
-      std::ostringstream oss;
-      oss << "Query tensor present: shape=" << t.sizes();
-      debugLog(oss.str());
-    }
-    return;
+void TensorLogicVM::projectRelation(const std::string &relation, const std::string &tensor) {
+  datalog_engine_.saturate();
+  env_.labelRelation(relation);
+  env_.bind(tensor, env_.relationTensor(relation));
+  VM_LOG(Debug, "Projected relation " << relation << " into " << tensor << " shape=" << env_.lookup(tensor).sizes());
+}
+
+size_t TensorLogicVM::thresholdTensor(const std::string &tensor, const std::string &relation, double threshold) {
+  const Tensor &t = env_.lookup(tensor);
+  const std::vector<SymbolId> tuples = env_.tensorTuples(t, threshold);
+  const size_t arity = static_cast<size_t>(t.dim());
+  if (arity == 0) {
+    throw std::invalid_argument("Cannot threshold scalar " + tensor + " into relation " + relation);
   }
+  const size_t added = datalog_engine_.addFacts(relation, arity, tuples.data(), tuples.size() / arity);
+  VM_LOG(Debug, "Thresholded " << tensor << " at " << threshold << " into " << relation << ": "
+                               << tuples.size() / arity << " tuples (" << added << " new)");
+  return added;
+}
 
-  // Handle Datalog queries - delegate to DatalogEngine
-  datalog_engine_.query(q, *output_stream_);
+void TensorLogicVM::saveSnapshot(const std::filesystem::path &path) const {
+  snapshot_io::write(path, env_, datalog_engine_);
+  VM_LOG(Debug, "Saved snapshot to " << path.string());
+}
+
+void TensorLogicVM::loadSnapshot(const std::filesystem::path &path) {
+  datalog_engine_.restore(snapshot_io::read(path, env_));
+  VM_LOG(Debug, "Restored snapshot from " << path.string() << ": " << env_.tensors().size() << " tensors, "
+                << env_.relations().size() << " relations");
+}
+
+void TensorLogicVM::applyModifiers(const QueryModifiers &modifiers, QueryResult &result) const {
+  if (modifiers.exists) throw std::invalid_argument("@exists applies to Datalog queries, not tensor " + result.name);
+  if (result.tensor.dim() == 0) {
+    throw std::invalid_argument("@topk and @limit select from a tensor with dimensions, not scalar " + result.name);
+  }
+  Tensor t = result.tensor.is_sparse() ? result.tensor.to_dense() : result.tensor;
+  if (modifiers.topk) {
+    // Largest first along the last dimension, without sorting the whole tensor
+    const int64_t k = static_cast<int64_t>(std::min<uint64_t>(*modifiers.topk, static_cast<uint64_t>(t.size(-1))));
+    auto [values, positions] = torch::topk(t, k);
+    t = values;
+    result.positions = positions;
+  }
+  if (modifiers.limit) {
+    const int64_t n = static_cast<int64_t>(std::min<uint64_t>(*modifiers.limit, static_cast<uint64_t>(t.size(0))));
+    t = t.slice(0, 0, n);
+    if (result.positions.defined()) result.positions = result.positions.slice(0, 0, n);
+  }
+  result.tensor = t;
 }
 
 } // namespace tl
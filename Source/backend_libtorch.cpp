@@ -1,13 +1,20 @@
 #include "TL/backend.hpp"
+#include "TL/Runtime/EinsumPath.hpp"
+#include "TL/Runtime/NativeEinsum.hpp"
+#include "TL/vm.hpp"
 
 #include <torch/torch.h>
+#include <algorithm>
+#include <cctype>
 #include <iostream>
+#include <optional>
 
 namespace tl {
 
 class LibTorchBackend final : public TensorBackend {
 public:
-  LibTorchBackend() = default;
+  explicit LibTorchBackend(const torch::Device &device = torch::kCPU)
+      : device_(device) {}
   ~LibTorchBackend() override = default;
 
   Tensor compute(const Equation &eq) override {
@@ -29,29 +36,403 @@ public:
 
   Tensor einsum(const std::string &indices,
                 const std::vector<Tensor> &tensors) override {
-    // Use at::einsum from LibTorch
-    return torch::einsum(indices, tensors);
+    const bool cast = policy_ != DTypePolicy{};
+    bool moved = false;
+    std::vector<Tensor> local;
+    for (const auto &t : tensors) {
+      if (t.device() != device_ || (cast && t.scalar_type() != policy_.compute)) {
+        moved = true;
+        break;
+      }
+    }
+    if (moved) {
+      local.reserve(tensors.size());
+      for (const auto &t : tensors) {
+        local.push_back(cast ? policy_.toCompute(t.to(device_)) : t.to(device_));
+      }
+    }
+    const std::vector<Tensor> &operands = moved ? local : tensors;
+
+    Tensor result;
+    // torch::einsum contracts left to right; with three or more operands
+    // run the cheapest pairwise order instead, planned once per shape
+    if (operands.size() >= 3) {
+      if (auto path = paths_.get(indices, operands)) {
+        result = path->run(operands);
+      }
+    }
+    if (!result.defined()) result = torch::einsum(indices, operands);
+    if (cast && result.scalar_type() != policy_.accumulate) {
+      result = result.to(policy_.accumulate);
+    }
+    return result;
   }
 
   void learn(const Program &, const Loss &) override {
     // Phase 1 stub: learning handled at program level in future steps
   }
+
+  torch::Device device() const override { return device_; }
+  void setDevice(const torch::Device &device) override { device_ = device; }
+  void setDTypePolicy(const DTypePolicy &policy) override { policy_ = policy; }
+
+private:
+  torch::Device device_;
+  DTypePolicy policy_;
+  EinsumPathCache paths_;
+};
+
+namespace {
+
+// Operand and output labels of an einsum spec; nullopt for ellipsis or a
+// malformed spec. Implicit outputs are labels used once, in alphabetical order.
+std::optional<std::vector<std::string>> splitSpec(const std::string &spec) {
+  std::string text;
+  for (char c : spec) {
+    if (c == '.') return std::nullopt;
+    if (c != ' ') text.push_back(c);
+  }
+  std::vector<std::string> parts;
+  const size_t arrow = text.find("->");
+  const std::string lhs = text.substr(0, arrow);
+  size_t start = 0;
+  while (true) {
+    const size_t comma = lhs.find(',', start);
+    parts.push_back(lhs.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+    if (comma == std::string::npos) break;
+    start = comma + 1;
+  }
+  if (arrow != std::string::npos) {
+    parts.push_back(text.substr(arrow + 2));
+  } else {
+    std::string out;
+    for (char c = 'A'; c <= 'z'; ++c) {
+      if (!std::isalpha(static_cast<unsigned char>(c))) continue;
+      size_t uses = 0;
+      for (char l : lhs) uses += l == c ? 1 : 0;
+      if (uses == 1) out.push_back(c);
+    }
+    parts.push_back(out);
+  }
+  return parts;
+}
+
+bool distinctLabels(const std::string &labels) {
+  for (size_t i = 0; i < labels.size(); ++i) {
+    if (labels.find(labels[i], i + 1) != std::string::npos) return false;
+  }
+  return true;
+}
+
+// Contract a sparse COO operand with a dense one. Every nonzero of `s` picks
+// the row of `d` addressed by the labels both share, scales it by its value
+// and is added into the output cell addressed by its own output labels, so
+// the work is proportional to nnz(s) times the size of d's output-only axes.
+// Returns an undefined tensor for label patterns this does not cover
+// (repeated labels, mismatched extents).
+Tensor contractSparseDense(const Tensor &s, const std::string &sL, const Tensor &d,
+                           const std::string &dL, const std::string &outL) {
+  if (!distinctLabels(sL) || !distinctLabels(dL) || !distinctLabels(outL)) return Tensor();
+  if (static_cast<int64_t>(sL.size()) != s.dim() || static_cast<int64_t>(dL.size()) != d.dim()) return Tensor();
+
+  auto extentOf = [&](char c) -> int64_t {
+    auto p = sL.find(c);
+    if (p != std::string::npos) return s.size(static_cast<int64_t>(p));
+    p = dL.find(c);
+    return p == std::string::npos ? -1 : d.size(static_cast<int64_t>(p));
+  };
+  std::string shared, sOut, dOut;
+  std::vector<int64_t> dReduced;
+  for (char c : sL) {
+    if (dL.find(c) != std::string::npos) {
+      if (s.size(static_cast<int64_t>(sL.find(c))) != d.size(static_cast<int64_t>(dL.find(c)))) return Tensor();
+      shared.push_back(c);
+    }
+    if (outL.find(c) != std::string::npos) sOut.push_back(c);
+  }
+  for (size_t k = 0; k < dL.size(); ++k) {
+    const char c = dL[k];
+    if (sL.find(c) != std::string::npos) continue;
+    if (outL.find(c) != std::string::npos) {
+      dOut.push_back(c);
+    } else {
+      dReduced.push_back(static_cast<int64_t>(k));
+    }
+  }
+  for (char c : outL) {
+    if (extentOf(c) < 0) return Tensor();
+  }
+
+  auto type = c10::promoteTypes(s.scalar_type(), d.scalar_type());
+  if (!c10::isFloatingType(type)) type = torch::kFloat32;
+
+  // d as a [shared, output-only] matrix after summing its private labels
+  Tensor dm = d.to(type);
+  std::string dLabels = dL;
+  if (!dReduced.empty()) {
+    dm = dm.sum(dReduced);
+    for (auto it = dReduced.rbegin(); it != dReduced.rend(); ++it) dLabels.erase(static_cast<size_t>(*it), 1);
+  }
+  std::vector<int64_t> perm;
+  int64_t sharedVolume = 1, restVolume = 1;
+  for (char c : shared) {
+    perm.push_back(static_cast<int64_t>(dLabels.find(c)));
+    sharedVolume *= extentOf(c);
+  }
+  for (char c : dOut) {
+    perm.push_back(static_cast<int64_t>(dLabels.find(c)));
+    restVolume *= extentOf(c);
+  }
+  dm = dm.permute(perm).contiguous().reshape({sharedVolume, restVolume});
+
+  const Tensor coo = s.coalesce();
+  const Tensor idx = coo.indices();
+  const Tensor vals = coo.values().to(type);
+  const int64_t nnz = vals.size(0);
+
+  auto flatIndex = [&](const std::string &labels) {
+    Tensor flat = torch::zeros({nnz}, idx.options());
+    for (char c : labels) flat = flat * extentOf(c) + idx[static_cast<int64_t>(sL.find(c))];
+    return flat;
+  };
+  const Tensor rowOf = flatIndex(shared);
+  const Tensor cellOf = flatIndex(sOut);
+
+  int64_t sOutVolume = 1;
+  for (char c : sOut) sOutVolume *= extentOf(c);
+  Tensor acc = torch::zeros({sOutVolume, restVolume}, dm.options());
+  // Bound the gathered rows to about 16M elements at a time
+  const int64_t chunk = std::max<int64_t>(1, (int64_t{1} << 24) / std::max<int64_t>(1, restVolume));
+  for (int64_t begin = 0; begin < nnz; begin += chunk) {
+    const int64_t len = std::min(chunk, nnz - begin);
+    Tensor rows = dm.index_select(0, rowOf.narrow(0, begin, len)) * vals.narrow(0, begin, len).unsqueeze(1);
+    acc.index_add_(0, cellOf.narrow(0, begin, len), rows);
+  }
+
+  // [sOut..., dOut...] -> output label order
+  std::vector<int64_t> shape;
+  const std::string labels = sOut + dOut;
+  for (char c : labels) shape.push_back(extentOf(c));
+  std::vector<int64_t> order;
+  for (char c : outL) order.push_back(static_cast<int64_t>(labels.find(c)));
+  return acc.reshape(shape).permute(order).contiguous();
+}
+
+Tensor densify(const Tensor &t) { return t.is_sparse() ? t.to_dense() : t; }
+
+} // namespace
+
+// Einsums over COO operands. Each pairwise contraction with a sparse side is
+// done by contractSparseDense; three or more operands follow the planned
+// pairwise order, so only the first contractions usually see sparse inputs.
+class SparseBackend final : public TensorBackend {
+public:
+  explicit SparseBackend(const torch::Device &device = torch::kCPU)
+      : device_(device) {}
+
+  Tensor compute(const Equation &eq) override {
+    if (eq.kind == Equation::Kind::Einsum) return einsum(eq.einsum_spec, eq.operands);
+    if (eq.kind == Equation::Kind::Constant) return eq.constant;
+    if (!eq.operands.empty()) return eq.operands.front();
+    if (eq.constant.defined()) return eq.constant;
+    throw std::invalid_argument("Identity equation missing operand");
+  }
+
+  Tensor einsum(const std::string &indices,
+                const std::vector<Tensor> &tensors) override {
+    std::vector<Tensor> operands;
+    operands.reserve(tensors.size());
+    for (const auto &t : tensors) operands.push_back(t.to(device_));
+
+    Tensor result;
+    if (operands.size() == 2) {
+      result = contractPair(indices, operands[0], operands[1]);
+    } else if (operands.size() >= 3) {
+      std::vector<std::vector<int64_t>> shapes;
+      for (const auto &t : operands) shapes.push_back(t.sizes().vec());
+      if (auto path = EinsumPath::plan(indices, shapes)) {
+        for (const auto &step : path->steps()) {
+          Tensor r = contractPair(step.spec, operands[step.lhs], operands[step.rhs]);
+          operands.erase(operands.begin() + static_cast<std::ptrdiff_t>(step.rhs));
+          operands.erase(operands.begin() + static_cast<std::ptrdiff_t>(step.lhs));
+          operands.push_back(std::move(r));
+        }
+        result = operands.front();
+      }
+    }
+    if (!result.defined()) {
+      for (auto &t : operands) t = densify(t);
+      result = torch::einsum(indices, operands);
+    }
+    if (policy_ != DTypePolicy{} && result.scalar_type() != policy_.accumulate) {
+      result = result.to(policy_.accumulate);
+    }
+    return result;
+  }
+
+  void learn(const Program &, const Loss &) override {}
+
+  torch::Device device() const override { return device_; }
+  void setDevice(const torch::Device &device) override { device_ = device; }
+  void setDTypePolicy(const DTypePolicy &policy) override { policy_ = policy; }
+
+private:
+  static Tensor contractPair(const std::string &spec, Tensor a, Tensor b) {
+    if (a.is_sparse() && b.is_sparse()) {
+      // Keep the sparser side in COO
+      if (BackendRouter::density(a) > BackendRouter::density(b)) {
+        a = a.to_dense();
+      } else {
+        b = b.to_dense();
+      }
+    }
+    if (a.is_sparse() || b.is_sparse()) {
+      if (auto parts = splitSpec(spec); parts && parts->size() == 3) {
+        const auto &p = *parts;
+        Tensor r = a.is_sparse() ? contractSparseDense(a, p[0], b, p[1], p[2])
+                                 : contractSparseDense(b, p[1], a, p[0], p[2]);
+        if (r.defined()) return r;
+      }
+    }
+    return torch::einsum(spec, {densify(a), densify(b)});
+  }
+
+  torch::Device device_;
+  DTypePolicy policy_;
+};
+
+// LibTorch, except for einsums NativeEinsum runs as a compiled kernel. Mixed
+// precision policies always take LibTorch.
+class NativeBackend final : public TensorBackend {
+public:
+  explicit NativeBackend(const torch::Device &device) : dense_(device), native_(device.is_cpu()) {}
+
+  Tensor compute(const Equation &eq) override {
+    if (eq.kind == Equation::Kind::Einsum) return einsum(eq.einsum_spec, eq.operands);
+    return dense_.compute(eq);
+  }
+
+  Tensor einsum(const std::string &indices,
+                const std::vector<Tensor> &tensors) override {
+    if (native_ && NativeEinsum::enabled()) {
+      Tensor result = NativeEinsum::run(indices, tensors);
+      if (result.defined()) return result;
+    }
+    return dense_.einsum(indices, tensors);
+  }
+
+  void learn(const Program &prog, const Loss &loss) override { dense_.learn(prog, loss); }
+
+  torch::Device device() const override { return dense_.device(); }
+  void setDevice(const torch::Device &device) override {
+    dense_.setDevice(device);
+    native_ = device.is_cpu() && policy_ == DTypePolicy{};
+  }
+  void setDTypePolicy(const DTypePolicy &policy) override {
+    dense_.setDTypePolicy(policy);
+    policy_ = policy;
+    native_ = dense_.device().is_cpu() && policy_ == DTypePolicy{};
+  }
+
+private:
+  LibTorchBackend dense_;
+  DTypePolicy policy_;
+  bool native_;  // CPU and the default policy
+};
+
+// Sends each einsum to the sparse or dense backend (BackendRouter::analyze)
+class HybridBackend final : public TensorBackend {
+public:
+  HybridBackend(std::unique_ptr<TensorBackend> sparse, std::unique_ptr<TensorBackend> dense,
+                const SparseRouting &routing)
+      : sparse_(std::move(sparse)), dense_(std::move(dense)), routing_(routing) {}
+
+  Tensor compute(const Equation &eq) override {
+    if (eq.kind == Equation::Kind::Einsum) return einsum(eq.einsum_spec, eq.operands);
+    return dense_->compute(eq);
+  }
+
+  Tensor einsum(const std::string &indices,
+                const std::vector<Tensor> &tensors) override {
+    // Same decision as BackendRouter::analyze, with each operand scanned once
+    const bool anySparse = std::any_of(tensors.begin(), tensors.end(),
+                                       [](const Tensor &t) { return t.is_sparse(); });
+    const auto convert = BackendRouter::denseToConvert(tensors, routing_);
+    if (!anySparse && std::find(convert.begin(), convert.end(), true) == convert.end()) {
+      return dense_->einsum(indices, tensors);
+    }
+    std::vector<Tensor> operands;
+    operands.reserve(tensors.size());
+    for (size_t i = 0; i < tensors.size(); ++i) {
+      operands.push_back(convert[i] ? tensors[i].to_sparse() : tensors[i]);
+    }
+    return sparse_->einsum(indices, operands);
+  }
+
+  void learn(const Program &prog, const Loss &loss) override { dense_->learn(prog, loss); }
+
+  torch::Device device() const override { return dense_->device(); }
+  void setDevice(const torch::Device &device) override {
+    sparse_->setDevice(device);
+    dense_->setDevice(device);
+  }
+  void setDTypePolicy(const DTypePolicy &policy) override {
+    sparse_->setDTypePolicy(policy);
+    dense_->setDTypePolicy(policy);
+  }
+
+private:
+  std::unique_ptr<TensorBackend> sparse_;
+  std::unique_ptr<TensorBackend> dense_;
+  SparseRouting routing_;
 };
 
-std::unique_ptr<TensorBackend> BackendFactory::create(BackendType type) {
+torch::Device parseDevice(const std::string &spec) {
+  std::string s;
+  for (char c : spec) s.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+  if (s == "cpu") return torch::kCPU;
+  if (s == "mps") {
+    if (!at::hasMPS()) throw std::invalid_argument("MPS device is not available");
+    return torch::Device(torch::kMPS);
+  }
+  if (s == "cuda" || s.rfind("cuda:", 0) == 0) {
+    int index = 0;
+    if (s.size() > 4) {
+      const std::string digits = s.substr(5);
+      if (digits.empty() || digits.find_first_not_of("0123456789") != std::string::npos) {
+        throw std::invalid_argument("Invalid device: " + spec);
+      }
+      index = std::stoi(digits);
+    }
+    if (!torch::cuda::is_available()) throw std::invalid_argument("CUDA device is not available");
+    if (index >= static_cast<int>(torch::cuda::device_count())) {
+      throw std::invalid_argument("CUDA device index out of range: " + spec);
+    }
+    return torch::Device(torch::kCUDA, static_cast<torch::DeviceIndex>(index));
+  }
+  throw std::invalid_argument("Invalid device: " + spec + " (expected cpu, cuda, cuda:N or mps)");
+}
+
+std::unique_ptr<TensorBackend> BackendFactory::create(BackendType type,
+                                                      const torch::Device &device) {
   switch (type) {
   case BackendType::LibTorch:
-    return std::make_unique<LibTorchBackend>();
+    return std::make_unique<LibTorchBackend>(device);
+  case BackendType::Sparse:
+    return std::make_unique<SparseBackend>(device);
+  case BackendType::Native:
+    return std::make_unique<NativeBackend>(device);
   }
   throw std::invalid_argument("Unsupported backend type");
 }
 
 std::unique_ptr<TensorBackend> BackendFactory::createHybrid(
     std::unique_ptr<TensorBackend> sparse,
-    std::unique_ptr<TensorBackend> dense) {
-  // Phase 1: no hybrid routing. Prefer dense backend if provided.
-  if (dense) return dense;
-  return sparse;
+    std::unique_ptr<TensorBackend> dense,
+    const SparseRouting &routing) {
+  if (!sparse) return dense;
+  if (!dense) return sparse;
+  return std::make_unique<HybridBackend>(std::move(sparse), std::move(dense), routing);
 }
 
 } // namespace tl
@@ -1,15 +1,28 @@
 #include "TL/AST.hpp"
 #include "TL/Parser.hpp"
+#include "TL/ProgramCache.hpp"
+#include "TL/Runtime/NativeEinsum.hpp"
 #include "TL/backend.hpp"
 #include "TL/vm.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <iostream>
 #include <optional>
+#include <stdexcept>
 #include <torch/torch.h>
 
 /// Parses, Evaluates/Executes the given '.tl' file
-void runFile(const std::string &fileName, bool debug) {
+/// With a profile path, prints the profile summary to stderr and writes the
+/// Chrome trace there. With a restore path, the program continues from that
+/// snapshot; with a snapshot path, the final state is saved there.
+void runFile(const std::string &fileName, bool debug, bool cache, bool keepAll, bool demand,
+             const torch::Device &device, const tl::DTypePolicy &dtype,
+             const std::optional<std::string> &profilePath,
+             const std::optional<std::string> &restorePath,
+             const std::optional<std::string> &snapshotPath) {
   try {
-    const tl::Program prog = tl::parseFile(fileName);
+    const tl::Program prog = cache ? tl::loadProgram(fileName) : tl::parseFile(fileName);
     std::cout << "Parsed program: " << prog.statements.size() << " statement(s)"
               << std::endl;
     // Print a short preview
@@ -25,8 +38,27 @@ void runFile(const std::string &fileName, bool debug) {
     // Execute program
     tl::TensorLogicVM vm;
     vm.setDebug(debug);
+    // Only queries and file writes are visible from the command line, unless
+    // the whole state is saved
+    vm.setDeadCodeElimination(!keepAll && !snapshotPath);
+    vm.setReleaseIntermediates(!keepAll && !snapshotPath);
+    vm.datalog().setDemandDriven(demand);
+    vm.setDevice(device);
+    vm.setDTypePolicy(dtype);
+    tl::Profiler profiler;
+    if (profilePath) vm.setProfiler(&profiler);
+    if (restorePath) vm.loadSnapshot(*restorePath);
     vm.execute(prog);
     std::cout << "Executed program successfully." << std::endl;
+    if (snapshotPath) {
+      vm.saveSnapshot(*snapshotPath);
+      std::cout << "Saved snapshot to " << *snapshotPath << std::endl;
+    }
+    if (profilePath) {
+      profiler.summary(std::cerr);
+      profiler.writeChromeTrace(*profilePath);
+      std::cerr << "Wrote trace to " << *profilePath << std::endl;
+    }
   } catch (const tl::ParseError &e) {
     std::cerr << e.what() << std::endl;
   } catch (const std::exception &e) {
@@ -95,8 +127,12 @@ bool handleCommand(const std::string &line, std::unique_ptr<tl::TensorLogicVM> &
     } else if (line == "\\clear" || line == "\\reset") {
       // Create a new VM to reset the environment
       const bool debugMode = vm->debug();
+      const torch::Device device = vm->device();
+      const tl::DTypePolicy dtype = vm->dtypePolicy();
       vm = std::make_unique<tl::TensorLogicVM>();
       vm->setDebug(debugMode);
+      vm->setDevice(device);
+      vm->setDTypePolicy(dtype);
       std::cout << "Environment cleared." << std::endl;
       return true;
     } else if (line == "\\debug") {
@@ -113,7 +149,7 @@ bool handleCommand(const std::string &line, std::unique_ptr<tl::TensorLogicVM> &
   // Parse and execute TensorLogic statement
   try {
     const tl::Program prog = tl::parseProgram(line);
-    vm->execute(prog);
+    vm->append(prog);
     return true;
   } catch (const tl::ParseError &e) {
     std::cerr << "Parse error: " << e.what() << std::endl;
@@ -127,8 +163,10 @@ bool handleCommand(const std::string &line, std::unique_ptr<tl::TensorLogicVM> &
 /**
  * Starts the REPL (Read-Eval-Print Loop)
  */
-void runRepl() {
+void runRepl(const torch::Device &device, const tl::DTypePolicy &dtype) {
   auto vm = std::make_unique<tl::TensorLogicVM>();
+  vm->setDevice(device);
+  vm->setDTypePolicy(dtype);
   bool shouldQuit = false;
 
   std::cout << "TensorLogic REPL v0.1" << std::endl;
@@ -157,10 +195,31 @@ void printBackendEinsumDemo() {
   std::cout << "Einsum result (3x5):\n" << res << std::endl;
 }
 
+/// Thread count of a command-line flag: a non-negative integer, 0 for the default
+size_t parseThreadCount(const std::string &spec, const std::string &flag) {
+  const bool digits = !spec.empty() && spec.size() <= 6 &&
+                      std::all_of(spec.begin(), spec.end(), [](unsigned char c) { return std::isdigit(c); });
+  if (!digits) throw std::invalid_argument("Invalid thread count for " + flag + ": '" + spec + "'");
+  return static_cast<size_t>(std::stoul(spec));
+}
+
 int main(const int argc, char **argv) {
 
   // Parse optional flags
   bool debug = false;
+  bool cache = true;
+  bool keepAll = false;
+  bool demand = false;
+  bool profile = false;
+  std::optional<std::string> profilePath;
+  std::optional<std::string> restorePath;
+  std::optional<std::string> snapshotPath;
+  std::optional<std::string> deviceSpec;
+  std::optional<std::string> dtypeSpec;
+  std::optional<std::string> threadsSpec;
+  std::optional<std::string> interopSpec;
+  std::optional<std::string> numaSpec;
+  bool pin = false;
   int argi = 1;
   while (argi < argc && argv[argi][0] == '-') {
     std::string opt = argv[argi];
@@ -169,8 +228,140 @@ int main(const int argc, char **argv) {
       ++argi;
       continue;
     }
+    if (opt == "--no-cache") {
+      cache = false;
+      ++argi;
+      continue;
+    }
+    if (opt == "--keep-all") {
+      keepAll = true;
+      ++argi;
+      continue;
+    }
+    if (opt == "--demand") {
+      demand = true;
+      ++argi;
+      continue;
+    }
+    if (opt == "--native") {
+      tl::NativeEinsum::setEnabled(true);
+      ++argi;
+      continue;
+    }
+    if (opt == "--profile") {
+      profile = true;
+      ++argi;
+      continue;
+    }
+    if (opt.rfind("--profile=", 0) == 0) {
+      profile = true;
+      profilePath = opt.substr(10);
+      ++argi;
+      continue;
+    }
+    if (opt == "--restore" && argi + 1 < argc) {
+      restorePath = argv[argi + 1];
+      argi += 2;
+      continue;
+    }
+    if (opt.rfind("--restore=", 0) == 0) {
+      restorePath = opt.substr(10);
+      ++argi;
+      continue;
+    }
+    if (opt == "--snapshot" && argi + 1 < argc) {
+      snapshotPath = argv[argi + 1];
+      argi += 2;
+      continue;
+    }
+    if (opt.rfind("--snapshot=", 0) == 0) {
+      snapshotPath = opt.substr(11);
+      ++argi;
+      continue;
+    }
+    if (opt == "--device" && argi + 1 < argc) {
+      deviceSpec = argv[argi + 1];
+      argi += 2;
+      continue;
+    }
+    if (opt.rfind("--device=", 0) == 0) {
+      deviceSpec = opt.substr(9);
+      ++argi;
+      continue;
+    }
+    if (opt == "--dtype" && argi + 1 < argc) {
+      dtypeSpec = argv[argi + 1];
+      argi += 2;
+      continue;
+    }
+    if (opt.rfind("--dtype=", 0) == 0) {
+      dtypeSpec = opt.substr(8);
+      ++argi;
+      continue;
+    }
+    if (opt == "--threads" && argi + 1 < argc) {
+      threadsSpec = argv[argi + 1];
+      argi += 2;
+      continue;
+    }
+    if (opt.rfind("--threads=", 0) == 0) {
+      threadsSpec = opt.substr(10);
+      ++argi;
+      continue;
+    }
+    if (opt == "--interop-threads" && argi + 1 < argc) {
+      interopSpec = argv[argi + 1];
+      argi += 2;
+      continue;
+    }
+    if (opt.rfind("--interop-threads=", 0) == 0) {
+      interopSpec = opt.substr(18);
+      ++argi;
+      continue;
+    }
+    if (opt == "--pin") {
+      pin = true;
+      ++argi;
+      continue;
+    }
+    if (opt == "--numa" && argi + 1 < argc) {
+      numaSpec = argv[argi + 1];
+      argi += 2;
+      continue;
+    }
+    if (opt.rfind("--numa=", 0) == 0) {
+      numaSpec = opt.substr(7);
+      ++argi;
+      continue;
+    }
     std::cerr << "Unknown option: " << opt << "\n";
-    std::cerr << "Usage: tl [--debug|-d] <file.tl>\n";
+    std::cerr << "Usage: tl [--debug|-d] [--no-cache] [--keep-all] [--demand] [--native] [--profile[=trace.json]] "
+                 "[--restore FILE] [--snapshot FILE] [--device cpu|cuda[:N]|mps] "
+                 "[--dtype fp32|mixed-bf16|mixed-fp16|bf16|fp16] [--threads N] "
+                 "[--interop-threads N] [--pin] [--numa none|compact|spread] <file.tl>\n";
+    return 1;
+  }
+
+  // Flags take precedence over TL_DEVICE / TL_DTYPE / TL_THREADS; all are
+  // validated up front
+  torch::Device device = torch::kCPU;
+  tl::DTypePolicy dtype;
+  if (const char *env = std::getenv("TL_DEVICE"); env && *env) deviceSpec = deviceSpec.value_or(env);
+  if (const char *env = std::getenv("TL_DTYPE"); env && *env) dtypeSpec = dtypeSpec.value_or(env);
+  if (const char *env = std::getenv("TL_THREADS"); env && *env) threadsSpec = threadsSpec.value_or(env);
+  try {
+    if (deviceSpec) device = tl::parseDevice(*deviceSpec);
+    if (dtypeSpec) dtype = tl::DTypePolicy::parse(*dtypeSpec);
+    if (threadsSpec || interopSpec || numaSpec || pin) {
+      tl::ThreadOptions threads;
+      if (threadsSpec) threads.intraOp = parseThreadCount(*threadsSpec, "--threads");
+      if (interopSpec) threads.interOp = parseThreadCount(*interopSpec, "--interop-threads");
+      if (numaSpec) threads.numa = tl::parseNumaPolicy(*numaSpec);
+      threads.pin = pin;
+      tl::TensorLogicVM::setThreadOptions(threads);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
     return 1;
   }
 
@@ -184,11 +375,14 @@ int main(const int argc, char **argv) {
       return 1;
     }
 
+    // The trace goes next to the program unless a path was given
+    if (profile && !profilePath) profilePath = fileName.substr(0, fileName.size() - 3) + ".trace.json";
+
     // Run file
-    runFile(fileName, debug);
+    runFile(fileName, debug, cache, keepAll, demand, device, dtype, profilePath, restorePath, snapshotPath);
   } else {
     // Start REPL if no file provided
-    runRepl();
+    runRepl(device, dtype);
   }
 
   return 0;
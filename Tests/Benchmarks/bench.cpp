@@ -0,0 +1,358 @@
+// tl_bench: timing harness over Examples/Programs and synthetic workloads
+//
+// Every case is run `warmup` times untimed and `reps` times timed, each run
+// on a fresh VM. A run is split into phases:
+//   parse     source text to AST
+//   compile   AST to CompiledProgram
+//   kernel    time inside executors (ExecutorRegistry stats)
+//   saturate  Datalog rule saturation (DatalogEngine::saturationTime)
+//   dispatch  the rest of execution: planning, executor choice, binding
+// Results go to stdout as a table and, with --json, to a file.
+//
+// Usage: tl_bench [--warmup N] [--reps N] [--filter TEXT] [--programs DIR]
+//                 [--no-programs] [--no-synthetic] [--json FILE]
+
+#include "TL/Parser.hpp"
+#include "TL/vm.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace tl;
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    int warmup{1};
+    int reps{10};
+    std::string filter;
+    std::string programs{std::string(TL_SOURCE_DIR) + "/Examples/Programs"};
+    bool runPrograms{true};
+    bool runSynthetic{true};
+    std::string json;
+};
+
+struct Case {
+    std::string name;
+    std::string kind;  // "program" or "synthetic"
+    std::string source;
+};
+
+// Milliseconds per phase of one run
+struct Sample {
+    double parse{0}, compile{0}, kernel{0}, saturate{0}, dispatch{0};
+    double total() const { return parse + compile + kernel + saturate + dispatch; }
+};
+
+struct Result {
+    Case bench;
+    std::vector<Sample> samples;
+    std::string error;
+};
+
+double ms(std::chrono::nanoseconds d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+// Nearest-rank percentile of unsorted values
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(values.size())));
+    return values[std::min(values.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+double mean(const std::vector<double>& values) {
+    double sum = 0.0;
+    for (double v : values) sum += v;
+    return values.empty() ? 0.0 : sum / static_cast<double>(values.size());
+}
+
+Sample runOnce(const std::string& source) {
+    std::ostream discard(nullptr);
+    Sample s;
+    auto start = Clock::now();
+    const Program program = parseProgram(source);
+    s.parse = ms(Clock::now() - start);
+
+    TensorLogicVM vm{&discard, &discard};
+    start = Clock::now();
+    CompiledProgram plan = vm.compile(program);
+    s.compile = ms(Clock::now() - start);
+
+    start = Clock::now();
+    vm.execute(plan);
+    const double run = ms(Clock::now() - start);
+    for (const auto& stats : vm.executors().stats()) s.kernel += ms(stats.executeTime);
+    s.saturate = ms(vm.datalog().saturationTime());
+    s.dispatch = std::max(0.0, run - s.kernel - s.saturate);
+    return s;
+}
+
+// -------- Synthetic workloads --------
+
+// Deterministic values in [-1, 1)
+struct Values {
+    uint64_t state{0x2545F4914F6CDD1Dull};
+    double next() {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return static_cast<double>(state >> 11) / static_cast<double>(1ull << 52) - 1.0;
+    }
+};
+
+void matrix(std::ostream& os, const std::string& name, int rows, int cols, Values& values) {
+    os << name << " = [";
+    for (int r = 0; r < rows; ++r) {
+        os << (r ? ", [" : "[");
+        for (int c = 0; c < cols; ++c) os << (c ? ", " : "") << std::fixed << std::setprecision(4) << values.next() * 0.5;
+        os << "]";
+    }
+    os << "]\n";
+}
+
+// Transitive closure of a chain over n nodes with a few shortcuts
+std::string closure(int n) {
+    std::ostringstream os;
+    for (int i = 0; i + 1 < n; ++i) os << "Edge(N" << i << ", N" << i + 1 << ")\n";
+    for (int i = 0; i + 7 < n; i += 7) os << "Edge(N" << i << ", N" << i + 7 << ")\n";
+    os << "Path(x, y) <- Edge(x, y)\n"
+       << "Path(x, z) <- Path(x, y), Edge(y, z)\n"
+       << "Path(N0, x)?\n";
+    return os.str();
+}
+
+// Elman RNN with hidden and input size d over t steps
+std::string rnn(int t, int d = 16) {
+    Values values;
+    std::ostringstream os;
+    matrix(os, "W", d, d, values);
+    matrix(os, "U", d, d, values);
+    matrix(os, "Input", d, t, values);
+    for (int i = 0; i < d; ++i) os << "State[" << i << ", 0] = 0.0\n";
+    os << "State[i, *t+1] = tanh(W[i, j] State[j, *t] + U[i, j] Input[j, t])\n"
+       << "State[0, 0]?\n";
+    return os.str();
+}
+
+// Self-attention with h heads over l positions, model width d
+std::string attention(int h, int l, int d = 16) {
+    Values values;
+    std::ostringstream os;
+    matrix(os, "X", l, d, values);
+    os << "scale = " << std::sqrt(static_cast<double>(d)) << "\n";
+    std::string sum;
+    for (int k = 0; k < h; ++k) {
+        const std::string n = std::to_string(k);
+        matrix(os, "WQ" + n, d, d, values);
+        matrix(os, "WK" + n, d, d, values);
+        matrix(os, "WV" + n, d, d, values);
+        os << "Q" << n << "[p, e] = WQ" << n << "[e, f] X[p, f]\n"
+           << "K" << n << "[p, e] = WK" << n << "[e, f] X[p, f]\n"
+           << "V" << n << "[p, e] = WV" << n << "[e, f] X[p, f]\n"
+           << "S" << n << "[p, q] = Q" << n << "[p, e] K" << n << "[q, e] / scale\n"
+           << "A" << n << "[p, q.] = softmax(S" << n << "[p, q])\n"
+           << "O" << n << "[p, e] = A" << n << "[p, q] V" << n << "[q, e]\n";
+        sum += (sum.empty() ? "" : " + ") + ("O" + n + "[p, e]");
+    }
+    os << "Out[p, e] = " << sum << "\n"
+       << "Out[0, e]?\n";
+    return os.str();
+}
+
+std::vector<Case> syntheticCases() {
+    std::vector<Case> cases;
+    for (int n : {64, 256}) cases.push_back({"closure/n=" + std::to_string(n), "synthetic", closure(n)});
+    for (int t : {32, 256}) cases.push_back({"rnn/t=" + std::to_string(t), "synthetic", rnn(t)});
+    for (auto hl : {std::pair<int, int>{2, 32}, std::pair<int, int>{8, 128}}) {
+        cases.push_back({"attention/h=" + std::to_string(hl.first) + ",l=" + std::to_string(hl.second),
+                         "synthetic", attention(hl.first, hl.second)});
+    }
+    return cases;
+}
+
+std::vector<Case> programCases(const std::string& dir) {
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".tl") files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+    std::vector<Case> cases;
+    for (const auto& file : files) {
+        std::ifstream in(file, std::ios::binary);
+        std::ostringstream text;
+        text << in.rdbuf();
+        cases.push_back({"program/" + file.stem().string(), "program", text.str()});
+    }
+    return cases;
+}
+
+// -------- Reporting --------
+
+std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof buf, "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+std::vector<double> phase(const Result& r, double Sample::*field) {
+    std::vector<double> values;
+    for (const auto& s : r.samples) values.push_back(s.*field);
+    return values;
+}
+
+std::vector<double> totals(const Result& r) {
+    std::vector<double> values;
+    for (const auto& s : r.samples) values.push_back(s.total());
+    return values;
+}
+
+void printTable(const std::vector<Result>& results) {
+    std::cout << std::left << std::setw(48) << "case" << std::right << std::setw(10) << "p50 ms" << std::setw(10)
+              << "p90 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "parse" << std::setw(10) << "compile"
+              << std::setw(10) << "dispatch" << std::setw(10) << "kernel" << std::setw(10) << "saturate" << "\n";
+    std::cout << std::fixed << std::setprecision(3);
+    for (const auto& r : results) {
+        std::cout << std::left << std::setw(48) << r.bench.name << std::right;
+        if (!r.error.empty()) {
+            std::cout << "  error: " << r.error << "\n";
+            continue;
+        }
+        const auto t = totals(r);
+        std::cout << std::setw(10) << percentile(t, 50) << std::setw(10) << percentile(t, 90) << std::setw(10)
+                  << percentile(t, 99);
+        for (auto field : {&Sample::parse, &Sample::compile, &Sample::dispatch, &Sample::kernel, &Sample::saturate}) {
+            std::cout << std::setw(10) << percentile(phase(r, field), 50);
+        }
+        std::cout << "\n";
+    }
+}
+
+void writeJson(const std::string& path, const Options& options, const std::vector<Result>& results) {
+    std::ofstream os(path, std::ios::trunc);
+    if (!os) throw std::runtime_error("Cannot write " + path);
+    os << std::setprecision(6);
+    os << "{\n  \"warmup\": " << options.warmup << ",\n  \"reps\": " << options.reps << ",\n  \"cases\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        os << (i ? ",\n" : "\n") << "    {\"name\": " << jsonString(r.bench.name) << ", \"kind\": "
+           << jsonString(r.bench.kind);
+        if (!r.error.empty()) {
+            os << ", \"status\": \"error\", \"error\": " << jsonString(r.error) << "}";
+            continue;
+        }
+        const auto t = totals(r);
+        os << ", \"status\": \"ok\", \"total_ms\": {\"min\": " << percentile(t, 0) << ", \"mean\": " << mean(t)
+           << ", \"p50\": " << percentile(t, 50) << ", \"p90\": " << percentile(t, 90) << ", \"p99\": "
+           << percentile(t, 99) << ", \"max\": " << percentile(t, 100) << "}, \"phase_p50_ms\": {";
+        const std::pair<const char*, double Sample::*> phases[] = {{"parse", &Sample::parse},
+                                                                   {"compile", &Sample::compile},
+                                                                   {"dispatch", &Sample::dispatch},
+                                                                   {"kernel", &Sample::kernel},
+                                                                   {"saturate", &Sample::saturate}};
+        for (size_t p = 0; p < std::size(phases); ++p) {
+            os << (p ? ", " : "") << "\"" << phases[p].first << "\": " << percentile(phase(r, phases[p].second), 50);
+        }
+        os << "}}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+int usage() {
+    std::cerr << "Usage: tl_bench [--warmup N] [--reps N] [--filter TEXT] [--programs DIR] "
+                 "[--no-programs] [--no-synthetic] [--json FILE]\n";
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string opt = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (opt == "--warmup" && hasValue) {
+            options.warmup = std::max(0, std::atoi(argv[++i]));
+        } else if (opt == "--reps" && hasValue) {
+            options.reps = std::max(1, std::atoi(argv[++i]));
+        } else if (opt == "--filter" && hasValue) {
+            options.filter = argv[++i];
+        } else if (opt == "--programs" && hasValue) {
+            options.programs = argv[++i];
+        } else if (opt == "--json" && hasValue) {
+            options.json = argv[++i];
+        } else if (opt == "--no-programs") {
+            options.runPrograms = false;
+        } else if (opt == "--no-synthetic") {
+            options.runSynthetic = false;
+        } else {
+            std::cerr << "Unknown option: " << opt << "\n";
+            return usage();
+        }
+    }
+
+    std::vector<Case> cases;
+    try {
+        if (options.runPrograms) cases = programCases(options.programs);
+    } catch (const std::exception& e) {
+        std::cerr << "Cannot read programs: " << e.what() << "\n";
+        return 1;
+    }
+    if (options.runSynthetic) {
+        for (auto& c : syntheticCases()) cases.push_back(std::move(c));
+    }
+
+    std::vector<Result> results;
+    for (const auto& c : cases) {
+        if (!options.filter.empty() && c.name.find(options.filter) == std::string::npos) continue;
+        Result r{c, {}, {}};
+        try {
+            for (int i = 0; i < options.warmup; ++i) runOnce(c.source);
+            for (int i = 0; i < options.reps; ++i) r.samples.push_back(runOnce(c.source));
+        } catch (const std::exception& e) {
+            r.samples.clear();
+            r.error = e.what();
+        }
+        results.push_back(std::move(r));
+    }
+
+    printTable(results);
+    if (!options.json.empty()) {
+        try {
+            writeJson(options.json, options, results);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Parser.hpp"
+#include "TL/vm.hpp"
+#include "TL/Runtime/AttentionFusion.hpp"
+#include <sstream>
+
+using namespace tl;
+
+namespace {
+const std::string kInputs = R"(
+    Q = [[1.0, 0.5], [0.2, -0.3], [0.7, 0.9]]
+    K = [[0.4, 1.0], [-0.5, 0.3], [0.8, 0.1], [0.0, -0.6]]
+    V = [[1.0, 2.0, 0.5], [0.0, -1.0, 1.5], [2.0, 0.5, -0.5], [0.3, 0.3, 0.3]]
+    sqrt_dk = 1.414
+)";
+
+// Disables attention fusion for the lifetime of the guard
+struct AttentionFusionDisabled {
+    AttentionFusionDisabled() { FusedAttention::setEnabled(false); }
+    ~AttentionFusionDisabled() { FusedAttention::setEnabled(true); }
+};
+
+// Runs with intermediates released, where attention chains are fused
+Tensor runReleased(const std::string& source, const std::string& result, bool* boundWeights = nullptr) {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.setReleaseIntermediates(true);
+    vm.execute(parseProgram(source));
+    if (boundWeights) *boundWeights = vm.env().has("Attn");
+    REQUIRE(vm.env().has(result));
+    return vm.env().lookup(result);
+}
+
+// Attention groups of a compiled program, by the statement that ends them
+std::vector<const CompiledProgram::AttentionGroup*> attentionGroups(const CompiledProgram& plan) {
+    std::vector<const CompiledProgram::AttentionGroup*> groups;
+    for (size_t k = 0; k < plan.instructions().size(); ++k) {
+        if (const auto* group = plan.attentionAt(k)) groups.push_back(group);
+    }
+    return groups;
+}
+}
+
+TEST_CASE("Attention chains are recognized when compiling", "[attention]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+
+    SECTION("Scaled scores run as SDPA") {
+        const CompiledProgram plan = vm.compile(parseProgram(kInputs + R"(
+            Scores[p, s] = Q[p, d] K[s, d] / sqrt_dk
+            Attn[p, s.] = softmax(Scores[p, s])
+            Out[p, v] = Attn[p, s] V[s, v]
+            Out[p, v]?
+        )"));
+        const auto groups = attentionGroups(plan);
+        REQUIRE(groups.size() == 1);
+        CHECK(groups[0]->members.size() == 2);
+        CHECK(groups[0]->kernel.usesSdpa());
+        for (size_t m : groups[0]->members) CHECK(plan.fusedInto(m) >= 0);
+    }
+
+    SECTION("Masked scores are evaluated blockwise") {
+        const CompiledProgram plan = vm.compile(parseProgram(kInputs + R"(
+            Mask = [[1.0, 0.0, 0.0, 0.0], [1.0, 1.0, 0.0, 0.0], [1.0, 1.0, 1.0, 0.0]]
+            RawScores[p, s] = Q[p, d] K[s, d] / sqrt_dk
+            Masked[p, s] = RawScores[p, s] * Mask[p, s] + -1000.0 * (1.0 - Mask[p, s])
+            Attn[p, s.] = softmax(Masked[p, s])
+            Out[p, v] = Attn[p, s] V[s, v]
+            Out[p, v]?
+        )"));
+        const auto groups = attentionGroups(plan);
+        REQUIRE(groups.size() == 1);
+        CHECK(groups[0]->members.size() == 3);
+        CHECK_FALSE(groups[0]->kernel.usesSdpa());
+    }
+
+    SECTION("Weights read elsewhere stay materialized") {
+        const CompiledProgram plan = vm.compile(parseProgram(kInputs + R"(
+            Attn[p, s.] = softmax(Q[p, d] K[s, d] / sqrt_dk)
+            Out[p, v] = Attn[p, s] V[s, v]
+            Attn[0, s]?
+            Out[p, v]?
+        )"));
+        CHECK(attentionGroups(plan).empty());
+    }
+}
+
+TEST_CASE("Fused attention matches the equations run one by one", "[attention]") {
+    const std::vector<std::string> chains = {
+        // Scores inlined into the weights; values on the left of the weighted sum
+        R"(
+            Scores[p, s] = Q[p, d] K[s, d] / sqrt_dk
+            Attn[p, s.] = softmax(Scores[p, s])
+            Out[v, p] = V[s, v] Attn[p, s]
+        )",
+        // Causal mask written arithmetically, as in 13_masked_self_attention
+        R"(
+            Mask = [[1.0, 0.0, 0.0, 0.0], [1.0, 1.0, 0.0, 0.0], [1.0, 1.0, 1.0, 0.0]]
+            RawScores[p, s] = Q[p, d] K[s, d] / sqrt_dk
+            Masked[p, s] = RawScores[p, s] * Mask[p, s] + -1000.0 * (1.0 - Mask[p, s])
+            Attn[p, s.] = softmax(Masked[p, s])
+            Out[p, v] = Attn[p, s] V[s, v]
+        )",
+        // Heads as a batch index, with an additive mask broadcast over them
+        R"(
+            Scale = [1.0, 2.0]
+            HQ[h, p, d] = Scale[h] Q[p, d]
+            HK[h, s, d] = Scale[h] K[s, d]
+            HV[h, s, v] = Scale[h] V[s, v]
+            Bias = [[0.0, -1.0, 0.0, 2.0], [0.5, 0.0, 0.0, 0.0], [0.0, 0.0, -3.0, 0.0]]
+            Attn[h, p, s.] = softmax(HQ[h, p, d] HK[h, s, d] * 0.5 + Bias[p, s])
+            Out[h, p, v] = Attn[h, p, s] HV[h, s, v]
+        )",
+    };
+
+    for (const auto& chain : chains) {
+        const std::string source = kInputs + chain + "Out?\n";
+        INFO(chain);
+
+        bool boundWeights = true;
+        Tensor fused = runReleased(source, "Out", &boundWeights);
+        CHECK_FALSE(boundWeights);
+        Tensor unfused;
+        {
+            AttentionFusionDisabled guard;
+            unfused = runReleased(source, "Out");
+        }
+        REQUIRE(fused.sizes() == unfused.sizes());
+        CHECK(torch::allclose(fused, unfused, 1e-4, 1e-5));
+    }
+}
@@ -0,0 +1,60 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Batcher.hpp"
+#include "TL/Parser.hpp"
+#include <future>
+#include <sstream>
+#include <vector>
+
+using namespace tl;
+
+TEST_CASE("Batcher stacks concurrent requests into one run", "[batcher]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram("W = [[1.0, 2.0], [3.0, 4.0]]"));
+    const Model model(vm, parseProgram(R"(
+        H[i] = W[i, j] X[j]
+        Y[i] = relu(H[i])
+        s = Y[i]
+        Z[i] = W[i, j]
+    )"));
+
+    BatchOptions options;
+    options.maxBatch = 4;
+    options.maxLatency = std::chrono::milliseconds(200);
+    Batcher batcher(model, {"X"}, {"Y", "s", "Z"}, options);
+    REQUIRE(batcher.batched());
+    CHECK(toString(batcher.batchedProgram().statements[0]).find("batch") != std::string::npos);
+
+    std::vector<std::future<Batcher::Result>> futures;
+    for (int r = 0; r < 8; ++r) {
+        const float x = static_cast<float>(r);
+        futures.push_back(batcher.submit({{"X", torch::tensor({x, 1.0f - x})}}));
+    }
+    for (int r = 0; r < 8; ++r) {
+        const float x = static_cast<float>(r);
+        const auto result = futures[r].get();
+        const auto expected = model.evaluate({{"X", torch::tensor({x, 1.0f - x})}}, {"Y", "s", "Z"});
+        CHECK(torch::allclose(result.at("Y"), expected.at("Y")));
+        CHECK(torch::allclose(result.at("s"), expected.at("s")));
+        CHECK(torch::equal(result.at("Z"), expected.at("Z")));  // not batched: the same for all
+    }
+    CHECK(batcher.requests() == 8);
+    CHECK(batcher.batches() >= 2);
+    CHECK(batcher.batches() < 8);
+
+    // Requests that do not bind the inputs fail on their own
+    CHECK_THROWS_AS(batcher.evaluate({{"Q", torch::tensor({1.0f})}}), std::invalid_argument);
+}
+
+TEST_CASE("Batcher falls back to single requests", "[batcher]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    const Model model(vm, parseProgram(R"(
+        Y = X
+        Parent(Alice, Bob)
+    )"));
+    Batcher batcher(model, {"X"}, {"Y"});
+    CHECK_FALSE(batcher.batched());
+    const auto result = batcher.evaluate({{"X", torch::tensor({1.0f, 2.0f})}});
+    CHECK(torch::equal(result.at("Y"), torch::tensor({1.0f, 2.0f})));
+}
@@ -0,0 +1,75 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Parser.hpp"
+#include "TL/Runtime/CompiledBody.hpp"
+#include <sstream>
+#include <string>
+
+using namespace tl;
+
+static DatalogRule ruleOf(const std::string& src) {
+    return std::get<DatalogRule>(parseProgram(src).statements.front());
+}
+
+TEST_CASE("CompiledBody numbers variables by first appearance", "[datalog][compiled]") {
+    const DatalogRule rule = ruleOf("Total(x, a + b) <- Cost(x, a), Cost(y, b), x != y");
+    const CompiledBody code = CompiledBody::compile(rule);
+
+    REQUIRE(code.slotCount() == 4);
+    REQUIRE(code.slotOf("x") == 0);
+    REQUIRE(code.slotOf("a") == 1);
+    REQUIRE(code.slotOf("y") == 2);
+    REQUIRE(code.slotOf("b") == 3);
+    REQUIRE(code.slotOf("z") == -1);
+
+    const auto& head = code.headTerms();
+    REQUIRE(head.size() == 2);
+    REQUIRE(head[0].kind == CompiledBody::Term::Kind::Variable);
+    REQUIRE(head[0].index == 0);
+    REQUIRE(head[1].kind == CompiledBody::Term::Kind::Expression);
+}
+
+TEST_CASE("CompiledBody evaluates arithmetic over interned values", "[datalog][compiled]") {
+    const DatalogRule rule = ruleOf("Total(x, a * b / 4) <- Cost(x, a), Cost(x, b)");
+    const CompiledBody code = CompiledBody::compile(rule);
+
+    SymbolTable symbols;
+    CompiledBody::Slots slots(code.slotCount(), CompiledBody::kUnbound);
+    slots[0] = symbols.intern("Item");
+    slots[1] = symbols.intern("3");
+    slots[2] = symbols.intern("0.5");
+
+    CompiledBody::Value value;
+    REQUIRE(code.evaluate(code.headTerms()[1], slots, symbols, value));
+    REQUIRE(value.numeric);
+    REQUIRE(value.number == 0.375);
+
+    // Computed numbers print like std::ostream
+    CompiledBody::NumberBuffer buffer;
+    std::ostringstream expected;
+    expected << 0.375;
+    REQUIRE(std::string(CompiledBody::text(value, buffer)) == expected.str());
+
+    // Non-numeric operands and unbound variables do not evaluate
+    slots[1] = symbols.intern("Many");
+    REQUIRE_FALSE(code.evaluate(code.headTerms()[1], slots, symbols, value));
+    slots[1] = CompiledBody::kUnbound;
+    REQUIRE_FALSE(code.evaluate(code.headTerms()[1], slots, symbols, value));
+}
+
+TEST_CASE("CompiledBody conditions compare numerically or textually", "[datalog][compiled]") {
+    const DatalogRule rule = ruleOf("Pick(x) <- Val(x, a), Val(x, b), a < b, a == b, x != \"Item\"");
+    const CompiledBody code = CompiledBody::compile(rule);
+
+    SymbolTable symbols;
+    CompiledBody::Slots slots(code.slotCount(), CompiledBody::kUnbound);
+    slots[0] = symbols.intern("Other");
+    slots[1] = symbols.intern("9");
+    slots[2] = symbols.intern("10");
+
+    // 9 < 10 numerically, although "9" > "10" as text
+    REQUIRE(code.testCondition(0, slots, symbols));
+    REQUIRE_FALSE(code.testCondition(1, slots, symbols));
+    slots[2] = symbols.intern("9.0");
+    REQUIRE(code.testCondition(1, slots, symbols));
+    REQUIRE(code.testCondition(2, slots, symbols));
+}
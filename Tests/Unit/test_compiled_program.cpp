@@ -0,0 +1,307 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "TL/Parser.hpp"
+#include "TL/vm.hpp"
+#include <sstream>
+
+using namespace tl;
+using Catch::Matchers::WithinAbs;
+using Opcode = CompiledProgram::Opcode;
+
+TEST_CASE("Compiled program orders and classifies statements", "[compiled_program]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    auto prog = parseProgram(R"(
+        A = [1, 2, 3]
+        B[i] = A[i] * 2
+        B?
+        Edge(X, Y)
+        x[0] = 1.0
+        x[*t+1] = cos(x[*t])
+    )");
+
+    const CompiledProgram plan = vm.compile(prog);
+    const auto& code = plan.instructions();
+    REQUIRE(code.size() == 6);
+    CHECK(code[0].op == Opcode::Equation);
+    CHECK(code[1].op == Opcode::Equation);
+    CHECK(code[2].op == Opcode::Fact);
+    CHECK(code[3].op == Opcode::Equation);
+    CHECK(code[4].op == Opcode::VirtualBatch);
+    CHECK(code[5].op == Opcode::Query);
+    CHECK(code[5].statement == 2);
+    CHECK(plan.virtualStatements().size() == 1);
+
+    // Tensor names resolve to slots
+    const int a = plan.slotOf("A");
+    const int b = plan.slotOf("B");
+    REQUIRE(a >= 0);
+    REQUIRE(b >= 0);
+    CHECK(plan.slots()[b] == "B");
+    CHECK(code[1].result == b);
+    CHECK(code[1].operands == std::vector<int>{a});
+    CHECK(code[5].operands == std::vector<int>{b});
+    CHECK(plan.slotOf("Missing") == -1);
+}
+
+TEST_CASE("Compiled program runs repeatedly with cached executors", "[compiled_program]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    auto prog = parseProgram(R"(
+        W = [[1.0, 2.0], [3.0, 4.0]]
+        X = [1.0, 1.0]
+        Y[i] = W[i, j] X[j]
+        Z[i] = relu(Y[i] - 4.0)
+        Z?
+    )");
+
+    CompiledProgram plan = vm.compile(prog);
+    vm.execute(plan);
+    const std::string first = out.str();
+    REQUIRE(vm.env().has("Z"));
+    CHECK_THAT(vm.env().lookup("Z")[1].item<float>(), WithinAbs(3.0f, 1e-6f));
+
+    // The first run binds new tensors, so the second one re-selects once;
+    // from then on the environment layout is stable and nothing is re-selected
+    vm.execute(plan);
+    const size_t selections = plan.executorSelections();
+    for (int run = 0; run < 5; ++run) vm.execute(plan);
+    CHECK(plan.executorSelections() == selections);
+
+    // Every run prints the same query result
+    std::string expected;
+    for (int run = 0; run < 7; ++run) expected += first;
+    CHECK(out.str() == expected);
+    CHECK_THAT(vm.env().lookup("Z")[1].item<float>(), WithinAbs(3.0f, 1e-6f));
+}
+
+TEST_CASE("Compiled program re-selects executors when tensors appear", "[compiled_program]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+
+    // Any new tensor name may change which executor claims an equation
+    CompiledProgram plan = vm.compile(parseProgram("T = S"));
+    vm.env().bind("S", torch::tensor({1.0f, 2.0f}));
+    vm.execute(plan);  // binds T, so the next run re-selects once
+    vm.execute(plan);
+    const size_t selections = plan.executorSelections();
+    vm.execute(plan);
+    CHECK(plan.executorSelections() == selections);
+
+    vm.env().bind("Other", torch::tensor({0.0f}));
+    vm.execute(plan);
+    CHECK(plan.executorSelections() == selections + 1);
+    CHECK_THAT(vm.env().lookup("T")[1].item<float>(), WithinAbs(2.0f, 1e-6f));
+}
+
+TEST_CASE("Compiled program matches interpreted execution of virtual indices", "[compiled_program]") {
+    const char* source = R"(
+        x[0] = 1.0
+        x[*t+1] = cos(x[*t])
+    )";
+    std::stringstream out, err;
+    TensorLogicVM interpreted{&out, &err};
+    interpreted.execute(parseProgram(source));
+
+    // A plan compiled by one VM can be run by another
+    TensorLogicVM compiler{&out, &err};
+    CompiledProgram plan = compiler.compile(parseProgram(source));
+    TensorLogicVM vm{&out, &err};
+    vm.execute(plan);
+
+    REQUIRE(vm.env().has("x"));
+    CHECK_THAT(vm.env().lookup("x").item<float>(),
+               WithinAbs(interpreted.env().lookup("x").item<float>(), 1e-6f));
+    CHECK_THAT(vm.env().lookup("x").item<float>(), WithinAbs(0.739f, 0.001f));
+}
+
+TEST_CASE("Independent equations run concurrently with sequential results", "[compiled_program][schedule]") {
+    const char* source = R"(
+        A = [1.0, -2.0, 3.0]
+        B = [0.5, 0.5, -1.0]
+        W = [[1.0, 0.0, 1.0], [0.0, 1.0, 0.0]]
+        a = 2.0
+        b = 3.0
+        H1[i] = relu(A[i] * 2.0)
+        H2[i] = sigmoid(B[i])
+        H3[j] = W[j, i] A[i]
+        p = a * b
+        q = a + b
+        a = 10.0
+        r = a * q
+        S[i] = H1[i] + H2[i]
+        S?
+    )";
+    std::stringstream seqOut, parOut, err;
+    TensorLogicVM sequential{&seqOut, &err};
+    sequential.setStatementThreads(1);
+    sequential.execute(parseProgram(source));
+
+    TensorLogicVM vm{&parOut, &err};
+    vm.setStatementThreads(4);
+    CompiledProgram plan = vm.compile(parseProgram(source));
+    for (int run = 0; run < 3; ++run) vm.execute(plan);
+
+    CHECK(parOut.str() == seqOut.str() + seqOut.str() + seqOut.str());
+    for (const char* name : {"H1", "H2", "H3", "S", "p", "q", "r", "a"}) {
+        INFO(name);
+        REQUIRE(vm.env().has(name));
+        CHECK(torch::allclose(vm.env().lookup(name), sequential.env().lookup(name)));
+    }
+    // p and q read a before it is rebound, r after
+    CHECK_THAT(vm.env().lookup("p").item<float>(), WithinAbs(6.0f, 1e-6f));
+    CHECK_THAT(vm.env().lookup("q").item<float>(), WithinAbs(5.0f, 1e-6f));
+    CHECK_THAT(vm.env().lookup("r").item<float>(), WithinAbs(50.0f, 1e-6f));
+}
+
+TEST_CASE("Index variables that name tensors order the schedule", "[compiled_program][schedule]") {
+    // Y reads n through its index, so it must wait for n to be bound
+    const char* source = R"(
+        X = [10.0, 20.0, 30.0]
+        n = 2.0
+        Y = X[n]
+        Y?
+    )";
+    std::stringstream seqOut, parOut, err;
+    TensorLogicVM sequential{&seqOut, &err};
+    sequential.setStatementThreads(1);
+    sequential.execute(parseProgram(source));
+
+    TensorLogicVM vm{&parOut, &err};
+    vm.setStatementThreads(4);
+    vm.execute(parseProgram(source));
+
+    CHECK(parOut.str() == seqOut.str());
+    REQUIRE(vm.env().has("Y"));
+    CHECK(vm.env().lookup("Y").numel() == 1);
+    CHECK_THAT(vm.env().lookup("Y").item<float>(), WithinAbs(30.0f, 1e-6f));
+}
+
+TEST_CASE("Statements no output reads are skipped", "[compiled_program][liveness]") {
+    const char* source = R"(
+        A = [1.0, 2.0]
+        Unused[i] = A[i] * 3.0
+        Tmp[i] = A[i] + 1.0
+        B[i] = Tmp[i] * 2.0
+        Edge(N1, N2)
+        Path(x, y) <- Edge(x, y)
+        Other(x) <- Node(x)
+        Node(N1)
+        B?
+        Path(x, y)?
+    )";
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    const CompiledProgram plan = vm.compile(parseProgram(source));
+    REQUIRE(plan.instructions().size() == 10);
+    const std::vector<bool> expected = {true, false, true, true, true, true, false, false, true, true};
+    for (size_t k = 0; k < expected.size(); ++k) {
+        INFO("instruction " << k);
+        CHECK(plan.live(k) == expected[k]);
+    }
+    CHECK(plan.deadInstructions() == 3);
+
+    std::stringstream fullOut;
+    TensorLogicVM full{&fullOut, &err};
+    full.execute(parseProgram(source));
+
+    vm.setDeadCodeElimination(true);
+    vm.execute(parseProgram(source));
+    CHECK(out.str() == fullOut.str());
+    CHECK(vm.env().has("B"));
+    CHECK_FALSE(vm.env().has("Unused"));
+    CHECK(full.env().has("Unused"));
+    CHECK_FALSE(vm.env().hasRelation("Node"));
+    CHECK_FALSE(vm.env().hasRelation("Other"));
+}
+
+TEST_CASE("Liveness keeps what later statements and training read", "[compiled_program][liveness]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+
+    // The first X is overwritten before anything reads it
+    CompiledProgram plan = vm.compile(parseProgram(R"(
+        X = [1.0]
+        X = [2.0]
+        Y[i] = X[i] + 1.0
+        Y?
+    )"));
+    CHECK_FALSE(plan.live(0));
+    CHECK(plan.live(1));
+
+    // Parameters stay for training even if the loss does not read them
+    plan = vm.compile(parseProgram(R"(
+        w = [0.0]
+        v = [1.0]
+        loss = (w[0] - 1.0)^2
+        loss? @minimize(lr=0.1, epochs=1)
+    )"));
+    CHECK(plan.deadInstructions() == 0);
+}
+
+TEST_CASE("Liveness keeps tensors read as index variables", "[compiled_program][liveness]") {
+    const char* source = R"(
+        X = [10.0, 20.0, 30.0]
+        n = 2.0
+        Y = X[n]
+        Y?
+    )";
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    const CompiledProgram plan = vm.compile(parseProgram(source));
+    CHECK(plan.deadInstructions() == 0);
+
+    std::stringstream fullOut;
+    TensorLogicVM full{&fullOut, &err};
+    full.execute(parseProgram(source));
+
+    vm.setDeadCodeElimination(true);
+    vm.execute(parseProgram(source));
+    CHECK(out.str() == fullOut.str());
+    CHECK_THAT(vm.env().lookup("Y").item<float>(), WithinAbs(30.0f, 1e-6f));
+}
+
+TEST_CASE("Intermediates are released after their last use", "[compiled_program][liveness]") {
+    const char* source = R"(
+        A = [1.0, 2.0]
+        Tmp[i] = A[i] + 1.0
+        B[i] = Tmp[i] * 2.0
+        C[i] = B[i] + A[i]
+        C?
+    )";
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.env().bind("Input", torch::tensor({1.0f}));
+    const CompiledProgram plan = vm.compile(parseProgram(source));
+    auto released = [&](size_t k) {
+        std::vector<std::string> names;
+        for (int slot : plan.releasedAfter(k)) names.push_back(plan.slots()[slot]);
+        return names;
+    };
+    CHECK(released(0).empty());
+    CHECK(released(1).empty());
+    CHECK(released(2) == std::vector<std::string>{"Tmp"});
+    CHECK(released(3) == std::vector<std::string>{"A", "B"});
+    CHECK(released(4).empty());
+
+    std::stringstream fullOut;
+    TensorLogicVM full{&fullOut, &err};
+    full.execute(parseProgram(source));
+
+    vm.setReleaseIntermediates(true);
+    vm.execute(parseProgram(source));
+    CHECK(out.str() == fullOut.str());
+    CHECK(vm.env().has("C"));
+    CHECK(vm.env().has("Input"));
+    CHECK_FALSE(vm.env().has("A"));
+    CHECK_FALSE(vm.env().has("Tmp"));
+    CHECK(full.env().has("Tmp"));
+
+    // Training replays the program, so nothing is released under it
+    const CompiledProgram training = vm.compile(parseProgram(R"(
+        w = [0.0]
+        loss = (w[0] - 1.0)^2
+        loss? @minimize(lr=0.1, epochs=1)
+    )"));
+    for (size_t k = 0; k < training.instructions().size(); ++k) CHECK(training.releasedAfter(k).empty());
+}
@@ -1,8 +1,13 @@
 #include <catch2/catch_test_macros.hpp>
 #include "TL/Parser.hpp"
 #include "TL/vm.hpp"
+#include "TL/Runtime/PartitionedDatalog.hpp"
+#include "TL/Runtime/TensorDatalog.hpp"
 #include <string>
 #include <sstream>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
 
 using namespace tl;
 
@@ -25,6 +30,21 @@ static bool hasFact(const Environment& env, const std::string& relation,
     return false;
 }
 
+// Helper to collect a relation as sorted, comma-joined tuples
+static std::vector<std::string> sortedFacts(const Environment& env, const std::string& relation) {
+    std::vector<std::string> rows;
+    for (const auto& fact : env.facts(relation)) {
+        std::string row;
+        for (size_t i = 0; i < fact.size(); ++i) {
+            if (i) row += ",";
+            row += fact[i];
+        }
+        rows.push_back(row);
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
 TEST_CASE("Simple Datalog fact", "[datalog][facts]") {
     std::stringstream out, err;
     TensorLogicVM vm{&out, &err};
@@ -458,3 +478,421 @@ TEST_CASE("Datalog query with numeric constants", "[datalog][query][numeric]") {
     // Should parse and execute without throwing
     REQUIRE_NOTHROW(vm.execute(prog));
 }
+
+TEST_CASE("Datalog semi-naive saturation matches naive evaluation", "[datalog][rules][seminaive]") {
+    // A 20-node cycle with a tail, closed with a non-linear recursive rule
+    std::string src;
+    for (int i = 0; i < 20; ++i) {
+        src += "Edge(N" + std::to_string(i) + ", N" + std::to_string((i + 1) % 20) + ")\n";
+    }
+    src += R"(
+        Edge(N5, M0)
+        Edge(M0, M1)
+
+        Path(x, y) <- Edge(x, y)
+        Path(x, z) <- Path(x, y), Path(y, z)
+        FromStart(y) <- Path(N0, y), Edge(y, z)
+
+        Path(N0, M1)?
+    )";
+
+    std::stringstream semiOut, semiErr, naiveOut, naiveErr;
+    TensorLogicVM semi{&semiOut, &semiErr};
+    TensorLogicVM naive{&naiveOut, &naiveErr};
+    REQUIRE(semi.datalog().semiNaive());
+    naive.datalog().setSemiNaive(false);
+
+    semi.execute(parseProgram(src));
+    naive.execute(parseProgram(src));
+
+    // 20 * 20 pairs inside the cycle, 20 sources reaching M0 and 21 reaching M1
+    REQUIRE(sortedFacts(semi.env(), "Path").size() == 400 + 20 + 21);
+    REQUIRE(sortedFacts(semi.env(), "Path") == sortedFacts(naive.env(), "Path"));
+    REQUIRE(sortedFacts(semi.env(), "FromStart") == sortedFacts(naive.env(), "FromStart"));
+    REQUIRE(semiOut.str() == "True\n");
+    REQUIRE(semiOut.str() == naiveOut.str());
+}
+
+TEST_CASE("Datalog join planner starts from the most selective atom", "[datalog][rules][planner]") {
+    std::string src;
+    for (int i = 0; i < 50; ++i) {
+        src += "Big(N" + std::to_string(i) + ", N" + std::to_string((i * 7) % 50) + ")\n";
+    }
+    src += R"(
+        Small(N3)
+        Small(N4)
+
+        Hit(x, y) <- Big(x, y), Small(x), x != y
+
+        Hit(x, y)?
+        Big(x, y), Small(x)?
+    )";
+
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.datalog().setDebug(true);
+    vm.execute(parseProgram(src));
+
+    // The two-row relation is joined first and probes Big on x
+    REQUIRE(out.str().find("Join plan for Hit: Small(2) Big(50)") != std::string::npos);
+    REQUIRE(sortedFacts(vm.env(), "Hit") == std::vector<std::string>{"N3,N21", "N4,N28"});
+
+    // Conjunctive query answers keep source order regardless of join order
+    REQUIRE(out.str().find("N3, N21\nN4, N28\n") != std::string::npos);
+}
+
+TEST_CASE("Datalog parallel saturation matches sequential evaluation", "[datalog][rules][parallel]") {
+    // A 64-node cycle closed non-linearly: late rounds carry thousands of
+    // delta rows, enough to be split into parallel tasks
+    std::string src;
+    for (int i = 0; i < 64; ++i) {
+        src += "Edge(N" + std::to_string(i) + ", N" + std::to_string((i + 1) % 64) + ")\n";
+        src += "Num(N" + std::to_string(i) + ", " + std::to_string(i) + ")\n";
+    }
+    src += R"(
+        Path(x, y) <- Edge(x, y)
+        Path(x, z) <- Path(x, y), Path(y, z)
+        Sum(x, y, a + b) <- Path(x, y), Num(x, a), Num(y, b)
+        Reach(y, Yes) <- Path(N0, y)
+
+        Sum(N63, N63, s)?
+    )";
+
+    std::stringstream seqOut, seqErr, parOut, parErr;
+    TensorLogicVM sequential{&seqOut, &seqErr};
+    TensorLogicVM parallel{&parOut, &parErr};
+    sequential.datalog().setNumThreads(1);
+    parallel.datalog().setNumThreads(4);
+    parallel.datalog().setDebug(true);
+
+    sequential.execute(parseProgram(src));
+    parallel.execute(parseProgram(src));
+
+    REQUIRE(parOut.str().find("parallel tasks on 4 threads") != std::string::npos);
+    REQUIRE(sequential.env().facts("Path").size() == 64 * 64);
+    REQUIRE(sequential.env().facts("Sum").size() == 64 * 64);
+    // Buffers are merged in task order, so even the fact order matches
+    REQUIRE(parallel.env().facts("Path") == sequential.env().facts("Path"));
+    REQUIRE(parallel.env().facts("Sum") == sequential.env().facts("Sum"));
+    REQUIRE(parallel.env().facts("Reach") == sequential.env().facts("Reach"));
+    REQUIRE(seqOut.str() == "126\n");
+    REQUIRE(parOut.str().find("126\n") != std::string::npos);
+}
+
+TEST_CASE("Datalog negation is evaluated by strata", "[datalog][rules][strata]") {
+    // The negating rule is registered before the rules deriving Reach, so
+    // source-order evaluation would negate a still incomplete relation
+    const std::string src = R"(
+        Node(A)
+        Node(B)
+        Node(C)
+        Node(D)
+        Edge(A, B)
+        Edge(B, C)
+        Start(A)
+
+        Unreachable(x) <- Node(x), not Reach(x)
+        Reach(y) <- Start(y)
+        Reach(y) <- Reach(x), Edge(x, y)
+
+        Unreachable(x)?
+    )";
+
+    SECTION("semi-naive") {
+        std::stringstream out, err;
+        TensorLogicVM vm{&out, &err};
+        vm.datalog().setDebug(true);
+        vm.execute(parseProgram(src));
+
+        REQUIRE(sortedFacts(vm.env(), "Reach") == std::vector<std::string>{"A", "B", "C"});
+        REQUIRE(sortedFacts(vm.env(), "Unreachable") == std::vector<std::string>{"D"});
+        REQUIRE(out.str().find("Stratum 0 {Reach} reached fixpoint after") != std::string::npos);
+        REQUIRE(out.str().find("Stratum 1 {Unreachable} applied once.") != std::string::npos);
+    }
+
+    SECTION("naive") {
+        std::stringstream out, err;
+        TensorLogicVM vm{&out, &err};
+        vm.datalog().setSemiNaive(false);
+        vm.execute(parseProgram(src));
+
+        REQUIRE(sortedFacts(vm.env(), "Unreachable") == std::vector<std::string>{"D"});
+        REQUIRE(out.str() == "D\n");
+    }
+}
+
+TEST_CASE("Datalog rejects negation inside a recursive cycle", "[datalog][rules][strata]") {
+    const std::string src = R"(
+        Node(A)
+        Win(x) <- Node(x), not Lose(x)
+        Lose(x) <- Node(x), Win(x)
+    )";
+
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    REQUIRE_THROWS_AS(vm.execute(parseProgram(src)), std::runtime_error);
+    // The offending rule is not kept
+    REQUIRE(vm.datalog().rules().size() == 1);
+}
+
+TEST_CASE("Datalog re-saturation only propagates new facts", "[datalog][rules][incremental]") {
+    std::string base;
+    for (int i = 0; i < 30; ++i) {
+        base += "Edge(N" + std::to_string(i) + ", N" + std::to_string(i + 1) + ")\n";
+    }
+    base += R"(
+        Path(x, y) <- Edge(x, y)
+        Path(x, z) <- Path(x, y), Edge(y, z)
+        Path(N0, N30)?
+    )";
+    const std::string update = R"(
+        Edge(N30, M0)
+        Path(N0, M0)?
+    )";
+
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(base));
+    REQUIRE(vm.env().facts("Path").size() == 30 * 31 / 2);
+
+    out.str("");
+    vm.datalog().setDebug(true);
+    vm.execute(parseProgram(update));
+    REQUIRE(out.str().find("Incremental saturation seeded with 1 new facts and 0 new rules.") != std::string::npos);
+    // The round-one join starts from the single new edge
+    REQUIRE(out.str().find("Join plan for Path: Edge[delta](1) Path(465)") != std::string::npos);
+    REQUIRE(out.str().find("True\n") != std::string::npos);
+
+    // Same closure as saturating everything at once
+    std::stringstream freshOut, freshErr;
+    TensorLogicVM fresh{&freshOut, &freshErr};
+    fresh.execute(parseProgram(base + update));
+    REQUIRE(sortedFacts(vm.env(), "Path") == sortedFacts(fresh.env(), "Path"));
+    REQUIRE(vm.env().facts("Path").size() == 30 * 31 / 2 + 31);
+}
+
+TEST_CASE("Datalog rules added after saturation see all facts", "[datalog][rules][incremental]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(R"(
+        Parent(Alice, Bob)
+        Parent(Bob, Carol)
+        Child(y, x) <- Parent(x, y)
+        Child(Carol, x)?
+    )"));
+    vm.execute(parseProgram(R"(
+        Grandparent(x, z) <- Parent(x, y), Parent(y, z)
+        Grandparent(x, Carol)?
+    )"));
+    REQUIRE(out.str() == "Bob\nAlice\n");
+}
+
+TEST_CASE("Datalog tensor mode evaluates rules as einsums", "[datalog][rules][tensor]") {
+    std::string src;
+    for (int i = 0; i < 12; ++i) {
+        src += "Edge(N" + std::to_string(i) + ", N" + std::to_string((i + 1) % 12) + ")\n";
+    }
+    src += R"(
+        Edge(N3, M0)
+        Start(N0)
+
+        Path(x, y) <- Edge(x, y)
+        Path(x, z) <- Path(x, y), Path(y, z)
+        FromStart(y) <- Start(x), Path(x, y)
+        Dead(x) <- Edge(x, x)
+
+        Path(N0, M0)?
+        FromStart(y)?
+    )";
+
+    std::stringstream tensorOut, tensorErr, tupleOut, tupleErr;
+    TensorLogicVM tensor{&tensorOut, &tensorErr};
+    TensorLogicVM tuples{&tupleOut, &tupleErr};
+    tensor.datalog().setTensorMode(true);
+    tensor.datalog().setDebug(true);
+
+    tensor.execute(parseProgram(src));
+    tuples.execute(parseProgram(src));
+
+    REQUIRE(tensorOut.str().find("Tensor rule for Path: einsum(\"ab,bc->ac\") > 0") != std::string::npos);
+    REQUIRE(tensorOut.str().find("{Path} reached fixpoint after") != std::string::npos);
+    REQUIRE(tensorOut.str().find("rounds as tensors.") != std::string::npos);
+    REQUIRE(sortedFacts(tensor.env(), "Path").size() == 12 * 12 + 12);
+    REQUIRE(sortedFacts(tensor.env(), "Path") == sortedFacts(tuples.env(), "Path"));
+    REQUIRE(sortedFacts(tensor.env(), "FromStart") == sortedFacts(tuples.env(), "FromStart"));
+    REQUIRE(sortedFacts(tensor.env(), "Dead").empty());
+}
+
+TEST_CASE("Datalog tensor mode only takes pure conjunctive rules", "[datalog][rules][tensor]") {
+    auto ruleOf = [](const std::string& src) {
+        return std::get<DatalogRule>(parseProgram(src).statements.front());
+    };
+    REQUIRE(TensorDatalog::supports(ruleOf("Path(x, z) <- Edge(x, y), Path(y, z)")));
+    REQUIRE(TensorDatalog::einsumSpec(ruleOf("Path(x, z) <- Edge(x, y), Path(y, z)")) == "ab,bc->ac");
+    REQUIRE(TensorDatalog::einsumSpec(ruleOf("Loop(x) <- Edge(x, x)")) == "aa->a");
+    REQUIRE_FALSE(TensorDatalog::supports(ruleOf("Root(x) <- Edge(x, N0)")));
+    REQUIRE_FALSE(TensorDatalog::supports(ruleOf("Far(x, y) <- Edge(x, y), x != y")));
+    REQUIRE_FALSE(TensorDatalog::supports(ruleOf("Lone(x) <- Node(x), not Edge(x, x)")));
+    REQUIRE_FALSE(TensorDatalog::supports(ruleOf("Pair(x, x) <- Node(x)")));
+}
+
+TEST_CASE("Datalog demand-driven queries derive only what they read", "[datalog][rules][demand]") {
+    // Two disconnected chains; queries about one must not derive the other
+    std::string src;
+    for (int i = 0; i < 30; ++i) {
+        src += "Edge(A" + std::to_string(i) + ", A" + std::to_string(i + 1) + ")\n";
+        src += "Edge(B" + std::to_string(i) + ", B" + std::to_string(i + 1) + ")\n";
+    }
+    src += R"(
+        Path(x, y) <- Edge(x, y)
+        Path(x, z) <- Edge(x, y), Path(y, z)
+        Reach(x, z) <- Reach(x, y), Edge(y, z)
+        Reach(x, y) <- Edge(x, y)
+        Twice(x, z) <- Path(x, y), Path(y, z), x != z
+        Start(A25)
+        Below(y) <- Start(x), Path(x, y)
+        Path(A30, C0)
+    )";
+    auto queryOf = [](const std::string& text) { return std::get<Query>(parseProgram(text).statements.front()); };
+    auto rowsOf = [](const TensorLogicVM& vm, const QueryResult& result) {
+        std::vector<std::string> rows;
+        for (size_t r = 0; r < result.rows; ++r) {
+            std::string row;
+            for (const auto& column : result.columns) row += vm.env().symbols().name(column[r]) + ",";
+            rows.push_back(row);
+        }
+        std::sort(rows.begin(), rows.end());
+        return rows;
+    };
+
+    std::stringstream demandOut, demandErr, fullOut, fullErr;
+    TensorLogicVM demand{&demandOut, &demandErr};
+    TensorLogicVM full{&fullOut, &fullErr};
+    demand.datalog().setDemandDriven(true);
+    demand.execute(parseProgram(src));
+    full.execute(parseProgram(src));
+
+    for (const std::string query : {"Path(A20, y)?", "Path(x, A3)?", "Reach(B27, y)?", "Twice(A0, z)?",
+                                    "Path(A2, A9)?", "Path(A9, A2)?", "Below(A27)?", "Edge(A4, y)?"}) {
+        INFO(query);
+        const QueryResult expected = full.query(queryOf(query));
+        const QueryResult answered = demand.query(queryOf(query));
+        CHECK(answered.name == expected.name);
+        CHECK(answered.rows == expected.rows);
+        CHECK(rowsOf(demand, answered) == rowsOf(full, expected));
+        // Nothing was saturated and no scratch relation is left behind
+        REQUIRE(demand.datalog().needsSaturation());
+        CHECK_FALSE(demand.env().hasRelation("Reach"));
+        for (const auto& kv : demand.env().relations()) CHECK(kv.first.find('$') == std::string::npos);
+    }
+    // Stored facts of a derived relation are answers too
+    CHECK(rowsOf(demand, demand.query(queryOf("Path(A29, y)?"))) == std::vector<std::string>{"A30,", "C0,"});
+    CHECK(sortedFacts(demand.env(), "Path") == std::vector<std::string>{"A30,C0"});
+
+    // Queries without constants saturate, after which the closure answers directly
+    CHECK(demand.query(queryOf("Reach(x, y)?")).rows == full.query(queryOf("Reach(x, y)?")).rows);
+    CHECK_FALSE(demand.datalog().needsSaturation());
+    CHECK(sortedFacts(demand.env(), "Path") == sortedFacts(full.env(), "Path"));
+}
+
+TEST_CASE("Datalog demand-driven queries saturate below a negated derived relation", "[datalog][rules][demand]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.datalog().setDemandDriven(true);
+    vm.execute(parseProgram(R"(
+        Edge(N0, N1)
+        Edge(N1, N2)
+        Node(N0)
+        Node(N1)
+        Node(N2)
+        Node(N3)
+        Path(x, y) <- Edge(x, y)
+        Path(x, z) <- Path(x, y), Edge(y, z)
+        Unreached(x, y) <- Node(x), Node(y), not Path(x, y)
+    )"));
+    const QueryResult result = vm.query(std::get<Query>(parseProgram("Unreached(N0, y)?").statements.front()));
+    REQUIRE(result.rows == 2);
+    std::vector<std::string> unreached;
+    for (SymbolId id : result.columns[0]) unreached.push_back(vm.env().symbols().name(id));
+    std::sort(unreached.begin(), unreached.end());
+    CHECK(unreached == std::vector<std::string>{"N0", "N3"});
+    CHECK_FALSE(vm.datalog().needsSaturation());
+}
+
+TEST_CASE("Datalog partitioned saturation matches a single store", "[datalog][rules][partitioned]") {
+    std::string src;
+    for (int i = 0; i < 40; ++i) {
+        src += "Edge(N" + std::to_string(i) + ", N" + std::to_string((i * 7 + 3) % 40) + ")\n";
+    }
+    src += R"(
+        Edge(N5, N5)
+        Hops(N0, 0)
+        Path(x, y) <- Edge(x, y)
+        Path(x, z) <- Path(x, y), Edge(y, z)
+        Hops(y, h + 1) <- Hops(x, h), Edge(x, y), h < 3
+        OneWay(x, y) <- Edge(x, y), not Path(y, x)
+        Path(N0, y)?
+    )";
+
+    std::stringstream partOut, partErr, singleOut, singleErr;
+    TensorLogicVM partitioned{&partOut, &partErr};
+    TensorLogicVM single{&singleOut, &singleErr};
+    partitioned.datalog().setPartitions(4);
+    partitioned.datalog().setNumThreads(2);
+    partitioned.execute(parseProgram(src));
+    single.execute(parseProgram(src));
+
+    REQUIRE(sortedFacts(partitioned.env(), "Path").size() > 40);
+    for (const std::string relation : {"Path", "Hops", "OneWay"}) {
+        INFO(relation);
+        CHECK(sortedFacts(partitioned.env(), relation) == sortedFacts(single.env(), relation));
+    }
+    CHECK(hasFact(partitioned.env(), "Hops", {"N3", "1"}));
+}
+
+TEST_CASE("Datalog partitioned saturation runs unpartitionable strata in one store", "[datalog][rules][partitioned]") {
+    std::string src;
+    for (int i = 0; i < 20; ++i) {
+        src += "Edge(N" + std::to_string(i) + ", N" + std::to_string((i * 3 + 1) % 20) + ")\n";
+    }
+    src += R"(
+        Path(x, y) <- Edge(x, y)
+        Path(x, z) <- Path(x, y), Edge(y, z)
+        Chain(x, w) <- Edge(x, y), Edge(y, z), Edge(z, w)
+        Reach(x, w) <- Chain(x, y), Path(y, w)
+        Chain(N0, w)?
+    )";
+
+    std::stringstream partOut, partErr, singleOut, singleErr;
+    TensorLogicVM partitioned{&partOut, &partErr};
+    TensorLogicVM single{&singleOut, &singleErr};
+    partitioned.datalog().setPartitions(4);
+    partitioned.datalog().setNumThreads(2);
+    REQUIRE_NOTHROW(partitioned.execute(parseProgram(src)));
+    single.execute(parseProgram(src));
+
+    REQUIRE_FALSE(sortedFacts(partitioned.env(), "Reach").empty());
+    for (const std::string relation : {"Path", "Chain", "Reach"}) {
+        INFO(relation);
+        CHECK(sortedFacts(partitioned.env(), relation) == sortedFacts(single.env(), relation));
+    }
+}
+
+TEST_CASE("Datalog partitions relations on the join key of each rule", "[datalog][rules][partitioned]") {
+    auto ruleOf = [](const std::string& src) {
+        return std::get<DatalogRule>(parseProgram(src).statements.front());
+    };
+    const PartitionedDatalog plan({ruleOf("Path(x, y) <- Edge(x, y)"),
+                                   ruleOf("Path(x, z) <- Path(x, y), Edge(y, z)"),
+                                   ruleOf("Back(x, y) <- Path(x, y), not Path(y, x)")},
+                                  {{0, 1}, {2}}, 4);
+    const std::vector<std::pair<std::string, size_t>> keys = {{"Edge", 0}, {"Path", 1}, {"Path", 0}};
+    CHECK(plan.partitioning() == keys);
+
+    const DatalogRule chain = ruleOf("Chain(x, w) <- Edge(x, y), Edge(y, z), Edge(z, w)");
+    CHECK_FALSE(PartitionedDatalog::partitionable(chain));
+    CHECK(PartitionedDatalog::partitionable(ruleOf("Path(x, z) <- Path(x, y), Edge(y, z)")));
+    REQUIRE_THROWS_AS(PartitionedDatalog({chain}, {{0}}, 4), std::runtime_error);
+    // Rules outside the strata are not partitioned
+    CHECK(PartitionedDatalog({chain, ruleOf("Path(x, y) <- Edge(x, y)")}, {{1}}, 4).partitioning().size() == 1);
+}
@@ -0,0 +1,104 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "TL/Parser.hpp"
+#include "TL/vm.hpp"
+#include "TL/Runtime/DTypePolicy.hpp"
+#include <sstream>
+
+using namespace tl;
+using Catch::Matchers::WithinAbs;
+
+TEST_CASE("Dtype policies parse from presets and overrides", "[dtype]") {
+    REQUIRE(DTypePolicy::parse("fp32") == DTypePolicy{});
+
+    auto mixed = DTypePolicy::parse("mixed-bf16");
+    CHECK(mixed.value == torch::kFloat32);
+    CHECK(mixed.compute == torch::kBFloat16);
+    CHECK(mixed.accumulate == torch::kFloat32);
+    CHECK(mixed.mask == torch::kBool);
+    CHECK(mixed.mixed());
+
+    auto reduced = DTypePolicy::parse("fp16,mask=uint8");
+    CHECK(reduced.value == torch::kFloat16);
+    CHECK(reduced.compute == torch::kFloat16);
+    CHECK(reduced.mask == torch::kUInt8);
+    CHECK_FALSE(reduced.mixed());
+
+    CHECK(DTypePolicy::parse("compute=bf16").value == torch::kFloat32);
+
+    CHECK_THROWS_AS(DTypePolicy::parse("int8"), std::invalid_argument);
+    CHECK_THROWS_AS(DTypePolicy::parse("value=bool"), std::invalid_argument);
+    CHECK_THROWS_AS(DTypePolicy::parse("weights=fp16"), std::invalid_argument);
+}
+
+TEST_CASE("Storage types follow the promotion rules", "[dtype]") {
+    auto policy = DTypePolicy::parse("bf16");
+    CHECK(policy.storageFor(torch::kFloat32) == torch::kBFloat16);
+    CHECK(policy.storageFor(torch::kFloat64) == torch::kBFloat16);
+    CHECK(policy.storageFor(torch::kBool) == torch::kBool);
+    CHECK(policy.storageFor(torch::kInt64) == torch::kInt64);  // indices stay exact
+
+    // Without a compact mask type Booleans become values
+    CHECK(DTypePolicy{}.storageFor(torch::kBool) == torch::kFloat32);
+}
+
+TEST_CASE("Reduced storage keeps tensors in bf16", "[dtype]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.setDTypePolicy(DTypePolicy::parse("bf16"));
+    vm.execute(parseProgram(R"(
+        X = [1.0, 2.0, 3.0]
+        W[1] = 4.0
+        Y[i] = X[i] * 2.0 + 0.5
+    )"));
+
+    for (const char* name : {"X", "W", "Y"}) {
+        INFO(name);
+        CHECK(vm.env().lookup(name).scalar_type() == torch::kBFloat16);
+    }
+    auto Y = vm.env().lookup("Y").to(torch::kFloat32);
+    CHECK_THAT(Y[2].item<float>(), WithinAbs(6.5f, 1e-2f));
+}
+
+TEST_CASE("Mixed precision contractions return fp32", "[dtype]") {
+    const std::string source = R"(
+        A = [[0.5, 1.25, -2.0], [3.0, 0.75, 1.5]]
+        B = [[1.0, -0.5], [2.0, 0.25], [0.5, 4.0]]
+        C[i, k] = A[i, j] B[j, k]
+    )";
+    std::stringstream out, err;
+    TensorLogicVM exact{&out, &err};
+    TensorLogicVM mixed{&out, &err};
+    mixed.setDTypePolicy(DTypePolicy::parse("mixed-bf16"));
+    exact.execute(parseProgram(source));
+    mixed.execute(parseProgram(source));
+
+    Tensor expected = exact.env().lookup("C");
+    Tensor result = mixed.env().lookup("C");
+    REQUIRE(result.scalar_type() == torch::kFloat32);
+    REQUIRE(result.sizes() == expected.sizes());
+    CHECK(torch::allclose(result, expected, 1e-2, 1e-2));
+}
+
+TEST_CASE("Tensorized Datalog stores relations as compact masks", "[dtype][datalog]") {
+    const std::string source = R"(
+        Edge(A, B)
+        Edge(B, C)
+        Edge(C, D)
+        Path(x, y) <- Edge(x, y)
+        Path(x, z) <- Path(x, y), Path(y, z)
+        Path(A, D)?
+    )";
+    std::stringstream compactOut, compactErr, denseOut, denseErr;
+    TensorLogicVM compact{&compactOut, &compactErr};
+    TensorLogicVM dense{&denseOut, &denseErr};
+    compact.setDTypePolicy(DTypePolicy::parse("mixed-bf16"));
+    compact.datalog().setTensorMode(true);
+    dense.datalog().setTensorMode(true);
+    compact.execute(parseProgram(source));
+    dense.execute(parseProgram(source));
+
+    REQUIRE(compact.env().facts("Path").size() == 6);
+    CHECK(compact.env().facts("Path") == dense.env().facts("Path"));
+    CHECK(compactOut.str() == denseOut.str());
+}
@@ -0,0 +1,111 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "TL/Parser.hpp"
+#include "TL/vm.hpp"
+#include "TL/backend.hpp"
+#include "TL/Runtime/EinsumPath.hpp"
+#include <sstream>
+
+using namespace tl;
+
+TEST_CASE("Einsum path reorders a matrix chain", "[einsum_path]") {
+    // (A B) C would build a 50x100 intermediate; A (B C) only 5x10
+    auto path = EinsumPath::plan("ij,jk,kl->il", {{50, 5}, {5, 100}, {100, 10}});
+    REQUIRE(path.has_value());
+    CHECK(path->strategy() == EinsumPath::Strategy::Optimal);
+    CHECK(path->cost() == 7500.0);
+    CHECK(path->naiveCost() == 75000.0);
+    REQUIRE(path->steps().size() == 2);
+    CHECK(path->steps()[0].lhs == 1);
+    CHECK(path->steps()[0].rhs == 2);
+    CHECK(path->steps()[1].spec == "ij,jl->il");
+
+    Tensor a = torch::randn({50, 5});
+    Tensor b = torch::randn({5, 100});
+    Tensor c = torch::randn({100, 10});
+    CHECK(torch::allclose(path->run({a, b, c}), torch::einsum("ij,jk,kl->il", {a, b, c}), 1e-4, 1e-4));
+}
+
+TEST_CASE("Einsum path contracts attention without the score tensor", "[einsum_path]") {
+    auto path = EinsumPath::plan("hid,hjd,hje->hie", {{2, 16, 4}, {2, 16, 4}, {2, 16, 4}});
+    REQUIRE(path.has_value());
+    CHECK(path->cost() < path->naiveCost());
+    CHECK(path->steps()[0].spec.rfind("hjd,hje->", 0) == 0);
+
+    Tensor q = torch::randn({2, 16, 4});
+    Tensor k = torch::randn({2, 16, 4});
+    Tensor v = torch::randn({2, 16, 4});
+    CHECK(torch::allclose(path->run({q, k, v}), torch::einsum("hid,hjd,hje->hie", {q, k, v}), 1e-4, 1e-4));
+}
+
+TEST_CASE("Einsum path plans large contractions greedily", "[einsum_path]") {
+    std::string spec;
+    std::vector<Tensor> operands;
+    std::vector<std::vector<int64_t>> shapes;
+    const std::string labels = "abcdefgh";
+    for (size_t k = 0; k + 1 < labels.size(); ++k) {
+        if (!spec.empty()) spec += ',';
+        spec += labels.substr(k, 2);
+        operands.push_back(torch::randn({static_cast<int64_t>(k + 2), static_cast<int64_t>(k + 3)}));
+        shapes.push_back(operands.back().sizes().vec());
+    }
+    spec += "->ah";
+
+    auto path = EinsumPath::plan(spec, shapes);
+    REQUIRE(path.has_value());
+    CHECK(path->strategy() == EinsumPath::Strategy::Greedy);
+    CHECK(path->cost() <= path->naiveCost());
+    CHECK(path->steps().size() == operands.size() - 1);
+    CHECK(torch::allclose(path->run(operands), torch::einsum(spec, operands), 1e-3, 1e-3));
+}
+
+TEST_CASE("Einsum path leaves simple specs to torch", "[einsum_path]") {
+    CHECK_FALSE(EinsumPath::plan("ij,jk->ik", {{2, 3}, {3, 4}}).has_value());
+    CHECK_FALSE(EinsumPath::plan("...i,i,i", {{2, 2}, {2}, {2}}).has_value());
+    CHECK_FALSE(EinsumPath::plan("ij,jk,kl->iz", {{2, 3}, {3, 4}, {4, 5}}).has_value());
+    CHECK_FALSE(EinsumPath::plan("ij,jk,kl->il", {{2, 3}, {4, 4}, {4, 5}}).has_value());
+
+    // Implicit output keeps the labels used once, alphabetically
+    auto path = EinsumPath::plan("ij,jk,kl", {{2, 3}, {3, 4}, {4, 5}});
+    REQUIRE(path.has_value());
+    CHECK(path->steps().back().spec.substr(path->steps().back().spec.find("->")) == "->il");
+}
+
+TEST_CASE("Einsum path cache is keyed by spec and shapes", "[einsum_path]") {
+    EinsumPathCache cache;
+    std::vector<Tensor> small = {torch::randn({2, 3}), torch::randn({3, 4}), torch::randn({4, 5})};
+    std::vector<Tensor> large = {torch::randn({20, 3}), torch::randn({3, 4}), torch::randn({4, 5})};
+
+    auto first = cache.get("ij,jk,kl->il", small);
+    REQUIRE(first != nullptr);
+    CHECK(cache.get("ij,jk,kl->il", small) == first);
+    CHECK(cache.misses() == 1);
+    CHECK(cache.hits() == 1);
+
+    CHECK(cache.get("ij,jk,kl->il", large) != first);
+    CHECK(cache.get("ij,jk->ik", {small[0], small[1]}) == nullptr);
+    CHECK(cache.size() == 3);
+
+    cache.clear();
+    CHECK(cache.size() == 0);
+    CHECK(cache.hits() == 0);
+}
+
+TEST_CASE("Product chains lower to one planned einsum", "[einsum_path]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    Tensor a = torch::randn({6, 2});
+    Tensor b = torch::randn({2, 8});
+    Tensor c = torch::randn({8, 3});
+    vm.env().bind("A", a);
+    vm.env().bind("B", b);
+    vm.env().bind("C", c);
+    vm.execute(parseProgram("Y[i, l] = A[i, j] B[j, k] C[k, l]"));
+
+    REQUIRE(vm.env().has("Y"));
+    CHECK(torch::allclose(vm.env().lookup("Y"), torch::matmul(torch::matmul(a, b), c), 1e-4, 1e-4));
+
+    auto backend = BackendFactory::create(BackendType::LibTorch);
+    CHECK(torch::allclose(backend->einsum("ij,jk,kl->il", {a, b, c}), torch::matmul(a, torch::matmul(b, c)),
+                          1e-4, 1e-4));
+}
@@ -0,0 +1,139 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include "TL/Parser.hpp"
+#include "TL/vm.hpp"
+#include "TL/Runtime/ElementwiseFusion.hpp"
+#include <sstream>
+
+using namespace tl;
+using Catch::Matchers::WithinAbs;
+
+// Right-hand side of a single equation
+static ExprPtr parseRhs(const std::string& code) {
+    auto program = parseProgram(code);
+    REQUIRE(program.statements.size() == 1);
+    auto* eq = std::get_if<TensorEquation>(&program.statements[0]);
+    REQUIRE(eq != nullptr);
+    return eq->clauses[0].expr;
+}
+
+// Disables fusion for the lifetime of the guard
+struct FusionDisabled {
+    FusionDisabled() { FusedElementwise::setEnabled(false); }
+    ~FusionDisabled() { FusedElementwise::setEnabled(true); }
+};
+
+static Tensor runProgram(const std::string& source, const std::string& result) {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(source));
+    REQUIRE(vm.env().has(result));
+    return vm.env().lookup(result);
+}
+
+TEST_CASE("Fused kernel collects the elementwise subtree", "[fusion]") {
+    SECTION("Products that may contract stay leaves") {
+        auto kernel = FusedElementwise::build(parseRhs("Z[i] = sigmoid(W[i, j] X[j] + b[i]) * 0.5"));
+        REQUIRE(kernel.has_value());
+        CHECK(kernel->opCount() == 3);  // sigmoid, +, *
+        REQUIRE(kernel->leaves().size() == 2);
+        CHECK(std::holds_alternative<ExprBinary>(kernel->leaves()[0]->node));
+        CHECK(std::holds_alternative<ExprTensorRef>(kernel->leaves()[1]->node));
+    }
+
+    SECTION("A single operation is not worth a kernel") {
+        CHECK_FALSE(FusedElementwise::build(parseRhs("Y[i] = A[i] + B[i]")).has_value());
+        CHECK_FALSE(FusedElementwise::build(parseRhs("Y[i] = relu(A[i])")).has_value());
+    }
+
+    SECTION("Softmax is not elementwise") {
+        auto rhs = parseRhs("Y[i] = softmax(A[i])");
+        CHECK_FALSE(FusedElementwise::fusible(*rhs));
+        auto kernel = FusedElementwise::build(parseRhs("Y[i] = softmax(A[i]) * 2.0 - 1.0"));
+        REQUIRE(kernel.has_value());
+        CHECK(kernel->leaves().size() == 1);
+    }
+}
+
+TEST_CASE("Fused evaluation matches the unfused executor", "[fusion]") {
+    const std::string source = R"(
+        W = [[1.0, -2.0, 0.5], [3.0, 4.0, -1.0]]
+        X = [1.0, 0.5, -2.0]
+        b = [0.25, -0.75]
+        c = [1.0, 2.0, 3.0]
+        Z[i] = sigmoid(W[i, j] X[j] + b[i]) * 0.5
+        Y[i, j] = (W[i, j] - c[j]) / 2.0 + relu(0.0 - W[i, j])
+        G[i, j] = (W[i, j] > 0.0) + (c[j] == 2.0) * 2.0
+        P[i] = exp(X[i]) % 2.0 + abs(X[i]) ^ 2.0
+    )";
+
+    for (const char* name : {"Z", "Y", "G", "P"}) {
+        Tensor fused = runProgram(source, name);
+        Tensor unfused;
+        {
+            FusionDisabled guard;
+            unfused = runProgram(source, name);
+        }
+        INFO(name);
+        REQUIRE(fused.sizes() == unfused.sizes());
+        CHECK(torch::allclose(fused, unfused, 1e-5, 1e-6));
+    }
+}
+
+TEST_CASE("Fused kernel handles strided and broadcast inputs", "[fusion]") {
+    auto kernel = FusedElementwise::build(parseRhs("R = sigmoid(x) - 2.0 * y"));
+    REQUIRE(kernel.has_value());
+    REQUIRE(kernel->leaves().size() == 2);
+
+    Tensor x = torch::arange(12, torch::kFloat32).reshape({3, 4}).t();  // non-contiguous
+    Tensor y = torch::tensor({1.0f, -1.0f, 0.5f});                       // broadcast over rows
+
+    Tensor fused = kernel->evaluate({x, y});
+    Tensor expected = torch::sigmoid(x) - 2.0 * y;
+    REQUIRE(fused.sizes() == expected.sizes());
+    CHECK(torch::allclose(fused, expected));
+
+    SECTION("Mismatched shapes raise the usual torch error") {
+        CHECK_THROWS(kernel->evaluate({x, torch::ones({5})}));
+    }
+
+    SECTION("Inputs that require gradients keep the autograd graph") {
+        Tensor xg = x.clone().requires_grad_(true);
+        Tensor r = kernel->evaluate({xg, y});
+        CHECK(r.requires_grad());
+        r.sum().backward();
+        CHECK(xg.grad().defined());
+    }
+
+    SECTION("Non-float inputs are promoted like the unfused path") {
+        Tensor xi = torch::arange(3, torch::kInt64);
+        Tensor r = kernel->evaluate({xi, y});
+        CHECK_THAT(r[0].item<float>(), WithinAbs(0.5f - 2.0f, 1e-6f));
+    }
+}
+
+TEST_CASE("Scalar equations sum the fused elements while computing them", "[fusion]") {
+    auto kernel = FusedElementwise::build(parseRhs("Loss = (P[i] - T[i]) * (P[i] - T[i])"));
+    REQUIRE(kernel.has_value());
+    Tensor p = torch::randn({1000, 3});
+    Tensor t = torch::randn({3});  // broadcast over rows
+    Tensor total = kernel->sum({p, t, p, t});
+    CHECK(total.dim() == 0);
+    CHECK(torch::allclose(total, torch::sum((p - t) * (p - t)), 1e-4, 1e-5));
+    CHECK(kernel->sum({torch::ones({0}), torch::ones({0}), torch::ones({0}), torch::ones({0})}).item<float>() == 0.0f);
+
+    const std::string source = R"(
+        P = [0.5, 1.5, -2.0, 4.0]
+        T = [1.0, 1.0, 1.0, 1.0]
+        Loss = (P[i] - T[i]) * (P[i] - T[i])
+    )";
+    Tensor fused = runProgram(source, "Loss");
+    Tensor unfused;
+    {
+        FusionDisabled guard;
+        unfused = runProgram(source, "Loss");
+    }
+    CHECK(fused.dim() == 0);
+    CHECK_THAT(fused.item<float>(), WithinAbs(unfused.item<float>(), 1e-5));
+    CHECK_THAT(fused.item<float>(), WithinAbs(0.25 + 0.25 + 9.0 + 9.0, 1e-5));
+}
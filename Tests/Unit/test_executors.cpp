@@ -1,5 +1,6 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
 
 #include "TL/vm.hpp"
 #include "TL/Parser.hpp"
@@ -180,6 +181,36 @@ TEST_CASE("ListLiteralExecutor::execute", "[executor][list]") {
     }
 }
 
+TEST_CASE("ListLiteralExecutor folds constant literals once", "[executor][list]") {
+    ListLiteralExecutor executor;
+    Environment env;
+    auto backend = createBackend();
+
+    auto eq = parseEquation("X = [[1.0, (2.0)], [3.0, 4.0]]");
+    const auto& lst = std::get<ExprList>(eq.clauses[0].expr->node);
+    REQUIRE(lst.folded == nullptr);
+
+    Tensor first = executor.execute(eq, env, *backend);
+    REQUIRE(lst.folded != nullptr);
+    REQUIRE(first.sizes().vec() == std::vector<int64_t>{2, 2});
+    REQUIRE_THAT(first.index({0, 1}).item<float>(), Catch::Matchers::WithinRel(2.0f, 0.001f));
+
+    // Each execution gets its own copy of the cached value
+    first.index_put_({0, 0}, 9.0f);
+    Tensor second = executor.execute(eq, env, *backend);
+    REQUIRE_THAT(second.index({0, 0}).item<float>(), Catch::Matchers::WithinRel(1.0f, 0.001f));
+    REQUIRE(second.data_ptr() != first.data_ptr());
+
+    SECTION("Literals with non-numeric leaves are not folded") {
+        auto ragged = parseEquation("Y = [[1.0, 2.0], [3.0]]");
+        REQUIRE_FALSE(executor_utils::foldListLiteral(std::get<ExprList>(ragged.clauses[0].expr->node)));
+        REQUIRE_THROWS(executor.execute(ragged, env, *backend));
+
+        auto mixed = parseEquation("Y = [a, 2.0]");
+        REQUIRE_FALSE(executor_utils::foldListLiteral(std::get<ExprList>(mixed.clauses[0].expr->node)));
+    }
+}
+
 // ============================================================================
 // EinsumExecutor Tests
 // ============================================================================
@@ -463,6 +494,42 @@ TEST_CASE("PoolingExecutor::execute", "[executor][pooling]") {
     }
 }
 
+TEST_CASE("PoolingExecutor pools arbitrary ranks in one reduction", "[executor][pooling]") {
+    PoolingExecutor executor;
+    Environment env;
+    auto backend = createBackend();
+
+    SECTION("Uneven windows keep the partial last window") {
+        env.bind("X", torch::tensor({0.0f, 1.0f, 2.0f, 3.0f, 4.0f}));
+        Tensor avg = executor.execute(parseEquation("Y[i/2] avg= X[i]"), env, *backend);
+        REQUIRE(torch::allclose(avg, torch::tensor({0.5f, 2.5f, 4.0f})));
+        Tensor max = executor.execute(parseEquation("Y[i/2] max= X[i]"), env, *backend);
+        REQUIRE(torch::allclose(max, torch::tensor({1.0f, 3.0f, 4.0f})));
+    }
+
+    SECTION("Divided and summed-out axes mix in one pass") {
+        Tensor x = torch::arange(24, torch::kFloat32).reshape({2, 4, 3});
+        env.bind("X", x);
+        Tensor result = executor.execute(parseEquation("Y[i, j/2] max= X[i, j, k]"), env, *backend);
+        REQUIRE(result.sizes() == std::vector<int64_t>{2, 2});
+        REQUIRE(torch::allclose(result, x.reshape({2, 2, 2, 3}).amax({2, 3})));
+    }
+
+    SECTION("Axes may be reordered") {
+        Tensor x = torch::arange(6, torch::kFloat32).reshape({2, 3});
+        env.bind("X", x);
+        Tensor result = executor.execute(parseEquation("Y[j, i] += X[i, j]"), env, *backend);
+        REQUIRE(torch::allclose(result, x.t()));
+    }
+
+    SECTION("Scalar LHS reduces everything") {
+        env.bind("X", torch::tensor({{1.0f, 2.0f}, {3.0f, 4.0f}}));
+        Tensor result = executor.execute(parseEquation("S += X[i, j]"), env, *backend);
+        REQUIRE(result.dim() == 0);
+        REQUIRE_THAT(result.item<float>(), Catch::Matchers::WithinRel(10.0f, 0.001f));
+    }
+}
+
 // ============================================================================
 // IdentityExecutor Tests
 // ============================================================================
@@ -821,3 +888,153 @@ TEST_CASE("GuardedClauseExecutor::execute", "[executor][guarded]") {
     }
 }
 
+TEST_CASE("GuardedClauseExecutor vectorized path matches per-index evaluation", "[executor][guarded]") {
+    GuardedClauseExecutor vectorized;
+    GuardedClauseExecutor scalar;
+    scalar.setVectorized(false);
+    Environment env;
+    auto backend = createBackend();
+
+    env.bind("X", torch::tensor({-3.0f, -0.5f, 0.0f, 0.25f, 1.5f, 4.0f}));
+    env.bind("M", torch::tensor({{1.0f, 2.0f}, {3.0f, 4.0f}, {5.0f, 6.0f},
+                                 {7.0f, 8.0f}, {9.0f, 10.0f}, {11.0f, 12.0f}}));
+    env.bind("t", torch::tensor(0.5f));
+
+    for (const char* source : {
+             "Y[i] = 0.0 : (X[i] < -1.0) | X[i] * X[i] : (X[i] < t and i != 3) | sigmoid(X[i]) * 2.0",
+             "Y[i] = M[i, 1] - M[i, 0] : (i % 2 == 0) | X[i] ^ 2.0 + i",
+             "Y[i] = 0.0 - X[i] : (X[i] >= 0.0) | 1.0",
+         }) {
+        INFO(source);
+        auto eq = parseEquation(source);
+        Tensor fast = vectorized.execute(eq, env, *backend);
+        Tensor slow = scalar.execute(eq, env, *backend);
+        REQUIRE(fast.sizes() == slow.sizes());
+        REQUIRE(torch::allclose(fast, slow, 1e-5, 1e-6));
+    }
+
+    SECTION("Index variables are not left bound") {
+        auto eq = parseEquation("Y[i] = 2.0 * X[i] : (i < 2) | X[i]");
+        vectorized.execute(eq, env, *backend);
+        REQUIRE_FALSE(env.has("i"));
+    }
+
+    SECTION("Indices no clause matches still raise") {
+        auto eq = parseEquation("Y[i] = X[i] : (X[i] < 0.0) | 1.0 : (X[i] > 1.0)");
+        REQUIRE_THROWS_WITH(vectorized.execute(eq, env, *backend),
+                            Catch::Matchers::ContainsSubstring("no clause matched for index 2"));
+    }
+}
+
+
+// ============================================================================
+// ExecutorRegistry dispatch cache
+// ============================================================================
+
+TEST_CASE("Dispatch signatures collapse integer indices only", "[executor][registry]") {
+    using executor_utils::dispatchSignature;
+    CHECK(dispatchSignature(parseEquation("S[i, 3] = W[i, j] S[j, 2]")) ==
+          dispatchSignature(parseEquation("S[i, 4] = W[i, j] S[j, 3]")));
+    CHECK(dispatchSignature(parseEquation("S[i] = W[i, j] S[j]")) !=
+          dispatchSignature(parseEquation("S[i] = W[i, j] T[j]")));
+    CHECK(dispatchSignature(parseEquation("Y[i] = X[i] + 1.0")) !=
+          dispatchSignature(parseEquation("Y[i] = X[i] * 1.0")));
+    CHECK(dispatchSignature(parseEquation("Y = einsum(\"ij->i\", X)")) !=
+          dispatchSignature(parseEquation("Y = einsum(\"ij->j\", X)")));
+    CHECK(dispatchSignature(parseEquation("Y[i] += X[i]")) !=
+          dispatchSignature(parseEquation("Y[i] = X[i]")));
+}
+
+TEST_CASE("ExecutorRegistry caches dispatch and records statistics", "[executor][registry]") {
+    auto backend = createBackend();
+    Environment env;
+    ExecutorRegistry registry;
+    registry.registerExecutor(std::make_unique<ScalarAssignExecutor>());
+    registry.registerExecutor(std::make_unique<IdentityExecutor>());
+    registry.registerExecutor(std::make_unique<ExpressionExecutor>());
+
+    env.bind("X", torch::tensor({1.0f, 2.0f}));
+    env.bind("Y", torch::tensor({0.0f, 0.0f}));
+    auto first = parseEquation("Y[i] = X[i] + 1.0");
+    auto second = parseEquation("Y[i] = X[i] + 1.0");
+
+    REQUIRE(&registry.select(first, env) == &registry.select(second, env));
+    auto stats = registry.stats();
+    REQUIRE(stats.size() == 3);
+    CHECK(stats[2].name == "ExpressionExecutor");
+    CHECK(stats[2].selections == 1);
+    CHECK(stats[2].cacheHits == 1);
+
+    Tensor result = registry.execute(second, env, *backend);
+    CHECK_THAT(result.index({1}).item<float>(), Catch::Matchers::WithinAbs(3.0f, 1e-6f));
+    stats = registry.stats();
+    CHECK(stats[2].cacheHits == 2);
+    CHECK(stats[2].executions == 1);
+    CHECK(stats[2].executeTime.count() >= 0);
+
+    SECTION("A new tensor name invalidates the cache") {
+        auto copy = parseEquation("Z = W");
+        CHECK(&registry.select(copy, env) == &registry.select(first, env));  // W missing: expression
+        env.bind("W", torch::tensor({5.0f}));
+        CHECK(registry.select(copy, env).name() == "IdentityExecutor");
+        CHECK(registry.stats()[1].selections == 1);
+    }
+
+    SECTION("Disabling the cache scans every time") {
+        registry.setCacheEnabled(false);
+        registry.resetStats();
+        registry.select(first, env);
+        registry.select(second, env);
+        CHECK(registry.stats()[2].selections == 2);
+        CHECK(registry.stats()[2].cacheHits == 0);
+    }
+}
+
+TEST_CASE("Environment slots agree with names", "[environment]") {
+    Environment env;
+    const Environment::Slot x = env.slot("X");
+    CHECK(env.slot("X") == x);
+    CHECK(env.findSlot("Y") == Environment::kNoSlot);
+    CHECK_FALSE(env.has(x));
+
+    const uint64_t layout = env.layoutVersion();
+    env.bind(x, torch::tensor({1.0f, 2.0f}));
+    CHECK(env.layoutVersion() == layout + 1);
+    CHECK(env.lookup("X").size(0) == 2);
+    env.bind("X", torch::tensor({3.0f}));
+    CHECK(env.layoutVersion() == layout + 1);
+    CHECK(env.lookup(x).item<float>() == 3.0f);
+
+    // Erasing keeps the slot for the next binding
+    CHECK(env.erase("X"));
+    CHECK_FALSE(env.has(x));
+    CHECK_THROWS_AS(env.lookup(x), std::runtime_error);
+    CHECK(env.tensors().empty());
+    env.bind(x, torch::tensor({4.0f}));
+    CHECK(env.tensors().count("X") == 1);
+
+    SECTION("Copies share slots until one interns a name") {
+        Environment copy = env;
+        copy.bind(copy.slot("Z"), torch::tensor({5.0f}));
+        env.bind(env.slot("W"), torch::tensor({6.0f}));
+        CHECK(copy.slot("Z") == env.slot("W"));
+        CHECK(copy.lookup(x).item<float>() == 4.0f);
+        CHECK_FALSE(copy.has("W"));
+        CHECK_FALSE(env.has("Z"));
+    }
+
+    SECTION("References cache their slot per environment") {
+        auto eq = parseEquation("Y = X");
+        const auto& ref = std::get<ExprTensorRef>(eq.clauses[0].expr->node).ref;
+        Environment other;
+        other.bind("A", torch::tensor({7.0f}));
+        other.bind("X", torch::tensor({8.0f}));
+        for (int i = 0; i < 2; ++i) {
+            CHECK(env.lookup(ref).item<float>() == 4.0f);
+            CHECK(other.lookup(ref).item<float>() == 8.0f);
+        }
+        const TensorRef renamed = [&] { TensorRef r = ref; r.name.name = "A"; return r; }();
+        CHECK(other.lookup(renamed).item<float>() == 7.0f);
+        CHECK_FALSE(env.has(renamed));
+    }
+}
@@ -3,7 +3,11 @@
 #include <catch2/matchers/catch_matchers_string.hpp>
 #include "TL/Parser.hpp"
 #include "TL/vm.hpp"
+#include <algorithm>
 #include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
 
 using namespace tl;
 
@@ -237,6 +241,46 @@ TEST_CASE("Sample from distribution", "[learning][sample]") {
     REQUIRE(!output.empty());
 }
 
+TEST_CASE("Alias-table sampler", "[learning][sample]") {
+    const LearningConfig config = LearningConfig::fromDirective(*std::get<Query>(
+        parseProgram("P = [1.0]\nP? @sample(n=10, seed=7, output=\"counts\")\n").statements.back()).directive);
+    REQUIRE(config.seed == 7u);
+    REQUIRE(config.sampleCounts);
+
+    const torch::Tensor probs = torch::tensor({1.0, 0.0, 3.0, 4.0});
+    Sampler sampler(4);
+    SampleOptions options;
+    options.count = 200000;  // several chunks across the pool
+    options.seed = 42;
+
+    const torch::Tensor draws = sampler.sample("P", probs, options);
+    REQUIRE(draws.sizes() == torch::IntArrayRef({200000}));
+    REQUIRE(draws.min().item<int64_t>() >= 0);
+    REQUIRE(draws.max().item<int64_t>() <= 3);
+    REQUIRE((draws == 1).sum().item<int64_t>() == 0);
+
+    // The same seed gives the same draws however they are split across
+    // threads, and counts are their histogram without the draws
+    Sampler serial(1);
+    REQUIRE(torch::equal(serial.sample("P", probs, options), draws));
+    options.counts = true;
+    const torch::Tensor counts = sampler.sample("P", probs, options);
+    REQUIRE(torch::equal(counts, torch::bincount(draws, {}, 4)));
+    REQUIRE_THAT(counts[3].item<double>() / 200000.0, Catch::Matchers::WithinAbs(0.5, 0.01));
+
+    // The table is built once while the tensor is unchanged
+    REQUIRE(sampler.tablesBuilt() == 1);
+    probs.mul_(1.0);
+    sampler.sample("P", probs, options);
+    REQUIRE(sampler.tablesBuilt() == 2);
+
+    // One distribution per row of a 2-d tensor
+    const torch::Tensor rows = sampler.sample("R", torch::tensor({{1.0, 0.0}, {0.0, 1.0}}), options);
+    REQUIRE(torch::equal(rows, torch::tensor({{200000, 0}, {0, 200000}}, torch::kLong)));
+
+    REQUIRE_THROWS(sampler.sample("N", torch::tensor({1.0, -1.0}), options));
+}
+
 TEST_CASE("Verbose mode outputs progress", "[learning][verbose]") {
     std::string code = R"(
         x = [0.0]
@@ -290,6 +334,234 @@ TEST_CASE("Multi-parameter optimization", "[learning][minimize]") {
     REQUIRE_THAT(y_val, Catch::Matchers::WithinAbs(2.0, 0.1));
 }
 
+TEST_CASE("Training replays only the parameter to loss slice", "[learning][minimize][plan]") {
+    std::string code = R"(
+        X = [1.0, 2.0, 3.0]
+        Scale = [2.0]
+        Y[i] = Scale[0] X[i]
+
+        w = [0.0]
+        Pred[i] = w[0] X[i]
+        Err[i] = (Pred[i] - Y[i])^2
+        Loss = Err[i]
+
+        Scaled[i] = w[0] Y[i]
+        Total = X[i]
+
+        Loss? @minimize(lr=0.01, epochs=200)
+    )";
+
+    Program prog = parseProgram(code);
+
+    // Y is constant and feeds the loss; Scaled reads w but not the loss;
+    // Total is unrelated to both
+    auto names = [](const std::vector<TrainingStep>& steps) {
+        std::vector<std::string> out;
+        for (const auto& step : steps) out.push_back(step.equation->lhs.name.name);
+        return out;
+    };
+    const TrainingPlan plan = LearningEngine::planTraining("Loss", {"w"}, prog);
+    REQUIRE(names(plan.steps) == std::vector<std::string>{"Pred", "Err", "Loss"});
+    REQUIRE(names(plan.cached) == std::vector<std::string>{"Y"});
+    REQUIRE(names(plan.refresh) == std::vector<std::string>{"Scaled"});
+
+    std::ostringstream out, err;
+    TensorLogicVM vm(&out, &err);
+    REQUIRE_NOTHROW(vm.execute(prog));
+    REQUIRE(vm.learning().lastPlan().steps.size() == 3);
+
+    const double w = vm.env().lookup("w")[0].item<double>();
+    REQUIRE_THAT(w, Catch::Matchers::WithinAbs(2.0, 0.1));
+
+    // Equations off the loss path see the trained parameter afterwards
+    const auto scaled = vm.env().lookup("Scaled");
+    REQUIRE_THAT(scaled[2].item<double>(), Catch::Matchers::WithinAbs(w * 6.0, 1e-4));
+}
+
+TEST_CASE("Mini-batched training", "[learning][minimize][batch]") {
+    // y = 2x + 1 on 64 points in [0, 1), learned 16 rows at a time
+    std::string xs, ys;
+    for (int i = 0; i < 64; ++i) {
+        if (i) { xs += ", "; ys += ", "; }
+        xs += std::to_string(i / 64.0);
+        ys += std::to_string(2.0 * (i / 64.0) + 1.0);
+    }
+    auto program = [&](const std::string& args) {
+        return parseProgram(
+            "X = [" + xs + "]\n"
+            "Y = [" + ys + "]\n"
+            "m = [0.0]\n"
+            "b = [0.0]\n"
+            "Pred[i] = m[0] X[i] + b[0]\n"
+            "Err[i] = (Pred[i] - Y[i])^2\n"
+            "Loss = Err[i]\n"
+            "Loss? @minimize(lr=0.02, epochs=200, " + args + ")\n");
+    };
+
+    const LearningConfig config = LearningConfig::fromDirective(
+        *std::get<Query>(program("batch_size=16, shuffle=true, workers=2").statements.back()).directive);
+    REQUIRE(config.batchSize == 16);
+    REQUIRE(config.shuffle);
+    REQUIRE(config.workers == 2);
+
+    auto train = [&](const std::string& args) {
+        std::ostringstream out, err;
+        TensorLogicVM vm(&out, &err);
+        vm.execute(program(args));
+        // The data and the slice are back at full size afterwards
+        REQUIRE(vm.env().lookup("X").size(0) == 64);
+        REQUIRE(vm.env().lookup("Pred").size(0) == 64);
+        const auto inputs = vm.learning().lastPlan().inputs;
+        REQUIRE(std::find(inputs.begin(), inputs.end(), "X") != inputs.end());
+        return std::make_pair(vm.env().lookup("m")[0].item<double>(), vm.env().lookup("b")[0].item<double>());
+    };
+
+    const auto shuffled = train("batch_size=16, shuffle=true, workers=2");
+    REQUIRE_THAT(shuffled.first, Catch::Matchers::WithinAbs(2.0, 0.1));
+    REQUIRE_THAT(shuffled.second, Catch::Matchers::WithinAbs(1.0, 0.1));
+
+    // In-order batches are the same with or without the loader thread
+    const auto inline_ = train("batch_size=16");
+    const auto prefetched = train("batch_size=16, workers=3");
+    REQUIRE(inline_ == prefetched);
+    REQUIRE_THAT(inline_.first, Catch::Matchers::WithinAbs(2.0, 0.1));
+
+    // A batch holding every row is full-batch training
+    REQUIRE(train("batch_size=64") == train("batch_size=0"));
+}
+
+TEST_CASE("Optimizers over a flat parameter buffer", "[learning][minimize][optimizer]") {
+    auto program = [](const std::string& args) {
+        return parseProgram(
+            "x = [0.0]\n"
+            "w = [[0.0, 0.0], [0.0, 0.0]]\n"
+            "TX = [1.5]\n"
+            "TW = [[1.0, 2.0], [3.0, 4.0]]\n"
+            "dx = x[0] - TX[0]\n"
+            "D[i, j] = (w[i, j] - TW[i, j])^2\n"
+            "dw = D[i, j]\n"
+            "loss = dx^2 + dw\n"
+            "loss? @minimize(epochs=300, " + args + ")\n");
+    };
+
+    const LearningConfig config = LearningConfig::fromDirective(*std::get<Query>(
+        program("optimizer=\"AdamW\", lr=0.05, beta1=0.8, weight_decay=0").statements.back()).directive);
+    REQUIRE(config.optimizer == "adamw");
+    REQUIRE(config.beta1 == 0.8);
+    REQUIRE(config.beta2 < 0);  // left at the optimizer default
+    REQUIRE(config.weightDecay == 0.0);
+
+    for (const std::string args : {"lr=0.1", "lr=0.1, momentum=0.5", "optimizer=\"adam\", lr=0.05",
+                                   "optimizer=\"adamw\", lr=0.05, weight_decay=0",
+                                   "optimizer=\"rmsprop\", lr=0.01"}) {
+        INFO(args);
+        std::ostringstream out, err;
+        TensorLogicVM vm(&out, &err);
+        REQUIRE_NOTHROW(vm.execute(program(args)));
+
+        const torch::Tensor x = vm.env().lookup("x");
+        const torch::Tensor w = vm.env().lookup("w");
+        REQUIRE_THAT(x[0].item<double>(), Catch::Matchers::WithinAbs(1.5, 0.1));
+        REQUIRE_THAT(w[1][0].item<double>(), Catch::Matchers::WithinAbs(3.0, 0.1));
+        REQUIRE(w.sizes() == torch::IntArrayRef({2, 2}));
+
+        // Both parameters alias one buffer, laid out in name order
+        const ParameterBuffer* buffer = vm.learning().lastParameters();
+        REQUIRE(buffer != nullptr);
+        REQUIRE(buffer->flat().numel() == 5);
+        REQUIRE(buffer->slots()[0].name == "w");
+        REQUIRE(w.data_ptr() == buffer->flat().data_ptr());
+        REQUIRE(x.data_ptr<float>() == buffer->flat().data_ptr<float>() + 4);
+        REQUIRE_FALSE(x.requires_grad());
+    }
+
+    std::ostringstream out, err;
+    TensorLogicVM vm(&out, &err);
+    REQUIRE_THROWS_WITH(vm.execute(program("optimizer=\"lbfgs\"")),
+                        Catch::Matchers::ContainsSubstring("Unknown optimizer"));
+}
+
+TEST_CASE("Checkpointed training through a recurrence", "[learning][minimize][checkpoint]") {
+    std::string xs;
+    for (int t = 0; t < 16; ++t) {
+        if (t) xs += ", ";
+        xs += std::to_string(0.1 * ((t % 5) - 2));
+    }
+    struct Trained { double w, b, loss; };
+    auto train = [&](const std::string& args) {
+        std::ostringstream out, err;
+        TensorLogicVM vm(&out, &err);
+        vm.execute(parseProgram(
+            "w = [0.5]\n"
+            "b = [0.0]\n"
+            "X = [" + xs + "]\n"
+            "Target = [0.4]\n"
+            "h[0] = 0.0\n"
+            "h[*t+1] = tanh(w[0] * h[*t] + b[0] + X[t])\n"
+            "Diff = h[0] - Target[0]\n"
+            "Loss = Diff^2\n"
+            "Loss? @minimize(lr=0.2, " + args + ")\n"));
+        REQUIRE(vm.learning().lastPlan().recurrences.size() == 1);
+        return Trained{vm.env().lookup("w")[0].item<double>(), vm.env().lookup("b")[0].item<double>(),
+                       vm.env().lookup("Loss").item<double>()};
+    };
+
+    const Trained untrained = train("epochs=0");
+    const Trained full = train("epochs=40");
+    REQUIRE(full.loss < untrained.loss);
+
+    // Recomputing segments in the backward pass gives the same gradients
+    for (const std::string args : {"epochs=40, checkpoint=4", "epochs=40, checkpoint=5",
+                                   "epochs=40, checkpoint=true"}) {
+        INFO(args);
+        const Trained checkpointed = train(args);
+        REQUIRE_THAT(checkpointed.w, Catch::Matchers::WithinAbs(full.w, 1e-5));
+        REQUIRE_THAT(checkpointed.b, Catch::Matchers::WithinAbs(full.b, 1e-5));
+        REQUIRE_THAT(checkpointed.loss, Catch::Matchers::WithinAbs(full.loss, 1e-6));
+    }
+}
+
+TEST_CASE("Training through a fixed-point loop", "[learning][minimize]") {
+    // No tensor drives t, so the loop runs until x stops changing; the
+    // convergence check sees states that require grad
+    auto train = [](const std::string& epochs) {
+        std::ostringstream out, err;
+        TensorLogicVM vm(&out, &err);
+        vm.execute(parseProgram(
+            "w = [0.5]\n"
+            "Target = [0.2]\n"
+            "x[0] = 0.0\n"
+            "x[*t+1] = 0.5 * tanh(w[0] + x[*t])\n"
+            "Diff = x[0] - Target[0]\n"
+            "Loss = Diff^2\n"
+            "Loss? @minimize(lr=0.5, epochs=" + epochs + ")\n"));
+        return vm.env().lookup("Loss").item<double>();
+    };
+
+    const double untrained = train("0");
+    double trained = 0.0;
+    REQUIRE_NOTHROW(trained = train("60"));
+    CHECK(trained < untrained);
+}
+
+TEST_CASE("Directives in a session see earlier fragments", "[learning][minimize][session]") {
+    std::ostringstream out, err;
+    TensorLogicVM vm(&out, &err);
+
+    // One line at a time, as typed into the REPL
+    vm.append(parseProgram("x = [0.0]\n"));
+    vm.append(parseProgram("Target = [2.0]\n"));
+    vm.append(parseProgram("diff = x[0] - Target[0]\n"));
+    vm.append(parseProgram("loss = diff^2\n"));
+    REQUIRE_NOTHROW(vm.append(parseProgram("loss? @minimize(lr=0.1, epochs=100)\n")));
+    CHECK_THAT(vm.env().lookup("x")[0].item<double>(), Catch::Matchers::WithinAbs(2.0, 0.1));
+    CHECK(vm.session().statements.size() == 5);
+
+    // A failing fragment is not kept
+    CHECK_THROWS(vm.append(parseProgram("Missing?\n")));
+    CHECK(vm.session().statements.size() == 5);
+}
+
 TEST_CASE("Error: No learnable parameters", "[learning][error]") {
     // All tensors are uppercase (data/constants), none are learnable by naming convention
     // Per the heuristic: lowercase = parameter, UPPERCASE = data (except W*)
@@ -0,0 +1,63 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Model.hpp"
+#include "TL/Parser.hpp"
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace tl;
+
+TEST_CASE("Model serves concurrent requests over shared parameters", "[model]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram("W = [[1.0, 2.0], [3.0, 4.0]]"));
+    const Model model(vm, parseProgram(R"(
+        H[i] = W[i, j] X[j]
+        Y[i] = relu(H[i])
+    )"));
+    const Tensor w = model.parameters().lookup("W").clone();
+
+    std::atomic<size_t> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&, t] {
+            for (int r = 0; r < 20; ++r) {
+                const float x = static_cast<float>(t * 20 + r);
+                auto result = model.evaluate({{"X", torch::tensor({x, 1.0f})}}, {"Y"});
+                const Tensor expected = torch::tensor({x + 2.0f, 3.0f * x + 4.0f});
+                if (!torch::allclose(result.at("Y"), expected)) ++wrong;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    CHECK(wrong == 0);
+    CHECK(torch::equal(model.parameters().lookup("W"), w));
+    CHECK_FALSE(model.parameters().has("Y"));
+    CHECK_THROWS_AS(model.evaluate({{"X", torch::tensor({1.0f, 1.0f})}}, {"Z"}), std::runtime_error);
+}
+
+TEST_CASE("Model contexts copy parameters on write", "[model]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(R"(
+        W = [1.0, 2.0]
+        Parent(Alice, Bob)
+        Ancestor(x, y) <- Parent(x, y)
+    )"));
+    const Model model(vm, parseProgram(R"(
+        W[0] = 5.0
+        Parent(Bob, Carol)
+        Ancestor(x, y)?
+    )"));
+    vm.execute(parseProgram("W = [9.0, 9.0]"));  // the model froze the VM as it was
+
+    std::stringstream requestOut;
+    auto context = model.context(&requestOut, &err);
+    model.run(*context);
+    CHECK(context->env().lookup("W")[0].item<float>() == 5.0f);
+    CHECK(model.parameters().lookup("W")[0].item<float>() == 1.0f);
+    // The rule came with the model and sees the request's fact
+    CHECK(requestOut.str().find("Carol") != std::string::npos);
+    CHECK(model.parameters().relation("Parent")->size() == 1);
+}
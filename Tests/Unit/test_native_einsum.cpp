@@ -0,0 +1,89 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Parser.hpp"
+#include "TL/vm.hpp"
+#include "TL/Runtime/NativeEinsum.hpp"
+#include <filesystem>
+#include <sstream>
+
+using namespace tl;
+
+namespace {
+// Enables native kernels, cached in a scratch directory, for the lifetime of the guard
+struct NativeEinsumEnabled {
+    NativeEinsumEnabled() {
+        NativeEinsum::setCacheDirectory(std::filesystem::temp_directory_path() / "tl_native_einsum_test");
+        NativeEinsum::setEnabled(true);
+    }
+    ~NativeEinsumEnabled() {
+        NativeEinsum::setEnabled(false);
+        NativeEinsum::setCacheDirectory({});
+    }
+};
+}
+
+TEST_CASE("Native einsum plans fold the shapes into the loops", "[native]") {
+    const auto matvec = NativeEinsum::plan("ij,j->i", {{4, 16}, {16}});
+    REQUIRE(matvec);
+    CHECK(matvec->outputShape() == std::vector<int64_t>{4});
+    CHECK(matvec->source().find("i_i < 4") != std::string::npos);
+    CHECK(matvec->source().find("t0[i_i * 16 + i_j] * t1[i_j]") != std::string::npos);
+    CHECK(matvec->source().find("#pragma omp simd reduction(+:acc)") != std::string::npos);
+
+    const auto diagonal = NativeEinsum::plan("ii->i", {{3, 3}});
+    REQUIRE(diagonal);
+    CHECK(diagonal->source().find("t0[i_i * 4]") != std::string::npos);
+
+    CHECK_FALSE(NativeEinsum::plan("ij,jk", {{2, 3}, {3, 4}}));          // implicit output
+    CHECK_FALSE(NativeEinsum::plan("ij,jk->ik", {{2, 3}, {2, 4}}));      // mismatched extents
+    CHECK_FALSE(NativeEinsum::plan("ij->ii", {{3, 3}}));                 // repeated output label
+    CHECK_FALSE(NativeEinsum::plan("ij,jk->ik", {{256, 256}, {256, 1}}));  // too many points
+}
+
+TEST_CASE("Native einsum kernels match LibTorch", "[native]") {
+    // Disabled by default: the backend leaves every einsum to LibTorch
+    CHECK_FALSE(NativeEinsum::run("i,i->", {torch::ones({4}), torch::ones({4})}).defined());
+
+    NativeEinsumEnabled guard;
+    const std::vector<std::pair<std::string, std::vector<Tensor>>> cases = {
+        {"ij,j->i", {torch::randn({4, 16}), torch::randn({16})}},
+        {"ij,jk->ik", {torch::randn({3, 5}), torch::randn({5, 2})}},
+        {"bi,bj->bij", {torch::randn({2, 3}), torch::randn({2, 4})}},
+        {"i,i->", {torch::randn({64}), torch::randn({64})}},
+        {"ij->ji", {torch::randn({3, 4}).t()}},  // non-contiguous operand
+        {"ii->i", {torch::randn({5, 5})}},
+    };
+    for (const auto& [spec, operands] : cases) {
+        INFO(spec);
+        const Tensor native = NativeEinsum::run(spec, operands);
+        // Without a compiler the kernel cannot be built and LibTorch is used
+        if (!native.defined()) continue;
+        const Tensor expected = torch::einsum(spec, operands);
+        REQUIRE(native.sizes() == expected.sizes());
+        CHECK(torch::allclose(native, expected, 1e-5, 1e-5));
+    }
+
+    // Operands LibTorch must handle are passed over
+    CHECK_FALSE(NativeEinsum::run("i,i->", {torch::ones({4}, torch::kFloat64), torch::ones({4}, torch::kFloat64)})
+                    .defined());
+    CHECK_FALSE(NativeEinsum::run("i,i->", {torch::ones({4}).requires_grad_(), torch::ones({4})}).defined());
+
+    // Kernels are never built in or loaded from a directory others can write to
+    const auto shared = std::filesystem::temp_directory_path() / "tl_native_einsum_shared";
+    std::filesystem::create_directories(shared);
+    std::filesystem::permissions(shared, std::filesystem::perms::all);
+    NativeEinsum::setCacheDirectory(shared);
+    CHECK_FALSE(NativeEinsum::run("ij->j", {torch::ones({7, 3})}).defined());
+    CHECK(std::filesystem::is_empty(shared));
+    NativeEinsum::setCacheDirectory(std::filesystem::temp_directory_path() / "tl_native_einsum_test");
+    std::filesystem::remove_all(shared);
+
+    // Programs give the same results through the VM's backend
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(R"(
+        W = [[1.0, 2.0, 3.0], [4.0, 5.0, 6.0]]
+        x = [0.5, -1.0, 2.0]
+        Score[i] = W[i, j] x[j]
+    )"));
+    CHECK(torch::allclose(vm.env().lookup("Score"), torch::tensor({4.5f, 9.0f})));
+}
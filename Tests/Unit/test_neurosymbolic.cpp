@@ -257,3 +257,98 @@ TEST_CASE("Neurosymbolic - confidence scoring", "[neurosymbolic][scoring]") {
     REQUIRE(hasFact(vm.env(), "HighConfidence", {"Alice", "Bob"}));
     REQUIRE(hasFact(vm.env(), "Trustworthy", {"Alice", "Bob"}));
 }
+
+TEST_CASE("Neurosymbolic - Datalog constants do not widen labelled tensors", "[neurosymbolic][symbols]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(R"(
+        Parent(Alice, Bob)
+        Score[Carol] = 1.0
+    )"));
+    const Tensor score = vm.env().lookup("Score");
+    REQUIRE(score.sizes() == std::vector<int64_t>{1});
+    CHECK(score[0].item<float>() == 1.0f);
+}
+
+TEST_CASE("Neurosymbolic - labels and constants share one index", "[neurosymbolic][symbols]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(R"(
+        Parent(Alice, Bob)
+        Parent(Bob, Charlie)
+        Ancestor(x, y) <- Parent(x, y)
+        Ancestor(x, z) <- Ancestor(x, y), Parent(y, z)
+
+        Emb[Alice, 0] = 1.0
+        Emb[Alice, 1] = 0.0
+        Emb[Bob, 0] = 0.9
+        Emb[Bob, 1] = 0.1
+        Emb[Charlie, 0] = 0.1
+        Emb[Charlie, 1] = 0.9
+        Emb[Dave, 0] = 0.95
+        Emb[Dave, 1] = 0.05
+        Score[x, y] = Emb[x, d] Emb[y, d]
+    )"));
+
+    // Labels take dense axis positions in order of first use, and the
+    // Datalog constants interned before them do not widen the tensors
+    const SymbolTable& symbols = vm.env().symbols();
+    const std::vector<std::string> labels = {"Alice", "Bob", "Charlie", "Dave"};
+    REQUIRE(vm.env().labelSymbols().size() == labels.size());
+    for (size_t axis = 0; axis < labels.size(); ++axis) {
+        int index = -1;
+        SymbolId id = 0;
+        REQUIRE(vm.env().getLabelIndex(labels[axis], index));
+        REQUIRE(symbols.lookup(labels[axis], id));
+        CHECK(index == static_cast<int>(axis));
+        CHECK(vm.env().labelAxis(id) == static_cast<int64_t>(axis));
+        CHECK(vm.env().labelSymbols()[axis] == id);
+    }
+    CHECK(vm.env().lookup("Emb").size(0) == 4);
+    int unused = -1;
+    CHECK_FALSE(vm.env().getLabelIndex("x", unused));
+
+    // Constants only Datalog has seen are not labels and leave the layout alone
+    const uint64_t layout = vm.env().layoutVersion();
+    vm.execute(parseProgram("Parent(Charlie, Erin)\n"));
+    vm.datalog().saturate();
+    int erin = -1;
+    CHECK_FALSE(vm.env().getLabelIndex("Erin", erin));
+    CHECK(vm.env().layoutVersion() == layout);
+    CHECK_THROWS_AS(vm.env().relationTensor("Ancestor"), std::runtime_error);
+
+    // Relations project into sparse tensors over the label axes with the
+    // closure included; their constants become labels readable by name
+    vm.projectRelation("Ancestor", "AncestorMask");
+    const Tensor mask = vm.env().lookup("AncestorMask");
+    REQUIRE(mask.is_sparse());
+    REQUIRE(mask.sizes() == std::vector<int64_t>{5, 5});
+    CHECK(mask._nnz() == 6);
+    int alice = -1, charlie = -1;
+    REQUIRE(vm.env().getLabelIndex("Alice", alice));
+    REQUIRE(vm.env().getLabelIndex("Charlie", charlie));
+    REQUIRE(vm.env().getLabelIndex("Erin", erin));
+    CHECK(erin == 4);
+    CHECK(getTensorValue(mask.to_dense(), {alice, charlie}) == 1.0f);
+    CHECK(getTensorValue(mask.to_dense(), {alice, erin}) == 1.0f);
+    const std::vector<SymbolId> tuples = vm.env().tensorTuples(mask);
+    REQUIRE(tuples.size() == 12);
+    for (size_t k = 0; k < tuples.size(); k += 2) {
+        CHECK(vm.env().relation("Ancestor")->contains(&tuples[k]));
+    }
+    CHECK_THROWS_AS(vm.projectRelation("Missing", "M"), std::runtime_error);
+
+    // Tensors threshold back into relations that rules then extend
+    vm.execute(parseProgram("MaybeRelated(x, z) <- Similar(x, y), Parent(y, z), x != z\n"));
+    CHECK(vm.thresholdTensor("Score", "Similar", 0.8) > 0);
+    CHECK(hasFact(vm.env(), "Similar", {"Alice", "Bob"}));
+    CHECK(hasFact(vm.env(), "Similar", {"Dave", "Alice"}));
+    CHECK_FALSE(hasFact(vm.env(), "Similar", {"Alice", "Charlie"}));
+    CHECK(vm.thresholdTensor("Score", "Similar", 0.8) == 0);  // nothing new
+    vm.datalog().saturate();
+    CHECK(hasFact(vm.env(), "MaybeRelated", {"Dave", "Bob"}));
+
+    // Positions past the last label are not symbols
+    vm.env().bind("Wide", torch::ones({static_cast<int64_t>(vm.env().labelSymbols().size()) + 1}));
+    CHECK_THROWS_AS(vm.thresholdTensor("Wide", "Unary"), std::runtime_error);
+}
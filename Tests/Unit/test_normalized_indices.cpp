@@ -2,6 +2,8 @@
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 #include "TL/Parser.hpp"
 #include "TL/vm.hpp"
+#include "TL/Runtime/NormalizationFusion.hpp"
+#include <limits>
 #include <sstream>
 
 using namespace tl;
@@ -215,3 +217,56 @@ TEST_CASE("Normalized indices - with arithmetic operations", "[normalized]") {
     float sum = Y[0].item<float>() + Y[1].item<float>();
     REQUIRE_THAT(sum, WithinAbs(1.0, 1e-5));
 }
+
+namespace {
+// Sends normalization to torch::softmax for the lifetime of the guard
+struct NormalizationFusionDisabled {
+    NormalizationFusionDisabled() { FusedNormalization::setEnabled(false); }
+    ~NormalizationFusionDisabled() { FusedNormalization::setEnabled(true); }
+};
+}
+
+TEST_CASE("Normalized indices - fused softmax matches torch", "[normalized]") {
+    // Rows longer than a block, and -inf entries that must not poison a row
+    Tensor x = torch::randn({3, 700, 5}) * 10.0;
+    x.index_put_({0, torch::indexing::Slice(0, 300), 0}, -std::numeric_limits<float>::infinity());
+    for (int64_t dim : {0, 1, 2, -1}) {
+        INFO(dim);
+        Tensor fused = FusedNormalization::softmax(x, dim, false);
+        CHECK(torch::allclose(fused, torch::softmax(x, dim), 1e-5, 1e-7));
+    }
+    CHECK(torch::allclose(FusedNormalization::softmax(x.transpose(0, 2), 1, false),
+                          torch::softmax(x.transpose(0, 2), 1), 1e-5, 1e-7));
+
+    // Owned values are overwritten; others are left alone
+    Tensor owned = x.clone();
+    Tensor result = FusedNormalization::softmax(owned, 2, true);
+    CHECK(result.data_ptr() == owned.data_ptr());
+    Tensor kept = x.clone();
+    FusedNormalization::softmax(kept, 2, false);
+    CHECK(torch::equal(kept, x));
+
+    std::string code = R"(
+        X = [[1.0, -2.0, 0.5], [3.0, 4.0, -1.0]]
+        W = [[0.5, 1.0], [-1.0, 2.0], [0.25, 0.0]]
+        Y[i, j.] = X[i, k] W[k, j]
+        Z[i., j] = X[i, j]
+    )";
+    auto run = [&](const char* name) {
+        std::ostringstream out, err;
+        TensorLogicVM vm(&out, &err);
+        vm.execute(tl::parseProgram(code));
+        CHECK(torch::equal(vm.env().lookup("X"), torch::tensor({{1.0f, -2.0f, 0.5f}, {3.0f, 4.0f, -1.0f}})));
+        return vm.env().lookup(name);
+    };
+    for (const char* name : {"Y", "Z"}) {
+        Tensor fused = run(name);
+        Tensor unfused;
+        {
+            NormalizationFusionDisabled guard;
+            unfused = run(name);
+        }
+        INFO(name);
+        CHECK(torch::allclose(fused, unfused, 1e-5, 1e-7));
+    }
+}
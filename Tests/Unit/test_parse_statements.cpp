@@ -91,3 +91,23 @@ TEST_CASE("Datalog rules: simple and mixed neurosymbolic condition") {
         CHECK(first(p) == "Similar(x,y) <- Emb[x,d]Emb[y,d] > threshold");
     }
 }
+
+TEST_CASE("Parsed programs outlive their source buffer") {
+    Program p;
+    {
+        std::string source = "W = [[0.5, 1.25], [3e2, .5]]\n"
+                             "file(\"a\\\"b.txt\") = W[i, j]\n"
+                             "'plain.txt' = W[i, j]\n";
+        p = parseProgram(source);
+        source.assign(source.size(), 'x');
+    }
+    REQUIRE(p.statements.size() == 3);
+    CHECK(first(p) == "W = [[0.5,1.25],[3e2,.5]]");
+    CHECK(std::get<FileOperation>(p.statements[1]).file.text == "a\"b.txt");
+    CHECK(std::get<FileOperation>(p.statements[2]).file.text == "plain.txt");
+
+    // Nodes stay valid in copies after the parse and its other nodes are gone
+    ExprPtr kept = std::get<TensorEquation>(p.statements[0]).clauses[0].expr;
+    p = Program{};
+    CHECK(toString(*kept) == "[[0.5,1.25],[3e2,.5]]");
+}
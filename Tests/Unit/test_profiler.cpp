@@ -0,0 +1,72 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Parser.hpp"
+#include "TL/vm.hpp"
+#include <sstream>
+
+using namespace tl;
+
+TEST_CASE("Profiler records statements, rules and epochs", "[profiler]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    Profiler profiler;
+    vm.setProfiler(&profiler);
+    vm.execute(parseProgram(R"(
+        W = [[1.0, 2.0, 3.0], [4.0, 5.0, 6.0]]
+        X = [1.0, 0.5, 2.0]
+        Y[i] = W[i, j] X[j]
+        Y?
+        Parent(Alice, Bob)
+        Parent(Bob, Charlie)
+        Ancestor(x, y) <- Parent(x, y)
+        Ancestor(x, z) <- Ancestor(x, y), Parent(y, z)
+        Ancestor(x, y)?
+        w = [0.0]
+        loss = (w[0] - 1.0)^2
+        loss? @minimize(lr=0.1, epochs=3)
+    )"));
+
+    const auto statements = profiler.statements();
+    const Profiler::StatementStats* y = nullptr;
+    for (const auto& s : statements) {
+        CHECK(s.runs == 1);
+        if (s.label.rfind("Y[i]", 0) == 0) y = &s;
+    }
+    REQUIRE(y != nullptr);
+    CHECK_FALSE(y->executor.empty());
+    CHECK(y->executor != "equation");
+    REQUIRE(y->inputs.size() == 2);
+    CHECK(y->inputs[0] == Profiler::Shape{2, 3});
+    CHECK(y->inputs[1] == Profiler::Shape{3});
+    CHECK(y->output == Profiler::Shape{2});
+    CHECK(y->bytes == 2 * sizeof(float));
+    CHECK(y->flops == 2.0 * 2 * 3);  // j is summed out over i x j
+
+    size_t derived = 0, joins = 0;
+    for (const auto& r : profiler.rules()) {
+        if (r.label.rfind("Ancestor", 0) == 0) {
+            derived += r.derived;
+            joins += r.joins;
+        }
+    }
+    CHECK(derived == 3);
+    CHECK(joins >= 2);
+
+    const auto epochs = profiler.epochs();
+    REQUIRE(epochs.size() == 3);
+    CHECK(epochs.front().target == "loss");
+    CHECK(epochs.back().epoch == 2);
+    CHECK(epochs.back().batches == 1);
+
+    std::ostringstream summary, trace;
+    profiler.summary(summary);
+    CHECK(summary.str().find("Y[i]") != std::string::npos);
+    CHECK(summary.str().find("Epochs:") != std::string::npos);
+    profiler.writeChromeTrace(trace);
+    CHECK(trace.str().rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0) == 0);
+    CHECK(trace.str().find("\"cat\":\"datalog\"") != std::string::npos);
+    CHECK(trace.str().find("\"cat\":\"learning\"") != std::string::npos);
+
+    profiler.clear();
+    CHECK(profiler.statements().empty());
+    CHECK(profiler.events().empty());
+}
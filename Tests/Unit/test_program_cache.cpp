@@ -0,0 +1,83 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Parser.hpp"
+#include "TL/ProgramCache.hpp"
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+using namespace tl;
+namespace fs = std::filesystem;
+
+static fs::path scratch(const std::string& name) {
+    const fs::path dir = fs::temp_directory_path() / "tl_program_cache";
+    fs::create_directories(dir);
+    return dir / name;
+}
+
+static void writeSource(const fs::path& path, const std::string& text) {
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    ofs << text;
+}
+
+static const char* kProgram =
+    "W = [[1, 2], [3, 4]]\n"
+    "Y[i,k] = relu(W[i,j] X[j,k]) + -b[i]\n"
+    "Z[i] = X[i, 1:3:2] : (X[i,0] > 0.5) | 0.0 : (not X[i,0] > 0.5)\n"
+    "State[*t+1] = State[*t] * 0.9\n"
+    "Emb = file(\"emb\\t.tlt\")\n"
+    "Parent(Alice, Bob)\n"
+    "Ancestor(x, z) <- Parent(x, y), Ancestor(y, z), not Blocked(x), y != z\n"
+    "Ancestor(Alice, x)?\n"
+    "Loss? @minimize(lr=0.01, epochs=3, optimizer=\"adam\", shuffle=true)\n";
+
+TEST_CASE("Serialized programs decode to the same statements", "[cache]") {
+    const Program p = parseProgram(kProgram);
+    const std::string bytes = serializeProgram(p);
+    const Program q = deserializeProgram(bytes);
+    REQUIRE(q.statements.size() == p.statements.size());
+    for (size_t i = 0; i < p.statements.size(); ++i) {
+        CHECK(toString(q.statements[i]) == toString(p.statements[i]));
+    }
+    CHECK(serializeProgram(q) == bytes);
+
+    // Locations survive, so errors from a cached program still point at the source
+    const auto& eq = std::get<TensorEquation>(q.statements[1]);
+    CHECK(eq.loc.line == 2);
+    CHECK(eq.clauses.front().expr->loc.line == 2);
+
+    CHECK_THROWS_AS(deserializeProgram(bytes.substr(0, bytes.size() - 1)), std::runtime_error);
+    CHECK_THROWS_AS(deserializeProgram(bytes + "x"), std::runtime_error);
+}
+
+TEST_CASE("loadProgram reuses the cache until the source changes", "[cache]") {
+    const fs::path src = scratch("model.tl");
+    const fs::path cache = programCachePath(src.string());
+    fs::remove(cache);
+    writeSource(src, "Y[i] = X[i] + 1\n");
+
+    bool hit = true;
+    Program p = loadProgram(src.string(), &hit);
+    CHECK_FALSE(hit);
+    REQUIRE(fs::exists(cache));
+    CHECK(toString(p.statements.front()) == "Y[i] = X[i]+1");
+
+    p = loadProgram(src.string(), &hit);
+    CHECK(hit);
+    CHECK(toString(p.statements.front()) == "Y[i] = X[i]+1");
+
+    writeSource(src, "Y[i] = X[i] + 2\n");
+    p = loadProgram(src.string(), &hit);
+    CHECK_FALSE(hit);
+    CHECK(toString(p.statements.front()) == "Y[i] = X[i]+2");
+
+    // A damaged cache is ignored and replaced
+    writeSource(cache, "TLC1 not a cache");
+    p = loadProgram(src.string(), &hit);
+    CHECK_FALSE(hit);
+    CHECK(toString(p.statements.front()) == "Y[i] = X[i]+2");
+    loadProgram(src.string(), &hit);
+    CHECK(hit);
+
+    CHECK_THROWS_AS(loadProgram(scratch("missing.tl").string()), ParseError);
+}
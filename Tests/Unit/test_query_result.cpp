@@ -0,0 +1,122 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Parser.hpp"
+#include "TL/Runtime/QueryResult.hpp"
+#include "TL/Runtime/RelationIO.hpp"
+#include "TL/Runtime/TensorIO.hpp"
+#include "TL/vm.hpp"
+#include <filesystem>
+#include <sstream>
+
+using namespace tl;
+
+namespace {
+Query queryOf(const std::string& text) {
+    return std::get<Query>(parseProgram(text).statements.front());
+}
+}
+
+TEST_CASE("Query results come back as columns and tensors", "[query]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(R"(
+        Parent(Alice, Bob)
+        Parent(Bob, Charlie)
+        Parent(Bob, Dana)
+        Ancestor(x, y) <- Parent(x, y)
+        Ancestor(x, z) <- Ancestor(x, y), Parent(y, z)
+        W = [[1.0, 2.0], [3.0, 4.0]]
+    )"));
+    const SymbolTable& symbols = vm.env().symbols();
+
+    const QueryResult children = vm.query(queryOf("Parent(Bob, c)?"));
+    REQUIRE_FALSE(children.isTensor());
+    REQUIRE(children.variables == std::vector<std::string>{"c"});
+    REQUIRE(children.rows == 2);
+    CHECK(symbols.name(children.columns[0][0]) == "Charlie");
+    CHECK(symbols.name(children.columns[0][1]) == "Dana");
+
+    // The query saturates the rules first
+    const QueryResult ancestors = vm.query(queryOf("Ancestor(Alice, d)?"));
+    CHECK(ancestors.rows == 3);
+
+    std::ostringstream text;
+    query_io::writeText(text, children, symbols);
+    CHECK(text.str() == "Charlie\nDana\n");
+    text.str("");
+    query_io::writeText(text, vm.query(queryOf("Parent(Dana, x)?")), symbols);
+    CHECK(text.str() == "None\n");
+    text.str("");
+    query_io::writeText(text, vm.query(queryOf("Parent(Alice, Bob)?")), symbols);
+    CHECK(text.str() == "True\n");
+
+    const QueryResult element = vm.query(queryOf("W[1, 0]?"));
+    REQUIRE(element.isTensor());
+    CHECK(element.indices == std::vector<int64_t>{1, 0});
+    CHECK(element.tensor.item<float>() == 3.0f);
+    text.str("");
+    query_io::writeText(text, element, symbols);
+    CHECK(text.str() == "W[1,0] = 3\n");
+
+    const QueryResult whole = vm.query(queryOf("W?"));
+    CHECK(whole.indices.empty());
+    CHECK(whole.tensor.sizes() == torch::IntArrayRef{2, 2});
+
+    // Binary columnar and tensor files read back without parsing text
+    const auto dir = std::filesystem::temp_directory_path() / "tl_query_result_test";
+    std::filesystem::remove_all(dir);
+    query_io::write(dir / "ancestors.tlr", ancestors, symbols);
+    SymbolTable readSymbols;
+    std::vector<std::string> names;
+    const size_t tuples = relation_io::read(dir / "ancestors.tlr", readSymbols,
+        [&](size_t arity, const SymbolId* ids, size_t count) {
+            for (size_t i = 0; i < arity * count; ++i) names.push_back(readSymbols.name(ids[i]));
+        });
+    CHECK(tuples == 3);
+    CHECK(names == std::vector<std::string>{"Bob", "Charlie", "Dana"});
+    query_io::write(dir / "w.tlt", whole, symbols);
+    CHECK(torch::equal(tensor_io::read(dir / "w.tlt"), whole.tensor));
+    CHECK_THROWS_AS(query_io::write(dir / "ground.tlr", vm.query(queryOf("Parent(Alice, Bob)?")), symbols),
+                    std::runtime_error);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Query modifiers bound the answers", "[query]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(R"(
+        Parent(Alice, Bob)
+        Parent(Bob, Charlie)
+        Parent(Bob, Dana)
+        Parent(Dana, Eve)
+        Ancestor(x, y) <- Parent(x, y)
+        Ancestor(x, z) <- Ancestor(x, y), Parent(y, z)
+        Scores = [[0.1, 0.9, 0.4], [0.7, 0.2, 0.8]]
+    )"));
+
+    const Query limited = queryOf("Ancestor(Alice, d)? @limit(n=2)");
+    REQUIRE(limited.modifiers.limit == 2u);
+    CHECK_FALSE(limited.directive.has_value());
+    CHECK(vm.query(limited).rows == 2);
+    CHECK(vm.query(queryOf("Ancestor(Alice, d)? @limit(n=0)")).rows == 0);
+    CHECK(vm.query(queryOf("Ancestor(Alice, d)?")).rows == 4);
+
+    const QueryResult some = vm.query(queryOf("Ancestor(x, Eve)? @exists()"));
+    CHECK(some.variables.empty());
+    CHECK(some.rows == 1);
+    CHECK(vm.query(queryOf("Ancestor(Eve, x)? @exists()")).rows == 0);
+
+    const QueryResult best = vm.query(queryOf("Scores? @topk(k=2)"));
+    REQUIRE(best.tensor.sizes() == torch::IntArrayRef{2, 2});
+    CHECK(torch::allclose(best.tensor, torch::tensor({{0.9f, 0.4f}, {0.8f, 0.7f}})));
+    CHECK(torch::equal(best.positions, torch::tensor({{1, 2}, {2, 0}}, torch::kLong)));
+
+    const QueryResult first = vm.query(queryOf("Scores? @topk(k=1) @limit(n=1)"));
+    CHECK(first.tensor.sizes() == torch::IntArrayRef{1, 1});
+    CHECK(first.positions.item<int64_t>() == 1);
+    CHECK(vm.query(queryOf("Scores? @limit(n=5)")).tensor.size(0) == 2);
+
+    CHECK_THROWS_AS(vm.query(queryOf("Ancestor(Alice, d)? @topk(k=1)")), std::invalid_argument);
+    CHECK_THROWS_AS(vm.query(queryOf("Scores? @exists()")), std::invalid_argument);
+    CHECK_THROWS_AS(queryOf("Scores? @limit(n=1.5)"), ParseError);
+    CHECK_THROWS_AS(queryOf("Scores? @limit(k=1)"), ParseError);
+}
@@ -0,0 +1,164 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Parser.hpp"
+#include "TL/vm.hpp"
+#include "TL/Runtime/RelationIO.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace tl;
+namespace fs = std::filesystem;
+
+static fs::path scratch(const std::string& name) {
+    const fs::path dir = fs::temp_directory_path() / "tl_relation_io";
+    fs::create_directories(dir);
+    return dir / name;
+}
+
+static void writeFile(const fs::path& path, const std::string& text) {
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << text;
+}
+
+// Reads a relation file into a fresh Environment and returns its sorted, comma-joined tuples
+static std::vector<std::string> loadSorted(const fs::path& path, size_t threads = 0) {
+    Environment env;
+    relation_io::read(path, env.symbols(), [&](size_t arity, const SymbolId* tuples, size_t count) {
+        env.addFacts("R", arity, tuples, count);
+    }, threads);
+    std::vector<std::string> rows;
+    for (const auto& fact : env.facts("R")) {
+        std::string row;
+        for (size_t i = 0; i < fact.size(); ++i) {
+            if (i) row += ",";
+            row += fact[i];
+        }
+        rows.push_back(row);
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+TEST_CASE("Relation files are chosen by extension", "[io][relation]") {
+    CHECK(relation_io::isRelationFile("edges.tsv"));
+    CHECK(relation_io::isRelationFile("/data/Parent.FACTS"));
+    CHECK(relation_io::isRelationFile("graph.tlr"));
+    CHECK_FALSE(relation_io::isRelationFile("values.csv"));
+    CHECK_FALSE(relation_io::isRelationFile("weights.tlt"));
+}
+
+TEST_CASE("Text relation files skip comments and separate by tab or comma", "[io][relation]") {
+    const std::vector<std::string> expected = {"alice,bob", "bob,carol", "carol,dave dan"};
+
+    const fs::path tsv = scratch("edges.tsv");
+    writeFile(tsv, "# parent edges\n"
+                   "alice\tbob\n"
+                   "\n"
+                   "bob\tcarol\r\n"
+                   "carol\t\"dave dan\"\n"
+                   "alice\tbob\n");
+    CHECK(loadSorted(tsv) == expected);
+
+    const fs::path facts = scratch("edges.facts");
+    writeFile(facts, "alice, bob\nbob,carol\ncarol,\"dave dan\"");
+    CHECK(loadSorted(facts) == expected);
+
+    const fs::path empty = scratch("empty.tsv");
+    writeFile(empty, "# nothing yet\n\n");
+    CHECK(loadSorted(empty).empty());
+}
+
+TEST_CASE("Large relation files load the same on any thread count", "[io][relation]") {
+    const fs::path path = scratch("large.tsv");
+    {
+        std::ofstream ofs(path);
+        for (int i = 0; i < 200000; ++i) {
+            ofs << "n" << i % 5000 << "\tn" << (i * 7) % 5000 << "\n";
+        }
+    }
+    const std::vector<std::string> serial = loadSorted(path, 1);
+    CHECK(loadSorted(path, 8) == serial);
+
+    // Count tuples and distinct symbols as delivered to the sink
+    SymbolTable symbols;
+    size_t delivered = 0;
+    const size_t read = relation_io::read(path, symbols, [&](size_t arity, const SymbolId*, size_t count) {
+        CHECK(arity == 2);
+        delivered += count;
+    });
+    CHECK(read == 200000);
+    CHECK(delivered == 200000);
+    CHECK(symbols.size() == 5000);
+}
+
+TEST_CASE("Relation files with mixed arities are rejected", "[io][relation]") {
+    const fs::path path = scratch("mixed.tsv");
+    writeFile(path, "a\tb\nc\td\te\n");
+    SymbolTable symbols;
+    CHECK_THROWS_AS(relation_io::read(path, symbols, [](size_t, const SymbolId*, size_t) {}),
+                    std::runtime_error);
+    CHECK_THROWS_AS(relation_io::read(scratch("missing.tsv"), symbols, [](size_t, const SymbolId*, size_t) {}),
+                    std::runtime_error);
+}
+
+TEST_CASE("Columnar relation files round-trip", "[io][relation]") {
+    Environment env;
+    const std::vector<std::vector<std::string>> tuples = {
+        {"alice", "bob", "1"}, {"bob", "carol", "2"}, {"alice", "carol", "2"}};
+    std::vector<SymbolId> packed;
+    for (const auto& t : tuples) {
+        for (const auto& field : t) packed.push_back(env.symbols().intern(field));
+    }
+    env.addFacts("R", 3, packed.data(), tuples.size());
+    const Relation* rel = env.relation("R");
+    REQUIRE(rel != nullptr);
+
+    const std::vector<std::string> expected = {"alice,bob,1", "alice,carol,2", "bob,carol,2"};
+    for (const char* name : {"rel.tlr", "rel.tsv"}) {
+        INFO(name);
+        const fs::path path = scratch(name);
+        relation_io::write(path, *rel, env.symbols());
+        CHECK(loadSorted(path) == expected);
+    }
+
+    // A file cut short is reported, not read partially
+    const fs::path whole = scratch("rel.tlr");
+    const fs::path cut = scratch("cut.tlr");
+    fs::copy_file(whole, cut, fs::copy_options::overwrite_existing);
+    fs::resize_file(cut, fs::file_size(whole) - 4);
+    SymbolTable symbols;
+    CHECK_THROWS_AS(relation_io::read(cut, symbols, [](size_t, const SymbolId*, size_t) {}), std::runtime_error);
+}
+
+TEST_CASE("Programs bind Datalog relations to files", "[io][relation][program]") {
+    const fs::path edges = scratch("program_edges.tsv");
+    writeFile(edges, "a\tb\nb\tc\nc\td\n");
+    const fs::path paths = scratch("program_paths.tlr");
+    const std::string rules = "Path(x, y) <- Edge(x, y)\n"
+                              "Path(x, z) <- Edge(x, y), Path(y, z)\n"
+                              "Path(a, d)?\n";
+
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram("Edge = file(\"" + edges.string() + "\")\n" + rules +
+                            "file(\"" + paths.string() + "\") = Path\n"));
+
+    std::stringstream inlineOut, inlineErr;
+    TensorLogicVM inlineVm{&inlineOut, &inlineErr};
+    inlineVm.execute(parseProgram("Edge(a, b)\nEdge(b, c)\nEdge(c, d)\n" + rules));
+    CHECK(out.str() == inlineOut.str());
+    CHECK(vm.env().facts("Path").size() == 6);
+
+    // The written closure reads back as the same six tuples
+    Environment env;
+    relation_io::read(paths, env.symbols(), [&](size_t arity, const SymbolId* tuples, size_t count) {
+        env.addFacts("Path", arity, tuples, count);
+    });
+    CHECK(env.facts("Path").size() == 6);
+
+    CHECK_THROWS_AS(vm.execute(parseProgram("Edge[i] = file(\"" + edges.string() + "\")\n")), std::runtime_error);
+}
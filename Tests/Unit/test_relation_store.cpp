@@ -0,0 +1,184 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Runtime/RelationStore.hpp"
+#include "TL/vm.hpp"
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace tl;
+
+TEST_CASE("SymbolTable assigns dense stable IDs", "[datalog][store]") {
+    SymbolTable symbols;
+    const SymbolId alice = symbols.intern("Alice");
+    const SymbolId bob = symbols.intern("Bob");
+
+    REQUIRE(alice == 0);
+    REQUIRE(bob == 1);
+    REQUIRE(symbols.intern("Alice") == alice);
+    REQUIRE(symbols.size() == 2);
+    REQUIRE(symbols.name(bob) == "Bob");
+
+    SymbolId id = 0;
+    REQUIRE(symbols.lookup("Bob", id));
+    REQUIRE(id == bob);
+    REQUIRE_FALSE(symbols.lookup("Charlie", id));
+}
+
+TEST_CASE("SymbolTable extends a base table without copying it", "[datalog][store]") {
+    SymbolTable base;
+    const SymbolId alice = base.intern("Alice");
+    base.intern("2.5");
+
+    SymbolTable local = SymbolTable::extending(base);
+    REQUIRE(local.size() == 2);
+    REQUIRE(local.intern("Alice") == alice);
+    const SymbolId carol = local.intern("Carol");
+    REQUIRE(carol == 2);
+    REQUIRE(local.name(carol) == "Carol");
+    double value = 0.0;
+    REQUIRE(local.number(1, value));
+    REQUIRE(value == 2.5);
+
+    // Symbols the base gains later stay out of the extension
+    const SymbolId dave = base.intern("Dave");
+    REQUIRE(dave == 2);
+    REQUIRE(local.intern("Dave") == 3);
+    REQUIRE(local.name(carol) == "Carol");
+    SymbolId id = 0;
+    REQUIRE_FALSE(base.lookup("Carol", id));
+}
+
+TEST_CASE("Relation packs tuples and rejects duplicates", "[datalog][store]") {
+    Relation rel(2);
+    size_t inserted = 0;
+    for (SymbolId i = 0; i < 5000; ++i) {
+        const SymbolId tuple[2] = {i, i + 1};
+        if (rel.insert(tuple)) ++inserted;
+    }
+    REQUIRE(inserted == 5000);
+    REQUIRE(rel.size() == 5000);
+
+    // Re-inserting every tuple is a no-op
+    size_t reinserted = 0;
+    for (SymbolId i = 0; i < 5000; ++i) {
+        const SymbolId tuple[2] = {i, i + 1};
+        if (rel.insert(tuple)) ++reinserted;
+    }
+    REQUIRE(reinserted == 0);
+    REQUIRE(rel.size() == 5000);
+
+    // Rows keep insertion order
+    REQUIRE(rel.row(1234)[0] == 1234);
+    REQUIRE(rel.row(1234)[1] == 1235);
+
+    const SymbolId present[2] = {42, 43};
+    const SymbolId absent[2] = {43, 42};
+    REQUIRE(rel.contains(present));
+    REQUIRE_FALSE(rel.contains(absent));
+
+    rel.clear();
+    REQUIRE(rel.empty());
+    REQUIRE_FALSE(rel.contains(present));
+    REQUIRE(rel.insert(present));
+}
+
+TEST_CASE("Environment exposes interned relations through facts()", "[datalog][store]") {
+    Environment env;
+    REQUIRE(env.addFact("Parent", std::vector<std::string>{"Alice", "Bob"}));
+    REQUIRE_FALSE(env.addFact("Parent", std::vector<std::string>{"Alice", "Bob"}));
+
+    const auto& before = env.facts("Parent");
+    REQUIRE(before.size() == 1);
+    REQUIRE(before[0] == std::vector<std::string>{"Alice", "Bob"});
+
+    // The string view catches up with tuples inserted after it was built
+    REQUIRE(env.addFact("Parent", std::vector<std::string>{"Bob", "Charlie"}));
+    const auto& after = env.facts("Parent");
+    REQUIRE(after.size() == 2);
+    REQUIRE(after[1] == std::vector<std::string>{"Bob", "Charlie"});
+
+    const Relation* rel = env.relation("Parent");
+    REQUIRE(rel != nullptr);
+    REQUIRE(rel->arity() == 2);
+    REQUIRE(env.symbols().name(rel->row(1)[1]) == "Charlie");
+
+    REQUIRE(env.facts("Missing").empty());
+    REQUIRE_THROWS_AS(env.addFact("Parent", std::vector<std::string>{"Alice"}), std::runtime_error);
+}
+
+TEST_CASE("Relation indexes bound columns and keeps them current", "[datalog][store][index]") {
+    Relation rel(2);
+    for (SymbolId i = 0; i < 100; ++i) {
+        const SymbolId tuple[2] = {i % 10, i};
+        rel.insert(tuple);
+    }
+    REQUIRE(rel.indexCount() == 0);
+
+    // Probe on column 0: rows whose first value is 3
+    const Relation::ColumnMask firstColumn = 1;
+    const SymbolId key[2] = {3, 0};
+    const Relation::RowList* rows = rel.probe(firstColumn, key);
+    REQUIRE(rows != nullptr);
+    REQUIRE(rel.indexCount() == 1);
+    size_t matches = 0;
+    for (uint32_t r : *rows) {
+        if (rel.row(r)[0] == 3) ++matches;
+    }
+    REQUIRE(matches == 10);
+
+    // Inserting extends the existing index instead of rebuilding it
+    const SymbolId extra[2] = {3, 1000};
+    REQUIRE(rel.insert(extra));
+    rows = rel.probe(firstColumn, key);
+    REQUIRE(rows != nullptr);
+    REQUIRE(rows->back() == rel.size() - 1);
+    REQUIRE(rel.indexCount() == 1);
+
+    // A key no tuple has yields no candidates
+    const SymbolId missing[2] = {77, 0};
+    const Relation::RowList* none = rel.probe(firstColumn, missing);
+    if (none) {
+        for (uint32_t r : *none) REQUIRE(rel.row(r)[0] != 77);
+    }
+
+    rel.clear();
+    REQUIRE(rel.indexCount() == 0);
+}
+
+TEST_CASE("Relation bulk inserts skip duplicates and extend indexes", "[datalog][store][bulk]") {
+    Relation rel(2);
+    const SymbolId seed[2] = {1, 101};
+    REQUIRE(rel.insert(seed));
+
+    const Relation::ColumnMask firstColumn = 1;
+    const SymbolId key[2] = {1, 0};
+    REQUIRE(rel.probe(firstColumn, key) != nullptr);
+
+    // Tuples repeat within the batch and against the stored seed
+    std::vector<SymbolId> batch;
+    for (SymbolId i = 0; i < 3000; ++i) {
+        batch.push_back(i % 1000);
+        batch.push_back(100 + i % 1000);
+    }
+    REQUIRE(rel.insertBulk(batch.data(), 3000) == 999);
+    REQUIRE(rel.size() == 1000);
+    REQUIRE(rel.insertBulk(batch.data(), 3000) == 0);
+    REQUIRE(rel.insertBulk(nullptr, 0) == 0);
+
+    // New rows keep first-occurrence order
+    REQUIRE(rel.row(1)[0] == 0);
+    REQUIRE(rel.row(2)[0] == 2);
+    const SymbolId present[2] = {999, 1099};
+    REQUIRE(rel.contains(present));
+
+    // The index built before the load sees the new rows
+    const SymbolId seven[2] = {7, 0};
+    const Relation::RowList* rows = rel.probe(firstColumn, seven);
+    REQUIRE(rows != nullptr);
+    size_t matches = 0;
+    for (uint32_t r : *rows) {
+        if (rel.row(r)[0] == 7) ++matches;
+    }
+    REQUIRE(matches == 1);
+    REQUIRE(rel.indexCount() == 1);
+}
@@ -257,3 +257,28 @@ TEST_CASE("Slice with start::step (omit end)", "[slice][step]") {
     REQUIRE_THAT(getTensorValue(Y, {3}), WithinAbs(8.0f, 0.001f));
     REQUIRE_THAT(getTensorValue(Y, {4}), WithinAbs(10.0f, 0.001f));
 }
+
+TEST_CASE("Slices are views and writes copy only shared storage", "[slice][assign]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(R"(
+        X = [1, 2, 3, 4, 5]
+        Y = X[1:4]
+        Z = X
+        U = [0.0, 0.0, 0.0]
+    )"));
+    CHECK(vm.env().lookup("Y").storage().is_alias_of(vm.env().lookup("X").storage()));
+
+    // A uniquely owned destination is written in place
+    const void* before = vm.env().lookup("U").data_ptr();
+    vm.execute(parseProgram("U[1] = 5.0"));
+    CHECK(vm.env().lookup("U").data_ptr() == before);
+    REQUIRE_THAT(getTensorValue(vm.env().lookup("U"), {1}), WithinAbs(5.0f, 0.001f));
+
+    // Z shares X's storage, so writing it copies first
+    vm.execute(parseProgram("Z[0] = 9.0"));
+    REQUIRE_THAT(getTensorValue(vm.env().lookup("Z"), {0}), WithinAbs(9.0f, 0.001f));
+    REQUIRE_THAT(getTensorValue(vm.env().lookup("X"), {0}), WithinAbs(1.0f, 0.001f));
+    REQUIRE_THAT(getTensorValue(vm.env().lookup("Y"), {0}), WithinAbs(2.0f, 0.001f));
+    CHECK_FALSE(vm.env().lookup("Z").storage().is_alias_of(vm.env().lookup("X").storage()));
+}
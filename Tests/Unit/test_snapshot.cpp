@@ -0,0 +1,87 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Parser.hpp"
+#include "TL/vm.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace tl;
+namespace fs = std::filesystem;
+
+namespace {
+Query queryOf(const std::string& text) {
+    return std::get<Query>(parseProgram(text).statements.front());
+}
+
+std::vector<std::string> answers(TensorLogicVM& vm, const std::string& query) {
+    const QueryResult result = vm.query(queryOf(query));
+    std::vector<std::string> names;
+    for (size_t r = 0; r < result.rows; ++r) names.push_back(vm.env().symbols().name(result.columns[0][r]));
+    std::sort(names.begin(), names.end());
+    return names;
+}
+}
+
+TEST_CASE("Snapshots restore tensors, relations and the closure", "[snapshot]") {
+    const fs::path dir = fs::temp_directory_path() / "tl_snapshot_test";
+    fs::remove_all(dir);
+    const fs::path path = dir / "state.tls";
+
+    std::stringstream out, err;
+    TensorLogicVM saved{&out, &err};
+    saved.execute(parseProgram(R"(
+        Parent(Alice, Bob)
+        Parent(Bob, Charlie)
+        Ancestor(x, y) <- Parent(x, y)
+        Ancestor(x, z) <- Ancestor(x, y), Parent(y, z)
+        W = [[1.0, 2.0], [3.0, 4.0]]
+        Count = 3
+        Score[Alice] = 0.5
+        Ancestor(Alice, x)?
+    )"));
+    REQUIRE_FALSE(saved.datalog().needsSaturation());
+    saved.saveSnapshot(path);
+
+    TensorLogicVM restored{&out, &err};
+    restored.execute(parseProgram("Stale = [1.0]\nOther(Eve)\n"));
+    restored.loadSnapshot(path);
+
+    CHECK_FALSE(restored.env().has("Stale"));
+    CHECK_FALSE(restored.env().hasRelation("Other"));
+    CHECK(torch::equal(restored.env().lookup("W"), saved.env().lookup("W")));
+    CHECK(restored.env().lookup("Count").item<float>() == 3.0f);
+    int alice = -1;
+    REQUIRE(restored.env().getLabelIndex("Alice", alice));
+    CHECK(restored.env().lookup("Score")[alice].item<float>() == 0.5f);
+    int bob = -1;
+    CHECK_FALSE(restored.env().getLabelIndex("Bob", bob));  // only a Datalog constant
+
+    // Symbols keep their IDs and the closure is not recomputed
+    CHECK(restored.env().symbols().size() == saved.env().symbols().size());
+    CHECK(restored.env().relation("Ancestor")->size() == 3);
+    CHECK(restored.env().relation("Ancestor")->indexCount() == saved.env().relation("Ancestor")->indexCount());
+    CHECK_FALSE(restored.datalog().needsSaturation());
+    CHECK(restored.datalog().rules().size() == 2);
+    CHECK(answers(restored, "Ancestor(Alice, x)?") == std::vector<std::string>{"Bob", "Charlie"});
+
+    // New facts extend the restored closure
+    restored.execute(parseProgram("Parent(Charlie, Dana)\n"));
+    CHECK(answers(restored, "Ancestor(Alice, x)?") == std::vector<std::string>{"Bob", "Charlie", "Dana"});
+
+    // Restored tensors are copy-on-write views of the file
+    restored.execute(parseProgram("W[0, 0] = 10.0\n"));
+    TensorLogicVM again{&out, &err};
+    again.loadSnapshot(path);
+    CHECK(again.env().lookup("W")[0][0].item<float>() == 1.0f);
+
+    // A malformed file leaves the environment as it was
+    {
+        std::ofstream ofs(dir / "broken.tls", std::ios::binary);
+        ofs << "TLS1 not a snapshot";
+    }
+    CHECK_THROWS_AS(again.loadSnapshot(dir / "broken.tls"), std::runtime_error);
+    CHECK(again.env().has("W"));
+    CHECK_THROWS_AS(again.loadSnapshot(dir / "missing.tls"), std::runtime_error);
+    fs::remove_all(dir);
+}
@@ -0,0 +1,91 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/backend.hpp"
+#include "TL/vm.hpp"
+
+using namespace tl;
+
+// Random tensor with roughly the given fraction of nonzeros
+static Tensor sparseish(const std::vector<int64_t>& shape, double density) {
+    Tensor values = torch::randn(shape);
+    return values * (torch::rand(shape) < density).to(torch::kFloat32);
+}
+
+TEST_CASE("Sparse backend matches dense einsum", "[backend][sparse]") {
+    torch::manual_seed(7);
+    auto sparse = BackendFactory::create(BackendType::Sparse);
+
+    struct Case { const char* spec; std::vector<int64_t> a; std::vector<int64_t> b; };
+    const std::vector<Case> cases = {
+        {"ij,jk->ik", {6, 5}, {5, 4}},
+        {"ij,ij->ij", {4, 3}, {4, 3}},
+        {"ijk,jl->li", {3, 4, 2}, {4, 5}},
+        {"ij,kl->ik", {3, 4}, {2, 5}},    // d's private axis is summed first
+        {"ab,bc", {4, 3}, {3, 2}},        // implicit output
+        {"ij,j->", {5, 3}, {3}},
+        {"ii,ij->j", {3, 3}, {3, 4}},     // repeated label: dense fallback
+    };
+    for (const auto& c : cases) {
+        INFO(c.spec);
+        Tensor a = sparseish(c.a, 0.3);
+        Tensor b = torch::randn(c.b);
+        Tensor expected = torch::einsum(c.spec, {a, b});
+
+        Tensor lhsSparse = sparse->einsum(c.spec, {a.to_sparse(), b});
+        REQUIRE(lhsSparse.sizes() == expected.sizes());
+        CHECK(torch::allclose(lhsSparse, expected, 1e-4, 1e-5));
+
+        Tensor x = torch::randn(c.a);
+        Tensor y = sparseish(c.b, 0.3);
+        Tensor rhsSparse = sparse->einsum(c.spec, {x, y.to_sparse()});
+        CHECK(torch::allclose(rhsSparse, torch::einsum(c.spec, {x, y}), 1e-4, 1e-5));
+    }
+
+    SECTION("Chains follow the planned order") {
+        Tensor a = sparseish({8, 6}, 0.2);
+        Tensor b = torch::randn({6, 7});
+        Tensor c = torch::randn({7, 3});
+        Tensor r = sparse->einsum("ij,jk,kl->il", {a.to_sparse(), b, c});
+        CHECK(torch::allclose(r, torch::einsum("ij,jk,kl->il", {a, b, c}), 1e-4, 1e-4));
+    }
+}
+
+TEST_CASE("Router picks the sparse backend by density and size", "[backend][sparse]") {
+    SparseRouting routing;
+    routing.maxDensity = 0.05;
+    routing.minElements = 1000;
+    routing.probeDense = true;
+
+    Tensor small = torch::zeros({10, 10});
+    Tensor big = torch::zeros({100, 100});
+    big.index_put_({0, 0}, 1.0f);
+    Tensor dense = torch::ones({100, 100});
+
+    CHECK(BackendRouter::analyze({small, small}, routing) == BackendType::LibTorch);
+    CHECK(BackendRouter::analyze({big, dense}, routing) == BackendType::Sparse);
+    CHECK(BackendRouter::analyze({dense, dense}, routing) == BackendType::LibTorch);
+    CHECK(BackendRouter::analyze({small.to_sparse()}, routing) == BackendType::Sparse);
+    CHECK(BackendRouter::density(big) == 1.0 / 10000.0);
+
+    // Without probing only operands that are already sparse are routed
+    routing.probeDense = false;
+    CHECK(BackendRouter::analyze({big, dense}, routing) == BackendType::LibTorch);
+    CHECK(BackendRouter::analyze({big.to_sparse(), dense}, routing) == BackendType::Sparse);
+    CHECK(BackendRouter::denseToConvert({big, dense}, routing) == std::vector<bool>{false, false});
+}
+
+TEST_CASE("Hybrid backend routes without changing results", "[backend][sparse]") {
+    torch::manual_seed(11);
+    SparseRouting routing;
+    routing.minElements = 1000;
+    routing.probeDense = true;
+    auto hybrid = BackendFactory::createHybrid(BackendFactory::create(BackendType::Sparse),
+                                               BackendFactory::create(BackendType::LibTorch), routing);
+
+    Tensor relation = sparseish({200, 200}, 0.002);
+    Tensor embedding = torch::randn({200, 16});
+    Tensor r = hybrid->einsum("xy,yd->xd", {relation, embedding});
+    CHECK(torch::allclose(r, torch::einsum("xy,yd->xd", {relation, embedding}), 1e-4, 1e-5));
+
+    Tensor x = torch::randn({4, 4});
+    CHECK(torch::allclose(hybrid->einsum("ij,jk->ik", {x, x}), torch::matmul(x, x), 1e-5, 1e-6));
+}
@@ -0,0 +1,324 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Parser.hpp"
+#include "TL/vm.hpp"
+#include "TL/Runtime/AsyncFileIO.hpp"
+#include "TL/Runtime/TensorIO.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace tl;
+namespace fs = std::filesystem;
+
+static fs::path scratch(const std::string& name) {
+    const fs::path dir = fs::temp_directory_path() / "tl_tensor_io";
+    fs::create_directories(dir);
+    return dir / name;
+}
+
+TEST_CASE("Formats follow the file extension", "[io]") {
+    CHECK(tensor_io::formatFor("weights.tlt") == tensor_io::Format::Tlt);
+    CHECK(tensor_io::formatFor("/data/Embeddings.NPY") == tensor_io::Format::Npy);
+    CHECK(tensor_io::formatFor("values.csv") == tensor_io::Format::Text);
+    CHECK(tensor_io::formatFor("values") == tensor_io::Format::Text);
+}
+
+TEST_CASE("Binary tensor files round-trip dtype and shape", "[io]") {
+    const std::vector<Tensor> tensors = {
+        torch::arange(12, torch::kFloat32).reshape({3, 4}),
+        torch::arange(12, torch::kFloat32).reshape({3, 4}).t(),  // written contiguously
+        torch::arange(5, torch::kInt64),
+        torch::tensor(2.5),
+        torch::tensor({true, false, true}),
+        torch::zeros({0, 3}),
+    };
+    for (const char* ext : {".tlt", ".npy"}) {
+        for (size_t i = 0; i < tensors.size(); ++i) {
+            INFO(ext << " tensor " << i);
+            const fs::path path = scratch("roundtrip" + std::to_string(i) + ext);
+            tensor_io::write(path, tensors[i]);
+            Tensor back = tensor_io::read(path);
+            CHECK(back.scalar_type() == tensors[i].scalar_type());
+            REQUIRE(back.sizes() == tensors[i].sizes());
+            CHECK(torch::equal(back, tensors[i]));
+        }
+    }
+
+    SECTION("bf16 has no NumPy encoding") {
+        Tensor half = torch::ones({2}, torch::kBFloat16);
+        tensor_io::write(scratch("half.tlt"), half);
+        CHECK(torch::equal(tensor_io::read(scratch("half.tlt")), half));
+        CHECK_THROWS_AS(tensor_io::write(scratch("half.npy"), half), std::runtime_error);
+    }
+}
+
+TEST_CASE("Mapped tensors never write back to the file", "[io]") {
+    const fs::path path = scratch("mapped.tlt");
+    tensor_io::write(path, torch::ones({4, 4}));
+    {
+        Tensor mapped = tensor_io::read(path);
+        mapped.mul_(3.0);
+        CHECK(mapped.sum().item<float>() == 48.0f);
+    }
+    CHECK(tensor_io::read(path).sum().item<float>() == 16.0f);
+}
+
+TEST_CASE("NumPy files in Fortran order keep their strides", "[io]") {
+    // Column-major 2x3 float32 matrix [[1, 2, 3], [4, 5, 6]]
+    std::string header = "{'descr': '<f4', 'fortran_order': True, 'shape': (2, 3), }";
+    header.append(64 - (10 + header.size() + 1) % 64, ' ');
+    header += '\n';
+    const float data[] = {1, 4, 2, 5, 3, 6};
+    const fs::path path = scratch("fortran.npy");
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        ofs.write("\x93NUMPY\x01\x00", 8);
+        const uint16_t length = static_cast<uint16_t>(header.size());
+        ofs.write(reinterpret_cast<const char*>(&length), 2);
+        ofs << header;
+        ofs.write(reinterpret_cast<const char*>(data), sizeof(data));
+    }
+
+    Tensor t = tensor_io::read(path);
+    REQUIRE(t.sizes() == std::vector<int64_t>{2, 3});
+    CHECK(t.stride(0) == 1);
+    CHECK(t.stride(1) == 2);
+    CHECK(torch::equal(t, torch::tensor({{1.0f, 2.0f, 3.0f}, {4.0f, 5.0f, 6.0f}})));
+}
+
+TEST_CASE("Truncated binary files are rejected", "[io]") {
+    const fs::path path = scratch("truncated.tlt");
+    tensor_io::write(path, torch::ones({16}));
+    fs::resize_file(path, fs::file_size(path) - 8);
+    CHECK_THROWS_AS(tensor_io::read(path), std::runtime_error);
+    CHECK_THROWS_AS(tensor_io::read(scratch("missing.npy")), std::runtime_error);
+}
+
+TEST_CASE("Text tensors parse in parallel chunks", "[io]") {
+    // Several MiB of rows so the file splits into multiple chunks
+    const int64_t rows = 200000;
+    const int64_t cols = 4;
+    const fs::path path = scratch("large.csv");
+    {
+        std::ofstream ofs(path);
+        for (int64_t r = 0; r < rows; ++r) {
+            for (int64_t c = 0; c < cols; ++c) ofs << (c ? ", " : "") << r * cols + c << ".5";
+            ofs << (r % 3 ? "\n" : "\r\n");
+        }
+    }
+    Tensor expected = torch::arange(rows * cols, torch::kFloat32).reshape({rows, cols}) + 0.5;
+    for (size_t threads : {size_t{1}, size_t{4}}) {
+        INFO(threads << " threads");
+        Tensor t = tensor_io::read(path, threads);
+        REQUIRE(t.sizes() == expected.sizes());
+        CHECK(torch::equal(t, expected));
+    }
+
+    SECTION("Blank lines, padding and empty fields") {
+        const fs::path small = scratch("padded.csv");
+        std::ofstream(small) << "\n  1.5,\t-2, +3 \n\n,4e1,\n";
+        CHECK(torch::equal(tensor_io::read(small), torch::tensor({{1.5f, -2.0f, 3.0f}, {0.0f, 40.0f, 0.0f}})));
+        std::ofstream(small) << "1\n 2.25\n";
+        CHECK(torch::equal(tensor_io::read(small), torch::tensor({1.0f, 2.25f})));
+    }
+
+    SECTION("Malformed rows are rejected") {
+        const fs::path bad = scratch("bad.csv");
+        std::ofstream(bad) << "1,2\n3,4,5\n";
+        CHECK_THROWS_AS(tensor_io::read(bad), std::runtime_error);
+        std::ofstream(bad) << "1,2\n3,x\n";
+        CHECK_THROWS_AS(tensor_io::read(bad), std::runtime_error);
+        {
+            std::ofstream ofs(path, std::ios::app);
+            ofs << "1,2\n";
+        }
+        CHECK_THROWS_AS(tensor_io::read(path, 4), std::runtime_error);
+    }
+}
+
+TEST_CASE("Text tensors are written in bulk", "[io]") {
+    std::ostringstream os;
+    tensor_io::format(os, torch::tensor({{0.1f, -2.0f}, {1e-8f, 3.0f}}));
+    CHECK(os.str() == "0.1,-2\n1e-08,3");
+
+    os.str("");
+    tensor_io::format(os, torch::tensor({true, false}));
+    CHECK(os.str() == "1\n0");
+
+    os.str("");
+    tensor_io::format(os, torch::tensor(int64_t{-42}));
+    CHECK(os.str() == "-42");
+
+    SECTION("Files read back exactly") {
+        torch::manual_seed(3);
+        for (const Tensor& t : {torch::randn({300, 7}), torch::randn({1000}) / 3.0}) {
+            const fs::path path = scratch("written.csv");
+            tensor_io::write(path, t);
+            CHECK(torch::equal(tensor_io::read(path), t));
+        }
+    }
+}
+
+TEST_CASE("Programs load and store binary tensors by extension", "[io]") {
+    const fs::path path = scratch("program.tlt");
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(
+        "A = [[1.0, 2.0], [3.0, 4.0]]\n"
+        "file(\"" + path.string() + "\") = A\n"
+        "B = file(\"" + path.string() + "\")\n"
+        "C[i] = B[i, j]\n"));
+    CHECK(torch::equal(vm.env().lookup("B"), vm.env().lookup("A")));
+    CHECK(torch::allclose(vm.env().lookup("C"), torch::tensor({3.0f, 7.0f})));
+
+    vm.execute(parseProgram("B[1, 0]?\n"));
+    CHECK(out.str().find("B[1,0] = 3\n") != std::string::npos);
+}
+
+TEST_CASE("Tensor files are prefetched and written in the background", "[io][async]") {
+    const fs::path input = scratch("async_in.tlt");
+    const fs::path output = scratch("async_out.npy");
+    tensor_io::write(input, torch::tensor({1.0f, 2.0f, 3.0f}));
+
+    SECTION("Background files") {
+        AsyncFileIO io;
+        io.prefetch(input);
+        CHECK(io.pendingReads() == 1);
+        CHECK(torch::equal(io.read(input), torch::tensor({1.0f, 2.0f, 3.0f})));
+        CHECK(io.pendingReads() == 0);
+
+        // Writes of a path stay in order, and reads of it wait for them
+        io.write(output, torch::zeros({2}));
+        io.write(output, torch::ones({4}));
+        io.prefetch(output);
+        CHECK(torch::equal(io.read(output), torch::ones({4})));
+        CHECK(io.pendingWrites() == 2);
+        io.flush();
+        CHECK(io.pendingWrites() == 0);
+
+        io.prefetch(scratch("async_missing.tlt"));
+        CHECK_THROWS_AS(io.read(scratch("async_missing.tlt")), std::runtime_error);
+    }
+
+    for (const bool async : {true, false}) {
+        INFO("async " << async);
+        fs::remove(output);
+        std::stringstream out, err;
+        TensorLogicVM vm{&out, &err};
+        vm.setAsyncFileIO(async);
+        vm.execute(parseProgram("X = file(\"" + input.string() + "\")\n"
+                                "Y[i] = X[i] X[i]\n"
+                                "file(\"" + output.string() + "\") = Y\n"
+                                "Y[0] = 100.0\n"
+                                "Z = file(\"" + output.string() + "\")\n"));
+        // Files are complete when the run returns, with the values at the time of the write
+        CHECK(torch::equal(tensor_io::read(output), torch::tensor({1.0f, 4.0f, 9.0f})));
+        CHECK(torch::equal(vm.env().lookup("Z"), torch::tensor({1.0f, 4.0f, 9.0f})));
+        CHECK(vm.env().lookup("Y")[0].item<float>() == 100.0f);
+    }
+
+    // A failed write fails the run once the statements after it have run
+    const fs::path blocker = scratch("async_blocker");
+    fs::remove_all(blocker);
+    std::ofstream(blocker) << "not a directory";
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    CHECK_THROWS_AS(vm.execute(parseProgram("A = [1.0]\n"
+                                            "file(\"" + (blocker / "a.tlt").string() + "\") = A\n"
+                                            "B = [2.0]\n")),
+                    std::runtime_error);
+    CHECK(vm.env().has("B"));
+}
+
+TEST_CASE("Chunked readers and writers split along the first axis", "[io][stream]") {
+    const Tensor t = torch::arange(30, torch::kFloat32).reshape({10, 3});
+    for (const char* ext : {".tlt", ".npy", ".csv"}) {
+        INFO(ext);
+        const fs::path path = scratch(std::string("chunked") + ext);
+        {
+            tensor_io::ChunkWriter writer(path);
+            for (int64_t start = 0; start < 10; start += 4) writer.append(t.narrow(0, start, std::min<int64_t>(4, 10 - start)));
+            writer.close();
+            CHECK(writer.rows() == 10);
+        }
+        CHECK(torch::equal(tensor_io::read(path), t));
+
+        tensor_io::ChunkReader reader(path, 4);
+        std::vector<Tensor> chunks;
+        while (auto chunk = reader.next()) chunks.push_back(chunk->clone());
+        REQUIRE(chunks.size() == 3);
+        CHECK(chunks.back().size(0) == 2);
+        CHECK(torch::equal(torch::cat(chunks), t));
+    }
+
+    SECTION("Chunks must match the first one") {
+        tensor_io::ChunkWriter writer(scratch("mismatch.npy"));
+        writer.append(torch::ones({2, 3}));
+        CHECK_THROWS_AS(writer.append(torch::ones({2, 4})), std::runtime_error);
+        CHECK_THROWS_AS(writer.append(torch::ones({2, 3}, torch::kInt64)), std::runtime_error);
+        CHECK_THROWS_AS(tensor_io::ChunkReader(scratch("mismatch.npy"), 0), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Streamed bindings run row-wise equations chunk by chunk", "[io][stream]") {
+    torch::manual_seed(5);
+    const Tensor x = torch::randn({50, 3});
+    for (const char* ext : {".npy", ".csv"}) {
+        INFO(ext);
+        const fs::path input = scratch(std::string("stream_input") + ext);
+        const fs::path scores = scratch("stream_scores.npy");
+        tensor_io::write(input, x);
+        const std::string source =
+            "W = [0.5, -1.0, 2.0]\n"
+            "X = file(\"" + input.string() + "\")\n"
+            "Score[b] = sigmoid(X[b, d] W[d])\n"
+            "Total = X[b, d] W[d]\n"
+            "Peak[d] max= X[b, d]\n"
+            "Mass += Score[b]\n"
+            "file(\"" + scores.string() + "\") = Score\n";
+
+        std::stringstream out, err;
+        TensorLogicVM whole{&out, &err};
+        whole.execute(parseProgram(source));
+        const Tensor expectedScores = whole.env().lookup("Score").clone();
+
+        TensorLogicVM streamed{&out, &err};
+        streamed.setStreamRows("X", 7);
+        streamed.execute(parseProgram(source));
+        for (const char* name : {"Total", "Peak", "Mass"}) {
+            INFO(name);
+            CHECK(torch::allclose(streamed.env().lookup(name), whole.env().lookup(name), 1e-4, 1e-5));
+        }
+        CHECK(torch::allclose(tensor_io::read(scores), expectedScores));
+        CHECK_FALSE(streamed.env().has("X"));
+        CHECK_FALSE(streamed.env().has("Score"));
+    }
+
+    SECTION("Bindings without row-wise statements load whole") {
+        const fs::path input = scratch("stream_whole.npy");
+        tensor_io::write(input, x);
+        std::stringstream out, err;
+        TensorLogicVM vm{&out, &err};
+        vm.setStreamRows("X", 7);
+        vm.execute(parseProgram("X = file(\"" + input.string() + "\")\nFirst[d] = X[0, d]\n"));
+        CHECK(torch::equal(vm.env().lookup("X"), x));
+        CHECK(torch::equal(vm.env().lookup("First"), x[0]));
+    }
+
+    SECTION("Files streamed together need the same rows") {
+        const fs::path a = scratch("stream_a.npy");
+        const fs::path b = scratch("stream_b.npy");
+        tensor_io::write(a, torch::ones({10, 2}));
+        tensor_io::write(b, torch::ones({8}));
+        std::stringstream out, err;
+        TensorLogicVM vm{&out, &err};
+        vm.setStreamRows("A", 4);
+        vm.setStreamRows("B", 4);
+        CHECK_THROWS_AS(vm.execute(parseProgram("A = file(\"" + a.string() + "\")\n"
+                                                "B = file(\"" + b.string() + "\")\n"
+                                                "S[n] = A[n, k] B[n]\n")),
+                        std::runtime_error);
+        CHECK_THROWS_AS(vm.setStreamRows("A", -1), std::invalid_argument);
+    }
+}
@@ -232,6 +232,58 @@ TEST_CASE("Label-based indexing", "[tensor][labels]") {
     REQUIRE(W.size(0) >= 3);
 }
 
+TEST_CASE("Label-driven writes grow storage geometrically", "[tensor][labels]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    std::string source;
+    for (int k = 0; k < 100; ++k) {
+        source += "W[Person" + std::to_string(k) + "] = " + std::to_string(k) + ".0\n";
+    }
+    vm.execute(parseProgram(source));
+
+    auto W = vm.env().lookup("W");
+    REQUIRE(W.dim() == 1);
+    REQUIRE(W.size(0) == 100);
+    for (int k = 0; k < 100; ++k) {
+        REQUIRE_THAT(getTensorValue(W, {k}), WithinAbs(static_cast<float>(k), 0.001f));
+    }
+
+    // The bound tensor is a window of storage that doubled as it filled up
+    const auto* growth = vm.env().growthStorage("W");
+    REQUIRE(growth != nullptr);
+    REQUIRE(growth->storage.size(0) == 128);
+    REQUIRE(growth->storage.data_ptr() == W.data_ptr());
+
+    SECTION("Rebinding the name drops the storage") {
+        vm.execute(parseProgram("W = [1.0, 2.0]"));
+        REQUIRE(vm.env().growthStorage("W") == nullptr);
+        vm.execute(parseProgram("W[2] = 3.0"));
+        auto grown = vm.env().lookup("W");
+        REQUIRE(grown.size(0) == 3);
+        REQUIRE_THAT(getTensorValue(grown, {0}), WithinAbs(1.0f, 0.001f));
+        REQUIRE_THAT(getTensorValue(grown, {2}), WithinAbs(3.0f, 0.001f));
+    }
+}
+
+TEST_CASE("Growing a 2D tensor keeps new cells zero", "[tensor][element]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(R"(
+        M[0, 0] = 1.0
+        M[1, 2] = 2.0
+        M[3, 1] = 3.0
+        M[2, 4] = 4.0
+    )"));
+
+    auto M = vm.env().lookup("M");
+    REQUIRE(M.sizes().vec() == std::vector<int64_t>{4, 5});
+    REQUIRE_THAT(M.sum().item<float>(), WithinAbs(10.0f, 0.001f));
+    REQUIRE_THAT(getTensorValue(M, {1, 2}), WithinAbs(2.0f, 0.001f));
+    REQUIRE_THAT(getTensorValue(M, {3, 1}), WithinAbs(3.0f, 0.001f));
+    REQUIRE_THAT(getTensorValue(M, {2, 4}), WithinAbs(4.0f, 0.001f));
+    REQUIRE_THAT(getTensorValue(M, {3, 4}), WithinAbs(0.0f, 0.001f));
+}
+
 TEST_CASE("Scalar exponentiation", "[tensor][exponentiation]") {
     std::stringstream out, err;
     TensorLogicVM vm{&out, &err};
@@ -301,3 +353,37 @@ TEST_CASE("Polynomial expression with exponentiation", "[tensor][exponentiation]
     auto y = vm.env().lookup("y");
     REQUIRE_THAT(getScalar(y), WithinAbs(16.0f, 0.001f));
 }
+
+TEST_CASE("Device specs parse or fail loudly", "[tensor][device]") {
+    REQUIRE(parseDevice("cpu") == torch::Device(torch::kCPU));
+    REQUIRE(parseDevice("CPU") == torch::Device(torch::kCPU));
+    REQUIRE_THROWS_AS(parseDevice("gpu"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parseDevice("cuda:x"), std::invalid_argument);
+    if (!torch::cuda::is_available()) {
+        REQUIRE_THROWS_AS(parseDevice("cuda"), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Tensors are created on the VM device", "[tensor][device]") {
+    const torch::Device device = torch::cuda::is_available() ? torch::Device(torch::kCUDA, 0)
+                                                             : torch::Device(torch::kCPU);
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.env().bind("Pre", torch::ones({2}));
+    vm.setDevice(device);
+    REQUIRE(vm.device() == device);
+    REQUIRE(vm.env().lookup("Pre").device() == device);
+
+    vm.execute(parseProgram(R"(
+        W[1, 1] = 2.0
+        X = [1.0, 2.0]
+        Y[i] = W[i, j] X[j] + Pre[i]
+    )"));
+    for (const char* name : {"W", "X", "Y"}) {
+        INFO(name);
+        REQUIRE(vm.env().lookup(name).device() == device);
+    }
+    auto Y = vm.env().lookup("Y").cpu();
+    REQUIRE_THAT(getTensorValue(Y, {0}), WithinAbs(1.0f, 0.001f));
+    REQUIRE_THAT(getTensorValue(Y, {1}), WithinAbs(5.0f, 0.001f));
+}
@@ -0,0 +1,102 @@
+#include <catch2/catch_test_macros.hpp>
+#include "TL/Runtime/ThreadPool.hpp"
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace tl;
+
+TEST_CASE("ThreadPool runs every loop index exactly once", "[threadpool]") {
+    ThreadPool pool(4);
+    REQUIRE(pool.size() == 4);
+
+    std::vector<int> hits(1000, 0);
+    pool.parallelFor(hits.size(), [&](size_t i) { hits[i] += 1; });
+    size_t wrong = 0;
+    for (int h : hits) wrong += (h != 1);
+    REQUIRE(wrong == 0);
+
+    // The pool can be reused for further loops
+    std::atomic<size_t> sum{0};
+    pool.parallelFor(100, [&](size_t i) { sum += i; });
+    REQUIRE(sum == 4950);
+}
+
+TEST_CASE("ThreadPool with one thread runs inline", "[threadpool]") {
+    ThreadPool pool(1);
+    REQUIRE(pool.size() == 1);
+
+    std::vector<size_t> order;
+    pool.parallelFor(5, [&](size_t i) { order.push_back(i); });
+    REQUIRE(order == std::vector<size_t>{0, 1, 2, 3, 4});
+}
+
+TEST_CASE("ThreadPool nested loops run inline", "[threadpool]") {
+    ThreadPool pool(3);
+    std::atomic<size_t> count{0};
+    pool.parallelFor(8, [&](size_t) {
+        pool.parallelFor(8, [&](size_t) { ++count; });
+    });
+    REQUIRE(count == 64);
+}
+
+TEST_CASE("ThreadPool rethrows loop body exceptions", "[threadpool]") {
+    ThreadPool pool(4);
+    REQUIRE_THROWS_AS(pool.parallelFor(64, [](size_t i) {
+        if (i == 17) throw std::runtime_error("boom");
+    }), std::runtime_error);
+
+    // A failed loop leaves the pool usable
+    std::atomic<size_t> count{0};
+    pool.parallelFor(32, [&](size_t) { ++count; });
+    REQUIRE(count == 32);
+}
+
+TEST_CASE("ThreadPool shares one configured pool", "[threadpool]") {
+    const ThreadOptions saved = ThreadPool::options();
+
+    ThreadOptions options;
+    options.intraOp = 3;
+    options.numa = NumaPolicy::Spread;
+    ThreadPool::configure(options);
+    CHECK(ThreadPool::options().pin);  // a NUMA order implies pinning
+    CHECK(ThreadPool::defaultThreads() == 3);
+
+    auto shared = ThreadPool::shared();
+    REQUIRE(shared->size() == 3);
+    CHECK(ThreadPool::shared() == shared);
+    std::atomic<size_t> sum{0};
+    shared->parallelFor(100, [&](size_t i) { sum += i; });
+    CHECK(sum == 4950);
+
+    // 0 threads selects the shared pool, other counts a private one kept while it fits
+    std::shared_ptr<ThreadPool> pool;
+    ThreadPool::obtain(pool, 0);
+    CHECK(pool == shared);
+    ThreadPool::obtain(pool, 2);
+    REQUIRE(pool->size() == 2);
+    const auto priv = pool;
+    ThreadPool::obtain(pool, 2);
+    CHECK(pool == priv);
+
+    // Reconfiguring replaces the shared pool; holders keep the old one alive
+    ThreadPool::configure(saved);
+    CHECK(ThreadPool::shared() != shared);
+    CHECK(shared->size() == 3);
+
+    CHECK(parseNumaPolicy("compact") == NumaPolicy::Compact);
+    CHECK_THROWS_AS(parseNumaPolicy("local"), std::invalid_argument);
+}
+
+TEST_CASE("ThreadPool runs a concurrent caller's loop inline", "[threadpool]") {
+    ThreadPool pool(4);
+    std::atomic<size_t> count{0};
+    std::thread other([&] {
+        for (int k = 0; k < 100; ++k) pool.parallelFor(50, [&](size_t) { ++count; });
+    });
+    for (int k = 0; k < 100; ++k) pool.parallelFor(50, [&](size_t) { ++count; });
+    other.join();
+    REQUIRE(count == 10000);
+}
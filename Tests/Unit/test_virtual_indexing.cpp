@@ -1,8 +1,10 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
 #include "TL/Parser.hpp"
 #include "TL/vm.hpp"
 #include <cmath>
+#include <map>
 #include <sstream>
 
 using namespace tl;
@@ -915,3 +917,240 @@ TEST_CASE("Virtual indexing - Error on invalid configuration", "[virtual_indexin
 
     REQUIRE_THROWS_AS(vm.execute(prog), std::runtime_error);
 }
+
+TEST_CASE("Virtual indexing - Native recurrence matches the expansion", "[virtual_indexing]") {
+    const std::string source = R"(
+        W = [[0.5, 0.2, 0.1], [0.3, 0.6, 0.4], [0.1, 0.2, 0.5]]
+        U = [[0.7, 0.3], [0.4, 0.6], [0.5, 0.2]]
+        Input = [[1.0, 0.8, 0.6, 0.9, 0.7, 0.2], [0.5, 0.6, 0.9, 0.4, 0.7, 0.3]]
+
+        Hidden[0, 0] = 0.0
+        Hidden[1, 0] = 0.0
+        Hidden[2, 0] = 0.0
+        Cell[0, 0] = 0.1
+        Cell[1, 0] = 0.3
+        Cell[2, 0] = 0.2
+
+        Gate[i, *t+1] = sigmoid(U[i, k] Input[k, t] + W[i, j] Hidden[j, *t])
+        Cell[i, *t+1] = Gate[i, *t+1] * Cell[i, *t] + tanh(U[i, k] Input[k, t])
+        Hidden[i, *t+1] = Gate[i, *t+1] * tanh(Cell[i, *t+1])
+    )";
+
+    std::stringstream out, err;
+    TensorLogicVM native{&out, &err};
+    TensorLogicVM unrolled{&out, &err};
+    unrolled.setNativeRecurrence(false);
+    native.execute(parseProgram(source));
+    unrolled.execute(parseProgram(source));
+
+    for (const char* name : {"Gate", "Cell", "Hidden"}) {
+        INFO(name);
+        const auto& expected = unrolled.env().lookup(name);
+        const auto& result = native.env().lookup(name);
+        REQUIRE(result.sizes() == expected.sizes());
+        CHECK(torch::allclose(result, expected, 1e-5, 1e-6));
+    }
+
+    // Only the live window is kept; the expansion leaves one temporary per step
+    CHECK(unrolled.env().has("Hidden_next_5"));
+    CHECK_FALSE(native.env().has("Hidden_next_0"));
+}
+
+TEST_CASE("Virtual indexing - Reads before the previous step are rejected", "[virtual_indexing]") {
+    // Only the previous state is kept between steps, so *t-1 has nothing to
+    // read on either path
+    const std::string source = R"(
+        steps = [0.0, 0.0, 0.0, 0.0, 0.0]
+        fib[0] = 1.0
+        fib[*t+1] = fib[*t] + fib[*t-1] + steps[t]
+    )";
+
+    for (bool nativeRecurrence : {true, false}) {
+        INFO(nativeRecurrence);
+        std::stringstream out, err;
+        TensorLogicVM vm{&out, &err};
+        vm.setNativeRecurrence(nativeRecurrence);
+        REQUIRE_THROWS_WITH(vm.execute(parseProgram(source)),
+                            Catch::Matchers::ContainsSubstring("fib[*t-1] reads 2 steps back"));
+    }
+}
+
+TEST_CASE("Virtual indexing - Native fixed-point loop", "[virtual_indexing]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    auto prog = parseProgram(R"(
+        x[0] = 1.0
+        x[*t+1] = cos(x[*t])
+    )");
+    vm.execute(prog);
+
+    const auto x = vm.env().lookup("x");
+    REQUIRE(x.numel() == 1);
+    CHECK_THAT(x.item<float>(), WithinAbs(0.739f, 0.001f));
+
+    // The body is dispatched once, not once per iteration
+    size_t dispatches = 0, executions = 0;
+    for (const auto& s : vm.executors().stats()) {
+        dispatches += s.selections + s.cacheHits;
+        executions += s.executions;
+    }
+    CHECK(executions > 20);
+    CHECK(dispatches < 10);
+}
+
+TEST_CASE("Virtual indexing - Fixed-point convergence options", "[virtual_indexing]") {
+    const std::string source = R"(
+        x[0] = 1.0
+        x[*t+1] = cos(x[*t])
+    )";
+    auto run = [&](const ConvergenceOptions& options, bool native = true) {
+        std::stringstream out, err;
+        TensorLogicVM vm{&out, &err};
+        vm.setNativeRecurrence(native);
+        vm.setConvergenceOptions("x", options);
+        vm.execute(parseProgram(source));
+        REQUIRE(vm.convergenceReports().count("x") == 1);
+        return vm.convergenceReports().at("x");
+    };
+
+    const ConvergenceReport every = run({});
+    CHECK(every.converged);
+    CHECK(every.iterations > 20);
+    CHECK(every.iterations < ABSOLUTE_MAX_ITERS);
+    CHECK(run({}, false).iterations == every.iterations);
+
+    // Reading the count every 8 comparisons stops at the first read after convergence
+    ConvergenceOptions batched;
+    batched.checkInterval = 8;
+    const ConvergenceReport late = run(batched);
+    CHECK(late.converged);
+    CHECK(late.iterations >= every.iterations);
+    CHECK(late.iterations < every.iterations + 8);
+    CHECK((late.iterations - 1) % 8 == 0);
+
+    ConvergenceOptions capped;
+    capped.maxIterations = 5;
+    const ConvergenceReport stopped = run(capped);
+    CHECK_FALSE(stopped.converged);
+    CHECK(stopped.iterations == 5);
+
+    ConvergenceOptions loose;
+    loose.tolerance = 0.1f;
+    loose.maxStable = 1;
+    CHECK(run(loose).iterations < every.iterations);
+
+    TensorLogicVM vm;
+    ConvergenceOptions invalid;
+    invalid.checkInterval = 0;
+    CHECK_THROWS_AS(vm.setConvergenceOptions(invalid), std::invalid_argument);
+}
+
+TEST_CASE("Virtual indexing - Wavefront over stacked and bidirectional layers", "[virtual_indexing]") {
+    const std::string setup = R"(
+        U1 = [[0.7, 0.3], [0.4, 0.6], [0.5, 0.2]]
+        W1 = [[0.5, 0.2, 0.1], [0.3, 0.6, 0.4], [0.1, 0.2, 0.5]]
+        U2 = [[0.6, 0.3, 0.4], [0.5, 0.4, 0.3]]
+        W2 = [[0.6, 0.2], [0.3, 0.7]]
+        Input = [[1.0, 0.8, 0.6, 0.9, 0.7], [0.5, 0.6, 0.9, 0.4, 0.3]]
+        Reversed = [[0.7, 0.9, 0.6, 0.8, 1.0], [0.3, 0.4, 0.9, 0.6, 0.5]]
+
+        State1[0, 0] = 0.0
+        State1[1, 0] = 0.0
+        State1[2, 0] = 0.0
+        State2[0, 0] = 0.0
+        State2[1, 0] = 0.0
+        Back[0, 0] = 0.0
+        Back[1, 0] = 0.0
+        Back[2, 0] = 0.0
+    )";
+    const std::string layers = R"(
+        State1[i, *t+1] = tanh(W1[i, j] State1[j, *t] + U1[i, k] Input[k, t])
+        Proj2[i, t] = U2[i, j] State1[j, *t+1]
+        State2[i, *t+1] = tanh(W2[i, j] State2[j, *t] + Proj2[i, t])
+        Back[i, *t+1] = tanh(W1[i, j] Back[j, *t] + U1[i, k] Reversed[k, t])
+    )";
+
+    std::stringstream out, err;
+    TensorLogicVM wavefront{&out, &err};
+    TensorLogicVM ordered{&out, &err};
+    TensorLogicVM unrolled{&out, &err};
+    ordered.setRecurrenceThreads(1);
+    unrolled.setNativeRecurrence(false);
+    for (TensorLogicVM* vm : {&wavefront, &ordered, &unrolled}) vm->execute(parseProgram(setup));
+
+    SECTION("Layer 2 trails layer 1 by its projection; directions share waves") {
+        auto lowered = VirtualIndexPreprocessor::lowerBatch(parseProgram(layers).statements, wavefront.env());
+        REQUIRE(lowered);
+        REQUIRE(lowered->size() == 1);
+        const auto& rec = lowered->front();
+        REQUIRE(rec.wavefront);
+        std::map<std::string, int> waves;
+        for (const auto& step : rec.steps) waves[step.output] = step.wave;
+        CHECK(waves["State1$next"] == 0);
+        CHECK(waves["Proj2$step"] == 1);
+        CHECK(waves["State2$next"] == 2);
+        CHECK(waves["Back$next"] == 0);
+    }
+
+    SECTION("Every schedule computes the expansion's values") {
+        for (TensorLogicVM* vm : {&wavefront, &ordered, &unrolled}) vm->execute(parseProgram(layers));
+        for (const char* name : {"State1", "Proj2", "State2", "Back"}) {
+            INFO(name);
+            const auto& expected = unrolled.env().lookup(name);
+            for (TensorLogicVM* vm : {&wavefront, &ordered}) {
+                const auto& result = vm->env().lookup(name);
+                REQUIRE(result.sizes() == expected.sizes());
+                CHECK(torch::allclose(result, expected, 1e-5, 1e-6));
+            }
+        }
+        CHECK_FALSE(wavefront.env().has("State2_next_0"));
+    }
+}
+
+TEST_CASE("Virtual indexing - Feedback from a later layer runs in order", "[virtual_indexing]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(R"(
+        Input = [1.0, 0.5, 0.25, 0.75]
+        A[0] = 0.0
+        B[0] = 0.0
+    )"));
+    // A reads B one step back while B reads this step's A: no skew satisfies both
+    auto lowered = VirtualIndexPreprocessor::lowerBatch(parseProgram(R"(
+        A[*t+1] = tanh(B[*t] + Input[t])
+        B[*t+1] = A[*t+1] * 0.5
+    )").statements, vm.env());
+    REQUIRE(lowered);
+    CHECK_FALSE(lowered->front().wavefront);
+    for (const auto& step : lowered->front().steps) CHECK(step.wave == 0);
+}
+
+TEST_CASE("Virtual indexing - Input projections leave the step body", "[virtual_indexing]") {
+    std::stringstream out, err;
+    TensorLogicVM vm{&out, &err};
+    vm.execute(parseProgram(R"(
+        W = [[0.5, 0.2], [0.3, 0.6]]
+        U = [[0.7, 0.3, 0.1], [0.4, 0.6, 0.2]]
+        Input = [[1.0, 0.8, 0.6, 0.9], [0.5, 0.6, 0.9, 0.4], [0.2, 0.1, 0.3, 0.7]]
+        Hidden[0, 0] = 0.1
+        Hidden[1, 0] = 0.2
+        Cell[0, 0] = 0.3
+        Cell[1, 0] = 0.4
+    )"));
+    auto lowered = VirtualIndexPreprocessor::lowerBatch(parseProgram(R"(
+        Hidden[i, *t+1] = tanh(W[i, j] Hidden[j, *t] + U[i, k] Input[k, t])
+        Cell[i, *t+1] = Cell[i, *t] * sigmoid(U[i, k] Input[k, t]) + Hidden[k, *t+1] U[i, k] Input[k, t]
+    )").statements, vm.env());
+    REQUIRE(lowered);
+    const auto& rec = lowered->front();
+
+    // The shared projection is computed once; the product with Hidden keeps
+    // its summed k and stays in the body
+    REQUIRE(rec.hoisted.size() == 1);
+    CHECK(rec.hoisted[0].lhs.name.name == "Hidden$in0");
+    CHECK(rec.hoisted[0].lhs.indices.size() == 2);
+    REQUIRE(rec.views.size() == 2);
+    CHECK(rec.views[0].source == "Hidden$in0");
+    CHECK(rec.views[0].dim == 1);
+    CHECK(rec.views[1].source == "Input");
+}